@@ -33,6 +33,8 @@ let package = Package(
             ],
             sources: [
                 "archive_acl.c",
+                "archive_aes.c",
+                "archive_base64.c",
                 "archive_check_magic.c",
                 "archive_cmdline.c",
                 "archive_cryptor.c",
@@ -45,6 +47,7 @@ let package = Package(
                 "archive_entry_strmode.c",
                 "archive_entry_xattr.c",
                 "archive_hmac.c",
+                "archive_lzo1x.c",
                 "archive_match.c",
                 "archive_options.c",
                 "archive_pack_dev.c",
@@ -101,8 +104,11 @@ let package = Package(
                 "archive_read_support_format_warc.c",
                 "archive_read_support_format_xar.c",
                 "archive_read_support_format_zip.c",
+                "archive_sha1.c",
+                "archive_sha256.c",
                 "archive_string.c",
                 "archive_string_sprintf.c",
+                "archive_thread.c",
                 "archive_time.c",
                 "archive_util.c",
                 "archive_version_details.c",
@@ -155,6 +161,7 @@ let package = Package(
                 "filter_fork_posix.c",
                 "xxhash.c",
                 "archive_blake2sp_ref.c",
+                "archive_blake2sp_simd.c",
                 "archive_blake2s_ref.c"
             ],
             cSettings: [
@@ -26,6 +26,8 @@ LOCAL_PATH := $(subst /contrib/android,,$(call my-dir))
 libarchive_target_config := contrib/android/config/android.h
 
 libarchive_src_files := libarchive/archive_acl.c \
+						libarchive/archive_aes.c \
+						libarchive/archive_base64.c \
 						libarchive/archive_check_magic.c \
 						libarchive/archive_cmdline.c \
 						libarchive/archive_cryptor.c \
@@ -38,6 +40,7 @@ libarchive_src_files := libarchive/archive_acl.c \
 						libarchive/archive_entry_strmode.c \
 						libarchive/archive_entry_xattr.c \
 						libarchive/archive_hmac.c \
+						libarchive/archive_lzo1x.c \
 						libarchive/archive_match.c \
 						libarchive/archive_options.c \
 						libarchive/archive_pack_dev.c \
@@ -91,8 +94,11 @@ libarchive_src_files := libarchive/archive_acl.c \
 						libarchive/archive_read_support_format_warc.c \
 						libarchive/archive_read_support_format_xar.c \
 						libarchive/archive_read_support_format_zip.c \
+						libarchive/archive_sha1.c \
+						libarchive/archive_sha256.c \
 						libarchive/archive_string.c \
 						libarchive/archive_string_sprintf.c \
+						libarchive/archive_thread.c \
 						libarchive/archive_util.c \
 						libarchive/archive_version_details.c \
 						libarchive/archive_virtual.c \
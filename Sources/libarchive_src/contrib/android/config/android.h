@@ -98,6 +98,7 @@
 #define HAVE_LONG_LONG_INT 1
 #define HAVE_LSETXATTR 1
 #define HAVE_LSTAT 1
+#define HAVE_MADVISE 1
 #define HAVE_MBRTOWC 1
 #define HAVE_MEMMOVE 1
 #define HAVE_MEMORY_H 1
@@ -140,6 +141,7 @@
 #define HAVE_SYMLINK 1
 #define HAVE_SYS_CDEFS_H 1
 #define HAVE_SYS_IOCTL_H 1
+#define HAVE_SYS_MMAN_H 1
 #define HAVE_SYS_MOUNT_H 1
 #define HAVE_SYS_PARAM_H 1
 #define HAVE_SYS_POLL_H 1
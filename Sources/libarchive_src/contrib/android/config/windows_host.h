@@ -427,9 +427,6 @@
 /* Define to 1 if you have the `lzma' library (-llzma). */
 /* #undef HAVE_LIBLZMA */
 
-/* Define to 1 if you have the `lzo2' library (-llzo2). */
-/* #undef HAVE_LIBLZO2 */
-
 /* Define to 1 if you have the `md' library (-lmd). */
 /* #undef HAVE_LIBMD */
 
@@ -533,11 +530,8 @@
 /* Define to 1 if you have the <lzma.h> header file. */
 /* #undef HAVE_LZMA_H */
 
-/* Define to 1 if you have the <lzo/lzo1x.h> header file. */
-/* #undef HAVE_LZO_LZO1X_H */
-
-/* Define to 1 if you have the <lzo/lzoconf.h> header file. */
-/* #undef HAVE_LZO_LZOCONF_H */
+/* Define to 1 if you have the `madvise' function. */
+/* #undef HAVE_MADVISE */
 
 /* Define to 1 if you have the `mbrtowc' function. */
 #define HAVE_MBRTOWC 1
@@ -778,6 +772,9 @@
 /* Define to 1 if you have the <sys/mkdev.h> header file. */
 /* #undef HAVE_SYS_MKDEV_H */
 
+/* Define to 1 if you have the <sys/mman.h> header file. */
+/* #undef HAVE_SYS_MMAN_H */
+
 /* Define to 1 if you have the <sys/mount.h> header file. */
 /* #undef HAVE_SYS_MOUNT_H */
 
@@ -11,6 +11,6 @@ cp $SRC/libarchive/contrib/oss-fuzz/corpus.zip\
 $CXX $CXXFLAGS -Ilibarchive \
     $SRC/libarchive/contrib/oss-fuzz/libarchive_fuzzer.cc \
      -o $OUT/libarchive_fuzzer $LIB_FUZZING_ENGINE \
-    .libs/libarchive.a -Wl,-Bstatic -lbz2 -llzo2  \
+    .libs/libarchive.a -Wl,-Bstatic -lbz2 \
     -lxml2 -llzma -lz -lcrypto -llz4 -licuuc \
     -licudata -Wl,-Bdynamic
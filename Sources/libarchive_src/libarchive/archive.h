@@ -572,6 +572,10 @@ __LA_DECL int archive_read_open_filename(struct archive *,
  * NOTE: Must be NULL terminated. Sorting is NOT done. */
 __LA_DECL int archive_read_open_filenames(struct archive *,
 		     const char **_filenames, size_t _block_size);
+/* Use this for a multivolume archive given any one volume's name; the
+ * others are found from .partN.rar, .rNN, .zNN and .NNN naming. */
+__LA_DECL int archive_read_open_volumes(struct archive *,
+		     const char *_filename, size_t _block_size);
 __LA_DECL int archive_read_open_filename_w(struct archive *,
 		     const wchar_t *_filename, size_t _block_size);
 #if defined(_WIN32) && !defined(__CYGWIN__)
@@ -608,6 +612,26 @@ __LA_DECL int archive_read_next_header2(struct archive *,
  */
 __LA_DECL la_int64_t		 archive_read_header_position(struct archive *);
 
+/*
+ * Tar only: using an index loaded with the "tar:read-index" option,
+ * reposition a seekable archive so that the next call to
+ * archive_read_next_header() returns the named entry.  The index is
+ * produced by an earlier sequential read with "tar:write-index".
+ */
+__LA_DECL int archive_read_tar_seek_entry(struct archive *,
+		     const char *_pathname);
+
+/*
+ * Zip only: check candidate passphrases against the traditional PKWARE
+ * encryption header of the entry just returned by
+ * archive_read_next_header(), before any of its data is read.
+ * Returns the index of the first candidate that passes, whose keys are
+ * then used to decrypt the entry, or ARCHIVE_WARN if none does.  The
+ * check covers one byte, so about one wrong passphrase in 256 passes.
+ */
+__LA_DECL int archive_read_zip_find_passphrase(struct archive *,
+		     const char * const *_passphrases, int _count);
+
 /*
  * Returns 1 if the archive contains at least one encrypted entry.
  * If the archive format not support encryption at all
@@ -685,6 +709,16 @@ __LA_DECL int archive_read_add_passphrase(struct archive *, const char *);
 __LA_DECL int archive_read_set_passphrase_callback(struct archive *,
 			    void *client_data, archive_passphrase_callback *);
 
+/*
+ * Declare, before opening the archive, the entries that will be read.
+ * archive_read_next_header() then returns only those entries, in
+ * archive order, and reports ARCHIVE_EOF once all of them have been
+ * returned.  Formats with solid compression use the list to decode
+ * each solid block at most once and only up to the last wanted byte.
+ */
+__LA_DECL int archive_read_add_wanted_pathname(struct archive *,
+			    const char *_pathname);
+
 
 /*-
  * Convenience function to recreate the current entry (whose header
@@ -0,0 +1,444 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "archive_platform.h"
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "archive_aes_private.h"
+#include "archive_thread_private.h"
+
+/*
+ * AES encryption for the built-in cryptor.
+ *
+ * The portable code keeps four blocks as eight 64-bit bit planes:
+ * bit i of byte j of block b is bit 16 * b + j of plane i.  SubBytes
+ * computes the inverse in GF(2^8) as x^254 with bitsliced multiplies,
+ * so nothing depends on the data but the values themselves; ShiftRows
+ * and MixColumns become shifts and masks on the planes.  The AES-NI
+ * code uses the byte-order round keys directly.
+ */
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))
+#include <cpuid.h>
+#include <wmmintrin.h>
+#define AES_X86_NI	1
+#define AES_NI_TARGET	__attribute__((target("aes,sse2")))
+#elif (defined(_M_X64) || defined(_M_IX86)) && defined(_MSC_VER)
+#include <intrin.h>
+#include <wmmintrin.h>
+#define AES_X86_NI	1
+#define AES_NI_TARGET
+#endif
+
+/* Increment the low eight bytes of a counter block, little-endian. */
+static void
+ctr_increment(uint8_t ctr[16])
+{
+	int j;
+
+	for (j = 0; j < 8; j++) {
+		if (++ctr[j])
+			break;
+	}
+}
+
+/*
+ * Portable bitsliced implementation.
+ */
+
+/* A 16-bit value repeated in each block's lane of a plane. */
+#define	LANES(x)	((uint64_t)(x) * 0x0001000100010001ULL)
+
+static void
+to_planes(uint64_t p[8], const uint8_t in[64])
+{
+	int i, j;
+
+	for (i = 0; i < 8; i++)
+		p[i] = 0;
+	for (j = 0; j < 16; j++) {
+		uint64_t x = in[j] | ((uint64_t)in[16 + j] << 16) |
+		    ((uint64_t)in[32 + j] << 32) | ((uint64_t)in[48 + j] << 48);
+
+		for (i = 0; i < 8; i++)
+			p[i] |= ((x >> i) & LANES(1)) << j;
+	}
+}
+
+static void
+from_planes(uint8_t out[64], const uint64_t p[8])
+{
+	int i, j;
+
+	for (j = 0; j < 16; j++) {
+		uint64_t x = 0;
+
+		for (i = 0; i < 8; i++)
+			x |= ((p[i] >> j) & LANES(1)) << i;
+		out[j] = (uint8_t)x;
+		out[16 + j] = (uint8_t)(x >> 16);
+		out[32 + j] = (uint8_t)(x >> 32);
+		out[48 + j] = (uint8_t)(x >> 48);
+	}
+}
+
+/* Reduce a 15-bit product modulo x^8 + x^4 + x^3 + x + 1. */
+static void
+gf_reduce(uint64_t r[8], uint64_t t[15])
+{
+	int k;
+
+	for (k = 14; k >= 8; k--) {
+		t[k - 4] ^= t[k];
+		t[k - 5] ^= t[k];
+		t[k - 7] ^= t[k];
+		t[k - 8] ^= t[k];
+	}
+	for (k = 0; k < 8; k++)
+		r[k] = t[k];
+}
+
+static void
+gf_mul(uint64_t r[8], const uint64_t a[8], const uint64_t b[8])
+{
+	uint64_t t[15];
+	int i, j;
+
+	for (i = 0; i < 15; i++)
+		t[i] = 0;
+	for (i = 0; i < 8; i++)
+		for (j = 0; j < 8; j++)
+			t[i + j] ^= a[i] & b[j];
+	gf_reduce(r, t);
+}
+
+static void
+gf_square(uint64_t r[8], const uint64_t a[8])
+{
+	uint64_t t[15];
+	int i;
+
+	for (i = 0; i < 15; i++)
+		t[i] = 0;
+	for (i = 0; i < 8; i++)
+		t[2 * i] = a[i];
+	gf_reduce(r, t);
+}
+
+static void
+sub_bytes(uint64_t p[8])
+{
+	uint64_t x2[8], x3[8], x12[8], x14[8], x[8];
+	int i;
+
+	/* x^254 = x^240 * x^14, which is 1/x, or 0 for 0. */
+	gf_square(x2, p);
+	gf_mul(x3, x2, p);
+	gf_square(x, x3);
+	gf_square(x12, x);
+	gf_mul(x14, x12, x2);
+	gf_mul(x, x12, x3);		/* x^15 */
+	for (i = 0; i < 4; i++)
+		gf_square(x, x);	/* x^240 */
+	gf_mul(x, x, x14);
+
+	/* The affine transform, with the constant 0x63. */
+	for (i = 0; i < 8; i++)
+		p[i] = x[i] ^ x[(i + 4) & 7] ^ x[(i + 5) & 7] ^
+		    x[(i + 6) & 7] ^ x[(i + 7) & 7];
+	p[0] = ~p[0];
+	p[1] = ~p[1];
+	p[5] = ~p[5];
+	p[6] = ~p[6];
+}
+
+/* Rotate each 16-bit lane right by k bits. */
+static uint64_t
+rot16(uint64_t x, int k)
+{
+	uint64_t lo = LANES(0xffffU >> k);
+
+	return ((x >> k) & lo) | ((x << (16 - k)) & ~lo);
+}
+
+/* Byte j is at row j % 4 of column j / 4, so each column is a nibble. */
+static void
+shift_rows(uint64_t p[8])
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+		p[i] = (p[i] & LANES(0x1111)) |
+		    (rot16(p[i], 4) & LANES(0x2222)) |
+		    (rot16(p[i], 8) & LANES(0x4444)) |
+		    (rot16(p[i], 12) & LANES(0x8888));
+}
+
+/* Row r + n of the same column, for n = 1, 2, 3. */
+#define	ROW1(x)	((((x) >> 1) & LANES(0x7777)) | (((x) << 3) & LANES(0x8888)))
+#define	ROW2(x)	((((x) >> 2) & LANES(0x3333)) | (((x) << 2) & LANES(0xcccc)))
+#define	ROW3(x)	((((x) >> 3) & LANES(0x1111)) | (((x) << 1) & LANES(0xeeee)))
+
+static void
+mix_columns(uint64_t p[8])
+{
+	uint64_t t[8], q[8];
+	int i;
+
+	/* 2 * s[r] ^ 3 * s[r+1] ^ s[r+2] ^ s[r+3]
+	 * = 2 * (s[r] ^ s[r+1]) ^ s[r+1] ^ s[r+2] ^ s[r+3] */
+	for (i = 0; i < 8; i++) {
+		t[i] = p[i] ^ ROW1(p[i]);
+		q[i] = ROW1(p[i]) ^ ROW2(p[i]) ^ ROW3(p[i]);
+	}
+	p[0] = q[0] ^ t[7];
+	p[1] = q[1] ^ t[0] ^ t[7];
+	p[2] = q[2] ^ t[1];
+	p[3] = q[3] ^ t[2] ^ t[7];
+	p[4] = q[4] ^ t[3] ^ t[7];
+	p[5] = q[5] ^ t[4];
+	p[6] = q[6] ^ t[5];
+	p[7] = q[7] ^ t[6];
+}
+
+static void
+add_round_key(uint64_t p[8], const uint64_t k[8])
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+		p[i] ^= k[i];
+}
+
+/* Encrypt four blocks. */
+static void
+encrypt4_bitsliced(const struct archive_aes *aes, const uint8_t in[64],
+    uint8_t out[64])
+{
+	uint64_t p[8];
+	unsigned r;
+
+	to_planes(p, in);
+	add_round_key(p, aes->rk_planes[0]);
+	for (r = 1; r < aes->rounds; r++) {
+		sub_bytes(p);
+		shift_rows(p);
+		mix_columns(p);
+		add_round_key(p, aes->rk_planes[r]);
+	}
+	sub_bytes(p);
+	shift_rows(p);
+	add_round_key(p, aes->rk_planes[aes->rounds]);
+	from_planes(out, p);
+}
+
+static void
+ctr_xor_bitsliced(const struct archive_aes *aes, uint8_t ctr[16],
+    const uint8_t *in, uint8_t *out, size_t blocks)
+{
+	uint8_t c[64], k[64];
+	int i, n;
+
+	while (blocks > 0) {
+		n = blocks >= 4 ? 4 : (int)blocks;
+		for (i = 0; i < n; i++) {
+			ctr_increment(ctr);
+			memcpy(c + 16 * i, ctr, 16);
+		}
+		encrypt4_bitsliced(aes, c, k);
+		for (i = 0; i < 16 * n; i++)
+			out[i] = in[i] ^ k[i];
+		in += 16 * n;
+		out += 16 * n;
+		blocks -= n;
+	}
+}
+
+#ifdef AES_X86_NI
+
+static int
+aes_ni_available(void)
+{
+#if defined(_MSC_VER)
+	int info[4];
+
+	__cpuid(info, 1);
+	return ((info[2] >> 25) & 1) && ((info[3] >> 26) & 1);
+#else
+	unsigned int a, b, c, d;
+
+	if (!__get_cpuid(1, &a, &b, &c, &d))
+		return (0);
+	return ((c >> 25) & 1) && ((d >> 26) & 1);
+#endif
+}
+
+AES_NI_TARGET static void
+ctr_xor_ni(const struct archive_aes *aes, uint8_t ctr[16],
+    const uint8_t *in, uint8_t *out, size_t blocks)
+{
+	__m128i rk[ARCHIVE_AES_MAX_ROUNDS + 1], x[8], c, one;
+	const unsigned rounds = aes->rounds;
+	unsigned r;
+	int i, n;
+
+	for (r = 0; r <= rounds; r++)
+		rk[r] = _mm_loadu_si128((const __m128i *)aes->rk[r]);
+	/* The little-endian counter is the low 64-bit lane, and
+	 * _mm_add_epi64() wraps it without touching the high lane. */
+	c = _mm_loadu_si128((const __m128i *)ctr);
+	one = _mm_set_epi32(0, 0, 0, 1);
+
+	/* Eight blocks at a time keep the AES unit busy. */
+	while (blocks > 0) {
+		n = blocks >= 8 ? 8 : (int)blocks;
+		for (i = 0; i < n; i++) {
+			c = _mm_add_epi64(c, one);
+			x[i] = _mm_xor_si128(c, rk[0]);
+		}
+		for (r = 1; r < rounds; r++)
+			for (i = 0; i < n; i++)
+				x[i] = _mm_aesenc_si128(x[i], rk[r]);
+		for (i = 0; i < n; i++) {
+			x[i] = _mm_aesenclast_si128(x[i], rk[rounds]);
+			_mm_storeu_si128((__m128i *)(out + 16 * i),
+			    _mm_xor_si128(x[i], _mm_loadu_si128(
+			    (const __m128i *)(in + 16 * i))));
+		}
+		in += 16 * n;
+		out += 16 * n;
+		blocks -= n;
+	}
+	_mm_storeu_si128((__m128i *)ctr, c);
+}
+
+#endif /* AES_X86_NI */
+
+#ifdef AES_X86_NI
+static int aes_use_ni;
+static archive_thread_once_t aes_once = ARCHIVE_THREAD_ONCE_INIT;
+/* Set by __archive_aes_force_portable(). */
+static int aes_portable;
+
+static void
+aes_select(void)
+{
+	aes_use_ni = !aes_portable && aes_ni_available();
+}
+#endif
+
+/*
+ * For the tests: use only the bitsliced code, or go back to AES-NI
+ * where the CPU has it.  Not safe while other threads are encrypting.
+ */
+void
+__archive_aes_force_portable(int portable)
+{
+#ifdef AES_X86_NI
+	__archive_thread_once(&aes_once, aes_select);
+	aes_portable = portable;
+	aes_select();
+#else
+	(void)portable; /* UNUSED */
+#endif
+}
+
+static void
+sub_word(uint8_t w[4])
+{
+	uint8_t a[64];
+	uint64_t p[8];
+
+	memset(a, 0, sizeof(a));
+	memcpy(a, w, 4);
+	to_planes(p, a);
+	sub_bytes(p);
+	from_planes(a, p);
+	memcpy(w, a, 4);
+}
+
+int
+__archive_aes_set_encrypt_key(struct archive_aes *aes, const uint8_t *key,
+    size_t key_len)
+{
+	uint8_t *w = &aes->rk[0][0];
+	uint8_t t[4], rcon = 1;
+	unsigned i, nk, words, r;
+	int j;
+
+	switch (key_len) {
+	case 16: aes->rounds = 10; break;
+	case 24: aes->rounds = 12; break;
+	case 32: aes->rounds = 14; break;
+	default: return (-1);
+	}
+	nk = (unsigned)key_len / 4;
+	words = 4 * (aes->rounds + 1);
+	memcpy(w, key, key_len);
+	for (i = nk; i < words; i++) {
+		memcpy(t, w + 4 * (i - 1), 4);
+		if (i % nk == 0) {
+			uint8_t t0 = t[0];
+
+			t[0] = t[1];
+			t[1] = t[2];
+			t[2] = t[3];
+			t[3] = t0;
+			sub_word(t);
+			t[0] ^= rcon;
+			rcon = (uint8_t)((rcon << 1) ^ ((rcon >> 7) * 0x1b));
+		} else if (nk > 6 && i % nk == 4)
+			sub_word(t);
+		for (j = 0; j < 4; j++)
+			w[4 * i + j] = w[4 * (i - nk) + j] ^ t[j];
+	}
+
+	for (r = 0; r <= aes->rounds; r++) {
+		uint8_t k4[64];
+
+		for (j = 0; j < 4; j++)
+			memcpy(k4 + 16 * j, aes->rk[r], 16);
+		to_planes(aes->rk_planes[r], k4);
+	}
+	return (0);
+}
+
+void
+__archive_aes_ctr_xor(const struct archive_aes *aes, uint8_t ctr[16],
+    const uint8_t *in, uint8_t *out, size_t blocks)
+{
+#ifdef AES_X86_NI
+	__archive_thread_once(&aes_once, aes_select);
+	if (aes_use_ni) {
+		ctr_xor_ni(aes, ctr, in, out, blocks);
+		return;
+	}
+#endif
+	ctr_xor_bitsliced(aes, ctr, in, out, blocks);
+}
@@ -0,0 +1,68 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ARCHIVE_AES_PRIVATE_H_INCLUDED
+#define ARCHIVE_AES_PRIVATE_H_INCLUDED
+
+#ifndef __LIBARCHIVE_BUILD
+#error This header is only to be used internally to libarchive.
+#endif
+
+/*
+ * Built-in AES encryption, used by the cryptor when no crypto library
+ * is available.  Only the forward cipher is provided, since counter
+ * mode is all the archive formats need.
+ *
+ * Blocks are encrypted with AES-NI where the CPU has it, otherwise
+ * with a portable bitsliced implementation that does no
+ * secret-dependent table lookups or branches.
+ */
+
+#define ARCHIVE_AES_MAX_ROUNDS	14
+
+struct archive_aes {
+	/* Round keys in FIPS-197 byte order. */
+	uint8_t		rk[ARCHIVE_AES_MAX_ROUNDS + 1][16];
+	/* The same round keys as bit planes for the portable code. */
+	uint64_t	rk_planes[ARCHIVE_AES_MAX_ROUNDS + 1][8];
+	unsigned	rounds;
+};
+
+/* Expand a 16, 24 or 32 byte key.  Returns -1 for other lengths. */
+int	__archive_aes_set_encrypt_key(struct archive_aes *,
+	    const uint8_t *key, size_t key_len);
+
+/*
+ * Counter mode as used by WinZip AES: for each block, the low eight
+ * bytes of ctr are first incremented as a little-endian number, then
+ * encrypted and XORed into the data.  in and out may be the same.
+ */
+void	__archive_aes_ctr_xor(const struct archive_aes *, uint8_t ctr[16],
+	    const uint8_t *in, uint8_t *out, size_t blocks);
+
+/* For the tests: make the above use only the portable code. */
+void	__archive_aes_force_portable(int);
+
+#endif /* !ARCHIVE_AES_PRIVATE_H_INCLUDED */
@@ -0,0 +1,534 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "archive_platform.h"
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "archive_base64_private.h"
+#include "archive_thread_private.h"
+
+/*
+ * The vector kernels are picked on first use: AVX2 or SSSE3 on x86,
+ * otherwise portable C.  They work on twelve bytes and sixteen
+ * characters per 128-bit lane: the bytes are spread out so that each
+ * 32-bit lane holds one group, the four 6-bit fields are moved into
+ * separate bytes with two multiplies, and the fields are turned into
+ * characters by adding an offset looked up from the range they fall
+ * in.  Decoding runs the other way, checking every character of a
+ * block against the alphabet before any of it is used.  Whatever is
+ * left over, including a block with a bad character, goes through
+ * the portable code.
+ */
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))
+#include <cpuid.h>
+#include <immintrin.h>
+#define BASE64_X86	1
+#define SSSE3_TARGET	__attribute__((target("ssse3")))
+#define AVX2_TARGET	__attribute__((target("avx2")))
+#elif (defined(_M_X64) || defined(_M_IX86)) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#define BASE64_X86	1
+#define SSSE3_TARGET
+#define AVX2_TARGET
+#endif
+
+/* Returns the number of bytes encoded, a multiple of three. */
+typedef size_t base64_encode_fn(char *, const unsigned char *, size_t, int);
+/* Returns the number of characters decoded, a multiple of four. */
+typedef size_t base64_decode_fn(unsigned char *, const unsigned char *,
+    size_t, int);
+
+static const char base64_digits[64] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* Value of each character of the standard alphabet, XX otherwise. */
+#define	XX	0xff
+static const unsigned char base64_values[256] = {
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, 62, XX, XX, XX, 63,
+	52, 53, 54, 55, 56, 57, 58, 59, 60, 61, XX, XX, XX, XX, XX, XX,
+	XX,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+	15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, XX, XX, XX, XX, XX,
+	XX, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+	41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, XX, XX, XX, XX, XX,
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+};
+#undef	XX
+
+#define	UU_CHAR(v)	((v) ? (v) + 0x20 : '`')
+#define	UU_VALID(c)	((c) >= 0x20 && (c) <= 0x60)
+
+static void
+encode_scalar(char *out, const unsigned char *in, size_t len, int alphabet)
+{
+	unsigned int v;
+
+	if (alphabet == ARCHIVE_BASE64_UU) {
+		for (; len >= 3; in += 3, len -= 3) {
+			v = (in[0] << 16) | (in[1] << 8) | in[2];
+			*out++ = UU_CHAR(v >> 18);
+			*out++ = UU_CHAR((v >> 12) & 0x3f);
+			*out++ = UU_CHAR((v >> 6) & 0x3f);
+			*out++ = UU_CHAR(v & 0x3f);
+		}
+		return;
+	}
+	for (; len >= 3; in += 3, len -= 3) {
+		v = (in[0] << 16) | (in[1] << 8) | in[2];
+		*out++ = base64_digits[v >> 18];
+		*out++ = base64_digits[(v >> 12) & 0x3f];
+		*out++ = base64_digits[(v >> 6) & 0x3f];
+		*out++ = base64_digits[v & 0x3f];
+	}
+}
+
+static size_t
+decode_scalar(unsigned char *out, const unsigned char *in, size_t len,
+    int alphabet)
+{
+	const unsigned char *start = in;
+	unsigned int a, b, c, d;
+
+	for (; len >= 4; in += 4, len -= 4) {
+		if (alphabet == ARCHIVE_BASE64_UU) {
+			if (!UU_VALID(in[0]) || !UU_VALID(in[1]) ||
+			    !UU_VALID(in[2]) || !UU_VALID(in[3]))
+				break;
+			a = (in[0] - 0x20) & 0x3f;
+			b = (in[1] - 0x20) & 0x3f;
+			c = (in[2] - 0x20) & 0x3f;
+			d = (in[3] - 0x20) & 0x3f;
+		} else {
+			a = base64_values[in[0]];
+			b = base64_values[in[1]];
+			c = base64_values[in[2]];
+			d = base64_values[in[3]];
+			if ((a | b | c | d) & 0x80)
+				break;
+		}
+		a = (a << 18) | (b << 12) | (c << 6) | d;
+		*out++ = (unsigned char)(a >> 16);
+		*out++ = (unsigned char)(a >> 8);
+		*out++ = (unsigned char)a;
+	}
+	return (in - start);
+}
+
+static size_t
+encode_none(char *out, const unsigned char *in, size_t len, int alphabet)
+{
+	(void)out; (void)in; (void)len; (void)alphabet; /* UNUSED */
+	return (0);
+}
+
+static size_t
+decode_none(unsigned char *out, const unsigned char *in, size_t len,
+    int alphabet)
+{
+	(void)out; (void)in; (void)len; (void)alphabet; /* UNUSED */
+	return (0);
+}
+
+#ifdef BASE64_X86
+
+/* Bit 0: SSSE3, bit 1: AVX2. */
+static int
+x86_features(void)
+{
+	int r = 0;
+#if defined(_MSC_VER)
+	int info[4], c1, max;
+
+	__cpuid(info, 0);
+	max = info[0];
+	if (max < 1)
+		return (0);
+	__cpuid(info, 1);
+	c1 = info[2];
+	if ((c1 >> 9) & 1)
+		r |= 1;
+	if (!r || max < 7)
+		return (r);
+	__cpuidex(info, 7, 0);
+	if (((info[1] >> 5) & 1) && ((c1 >> 27) & 1) && ((c1 >> 28) & 1) &&
+	    (_xgetbv(0) & 6) == 6)
+		r |= 2;
+#else
+	unsigned int a, b, c, d, c1, xcr0_lo, xcr0_hi, max;
+
+	max = __get_cpuid_max(0, NULL);
+	if (max < 1)
+		return (0);
+	__cpuid(1, a, b, c1, d);
+	if ((c1 >> 9) & 1)
+		r |= 1;
+	if (!r || max < 7)
+		return (r);
+	__cpuid_count(7, 0, a, b, c, d);
+	if (((b >> 5) & 1) && ((c1 >> 27) & 1) && ((c1 >> 28) & 1)) {
+		__asm__ __volatile__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi)
+		    : "c"(0));
+		if ((xcr0_lo & 6) == 6)
+			r |= 2;
+	}
+#endif
+	return (r);
+}
+
+/* Store the twelve low bytes of v. */
+SSSE3_TARGET static void
+store12(unsigned char *out, __m128i v)
+{
+	uint32_t w = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+
+	_mm_storel_epi64((__m128i *)out, v);
+	memcpy(out + 8, &w, 4);
+}
+
+SSSE3_TARGET static __m128i
+enc_fields_x4(__m128i in)
+{
+	__m128i t0, t1;
+
+	in = _mm_shuffle_epi8(in, _mm_set_epi8(
+	    10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+	t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)),
+	    _mm_set1_epi32(0x04000040));
+	t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)),
+	    _mm_set1_epi32(0x01000010));
+	return (_mm_or_si128(t0, t1));
+}
+
+SSSE3_TARGET static __m128i
+enc_chars_x4(__m128i v, int alphabet)
+{
+	__m128i r;
+
+	if (alphabet == ARCHIVE_BASE64_UU)
+		return (_mm_add_epi8(_mm_add_epi8(v, _mm_set1_epi8(0x20)),
+		    _mm_and_si128(_mm_cmpeq_epi8(v, _mm_setzero_si128()),
+		    _mm_set1_epi8(0x40))));
+	/* 0-25: 'A', 26-51: 'a', 52-61: '0', 62: '+', 63: '/'. */
+	r = _mm_subs_epu8(v, _mm_set1_epi8(51));
+	r = _mm_or_si128(r, _mm_and_si128(
+	    _mm_cmpgt_epi8(_mm_set1_epi8(26), v), _mm_set1_epi8(13)));
+	r = _mm_shuffle_epi8(_mm_setr_epi8('a' - 26, '0' - 52, '0' - 52,
+	    '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+	    '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0), r);
+	return (_mm_add_epi8(r, v));
+}
+
+/* Returns the 6-bit values of the characters, or sets *bad. */
+SSSE3_TARGET static __m128i
+dec_values_x4(__m128i in, int alphabet, int *bad)
+{
+	__m128i hi, outside, slash, x;
+
+	if (alphabet == ARCHIVE_BASE64_UU) {
+		x = _mm_sub_epi8(in, _mm_set1_epi8(0x20));
+		outside = _mm_or_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8(0x40)),
+		    _mm_cmplt_epi8(x, _mm_setzero_si128()));
+		*bad |= _mm_movemask_epi8(outside);
+		return (_mm_and_si128(x, _mm_set1_epi8(0x3f)));
+	}
+	/* The high nibble selects the valid range and the offset. */
+	hi = _mm_and_si128(_mm_srli_epi32(in, 4), _mm_set1_epi8(0x0f));
+	slash = _mm_cmpeq_epi8(in, _mm_set1_epi8('/'));
+	outside = _mm_or_si128(
+	    _mm_cmplt_epi8(in, _mm_shuffle_epi8(_mm_setr_epi8(
+		1, 1, 0x2b, 0x30, 0x41, 0x50, 0x61, 0x70,
+		1, 1, 1, 1, 1, 1, 1, 1), hi)),
+	    _mm_cmpgt_epi8(in, _mm_shuffle_epi8(_mm_setr_epi8(
+		0, 0, 0x2b, 0x39, 0x4f, 0x5a, 0x6f, 0x7a,
+		0, 0, 0, 0, 0, 0, 0, 0), hi)));
+	*bad |= _mm_movemask_epi8(_mm_andnot_si128(slash, outside));
+	x = _mm_add_epi8(in, _mm_shuffle_epi8(_mm_setr_epi8(
+	    0, 0, 62 - 0x2b, 52 - 0x30, 0 - 0x41, 15 - 0x50, 26 - 0x61,
+	    41 - 0x70, 0, 0, 0, 0, 0, 0, 0, 0), hi));
+	return (_mm_add_epi8(x, _mm_and_si128(slash, _mm_set1_epi8(-3))));
+}
+
+/* Join the four 6-bit values of each group into its three bytes. */
+SSSE3_TARGET static __m128i
+dec_bytes_x4(__m128i v)
+{
+	v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+	v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+	return (_mm_shuffle_epi8(v, _mm_setr_epi8(
+	    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)));
+}
+
+SSSE3_TARGET static size_t
+encode_ssse3(char *out, const unsigned char *in, size_t len, int alphabet)
+{
+	size_t done;
+
+	/* Sixteen bytes are loaded for every twelve encoded. */
+	for (done = 0; len - done >= 16; done += 12, out += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(in + done));
+
+		_mm_storeu_si128((__m128i *)out,
+		    enc_chars_x4(enc_fields_x4(v), alphabet));
+	}
+	return (done);
+}
+
+SSSE3_TARGET static size_t
+decode_ssse3(unsigned char *out, const unsigned char *in, size_t len,
+    int alphabet)
+{
+	size_t done;
+	int bad = 0;
+
+	for (done = 0; len - done >= 16; done += 16, out += 12) {
+		__m128i v = dec_values_x4(
+		    _mm_loadu_si128((const __m128i *)(in + done)),
+		    alphabet, &bad);
+
+		if (bad)
+			break;
+		store12(out, dec_bytes_x4(v));
+	}
+	return (done);
+}
+
+/*
+ * The AVX2 kernels handle two blocks at a time, one in each 128-bit
+ * half, with the same steps as above.
+ */
+AVX2_TARGET static size_t
+encode_avx2(char *out, const unsigned char *in, size_t len, int alphabet)
+{
+	const __m256i spread = _mm256_broadcastsi128_si256(_mm_set_epi8(
+	    10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+	const __m256i shift_lut = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+	    'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+	    '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+	    '/' - 63, 'A', 0, 0));
+	size_t done;
+
+	for (done = 0; len - done >= 28; done += 24, out += 32) {
+		__m256i v, t0, t1, r;
+
+		v = _mm256_inserti128_si256(_mm256_castsi128_si256(
+		    _mm_loadu_si128((const __m128i *)(in + done))),
+		    _mm_loadu_si128((const __m128i *)(in + done + 12)), 1);
+		v = _mm256_shuffle_epi8(v, spread);
+		t0 = _mm256_mulhi_epu16(
+		    _mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00)),
+		    _mm256_set1_epi32(0x04000040));
+		t1 = _mm256_mullo_epi16(
+		    _mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0)),
+		    _mm256_set1_epi32(0x01000010));
+		v = _mm256_or_si256(t0, t1);
+		if (alphabet == ARCHIVE_BASE64_UU) {
+			r = _mm256_add_epi8(
+			    _mm256_add_epi8(v, _mm256_set1_epi8(0x20)),
+			    _mm256_and_si256(_mm256_cmpeq_epi8(v,
+			    _mm256_setzero_si256()), _mm256_set1_epi8(0x40)));
+		} else {
+			r = _mm256_subs_epu8(v, _mm256_set1_epi8(51));
+			r = _mm256_or_si256(r, _mm256_and_si256(
+			    _mm256_cmpgt_epi8(_mm256_set1_epi8(26), v),
+			    _mm256_set1_epi8(13)));
+			r = _mm256_add_epi8(_mm256_shuffle_epi8(shift_lut, r),
+			    v);
+		}
+		_mm256_storeu_si256((__m256i *)out, r);
+	}
+	/* The SSSE3 kernel is not VEX encoded; avoid the transition
+	 * penalty of running it with the upper halves in use. */
+	_mm256_zeroupper();
+	return (done + encode_ssse3(out, in + done, len - done, alphabet));
+}
+
+AVX2_TARGET static size_t
+decode_avx2(unsigned char *out, const unsigned char *in, size_t len,
+    int alphabet)
+{
+	const __m256i lower = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+	    1, 1, 0x2b, 0x30, 0x41, 0x50, 0x61, 0x70,
+	    1, 1, 1, 1, 1, 1, 1, 1));
+	const __m256i upper = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+	    0, 0, 0x2b, 0x39, 0x4f, 0x5a, 0x6f, 0x7a,
+	    0, 0, 0, 0, 0, 0, 0, 0));
+	const __m256i shift = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+	    0, 0, 62 - 0x2b, 52 - 0x30, 0 - 0x41, 15 - 0x50, 26 - 0x61,
+	    41 - 0x70, 0, 0, 0, 0, 0, 0, 0, 0));
+	const __m256i pack = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+	    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+	size_t done;
+
+	for (done = 0; len - done >= 32; done += 32, out += 24) {
+		__m256i v, x, hi, slash, outside;
+
+		v = _mm256_loadu_si256((const __m256i *)(in + done));
+		if (alphabet == ARCHIVE_BASE64_UU) {
+			x = _mm256_sub_epi8(v, _mm256_set1_epi8(0x20));
+			outside = _mm256_or_si256(
+			    _mm256_cmpgt_epi8(x, _mm256_set1_epi8(0x40)),
+			    _mm256_cmpgt_epi8(_mm256_setzero_si256(), x));
+			if (_mm256_movemask_epi8(outside))
+				break;
+			x = _mm256_and_si256(x, _mm256_set1_epi8(0x3f));
+		} else {
+			hi = _mm256_and_si256(_mm256_srli_epi32(v, 4),
+			    _mm256_set1_epi8(0x0f));
+			slash = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('/'));
+			outside = _mm256_or_si256(
+			    _mm256_cmpgt_epi8(_mm256_shuffle_epi8(lower, hi), v),
+			    _mm256_cmpgt_epi8(v, _mm256_shuffle_epi8(upper, hi)));
+			if (_mm256_movemask_epi8(
+			    _mm256_andnot_si256(slash, outside)))
+				break;
+			x = _mm256_add_epi8(v, _mm256_shuffle_epi8(shift, hi));
+			x = _mm256_add_epi8(x, _mm256_and_si256(slash,
+			    _mm256_set1_epi8(-3)));
+		}
+		x = _mm256_maddubs_epi16(x, _mm256_set1_epi32(0x01400140));
+		x = _mm256_madd_epi16(x, _mm256_set1_epi32(0x00011000));
+		x = _mm256_shuffle_epi8(x, pack);
+		store12(out, _mm256_castsi256_si128(x));
+		store12(out + 12, _mm256_extracti128_si256(x, 1));
+	}
+	_mm256_zeroupper();
+	return (done + decode_ssse3(out, in + done, len - done, alphabet));
+}
+
+#endif /* BASE64_X86 */
+
+static base64_encode_fn *base64_encode_vec;
+static base64_decode_fn *base64_decode_vec;
+static archive_thread_once_t base64_once = ARCHIVE_THREAD_ONCE_INIT;
+
+static void
+base64_select(void)
+{
+	base64_encode_fn *enc = encode_none;
+	base64_decode_fn *dec = decode_none;
+
+#ifdef BASE64_X86
+	{
+		int features = x86_features();
+
+		if (features & 1) {
+			enc = encode_ssse3;
+			dec = decode_ssse3;
+		}
+		if (features & 2) {
+			enc = encode_avx2;
+			dec = decode_avx2;
+		}
+	}
+#endif
+	base64_decode_vec = dec;
+	base64_encode_vec = enc;
+}
+
+size_t
+__archive_base64_encode(char *out, const unsigned char *in, size_t len,
+    int alphabet)
+{
+	size_t done;
+
+	__archive_thread_once(&base64_once, base64_select);
+	done = base64_encode_vec(out, in, len, alphabet);
+	encode_scalar(out + done / 3 * 4, in + done, len - done, alphabet);
+	return (len / 3 * 4);
+}
+
+size_t
+__archive_base64_lines_size(size_t len, size_t line_bytes)
+{
+	/* Length, padded groups and newline of each line. */
+	return ((len / line_bytes + 1) * (line_bytes / 3 * 4 + 6));
+}
+
+size_t
+__archive_base64_encode_lines(char *out, const unsigned char *in,
+    size_t len, size_t line_bytes, int alphabet)
+{
+	char *p = out;
+	size_t n, full;
+	unsigned int v;
+	char pad;
+
+	pad = alphabet == ARCHIVE_BASE64_UU ? '`' : '=';
+	while (len > 0) {
+		n = len < line_bytes ? len : line_bytes;
+		full = n - n % 3;
+		if (alphabet == ARCHIVE_BASE64_UU)
+			*p++ = (char)UU_CHAR(n);
+		p += __archive_base64_encode(p, in, full, alphabet);
+		if (n > full) {
+			v = in[full] << 16;
+			if (n - full == 2)
+				v |= in[full + 1] << 8;
+			if (alphabet == ARCHIVE_BASE64_UU) {
+				p[0] = (char)UU_CHAR(v >> 18);
+				p[1] = (char)UU_CHAR((v >> 12) & 0x3f);
+				p[2] = (char)UU_CHAR((v >> 6) & 0x3f);
+			} else {
+				p[0] = base64_digits[v >> 18];
+				p[1] = base64_digits[(v >> 12) & 0x3f];
+				p[2] = base64_digits[(v >> 6) & 0x3f];
+			}
+			if (n - full == 1)
+				p[2] = pad;
+			p[3] = pad;
+			p += 4;
+		}
+		*p++ = '\n';
+		in += n;
+		len -= n;
+	}
+	return (p - out);
+}
+
+size_t
+__archive_base64_decode(unsigned char *out, const unsigned char *in,
+    size_t len, int alphabet)
+{
+	size_t done;
+
+	__archive_thread_once(&base64_once, base64_select);
+	done = base64_decode_vec(out, in, len, alphabet);
+	return (done + decode_scalar(out + done / 4 * 3, in + done,
+	    len - done, alphabet));
+}
@@ -0,0 +1,69 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ARCHIVE_BASE64_PRIVATE_H_INCLUDED
+#define ARCHIVE_BASE64_PRIVATE_H_INCLUDED
+
+#ifndef __LIBARCHIVE_BUILD
+#error This header is only to be used internally to libarchive.
+#endif
+
+/*
+ * Base64 and uuencode conversion of three bytes to four characters
+ * and back, shared by the b64encode and uuencode write filters, the
+ * uu read filter and the pax attribute decoder of the tar reader.
+ */
+
+#define ARCHIVE_BASE64_STD	0	/* A-Z a-z 0-9 + /, padded with '=' */
+#define ARCHIVE_BASE64_UU	1	/* 0x20 + value, 0 as '`' */
+
+/*
+ * Encode the complete three-byte groups of the len bytes at in.
+ * Returns the number of characters stored at out.
+ */
+size_t	__archive_base64_encode(char *out, const unsigned char *in,
+	    size_t len, int alphabet);
+
+/*
+ * Encode len bytes as lines of line_bytes bytes, the last one
+ * possibly shorter and padded, each ending with a newline; uuencode
+ * lines start with their length.  line_bytes must be a multiple of
+ * three.  out must have room for __archive_base64_lines_size()
+ * characters.  Returns the number of characters stored.
+ */
+size_t	__archive_base64_encode_lines(char *out, const unsigned char *in,
+	    size_t len, size_t line_bytes, int alphabet);
+size_t	__archive_base64_lines_size(size_t len, size_t line_bytes);
+
+/*
+ * Decode complete groups of four characters from the len characters
+ * at in, stopping before the first group that holds a character
+ * outside the alphabet (or padding).  Returns the number of
+ * characters consumed; three bytes are stored at out for each four.
+ */
+size_t	__archive_base64_decode(unsigned char *out, const unsigned char *in,
+	    size_t len, int alphabet);
+
+#endif /* !ARCHIVE_BASE64_PRIVATE_H_INCLUDED */
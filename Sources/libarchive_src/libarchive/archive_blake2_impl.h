@@ -158,4 +158,7 @@ static BLAKE2_INLINE void secure_zero_memory(void *v, size_t n)
   memset_v(v, 0, n);
 }
 
+/* archive_blake2sp_simd.c: all eight BLAKE2sp leaves at once, or 0. */
+int __archive_blake2sp_stripes(blake2sp_state *S, const uint8_t *in, size_t n);
+
 #endif
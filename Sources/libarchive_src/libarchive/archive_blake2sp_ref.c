@@ -137,20 +137,26 @@ int blake2sp_update( blake2sp_state *S, const void *pin, size_t inlen )
   const unsigned char * in = (const unsigned char *)pin;
   size_t left = S->buflen;
   size_t fill = sizeof( S->buf ) - left;
-  size_t i;
+  size_t i, stripes;
 
   if( left && inlen >= fill )
   {
     memcpy( S->buf + left, in, fill );
 
-    for( i = 0; i < PARALLELISM_DEGREE; ++i )
-      blake2s_update( S->S[i], S->buf + i * BLAKE2S_BLOCKBYTES, BLAKE2S_BLOCKBYTES );
+    if( !__archive_blake2sp_stripes( S, S->buf, 1 ) )
+      for( i = 0; i < PARALLELISM_DEGREE; ++i )
+        blake2s_update( S->S[i], S->buf + i * BLAKE2S_BLOCKBYTES, BLAKE2S_BLOCKBYTES );
 
     in += fill;
     inlen -= fill;
     left = 0;
   }
 
+  /* Whole stripes go to the SIMD code when there is one; else to
+     each leaf in turn. */
+  stripes = inlen / ( PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES );
+  if( stripes > 0 && !__archive_blake2sp_stripes( S, in, stripes ) )
+  {
 #if defined(_OPENMP)
   #pragma omp parallel shared(S), num_threads(PARALLELISM_DEGREE)
 #else
@@ -171,6 +177,7 @@ int blake2sp_update( blake2sp_state *S, const void *pin, size_t inlen )
       inlen__ -= PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES;
     }
   }
+  }
 
   in += inlen - inlen % ( PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES );
   inlen %= PARALLELISM_DEGREE * BLAKE2S_BLOCKBYTES;
@@ -0,0 +1,440 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "archive_platform.h"
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "archive_blake2.h"
+#include "archive_blake2_impl.h"
+#include "archive_thread_private.h"
+
+/*
+ * The eight leaves of BLAKE2sp take consecutive 64-byte blocks of the
+ * input in turn, so every 512-byte stripe holds one block for each
+ * leaf.  Here the leaves are hashed side by side, one per 32-bit SIMD
+ * lane: eight lanes with AVX2, or two passes of four with SSE2 or NEON.
+ * The state of leaf i is word i of the vectors, so the message words
+ * of each stripe are transposed on loading.
+ */
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define B2SP_SSE2	1
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))
+#include <cpuid.h>
+#include <immintrin.h>
+#define B2SP_AVX2	1
+#define AVX2_TARGET	__attribute__((target("avx2")))
+#elif defined(_M_X64) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#define B2SP_AVX2	1
+#define AVX2_TARGET
+#endif
+
+#if defined(__ARM_NEON) && defined(__BYTE_ORDER__) && \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#include <arm_neon.h>
+#define B2SP_NEON	1
+#endif
+
+#define	LEAVES		8
+#define	STRIPE		(LEAVES * BLAKE2S_BLOCKBYTES)
+
+/* Compress one stripe; h[k][i] is word k of the state of leaf i. */
+typedef void stripe_fn(uint32_t h[8][LEAVES], uint32_t t0, uint32_t t1,
+    const uint8_t *stripe);
+
+#if defined(B2SP_SSE2) || defined(B2SP_AVX2) || defined(B2SP_NEON)
+
+static const uint32_t b2s_iv[8] = {
+	0x6A09E667UL, 0xBB67AE85UL, 0x3C6EF372UL, 0xA54FF53AUL,
+	0x510E527FUL, 0x9B05688CUL, 0x1F83D9ABUL, 0x5BE0CD19UL
+};
+
+static const uint8_t b2s_sigma[10][16] = {
+	{  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+	{ 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+	{ 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 },
+	{  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 },
+	{  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 },
+	{  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 },
+	{ 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 },
+	{ 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 },
+	{  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 },
+	{ 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 },
+};
+
+/* The vector operations ADD, XOR and ROTR16/12/8/7 are defined for
+ * each instruction set below. */
+#define	G(a, b, c, d, x, y) do {					\
+	a = ADD(ADD(a, b), x);	d = ROTR16(XOR(d, a));			\
+	c = ADD(c, d);		b = ROTR12(XOR(b, c));			\
+	a = ADD(ADD(a, b), y);	d = ROTR8(XOR(d, a));			\
+	c = ADD(c, d);		b = ROTR7(XOR(b, c));			\
+} while (0)
+#define	ROUNDS() do {							\
+	int r_;								\
+	for (r_ = 0; r_ < 10; r_++) {					\
+		const uint8_t *s = b2s_sigma[r_];			\
+		G(v[0], v[4], v[8], v[12], m[s[0]], m[s[1]]);		\
+		G(v[1], v[5], v[9], v[13], m[s[2]], m[s[3]]);		\
+		G(v[2], v[6], v[10], v[14], m[s[4]], m[s[5]]);		\
+		G(v[3], v[7], v[11], v[15], m[s[6]], m[s[7]]);		\
+		G(v[0], v[5], v[10], v[15], m[s[8]], m[s[9]]);		\
+		G(v[1], v[6], v[11], v[12], m[s[10]], m[s[11]]);	\
+		G(v[2], v[7], v[8], v[13], m[s[12]], m[s[13]]);		\
+		G(v[3], v[4], v[9], v[14], m[s[14]], m[s[15]]);		\
+	}								\
+} while (0)
+
+#endif
+
+#ifdef B2SP_SSE2
+
+#define	ADD(a, b)	_mm_add_epi32(a, b)
+#define	XOR(a, b)	_mm_xor_si128(a, b)
+#define	ROTR(x, n)	_mm_or_si128(_mm_srli_epi32(x, n),		\
+			    _mm_slli_epi32(x, 32 - (n)))
+#define	ROTR16(x)	_mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xB1), 0xB1)
+#define	ROTR12(x)	ROTR(x, 12)
+#define	ROTR8(x)	ROTR(x, 8)
+#define	ROTR7(x)	ROTR(x, 7)
+
+/* Leaves first to first + 3. */
+static void
+stripe_sse2_half(uint32_t h[8][LEAVES], uint32_t t0, uint32_t t1,
+    const uint8_t *stripe, int first)
+{
+	__m128i v[16], m[16], r0, r1, r2, r3, u0, u1, u2, u3;
+	const uint8_t *p = stripe + first * BLAKE2S_BLOCKBYTES;
+	int k;
+
+	for (k = 0; k < 8; k++)
+		v[k] = _mm_loadu_si128((const __m128i *)&h[k][first]);
+	for (k = 0; k < 4; k++)
+		v[8 + k] = _mm_set1_epi32((int)b2s_iv[k]);
+	v[12] = _mm_set1_epi32((int)(t0 ^ b2s_iv[4]));
+	v[13] = _mm_set1_epi32((int)(t1 ^ b2s_iv[5]));
+	v[14] = _mm_set1_epi32((int)b2s_iv[6]);
+	v[15] = _mm_set1_epi32((int)b2s_iv[7]);
+	for (k = 0; k < 16; k += 4) {
+		r0 = _mm_loadu_si128((const __m128i *)(p + 4 * k));
+		r1 = _mm_loadu_si128((const __m128i *)(p + 64 + 4 * k));
+		r2 = _mm_loadu_si128((const __m128i *)(p + 128 + 4 * k));
+		r3 = _mm_loadu_si128((const __m128i *)(p + 192 + 4 * k));
+		u0 = _mm_unpacklo_epi32(r0, r1);
+		u1 = _mm_unpacklo_epi32(r2, r3);
+		u2 = _mm_unpackhi_epi32(r0, r1);
+		u3 = _mm_unpackhi_epi32(r2, r3);
+		m[k] = _mm_unpacklo_epi64(u0, u1);
+		m[k + 1] = _mm_unpackhi_epi64(u0, u1);
+		m[k + 2] = _mm_unpacklo_epi64(u2, u3);
+		m[k + 3] = _mm_unpackhi_epi64(u2, u3);
+	}
+	ROUNDS();
+	for (k = 0; k < 8; k++)
+		_mm_storeu_si128((__m128i *)&h[k][first],
+		    XOR(_mm_loadu_si128((const __m128i *)&h[k][first]),
+		    XOR(v[k], v[k + 8])));
+}
+
+static void
+stripe_sse2(uint32_t h[8][LEAVES], uint32_t t0, uint32_t t1,
+    const uint8_t *stripe)
+{
+	stripe_sse2_half(h, t0, t1, stripe, 0);
+	stripe_sse2_half(h, t0, t1, stripe, 4);
+}
+
+#undef ADD
+#undef XOR
+#undef ROTR
+#undef ROTR16
+#undef ROTR12
+#undef ROTR8
+#undef ROTR7
+
+#endif /* B2SP_SSE2 */
+
+#ifdef B2SP_AVX2
+
+static int
+avx2_available(void)
+{
+#if defined(_MSC_VER)
+	int info[4], c1;
+
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return (0);
+	__cpuid(info, 1);
+	c1 = info[2];
+	if (!((c1 >> 27) & 1) || !((c1 >> 28) & 1))
+		return (0);
+	__cpuidex(info, 7, 0);
+	return ((info[1] >> 5) & 1) && (_xgetbv(0) & 6) == 6;
+#else
+	unsigned int a, b, c, d, c1, xcr0_lo, xcr0_hi;
+
+	if (__get_cpuid_max(0, NULL) < 7)
+		return (0);
+	__cpuid(1, a, b, c1, d);
+	if (!((c1 >> 27) & 1) || !((c1 >> 28) & 1))
+		return (0);
+	__cpuid_count(7, 0, a, b, c, d);
+	if (!((b >> 5) & 1))
+		return (0);
+	__asm__ __volatile__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+	return ((xcr0_lo & 6) == 6);
+#endif
+}
+
+#define	ADD(a, b)	_mm256_add_epi32(a, b)
+#define	XOR(a, b)	_mm256_xor_si256(a, b)
+#define	ROTR(x, n)	_mm256_or_si256(_mm256_srli_epi32(x, n),	\
+			    _mm256_slli_epi32(x, 32 - (n)))
+#define	ROTR16(x)	_mm256_shuffle_epi8(x, rot16)
+#define	ROTR12(x)	ROTR(x, 12)
+#define	ROTR8(x)	_mm256_shuffle_epi8(x, rot8)
+#define	ROTR7(x)	ROTR(x, 7)
+
+AVX2_TARGET static void
+stripe_avx2(uint32_t h[8][LEAVES], uint32_t t0, uint32_t t1,
+    const uint8_t *stripe)
+{
+	const __m256i rot16 = _mm256_set_epi8(
+	    13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2,
+	    13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2);
+	const __m256i rot8 = _mm256_set_epi8(
+	    12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1,
+	    12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1);
+	__m256i v[16], m[16], r[8], u[8];
+	int i, k;
+
+	for (k = 0; k < 8; k++)
+		v[k] = _mm256_loadu_si256((const __m256i *)h[k]);
+	for (k = 0; k < 4; k++)
+		v[8 + k] = _mm256_set1_epi32((int)b2s_iv[k]);
+	v[12] = _mm256_set1_epi32((int)(t0 ^ b2s_iv[4]));
+	v[13] = _mm256_set1_epi32((int)(t1 ^ b2s_iv[5]));
+	v[14] = _mm256_set1_epi32((int)b2s_iv[6]);
+	v[15] = _mm256_set1_epi32((int)b2s_iv[7]);
+	for (k = 0; k < 16; k += 8) {
+		for (i = 0; i < 8; i++)
+			r[i] = _mm256_loadu_si256((const __m256i *)(stripe +
+			    i * BLAKE2S_BLOCKBYTES + 4 * k));
+		for (i = 0; i < 8; i += 4) {
+			__m256i a = _mm256_unpacklo_epi32(r[i], r[i + 1]);
+			__m256i b = _mm256_unpackhi_epi32(r[i], r[i + 1]);
+			__m256i c = _mm256_unpacklo_epi32(r[i + 2], r[i + 3]);
+			__m256i d = _mm256_unpackhi_epi32(r[i + 2], r[i + 3]);
+
+			u[i] = _mm256_unpacklo_epi64(a, c);
+			u[i + 1] = _mm256_unpackhi_epi64(a, c);
+			u[i + 2] = _mm256_unpacklo_epi64(b, d);
+			u[i + 3] = _mm256_unpackhi_epi64(b, d);
+		}
+		for (i = 0; i < 4; i++) {
+			m[k + i] = _mm256_permute2x128_si256(u[i], u[i + 4],
+			    0x20);
+			m[k + i + 4] = _mm256_permute2x128_si256(u[i],
+			    u[i + 4], 0x31);
+		}
+	}
+	ROUNDS();
+	for (k = 0; k < 8; k++)
+		_mm256_storeu_si256((__m256i *)h[k],
+		    XOR(_mm256_loadu_si256((const __m256i *)h[k]),
+		    XOR(v[k], v[k + 8])));
+}
+
+#undef ADD
+#undef XOR
+#undef ROTR
+#undef ROTR16
+#undef ROTR12
+#undef ROTR8
+#undef ROTR7
+
+#endif /* B2SP_AVX2 */
+
+#ifdef B2SP_NEON
+
+#define	ADD(a, b)	vaddq_u32(a, b)
+#define	XOR(a, b)	veorq_u32(a, b)
+#define	ROTR(x, n)	vsriq_n_u32(vshlq_n_u32(x, 32 - (n)), x, n)
+#define	ROTR16(x)	vreinterpretq_u32_u16(vrev32q_u16(		\
+			    vreinterpretq_u16_u32(x)))
+#define	ROTR12(x)	ROTR(x, 12)
+#define	ROTR8(x)	ROTR(x, 8)
+#define	ROTR7(x)	ROTR(x, 7)
+
+/* Leaves first to first + 3. */
+static void
+stripe_neon_half(uint32_t h[8][LEAVES], uint32_t t0, uint32_t t1,
+    const uint8_t *stripe, int first)
+{
+	uint32x4_t v[16], m[16];
+	uint32x4x2_t a, b;
+	const uint8_t *p = stripe + first * BLAKE2S_BLOCKBYTES;
+	int k;
+
+	for (k = 0; k < 8; k++)
+		v[k] = vld1q_u32(&h[k][first]);
+	for (k = 0; k < 4; k++)
+		v[8 + k] = vdupq_n_u32(b2s_iv[k]);
+	v[12] = vdupq_n_u32(t0 ^ b2s_iv[4]);
+	v[13] = vdupq_n_u32(t1 ^ b2s_iv[5]);
+	v[14] = vdupq_n_u32(b2s_iv[6]);
+	v[15] = vdupq_n_u32(b2s_iv[7]);
+	for (k = 0; k < 16; k += 4) {
+		a = vtrnq_u32(vreinterpretq_u32_u8(vld1q_u8(p + 4 * k)),
+		    vreinterpretq_u32_u8(vld1q_u8(p + 64 + 4 * k)));
+		b = vtrnq_u32(vreinterpretq_u32_u8(vld1q_u8(p + 128 + 4 * k)),
+		    vreinterpretq_u32_u8(vld1q_u8(p + 192 + 4 * k)));
+		m[k] = vcombine_u32(vget_low_u32(a.val[0]),
+		    vget_low_u32(b.val[0]));
+		m[k + 1] = vcombine_u32(vget_low_u32(a.val[1]),
+		    vget_low_u32(b.val[1]));
+		m[k + 2] = vcombine_u32(vget_high_u32(a.val[0]),
+		    vget_high_u32(b.val[0]));
+		m[k + 3] = vcombine_u32(vget_high_u32(a.val[1]),
+		    vget_high_u32(b.val[1]));
+	}
+	ROUNDS();
+	for (k = 0; k < 8; k++)
+		vst1q_u32(&h[k][first], XOR(vld1q_u32(&h[k][first]),
+		    XOR(v[k], v[k + 8])));
+}
+
+static void
+stripe_neon(uint32_t h[8][LEAVES], uint32_t t0, uint32_t t1,
+    const uint8_t *stripe)
+{
+	stripe_neon_half(h, t0, t1, stripe, 0);
+	stripe_neon_half(h, t0, t1, stripe, 4);
+}
+
+#undef ADD
+#undef XOR
+#undef ROTR
+#undef ROTR16
+#undef ROTR12
+#undef ROTR8
+#undef ROTR7
+
+#endif /* B2SP_NEON */
+
+static stripe_fn *stripe_impl;
+static archive_thread_once_t stripe_once = ARCHIVE_THREAD_ONCE_INIT;
+
+static void
+stripe_select(void)
+{
+	stripe_fn *fn = NULL;
+
+#ifdef B2SP_SSE2
+	fn = stripe_sse2;
+#endif
+#ifdef B2SP_AVX2
+	if (avx2_available())
+		fn = stripe_avx2;
+#endif
+#ifdef B2SP_NEON
+	fn = stripe_neon;
+#endif
+	stripe_impl = fn;
+}
+
+/*
+ * Feed n stripes to the leaves of S, exactly as blake2s_update() of
+ * each leaf with its 64-byte blocks would: the block a leaf holds back
+ * for its final compression is hashed once the next one arrives, and
+ * the last block of the last stripe is held back in its place.
+ * Returns 0, having done nothing, if there is no SIMD code to use or
+ * the leaves are not in step.
+ */
+int
+__archive_blake2sp_stripes(blake2sp_state *S, const uint8_t *in, size_t n)
+{
+	stripe_fn *fn;
+	uint32_t h[8][LEAVES], t0, t1;
+	uint8_t held[STRIPE];
+	const blake2s_state *L0 = S->S[0];
+	blake2s_state *L;
+	size_t i, k;
+
+	__archive_thread_once(&stripe_once, stripe_select);
+	fn = stripe_impl;
+	if (fn == NULL || n == 0)
+		return (0);
+	for (i = 0; i < LEAVES; i++) {
+		L = S->S[i];
+		if (L->buflen != L0->buflen ||
+		    (L->buflen != 0 && L->buflen != BLAKE2S_BLOCKBYTES) ||
+		    L->t[0] != L0->t[0] || L->t[1] != L0->t[1] ||
+		    L->f[0] != 0 || L->f[1] != 0)
+			return (0);
+		for (k = 0; k < 8; k++)
+			h[k][i] = L->h[k];
+	}
+	t0 = L0->t[0];
+	t1 = L0->t[1];
+#define	ADVANCE() do {							\
+	t0 += BLAKE2S_BLOCKBYTES;					\
+	t1 += (t0 < BLAKE2S_BLOCKBYTES);				\
+} while (0)
+	if (L0->buflen == BLAKE2S_BLOCKBYTES) {
+		for (i = 0; i < LEAVES; i++)
+			memcpy(held + i * BLAKE2S_BLOCKBYTES, S->S[i]->buf,
+			    BLAKE2S_BLOCKBYTES);
+		ADVANCE();
+		fn(h, t0, t1, held);
+	}
+	for (k = 0; k + 1 < n; k++) {
+		ADVANCE();
+		fn(h, t0, t1, in + k * STRIPE);
+	}
+#undef ADVANCE
+	in += (n - 1) * STRIPE;
+	for (i = 0; i < LEAVES; i++) {
+		L = S->S[i];
+		for (k = 0; k < 8; k++)
+			L->h[k] = h[k][i];
+		L->t[0] = t0;
+		L->t[1] = t1;
+		memcpy(L->buf, in + i * BLAKE2S_BLOCKBYTES, BLAKE2S_BLOCKBYTES);
+		L->buflen = BLAKE2S_BLOCKBYTES;
+	}
+	return (1);
+}
@@ -30,6 +30,7 @@
 #endif
 #include "archive.h"
 #include "archive_cryptor_private.h"
+#include "archive_sha1_private.h"
 
 /*
  * On systems that do not support any recognized crypto libraries,
@@ -139,19 +140,12 @@ pbkdf2_sha1(const char *pw, size_t pw_len, const uint8_t *salt,
 
 #else
 
-/* Stub */
 static int
 pbkdf2_sha1(const char *pw, size_t pw_len, const uint8_t *salt,
     size_t salt_len, unsigned rounds, uint8_t *derived_key,
     size_t derived_key_len) {
-	(void)pw; /* UNUSED */
-	(void)pw_len; /* UNUSED */
-	(void)salt; /* UNUSED */
-	(void)salt_len; /* UNUSED */
-	(void)rounds; /* UNUSED */
-	(void)derived_key; /* UNUSED */
-	(void)derived_key_len; /* UNUSED */
-	return CRYPTOR_STUB_FUNCTION; /* UNSUPPORTED */
+	return __archive_pbkdf2_sha1(pw, pw_len, salt, salt_len, rounds,
+	    derived_key, derived_key_len);
 }
 
 #endif
@@ -431,45 +425,60 @@ aes_ctr_release(archive_crypto_ctx *ctx)
 
 #else
 
-#define ARCHIVE_CRYPTOR_STUB
-/* Stub */
 static int
 aes_ctr_init(archive_crypto_ctx *ctx, const uint8_t *key, size_t key_len)
 {
-	(void)ctx; /* UNUSED */
-	(void)key; /* UNUSED */
-	(void)key_len; /* UNUSED */
-	return CRYPTOR_STUB_FUNCTION;
-}
-
-static int
-aes_ctr_encrypt_counter(archive_crypto_ctx *ctx)
-{
-	(void)ctx; /* UNUSED */
-	return CRYPTOR_STUB_FUNCTION;
+	if (__archive_aes_set_encrypt_key(&ctx->aes, key, key_len) != 0)
+		return -1;
+	memset(ctx->nonce, 0, sizeof(ctx->nonce));
+	ctx->encr_pos = AES_BLOCK_SIZE;
+	return 0;
 }
 
 static int
 aes_ctr_release(archive_crypto_ctx *ctx)
 {
-	(void)ctx; /* UNUSED */
+	memset(ctx, 0, sizeof(*ctx));
 	return 0;
 }
 
 #endif
 
-#ifdef ARCHIVE_CRYPTOR_STUB
+#ifdef ARCHIVE_CRYPTOR_USE_BUILTIN
+/*
+ * The built-in AES runs whole runs of counter blocks at once, which
+ * is what lets the AES-NI code keep several blocks in flight; only
+ * the partial blocks at either end go through encr_buf.
+ */
 static int
 aes_ctr_update(archive_crypto_ctx *ctx, const uint8_t * const in,
     size_t in_len, uint8_t * const out, size_t *out_len)
 {
-	(void)ctx; /* UNUSED */
-	(void)in; /* UNUSED */
-	(void)in_len; /* UNUSED */
-	(void)out; /* UNUSED */
-	(void)out_len; /* UNUSED */
-	aes_ctr_encrypt_counter(ctx); /* UNUSED */ /* Fix unused function warning */
-	return CRYPTOR_STUB_FUNCTION;
+	uint8_t *const ebuf = ctx->encr_buf;
+	unsigned pos = ctx->encr_pos;
+	size_t max = (in_len < *out_len)? in_len: *out_len;
+	size_t i = 0, blocks;
+
+	while (i < max && pos < AES_BLOCK_SIZE) {
+		out[i] = in[i] ^ ebuf[pos++];
+		i++;
+	}
+	blocks = (max - i) / AES_BLOCK_SIZE;
+	if (blocks > 0) {
+		__archive_aes_ctr_xor(&ctx->aes, ctx->nonce, in + i, out + i,
+		    blocks);
+		i += blocks * AES_BLOCK_SIZE;
+	}
+	if (i < max) {
+		memset(ebuf, 0, AES_BLOCK_SIZE);
+		__archive_aes_ctr_xor(&ctx->aes, ctx->nonce, ebuf, ebuf, 1);
+		for (pos = 0; i < max; pos++, i++)
+			out[i] = in[i] ^ ebuf[pos];
+	}
+	ctx->encr_pos = pos;
+	*out_len = i;
+
+	return 0;
 }
 
 #else
@@ -519,7 +528,7 @@ aes_ctr_update(archive_crypto_ctx *ctx, const uint8_t * const in,
 
 	return 0;
 }
-#endif /* ARCHIVE_CRYPTOR_STUB */
+#endif /* ARCHIVE_CRYPTOR_USE_BUILTIN */
 
 
 const struct archive_cryptor __archive_cryptor =
@@ -154,9 +154,18 @@ typedef struct {
 #endif
 #endif
 
+/* No crypto library; use the built-in AES and PBKDF2. */
+#include "archive_aes_private.h"
+#define	ARCHIVE_CRYPTOR_USE_BUILTIN 1
 #define AES_BLOCK_SIZE	16
 #define AES_MAX_KEY_SIZE 32
-typedef int archive_crypto_ctx;
+
+typedef struct {
+	struct archive_aes aes;
+	uint8_t		nonce[AES_BLOCK_SIZE];
+	uint8_t		encr_buf[AES_BLOCK_SIZE];
+	unsigned	encr_pos;
+} archive_crypto_ctx;
 
 #endif
 
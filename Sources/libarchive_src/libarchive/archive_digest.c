@@ -770,6 +770,30 @@ __archive_sha1final(archive_sha1_ctx *ctx, void *md)
   return (ARCHIVE_OK);
 }
 
+#elif defined(ARCHIVE_CRYPTO_SHA1_BUILTIN)
+
+static int
+__archive_sha1init(archive_sha1_ctx *ctx)
+{
+	__archive_sha1_init(ctx);
+	return (ARCHIVE_OK);
+}
+
+static int
+__archive_sha1update(archive_sha1_ctx *ctx, const void *indata,
+    size_t insize)
+{
+	__archive_sha1_update(ctx, indata, insize);
+	return (ARCHIVE_OK);
+}
+
+static int
+__archive_sha1final(archive_sha1_ctx *ctx, void *md)
+{
+	__archive_sha1_final(ctx, md);
+	return (ARCHIVE_OK);
+}
+
 #else
 
 static int
@@ -1046,6 +1070,30 @@ __archive_sha256final(archive_sha256_ctx *ctx, void *md)
   return (ARCHIVE_OK);
 }
 
+#elif defined(ARCHIVE_CRYPTO_SHA256_BUILTIN)
+
+static int
+__archive_sha256init(archive_sha256_ctx *ctx)
+{
+	__archive_sha256_init(ctx);
+	return (ARCHIVE_OK);
+}
+
+static int
+__archive_sha256update(archive_sha256_ctx *ctx, const void *indata,
+    size_t insize)
+{
+	__archive_sha256_update(ctx, indata, insize);
+	return (ARCHIVE_OK);
+}
+
+static int
+__archive_sha256final(archive_sha256_ctx *ctx, void *md)
+{
+	__archive_sha256_final(ctx, md);
+	return (ARCHIVE_OK);
+}
+
 #else
 
 static int
@@ -1614,6 +1662,7 @@ __archive_sha512final(archive_sha512_ctx *ctx, void *md)
  * 7. mbedTLS
  * 8. Nettle
  * 9. OpenSSL
+ * 10. built-in (SHA1 and SHA256 only; archive_sha1.c, archive_sha256.c)
  */
 const struct archive_digest __archive_digest =
 {
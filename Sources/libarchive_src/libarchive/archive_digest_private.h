@@ -223,6 +223,20 @@ typedef EVP_MD_CTX *archive_rmd160_ctx;
 typedef unsigned char archive_rmd160_ctx;
 #endif
 
+/*
+ * The build-time probes compile archive_digest.c on its own, without
+ * archive_sha1.c and archive_sha256.c, so they must not see the
+ * built-in SHA-1 and SHA-256 below.
+ */
+#if defined(ARCHIVE_MD5_COMPILE_TEST) ||\
+  defined(ARCHIVE_RMD160_COMPILE_TEST) ||\
+  defined(ARCHIVE_SHA1_COMPILE_TEST) ||\
+  defined(ARCHIVE_SHA256_COMPILE_TEST) ||\
+  defined(ARCHIVE_SHA384_COMPILE_TEST) ||\
+  defined(ARCHIVE_SHA512_COMPILE_TEST)
+#define ARCHIVE_CRYPTO_COMPILE_TEST 1
+#endif
+
 #if defined(ARCHIVE_CRYPTO_SHA1_LIBC)
 typedef SHA1_CTX archive_sha1_ctx;
 #elif defined(ARCHIVE_CRYPTO_SHA1_LIBMD)
@@ -239,6 +253,11 @@ typedef mbedtls_sha1_context archive_sha1_ctx;
 typedef struct sha1_ctx archive_sha1_ctx;
 #elif defined(ARCHIVE_CRYPTO_SHA1_OPENSSL)
 typedef EVP_MD_CTX *archive_sha1_ctx;
+#elif !defined(ARCHIVE_CRYPTO_COMPILE_TEST)
+/* No library provides SHA-1; use the one in archive_sha1.c. */
+#define ARCHIVE_CRYPTO_SHA1_BUILTIN 1
+#include "archive_sha1_private.h"
+typedef struct archive_sha1 archive_sha1_ctx;
 #else
 typedef unsigned char archive_sha1_ctx;
 #endif
@@ -263,6 +282,11 @@ typedef mbedtls_sha256_context archive_sha256_ctx;
 typedef struct sha256_ctx archive_sha256_ctx;
 #elif defined(ARCHIVE_CRYPTO_SHA256_OPENSSL)
 typedef EVP_MD_CTX *archive_sha256_ctx;
+#elif !defined(ARCHIVE_CRYPTO_COMPILE_TEST)
+/* No library provides SHA-256; use the one in archive_sha256.c. */
+#define ARCHIVE_CRYPTO_SHA256_BUILTIN 1
+#include "archive_sha256_private.h"
+typedef struct archive_sha256 archive_sha256_ctx;
 #else
 typedef unsigned char archive_sha256_ctx;
 #endif
@@ -349,7 +373,8 @@ typedef unsigned char archive_sha512_ctx;
   defined(ARCHIVE_CRYPTO_SHA1_MBEDTLS) ||\
   defined(ARCHIVE_CRYPTO_SHA1_NETTLE) ||\
   defined(ARCHIVE_CRYPTO_SHA1_OPENSSL) ||\
-  defined(ARCHIVE_CRYPTO_SHA1_WIN)
+  defined(ARCHIVE_CRYPTO_SHA1_WIN) ||\
+  defined(ARCHIVE_CRYPTO_SHA1_BUILTIN)
 #define ARCHIVE_HAS_SHA1
 #endif
 #define archive_sha1_init(ctx)\
@@ -367,7 +392,8 @@ typedef unsigned char archive_sha512_ctx;
   defined(ARCHIVE_CRYPTO_SHA256_MBEDTLS) ||\
   defined(ARCHIVE_CRYPTO_SHA256_NETTLE) ||\
   defined(ARCHIVE_CRYPTO_SHA256_OPENSSL) ||\
-  defined(ARCHIVE_CRYPTO_SHA256_WIN)
+  defined(ARCHIVE_CRYPTO_SHA256_WIN) ||\
+  defined(ARCHIVE_CRYPTO_SHA256_BUILTIN)
 #define ARCHIVE_HAS_SHA256
 #endif
 #define archive_sha256_init(ctx)\
@@ -296,37 +296,57 @@ __hmac_sha1_cleanup(archive_hmac_sha1_ctx *ctx)
 
 #else
 
-/* Stub */
 static int
 __hmac_sha1_init(archive_hmac_sha1_ctx *ctx, const uint8_t *key, size_t key_len)
 {
-	(void)ctx;/* UNUSED */
-	(void)key;/* UNUSED */
-	(void)key_len;/* UNUSED */
-	return -1;
+	uint8_t k[64], pad[64];
+	int i;
+
+	memset(k, 0, sizeof(k));
+	if (key_len > sizeof(k)) {
+		__archive_sha1_init(&ctx->inner);
+		__archive_sha1_update(&ctx->inner, key, key_len);
+		__archive_sha1_final(&ctx->inner, k);
+	} else
+		memcpy(k, key, key_len);
+	for (i = 0; i < 64; i++)
+		pad[i] = k[i] ^ 0x36;
+	__archive_sha1_init(&ctx->inner);
+	__archive_sha1_update(&ctx->inner, pad, sizeof(pad));
+	for (i = 0; i < 64; i++)
+		pad[i] = k[i] ^ 0x5c;
+	__archive_sha1_init(&ctx->outer);
+	__archive_sha1_update(&ctx->outer, pad, sizeof(pad));
+	memset(k, 0, sizeof(k));
+	memset(pad, 0, sizeof(pad));
+	return 0;
 }
 
 static void
 __hmac_sha1_update(archive_hmac_sha1_ctx *ctx, const uint8_t *data,
     size_t data_len)
 {
-	(void)ctx;/* UNUSED */
-	(void)data;/* UNUSED */
-	(void)data_len;/* UNUSED */
+	__archive_sha1_update(&ctx->inner, data, data_len);
 }
 
 static void
 __hmac_sha1_final(archive_hmac_sha1_ctx *ctx, uint8_t *out, size_t *out_len)
 {
-	(void)ctx;/* UNUSED */
-	(void)out;/* UNUSED */
-	(void)out_len;/* UNUSED */
+	uint8_t md[ARCHIVE_SHA1_DIGEST_SIZE];
+
+	__archive_sha1_final(&ctx->inner, md);
+	__archive_sha1_update(&ctx->outer, md, sizeof(md));
+	__archive_sha1_final(&ctx->outer, md);
+	if (*out_len > sizeof(md))
+		*out_len = sizeof(md);
+	memcpy(out, md, *out_len);
+	memset(md, 0, sizeof(md));
 }
 
 static void
 __hmac_sha1_cleanup(archive_hmac_sha1_ctx *ctx)
 {
-	(void)ctx;/* UNUSED */
+	memset(ctx, 0, sizeof(*ctx));
 }
 
 #endif
@@ -88,8 +88,14 @@ typedef	HMAC_CTX* archive_hmac_sha1_ctx;
 #endif
 
 #else
+/* No crypto library; use the built-in SHA-1. */
+#include "archive_sha1_private.h"
+#define ARCHIVE_HMAC_USE_BUILTIN 1
 
-typedef int archive_hmac_sha1_ctx;
+typedef struct {
+	struct archive_sha1	inner;
+	struct archive_sha1	outer;
+} archive_hmac_sha1_ctx;
 
 #endif
 
@@ -0,0 +1,527 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "archive_platform.h"
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "archive_endian.h"
+#include "archive_lzo1x_private.h"
+
+/*
+ * The LZO1X stream is a series of instructions, each a literal run
+ * or a match.  The low two bits of the last offset byte of a match
+ * give the number of literals (0 to 3) that follow it; longer runs
+ * have an instruction of their own.  What an instruction byte below
+ * 16 means depends on what came before it:
+ *
+ *   0000LLLL            after a match with no literals: a run of
+ *                       L + 3 literals (L == 0: extended length)
+ *   0000DDSS DDDDDDDD   after 1 to 3 literals: a 2-byte match at
+ *                       distance D + 1, up to 1024
+ *   0000DDSS DDDDDDDD   after a longer run: a 3-byte match at
+ *                       distance D + 2049, up to 3072
+ *
+ * Instruction bytes of 16 and above are always matches:
+ *
+ *   LLLDDDSS DDDDDDDD   M2: 3 to 8 bytes, distance up to 2048
+ *   001LLLLL DDDDDDDD DDDDDDSS
+ *                       M3: distance up to 16384
+ *   0001HLLL DDDDDDDD DDDDDDSS
+ *                       M4: distance 16385 to 49151; the distance
+ *                       16384 (H and D zero) marks the end
+ *
+ * A length field of zero in a literal run, M3 or M4 is extended by
+ * a count of zero bytes, each adding 255, and a final non-zero byte.
+ * The first byte of a stream may also be 17 + L for an initial run
+ * of L literals.
+ */
+#define M2_MAX_LEN	8
+#define M2_MAX_OFFSET	0x0800
+#define M3_MAX_LEN	33
+#define M3_MAX_OFFSET	0x4000
+#define M4_MAX_LEN	9
+#define M4_MAX_OFFSET	0xbfff
+#define M3_MARKER	32
+#define M4_MARKER	16
+
+/* Hash chain search of levels 7 to 9. */
+#define CHAIN_HASH_BITS	15
+#define CHAIN_WINDOW	0x10000
+
+/*
+ * Store a run of t literals, after a match or at the start of the
+ * output.
+ */
+static unsigned char *
+store_literals(unsigned char *op, const unsigned char *out,
+    const unsigned char *ii, size_t t)
+{
+	if (t == 0)
+		return (op);
+	if (op == out && t <= 238)
+		*op++ = (unsigned char)(17 + t);
+	else if (t <= 3)
+		op[-2] |= (unsigned char)t;
+	else if (t <= 18)
+		*op++ = (unsigned char)(t - 3);
+	else {
+		size_t tt = t - 18;
+
+		*op++ = 0;
+		while (tt > 255) {
+			tt -= 255;
+			*op++ = 0;
+		}
+		*op++ = (unsigned char)tt;
+	}
+	memcpy(op, ii, t);
+	return (op + t);
+}
+
+/*
+ * Store a match of m_len bytes, at least 3 and at least 4 beyond
+ * M2_MAX_OFFSET, at distance m_off.
+ */
+static unsigned char *
+store_match(unsigned char *op, size_t m_len, size_t m_off)
+{
+	if (m_len <= M2_MAX_LEN && m_off <= M2_MAX_OFFSET) {
+		m_off -= 1;
+		*op++ = (unsigned char)(((m_len - 1) << 5) | ((m_off & 7) << 2));
+		*op++ = (unsigned char)(m_off >> 3);
+		return (op);
+	}
+	if (m_off <= M3_MAX_OFFSET) {
+		m_off -= 1;
+		if (m_len <= M3_MAX_LEN)
+			*op++ = (unsigned char)(M3_MARKER | (m_len - 2));
+		else {
+			m_len -= M3_MAX_LEN;
+			*op++ = M3_MARKER;
+			while (m_len > 255) {
+				m_len -= 255;
+				*op++ = 0;
+			}
+			*op++ = (unsigned char)m_len;
+		}
+	} else {
+		m_off -= 0x4000;
+		if (m_len <= M4_MAX_LEN)
+			*op++ = (unsigned char)(M4_MARKER |
+			    ((m_off >> 11) & 8) | (m_len - 2));
+		else {
+			m_len -= M4_MAX_LEN;
+			*op++ = (unsigned char)(M4_MARKER | ((m_off >> 11) & 8));
+			while (m_len > 255) {
+				m_len -= 255;
+				*op++ = 0;
+			}
+			*op++ = (unsigned char)m_len;
+		}
+	}
+	*op++ = (unsigned char)(m_off << 2);
+	*op++ = (unsigned char)(m_off >> 6);
+	return (op);
+}
+
+/*
+ * Length of the common prefix of p and m, at most limit bytes.
+ */
+static size_t
+match_length(const unsigned char *p, const unsigned char *m, size_t limit)
+{
+	size_t n = 0;
+
+#if defined(__GNUC__) || defined(__clang__)
+	while (n + 8 <= limit) {
+		uint64_t x = archive_le64dec(p + n) ^ archive_le64dec(m + n);
+
+		if (x != 0)
+			return (n + (__builtin_ctzll(x) >> 3));
+		n += 8;
+	}
+#endif
+	while (n < limit && p[n] == m[n])
+		n++;
+	return (n);
+}
+
+/*
+ * LZO1X-1: one dictionary probe per position, skipping ahead faster
+ * the longer no match has been found.
+ */
+static unsigned char *
+compress_fast(const unsigned char *in, size_t in_len, unsigned char *out,
+    int dict_bits, uint32_t *dict)
+{
+	const unsigned char * const in_end = in + in_len;
+	const unsigned char *ip, *ii, *m_pos;
+	unsigned char *op = out;
+	size_t m_len, m_off;
+	uint32_t dv, h;
+
+	ii = in;
+	if (in_len > 20) {
+		const unsigned char * const ip_end = in_end - 20;
+
+		memset(dict, 0, sizeof(*dict) << dict_bits);
+		ip = in + 1;
+		while (ip < ip_end) {
+			dv = archive_le32dec(ip);
+			h = (dv * 0x1824429dU) >> (32 - dict_bits);
+			m_pos = in + dict[h];
+			dict[h] = (uint32_t)(ip - in);
+			m_off = (size_t)(ip - m_pos);
+			if (dv != archive_le32dec(m_pos) ||
+			    m_off > M4_MAX_OFFSET) {
+				ip += 1 + ((ip - ii) >> 5);
+				continue;
+			}
+			op = store_literals(op, out, ii, (size_t)(ip - ii));
+			m_len = 4 + match_length(ip + 4, m_pos + 4,
+			    (size_t)(in_end - ip) - 4);
+			op = store_match(op, m_len, m_off);
+			ip += m_len;
+			ii = ip;
+		}
+	}
+	return (store_literals(op, out, ii, (size_t)(in_end - ii)));
+}
+
+static uint32_t
+chain_hash(const unsigned char *p)
+{
+	return ((((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2]) *
+	    2654435761U) >> (32 - CHAIN_HASH_BITS);
+}
+
+/*
+ * Find the longest match for pos among the positions on its hash
+ * chain, visiting at most depth of them.  Returns its length, or 0
+ * if none is worth storing.
+ */
+static size_t
+chain_find(const unsigned char *in, size_t in_len, size_t pos,
+    const uint32_t *head, const uint16_t *prev, int depth, size_t *off)
+{
+	const unsigned char *p = in + pos;
+	size_t limit = in_len - pos;
+	size_t best = 0, cand, d, len;
+
+	cand = head[chain_hash(p)];
+	if (cand == 0)
+		return (0);
+	d = pos - (cand - 1);
+	while (d <= M4_MAX_OFFSET && depth-- > 0) {
+		const unsigned char *m = p - d;
+
+		if (best < limit && m[best] == p[best]) {
+			len = match_length(p, m, limit);
+			if (len > best && (len >= 4 ||
+			    (len == 3 && d <= M2_MAX_OFFSET))) {
+				best = len;
+				*off = d;
+				if (len == limit)
+					break;
+			}
+		}
+		if (prev[(pos - d) & (CHAIN_WINDOW - 1)] == 0)
+			break;
+		d += prev[(pos - d) & (CHAIN_WINDOW - 1)];
+	}
+	return (best);
+}
+
+static void
+chain_insert(const unsigned char *in, size_t pos, uint32_t *head,
+    uint16_t *prev)
+{
+	uint32_t h = chain_hash(in + pos);
+	size_t d = 0;
+
+	if (head[h] != 0 && pos - (head[h] - 1) < CHAIN_WINDOW)
+		d = pos - (head[h] - 1);
+	prev[pos & (CHAIN_WINDOW - 1)] = (uint16_t)d;
+	head[h] = (uint32_t)(pos + 1);
+}
+
+/*
+ * Hash chain search for levels 7 to 9, taking the match at the next
+ * position instead while that one is longer.
+ */
+static unsigned char *
+compress_chain(const unsigned char *in, size_t in_len, unsigned char *out,
+    int depth, void *wrkmem)
+{
+	uint32_t *head = (uint32_t *)wrkmem;
+	uint16_t *prev = (uint16_t *)(head + ((size_t)1 << CHAIN_HASH_BITS));
+	unsigned char *op = out;
+	size_t pos = 0, lit = 0, limit, len, len2, off = 0, off2 = 0, end;
+
+	memset(head, 0, sizeof(*head) << CHAIN_HASH_BITS);
+	limit = in_len > 8 ? in_len - 8 : 0;
+	while (pos < limit) {
+		len = chain_find(in, in_len, pos, head, prev, depth, &off);
+		chain_insert(in, pos, head, prev);
+		if (len == 0) {
+			pos++;
+			continue;
+		}
+		while (pos + 1 < limit) {
+			len2 = chain_find(in, in_len, pos + 1, head, prev,
+			    depth, &off2);
+			if (len2 <= len)
+				break;
+			chain_insert(in, ++pos, head, prev);
+			len = len2;
+			off = off2;
+		}
+		op = store_literals(op, out, in + lit, pos - lit);
+		op = store_match(op, len, off);
+		end = pos + len;
+		while (++pos < end && pos < limit)
+			chain_insert(in, pos, head, prev);
+		pos = lit = end;
+	}
+	return (store_literals(op, out, in + lit, in_len - lit));
+}
+
+int
+__archive_lzo1x_compress(const unsigned char *in, size_t in_len,
+    unsigned char *out, size_t *out_len, int level, void *wrkmem)
+{
+	unsigned char *op;
+
+	if (level <= 1)
+		op = compress_fast(in, in_len, out, 15, (uint32_t *)wrkmem);
+	else if (level <= 6)
+		op = compress_fast(in, in_len, out, 14, (uint32_t *)wrkmem);
+	else
+		op = compress_chain(in, in_len, out,
+		    level == 7 ? 16 : level == 8 ? 64 : 256, wrkmem);
+	/* End of stream marker: an M4 match at distance 16384. */
+	*op++ = M4_MARKER | 1;
+	*op++ = 0;
+	*op++ = 0;
+	*out_len = (size_t)(op - out);
+	return (ARCHIVE_LZO_E_OK);
+}
+
+#define NEED_IP(x) \
+	do { if ((size_t)(ip_end - ip) < (size_t)(x)) \
+		return (ARCHIVE_LZO_E_INPUT_OVERRUN); } while (0)
+#define NEED_OP(x) \
+	do { if ((size_t)(op_end - op) < (size_t)(x)) \
+		return (ARCHIVE_LZO_E_OUTPUT_OVERRUN); } while (0)
+
+/*
+ * Read the zero bytes and final byte extending a length field and
+ * add them to *t.
+ */
+static int
+extended_length(const unsigned char **ipp, const unsigned char *ip_end,
+    size_t avail, size_t *t)
+{
+	const unsigned char *ip = *ipp;
+
+	for (;;) {
+		NEED_IP(1);
+		if (*ip != 0)
+			break;
+		ip++;
+		*t += 255;
+		/* Nothing that long fits in the output. */
+		if (*t > avail)
+			return (ARCHIVE_LZO_E_OUTPUT_OVERRUN);
+	}
+	*t += *ip++;
+	*ipp = ip;
+	return (ARCHIVE_LZO_E_OK);
+}
+
+int
+__archive_lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
+    unsigned char *out, size_t *out_len)
+{
+	const unsigned char *ip = in;
+	const unsigned char * const ip_end = in + in_len;
+	unsigned char *op = out;
+	unsigned char * const op_end = out + *out_len;
+	const unsigned char *m_pos;
+	size_t t, len, dist, next, state;
+	int r;
+
+	*out_len = 0;
+	NEED_IP(1);
+	if (*ip > 17) {
+		t = *ip++ - 17;
+		if (t >= 4)
+			goto copy_literal_run;
+		next = t;
+		goto match_next;
+	}
+
+	for (state = 0;;) {
+		NEED_IP(1);
+		t = *ip++;
+		if (t < 16) {
+			if (state == 0) {
+				/* A run of literals. */
+				if (t == 0) {
+					r = extended_length(&ip, ip_end,
+					    (size_t)(op_end - op), &t);
+					if (r != ARCHIVE_LZO_E_OK)
+						return (r);
+					t += 15;
+				}
+				t += 3;
+copy_literal_run:
+				NEED_IP(t);
+				NEED_OP(t);
+				memcpy(op, ip, t);
+				op += t;
+				ip += t;
+				state = 4;
+				continue;
+			}
+			NEED_IP(1);
+			next = t & 3;
+			dist = 1 + (t >> 2) + ((size_t)*ip++ << 2);
+			if (state == 4) {
+				dist += M2_MAX_OFFSET;
+				len = 3;
+			} else
+				len = 2;
+		} else if (t >= 64) {
+			NEED_IP(1);
+			next = t & 3;
+			dist = 1 + ((t >> 2) & 7) + ((size_t)*ip++ << 3);
+			len = (t >> 5) + 1;
+		} else if (t >= 32) {
+			len = t & 31;
+			if (len == 0) {
+				r = extended_length(&ip, ip_end,
+				    (size_t)(op_end - op), &len);
+				if (r != ARCHIVE_LZO_E_OK)
+					return (r);
+				len += 31;
+			}
+			len += 2;
+			NEED_IP(2);
+			next = archive_le16dec(ip);
+			ip += 2;
+			dist = 1 + (next >> 2);
+			next &= 3;
+		} else {
+			len = t & 7;
+			if (len == 0) {
+				r = extended_length(&ip, ip_end,
+				    (size_t)(op_end - op), &len);
+				if (r != ARCHIVE_LZO_E_OK)
+					return (r);
+				len += 7;
+			}
+			len += 2;
+			NEED_IP(2);
+			next = archive_le16dec(ip);
+			ip += 2;
+			dist = ((t & 8) << 11) + (next >> 2);
+			next &= 3;
+			if (dist == 0) {
+				/* End of stream. */
+				*out_len = (size_t)(op - out);
+				if (len != 3)
+					return (ARCHIVE_LZO_E_ERROR);
+				if (ip != ip_end)
+					return (ARCHIVE_LZO_E_INPUT_NOT_CONSUMED);
+				return (ARCHIVE_LZO_E_OK);
+			}
+			dist += 0x4000;
+		}
+
+		if (dist > (size_t)(op - out))
+			return (ARCHIVE_LZO_E_LOOKBEHIND_OVERRUN);
+		NEED_OP(len);
+		m_pos = op - dist;
+		if (dist >= 8 && (size_t)(op_end - op) >= len + 8) {
+			/* Eight bytes at a time, overrunning by up to seven
+			 * bytes that later output will replace. */
+			unsigned char *oe = op + len;
+
+			do {
+				memcpy(op, m_pos, 8);
+				op += 8;
+				m_pos += 8;
+			} while (op < oe);
+			op = oe;
+		} else if (dist >= len) {
+			memcpy(op, m_pos, len);
+			op += len;
+		} else {
+			do {
+				*op++ = *m_pos++;
+			} while (--len > 0);
+		}
+match_next:
+		/* Up to three literals given by the last instruction. */
+		state = next;
+		if (next > 0) {
+			NEED_IP(next);
+			NEED_OP(next);
+			memcpy(op, ip, next);
+			op += next;
+			ip += next;
+		}
+	}
+}
+
+#undef NEED_IP
+#undef NEED_OP
+
+uint32_t
+__archive_lzo_adler32(uint32_t adler, const void *buff, size_t len)
+{
+	const unsigned char *p = buff;
+	uint32_t s1 = adler & 0xffff, s2 = adler >> 16;
+	size_t n;
+
+	if (p == NULL)
+		return (1);
+	while (len > 0) {
+		/* 5552 is the largest n for which s2 can't overflow. */
+		n = len < 5552 ? len : 5552;
+		len -= n;
+		while (n-- > 0) {
+			s1 += *p++;
+			s2 += s1;
+		}
+		s1 %= 65521;
+		s2 %= 65521;
+	}
+	return ((s2 << 16) | s1);
+}
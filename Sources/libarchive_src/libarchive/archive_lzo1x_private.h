@@ -0,0 +1,74 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ARCHIVE_LZO1X_PRIVATE_H_INCLUDED
+#define ARCHIVE_LZO1X_PRIVATE_H_INCLUDED
+
+#ifndef __LIBARCHIVE_BUILD
+#error This header is only to be used internally to libarchive.
+#endif
+
+/*
+ * LZO1X compression and decompression for the lzop filters, so that
+ * they need neither liblzo2 nor an external lzop program.
+ */
+
+/* Return values; the same numbers liblzo2 uses. */
+#define ARCHIVE_LZO_E_OK			0
+#define ARCHIVE_LZO_E_ERROR			(-1)
+#define ARCHIVE_LZO_E_INPUT_OVERRUN		(-4)
+#define ARCHIVE_LZO_E_OUTPUT_OVERRUN		(-5)
+#define ARCHIVE_LZO_E_LOOKBEHIND_OVERRUN	(-6)
+#define ARCHIVE_LZO_E_INPUT_NOT_CONSUMED	(-8)
+
+/* Size of the work memory __archive_lzo1x_compress() needs. */
+#define ARCHIVE_LZO1X_MEM_COMPRESS		(256 * 1024)
+
+/* Largest output __archive_lzo1x_compress() can make from len bytes. */
+#define ARCHIVE_LZO1X_WORST_SIZE(len)	((len) + ((len) >> 4) + 64 + 3)
+
+/*
+ * Compress in_len bytes to out, which must have room for
+ * ARCHIVE_LZO1X_WORST_SIZE(in_len) bytes, and store the compressed
+ * size in *out_len.  Level 1 is LZO1X-1 with a 2^15 entry dictionary,
+ * levels 2 to 6 LZO1X-1 with a 2^14 entry one, and levels 7 to 9
+ * search hash chains of increasing depth for longer matches.
+ */
+int	__archive_lzo1x_compress(const unsigned char *in, size_t in_len,
+	    unsigned char *out, size_t *out_len, int level, void *wrkmem);
+
+/*
+ * Decompress in_len bytes to out, never writing more than *out_len
+ * bytes nor reading outside the input or the output already made.
+ * *out_len is set to the decompressed size.
+ */
+int	__archive_lzo1x_decompress_safe(const unsigned char *in,
+	    size_t in_len, unsigned char *out, size_t *out_len);
+
+/* Adler-32, for builds without zlib. */
+uint32_t __archive_lzo_adler32(uint32_t adler, const void *buff,
+	    size_t len);
+
+#endif /* !ARCHIVE_LZO1X_PRIVATE_H_INCLUDED */
@@ -5,9 +5,18 @@ This code is based on PPMd var.H (2001): Dmitry Shkarin : Public domain */
 #include "archive_platform.h"
 
 #include <stdlib.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 
 #include "archive_ppmd7_private.h"
 
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MADVISE) && \
+    defined(MAP_ANONYMOUS) && defined(MADV_HUGEPAGE)
+#define PPMD_HUGE_PAGES
+#define PPMD_HUGE_PAGE_SIZE	((size_t)2 * 1024 * 1024)
+#endif
+
 #ifdef PPMD_32BIT
   #define Ppmd7_GetPtr(p, ptr) (ptr)
   #define Ppmd7_GetContext(p, ptr) (ptr)
@@ -82,6 +91,73 @@ static void Ppmd7_UpdateBin(CPpmd7 *p);
 static CPpmd_See *Ppmd7_MakeEscFreq(CPpmd7 *p, unsigned numMasked,
                                     UInt32 *scale);
 
+/* ----------- Model memory ----------- */
+
+void *__archive_ppmd_alloc(size_t size, size_t *capacity)
+{
+  void *p;
+
+#ifdef PPMD_HUGE_PAGES
+  if (size >= PPMD_HUGE_PAGE_SIZE)
+  {
+    size_t len, lead;
+    char *m;
+
+    /* Over-map by one huge page so the block can be trimmed to start
+       on a huge page boundary, then hint the kernel to back it with
+       huge pages; a miss only costs TLB entries. */
+    len = (size + PPMD_HUGE_PAGE_SIZE - 1) & ~(PPMD_HUGE_PAGE_SIZE - 1);
+    m = mmap(NULL, len + PPMD_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (m != MAP_FAILED)
+    {
+      lead = (PPMD_HUGE_PAGE_SIZE -
+          ((uintptr_t)m & (PPMD_HUGE_PAGE_SIZE - 1))) &
+          (PPMD_HUGE_PAGE_SIZE - 1);
+      if (lead > 0)
+        munmap(m, lead);
+      munmap(m + lead + len, PPMD_HUGE_PAGE_SIZE - lead);
+      m += lead;
+    }
+    else
+    {
+      /* No room for the slack; take an unaligned mapping instead.
+         Every block this large must be mapped for
+         __archive_ppmd_free() to tell it apart. */
+      m = mmap(NULL, len, PROT_READ | PROT_WRITE,
+          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (m == MAP_FAILED)
+      {
+        *capacity = 0;
+        return NULL;
+      }
+    }
+    (void)madvise(m, len, MADV_HUGEPAGE);
+    *capacity = len;
+    return m;
+  }
+#endif
+  p = malloc(size);
+  *capacity = (p != NULL) ? size : 0;
+  return p;
+}
+
+void __archive_ppmd_free(void *p, size_t capacity)
+{
+  if (p == NULL)
+    return;
+#ifdef PPMD_HUGE_PAGES
+  if (capacity >= PPMD_HUGE_PAGE_SIZE)
+  {
+    munmap(p, capacity);
+    return;
+  }
+#else
+  (void)capacity; /* UNUSED */
+#endif
+  free(p);
+}
+
 /* ----------- Base ----------- */
 
 static void Ppmd7_Construct(CPpmd7 *p)
@@ -89,6 +165,7 @@ static void Ppmd7_Construct(CPpmd7 *p)
   unsigned i, k, m;
 
   p->Base = 0;
+  p->BaseSize = 0;
 
   for (i = 0, k = 0; i < PPMD_NUM_INDEXES; i++)
   {
@@ -117,35 +194,46 @@ static void Ppmd7_Construct(CPpmd7 *p)
 
 static void Ppmd7_Free(CPpmd7 *p)
 {
-  free(p->Base);
+  __archive_ppmd_free(p->Base, p->BaseSize);
   p->Size = 0;
   p->Base = 0;
+  p->BaseSize = 0;
 }
 
+/*
+ * A model that is still allocated is reused whenever it is large
+ * enough, so that a reader decoding many streams pays for the memory
+ * (and the page faults on it) only once.
+ */
 static Bool Ppmd7_Alloc(CPpmd7 *p, UInt32 size)
 {
-  if (p->Base == 0 || p->Size != size)
+  UInt32 alignOffset;
+  size_t need;
+
+  /* RestartModel() below assumes that p->Size >= UNIT_SIZE
+     (see the calculation of m->MinContext). */
+  if (size < UNIT_SIZE) {
+    return False;
+  }
+  alignOffset =
+    #ifdef PPMD_32BIT
+      (4 - size) & 3;
+    #else
+      4 - (size & 3);
+    #endif
+  need = (size_t)alignOffset + size
+    #ifndef PPMD_32BIT
+    + UNIT_SIZE
+    #endif
+    ;
+  if (p->Base == 0 || p->BaseSize < need)
   {
-    /* RestartModel() below assumes that p->Size >= UNIT_SIZE
-       (see the calculation of m->MinContext). */
-    if (size < UNIT_SIZE) {
-      return False;
-    }
     Ppmd7_Free(p);
-    p->AlignOffset =
-      #ifdef PPMD_32BIT
-        (4 - size) & 3;
-      #else
-        4 - (size & 3);
-      #endif
-    if ((p->Base = malloc(p->AlignOffset + size
-        #ifndef PPMD_32BIT
-        + UNIT_SIZE
-        #endif
-        )) == 0)
+    if ((p->Base = __archive_ppmd_alloc(need, &p->BaseSize)) == 0)
       return False;
-    p->Size = size;
   }
+  p->AlignOffset = alignOffset;
+  p->Size = size;
   return True;
 }
 
@@ -753,13 +841,13 @@ static Bool Ppmd_RangeDec_Init(CPpmd7z_RangeDec *p)
   p->Low = p->Bottom = 0;
   p->Range = 0xFFFFFFFF;
   for (i = 0; i < 4; i++)
-    p->Code = (p->Code << 8) | p->Stream->Read((void *)p->Stream);
+    p->Code = (p->Code << 8) | IByteIn_Read(p->Stream);
   return (p->Code < 0xFFFFFFFF);
 }
 
 static Bool Ppmd7z_RangeDec_Init(CPpmd7z_RangeDec *p)
 {
-  if (p->Stream->Read((void *)p->Stream) != 0)
+  if (IByteIn_Read(p->Stream) != 0)
     return False;
   return Ppmd_RangeDec_Init(p);
 }
@@ -789,7 +877,7 @@ static void Range_Normalize(CPpmd7z_RangeDec *p)
       else
         p->Range = ((uint32_t)(-(int32_t)p->Low)) & (p->Bottom - 1);
     }
-    p->Code = (p->Code << 8) | p->Stream->Read((void *)p->Stream);
+    p->Code = (p->Code << 8) | IByteIn_Read(p->Stream);
     p->Range <<= 8;
     p->Low <<= 8;
   }
@@ -52,6 +52,7 @@ typedef struct
   UInt32 GlueCount;
   Byte *Base, *LoUnit, *HiUnit, *Text, *UnitsStart;
   UInt32 AlignOffset;
+  size_t BaseSize; /* bytes allocated at Base; may exceed what Size needs */
 
   Byte Indx2Units[PPMD_NUM_INDEXES];
   Byte Units2Indx[128];
@@ -66,6 +66,7 @@ void Ppmd8_Construct(CPpmd8 *p)
   unsigned i, k, m;
 
   p->Base = 0;
+  p->BaseSize = 0;
 
   for (i = 0, k = 0; i < PPMD_NUM_INDEXES; i++)
   {
@@ -91,26 +92,32 @@ void Ppmd8_Construct(CPpmd8 *p)
 
 void Ppmd8_Free(CPpmd8 *p)
 {
-  free(p->Base);
+  __archive_ppmd_free(p->Base, p->BaseSize);
   p->Size = 0;
   p->Base = 0;
+  p->BaseSize = 0;
 }
 
+/* As with Ppmd7_Alloc(), a large enough model is reused. */
 Bool Ppmd8_Alloc(CPpmd8 *p, UInt32 size)
 {
-  if (p->Base == 0 || p->Size != size)
+  UInt32 alignOffset;
+
+  alignOffset =
+    #ifdef PPMD_32BIT
+      (4 - size) & 3;
+    #else
+      4 - (size & 3);
+    #endif
+  if (p->Base == 0 || p->BaseSize < (size_t)alignOffset + size)
   {
     Ppmd8_Free(p);
-    p->AlignOffset =
-      #ifdef PPMD_32BIT
-        (4 - size) & 3;
-      #else
-        4 - (size & 3);
-      #endif
-    if ((p->Base = malloc(p->AlignOffset + size)) == 0)
+    if ((p->Base = __archive_ppmd_alloc((size_t)alignOffset + size,
+        &p->BaseSize)) == 0)
       return False;
-    p->Size = size;
   }
+  p->AlignOffset = alignOffset;
+  p->Size = size;
   return True;
 }
 
@@ -1134,7 +1141,7 @@ Bool Ppmd8_RangeDec_Init(CPpmd8 *p)
   p->Range = 0xFFFFFFFF;
   p->Code = 0;
   for (i = 0; i < 4; i++)
-    p->Code = (p->Code << 8) | p->Stream.In->Read(p->Stream.In);
+    p->Code = (p->Code << 8) | IByteIn_Read(p->Stream.In);
   return (p->Code < 0xFFFFFFFF);
 }
 
@@ -1153,7 +1160,7 @@ static void RangeDec_Decode(CPpmd8 *p, UInt32 start, UInt32 size)
   while ((p->Low ^ (p->Low + p->Range)) < kTop ||
       (p->Range < kBot && ((p->Range = (0 - p->Low) & (kBot - 1)), 1)))
   {
-    p->Code = (p->Code << 8) | p->Stream.In->Read(p->Stream.In);
+    p->Code = (p->Code << 8) | IByteIn_Read(p->Stream.In);
     p->Range <<= 8;
     p->Low <<= 8;
   }
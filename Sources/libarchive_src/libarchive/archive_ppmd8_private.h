@@ -61,6 +61,7 @@ typedef struct
   UInt32 GlueCount;
   Byte *Base, *LoUnit, *HiUnit, *Text, *UnitsStart;
   UInt32 AlignOffset;
+  size_t BaseSize; /* bytes allocated at Base; may exceed what Size needs */
   unsigned RestoreMethod;
 
   /* Range Coder */
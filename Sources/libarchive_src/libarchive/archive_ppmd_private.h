@@ -61,8 +61,14 @@ typedef struct
 {
   struct archive_read *a;
   Byte (*Read)(void *p); /* reads one byte, returns 0 in case of EOF or error */
+  /* Bytes the reader has already made available; Read() is only
+     called once Cur reaches Lim, and may refill the window. */
+  const Byte *Cur, *Lim;
 } IByteIn;
 
+#define IByteIn_Read(s) \
+    ((s)->Cur < (s)->Lim ? *(s)->Cur++ : (s)->Read((void *)(s)))
+
 typedef struct
 {
   struct archive_write *a;
@@ -148,6 +154,16 @@ typedef
   #endif
   CPpmd_Byte_Ref;
 
+/*
+ * Model memory.  Blocks of 2 MiB or more are mapped on a huge page
+ * boundary and advised for transparent huge pages where the system
+ * supports it, since the model is accessed all over at random.
+ * *capacity receives the usable size, which must be passed back to
+ * __archive_ppmd_free().
+ */
+void *__archive_ppmd_alloc(size_t size, size_t *capacity);
+void __archive_ppmd_free(void *p, size_t capacity);
+
 #define PPMD_SetAllBitsIn256Bytes(p) do {				\
 	unsigned j;							\
 	for (j = 0; j < 256 / sizeof(p[0]); j += 8) {			\
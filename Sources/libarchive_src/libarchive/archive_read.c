@@ -601,6 +601,112 @@ __archive_read_header(struct archive_read *a, struct archive_entry *entry)
 	return a->filter->vtable->read_header(a->filter, entry);
 }
 
+/*
+ * Add a pathname to the list of entries the client will read.
+ */
+int
+archive_read_add_wanted_pathname(struct archive *_a, const char *pathname)
+{
+	struct archive_read *a = (struct archive_read *)_a;
+	char *name;
+
+	archive_check_magic(_a, ARCHIVE_READ_MAGIC, ARCHIVE_STATE_NEW,
+	    "archive_read_add_wanted_pathname");
+
+	if (pathname == NULL || pathname[0] == '\0') {
+		archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
+		    "Empty pathname is unacceptable");
+		return (ARCHIVE_FAILED);
+	}
+	if (a->plan.count >= a->plan.size) {
+		size_t new_size = a->plan.size ? a->plan.size * 2 : 16;
+		char **names;
+
+		names = realloc(a->plan.names, new_size * sizeof(*names));
+		if (names == NULL) {
+			archive_set_error(&a->archive, ENOMEM,
+			    "Can't allocate wanted pathname");
+			return (ARCHIVE_FATAL);
+		}
+		a->plan.names = names;
+		a->plan.size = new_size;
+	}
+	name = strdup(pathname);
+	if (name == NULL) {
+		archive_set_error(&a->archive, ENOMEM,
+		    "Can't allocate wanted pathname");
+		return (ARCHIVE_FATAL);
+	}
+	a->plan.names[a->plan.count++] = name;
+	a->plan.sorted = 0;
+	return (ARCHIVE_OK);
+}
+
+static int
+cmp_pathname(const void *p1, const void *p2)
+{
+	return (strcmp(*(char * const *)p1, *(char * const *)p2));
+}
+
+/*
+ * Return the index of a wanted pathname, or -1.  The list is sorted
+ * and duplicates dropped on first use.
+ */
+static ssize_t
+plan_lookup(struct archive_read *a, const char *pathname)
+{
+	size_t lo, hi, i, n;
+	int c;
+
+	if (pathname == NULL)
+		return (-1);
+	if (!a->plan.sorted) {
+		qsort(a->plan.names, a->plan.count, sizeof(char *),
+		    cmp_pathname);
+		for (i = n = 0; i < a->plan.count; i++) {
+			if (n > 0 &&
+			    strcmp(a->plan.names[n - 1], a->plan.names[i]) == 0)
+				free(a->plan.names[i]);
+			else
+				a->plan.names[n++] = a->plan.names[i];
+		}
+		a->plan.count = n;
+		free(a->plan.found);
+		a->plan.found = calloc(n, 1);
+		a->plan.found_count = 0;
+		if (a->plan.found == NULL)
+			return (-1);
+		a->plan.sorted = 1;
+	}
+	lo = 0;
+	hi = a->plan.count;
+	while (lo < hi) {
+		i = lo + (hi - lo) / 2;
+		c = strcmp(pathname, a->plan.names[i]);
+		if (c == 0)
+			return ((ssize_t)i);
+		if (c < 0)
+			hi = i;
+		else
+			lo = i + 1;
+	}
+	return (-1);
+}
+
+int
+__archive_read_plan_active(struct archive_read *a)
+{
+	return (a->plan.count > 0);
+}
+
+int
+__archive_read_plan_wanted(struct archive_read *a, const char *pathname)
+{
+	if (a->plan.count == 0)
+		return (1);
+	return (plan_lookup(a, pathname) >= 0);
+}
+
 /*
  * Read header of next entry.
  */
@@ -609,6 +715,7 @@ _archive_read_next_header2(struct archive *_a, struct archive_entry *entry)
 {
 	struct archive_read *a = (struct archive_read *)_a;
 	int r1 = ARCHIVE_OK, r2;
+	ssize_t idx;
 
 	archive_check_magic(_a, ARCHIVE_READ_MAGIC,
 	    ARCHIVE_STATE_HEADER | ARCHIVE_STATE_DATA,
@@ -632,11 +739,45 @@ _archive_read_next_header2(struct archive *_a, struct archive_entry *entry)
 		}
 	}
 
-	/* Record start-of-header offset in uncompressed stream. */
-	a->header_position = a->filter->position;
+	for (;;) {
+		/* Every wanted entry has been returned. */
+		if (a->plan.count > 0 && a->plan.sorted &&
+		    a->plan.found_count == a->plan.count) {
+			a->archive.state = ARCHIVE_STATE_EOF;
+			return (ARCHIVE_EOF);
+		}
 
-	++_a->file_count;
-	r2 = (a->format->read_header)(a, entry);
+		/* Record start-of-header offset in uncompressed stream. */
+		a->header_position = a->filter->position;
+
+		++_a->file_count;
+		r2 = (a->format->read_header)(a, entry);
+		if (a->plan.count == 0 ||
+		    (r2 != ARCHIVE_OK && r2 != ARCHIVE_WARN))
+			break;
+		idx = plan_lookup(a, archive_entry_pathname(entry));
+		if (idx >= 0 && !a->plan.found[idx]) {
+			a->plan.found[idx] = 1;
+			a->plan.found_count++;
+			break;
+		}
+		if (a->plan.found == NULL) {
+			archive_set_error(&a->archive, ENOMEM,
+			    "Can't allocate wanted pathname");
+			r2 = ARCHIVE_FATAL;
+			break;
+		}
+
+		/* Not wanted: skip it without handing it to the client. */
+		--_a->file_count;
+		a->archive.state = ARCHIVE_STATE_DATA;
+		__archive_reset_read_data(&a->archive);
+		r2 = archive_read_data_skip(&a->archive);
+		if (r2 == ARCHIVE_FATAL)
+			break;
+		archive_entry_clear(entry);
+		archive_clear_error(&a->archive);
+	}
 
 	/*
 	 * EOF and FATAL are persistent at this layer.  By
@@ -1113,6 +1254,12 @@ _archive_read_free(struct archive *_a)
 		p = np;
 	}
 
+	/* Release the list of wanted entries. */
+	for (i = 0; i < (int)a->plan.count; i++)
+		free(a->plan.names[i]);
+	free(a->plan.names);
+	free(a->plan.found);
+
 	archive_string_free(&a->archive.error_string);
 	archive_entry_free(a->entry);
 	a->archive.magic = 0;
@@ -1487,6 +1634,32 @@ __archive_read_filter_ahead(struct archive_read_filter *filter,
 	}
 }
 
+/*
+ * Find the first complete copy of the 'len'-byte signature 'sig' in
+ * [p, end), or return NULL.  Format readers use this to hunt for
+ * record markers in look-ahead buffers.  memchr() on the first byte
+ * does the scanning (C libraries vectorize it) and the rest of the
+ * signature is compared only where that byte turns up.
+ */
+const char *
+__archive_read_find_signature(const char *p, const char *end,
+    const void *sig, size_t len)
+{
+	const char *s = (const char *)sig;
+
+	if (len == 0)
+		return (p);
+	while (p < end && (size_t)(end - p) >= len) {
+		p = memchr(p, s[0], (end - p) - len + 1);
+		if (p == NULL)
+			break;
+		if (memcmp(p + 1, s + 1, len - 1) == 0)
+			return (p);
+		p++;
+	}
+	return (NULL);
+}
+
 /*
  * Move the file pointer forward.
  */
@@ -1629,6 +1802,21 @@ __archive_read_filter_seek(struct archive_read_filter *filter, int64_t offset,
 
 	if (filter->closed || filter->fatal)
 		return (ARCHIVE_FATAL);
+	if (filter->vtable->seek != NULL) {
+		/* A decompressing filter that can reposition itself. */
+		if (whence == SEEK_CUR) {
+			offset += filter->position;
+			whence = SEEK_SET;
+		}
+		r = (filter->vtable->seek)(filter, offset, whence);
+		if (r >= 0) {
+			filter->avail = filter->client_avail = 0;
+			filter->next = filter->buffer;
+			filter->position = r;
+			filter->end_of_file = 0;
+		}
+		return r;
+	}
 	if (filter->can_seek == 0)
 		return (ARCHIVE_FAILED);
 
@@ -61,6 +61,7 @@
 #include "archive.h"
 #include "archive_private.h"
 #include "archive_string.h"
+#include "archive_thread_private.h"
 
 #ifndef O_BINARY
 #define O_BINARY 0
@@ -76,6 +77,19 @@ struct read_file_data {
 	mode_t	 st_mode;  /* Mode bits for opened file. */
 	int64_t	 size;
 	char	 use_lseek;
+	/*
+	 * While one volume of a multi-volume set is being read, a worker
+	 * opens the next one and reads its first block; the results wait
+	 * here until file_open() for that volume picks them up.
+	 */
+	struct read_file_data	*next;
+	struct archive_thread	*prefetch;
+	int	 pre_fd;
+	void	*pre_buffer;
+	size_t	 pre_block_size;
+	ssize_t	 pre_bytes;
+	/* The buffer holds a prefetched block not yet returned. */
+	char	 pending;
 	enum fnt_e { FNT_STDIN, FNT_MBS, FNT_WCS } filename_type;
 	union {
 		char	 m[1];/* MBS filename. */
@@ -113,7 +127,7 @@ int
 archive_read_open_filenames(struct archive *a, const char **filenames,
     size_t block_size)
 {
-	struct read_file_data *mine;
+	struct read_file_data *mine, *prev = NULL;
 	const char *filename = NULL;
 	if (filenames)
 		filename = *(filenames++);
@@ -130,6 +144,7 @@ archive_read_open_filenames(struct archive *a, const char **filenames,
 		strcpy(mine->filename.m, filename);
 		mine->block_size = block_size;
 		mine->fd = -1;
+		mine->pre_fd = -1;
 		mine->buffer = NULL;
 		mine->st_mode = mine->use_lseek = 0;
 		if (filename == NULL || filename[0] == '\0') {
@@ -140,6 +155,9 @@ archive_read_open_filenames(struct archive *a, const char **filenames,
 			free(mine);
 			return (ARCHIVE_FATAL);
 		}
+		if (prev != NULL)
+			prev->next = mine;
+		prev = mine;
 		if (filenames == NULL)
 			break;
 		filename = *(filenames++);
@@ -157,6 +175,202 @@ no_memory:
 	return (ARCHIVE_FATAL);
 }
 
+static int
+volume_exists(const char *name)
+{
+	struct stat st;
+
+	return (stat(name, &st) == 0);
+}
+
+/* Append "<prefix><number><suffix>" to the list of volume names. */
+static int
+volume_add(char ***names, size_t *count, size_t *alloc, const char *prefix,
+    size_t prefix_len, int width, unsigned number, const char *suffix)
+{
+	size_t size = prefix_len + strlen(suffix) + 16;
+	char *name;
+
+	if (*count + 2 > *alloc) {
+		size_t new_alloc = *alloc ? *alloc * 2 : 16;
+		char **p = realloc(*names, new_alloc * sizeof(*p));
+		if (p == NULL)
+			return (-1);
+		*names = p;
+		*alloc = new_alloc;
+	}
+	if ((name = malloc(size)) == NULL)
+		return (-1);
+	if (width > 0)
+		snprintf(name, size, "%.*s%0*u%s", (int)prefix_len, prefix,
+		    width, number, suffix);
+	else
+		snprintf(name, size, "%.*s%s", (int)prefix_len, prefix,
+		    suffix);
+	(*names)[(*count)++] = name;
+	(*names)[*count] = NULL;
+	return (0);
+}
+
+/* Add numbered volumes, from 'first' on, for as long as they exist. */
+static int
+volume_add_numbered(char ***names, size_t *count, size_t *alloc,
+    const char *prefix, size_t prefix_len, int width, unsigned first,
+    unsigned last, const char *suffix)
+{
+	unsigned n;
+
+	for (n = first; n <= last; n++) {
+		if (volume_add(names, count, alloc, prefix, prefix_len,
+		    width, n, suffix) != 0)
+			return (-1);
+		if (!volume_exists((*names)[*count - 1])) {
+			free((*names)[--(*count)]);
+			(*names)[*count] = NULL;
+			break;
+		}
+	}
+	return (0);
+}
+
+/* Compare with a lower-case ASCII string, ignoring case. */
+static int
+ascii_caseeq(const char *p, const char *lower, size_t len)
+{
+	while (len-- > 0) {
+		char c = *p++;
+		if (c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+		if (c != *lower++)
+			return (0);
+	}
+	return (1);
+}
+
+static int
+all_digits(const char *p, size_t len)
+{
+	if (len == 0)
+		return (0);
+	while (len-- > 0)
+		if (*p < '0' || *p++ > '9')
+			return (0);
+	return (1);
+}
+
+/*
+ * Open a multi-volume archive given the name of any of its volumes.
+ * The full list, in order, is worked out from the naming schemes
+ * archivers use for split archives:
+ *   NAME.partN.rar	RAR 3 and later; N counts from 1.
+ *   NAME.rar, NAME.rNN	Older RAR; .r00 follows .rar.
+ *   NAME.zNN, NAME.zip	Split ZIP; .z01 first, .zip last.
+ *   NAME.NNN		Generic split files; counts from 1 (or 0).
+ * Any other name is opened as a single file.
+ */
+int
+archive_read_open_volumes(struct archive *a, const char *filename,
+    size_t block_size)
+{
+	char **names = NULL;
+	const char **list;
+	size_t count = 0, alloc = 0, len, base_len, ext_len, i;
+	const char *ext, *p;
+	char buff[8];
+	int r;
+
+	if (filename == NULL || filename[0] == '\0')
+		return (archive_read_open_filename(a, filename, block_size));
+
+	len = strlen(filename);
+	ext = strrchr(filename, '.');
+	if (ext != NULL && (strchr(ext, '/') != NULL
+#if defined(_WIN32) && !defined(__CYGWIN__)
+	    || strchr(ext, '\\') != NULL
+#endif
+	    ))
+		ext = NULL;
+	base_len = ext != NULL ? (size_t)(ext - filename) : len;
+	ext_len = ext != NULL ? strlen(++ext) : 0;
+
+	if (ext_len == 3 && ascii_caseeq(ext, "rar", 3)) {
+		/* Look back for ".partN" before ".rar". */
+		p = filename + base_len;
+		while (p > filename && p[-1] >= '0' && p[-1] <= '9')
+			p--;
+		if (p < filename + base_len && p - filename >= 5
+		    && ascii_caseeq(p - 5, ".part", 5)) {
+			r = volume_add_numbered(&names, &count, &alloc,
+			    filename, p - filename,
+			    (int)(filename + base_len - p), 1, 999999,
+			    ext - 1);
+		} else {
+			r = volume_add(&names, &count, &alloc, filename, len,
+			    0, 0, "");
+			/* NAME.r00 and on, keeping the case of the 'r'. */
+			if (r == 0)
+				r = volume_add_numbered(&names, &count,
+				    &alloc, filename, base_len + 2, 2, 0, 99,
+				    "");
+		}
+	} else if (ext_len == 3 && (ext[0] == 'r' || ext[0] == 'R')
+	    && all_digits(ext + 1, 2)) {
+		/* A later volume of an old-style RAR set. */
+		snprintf(buff, sizeof(buff), ".%s",
+		    ext[0] == 'R' ? "RAR" : "rar");
+		r = volume_add(&names, &count, &alloc, filename, base_len,
+		    0, 0, buff);
+		if (r == 0 && volume_exists(names[0]))
+			r = volume_add_numbered(&names, &count, &alloc,
+			    filename, base_len + 2, 2, 0, 99, "");
+	} else if ((ext_len == 3 && ascii_caseeq(ext, "zip", 3))
+	    || (ext_len >= 3 && (ext[0] == 'z' || ext[0] == 'Z')
+	    && all_digits(ext + 1, ext_len - 1))) {
+		r = volume_add_numbered(&names, &count, &alloc, filename,
+		    base_len + 2, 2, 1, 999999, "");
+		/* The last part always carries the .zip name. */
+		snprintf(buff, sizeof(buff), ".%s",
+		    ext[0] == 'Z' ? "ZIP" : "zip");
+		if (r == 0)
+			r = volume_add(&names, &count, &alloc, filename,
+			    base_len, 0, 0, buff);
+	} else if (ext_len >= 3 && all_digits(ext, ext_len)) {
+		/* Most tools count from .001, a few from .000. */
+		r = volume_add(&names, &count, &alloc, filename, base_len + 1,
+		    (int)ext_len, 0, "");
+		if (r == 0) {
+			if (!volume_exists(names[0])) {
+				free(names[0]);
+				names[0] = NULL;
+				count = 0;
+			}
+			r = volume_add_numbered(&names, &count, &alloc,
+			    filename, base_len + 1, (int)ext_len, 1, 999999,
+			    "");
+		}
+	} else
+		r = 0;
+
+	if (r == 0 && count == 0)
+		/* Nothing found; open the name as given. */
+		r = volume_add(&names, &count, &alloc, filename, len, 0, 0,
+		    "");
+	if (r == 0 && (list = malloc((count + 1) * sizeof(*list))) != NULL) {
+		for (i = 0; i < count; i++)
+			list[i] = names[i];
+		list[count] = NULL;
+		r = archive_read_open_filenames(a, list, block_size);
+		free(list);
+	} else {
+		archive_set_error(a, ENOMEM, "No memory");
+		r = ARCHIVE_FATAL;
+	}
+	for (i = 0; i < count; i++)
+		free(names[i]);
+	free(names);
+	return (r);
+}
+
 /*
  * This function is an implementation detail of archive_read_open_filename_w,
  * which is exposed as a separate API on Windows.
@@ -168,7 +382,7 @@ int
 archive_read_open_filenames_w(struct archive *a, const wchar_t **wfilenames,
     size_t block_size)
 {
-	struct read_file_data *mine;
+	struct read_file_data *mine, *prev = NULL;
 	const wchar_t *wfilename = NULL;
 	if (wfilenames)
 		wfilename = *(wfilenames++);
@@ -184,6 +398,7 @@ archive_read_open_filenames_w(struct archive *a, const wchar_t **wfilenames,
 			goto no_memory;
 		mine->block_size = block_size;
 		mine->fd = -1;
+		mine->pre_fd = -1;
 
 		if (wfilename == NULL || wfilename[0] == L'\0') {
 			mine->filename_type = FNT_STDIN;
@@ -222,6 +437,9 @@ archive_read_open_filenames_w(struct archive *a, const wchar_t **wfilenames,
 			free(mine);
 			return (ARCHIVE_FATAL);
 		}
+		if (prev != NULL)
+			prev->next = mine;
+		prev = mine;
 		if (wfilenames == NULL)
 			break;
 		wfilename = *(wfilenames++);
@@ -249,6 +467,88 @@ archive_read_open_filename_w(struct archive *a, const wchar_t *wfilename,
 	return archive_read_open_filenames_w(a, wfilenames, block_size);
 }
 
+/* Disk-like devices prefer power-of-two block sizes.  */
+/* Use provided block_size as a guide so users have some control. */
+static size_t
+disk_block_size(size_t block_size)
+{
+	size_t new_block_size = 64 * 1024;
+
+	while (new_block_size < block_size
+	    && new_block_size < 64 * 1024 * 1024)
+		new_block_size *= 2;
+	return (new_block_size);
+}
+
+/*
+ * Worker body: open the next volume and read its first block so
+ * that crossing into it doesn't stall on a cold open and read.
+ * Failures are left for file_open() to repeat and report.
+ */
+static void
+prefetch_volume(void *arg)
+{
+	struct read_file_data *mine = (struct read_file_data *)arg;
+	struct stat st;
+	ssize_t bytes;
+	int fd;
+
+	fd = open(mine->filename.m, O_RDONLY | O_BINARY | O_CLOEXEC);
+	if (fd < 0)
+		return;
+	__archive_ensure_cloexec_flag(fd);
+	mine->pre_fd = fd;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+		return;
+#if defined(POSIX_FADV_WILLNEED)
+	/* Ask for the rest of the volume to be read in, too. */
+	(void)posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+	mine->pre_block_size = disk_block_size(mine->block_size);
+	mine->pre_buffer = malloc(mine->pre_block_size);
+	if (mine->pre_buffer == NULL)
+		return;
+	do {
+		bytes = read(fd, mine->pre_buffer, mine->pre_block_size);
+	} while (bytes < 0 && errno == EINTR);
+	mine->pre_bytes = bytes;
+}
+
+static void
+prefetch_start(struct read_file_data *mine)
+{
+	/* Only named files; stdin can't be opened early. */
+	if (mine == NULL || mine->filename_type != FNT_MBS
+	    || mine->fd >= 0 || mine->prefetch != NULL)
+		return;
+	mine->pre_fd = -1;
+	mine->pre_bytes = 0;
+	/* Without a thread, the volume is just opened when reached. */
+	__archive_thread_create(&mine->prefetch, prefetch_volume, mine);
+}
+
+static void
+prefetch_join(struct read_file_data *mine)
+{
+	if (mine->prefetch != NULL) {
+		__archive_thread_join(mine->prefetch);
+		mine->prefetch = NULL;
+	}
+}
+
+/*
+ * A seek or skip before the prefetched block was returned: the file
+ * offset is past that block, so go back to the start.
+ */
+static void
+prefetch_rewind(struct read_file_data *mine)
+{
+	if (mine->pending) {
+		mine->pending = 0;
+		lseek(mine->fd, 0, SEEK_SET);
+	}
+}
+
 static int
 file_open(struct archive *a, void *client_data)
 {
@@ -287,8 +587,14 @@ file_open(struct archive *a, void *client_data)
 		filename = "";
 	} else if (mine->filename_type == FNT_MBS) {
 		filename = mine->filename.m;
-		fd = open(filename, O_RDONLY | O_BINARY | O_CLOEXEC);
-		__archive_ensure_cloexec_flag(fd);
+		/* Pick up the descriptor a prefetch opened, if any. */
+		prefetch_join(mine);
+		fd = mine->pre_fd;
+		mine->pre_fd = -1;
+		if (fd < 0) {
+			fd = open(filename, O_RDONLY | O_BINARY | O_CLOEXEC);
+			__archive_ensure_cloexec_flag(fd);
+		}
 		if (fd < 0) {
 			archive_set_error(a, errno,
 			    "Failed to open '%s'", filename);
@@ -385,16 +691,20 @@ file_open(struct archive *a, void *client_data)
 #endif
 	/* TODO: Add an "is_tape_like" variable and appropriate tests. */
 
-	/* Disk-like devices prefer power-of-two block sizes.  */
-	/* Use provided block_size as a guide so users have some control. */
-	if (is_disk_like) {
-		size_t new_block_size = 64 * 1024;
-		while (new_block_size < mine->block_size
-		    && new_block_size < 64 * 1024 * 1024)
-			new_block_size *= 2;
-		mine->block_size = new_block_size;
+	if (is_disk_like)
+		mine->block_size = disk_block_size(mine->block_size);
+	if (mine->pre_buffer != NULL
+	    && mine->pre_block_size == mine->block_size) {
+		/* The first block was read ahead; hand it out first. */
+		buffer = mine->pre_buffer;
+		mine->pending = mine->pre_bytes > 0;
+	} else {
+		if (mine->pre_bytes > 0)
+			lseek(fd, 0, SEEK_SET);
+		free(mine->pre_buffer);
+		buffer = malloc(mine->block_size);
 	}
-	buffer = malloc(mine->block_size);
+	mine->pre_buffer = NULL;
 	if (buffer == NULL) {
 		archive_set_error(a, ENOMEM, "No memory");
 		goto fail;
@@ -410,6 +720,8 @@ file_open(struct archive *a, void *client_data)
 		mine->size = st.st_size;
 	}
 
+	/* Get the next volume ready while this one is read. */
+	prefetch_start(mine->next);
 	return (ARCHIVE_OK);
 fail:
 	/*
@@ -441,6 +753,10 @@ file_read(struct archive *a, void *client_data, const void **buff)
 	 * worth of data. */
 
 	*buff = mine->buffer;
+	if (mine->pending) {
+		mine->pending = 0;
+		return (mine->pre_bytes);
+	}
 	for (;;) {
 		bytes_read = read(mine->fd, mine->buffer, mine->block_size);
 		if (bytes_read < 0) {
@@ -494,6 +810,8 @@ file_skip_lseek(struct archive *a, void *client_data, int64_t request)
 
 	/* We use off_t here because lseek() is declared that way. */
 
+	prefetch_rewind(mine);
+
 	/* Reduce a request that would overflow the 'skip' variable. */
 	if (sizeof(request) > sizeof(skip)) {
 		const int64_t max_skip =
@@ -562,6 +880,8 @@ file_seek(struct archive *a, void *client_data, int64_t request, int whence)
 
 	/* We use off_t here because lseek() is declared that way. */
 
+	prefetch_rewind(mine);
+
 	/* Reduce a request that would overflow the 'seek' variable. */
 	if (sizeof(request) > sizeof(seek)) {
 		const int64_t max_seek =
@@ -596,6 +916,15 @@ file_close2(struct archive *a, void *client_data)
 
 	(void)a; /* UNUSED */
 
+	/* Drop a prefetch of this volume that was never used. */
+	prefetch_join(mine);
+	if (mine->pre_fd >= 0)
+		close(mine->pre_fd);
+	mine->pre_fd = -1;
+	free(mine->pre_buffer);
+	mine->pre_buffer = NULL;
+	mine->pending = 0;
+
 	/* Only flush and close if open succeeded. */
 	if (mine->fd >= 0) {
 		/*
@@ -46,6 +46,9 @@ struct archive_read_filter_bidder_vtable {
 	    struct archive_read_filter *);
 	/* Initialize a newly-created filter. */
 	int (*init)(struct archive_read_filter *);
+	/* Set an option for the filters created by this bidder. */
+	int (*options)(struct archive_read_filter_bidder *,
+	    const char *key, const char *value);
 	/* Release the bidder's configuration data. */
 	void (*free)(struct archive_read_filter_bidder *);
 };
@@ -80,6 +83,8 @@ struct archive_read_filter_vtable {
 	int (*close)(struct archive_read_filter *self);
 	/* Read any header metadata if available. */
 	int (*read_header)(struct archive_read_filter *self, struct archive_entry *entry);
+	/* Reposition the output stream; NULL if the filter can't. */
+	int64_t (*seek)(struct archive_read_filter *self, int64_t offset, int whence);
 };
 
 /*
@@ -224,6 +229,18 @@ struct archive_read {
 		archive_passphrase_callback *callback;
 		void *client_data;
 	}		passphrases;
+
+	/*
+	 * Entries the client intends to read.
+	 */
+	struct {
+		char		**names;
+		unsigned char	*found;
+		size_t		 count;
+		size_t		 size;
+		size_t		 found_count;
+		int		 sorted;
+	}		plan;
 };
 
 int	__archive_read_register_format(struct archive_read *a,
@@ -250,6 +267,8 @@ const void *__archive_read_filter_ahead(struct archive_read_filter *,
 int64_t	__archive_read_seek(struct archive_read*, int64_t, int);
 int64_t	__archive_read_filter_seek(struct archive_read_filter *, int64_t, int);
 int64_t	__archive_read_consume(struct archive_read *, int64_t);
+const char *__archive_read_find_signature(const char *, const char *,
+    const void *, size_t);
 int64_t	__archive_read_filter_consume(struct archive_read_filter *, int64_t);
 int __archive_read_header(struct archive_read *, struct archive_entry *);
 int __archive_read_program(struct archive_read_filter *, const char *);
@@ -262,4 +281,11 @@ struct archive_read_extract *__archive_read_get_extract(struct archive_read *);
  */
 void __archive_read_reset_passphrase(struct archive_read *a);
 const char * __archive_read_next_passphrase(struct archive_read *a);
+
+/*
+ * Whether archive_read_add_wanted_pathname() was used, and whether
+ * a given pathname was one of them.
+ */
+int __archive_read_plan_active(struct archive_read *a);
+int __archive_read_plan_wanted(struct archive_read *a, const char *);
 #endif
@@ -79,6 +79,7 @@
 #endif
 
 #include "archive.h"
+#include "archive_endian.h"
 #include "archive_private.h"
 #include "archive_read_private.h"
 
@@ -88,6 +89,14 @@
  * of course), rather than relying on an external library.  I have
  * made an effort to clarify and simplify the algorithm, so the
  * names and structure here don't exactly match those used by compress.
+ *
+ * Each dictionary entry is an earlier entry plus one byte, so the
+ * string it stands for has already been output once: it is the string
+ * of the code that was read when the entry was made, followed by the
+ * first byte of the next one.  We remember where that was and how
+ * long the string is, and copy it from there while it is still in the
+ * output block; otherwise the string is spelled out backwards from the
+ * prefix chain.
  */
 
 struct private_data {
@@ -95,13 +104,15 @@ struct private_data {
 	const unsigned char	*next_in;
 	size_t			 avail_in;
 	size_t			 consume_unnotified;
-	int			 bit_buffer;
+	uint64_t		 bit_buffer;
 	int			 bits_avail;
-	size_t			 bytes_in_section;
+	int64_t			 bits_read;	/* Bits taken from input. */
+	int64_t			 section_start;	/* Byte where it began. */
 
 	/* Output variables. */
 	size_t			 out_block_size;
 	void			*out_block;
+	int64_t			 out_total;	/* Bytes output so far. */
 
 	/* Decompression status variables. */
 	int			 use_reset_code;
@@ -111,22 +122,35 @@ struct private_data {
 	int			 section_end_code; /* When to increase bits. */
 	int			 bits;		/* Current code length. */
 	int			 oldcode;	/* Previous code. */
-	int			 finbyte;	/* Last byte of prev code. */
+	int			 finbyte;	/* First byte of prev code. */
+	int64_t			 oldpos;	/* Where prev code was output. */
 
 	/* Dictionary. */
 	int			 free_ent;       /* Next dictionary entry. */
 	unsigned char		 suffix[65536];
 	uint16_t		 prefix[65536];
+	uint16_t		 length[65536];	/* Length of the string. */
+	int64_t			 position[65536]; /* Where it was output. */
+
+	/*
+	 * Where next_code() puts its output: out_next up to out_end
+	 * in the block that starts at stream offset out_base.
+	 */
+	unsigned char		*out_start;
+	unsigned char		*out_next;
+	unsigned char		*out_end;
+	int64_t			 out_base;
 
 	/*
-	 * Scratch area for expanding dictionary entries.  Note:
-	 * "worst" case here comes from compressing /dev/zero: the
-	 * last code in the dictionary will code a sequence of
-	 * 65536-256 zero bytes.  Thus, we need stack space to expand
-	 * a 65280-byte dictionary entry.  (Of course, 32640:1
+	 * Scratch area for an expansion that doesn't fit in the output
+	 * block.  Note: "worst" case here comes from compressing
+	 * /dev/zero: the last code in the dictionary will code a
+	 * sequence of 65536-256 zero bytes.  Thus, we need space to
+	 * expand a 65280-byte dictionary entry.  (Of course, 32640:1
 	 * compression could also be considered the "best" case. ;-)
 	 */
 	unsigned char		*stackp;
+	unsigned char		*stack_end;
 	unsigned char		 stack[65300];
 };
 
@@ -138,6 +162,8 @@ static int	compress_filter_close(struct archive_read_filter *);
 
 static int	getbits(struct archive_read_filter *, int n);
 static int	next_code(struct archive_read_filter *);
+static unsigned char *decode_fast(struct private_data *, unsigned char *,
+		    unsigned char *);
 
 #if ARCHIVE_VERSION_NUMBER < 4000000
 /* Deprecated; remove in libarchive 4.0 */
@@ -251,7 +277,7 @@ compress_bidder_init(struct archive_read_filter *self)
 
 	/* Initialize decompressor. */
 	state->free_ent = 256;
-	state->stackp = state->stack;
+	state->stackp = state->stack_end = state->stack;
 	if (state->use_reset_code)
 		state->free_ent++;
 	state->bits = 9;
@@ -260,6 +286,7 @@ compress_bidder_init(struct archive_read_filter *self)
 	for (code = 255; code >= 0; code--) {
 		state->prefix[code] = 0;
 		state->suffix[code] = code;
+		state->length[code] = 1;
 	}
 	next_code(self);
 
@@ -275,6 +302,7 @@ compress_filter_read(struct archive_read_filter *self, const void **pblock)
 {
 	struct private_data *state;
 	unsigned char *p, *start, *end;
+	size_t n;
 	int ret;
 
 	state = (struct private_data *)self->data;
@@ -284,23 +312,142 @@ compress_filter_read(struct archive_read_filter *self, const void **pblock)
 	}
 	p = start = (unsigned char *)state->out_block;
 	end = start + state->out_block_size;
+	state->out_start = start;
+	state->out_end = end;
+	state->out_base = state->out_total;
+
+	/* The rest of an expansion that didn't fit last time. */
+	n = state->stack_end - state->stackp;
+	if (n > state->out_block_size)
+		n = state->out_block_size;
+	memcpy(p, state->stackp, n);
+	state->stackp += n;
+	p += n;
 
 	while (p < end && !state->end_of_stream) {
-		if (state->stackp > state->stack) {
-			*p++ = *--state->stackp;
-		} else {
-			ret = next_code(self);
-			if (ret == -1)
-				state->end_of_stream = ret;
-			else if (ret != ARCHIVE_OK)
-				return (ret);
+		p = decode_fast(state, p, end);
+		if (p >= end)
+			break;
+		state->out_next = p;
+		ret = next_code(self);
+		p = state->out_next;
+		if (ret == -1)
+			state->end_of_stream = ret;
+		else if (ret != ARCHIVE_OK)
+			return (ret);
+		if (state->stackp < state->stack_end) {
+			n = state->stack_end - state->stackp;
+			if (n > (size_t)(end - p))
+				n = end - p;
+			memcpy(p, state->stackp, n);
+			state->stackp += n;
+			p += n;
 		}
 	}
 
+	state->out_total += p - start;
 	*pblock = start;
 	return (p - start);
 }
 
+/*
+ * Expand codes into the output block for as long as no special
+ * handling is needed: there are 8 bytes of input at hand, the code is
+ * neither a reset code nor the entry being made, and its expansion
+ * fits with room to spare.  The code that stops us is left for
+ * next_code().
+ */
+static unsigned char *
+decode_fast(struct private_data *state, unsigned char *p, unsigned char *end)
+{
+	const unsigned char *start = state->out_start;
+	const unsigned char *next_in = state->next_in;
+	const unsigned char *src;
+	unsigned char *q;
+	uint64_t bit_buffer = state->bit_buffer;
+	int64_t base = state->out_base;
+	int64_t bits_read = state->bits_read;
+	size_t avail_in = state->avail_in;
+	int bits_avail = state->bits_avail;
+	int bits = state->bits;
+	int mask = (1 << bits) - 1;
+	int free_ent = state->free_ent;
+	int reset_code = state->use_reset_code ? 256 : -1;
+	int code, c, k, len;
+
+	if (state->oldcode < 0)
+		return (p);
+	for (;;) {
+		if (bits_avail < bits) {
+			if (avail_in < 8)
+				break;
+			bit_buffer |= archive_le64dec(next_in) << bits_avail;
+			k = (63 - bits_avail) >> 3;
+			next_in += k;
+			avail_in -= k;
+			bits_avail += k * 8;
+		}
+		code = (int)(bit_buffer & mask);
+		if (code >= free_ent || code == reset_code)
+			break;
+		len = state->length[code];
+		if (end - p < len + 16)
+			break;
+		bit_buffer >>= bits;
+		bits_avail -= bits;
+		bits_read += bits;
+
+		if (code < 256)
+			*p = (unsigned char)code;
+		else if (state->position[code] >= base) {
+			/* Copy it from where it was output before. */
+			src = start + (state->position[code] - base);
+			if (len <= 16 && p - src >= 16)
+				memcpy(p, src, 16);
+			else
+				memcpy(p, src, len);
+		} else {
+			q = p + len;
+			c = code;
+			while (c >= 256) {
+				*--q = state->suffix[c];
+				c = state->prefix[c];
+			}
+			*--q = c;
+		}
+
+		if (free_ent < state->maxcode) {
+			state->prefix[free_ent] = state->oldcode;
+			state->suffix[free_ent] = *p;
+			state->length[free_ent] =
+			    state->length[state->oldcode] + 1;
+			state->position[free_ent] = state->oldpos;
+			free_ent++;
+		}
+		state->oldcode = code;
+		state->oldpos = base + (p - start);
+		p += len;
+		if (free_ent > state->section_end_code) {
+			bits = ++state->bits;
+			mask = (1 << bits) - 1;
+			state->section_start = (bits_read + 7) >> 3;
+			if (bits == state->maxcode_bits)
+				state->section_end_code = state->maxcode;
+			else
+				state->section_end_code = (1 << bits) - 1;
+		}
+	}
+	if (state->oldcode >= 0 && state->oldpos >= base)
+		state->finbyte = start[state->oldpos - base];
+	state->next_in = next_in;
+	state->avail_in = avail_in;
+	state->bit_buffer = bit_buffer;
+	state->bits_avail = bits_avail;
+	state->bits_read = bits_read;
+	state->free_ent = free_ent;
+	return (p);
+}
+
 /*
  * Close and release the filter.
  */
@@ -315,28 +462,42 @@ compress_filter_close(struct archive_read_filter *self)
 }
 
 /*
- * Process the next code and fill the stack with the expansion
- * of the code.  Returns ARCHIVE_FATAL if there is a fatal I/O or
- * format error, ARCHIVE_EOF if we hit end of data, ARCHIVE_OK otherwise.
+ * Add the previous code followed by c to the dictionary.
+ */
+static void
+add_entry(struct private_data *state, int c)
+{
+	int code = state->free_ent;
+
+	if (code < state->maxcode && state->oldcode >= 0) {
+		state->prefix[code] = state->oldcode;
+		state->suffix[code] = c;
+		state->length[code] = state->length[state->oldcode] + 1;
+		state->position[code] = state->oldpos;
+		++state->free_ent;
+	}
+}
+
+/*
+ * Process the next code and write its expansion to the output block,
+ * or to the stack if it doesn't fit there.  Returns ARCHIVE_FATAL if
+ * there is a fatal I/O or format error, -1 if we hit end of data,
+ * ARCHIVE_OK otherwise.
  */
 static int
 next_code(struct archive_read_filter *self)
 {
 	struct private_data *state = (struct private_data *)self->data;
-	int code, newcode;
-
-	static int debug_buff[1024];
-	static unsigned debug_index;
+	unsigned char *dest, *q;
+	const unsigned char *src;
+	int64_t pos;
+	int code, newcode, extra, added, len, total;
 
 again:
 	code = newcode = getbits(self, state->bits);
 	if (code < 0)
 		return (code);
 
-	debug_buff[debug_index++] = code;
-	if (debug_index >= sizeof(debug_buff)/sizeof(debug_buff[0]))
-		debug_index = 0;
-
 	/* If it's a reset code, reset the dictionary. */
 	if ((code == 256) && state->use_reset_code) {
 		/*
@@ -346,17 +507,23 @@ again:
 		 * this junk.  (Yes, the number of *bytes* to skip is
 		 * a function of the current *bit* length.)
 		 */
+		int64_t bytes_in_section =
+		    ((state->bits_read + 7) >> 3) - state->section_start;
 		int skip_bytes =  state->bits -
-		    (state->bytes_in_section % state->bits);
+		    (int)(bytes_in_section % state->bits);
+		int drop = state->bits_avail & 7;
 		skip_bytes %= state->bits;
-		state->bits_avail = 0; /* Discard rest of this byte. */
+		/* Discard rest of this byte. */
+		state->bit_buffer >>= drop;
+		state->bits_avail -= drop;
+		state->bits_read += drop;
 		while (skip_bytes-- > 0) {
 			code = getbits(self, 8);
 			if (code < 0)
 				return (code);
 		}
 		/* Now, actually do the reset. */
-		state->bytes_in_section = 0;
+		state->section_start = state->bits_read >> 3;
 		state->bits = 9;
 		state->section_end_code = (1 << state->bits) - 1;
 		state->free_ent = 257;
@@ -372,29 +539,75 @@ again:
 		return (ARCHIVE_FATAL);
 	}
 
-	/* Special case for KwKwK string. */
+	/*
+	 * Special case for KwKwK string: the previous string followed
+	 * by its own first byte.  That is the entry being made now, so
+	 * make it first and then expand it like any other.
+	 */
+	extra = -1;
+	added = 0;
 	if (code >= state->free_ent) {
-		*state->stackp++ = state->finbyte;
-		code = state->oldcode;
+		if (state->free_ent < state->maxcode) {
+			add_entry(state, state->finbyte);
+			added = 1;
+		} else {
+			extra = state->finbyte;
+			code = state->oldcode;
+		}
 	}
 
-	/* Generate output characters in reverse order. */
-	while (code >= 256) {
-		*state->stackp++ = state->suffix[code];
-		code = state->prefix[code];
+	len = state->length[code];
+	total = len + (extra >= 0);
+	if (state->out_next != NULL &&
+	    total <= state->out_end - state->out_next) {
+		dest = state->out_next;
+		state->out_next += total;
+		pos = state->out_base + (dest - state->out_start);
+	} else {
+		dest = state->stack;
+		state->stackp = dest;
+		state->stack_end = dest + total;
+		pos = state->out_base;
+		if (state->out_next != NULL)
+			pos += state->out_next - state->out_start;
 	}
-	*state->stackp++ = state->finbyte = code;
 
-	/* Generate the new entry. */
-	code = state->free_ent;
-	if (code < state->maxcode && state->oldcode >= 0) {
-		state->prefix[code] = state->oldcode;
-		state->suffix[code] = state->finbyte;
-		++state->free_ent;
+	if (code >= 256 && dest != state->stack &&
+	    state->position[code] >= state->out_base) {
+		/* Copy it from where it was output before. */
+		src = state->out_start +
+		    (state->position[code] - state->out_base);
+		if (len <= 16 && dest - src >= 16 &&
+		    state->out_end - dest >= 16)
+			/* Most strings are short; copy a fixed size. */
+			memcpy(dest, src, 16);
+		else if (dest - src >= len)
+			memcpy(dest, src, len);
+		else {
+			/* KwKwK: the copy overlaps its own start. */
+			q = dest;
+			while (len-- > 0)
+				*q++ = *src++;
+		}
+	} else {
+		/* Generate output characters in reverse order. */
+		q = dest + len;
+		while (code >= 256) {
+			*--q = state->suffix[code];
+			code = state->prefix[code];
+		}
+		*--q = code;
 	}
+	if (extra >= 0)
+		dest[total - 1] = extra;
+	state->finbyte = dest[0];
+
+	/* Generate the new entry. */
+	if (!added)
+		add_entry(state, state->finbyte);
 	if (state->free_ent > state->section_end_code) {
 		state->bits++;
-		state->bytes_in_section = 0;
+		state->section_start = (state->bits_read + 7) >> 3;
 		if (state->bits == state->maxcode_bits)
 			state->section_end_code = state->maxcode;
 		else
@@ -403,6 +616,7 @@ again:
 
 	/* Remember previous code. */
 	state->oldcode = newcode;
+	state->oldpos = pos;
 	return (ARCHIVE_OK);
 }
 
@@ -415,12 +629,8 @@ static int
 getbits(struct archive_read_filter *self, int n)
 {
 	struct private_data *state = (struct private_data *)self->data;
-	int code;
+	int code, k;
 	ssize_t ret;
-	static const int mask[] = {
-		0x00, 0x01, 0x03, 0x07, 0x0f, 0x1f, 0x3f, 0x7f, 0xff,
-		0x1ff, 0x3ff, 0x7ff, 0xfff, 0x1fff, 0x3fff, 0x7fff, 0xffff
-	};
 
 	while (state->bits_avail < n) {
 		if (state->avail_in <= 0) {
@@ -438,15 +648,29 @@ getbits(struct archive_read_filter *self, int n)
 				return (ARCHIVE_FATAL);
 			state->consume_unnotified = state->avail_in = ret;
 		}
-		state->bit_buffer |= *state->next_in++ << state->bits_avail;
-		state->avail_in--;
-		state->bits_avail += 8;
-		state->bytes_in_section++;
+		if (state->avail_in >= 8) {
+			/*
+			 * Take as many whole bytes as fit.  The bits of
+			 * the next byte that come along are ORed in
+			 * again, unchanged, when it is taken.
+			 */
+			state->bit_buffer |= archive_le64dec(state->next_in)
+			    << state->bits_avail;
+			k = (63 - state->bits_avail) >> 3;
+			state->next_in += k;
+			state->avail_in -= k;
+			state->bits_avail += k * 8;
+		} else {
+			state->bit_buffer |=
+			    (uint64_t)*state->next_in++ << state->bits_avail;
+			state->avail_in--;
+			state->bits_avail += 8;
+		}
 	}
 
-	code = state->bit_buffer;
+	code = (int)(state->bit_buffer & ((1U << n) - 1));
 	state->bit_buffer >>= n;
 	state->bits_avail -= n;
-
-	return (code & mask[n]);
+	state->bits_read += n;
+	return (code);
 }
@@ -28,6 +28,7 @@
 #ifdef HAVE_ERRNO_H
 #include <errno.h>
 #endif
+#include <stdio.h>
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>
 #endif
@@ -51,6 +52,34 @@
 #include "archive_read_private.h"
 
 #ifdef HAVE_ZLIB_H
+/* Deflate can refer back at most this far. */
+#define GZIP_WINDOW_SIZE	32768
+
+/*
+ * A place in the stream where decompression can be restarted: the
+ * compressed and uncompressed offsets of a deflate block boundary,
+ * the bits of the preceding byte that belong to the next block, and
+ * the 32 KiB of output that preceded it (itself deflate-compressed,
+ * since there are many of these).  A checkpoint at the start of a
+ * gzip member needs no history at all.
+ */
+struct gzip_checkpoint {
+	int64_t		 in;
+	int64_t		 out;
+	int		 bits;
+	int		 at_member;
+	unsigned char	*window;
+	size_t		 window_size;	/* Compressed size. */
+	size_t		 window_len;	/* Uncompressed size. */
+};
+
+/* Bidder options, copied into each filter created. */
+struct gzip_bidder_options {
+	char		*index_read_path;
+	char		*index_write_path;
+	int64_t		 index_span;
+};
+
 struct private_data {
 	z_stream	 stream;
 	char		 in_stream;
@@ -61,11 +90,27 @@ struct private_data {
 	uint32_t	 mtime;
 	char		*name;
 	char		 eof; /* True = found end of compressed data. */
+
+	/* Random access (see gzip_filter_seek()). */
+	struct gzip_checkpoint *points;
+	size_t		 points_count;
+	size_t		 points_allocated;
+	int64_t		 span;
+	char		*index_write_path;
+	int		 index_build;
+	unsigned char	*window;	/* Ring of the most recent output. */
+	size_t		 window_pos;
+	size_t		 window_len;
+	unsigned char	*dict;		/* Scratch for one window. */
 };
 
 /* Gzip Filter. */
 static ssize_t	gzip_filter_read(struct archive_read_filter *, const void **);
+static int64_t	gzip_filter_seek(struct archive_read_filter *, int64_t, int);
 static int	gzip_filter_close(struct archive_read_filter *);
+static int	gzip_index_load(struct archive_read_filter *, const char *);
+static int	gzip_index_save(struct archive_read_filter *);
+static void	gzip_points_free(struct private_data *);
 #endif
 
 /*
@@ -81,6 +126,11 @@ static int	gzip_filter_close(struct archive_read_filter *);
 static int	gzip_bidder_bid(struct archive_read_filter_bidder *,
 		    struct archive_read_filter *);
 static int	gzip_bidder_init(struct archive_read_filter *);
+#ifdef HAVE_ZLIB_H
+static int	gzip_bidder_options(struct archive_read_filter_bidder *,
+		    const char *, const char *);
+static void	gzip_bidder_free(struct archive_read_filter_bidder *);
+#endif
 
 #if ARCHIVE_VERSION_NUMBER < 4000000
 /* Deprecated; remove in libarchive 4.0 */
@@ -95,16 +145,35 @@ static const struct archive_read_filter_bidder_vtable
 gzip_bidder_vtable = {
 	.bid = gzip_bidder_bid,
 	.init = gzip_bidder_init,
+#ifdef HAVE_ZLIB_H
+	.options = gzip_bidder_options,
+	.free = gzip_bidder_free,
+#endif
 };
 
 int
 archive_read_support_filter_gzip(struct archive *_a)
 {
 	struct archive_read *a = (struct archive_read *)_a;
+	void *data = NULL;
 
-	if (__archive_read_register_bidder(a, NULL, "gzip",
-				&gzip_bidder_vtable) != ARCHIVE_OK)
+#ifdef HAVE_ZLIB_H
+	struct gzip_bidder_options *options;
+
+	options = calloc(1, sizeof(*options));
+	if (options == NULL) {
+		archive_set_error(_a, ENOMEM,
+		    "Can't allocate data for gzip bidder");
+		return (ARCHIVE_FATAL);
+	}
+	options->index_span = 4 * 1024 * 1024;
+	data = options;
+#endif
+	if (__archive_read_register_bidder(a, data, "gzip",
+				&gzip_bidder_vtable) != ARCHIVE_OK) {
+		free(data);
 		return (ARCHIVE_FATAL);
+	}
 
 	/* Signal the extent of gzip support with the return value here. */
 #if HAVE_ZLIB_H
@@ -295,12 +364,67 @@ gzip_read_header(struct archive_read_filter *self, struct archive_entry *entry)
 	return (ARCHIVE_OK);
 }
 
+static int
+gzip_set_path(char **path, const char *value)
+{
+	free(*path);
+	*path = NULL;
+	if (value == NULL || value[0] == '\0')
+		return (ARCHIVE_OK);
+	*path = strdup(value);
+	return (*path == NULL ? ARCHIVE_FATAL : ARCHIVE_OK);
+}
+
+static int
+gzip_bidder_options(struct archive_read_filter_bidder *self,
+    const char *key, const char *value)
+{
+	struct gzip_bidder_options *options;
+	char *end;
+	long long span;
+
+	options = (struct gzip_bidder_options *)self->data;
+	if (strcmp(key, "checkpoint-read") == 0)
+		return (gzip_set_path(&options->index_read_path, value));
+	if (strcmp(key, "checkpoint-write") == 0)
+		return (gzip_set_path(&options->index_write_path, value));
+	if (strcmp(key, "checkpoint-span") == 0) {
+		if (value == NULL)
+			return (ARCHIVE_FAILED);
+		span = strtoll(value, &end, 10);
+		if (*end != '\0' || span < GZIP_WINDOW_SIZE)
+			return (ARCHIVE_FAILED);
+		options->index_span = span;
+		return (ARCHIVE_OK);
+	}
+
+	/* Note: The "warn" return is just to inform the options
+	 * supervisor that we didn't handle it.  It will generate
+	 * a suitable error if no one used this option. */
+	return (ARCHIVE_WARN);
+}
+
+static void
+gzip_bidder_free(struct archive_read_filter_bidder *self)
+{
+	struct gzip_bidder_options *options;
+
+	options = (struct gzip_bidder_options *)self->data;
+	if (options == NULL)
+		return;
+	free(options->index_read_path);
+	free(options->index_write_path);
+	free(options);
+	self->data = NULL;
+}
+
 static const struct archive_read_filter_vtable
 gzip_reader_vtable = {
 	.read = gzip_filter_read,
 	.close = gzip_filter_close,
 #ifdef HAVE_ZLIB_H
 	.read_header = gzip_read_header,
+	.seek = gzip_filter_seek,
 #endif
 };
 
@@ -311,6 +435,7 @@ static int
 gzip_bidder_init(struct archive_read_filter *self)
 {
 	struct private_data *state;
+	struct gzip_bidder_options *options;
 	static const size_t out_block_size = 64 * 1024;
 	void *out_block;
 
@@ -334,6 +459,23 @@ gzip_bidder_init(struct archive_read_filter *self)
 
 	state->in_stream = 0; /* We're not actually within a stream yet. */
 
+	/* Set up random access, if asked to. */
+	options = (struct gzip_bidder_options *)self->bidder->data;
+	state->span = options->index_span;
+	if (options->index_read_path != NULL)
+		return (gzip_index_load(self, options->index_read_path));
+	if (options->index_write_path != NULL) {
+		state->index_write_path = strdup(options->index_write_path);
+		state->window = malloc(GZIP_WINDOW_SIZE);
+		state->dict = malloc(GZIP_WINDOW_SIZE);
+		if (state->index_write_path == NULL || state->window == NULL
+		    || state->dict == NULL) {
+			archive_set_error(&self->archive->archive, ENOMEM,
+			    "Can't allocate data for gzip index");
+			return (ARCHIVE_FATAL);
+		}
+		state->index_build = 1;
+	}
 	return (ARCHIVE_OK);
 }
 
@@ -428,25 +570,124 @@ consume_trailer(struct archive_read_filter *self)
 	return (ARCHIVE_OK);
 }
 
+/*
+ * Remember the most recent output, so that a checkpoint can carry the
+ * history the next deflate block may refer back to.
+ */
+static void
+gzip_window_update(struct private_data *state, const unsigned char *p,
+    size_t len)
+{
+	size_t n;
+
+	if (len > GZIP_WINDOW_SIZE) {
+		p += len - GZIP_WINDOW_SIZE;
+		len = GZIP_WINDOW_SIZE;
+	}
+	while (len > 0) {
+		n = GZIP_WINDOW_SIZE - state->window_pos;
+		if (n > len)
+			n = len;
+		memcpy(state->window + state->window_pos, p, n);
+		state->window_pos = (state->window_pos + n) % GZIP_WINDOW_SIZE;
+		state->window_len += n;
+		if (state->window_len > GZIP_WINDOW_SIZE)
+			state->window_len = GZIP_WINDOW_SIZE;
+		p += n;
+		len -= n;
+	}
+}
+
+/*
+ * Record a checkpoint at the current output offset if the previous
+ * one is at least a span behind.
+ */
+static int
+gzip_add_point(struct archive_read_filter *self, int64_t in, int bits,
+    int at_member)
+{
+	struct private_data *state;
+	struct gzip_checkpoint *pt;
+	size_t n, tail;
+	uLongf size;
+
+	state = (struct private_data *)self->data;
+	if (state->points_count > 0 && state->total_out -
+	    state->points[state->points_count - 1].out < state->span)
+		return (ARCHIVE_OK);
+	if (state->points_count >= state->points_allocated) {
+		n = state->points_allocated < 16 ? 16 :
+		    state->points_allocated * 2;
+		pt = realloc(state->points, n * sizeof(*pt));
+		if (pt == NULL)
+			goto nomem;
+		state->points = pt;
+		state->points_allocated = n;
+	}
+	pt = &state->points[state->points_count];
+	memset(pt, 0, sizeof(*pt));
+	pt->in = in;
+	pt->out = state->total_out;
+	pt->bits = bits;
+	pt->at_member = at_member;
+	if (!at_member && state->window_len > 0) {
+		/* Unroll the ring, oldest byte first. */
+		n = state->window_len;
+		if (state->window_pos >= n)
+			memcpy(state->dict,
+			    state->window + state->window_pos - n, n);
+		else {
+			tail = n - state->window_pos;
+			memcpy(state->dict,
+			    state->window + GZIP_WINDOW_SIZE - tail, tail);
+			memcpy(state->dict + tail, state->window,
+			    state->window_pos);
+		}
+		size = compressBound((uLong)n);
+		pt->window = malloc(size);
+		if (pt->window == NULL)
+			goto nomem;
+		if (compress2(pt->window, &size, state->dict, (uLong)n,
+		    Z_BEST_SPEED) != Z_OK) {
+			free(pt->window);
+			goto nomem;
+		}
+		pt->window_size = size;
+		pt->window_len = n;
+	}
+	state->points_count++;
+	return (ARCHIVE_OK);
+nomem:
+	archive_set_error(&self->archive->archive, ENOMEM,
+	    "Can't allocate data for gzip index");
+	return (ARCHIVE_FATAL);
+}
+
+/*
+ * Decompress up to 'size' bytes into 'out'.  Returns the number of
+ * bytes produced; zero means the end of the compressed data.
+ */
 static ssize_t
-gzip_filter_read(struct archive_read_filter *self, const void **p)
+gzip_inflate(struct archive_read_filter *self, unsigned char *out, size_t size)
 {
 	struct private_data *state;
-	size_t decompressed;
+	const unsigned char *before;
+	size_t produced;
 	ssize_t avail_in, max_in;
+	int64_t member_start;
 	int ret;
 
 	state = (struct private_data *)self->data;
 
-	/* Empty our output buffer. */
-	state->stream.next_out = state->out_block;
-	state->stream.avail_out = (uInt)state->out_block_size;
+	state->stream.next_out = out;
+	state->stream.avail_out = (uInt)size;
 
 	/* Try to fill the output buffer. */
 	while (state->stream.avail_out > 0 && !state->eof) {
 		/* If we're not in a stream, read a header
 		 * and initialize the decompression library. */
 		if (!state->in_stream) {
+			member_start = self->upstream->position;
 			ret = consume_header(self);
 			if (ret == ARCHIVE_EOF) {
 				state->eof = 1;
@@ -454,6 +695,10 @@ gzip_filter_read(struct archive_read_filter *self, const void **p)
 			}
 			if (ret < ARCHIVE_OK)
 				return (ret);
+			if (state->index_build &&
+			    gzip_add_point(self, member_start, 0, 1)
+			    != ARCHIVE_OK)
+				return (ARCHIVE_FATAL);
 		}
 
 		/* Peek at the next available data. */
@@ -475,12 +720,25 @@ gzip_filter_read(struct archive_read_filter *self, const void **p)
 			avail_in = max_in;
 		state->stream.avail_in = (uInt)avail_in;
 
-		/* Decompress and consume some of that data. */
-		ret = inflate(&(state->stream), 0);
+		/* Decompress and consume some of that data.  While
+		 * building an index, stop at every block boundary. */
+		before = state->stream.next_out;
+		ret = inflate(&(state->stream),
+		    state->index_build ? Z_BLOCK : Z_NO_FLUSH);
+		produced = state->stream.next_out - before;
+		state->total_out += produced;
+		if (state->index_build)
+			gzip_window_update(state, before, produced);
 		switch (ret) {
 		case Z_OK: /* Decompressor made some progress. */
 			__archive_read_filter_consume(self->upstream,
 			    avail_in - state->stream.avail_in);
+			if (state->index_build &&
+			    (state->stream.data_type & 128) != 0 &&
+			    (state->stream.data_type & 64) == 0 &&
+			    gzip_add_point(self, self->upstream->position,
+				state->stream.data_type & 7, 0) != ARCHIVE_OK)
+				return (ARCHIVE_FATAL);
 			break;
 		case Z_STREAM_END: /* Found end of stream. */
 			__archive_read_filter_consume(self->upstream,
@@ -501,15 +759,317 @@ gzip_filter_read(struct archive_read_filter *self, const void **p)
 	}
 
 	/* We've read as much as we can. */
-	decompressed = state->stream.next_out - state->out_block;
-	state->total_out += decompressed;
-	if (decompressed == 0)
+	return (state->stream.next_out - out);
+}
+
+static ssize_t
+gzip_filter_read(struct archive_read_filter *self, const void **p)
+{
+	struct private_data *state;
+	ssize_t decompressed;
+
+	state = (struct private_data *)self->data;
+	decompressed = gzip_inflate(self, state->out_block,
+	    state->out_block_size);
+	if (decompressed <= 0)
 		*p = NULL;
 	else
 		*p = state->out_block;
 	return (decompressed);
 }
 
+/*
+ * Restart decompression at a checkpoint.
+ */
+static int
+gzip_restore_point(struct archive_read_filter *self,
+    const struct gzip_checkpoint *pt)
+{
+	struct private_data *state;
+	const unsigned char *b;
+	uLongf len;
+	int byte = 0;
+
+	state = (struct private_data *)self->data;
+	if (state->in_stream) {
+		inflateEnd(&(state->stream));
+		state->in_stream = 0;
+	}
+	if (__archive_read_filter_seek(self->upstream,
+	    pt->in - (pt->bits ? 1 : 0), SEEK_SET) < 0) {
+		archive_set_error(&self->archive->archive, ARCHIVE_ERRNO_MISC,
+		    "Can't seek in compressed gzip data");
+		return (ARCHIVE_FATAL);
+	}
+	state->eof = 0;
+	state->total_out = pt->out;
+	state->window_len = 0;
+	state->window_pos = 0;
+	if (pt->at_member)
+		return (ARCHIVE_OK);
+
+	if (pt->bits) {
+		b = __archive_read_filter_ahead(self->upstream, 1, NULL);
+		if (b == NULL)
+			goto truncated;
+		byte = *b;
+		__archive_read_filter_consume(self->upstream, 1);
+	}
+	state->stream.next_in = NULL;
+	state->stream.avail_in = 0;
+	if (inflateInit2(&(state->stream), -15) != Z_OK) {
+		archive_set_error(&self->archive->archive, ARCHIVE_ERRNO_MISC,
+		    "Internal error initializing compression library");
+		return (ARCHIVE_FATAL);
+	}
+	state->in_stream = 1;
+	if (pt->bits)
+		inflatePrime(&(state->stream), pt->bits,
+		    byte >> (8 - pt->bits));
+	if (pt->window_len > 0) {
+		if (state->dict == NULL &&
+		    (state->dict = malloc(GZIP_WINDOW_SIZE)) == NULL) {
+			archive_set_error(&self->archive->archive, ENOMEM,
+			    "Can't allocate data for gzip index");
+			return (ARCHIVE_FATAL);
+		}
+		len = GZIP_WINDOW_SIZE;
+		if (uncompress(state->dict, &len, pt->window,
+		    (uLong)pt->window_size) != Z_OK || len != pt->window_len)
+			goto corrupt;
+		inflateSetDictionary(&(state->stream), state->dict,
+		    (uInt)len);
+		if (state->index_build)
+			gzip_window_update(state, state->dict, len);
+	}
+	return (ARCHIVE_OK);
+truncated:
+	archive_set_error(&self->archive->archive, ARCHIVE_ERRNO_MISC,
+	    "truncated gzip input");
+	return (ARCHIVE_FATAL);
+corrupt:
+	archive_set_error(&self->archive->archive, ARCHIVE_ERRNO_MISC,
+	    "Damaged gzip index");
+	return (ARCHIVE_FATAL);
+}
+
+/*
+ * Reposition the uncompressed stream: restart from the nearest
+ * checkpoint at or before the target, then decompress and discard
+ * up to it.  Without checkpoints, gzip data can't be seeked.
+ */
+static int64_t
+gzip_filter_seek(struct archive_read_filter *self, int64_t offset, int whence)
+{
+	struct private_data *state;
+	const struct gzip_checkpoint *pt;
+	size_t lo, hi, mid;
+	ssize_t n;
+	int r;
+
+	state = (struct private_data *)self->data;
+	if (whence != SEEK_SET || state->points_count == 0)
+		return (ARCHIVE_FAILED);
+	if (offset < 0) {
+		archive_set_error(&self->archive->archive, ARCHIVE_ERRNO_MISC,
+		    "Invalid seek offset");
+		return (ARCHIVE_FAILED);
+	}
+
+	/* Find the last checkpoint at or before the target. */
+	lo = 0;
+	hi = state->points_count;
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if (state->points[mid].out <= offset)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	pt = &state->points[lo];
+	if (pt->out > offset)
+		return (ARCHIVE_FAILED);
+
+	/* No need to restart if we're already between it and the target. */
+	if (state->total_out < pt->out || state->total_out > offset) {
+		r = gzip_restore_point(self, pt);
+		if (r != ARCHIVE_OK)
+			return (r);
+	}
+	while (state->total_out < offset) {
+		n = gzip_inflate(self, state->out_block,
+		    (size_t)(offset - state->total_out) < state->out_block_size
+		    ? (size_t)(offset - state->total_out)
+		    : state->out_block_size);
+		if (n < 0)
+			return (n);
+		if (n == 0) {
+			archive_set_error(&self->archive->archive,
+			    ARCHIVE_ERRNO_MISC,
+			    "Seek past end of gzip data");
+			return (ARCHIVE_FATAL);
+		}
+	}
+	return (state->total_out);
+}
+
+static void
+gzip_points_free(struct private_data *state)
+{
+	size_t i;
+
+	for (i = 0; i < state->points_count; i++)
+		free(state->points[i].window);
+	free(state->points);
+	state->points = NULL;
+	state->points_count = state->points_allocated = 0;
+}
+
+/*
+ * Index files are little-endian:
+ *
+ *   8 bytes   magic "GZIPINDX"
+ *   4 bytes   version (1)
+ *   4 bytes   reserved (0)
+ *   8 bytes   checkpoint span
+ *   8 bytes   number of checkpoints
+ *
+ * then, for each checkpoint:
+ *
+ *   8 bytes   compressed offset
+ *   8 bytes   uncompressed offset
+ *   1 byte    bits of the preceding byte belonging to the next block
+ *   1 byte    1 if at the start of a gzip member, else 0
+ *   2 bytes   reserved (0)
+ *   4 bytes   window length
+ *   4 bytes   deflate-compressed window size
+ *   compressed window
+ */
+#define GZIP_INDEX_MAGIC	"GZIPINDX"
+#define GZIP_INDEX_VERSION	1
+#define GZIP_INDEX_HEADER_SIZE	32
+#define GZIP_INDEX_RECORD_SIZE	28
+
+static int
+gzip_index_save(struct archive_read_filter *self)
+{
+	struct private_data *state;
+	const struct gzip_checkpoint *pt;
+	unsigned char buff[GZIP_INDEX_HEADER_SIZE];
+	size_t i;
+	FILE *f;
+	int r = ARCHIVE_OK;
+
+	state = (struct private_data *)self->data;
+	f = fopen(state->index_write_path, "wb");
+	if (f == NULL) {
+		archive_set_error(&self->archive->archive, errno,
+		    "Can't create gzip index `%s'", state->index_write_path);
+		return (ARCHIVE_FATAL);
+	}
+	memcpy(buff, GZIP_INDEX_MAGIC, 8);
+	archive_le32enc(buff + 8, GZIP_INDEX_VERSION);
+	archive_le32enc(buff + 12, 0);
+	archive_le64enc(buff + 16, (uint64_t)state->span);
+	archive_le64enc(buff + 24, state->points_count);
+	if (fwrite(buff, GZIP_INDEX_HEADER_SIZE, 1, f) != 1)
+		r = ARCHIVE_FATAL;
+	for (i = 0; r == ARCHIVE_OK && i < state->points_count; i++) {
+		pt = &state->points[i];
+		archive_le64enc(buff, (uint64_t)pt->in);
+		archive_le64enc(buff + 8, (uint64_t)pt->out);
+		buff[16] = (unsigned char)pt->bits;
+		buff[17] = (unsigned char)pt->at_member;
+		buff[18] = buff[19] = 0;
+		archive_le32enc(buff + 20, (uint32_t)pt->window_len);
+		archive_le32enc(buff + 24, (uint32_t)pt->window_size);
+		if (fwrite(buff, GZIP_INDEX_RECORD_SIZE, 1, f) != 1
+		    || (pt->window_size > 0 &&
+		    fwrite(pt->window, pt->window_size, 1, f) != 1))
+			r = ARCHIVE_FATAL;
+	}
+	if (fclose(f) != 0)
+		r = ARCHIVE_FATAL;
+	if (r != ARCHIVE_OK)
+		archive_set_error(&self->archive->archive, errno,
+		    "Can't write gzip index `%s'", state->index_write_path);
+	return (r);
+}
+
+static int
+gzip_index_load(struct archive_read_filter *self, const char *path)
+{
+	struct private_data *state;
+	struct gzip_checkpoint *pt;
+	unsigned char buff[GZIP_INDEX_HEADER_SIZE];
+	uint64_t count, i;
+	FILE *f;
+
+	state = (struct private_data *)self->data;
+	f = fopen(path, "rb");
+	if (f == NULL) {
+		archive_set_error(&self->archive->archive, errno,
+		    "Can't open gzip index `%s'", path);
+		return (ARCHIVE_FATAL);
+	}
+	if (fread(buff, GZIP_INDEX_HEADER_SIZE, 1, f) != 1
+	    || memcmp(buff, GZIP_INDEX_MAGIC, 8) != 0
+	    || archive_le32dec(buff + 8) != GZIP_INDEX_VERSION)
+		goto corrupt;
+	state->span = (int64_t)archive_le64dec(buff + 16);
+	count = archive_le64dec(buff + 24);
+	for (i = 0; i < count; i++) {
+		if (fread(buff, GZIP_INDEX_RECORD_SIZE, 1, f) != 1)
+			goto corrupt;
+		if (state->points_count >= state->points_allocated) {
+			size_t n = state->points_allocated < 16 ? 16 :
+			    state->points_allocated * 2;
+			pt = realloc(state->points, n * sizeof(*pt));
+			if (pt == NULL)
+				goto nomem;
+			state->points = pt;
+			state->points_allocated = n;
+		}
+		pt = &state->points[state->points_count];
+		memset(pt, 0, sizeof(*pt));
+		pt->in = (int64_t)archive_le64dec(buff);
+		pt->out = (int64_t)archive_le64dec(buff + 8);
+		pt->bits = buff[16];
+		pt->at_member = buff[17];
+		pt->window_len = archive_le32dec(buff + 20);
+		pt->window_size = archive_le32dec(buff + 24);
+		if (pt->bits > 7 || pt->in < (pt->bits ? 1 : 0)
+		    || pt->window_len > GZIP_WINDOW_SIZE
+		    || pt->window_size > compressBound(GZIP_WINDOW_SIZE)
+		    || (state->points_count > 0 &&
+		    pt->out < state->points[state->points_count - 1].out))
+			goto corrupt;
+		if (pt->window_size > 0) {
+			pt->window = malloc(pt->window_size);
+			if (pt->window == NULL)
+				goto nomem;
+			state->points_count++;
+			if (fread(pt->window, pt->window_size, 1, f) != 1)
+				goto corrupt;
+		} else
+			state->points_count++;
+	}
+	fclose(f);
+	return (ARCHIVE_OK);
+corrupt:
+	fclose(f);
+	gzip_points_free(state);
+	archive_set_error(&self->archive->archive, ARCHIVE_ERRNO_FILE_FORMAT,
+	    "Damaged gzip index `%s'", path);
+	return (ARCHIVE_FATAL);
+nomem:
+	fclose(f);
+	gzip_points_free(state);
+	archive_set_error(&self->archive->archive, ENOMEM,
+	    "Can't allocate data for gzip index");
+	return (ARCHIVE_FATAL);
+}
+
 /*
  * Clean up the decompressor.
  */
@@ -522,6 +1082,14 @@ gzip_filter_close(struct archive_read_filter *self)
 	state = (struct private_data *)self->data;
 	ret = ARCHIVE_OK;
 
+	/*
+	 * Save the checkpoints gathered so far.  An index that stops
+	 * short of the end of the data is still good; seeks past its
+	 * last checkpoint just decompress further.
+	 */
+	if (state->index_build && gzip_index_save(self) != ARCHIVE_OK)
+		ret = ARCHIVE_FATAL;
+
 	if (state->in_stream) {
 		switch (inflateEnd(&(state->stream))) {
 		case Z_OK:
@@ -534,6 +1102,10 @@ gzip_filter_close(struct archive_read_filter *self)
 		}
 	}
 
+	gzip_points_free(state);
+	free(state->index_write_path);
+	free(state->window);
+	free(state->dict);
 	free(state->name);
 	free(state->out_block);
 	free(state);
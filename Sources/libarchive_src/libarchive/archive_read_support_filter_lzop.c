@@ -38,36 +38,26 @@
 #ifdef HAVE_STRING_H
 #include <string.h>
 #endif
-#ifdef HAVE_UNISTD_H
-#include <unistd.h>
-#endif
-#ifdef HAVE_LZO_LZOCONF_H
-#include <lzo/lzoconf.h>
-#endif
-#ifdef HAVE_LZO_LZO1X_H
-#include <lzo/lzo1x.h>
-#endif
 #ifdef HAVE_ZLIB_H
 #include <zlib.h> /* for crc32 and adler32 */
 #endif
 
 #include "archive.h"
-#if !defined(HAVE_ZLIB_H) &&\
-     defined(HAVE_LZO_LZOCONF_H) && defined(HAVE_LZO_LZO1X_H)
+#ifndef HAVE_ZLIB_H
 #include "archive_crc32.h"
 #endif
 #include "archive_endian.h"
+#include "archive_lzo1x_private.h"
 #include "archive_private.h"
 #include "archive_read_private.h"
 
 #ifndef HAVE_ZLIB_H
-#define adler32	lzo_adler32
+#define adler32	__archive_lzo_adler32
 #endif
 
 #define LZOP_HEADER_MAGIC "\x89\x4c\x5a\x4f\x00\x0d\x0a\x1a\x0a"
 #define LZOP_HEADER_MAGIC_LEN 9
 
-#if defined(HAVE_LZO_LZOCONF_H) && defined(HAVE_LZO_LZO1X_H)
 struct read_lzop {
 	unsigned char	*out_block;
 	size_t		 out_block_size;
@@ -93,7 +83,6 @@ struct read_lzop {
 
 static ssize_t  lzop_filter_read(struct archive_read_filter *, const void **);
 static int	lzop_filter_close(struct archive_read_filter *);
-#endif
 
 static int lzop_bidder_bid(struct archive_read_filter_bidder *,
     struct archive_read_filter *);
@@ -114,15 +103,7 @@ archive_read_support_filter_lzop(struct archive *_a)
 				&lzop_bidder_vtable) != ARCHIVE_OK)
 		return (ARCHIVE_FATAL);
 
-	/* Signal the extent of lzop support with the return value here. */
-#if defined(HAVE_LZO_LZOCONF_H) && defined(HAVE_LZO_LZO1X_H)
 	return (ARCHIVE_OK);
-#else
-	/* Return ARCHIVE_WARN since this always uses an external program. */
-	archive_set_error(_a, ARCHIVE_ERRNO_MISC,
-	    "Using external lzop program for lzop decompression");
-	return (ARCHIVE_WARN);
-#endif
 }
 
 /*
@@ -147,27 +128,6 @@ lzop_bidder_bid(struct archive_read_filter_bidder *self,
 	return (LZOP_HEADER_MAGIC_LEN * 8);
 }
 
-#if !defined(HAVE_LZO_LZOCONF_H) || !defined(HAVE_LZO_LZO1X_H)
-/*
- * If we don't have the library on this system, we can't do the
- * decompression directly.  We can, however, try to run "lzop -d"
- * in case that's available.
- */
-static int
-lzop_bidder_init(struct archive_read_filter *self)
-{
-	int r;
-
-	r = __archive_read_program(self, "lzop -d");
-	/* Note: We set the format here even if __archive_read_program()
-	 * above fails.  We do, after all, know what the format is
-	 * even if we weren't able to read it. */
-	self->code = ARCHIVE_FILTER_LZOP;
-	self->name = "lzop";
-	return (r);
-}
-#else
-
 static const struct archive_read_filter_vtable
 lzop_reader_vtable = {
 	.read = lzop_filter_read,
@@ -364,7 +324,7 @@ lzop_filter_read(struct archive_read_filter *self, const void **p)
 {
 	struct read_lzop *state = (struct read_lzop *)self->data;
 	const void *b;
-	lzo_uint out_size;
+	size_t out_size;
 	uint32_t cksum;
 	int ret, r;
 
@@ -442,20 +402,16 @@ lzop_filter_read(struct archive_read_filter *self, const void **p)
 	/*
 	 * Drive lzo uncompression.
 	 */
-	out_size = (lzo_uint)state->uncompressed_size;
-	r = lzo1x_decompress_safe(b, (lzo_uint)state->compressed_size,
-		state->out_block, &out_size, NULL);
+	out_size = state->uncompressed_size;
+	r = __archive_lzo1x_decompress_safe(b, state->compressed_size,
+		state->out_block, &out_size);
 	switch (r) {
-	case LZO_E_OK:
+	case ARCHIVE_LZO_E_OK:
 		if (out_size == state->uncompressed_size)
 			break;
 		archive_set_error(&self->archive->archive,
 		    ARCHIVE_ERRNO_MISC, "Corrupted data");
 		return (ARCHIVE_FATAL);
-	case LZO_E_OUT_OF_MEMORY:
-		archive_set_error(&self->archive->archive, ENOMEM,
-		    "lzop decompression failed: out of memory");
-		return (ARCHIVE_FATAL);
 	default:
 		archive_set_error(&self->archive->archive, ARCHIVE_ERRNO_MISC,
 		    "lzop decompression failed: %d", r);
@@ -494,5 +450,3 @@ lzop_filter_close(struct archive_read_filter *self)
 	free(state);
 	return (ARCHIVE_OK);
 }
-
-#endif
@@ -112,6 +112,8 @@ struct program_filter {
 	int		 exit_status;
 	pid_t		 waitpid_return;
 	int		 child_stdin, child_stdout;
+	/* Feeds child_stdin while we read child_stdout. */
+	struct archive_child_writer *writer;
 
 	char		*out_buf;
 	size_t		 out_buf_len;
@@ -226,6 +228,18 @@ program_bidder_bid(struct archive_read_filter_bidder *self,
 static int
 child_stop(struct archive_read_filter *self, struct program_filter *state)
 {
+	if (__archive_child_writer_busy(state->writer)) {
+		/* Stop reading first, so that a child blocked on its
+		 * output quits instead of waiting for more input. */
+		if (state->child_stdout != -1) {
+			close(state->child_stdout);
+			state->child_stdout = -1;
+		}
+		__archive_child_writer_finish(state->writer);
+	}
+	__archive_child_writer_free(state->writer);
+	state->writer = NULL;
+
 	/* Close our side of the I/O with the child. */
 	if (state->child_stdin != -1) {
 		close(state->child_stdin);
@@ -335,6 +349,29 @@ child_read(struct archive_read_filter *self, char *buf, size_t buf_len)
 		if (ret == -1 && errno != EAGAIN)
 			return (-1);
 
+		if (__archive_child_writer_busy(state->writer)) {
+			if (!__archive_child_writer_done(state->writer)) {
+				/* Block until the child has output or
+				 * has taken all of its input. */
+				__archive_child_writer_wait(state->writer,
+				    state->child_stdout);
+				continue;
+			}
+			ret = __archive_child_writer_finish(state->writer);
+			if (ret > 0) {
+				__archive_read_filter_consume(self->upstream,
+				    ret);
+				continue;
+			}
+			/* The child won't take any more input. */
+			close(state->child_stdin);
+			state->child_stdin = -1;
+			fcntl(state->child_stdout, F_SETFL, 0);
+			if (ret == -1 && errno != EPIPE)
+				return (-1);
+			continue;
+		}
+
 		if (state->child_stdin == -1) {
 			/* Block until child has some I/O ready. */
 			__archive_check_child(state->child_stdin,
@@ -353,6 +390,13 @@ child_read(struct archive_read_filter *self, char *buf, size_t buf_len)
 			continue;
 		}
 
+		/* Hand the data to the writer; we consume it once it
+		 * has been written. */
+		if (state->writer != NULL &&
+		    __archive_child_writer_start(state->writer, p,
+		    avail) == 0)
+			continue;
+
 		do {
 			ret = write(state->child_stdin, p, avail);
 		} while (ret == -1 && errno == EINTR);
@@ -388,7 +432,7 @@ int
 __archive_read_program(struct archive_read_filter *self, const char *cmd)
 {
 	struct program_filter	*state;
-	static const size_t out_buf_len = 65536;
+	static const size_t out_buf_len = 262144;
 	char *out_buf;
 	const char *prefix = "Program: ";
 	int ret;
@@ -429,6 +473,9 @@ __archive_read_program(struct archive_read_filter *self, const char *cmd)
 		return (ARCHIVE_FATAL);
 	}
 
+	/* If there is no writer, child_read() feeds the child itself. */
+	state->writer = __archive_child_writer_new(state->child_stdin);
+
 	self->data = state;
 	self->vtable = &program_reader_vtable;
 
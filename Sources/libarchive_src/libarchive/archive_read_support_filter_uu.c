@@ -36,6 +36,7 @@
 #endif
 
 #include "archive.h"
+#include "archive_base64_private.h"
 #include "archive_entry.h"
 #include "archive_private.h"
 #include "archive_read_private.h"
@@ -466,6 +467,7 @@ uudecode_filter_read(struct archive_read_filter *self, const void **buff)
 	ssize_t used;
 	ssize_t total;
 	ssize_t len, llen, nl, namelen;
+	size_t done;
 
 	uudecode = (struct uudecode *)self->data;
 
@@ -623,6 +625,17 @@ read_more:
 				uudecode->state = ST_UUEND;
 				break;
 			}
+			/* Decode the complete groups in bulk. */
+			done = (size_t)(l / 3 * 4);
+			if (done > (size_t)body)
+				done = (size_t)body & ~(size_t)3;
+			done = __archive_base64_decode(out, b, done,
+			    ARCHIVE_BASE64_UU);
+			b += done;
+			done = done / 4 * 3;
+			out += done;
+			total += (ssize_t)done;
+			l -= (ssize_t)done;
 			while (l > 0) {
 				int n = 0;
 
@@ -674,6 +687,14 @@ read_more:
 				uudecode->state = ST_FIND_HEAD;
 				break;
 			}
+			/* Decode the complete groups in bulk. */
+			done = __archive_base64_decode(out, b,
+			    (size_t)l & ~(size_t)3, ARCHIVE_BASE64_STD);
+			b += done;
+			l -= (ssize_t)done;
+			done = done / 4 * 3;
+			out += done;
+			total += (ssize_t)done;
 			while (l > 0) {
 				int n = 0;
 
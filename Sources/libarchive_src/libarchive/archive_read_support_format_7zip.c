@@ -53,6 +53,7 @@
 #include "archive_ppmd7_private.h"
 #include "archive_private.h"
 #include "archive_read_private.h"
+#include "archive_thread_private.h"
 #include "archive_time_private.h"
 #include "archive_endian.h"
 
@@ -307,6 +308,12 @@ struct _7zip {
 	unsigned		 pack_stream_remaining;
 	uint64_t		 pack_stream_inbytes_remaining;
 	size_t			 pack_stream_bytes_unconsumed;
+	/* Bytes of the current folder skipped but not yet decoded. */
+	uint64_t		 folder_skip;
+	/* With a read plan, which folders hold a wanted entry. */
+	unsigned char		*folder_wanted;
+	/* Set once decoding has failed; skips then decode again. */
+	int			 decode_failed;
 
 	/* The codec information of a folder. */
 	unsigned long		 codec;
@@ -388,6 +395,42 @@ struct _7zip {
 
 	/* Custom value that is non-zero if this archive contains encrypted entries. */
 	int			 has_encrypted_entries;
+
+	/*
+	 * Parallel folder decoding.
+	 */
+	int			 threads;
+	/* One slot per thread, indexed by folder number modulo threads. */
+	struct _7z_folder_job	*jobs;
+	struct archive_thread_pool *pool;
+	/* Pack and unpacked bytes held by the slots' jobs. */
+	size_t			 inflight;
+	/* Next folder whose pack streams have not been read ahead. */
+	unsigned		 prefetch_next;
+	/* Output of the current folder when it was decoded by a job. */
+	unsigned char		*folder_buff;
+	/* Pack streams held in memory; set only while a job decodes. */
+	const unsigned char	*pack_buff;
+	size_t			 pack_buff_size;
+	int64_t			 pack_buff_offset;
+};
+
+struct _7z_folder_job {
+	const struct _7z_stream_info *si;
+	struct archive_thread_task task;
+	int			 busy;
+	unsigned		 folder;
+	unsigned char		*pack;
+	size_t			 pack_size;
+	int64_t			 pack_offset;
+	unsigned char		*out;
+	size_t			 out_size;
+	int			 status;
+	int			 error_number;
+	struct archive_string	 error_string;
+	/* PPMd model kept between the folders this slot decodes. */
+	CPpmd7			 ppmd7_context;
+	int			 ppmd7_valid;
 };
 
 /* Maximum entry size. This limitation prevents reading intentional
@@ -395,19 +438,31 @@ struct _7zip {
  * the files. */
 #define UMAX_ENTRY	ARCHIVE_LITERAL_ULL(100000000)
 
+/* Largest folder, packed or unpacked, that is decoded on a worker
+ * thread; each one in flight holds both in memory. */
+#define PARALLEL_FOLDER_MAX	(64 * 1024 * 1024)
+/* Most memory the folders being read ahead may hold between them,
+ * however many threads there are. */
+#define PARALLEL_INFLIGHT_MAX	(256 * 1024 * 1024)
+/* Bytes following a folder's pack streams that are kept with them. */
+#define PACK_TAIL_SIZE		64
+
 static int	archive_read_format_7zip_has_encrypted_entries(struct archive_read *);
 static int	archive_read_support_format_7zip_capabilities(struct archive_read *a);
 static int	archive_read_format_7zip_bid(struct archive_read *, int);
 static int	archive_read_format_7zip_cleanup(struct archive_read *);
+static int	archive_read_format_7zip_options(struct archive_read *,
+		    const char *, const char *);
 static int	archive_read_format_7zip_read_data(struct archive_read *,
 		    const void **, size_t *, int64_t *);
 static int	archive_read_format_7zip_read_data_skip(struct archive_read *);
 static int	archive_read_format_7zip_read_header(struct archive_read *,
 		    struct archive_entry *);
-static int	check_7zip_header_in_sfx(const char *);
+static const char *find_7zip_header_in_sfx(const char *, const char *);
 static unsigned long decode_codec_id(const unsigned char *, size_t);
 static int	decode_encoded_header_info(struct archive_read *,
 		    struct _7z_stream_info *);
+static void	decode_folder_job(void *);
 static int	decompress(struct archive_read *, struct _7zip *,
 		    void *, size_t *, const void *, size_t *);
 static ssize_t	extract_pack_stream(struct archive_read *, size_t);
@@ -420,12 +475,18 @@ static void	free_PackInfo(struct _7z_pack_info *);
 static void	free_StreamsInfo(struct _7z_stream_info *);
 static void	free_SubStreamsInfo(struct _7z_substream_info *);
 static int	free_decompression(struct archive_read *, struct _7zip *);
+static void	free_folder_jobs(struct _7zip *);
 static ssize_t	get_uncompressed_data(struct archive_read *, const void **,
 		    size_t, size_t);
 static const unsigned char * header_bytes(struct archive_read *, size_t);
+static int	folder_job_eligible(struct _7zip *, unsigned);
+static void	abandon_folder(struct archive_read *);
 static int	init_decompression(struct archive_read *, struct _7zip *,
 		    const struct _7z_coder *, const struct _7z_coder *);
+static const void *pack_read_ahead(struct archive_read *, size_t,
+		    ssize_t *);
 static int	parse_7zip_uint64(struct archive_read *, uint64_t *);
+static int	plan_folders(struct archive_read *, struct _7zip *);
 static int	read_Bools(struct archive_read *, unsigned char *, size_t);
 static int	read_CodersInfo(struct archive_read *,
 		    struct _7z_coders_info *);
@@ -445,12 +506,14 @@ static void	read_consume(struct archive_read *);
 static ssize_t	read_stream(struct archive_read *, const void **, size_t,
 		    size_t);
 static int	seek_pack(struct archive_read *);
-static int64_t	skip_stream(struct archive_read *, size_t);
+static int64_t	skip_stream(struct archive_read *, uint64_t);
 static int	skip_sfx(struct archive_read *, const ssize_t);
 static ssize_t	find_pe_overlay(struct archive_read *);
 static ssize_t	find_elf_data_sec(struct archive_read *);
+static int	start_folder_job(struct archive_read *, unsigned);
 static int	slurp_central_directory(struct archive_read *, struct _7zip *,
 		    struct _7z_header_info *);
+static int	take_decoded_folder(struct archive_read *);
 static int	setup_decode_folder(struct archive_read *, struct _7z_folder *,
 		    int);
 static void	x86_Init(struct _7zip *);
@@ -485,13 +548,13 @@ archive_read_support_format_7zip(struct archive *_a)
 	 * any encrypted entries yet.
 	 */
 	zip->has_encrypted_entries = ARCHIVE_READ_FORMAT_ENCRYPTION_DONT_KNOW;
-
+	zip->threads = 1;
 
 	r = __archive_read_register_format(a,
 	    zip,
 	    "7zip",
 	    archive_read_format_7zip_bid,
-	    NULL,
+	    archive_read_format_7zip_options,
 	    archive_read_format_7zip_read_header,
 	    archive_read_format_7zip_read_data,
 	    archive_read_format_7zip_read_data_skip,
@@ -526,6 +589,23 @@ archive_read_format_7zip_has_encrypted_entries(struct archive_read *_a)
 	return ARCHIVE_READ_FORMAT_ENCRYPTION_DONT_KNOW;
 }
 
+static int
+archive_read_format_7zip_options(struct archive_read *a,
+    const char *key, const char *val)
+{
+	struct _7zip *zip;
+
+	zip = (struct _7zip *)(a->format->data);
+	if (strcmp(key, "threads") == 0)
+		return (__archive_thread_parse_count(&a->archive, val,
+		    &zip->threads));
+
+	/* Note: The "warn" return is just to inform the options
+	 * supervisor that we didn't handle it.  It will generate
+	 * a suitable error if no one used this option. */
+	return (ARCHIVE_WARN);
+}
+
 static int
 archive_read_format_7zip_bid(struct archive_read *a, int best_bid)
 {
@@ -569,42 +649,39 @@ archive_read_format_7zip_bid(struct archive_read *a, int best_bid)
 				continue;
 			}
 			p = buff + offset;
-			while (p + 32 < buff + bytes_avail) {
-				int step = check_7zip_header_in_sfx(p);
-				if (step == 0)
-					return (48);
-				p += step;
-			}
+			if (find_7zip_header_in_sfx(p, buff + bytes_avail)
+			    != NULL)
+				return (48);
+			if (p < buff + bytes_avail - 32)
+				p = buff + bytes_avail - 32;
 			offset = p - buff;
 		}
 	}
 	return (0);
 }
 
-static int
-check_7zip_header_in_sfx(const char *p)
+/*
+ * Return the first 7-Zip signature header in [p, end) that has all of
+ * its 32 bytes before end, or NULL if there is none.
+ */
+static const char *
+find_7zip_header_in_sfx(const char *p, const char *end)
 {
-	switch ((unsigned char)p[5]) {
-	case 0x1C:
-		if (memcmp(p, _7ZIP_SIGNATURE, 6) != 0)
-			return (6);
+	if (end - p <= 32)
+		return (NULL);
+	while ((p = __archive_read_find_signature(p, end - 27,
+	    _7ZIP_SIGNATURE, 6)) != NULL) {
 		/*
 		 * Test the CRC because its extraction code has 7-Zip
 		 * Magic Code, so we should do this in order not to
 		 * make a mis-detection.
 		 */
 		if (crc32(0, (const unsigned char *)p + 12, 20)
-			!= archive_le32dec(p + 8))
-			return (6);
-		/* Hit the header! */
-		return (0);
-	case 0x37: return (5);
-	case 0x7A: return (4);
-	case 0xBC: return (3);
-	case 0xAF: return (2);
-	case 0x27: return (1);
-	default: return (6);
+			== archive_le32dec(p + 8))
+			return (p);	/* Hit the header! */
+		p++;
 	}
+	return (NULL);
 }
 
 static int
@@ -641,18 +718,16 @@ skip_sfx(struct archive_read *a, const ssize_t min_addr)
 		 * Scan ahead until we find something that looks
 		 * like the 7-Zip header.
 		 */
-		while (p + 32 < q) {
-			int step = check_7zip_header_in_sfx(p);
-			if (step == 0) {
-				struct _7zip *zip =
-				    (struct _7zip *)a->format->data;
-				skip = p - (const char *)h;
-				__archive_read_consume(a, skip);
-				zip->seek_base = min_addr + offset + skip;
-				return (ARCHIVE_OK);
-			}
-			p += step;
+		if ((q = find_7zip_header_in_sfx(p, q)) != NULL) {
+			struct _7zip *zip =
+			    (struct _7zip *)a->format->data;
+			skip = q - (const char *)h;
+			__archive_read_consume(a, skip);
+			zip->seek_base = min_addr + offset + skip;
+			return (ARCHIVE_OK);
 		}
+		if (bytes > 32)
+			p += bytes - 32;
 		skip = p - (const char *)h;
 		__archive_read_consume(a, skip);
 		offset += skip;
@@ -923,6 +998,10 @@ archive_read_format_7zip_read_header(struct archive_read *a,
 		if (zip->sconv == NULL)
 			return (ARCHIVE_FATAL);
 	}
+	if (zip->folder_wanted == NULL && __archive_read_plan_active(a)) {
+		if (plan_folders(a, zip) != ARCHIVE_OK)
+			return (ARCHIVE_FATAL);
+	}
 
 	/* Figure out if the entry is encrypted by looking at the folder
 	   that is associated to the current 7zip entry. If the folder
@@ -1019,7 +1098,10 @@ archive_read_format_7zip_read_header(struct archive_read *a,
 	if (zip->entry_bytes_remaining < 1)
 		zip->end_of_entry = 1;
 
-	if ((zip_entry->mode & AE_IFMT) == AE_IFLNK) {
+	/* An entry that will be skipped keeps its symlink unread, so
+	 * that nothing needs to be decoded for it. */
+	if ((zip_entry->mode & AE_IFMT) == AE_IFLNK &&
+	    __archive_read_plan_wanted(a, archive_entry_pathname(entry))) {
 		unsigned char *symname = NULL;
 		size_t symsize = 0;
 
@@ -1110,13 +1192,26 @@ archive_read_format_7zip_read_data(struct archive_read *a,
 	if (zip->end_of_entry)
 		return (ARCHIVE_EOF);
 
+	if (zip->folder_index > 0 &&
+	    zip->entry->folderIndex >= zip->folder_index) {
+		/* Nothing more is wanted from the current folder. */
+		abandon_folder(a);
+	} else if (zip->folder_skip > 0) {
+		/* Decode the entries skipped before this one. */
+		if (skip_stream(a, zip->folder_skip) < 0)
+			return (ARCHIVE_FATAL);
+		zip->folder_skip = 0;
+	}
+
 	size_t bytes_to_read = 16 * 1024 * 1024;  // Don't try to read more than 16 MB at a time
 	if ((uint64_t)bytes_to_read > zip->entry_bytes_remaining) {
 		bytes_to_read = (size_t)zip->entry_bytes_remaining;
 	}
 	bytes = read_stream(a, buff, bytes_to_read, 0);
-	if (bytes < 0)
+	if (bytes < 0) {
+		zip->decode_failed = 1;
 		return ((int)bytes);
+	}
 	if (bytes == 0) {
 		archive_set_error(&a->archive,
 		    ARCHIVE_ERRNO_FILE_FORMAT,
@@ -1158,7 +1253,6 @@ static int
 archive_read_format_7zip_read_data_skip(struct archive_read *a)
 {
 	struct _7zip *zip;
-	int64_t bytes_skipped;
 
 	zip = (struct _7zip *)(a->format->data);
 
@@ -1169,13 +1263,34 @@ archive_read_format_7zip_read_data_skip(struct archive_read *a)
 	if (zip->end_of_entry)
 		return (ARCHIVE_OK);
 
-	/*
-	 * If the length is at the beginning, we can skip the
-	 * compressed data much more quickly.
-	 */
-	bytes_skipped = skip_stream(a, (size_t)zip->entry_bytes_remaining);
-	if (bytes_skipped < 0)
-		return (ARCHIVE_FATAL);
+	if (__archive_read_plan_active(a)) {
+		/*
+		 * Nothing is decoded here.  If a later entry of the same
+		 * folder is read, the skipped bytes are decoded and
+		 * discarded first; otherwise they never are.
+		 */
+		if (zip->decode_failed && zip->folder_index > 0) {
+			/* Report the error again rather than skip past it. */
+			if (skip_stream(a, zip->entry_bytes_remaining) < 0)
+				return (ARCHIVE_FATAL);
+		} else if (zip->folder_index > 0 &&
+		    zip->entry->folderIndex == zip->folder_index - 1)
+			zip->folder_skip += zip->entry_bytes_remaining;
+		else
+			zip->si.ci.folders[zip->entry->folderIndex].skipped_bytes
+			    += zip->entry_bytes_remaining;
+	} else if (zip->folder_index == 0) {
+		/*
+		 * Optimization for a list mode.
+		 * Avoid unnecessary decoding operations.
+		 */
+		zip->si.ci.folders[zip->entry->folderIndex].skipped_bytes
+		    += zip->entry_bytes_remaining;
+	} else {
+		/* Decode the rest, so that errors in it are reported. */
+		if (skip_stream(a, zip->entry_bytes_remaining) < 0)
+			return (ARCHIVE_FATAL);
+	}
 	zip->entry_bytes_remaining = 0;
 
 	/* This entry is finished and done. */
@@ -1198,6 +1313,8 @@ archive_read_format_7zip_cleanup(struct archive_read *a)
 	free(zip->sub_stream_buff[1]);
 	free(zip->sub_stream_buff[2]);
 	free(zip->tmp_stream_buff);
+	free(zip->folder_wanted);
+	free_folder_jobs(zip);
 	free(zip);
 	(a->format->data) = NULL;
 	return (ARCHIVE_OK);
@@ -1209,12 +1326,36 @@ read_consume(struct archive_read *a)
 	struct _7zip *zip = (struct _7zip *)a->format->data;
 
 	if (zip->pack_stream_bytes_unconsumed) {
-		__archive_read_consume(a, zip->pack_stream_bytes_unconsumed);
+		if (zip->pack_buff == NULL)
+			__archive_read_consume(a,
+			    zip->pack_stream_bytes_unconsumed);
 		zip->stream_offset += zip->pack_stream_bytes_unconsumed;
 		zip->pack_stream_bytes_unconsumed = 0;
 	}
 }
 
+/*
+ * Like __archive_read_ahead(), but a folder being decoded by a job
+ * reads its pack streams from memory.
+ */
+static const void *
+pack_read_ahead(struct archive_read *a, size_t minimum, ssize_t *avail)
+{
+	struct _7zip *zip = (struct _7zip *)a->format->data;
+	int64_t pos;
+
+	if (zip->pack_buff == NULL)
+		return (__archive_read_ahead(a, minimum, avail));
+	pos = zip->stream_offset - zip->pack_buff_offset;
+	if (pos < 0 || (uint64_t)pos > zip->pack_buff_size)
+		*avail = 0;
+	else
+		*avail = (ssize_t)(zip->pack_buff_size - (size_t)pos);
+	if (*avail <= 0 || (size_t)*avail < minimum)
+		return (NULL);
+	return (zip->pack_buff + pos);
+}
+
 #ifdef HAVE_LZMA_H
 
 /*
@@ -1280,6 +1421,32 @@ decode_codec_id(const unsigned char *codecId, size_t id_size)
 	return (id);
 }
 
+/*
+ * The range decoder takes bytes straight from zip->bytein's window
+ * over ppstream.next_in; account for the ones it has taken.
+ */
+static void
+ppmd_sync_in(struct _7zip *zip)
+{
+	int64_t n;
+
+	if (zip->bytein.Cur == zip->ppstream.next_in)
+		return;
+	n = zip->bytein.Cur - zip->ppstream.next_in;
+	zip->ppstream.next_in += n;
+	zip->ppstream.avail_in -= n;
+	zip->ppstream.total_in += n;
+	zip->ppstream.stream_in += n;
+}
+
+static void
+ppmd_set_window(struct _7zip *zip)
+{
+	zip->bytein.Cur = zip->ppstream.next_in;
+	zip->bytein.Lim = zip->ppstream.next_in +
+	    (zip->ppstream.avail_in > 0 ? zip->ppstream.avail_in : 0);
+}
+
 static Byte
 ppmd_read(void *p)
 {
@@ -1287,6 +1454,7 @@ ppmd_read(void *p)
 	struct _7zip *zip = (struct _7zip *)(a->format->data);
 	Byte b;
 
+	ppmd_sync_in(zip);
 	if (zip->ppstream.avail_in <= 0) {
 		/*
 		 * Ppmd7_DecodeSymbol might require reading multiple bytes
@@ -1294,7 +1462,7 @@ ppmd_read(void *p)
 		 * last resort to read using __archive_read_ahead.
 		 */
 		ssize_t bytes_avail = 0;
-		const uint8_t* data = __archive_read_ahead(a,
+		const uint8_t* data = pack_read_ahead(a,
 		    (size_t)zip->ppstream.stream_in+1, &bytes_avail);
 		if(data == NULL || bytes_avail < zip->ppstream.stream_in+1) {
 			archive_set_error(&a->archive,
@@ -1311,6 +1479,7 @@ ppmd_read(void *p)
 	zip->ppstream.avail_in--;
 	zip->ppstream.total_in++;
 	zip->ppstream.stream_in++;
+	ppmd_set_window(zip);
 	return (b);
 }
 
@@ -1584,12 +1753,9 @@ init_decompression(struct archive_read *a, struct _7zip *zip,
 		unsigned order;
 		uint32_t msize;
 
-		if (zip->ppmd7_valid) {
-			__archive_ppmd7_functions.Ppmd7_Free(
-			    &zip->ppmd7_context);
-			zip->ppmd7_valid = 0;
-		}
-
+		/* A model left by an earlier folder is reused by
+		 * Ppmd7_Alloc() when it is large enough. */
+		zip->ppmd7_stat = -1;
 		if (coder1->propertiesSize < 5) {
 			archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
 			    "Malformed PPMd parameter");
@@ -1603,7 +1769,11 @@ init_decompression(struct archive_read *a, struct _7zip *zip,
 			    "Malformed PPMd parameter");
 			return (ARCHIVE_FAILED);
 		}
-		__archive_ppmd7_functions.Ppmd7_Construct(&zip->ppmd7_context);
+		if (!zip->ppmd7_valid) {
+			__archive_ppmd7_functions.Ppmd7_Construct(
+			    &zip->ppmd7_context);
+			zip->ppmd7_valid = 1;
+		}
 		r = __archive_ppmd7_functions.Ppmd7_Alloc(
 			&zip->ppmd7_context, msize);
 		if (r == 0) {
@@ -1615,7 +1785,6 @@ init_decompression(struct archive_read *a, struct _7zip *zip,
 			&zip->ppmd7_context, order);
 		__archive_ppmd7_functions.Ppmd7z_RangeDec_CreateVTable(
 			&zip->range_dec);
-		zip->ppmd7_valid = 1;
 		zip->ppmd7_stat = 0;
 		zip->ppstream.overconsumed = 0;
 		zip->ppstream.total_in = 0;
@@ -1858,12 +2027,14 @@ decompress(struct archive_read *a, struct _7zip *zip,
 		zip->ppstream.stream_in = 0;
 		zip->ppstream.next_out = t_next_out;
 		zip->ppstream.avail_out = t_avail_out;
+		ppmd_set_window(zip);
 		if (zip->ppmd7_stat == 0) {
 			zip->bytein.a = a;
 			zip->bytein.Read = &ppmd_read;
 			zip->range_dec.Stream = &zip->bytein;
 			r = __archive_ppmd7_functions.Ppmd7z_RangeDec_Init(
 				&(zip->range_dec));
+			ppmd_sync_in(zip);
 			if (r == 0) {
 				zip->ppmd7_stat = -1;
 				archive_set_error(&a->archive,
@@ -1906,7 +2077,10 @@ decompress(struct archive_read *a, struct _7zip *zip,
 			if (flush_bytes)
 				flush_bytes--;
 		} while (zip->ppstream.avail_out &&
-			(zip->ppstream.avail_in || flush_bytes));
+			(zip->ppstream.avail_in !=
+			 zip->bytein.Cur - zip->ppstream.next_in ||
+			 flush_bytes));
+		ppmd_sync_in(zip);
 
 		t_avail_in = (size_t)zip->ppstream.avail_in;
 		t_avail_out = (size_t)zip->ppstream.avail_out;
@@ -3384,10 +3558,11 @@ get_uncompressed_data(struct archive_read *a, const void **buff, size_t size,
 	struct _7zip *zip = (struct _7zip *)a->format->data;
 	ssize_t bytes_avail;
 
-	if (zip->codec == _7Z_COPY && zip->codec2 == (unsigned long)-1) {
+	if (zip->codec == _7Z_COPY && zip->codec2 == (unsigned long)-1 &&
+	    zip->folder_buff == NULL) {
 		/* Copy mode. */
 
-		*buff = __archive_read_ahead(a, minimum, &bytes_avail);
+		*buff = pack_read_ahead(a, minimum, &bytes_avail);
 		if (*buff == NULL) {
 			archive_set_error(&a->archive,
 			    ARCHIVE_ERRNO_FILE_FORMAT,
@@ -3440,7 +3615,7 @@ extract_pack_stream(struct archive_read *a, size_t minimum)
 	if (zip->codec == _7Z_COPY && zip->codec2 == (unsigned long)-1) {
 		if (minimum == 0)
 			minimum = 1;
-		if (__archive_read_ahead(a, minimum, &bytes_avail) == NULL
+		if (pack_read_ahead(a, minimum, &bytes_avail) == NULL
 		    || bytes_avail <= 0) {
 			archive_set_error(&a->archive,
 			    ARCHIVE_ERRNO_FILE_FORMAT,
@@ -3527,7 +3702,7 @@ extract_pack_stream(struct archive_read *a, size_t minimum)
 		 * available bytes; asking for more than that forces the
 		 * decompressor to combine reads by copying data.
 		 */
-		buff_in = __archive_read_ahead(a, 1, &bytes_avail);
+		buff_in = pack_read_ahead(a, 1, &bytes_avail);
 		if (bytes_avail <= 0) {
 			archive_set_error(&a->archive,
 			    ARCHIVE_ERRNO_FILE_FORMAT,
@@ -3606,8 +3781,17 @@ seek_pack(struct archive_read *a)
 	    zip->si.pi.sizes[zip->pack_stream_index];
 	pack_offset = zip->si.pi.positions[zip->pack_stream_index];
 	if (zip->stream_offset != pack_offset) {
-		if (0 > __archive_read_seek(a, pack_offset + zip->seek_base,
-		    SEEK_SET))
+		if (zip->pack_buff != NULL) {
+			if (pack_offset < zip->pack_buff_offset ||
+			    pack_offset - zip->pack_buff_offset >
+			    (int64_t)zip->pack_buff_size) {
+				archive_set_error(&(a->archive),
+				    ARCHIVE_ERRNO_MISC,
+				    "Damaged 7-Zip archive");
+				return (ARCHIVE_FATAL);
+			}
+		} else if (0 > __archive_read_seek(a,
+		    pack_offset + zip->seek_base, SEEK_SET))
 			return (ARCHIVE_FATAL);
 		zip->stream_offset = pack_offset;
 	}
@@ -3616,12 +3800,423 @@ seek_pack(struct archive_read *a)
 	return (ARCHIVE_OK);
 }
 
+/*
+ * Whether a folder can be decoded by a job: it must be compressed,
+ * not encrypted, and small enough to hold in memory.
+ */
+static int
+folder_job_eligible(struct _7zip *zip, unsigned fi)
+{
+	const struct _7z_folder *folder = &(zip->si.ci.folders[fi]);
+	uint64_t pack_size, unpack_size;
+	unsigned i;
+
+	if (folder->numCoders == 1 && folder->coders[0].codec == _7Z_COPY)
+		return (0);
+	if (zip->folder_wanted != NULL && !zip->folder_wanted[fi])
+		return (0);
+	for (i = 0; i < folder->numCoders; i++) {
+		switch (folder->coders[i].codec) {
+		case _7Z_CRYPTO_MAIN_ZIP:
+		case _7Z_CRYPTO_RAR_29:
+		case _7Z_CRYPTO_AES_256_SHA_256:
+			return (0);
+		}
+	}
+	unpack_size = folder_uncompressed_size(
+	    &(zip->si.ci.folders[fi]));
+	if (unpack_size == 0 || unpack_size > PARALLEL_FOLDER_MAX)
+		return (0);
+	if (folder->numPackedStreams == 0 ||
+	    folder->packIndex + folder->numPackedStreams >
+	    zip->si.pi.numPackStreams)
+		return (0);
+	pack_size = 0;
+	for (i = 0; i < folder->numPackedStreams; i++) {
+		pack_size += zip->si.pi.sizes[folder->packIndex + i];
+		if (pack_size > PARALLEL_FOLDER_MAX)
+			return (0);
+	}
+	return (pack_size > 0);
+}
+
+/*
+ * Memory a job for an eligible folder holds: its pack streams and
+ * its output.
+ */
+static size_t
+folder_job_size(struct _7zip *zip, unsigned fi)
+{
+	const struct _7z_folder *folder = &(zip->si.ci.folders[fi]);
+	uint64_t size;
+	unsigned i;
+
+	size = folder_uncompressed_size(&(zip->si.ci.folders[fi]));
+	for (i = 0; i < folder->numPackedStreams; i++)
+		size += zip->si.pi.sizes[folder->packIndex + i];
+	return ((size_t)size);
+}
+
+/*
+ * Decode a whole folder from the copy of its pack streams in a job.
+ * This runs on a worker thread, with a private reader state sharing
+ * only the archive's read-only structural information.
+ */
+static void
+decode_folder_job(void *arg)
+{
+	struct _7z_folder_job *job = (struct _7z_folder_job *)arg;
+	struct archive_format_descriptor format;
+	struct archive_read *a;
+	struct _7zip *zip;
+	const void *buff;
+	size_t done = 0;
+	ssize_t bytes;
+	int r;
+
+	a = calloc(1, sizeof(*a));
+	zip = calloc(1, sizeof(*zip));
+	job->out = malloc(job->out_size);
+	if (a == NULL || zip == NULL || job->out == NULL) {
+		free(a);
+		free(zip);
+		job->status = ARCHIVE_FATAL;
+		job->error_number = ENOMEM;
+		archive_strcpy(&job->error_string,
+		    "No memory for 7-Zip decompression");
+		return;
+	}
+	memset(&format, 0, sizeof(format));
+	format.data = zip;
+	a->format = &format;
+	zip->si = *job->si;
+	zip->has_encrypted_entries = 0;
+	zip->pack_buff = job->pack;
+	zip->pack_buff_size = job->pack_size;
+	zip->pack_buff_offset = job->pack_offset;
+	zip->stream_offset = job->pack_offset;
+	if (job->ppmd7_valid) {
+		zip->ppmd7_context = job->ppmd7_context;
+		zip->ppmd7_valid = 1;
+		job->ppmd7_valid = 0;
+	}
+
+	r = setup_decode_folder(a, &(zip->si.ci.folders[job->folder]), 0);
+	if (r == ARCHIVE_OK)
+		r = seek_pack(a);
+	if (r == ARCHIVE_OK)
+		r = (int)extract_pack_stream(a, 0);
+	while (r >= 0 && done < job->out_size) {
+		if (zip->uncompressed_buffer_bytes_remaining == 0) {
+			if (zip->pack_stream_inbytes_remaining == 0 &&
+			    zip->folder_outbytes_remaining == 0) {
+				archive_set_error(&a->archive,
+				    ARCHIVE_ERRNO_FILE_FORMAT,
+				    "Truncated 7-Zip file body");
+				r = ARCHIVE_FATAL;
+				break;
+			}
+			r = (int)extract_pack_stream(a, 0);
+			if (r < 0)
+				break;
+		}
+		bytes = get_uncompressed_data(a, &buff,
+		    job->out_size - done, 0);
+		if (bytes < 0) {
+			r = (int)bytes;
+			break;
+		}
+		memcpy(job->out + done, buff, bytes);
+		done += bytes;
+		read_consume(a);
+	}
+	job->status = (r < 0) ? ARCHIVE_FATAL : ARCHIVE_OK;
+	if (job->status != ARCHIVE_OK) {
+		job->error_number = a->archive.archive_error_number;
+		archive_strcpy(&job->error_string,
+		    a->archive.error != NULL ? a->archive.error :
+		    "Damaged 7-Zip archive");
+	}
+
+	/* Hand the PPMd model back to the slot for its next folder. */
+	if (zip->ppmd7_valid) {
+		job->ppmd7_context = zip->ppmd7_context;
+		job->ppmd7_valid = 1;
+		zip->ppmd7_valid = 0;
+	}
+	free_decompression(a, zip);
+	free(zip->uncompressed_buffer);
+	free(zip->sub_stream_buff[0]);
+	free(zip->sub_stream_buff[1]);
+	free(zip->sub_stream_buff[2]);
+	free(zip->tmp_stream_buff);
+	free(zip);
+	archive_string_free(&a->archive.error_string);
+	free(a);
+	/* The pack streams are no longer needed. */
+	free(job->pack);
+	job->pack = NULL;
+}
+
+/*
+ * Read the pack streams of a folder into memory and queue them to
+ * the worker pool.  Without a pool they are decoded right away.
+ */
+static int
+start_folder_job(struct archive_read *a, unsigned fi)
+{
+	struct _7zip *zip = (struct _7zip *)a->format->data;
+	const struct _7z_folder *folder = &(zip->si.ci.folders[fi]);
+	struct _7z_folder_job *job = &(zip->jobs[fi % zip->threads]);
+	const void *p;
+	ssize_t bytes_avail;
+	size_t copied = 0;
+	unsigned i;
+
+	job->pack_offset = zip->si.pi.positions[folder->packIndex];
+	job->pack_size = 0;
+	for (i = 0; i < folder->numPackedStreams; i++)
+		job->pack_size +=
+		    (size_t)zip->si.pi.sizes[folder->packIndex + i];
+	job->out_size = (size_t)folder_uncompressed_size(
+	    &(zip->si.ci.folders[fi]));
+	job->pack = malloc(job->pack_size + PACK_TAIL_SIZE);
+	if (job->pack == NULL) {
+		archive_set_error(&a->archive, ENOMEM,
+		    "No memory for 7-Zip decompression");
+		return (ARCHIVE_FATAL);
+	}
+	if (zip->stream_offset != job->pack_offset) {
+		if (0 > __archive_read_seek(a,
+		    job->pack_offset + zip->seek_base, SEEK_SET)) {
+			free(job->pack);
+			job->pack = NULL;
+			return (ARCHIVE_FATAL);
+		}
+		zip->stream_offset = job->pack_offset;
+	}
+	while (copied < job->pack_size) {
+		p = __archive_read_ahead(a, 1, &bytes_avail);
+		if (p == NULL || bytes_avail <= 0) {
+			archive_set_error(&a->archive,
+			    ARCHIVE_ERRNO_FILE_FORMAT,
+			    "Truncated 7-Zip file body");
+			free(job->pack);
+			job->pack = NULL;
+			return (ARCHIVE_FATAL);
+		}
+		if ((size_t)bytes_avail > job->pack_size - copied)
+			bytes_avail = (ssize_t)(job->pack_size - copied);
+		memcpy(job->pack + copied, p, bytes_avail);
+		__archive_read_consume(a, bytes_avail);
+		zip->stream_offset += bytes_avail;
+		copied += bytes_avail;
+	}
+	/*
+	 * The PPMd range decoder may look a few bytes past the end of
+	 * its pack stream while flushing, as it does when reading from
+	 * the file; give it whatever follows without consuming it.
+	 */
+	p = __archive_read_ahead(a, 1, &bytes_avail);
+	if (p != NULL && bytes_avail > 0) {
+		if (bytes_avail > PACK_TAIL_SIZE)
+			bytes_avail = PACK_TAIL_SIZE;
+		memcpy(job->pack + copied, p, bytes_avail);
+		job->pack_size += bytes_avail;
+	}
+
+	job->si = &(zip->si);
+	job->folder = fi;
+	job->busy = 1;
+	job->status = ARCHIVE_OK;
+	job->out = NULL;
+	zip->inflight += job->pack_size + job->out_size;
+	__archive_thread_pool_run(zip->pool, &job->task, decode_folder_job,
+	    job);
+	return (ARCHIVE_OK);
+}
+
+static void
+finish_folder_job(struct _7zip *zip, struct _7z_folder_job *job)
+{
+	__archive_thread_pool_wait(zip->pool, &job->task);
+	zip->inflight -= job->pack_size + job->out_size;
+	job->busy = 0;
+}
+
+static void
+free_folder_jobs(struct _7zip *zip)
+{
+	int i;
+
+	if (zip->jobs != NULL) {
+		for (i = 0; i < zip->threads; i++) {
+			if (zip->jobs[i].busy)
+				finish_folder_job(zip, &(zip->jobs[i]));
+			free(zip->jobs[i].pack);
+			free(zip->jobs[i].out);
+			archive_string_free(&(zip->jobs[i].error_string));
+			if (zip->jobs[i].ppmd7_valid)
+				__archive_ppmd7_functions.Ppmd7_Free(
+				    &(zip->jobs[i].ppmd7_context));
+		}
+		free(zip->jobs);
+		zip->jobs = NULL;
+	}
+	__archive_thread_pool_free(zip->pool);
+	zip->pool = NULL;
+	zip->inflight = 0;
+	free(zip->folder_buff);
+	zip->folder_buff = NULL;
+}
+
+/*
+ * Called when switching to the folder zip->folder_index.  Read the
+ * pack streams of the following folders ahead, as long as they are
+ * stored in order, and start decoding them.  Returns 1 if the current
+ * folder has been decoded that way and its output is now ready to be
+ * read from zip->folder_buff, 0 if it must be decoded as usual.
+ */
+static int
+take_decoded_folder(struct archive_read *a)
+{
+	struct _7zip *zip = (struct _7zip *)a->format->data;
+	struct _7z_folder_job *job;
+	unsigned fi, k = zip->folder_index;
+	int i, r;
+
+	read_consume(a);
+	if (zip->jobs == NULL) {
+		zip->jobs = calloc(zip->threads, sizeof(*zip->jobs));
+		if (zip->jobs == NULL) {
+			archive_set_error(&a->archive, ENOMEM,
+			    "No memory for 7-Zip decompression");
+			return (ARCHIVE_FATAL);
+		}
+		/* Without a pool, jobs are simply decoded in turn. */
+		zip->pool = __archive_thread_pool_new(zip->threads);
+	}
+	/* Discard folders left behind. */
+	for (i = 0; i < zip->threads; i++) {
+		job = &(zip->jobs[i]);
+		if (job->busy && job->folder < k) {
+			finish_folder_job(zip, job);
+			free(job->out);
+			job->out = NULL;
+		}
+	}
+	if (zip->prefetch_next < k)
+		zip->prefetch_next = k;
+
+	job = &(zip->jobs[k % zip->threads]);
+	if (!job->busy && !folder_job_eligible(zip, k))
+		return (0);
+	while (zip->prefetch_next < zip->si.ci.numFolders &&
+	    zip->prefetch_next - k < (unsigned)zip->threads) {
+		fi = zip->prefetch_next;
+		/* Folders outside the read plan are passed over. */
+		if (zip->folder_wanted != NULL && !zip->folder_wanted[fi]) {
+			zip->prefetch_next++;
+			continue;
+		}
+		if (!folder_job_eligible(zip, fi))
+			break;
+		/* Never seek backwards to read ahead. */
+		if (fi != k && zip->si.pi.positions[
+		    zip->si.ci.folders[fi].packIndex] <
+		    (uint64_t)zip->stream_offset)
+			break;
+		/* Nor hold more than PARALLEL_INFLIGHT_MAX in memory. */
+		if (fi != k && zip->inflight + folder_job_size(zip, fi) >
+		    PARALLEL_INFLIGHT_MAX)
+			break;
+		r = start_folder_job(a, fi);
+		if (r < 0)
+			return (r);
+		zip->prefetch_next++;
+	}
+	if (!job->busy || job->folder != k)
+		return (0);
+
+	finish_folder_job(zip, job);
+	if (job->status != ARCHIVE_OK) {
+		archive_set_error(&a->archive, job->error_number, "%s",
+		    job->error_string.s);
+		free(job->out);
+		job->out = NULL;
+		return (ARCHIVE_FATAL);
+	}
+	if (zip->has_encrypted_entries ==
+	    ARCHIVE_READ_FORMAT_ENCRYPTION_DONT_KNOW)
+		zip->has_encrypted_entries = 0;
+	zip->folder_buff = job->out;
+	job->out = NULL;
+	zip->uncompressed_buffer_pointer = zip->folder_buff;
+	zip->uncompressed_buffer_bytes_remaining = job->out_size;
+	zip->folder_outbytes_remaining = 0;
+	zip->pack_stream_inbytes_remaining = 0;
+	zip->pack_stream_remaining = 0;
+	return (1);
+}
+
+/*
+ * Drop whatever is left of the current folder, so that the next read
+ * switches to the folder of the current entry.
+ */
+static void
+abandon_folder(struct archive_read *a)
+{
+	struct _7zip *zip = (struct _7zip *)a->format->data;
+
+	read_consume(a);
+	zip->uncompressed_buffer_bytes_remaining = 0;
+	zip->pack_stream_inbytes_remaining = 0;
+	zip->folder_outbytes_remaining = 0;
+	zip->pack_stream_remaining = 0;
+	zip->odd_bcj_size = 0;
+	zip->folder_skip = 0;
+}
+
+/*
+ * Mark the folders that hold an entry of the client's read plan, so
+ * that read-ahead does not decode the others.
+ */
+static int
+plan_folders(struct archive_read *a, struct _7zip *zip)
+{
+	struct archive_string name;
+	size_t i;
+
+	zip->folder_wanted = calloc(zip->si.ci.numFolders + 1, 1);
+	if (zip->folder_wanted == NULL) {
+		archive_set_error(&a->archive, ENOMEM,
+		    "No memory for 7-Zip decompression");
+		return (ARCHIVE_FATAL);
+	}
+	archive_string_init(&name);
+	for (i = 0; i < zip->numFiles; i++) {
+		const struct _7zip_entry *e = &(zip->entries[i]);
+
+		if (e->folderIndex >= zip->si.ci.numFolders)
+			continue;
+		archive_string_empty(&name);
+		/* Be conservative with names that cannot be converted. */
+		if (archive_strncpy_l(&name, e->utf16name, e->name_len,
+		    zip->sconv) != 0 ||
+		    __archive_read_plan_wanted(a, name.s))
+			zip->folder_wanted[e->folderIndex] = 1;
+	}
+	archive_string_free(&name);
+	return (ARCHIVE_OK);
+}
+
 static ssize_t
 read_stream(struct archive_read *a, const void **buff, size_t size,
     size_t minimum)
 {
 	struct _7zip *zip = (struct _7zip *)a->format->data;
 	uint64_t skip_bytes = 0;
+	int decoded = 0;
 	ssize_t r;
 
 	if (zip->uncompressed_buffer_bytes_remaining == 0) {
@@ -3656,12 +4251,17 @@ read_stream(struct archive_read *a, const void **buff, size_t size,
 		 * All current folder's pack streams have been
 		 * consumed. Switch to next folder.
 		 */
-		if (zip->folder_index == 0 &&
-		    (zip->si.ci.folders[zip->entry->folderIndex].skipped_bytes
-		     || zip->folder_index != zip->entry->folderIndex)) {
+		/*
+		 * Go straight to the folder of the entry being read;
+		 * folders in between were not wanted and are never
+		 * decoded.
+		 */
+		if (zip->entry->folderIndex >= zip->folder_index &&
+		    zip->entry->folderIndex < zip->si.ci.numFolders) {
 			zip->folder_index = zip->entry->folderIndex;
 			skip_bytes =
 			    zip->si.ci.folders[zip->folder_index].skipped_bytes;
+			zip->si.ci.folders[zip->folder_index].skipped_bytes = 0;
 		}
 
 		if (zip->folder_index >= zip->si.ci.numFolders) {
@@ -3671,25 +4271,39 @@ read_stream(struct archive_read *a, const void **buff, size_t size,
 			*buff = NULL;
 			return (0);
 		}
-		r = setup_decode_folder(a,
-			&(zip->si.ci.folders[zip->folder_index]), 0);
-		if (r != ARCHIVE_OK)
-			return (ARCHIVE_FATAL);
+		if (zip->folder_buff != NULL) {
+			free(zip->folder_buff);
+			zip->folder_buff = NULL;
+			zip->uncompressed_buffer_pointer = NULL;
+		}
+		if (zip->threads > 1) {
+			decoded = take_decoded_folder(a);
+			if (decoded < 0)
+				return (decoded);
+		}
+		if (!decoded) {
+			r = setup_decode_folder(a,
+				&(zip->si.ci.folders[zip->folder_index]), 0);
+			if (r != ARCHIVE_OK)
+				return (ARCHIVE_FATAL);
+		}
 
 		zip->folder_index++;
 	}
 
-	/*
-	 * Switch to next pack stream.
-	 */
-	r = seek_pack(a);
-	if (r < 0)
-		return (r);
+	if (!decoded) {
+		/*
+		 * Switch to next pack stream.
+		 */
+		r = seek_pack(a);
+		if (r < 0)
+			return (r);
 
-	/* Extract a new pack stream. */
-	r = extract_pack_stream(a, 0);
-	if (r < 0)
-		return (r);
+		/* Extract a new pack stream. */
+		r = extract_pack_stream(a, 0);
+		if (r < 0)
+			return (r);
+	}
 
 	/*
 	 * Skip the bytes we already has skipped in skip_stream().
@@ -3987,26 +4601,20 @@ setup_decode_folder(struct archive_read *a, struct _7z_folder *folder,
 	return (ARCHIVE_OK);
 }
 
+/*
+ * Decode and discard bytes of the current folder.
+ */
 static int64_t
-skip_stream(struct archive_read *a, size_t skip_bytes)
+skip_stream(struct archive_read *a, uint64_t skip_bytes)
 {
 	struct _7zip *zip = (struct _7zip *)a->format->data;
 	const void *p;
 	int64_t skipped_bytes;
-	size_t bytes = skip_bytes;
-
-	if (zip->folder_index == 0) {
-		/*
-		 * Optimization for a list mode.
-		 * Avoid unnecessary decoding operations.
-		 */
-		zip->si.ci.folders[zip->entry->folderIndex].skipped_bytes
-		    += skip_bytes;
-		return (skip_bytes);
-	}
+	uint64_t bytes = skip_bytes;
 
 	while (bytes) {
-		skipped_bytes = read_stream(a, &p, bytes, 0);
+		skipped_bytes = read_stream(a, &p,
+		    bytes > SIZE_MAX ? SIZE_MAX : (size_t)bytes, 0);
 		if (skipped_bytes < 0)
 			return (skipped_bytes);
 		if (skipped_bytes == 0) {
@@ -4015,11 +4623,11 @@ skip_stream(struct archive_read *a, size_t skip_bytes)
 			    "Truncated 7-Zip file body");
 			return (ARCHIVE_FATAL);
 		}
-		bytes -= (size_t)skipped_bytes;
+		bytes -= skipped_bytes;
 		if (zip->pack_stream_bytes_unconsumed)
 			read_consume(a);
 	}
-	return (skip_bytes);
+	return ((int64_t)skip_bytes);
 }
 
 /*
@@ -46,6 +46,7 @@
 #include "archive_entry_locale.h"
 #include "archive_private.h"
 #include "archive_read_private.h"
+#include "archive_thread_private.h"
 #include "archive_endian.h"
 
 
@@ -114,11 +115,15 @@ struct lzx_dec {
 		/*
 		 * Use a index table. It's faster than searching a huffman
 		 * coding tree, which is a binary tree. But a use of a large
-		 * index table causes L1 cache read miss many times.
+		 * index table causes L1 cache read miss many times, so
+		 * codes longer than HTBL_BITS are resolved by a small
+		 * second-level table hanging off the first-level entry.
 		 */
 		int		 max_bits;
 		int		 tbl_bits;
 		int		 tree_used;
+		/* Bits looked up in a second-level table; 0 if none. */
+		int		 sub_bits;
 		/* Direct access table. */
 		uint16_t	*tbl;
 	}			 at, lt, mt, pt;
@@ -127,6 +132,9 @@ struct lzx_dec {
 	int			 error;
 };
 
+/* Bits of the first-level table of a two-level huffman table. */
+#define HTBL_BITS	10
+
 static const int slots[] = {
 	30, 32, 34, 36, 38, 42, 50, 66, 98, 162, 290
 };
@@ -301,8 +309,46 @@ struct cab {
 	char			 stream_valid;
 #endif
 	struct lzx_stream	 xstrm;
+
+	/*
+	 * Parallel folder decoding.
+	 */
+	int			 threads;
+	/* One slot per thread, indexed by folder number modulo threads,
+	 * and the workers that decode them. */
+	struct cab_folder_job	*jobs;
+	struct archive_thread_pool *pool;
+	/* Next folder whose CFDATA have not been read ahead. */
+	int			 prefetch_next;
+	/* Set when reading ahead failed; the stream is no longer usable. */
+	char			 prefetch_failed;
+	/* Output of the current folder when it was decoded by a job. */
+	unsigned char		*folder_buff;
+	size_t			 folder_buff_size;
 };
 
+struct cab_folder_job {
+	struct archive_thread_task task;
+	int			 busy;
+	int			 folder;
+	/* All CFDATA of the folder, headers included. */
+	unsigned char		*raw;
+	size_t			 raw_size;
+	int			 cfdata_count;
+	int			 cfdata_hdr_size;
+	uint16_t		 comptype;
+	uint16_t		 compdata;
+	unsigned char		*out;
+	size_t			 out_size;
+	int			 status;
+	int			 error_number;
+	struct archive_string	 error_string;
+};
+
+/* Largest folder, in 32 KiB CFDATA, that is decoded on a worker thread;
+ * each one in flight holds both its CFDATA and its output in memory. */
+#define PARALLEL_CFDATA_MAX	2048
+
 static int	archive_read_format_cab_bid(struct archive_read *, int);
 static int	archive_read_format_cab_options(struct archive_read *,
 		    const char *, const char *);
@@ -312,6 +358,8 @@ static int	archive_read_format_cab_read_data(struct archive_read *,
 		    const void **, size_t *, int64_t *);
 static int	archive_read_format_cab_read_data_skip(struct archive_read *);
 static int	archive_read_format_cab_cleanup(struct archive_read *);
+static int	cab_decoded_folder(struct archive_read *);
+static void	free_folder_jobs(struct cab *);
 
 static int	cab_skip_sfx(struct archive_read *);
 static time_t	cab_dos_time(const unsigned char *);
@@ -363,6 +411,7 @@ archive_read_support_format_cab(struct archive *_a)
 		return (ARCHIVE_FATAL);
 	}
 	archive_string_init(&cab->ws);
+	cab->threads = 1;
 	if (archive_wstring_ensure(&cab->ws, 256) == NULL) {
 		archive_set_error(&a->archive, ENOMEM,
 		    "Can't allocate memory");
@@ -467,6 +516,9 @@ archive_read_format_cab_options(struct archive_read *a,
 	int ret = ARCHIVE_FAILED;
 
 	cab = (struct cab *)(a->format->data);
+	if (strcmp(key, "threads") == 0)
+		return (__archive_thread_parse_count(&a->archive, val,
+		    &cab->threads));
 	if (strcmp(key, "hdrcharset")  == 0) {
 		if (val == NULL || val[0] == 0)
 			archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
@@ -936,8 +988,14 @@ archive_read_format_cab_read_header(struct archive_read *a,
 	}
 	/* If a cffolder of this file is changed, reset a cfdata to read
 	 * file contents from next cfdata. */
-	if (prev_folder != cab->entry_cffolder)
+	if (prev_folder != cab->entry_cffolder) {
 		cab->entry_cfdata = NULL;
+		/* Bytes skipped in the previous folder are passed over
+		 * by seeking to the CFDATA of this one. */
+		cab->bytes_skipped = 0;
+		free(cab->folder_buff);
+		cab->folder_buff = NULL;
+	}
 
 	/* If a pathname is UTF-8, prepare a string conversion object
 	 * for UTF-8 and use it. */
@@ -1029,6 +1087,35 @@ archive_read_format_cab_read_data(struct archive_read *a,
 	default:
 		break;
 	}
+	r = cab_decoded_folder(a);
+	if (r < 0)
+		return (r);
+	if (r > 0) {
+		/* The whole folder is in memory; hand out the rest of
+		 * this entry at once. */
+		const struct cffile *file = cab->entry_cffile;
+
+		cab->read_data_invoked = 1;
+		cab->bytes_skipped = 0;
+		*offset = cab->entry_offset;
+		if (cab->end_of_entry) {
+			*size = 0;
+			*buff = NULL;
+			return (ARCHIVE_EOF);
+		}
+		if ((uint64_t)file->offset + file->uncompressed_size >
+		    cab->folder_buff_size) {
+			archive_set_error(&a->archive,
+			    ARCHIVE_ERRNO_FILE_FORMAT, "Invalid CFDATA");
+			return (ARCHIVE_FATAL);
+		}
+		*buff = cab->folder_buff + file->offset + cab->entry_offset;
+		*size = (size_t)cab->entry_bytes_remaining;
+		cab->entry_offset += cab->entry_bytes_remaining;
+		cab->entry_bytes_remaining = 0;
+		cab->end_of_entry = 1;
+		return (ARCHIVE_OK);
+	}
 	if (cab->read_data_invoked == 0) {
 		if (cab->bytes_skipped) {
 			if (cab->entry_cfdata == NULL) {
@@ -1073,10 +1160,14 @@ cab_checksum_cfdata_4(const void *p, size_t bytes, uint32_t seed)
 	u32num = (unsigned)bytes / 4;
 	sum = seed;
 	b = p;
-	for (;u32num > 0; --u32num) {
-		sum ^= archive_le32dec(b);
-		b += 4;
+	/* XOR is associative, so fold two words of each 64-bit load. */
+	for (;u32num >= 2; u32num -= 2) {
+		uint64_t x = archive_le64dec(b);
+		sum ^= (uint32_t)x ^ (uint32_t)(x >> 32);
+		b += 8;
 	}
+	if (u32num)
+		sum ^= archive_le32dec(b);
 	return (sum);
 }
 
@@ -1980,6 +2071,15 @@ archive_read_format_cab_read_data_skip(struct archive_read *a)
 		return (ARCHIVE_OK);
 	}
 
+	r = cab_decoded_folder(a);
+	if (r < 0)
+		return (ARCHIVE_FATAL);
+	if (r > 0) {
+		cab->entry_bytes_remaining = 0;
+		cab->end_of_entry_cleanup = cab->end_of_entry = 1;
+		return (ARCHIVE_OK);
+	}
+
 	if (cab->entry_unconsumed) {
 		/* Consume as much as the compressor actually used. */
 		r = (int)cab_consume_cfdata(a, cab->entry_unconsumed);
@@ -2015,6 +2115,432 @@ archive_read_format_cab_read_data_skip(struct archive_read *a)
 	return (ARCHIVE_OK);
 }
 
+/*
+ * Whether a folder can be decoded by a job: it must be compressed with
+ * LZX or MSZIP, not span cabinets, be small enough to hold in memory
+ * and not lie behind the current read position.
+ */
+static int
+folder_job_eligible(struct cab *cab, int fi)
+{
+	const struct cffolder *folder = &(cab->cfheader.folder_array[fi]);
+
+	if (cab->cfheader.flags & (PREV_CABINET | NEXT_CABINET))
+		return (0);
+	if (folder->cfdata_count == 0 ||
+	    folder->cfdata_count > PARALLEL_CFDATA_MAX)
+		return (0);
+	if (folder->cfdata_offset_in_cab < cab->cab_offset)
+		return (0);
+	switch (folder->comptype) {
+	case COMPTYPE_LZX:
+		return (folder->compdata >= SLOT_BASE &&
+		    folder->compdata <= SLOT_MAX);
+#ifdef HAVE_ZLIB_H
+	case COMPTYPE_MSZIP:
+		return (1);
+#endif
+	default:
+		return (0);
+	}
+}
+
+static int
+decode_folder_job_lzx(struct cab_folder_job *job)
+{
+	struct lzx_stream strm;
+	const unsigned char *p = job->raw;
+	size_t done = 0;
+	int i, r;
+
+	memset(&strm, 0, sizeof(strm));
+	if (lzx_decode_init(&strm, job->compdata) != ARCHIVE_OK) {
+		lzx_decode_free(&strm);
+		job->error_number = ARCHIVE_ERRNO_MISC;
+		archive_strcpy(&job->error_string,
+		    "Can't initialize LZX decompression.");
+		return (ARCHIVE_FATAL);
+	}
+	for (i = 0; i < job->cfdata_count; i++) {
+		uint16_t csize = archive_le16dec(p + CFDATA_cbData);
+		uint16_t usize = archive_le16dec(p + CFDATA_cbUncomp);
+
+		lzx_cleanup_bitstream(&strm);
+		strm.next_in = p + job->cfdata_hdr_size;
+		strm.avail_in = csize;
+		strm.total_in = 0;
+		strm.next_out = job->out + done;
+		strm.avail_out = usize;
+		strm.total_out = 0;
+		while (strm.total_out < usize) {
+			int64_t in = strm.avail_in, out = strm.total_out;
+
+			r = lzx_decode(&strm, 1);
+			if (r != ARCHIVE_OK && r != ARCHIVE_EOF) {
+				lzx_decode_free(&strm);
+				job->error_number = ARCHIVE_ERRNO_MISC;
+				archive_string_sprintf(&job->error_string,
+				    "LZX decompression failed (%d)", r);
+				return (ARCHIVE_FATAL);
+			}
+			if (in == strm.avail_in && out == strm.total_out) {
+				lzx_decode_free(&strm);
+				job->error_number = ARCHIVE_ERRNO_FILE_FORMAT;
+				archive_strcpy(&job->error_string,
+				    "Truncated CAB file data");
+				return (ARCHIVE_FATAL);
+			}
+		}
+		lzx_translation(&strm, job->out + done, usize,
+		    (uint32_t)i * 0x8000);
+		done += usize;
+		p += job->cfdata_hdr_size + csize;
+	}
+	lzx_decode_free(&strm);
+	return (ARCHIVE_OK);
+}
+
+#ifdef HAVE_ZLIB_H
+static int
+decode_folder_job_deflate(struct cab_folder_job *job)
+{
+	z_stream stream;
+	const unsigned char *p = job->raw;
+	size_t done = 0;
+	int i, r;
+
+	memset(&stream, 0, sizeof(stream));
+	r = inflateInit2(&stream, -15 /* Don't check for zlib header */);
+	if (r != Z_OK) {
+		job->error_number = ARCHIVE_ERRNO_MISC;
+		archive_strcpy(&job->error_string,
+		    "Can't initialize deflate decompression.");
+		return (ARCHIVE_FATAL);
+	}
+	for (i = 0; i < job->cfdata_count; i++) {
+		const unsigned char *d = p + job->cfdata_hdr_size;
+		uint16_t csize = archive_le16dec(p + CFDATA_cbData);
+		uint16_t usize = archive_le16dec(p + CFDATA_cbUncomp);
+
+		if (csize < 2 || d[0] != 0x43 || d[1] != 0x4b) {
+			inflateEnd(&stream);
+			job->error_number = ARCHIVE_ERRNO_MISC;
+			archive_strcpy(&job->error_string,
+			    "CFDATA incorrect(no MSZIP signature)");
+			return (ARCHIVE_FATAL);
+		}
+		stream.next_in = (Bytef *)(uintptr_t)(d + 2);
+		stream.avail_in = csize - 2;
+		stream.next_out = job->out + done;
+		stream.avail_out = usize;
+		stream.total_out = 0;
+		r = Z_OK;
+		while (r == Z_OK && stream.total_out < usize) {
+			r = inflate(&stream, 0);
+			if (r != Z_OK && r != Z_STREAM_END) {
+				inflateEnd(&stream);
+				job->error_number = r == Z_MEM_ERROR ?
+				    ENOMEM : ARCHIVE_ERRNO_MISC;
+				if (r == Z_MEM_ERROR)
+					archive_strcpy(&job->error_string,
+					    "Out of memory for deflate "
+					    "decompression");
+				else
+					archive_string_sprintf(
+					    &job->error_string,
+					    "Deflate decompression failed (%d)",
+					    r);
+				return (ARCHIVE_FATAL);
+			}
+		}
+		if (stream.total_out < usize) {
+			inflateEnd(&stream);
+			job->error_number = ARCHIVE_ERRNO_MISC;
+			archive_string_sprintf(&job->error_string,
+			    "Invalid uncompressed size (%d < %d)",
+			    (int)stream.total_out, usize);
+			return (ARCHIVE_FATAL);
+		}
+		/* The next CFDATA refers to this one as its dictionary. */
+		if (i + 1 < job->cfdata_count &&
+		    (inflateReset(&stream) != Z_OK ||
+		     inflateSetDictionary(&stream, job->out + done,
+		      usize) != Z_OK)) {
+			inflateEnd(&stream);
+			job->error_number = ARCHIVE_ERRNO_MISC;
+			archive_strcpy(&job->error_string,
+			    "Deflate decompression failed");
+			return (ARCHIVE_FATAL);
+		}
+		done += usize;
+		p += job->cfdata_hdr_size + csize;
+	}
+	inflateEnd(&stream);
+	return (ARCHIVE_OK);
+}
+#endif
+
+/*
+ * Verify and decode all CFDATA of a folder held in a job.
+ * This runs on a worker thread and touches nothing but the job.
+ */
+static void
+decode_folder_job(void *arg)
+{
+	struct cab_folder_job *job = (struct cab_folder_job *)arg;
+	const unsigned char *p = job->raw;
+	int i;
+
+	job->out = malloc(job->out_size);
+	if (job->out == NULL) {
+		job->status = ARCHIVE_FATAL;
+		job->error_number = ENOMEM;
+		archive_strcpy(&job->error_string,
+		    "No memory for CAB reader");
+		goto done;
+	}
+	for (i = 0; i < job->cfdata_count; i++) {
+		uint32_t sum = archive_le32dec(p + CFDATA_csum);
+		uint16_t csize = archive_le16dec(p + CFDATA_cbData);
+
+		if (sum != 0) {
+			uint32_t sum_calculated;
+
+			sum_calculated = cab_checksum_cfdata(
+			    p + job->cfdata_hdr_size, csize, 0);
+			sum_calculated = cab_checksum_cfdata(
+			    p + CFDATA_cbData, job->cfdata_hdr_size - 4,
+			    sum_calculated);
+#ifndef DONT_FAIL_ON_CRC_ERROR
+			if (sum_calculated != sum) {
+				job->status = ARCHIVE_FATAL;
+				job->error_number = ARCHIVE_ERRNO_FILE_FORMAT;
+				archive_string_sprintf(&job->error_string,
+				    "Checksum error CFDATA[%d] %" PRIx32 ":%"
+				    PRIx32 " in %d bytes", i, sum,
+				    sum_calculated, csize);
+				goto done;
+			}
+#endif
+		}
+		p += job->cfdata_hdr_size + csize;
+	}
+#ifdef HAVE_ZLIB_H
+	if (job->comptype == COMPTYPE_MSZIP)
+		job->status = decode_folder_job_deflate(job);
+	else
+#endif
+		job->status = decode_folder_job_lzx(job);
+done:
+	/* The CFDATA are no longer needed. */
+	free(job->raw);
+	job->raw = NULL;
+}
+
+/*
+ * Read all CFDATA of a folder into memory and hand them to the worker
+ * pool.  Without a pool, they are decoded right away instead.  A broken or truncated folder is recorded in its job, to be
+ * reported once the folder is read, and ends reading ahead.
+ */
+static int
+start_folder_job(struct archive_read *a, int fi)
+{
+	struct cab *cab = (struct cab *)(a->format->data);
+	const struct cffolder *folder = &(cab->cfheader.folder_array[fi]);
+	struct cab_folder_job *job = &(cab->jobs[fi % cab->threads]);
+	const unsigned char *p;
+	size_t alloc = 0;
+	int64_t skip;
+	int i, l;
+
+	l = 8;
+	if (cab->cfheader.flags & RESERVE_PRESENT)
+		l += cab->cfheader.cfdata;
+	job->folder = fi;
+	job->busy = 1;
+	job->status = ARCHIVE_OK;
+	job->raw = NULL;
+	job->raw_size = 0;
+	job->cfdata_count = folder->cfdata_count;
+	job->cfdata_hdr_size = l;
+	job->comptype = folder->comptype;
+	job->compdata = folder->compdata;
+	job->out = NULL;
+	job->out_size = 0;
+	archive_string_empty(&job->error_string);
+
+	skip = folder->cfdata_offset_in_cab - cab->cab_offset;
+	if (skip > 0) {
+		if (__archive_read_consume(a, skip) < 0)
+			goto failed;
+		cab->cab_offset += skip;
+	}
+	for (i = 0; i < folder->cfdata_count; i++) {
+		uint16_t csize, usize;
+
+		if ((p = __archive_read_ahead(a, l, NULL)) == NULL) {
+			truncated_error(a);
+			goto failed;
+		}
+		csize = archive_le16dec(p + CFDATA_cbData);
+		usize = archive_le16dec(p + CFDATA_cbUncomp);
+		/* The same sanity checks as cab_next_cfdata() makes. */
+		if (csize == 0 || csize > (0x8000+6144) ||
+		    usize == 0 || usize > 0x8000 ||
+		    (i + 1 < folder->cfdata_count && usize != 0x8000)) {
+			archive_set_error(&a->archive,
+			    ARCHIVE_ERRNO_FILE_FORMAT, "Invalid CFDATA");
+			goto failed;
+		}
+		if ((p = __archive_read_ahead(a, l + csize, NULL)) == NULL) {
+			archive_set_error(&a->archive,
+			    ARCHIVE_ERRNO_FILE_FORMAT,
+			    "Truncated CAB file data");
+			goto failed;
+		}
+		if (job->raw_size + l + csize > alloc) {
+			unsigned char *raw;
+
+			alloc = alloc ? alloc * 2 : (size_t)l + 0x8000 + 6144;
+			if (alloc < job->raw_size + l + csize)
+				alloc = job->raw_size + l + csize;
+			raw = realloc(job->raw, alloc);
+			if (raw == NULL) {
+				free(job->raw);
+				job->raw = NULL;
+				job->busy = 0;
+				archive_set_error(&a->archive, ENOMEM,
+				    "No memory for CAB reader");
+				return (ARCHIVE_FATAL);
+			}
+			job->raw = raw;
+		}
+		memcpy(job->raw + job->raw_size, p, l + csize);
+		job->raw_size += l + csize;
+		job->out_size += usize;
+		__archive_read_consume(a, l + csize);
+		cab->cab_offset += l + csize;
+	}
+
+	__archive_thread_pool_run(cab->pool, &job->task, decode_folder_job,
+	    job);
+	return (ARCHIVE_OK);
+failed:
+	free(job->raw);
+	job->raw = NULL;
+	job->status = ARCHIVE_FATAL;
+	job->error_number = archive_errno(&a->archive);
+	archive_strcpy(&job->error_string,
+	    archive_error_string(&a->archive) != NULL ?
+	    archive_error_string(&a->archive) : "Truncated CAB file data");
+	archive_clear_error(&a->archive);
+	cab->prefetch_failed = 1;
+	return (ARCHIVE_OK);
+}
+
+static void
+finish_folder_job(struct cab *cab, struct cab_folder_job *job)
+{
+	__archive_thread_pool_wait(cab->pool, &job->task);
+	job->busy = 0;
+}
+
+static void
+free_folder_jobs(struct cab *cab)
+{
+	int i;
+
+	if (cab->jobs != NULL) {
+		for (i = 0; i < cab->threads; i++) {
+			if (cab->jobs[i].busy)
+				finish_folder_job(cab, &(cab->jobs[i]));
+			free(cab->jobs[i].raw);
+			free(cab->jobs[i].out);
+			archive_string_free(&(cab->jobs[i].error_string));
+		}
+		free(cab->jobs);
+		cab->jobs = NULL;
+		__archive_thread_pool_free(cab->pool);
+		cab->pool = NULL;
+	}
+	free(cab->folder_buff);
+	cab->folder_buff = NULL;
+}
+
+/*
+ * Called when the data of an entry is first asked for.  With more
+ * than one thread, and unless the folder of the entry has already
+ * been partly read, read the CFDATA of that folder and of those
+ * following it ahead and decode them on worker threads.  Returns 1 if
+ * the folder has been decoded that way and its output is in
+ * cab->folder_buff, 0 if it must be decoded as usual.
+ */
+static int
+cab_decoded_folder(struct archive_read *a)
+{
+	struct cab *cab = (struct cab *)(a->format->data);
+	struct cab_folder_job *job;
+	int fi, i, k, r;
+
+	if (cab->folder_buff != NULL)
+		return (1);
+	if (cab->threads <= 1 || cab->entry_cfdata != NULL ||
+	    cab->entry_cffile->folder >= cab->cfheader.folder_count)
+		return (0);
+	k = cab->entry_cffile->folder;
+
+	if (cab->jobs == NULL) {
+		cab->jobs = calloc(cab->threads, sizeof(*cab->jobs));
+		if (cab->jobs == NULL) {
+			archive_set_error(&a->archive, ENOMEM,
+			    "No memory for CAB reader");
+			return (ARCHIVE_FATAL);
+		}
+		cab->pool = __archive_thread_pool_new(cab->threads);
+	}
+	/* Discard folders left behind. */
+	for (i = 0; i < cab->threads; i++) {
+		job = &(cab->jobs[i]);
+		if (job->busy && job->folder < k) {
+			finish_folder_job(cab, job);
+			free(job->out);
+			job->out = NULL;
+		}
+	}
+	if (cab->prefetch_next < k)
+		cab->prefetch_next = k;
+
+	job = &(cab->jobs[k % cab->threads]);
+	if (!job->busy && !folder_job_eligible(cab, k))
+		return (0);
+	while (!cab->prefetch_failed &&
+	    cab->prefetch_next < cab->cfheader.folder_count &&
+	    cab->prefetch_next - k < cab->threads) {
+		fi = cab->prefetch_next;
+		if (!folder_job_eligible(cab, fi))
+			break;
+		r = start_folder_job(a, fi);
+		if (r < 0)
+			return (r);
+		cab->prefetch_next++;
+	}
+	if (!job->busy || job->folder != k)
+		return (0);
+
+	finish_folder_job(cab, job);
+	if (job->status != ARCHIVE_OK) {
+		archive_set_error(&a->archive, job->error_number, "%s",
+		    job->error_string.s);
+		free(job->out);
+		job->out = NULL;
+		return (ARCHIVE_FATAL);
+	}
+	cab->folder_buff = job->out;
+	cab->folder_buff_size = job->out_size;
+	job->out = NULL;
+	return (1);
+}
+
 static int
 archive_read_format_cab_cleanup(struct archive_read *a)
 {
@@ -2037,6 +2563,7 @@ archive_read_format_cab_cleanup(struct archive_read *a)
 		inflateEnd(&cab->stream);
 #endif
 	lzx_decode_free(&cab->xstrm);
+	free_folder_jobs(cab);
 	archive_wstring_free(&cab->ws);
 	free(cab->uncompressed_buffer);
 	free(cab);
@@ -2110,7 +2637,9 @@ lzx_decode_init(struct lzx_stream *strm, int w_bits)
 	ds->w_mask = ds->w_size -1;
 	if (ds->w_buff == NULL || w_size != ds->w_size) {
 		free(ds->w_buff);
-		ds->w_buff = malloc(ds->w_size);
+		/* The copy in lzx_decode_blocks() may run up to eight
+		 * bytes past the end of the window. */
+		ds->w_buff = calloc(1, ds->w_size + 8);
 		if (ds->w_buff == NULL)
 			return (ARCHIVE_FATAL);
 		free(ds->pos_tbl);
@@ -2275,47 +2804,33 @@ lzx_br_fillup(struct lzx_stream *strm, struct lzx_br *br)
 	int n = CACHE_BITS - br->cache_avail;
 
 	for (;;) {
-		switch (n >> 4) {
-		case 4:
-			if (strm->avail_in >= 8) {
-				br->cache_buffer =
-				    ((uint64_t)strm->next_in[1]) << 56 |
-				    ((uint64_t)strm->next_in[0]) << 48 |
-				    ((uint64_t)strm->next_in[3]) << 40 |
-				    ((uint64_t)strm->next_in[2]) << 32 |
-				    ((uint32_t)strm->next_in[5]) << 24 |
-				    ((uint32_t)strm->next_in[4]) << 16 |
-				    ((uint32_t)strm->next_in[7]) << 8 |
-				     (uint32_t)strm->next_in[6];
-				strm->next_in += 8;
-				strm->avail_in -= 8;
-				br->cache_avail += 8 * 8;
-				return (1);
-			}
-			break;
-		case 3:
-			if (strm->avail_in >= 6) {
+		if (n >= 16 && strm->avail_in >= 8) {
+			/*
+			 * Load four 16-bit little-endian units at once,
+			 * put them in stream order and take as many as
+			 * the cache buffer has room for.
+			 */
+			uint64_t x = archive_le64dec(strm->next_in);
+			int units = n >> 4;
+
+			x = ((x >> 16) & 0x0000FFFF0000FFFFULL) |
+			    ((x & 0x0000FFFF0000FFFFULL) << 16);
+			x = (x >> 32) | (x << 32);
+			if (units == 4)
+				br->cache_buffer = x;
+			else
 				br->cache_buffer =
-		 		   (br->cache_buffer << 48) |
-				    ((uint64_t)strm->next_in[1]) << 40 |
-				    ((uint64_t)strm->next_in[0]) << 32 |
-				    ((uint64_t)strm->next_in[3]) << 24 |
-				    ((uint64_t)strm->next_in[2]) << 16 |
-				    ((uint64_t)strm->next_in[5]) << 8 |
-				     (uint64_t)strm->next_in[4];
-				strm->next_in += 6;
-				strm->avail_in -= 6;
-				br->cache_avail += 6 * 8;
-				return (1);
-			}
-			break;
-		case 0:
+				    (br->cache_buffer << (units * 16)) |
+				    (x >> (64 - units * 16));
+			strm->next_in += units * 2;
+			strm->avail_in -= units * 2;
+			br->cache_avail += units * 16;
+			return (1);
+		}
+		if (n < 16)
 			/* We have enough compressed data in
 			 * the cache buffer.*/
 			return (1);
-		default:
-			break;
-		}
 		if (strm->avail_in < 2) {
 			/* There is not enough compressed data to
 			 * fill up the cache buffer. */
@@ -2744,6 +3259,22 @@ failed:
 	return (ds->error = ARCHIVE_FAILED);
 }
 
+/*
+ * Copy the last 'size' bytes decoded into the window to 'out'.
+ */
+static void
+lzx_window_out(const struct lzx_dec *ds, unsigned char *out, size_t size)
+{
+	size_t start, l;
+
+	start = (ds->w_pos - size) & ds->w_mask;
+	l = ds->w_size - start;
+	if (l > size)
+		l = size;
+	memcpy(out, ds->w_buff + start, l);
+	memcpy(out + l, ds->w_buff, size - l);
+}
+
 static int
 lzx_decode_blocks(struct lzx_stream *strm, int last)
 {
@@ -2751,6 +3282,11 @@ lzx_decode_blocks(struct lzx_stream *strm, int last)
 	struct lzx_br bre = ds->br;
 	struct huffman *at = &(ds->at), *lt = &(ds->lt), *mt = &(ds->mt);
 	const struct lzx_pos_tbl *pos_tbl = ds->pos_tbl;
+	/*
+	 * Codes are decoded into the window only; noutp just tracks the
+	 * output position, and what was decoded is copied out of the
+	 * window in one go when we return.
+	 */
 	unsigned char *noutp = strm->next_out;
 	unsigned char *endp = noutp + strm->avail_out;
 	unsigned char *w_buff = ds->w_buff;
@@ -2786,6 +3322,8 @@ lzx_decode_blocks(struct lzx_stream *strm, int last)
 					ds->position_slot = position_slot;
 					ds->r0 = r0; ds->r1 = r1; ds->r2 = r2;
 					ds->w_pos = w_pos;
+					lzx_window_out(ds, strm->next_out,
+					    noutp - strm->next_out);
 					strm->avail_out = endp - noutp;
 					return (ARCHIVE_EOF);
 				}
@@ -2822,8 +3360,7 @@ lzx_decode_blocks(struct lzx_stream *strm, int last)
 				 * afterward. */
 				w_buff[w_pos] = c;
 				w_pos = (w_pos + 1) & w_mask;
-				/* Store the decoded code to output buffer. */
-				*noutp++ = c;
+				noutp++;
 				block_bytes_avail--;
 			}
 			/*
@@ -2953,12 +3490,13 @@ lzx_decode_blocks(struct lzx_stream *strm, int last)
 			/* FALL THROUGH */
 		case ST_COPY:
 			/*
-			 * Copy several bytes as extracted data from the window
-			 * into the output buffer.
+			 * Copy several bytes of extracted data within
+			 * the window.
 			 */
 			for (;;) {
 				const unsigned char *s;
-				int l;
+				unsigned char *d;
+				int l, li;
 
 				l = copy_len;
 				if (copy_pos > w_pos) {
@@ -2971,17 +3509,20 @@ lzx_decode_blocks(struct lzx_stream *strm, int last)
 				if (noutp + l >= endp)
 					l = (int)(endp - noutp);
 				s = w_buff + copy_pos;
-				if (l >= 8 && ((copy_pos + l < w_pos)
-				  || (w_pos + l < copy_pos))) {
-					memcpy(w_buff + w_pos, s, l);
-					memcpy(noutp, s, l);
+				d = w_buff + w_pos;
+				if (((w_pos - copy_pos) & w_mask) >= 8 &&
+				    ((copy_pos - w_pos) & w_mask) >= 8) {
+					/* Copy eight bytes at a time; the bytes
+					 * written past the end are put back. */
+					unsigned char keep[8];
+
+					memcpy(keep, d + l, 8);
+					for (li = 0; li < l; li += 8)
+						memcpy(d + li, s + li, 8);
+					memcpy(d + l, keep, 8);
 				} else {
-					unsigned char *d;
-					int li;
-
-					d = w_buff + w_pos;
 					for (li = 0; li < l; li++)
-						noutp[li] = d[li] = s[li];
+						d[li] = s[li];
 				}
 				noutp += l;
 				copy_pos = (copy_pos + l) & w_mask;
@@ -3014,6 +3555,7 @@ next_data:
 	ds->r0 = r0; ds->r1 = r1; ds->r2 = r2;
 	ds->state = state;
 	ds->w_pos = w_pos;
+	lzx_window_out(ds, strm->next_out, noutp - strm->next_out);
 	strm->avail_out = endp - noutp;
 	return (ARCHIVE_OK);
 }
@@ -3134,7 +3676,12 @@ lzx_huffman_init(struct huffman *hf, size_t len_size, int tbl_bits)
 	} else
 		memset(hf->bitlen, 0, len_size *  sizeof(hf->bitlen[0]));
 	if (hf->tbl == NULL) {
-		hf->tbl = malloc(((size_t)1 << tbl_bits) * sizeof(hf->tbl[0]));
+		size_t tbl_size = (size_t)1 << tbl_bits;
+
+		/* Room for the second-level tables. */
+		if (tbl_bits > HTBL_BITS)
+			tbl_size += (size_t)1 << HTBL_BITS;
+		hf->tbl = malloc(tbl_size * sizeof(hf->tbl[0]));
 		if (hf->tbl == NULL)
 			return (ARCHIVE_FATAL);
 		hf->tbl_bits = tbl_bits;
@@ -3151,6 +3698,11 @@ lzx_huffman_free(struct huffman *hf)
 
 /*
  * Make a huffman coding table.
+ *
+ * Codes up to HTBL_BITS long are looked up directly with the leading
+ * HTBL_BITS bits.  When longer codes are used, their first-level entry
+ * holds len_size plus the number of a second-level table, which is
+ * indexed by the remaining max_bits - HTBL_BITS bits.
  */
 static int
 lzx_make_huffman_table(struct huffman *hf)
@@ -3159,7 +3711,7 @@ lzx_make_huffman_table(struct huffman *hf)
 	const unsigned char *bitlen;
 	int bitptn[17], weight[17];
 	int i, maxbits = 0, ptn, tbl_size, w;
-	int len_avail;
+	int len_avail, sub_bits, sub_count;
 
 	/*
 	 * Initialize bit patterns.
@@ -3177,6 +3729,8 @@ lzx_make_huffman_table(struct huffman *hf)
 		return (0);/* Invalid */
 
 	hf->max_bits = maxbits;
+	sub_bits = maxbits > HTBL_BITS ? maxbits - HTBL_BITS : 0;
+	hf->sub_bits = sub_bits;
 
 	/*
 	 * Cut out extra bits which we won't house in the table.
@@ -3194,11 +3748,16 @@ lzx_make_huffman_table(struct huffman *hf)
 	/*
 	 * Make the table.
 	 */
-	tbl_size = 1 << hf->tbl_bits;
+	tbl_size = 1 << maxbits;
 	tbl = hf->tbl;
 	bitlen = hf->bitlen;
 	len_avail = hf->len_size;
 	hf->tree_used = 0;
+	sub_count = 0;
+	/* An empty tree decodes nothing but symbol 0. */
+	tbl[0] = 0;
+	if (sub_bits)
+		memset(tbl, 0xff, sizeof(tbl[0]) << HTBL_BITS);
 	for (i = 0; i < len_avail; i++) {
 		uint16_t *p;
 		int len, cnt;
@@ -3207,7 +3766,7 @@ lzx_make_huffman_table(struct huffman *hf)
 			continue;
 		/* Get a bit pattern */
 		len = bitlen[i];
-		if (len > tbl_size)
+		if (len > maxbits)
 			return (0);
 		ptn = bitptn[len];
 		cnt = weight[len];
@@ -3215,7 +3774,18 @@ lzx_make_huffman_table(struct huffman *hf)
 		if ((bitptn[len] = ptn + cnt) > tbl_size)
 			return (0);/* Invalid */
 		/* Update the table */
-		p = &(tbl[ptn]);
+		if (len <= HTBL_BITS) {
+			p = &(tbl[ptn >> sub_bits]);
+			cnt >>= sub_bits;
+		} else {
+			uint16_t *e = &(tbl[ptn >> sub_bits]);
+
+			if (*e == 0xffff)
+				*e = (uint16_t)(len_avail + sub_count++);
+			p = &(tbl[(1 << HTBL_BITS) +
+			    ((*e - len_avail) << sub_bits) +
+			    (ptn & ((1 << sub_bits) - 1))]);
+		}
 		while (--cnt >= 0)
 			p[cnt] = (uint16_t)i;
 	}
@@ -3226,7 +3796,13 @@ static inline int
 lzx_decode_huffman(struct huffman *hf, unsigned rbits)
 {
 	int c;
-	c = hf->tbl[rbits];
+	c = hf->tbl[rbits >> hf->sub_bits];
+	if (c < hf->len_size)
+		return (c);
+	if (hf->sub_bits == 0)
+		return (0);
+	c = hf->tbl[(1 << HTBL_BITS) + ((c - hf->len_size) << hf->sub_bits) +
+	    (rbits & ((1 << hf->sub_bits) - 1))];
 	if (c < hf->len_size)
 		return (c);
 	return (0);
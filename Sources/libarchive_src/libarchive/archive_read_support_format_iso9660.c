@@ -50,6 +50,7 @@
 #include "archive_private.h"
 #include "archive_read_private.h"
 #include "archive_string.h"
+#include "archive_thread_private.h"
 
 /*
  * An overview of ISO 9660 format:
@@ -73,7 +74,7 @@
  * sector.  At each step, I look for the earliest dir entry that
  * hasn't yet been read, seek forward to that location and read
  * that entry.  If it's a dir, I slurp in the new dir entries and
- * add them to the heap; if it's a regular file, I return the
+ * add them to the extent table; if it's a regular file, I return the
  * corresponding archive_entry and wait for the client to request
  * the file body.  This strategy allows us to read most compliant
  * CDs with a single pass through the data, as required by libarchive.
@@ -219,6 +220,26 @@ static const unsigned char zisofs_magic[8] = {
 	0x37, 0xE4, 0x53, 0x96, 0xC9, 0xDB, 0xD6, 0x07
 };
 
+/*
+ * A share of the blocks of a zisofs batch, inflated by a worker
+ * thread or by the calling thread.
+ */
+struct zisofs_job {
+	struct archive_thread_task task;
+	z_stream	 stream;
+	int		 stream_valid;
+	/* Compressed data of the batch; in[0] is at zisofs offset base. */
+	const unsigned char *in;
+	uint32_t	 base;
+	const unsigned char *block_pointers;
+	unsigned char	*out;
+	size_t		*out_sizes;
+	int		 log2_bs;
+	int		 first;
+	int		 end;
+	int		 status;
+};
+
 struct zisofs {
 	/* Set 1 if this file compressed by paged zlib */
 	int		 pz;
@@ -242,6 +263,13 @@ struct zisofs {
 
 	z_stream	 stream;
 	int		 stream_valid;
+
+	/* Inflating several blocks at a time with "threads" option. */
+	struct zisofs_job *jobs;
+	struct archive_thread_pool *pool;
+	unsigned char	*batch_buffer;
+	size_t		 batch_buffer_size;
+	size_t		*batch_sizes;
 };
 #else
 struct zisofs {
@@ -263,7 +291,7 @@ struct file_info {
 	struct file_info	*next;
 	struct file_info	*re_next;
 	int		 subdirs;
-	uint64_t	 key;		/* Heap Key.			*/
+	uint64_t	 key;		/* Extent table key.		*/
 	uint64_t	 offset;	/* Offset on disk.		*/
 	uint64_t	 size;		/* File size in bytes.		*/
 	uint32_t	 ce_offset;	/* Offset of CE.		*/
@@ -311,10 +339,34 @@ struct file_info {
 #define ATIME_IS_SET 4
 #define CTIME_IS_SET 8
 
-struct heap_queue {
-	struct file_info **files;
+/*
+ * Directory records waiting for their extents to come up.
+ *
+ * The children of each directory are appended to one flat table.
+ * When the next entry is wanted, the slice appended since the last
+ * time is sorted by key (writers almost always record the children
+ * in extent order already, so this is usually just a check) and
+ * becomes a run.  Only the heads of the runs are kept in a binary
+ * heap, so taking the next extent compares keys stored in the table
+ * among a few hundred runs rather than chasing pointers through a
+ * heap holding every file on the volume.
+ */
+struct extent_table {
+	struct pending_extent {
+		uint64_t	 key;
+		struct file_info *file;
+	}		*extents;
 	int		 allocated;
 	int		 used;
+	int		 sorted;	/* extents[sorted..used) are new. */
+	int		 pending;	/* Entries not taken yet. */
+	struct extent_run {
+		uint64_t	 key;	/* Key of extents[next]. */
+		int		 next;
+		int		 end;
+	}		*runs;		/* Binary heap by key. */
+	int		 runs_allocated;
+	int		 runs_used;
 };
 
 struct iso9660 {
@@ -323,6 +375,7 @@ struct iso9660 {
 
 	int opt_support_joliet;
 	int opt_support_rockridge;
+	int threads;
 
 	struct archive_string pathname;
 	char	seenRockridge;	/* Set true if RR extensions are used. */
@@ -344,7 +397,7 @@ struct iso9660 {
 	struct archive_string previous_pathname;
 
 	struct file_info		*use_files;
-	struct heap_queue		 pending_files;
+	struct extent_table		 pending_files;
 	struct {
 		struct file_info	*first;
 		struct file_info	**last;
@@ -444,14 +497,18 @@ static inline struct file_info * rede_get_entry(struct file_info *);
 static inline void cache_add_entry(struct iso9660 *iso9660,
 		    struct file_info *file);
 static inline struct file_info *cache_get_entry(struct iso9660 *iso9660);
-static int	heap_add_entry(struct archive_read *a, struct heap_queue *heap,
-		    struct file_info *file, uint64_t key);
-static struct file_info *heap_get_entry(struct heap_queue *heap);
+static int	extent_add_entry(struct archive_read *a,
+		    struct extent_table *tbl, struct file_info *file,
+		    uint64_t key);
+static struct file_info *extent_get_entry(struct extent_table *tbl);
+static struct file_info *extent_peek_entry(struct extent_table *tbl);
 
 #define add_entry(arch, iso9660, file)	\
-	heap_add_entry(arch, &((iso9660)->pending_files), file, file->offset)
+	extent_add_entry(arch, &((iso9660)->pending_files), file, file->offset)
 #define next_entry(iso9660)		\
-	heap_get_entry(&((iso9660)->pending_files))
+	extent_get_entry(&((iso9660)->pending_files))
+#define peek_entry(iso9660)		\
+	extent_peek_entry(&((iso9660)->pending_files))
 
 int
 archive_read_support_format_iso9660(struct archive *_a)
@@ -478,6 +535,7 @@ archive_read_support_format_iso9660(struct archive *_a)
 	iso9660->opt_support_joliet = 1;
 	/* Enable to support Rock Ridge extensions by default.	*/
 	iso9660->opt_support_rockridge = 1;
+	iso9660->threads = 1;
 
 	r = __archive_read_register_format(a,
 	    iso9660,
@@ -595,6 +653,9 @@ archive_read_format_iso9660_options(struct archive_read *a,
 		iso9660->opt_support_rockridge = val != NULL;
 		return (ARCHIVE_OK);
 	}
+	if (strcmp(key, "threads") == 0)
+		return (__archive_thread_parse_count(&a->archive, val,
+		    &iso9660->threads));
 
 	/* Note: The "warn" return is just to inform the options
 	 * supervisor that we didn't handle it.  It will generate
@@ -1495,6 +1556,199 @@ archive_read_format_iso9660_read_data_skip(struct archive_read *a)
 
 #ifdef HAVE_ZLIB_H
 
+/*
+ * Upper bounds of a zisofs batch: blocks per thread and the total
+ * size of its uncompressed data.
+ */
+#define ZISOFS_BATCH_BLOCKS	8
+#define ZISOFS_BATCH_MAX	(8 * 1024 * 1024)
+
+/*
+ * Inflate the blocks [first, end) of a batch, each into its own
+ * slot of the output buffer.
+ * This runs on a worker thread and touches nothing but the job.
+ */
+static void
+zisofs_inflate_job(void *arg)
+{
+	struct zisofs_job *job = (struct zisofs_job *)arg;
+	size_t bs = (size_t)1 << job->log2_bs;
+	int i, r;
+
+	job->status = Z_OK;
+	for (i = job->first; i < job->end; i++) {
+		uint32_t bst, bed;
+
+		bst = archive_le32dec(job->block_pointers + i * 4);
+		bed = archive_le32dec(job->block_pointers + i * 4 + 4);
+		if (bst == bed) {
+			/* An empty block stands for a block of zeros. */
+			memset(job->out + i * bs, 0, bs);
+			job->out_sizes[i] = bs;
+			continue;
+		}
+		if (job->stream_valid)
+			r = inflateReset(&job->stream);
+		else
+			r = inflateInit(&job->stream);
+		if (r != Z_OK) {
+			job->status = r;
+			return;
+		}
+		job->stream_valid = 1;
+		job->stream.next_in =
+		    (Bytef *)(uintptr_t)(const void *)(job->in + (bst - job->base));
+		job->stream.avail_in = bed - bst;
+		job->stream.next_out = job->out + i * bs;
+		job->stream.avail_out = (uInt)bs;
+		r = inflate(&job->stream, 0);
+		if (r != Z_OK && r != Z_STREAM_END) {
+			job->status = r;
+			return;
+		}
+		/* A block must not inflate to more than the block size. */
+		if (job->stream.avail_in != 0) {
+			job->status = Z_DATA_ERROR;
+			return;
+		}
+		job->out_sizes[i] = bs - job->stream.avail_out;
+	}
+}
+
+/*
+ * With more than one thread, read the compressed data of the next
+ * several blocks ahead and inflate them at the same time; zisofs
+ * blocks are independent zlib streams.  Returns 1 if a batch has been
+ * inflated, 0 if the next block must be inflated as usual, which is
+ * also how damaged block pointers and truncated data get reported.
+ */
+static int
+zisofs_read_batch(struct archive_read *a,
+    const void **buff, size_t *size, int64_t *offset)
+{
+	struct iso9660 *iso9660;
+	struct zisofs  *zisofs;
+	const unsigned char *bp, *p;
+	uint32_t bst, bed, prev;
+	size_t bs, total;
+	int i, n, t, threads;
+
+	iso9660 = (struct iso9660 *)(a->format->data);
+	zisofs = &iso9660->entry_zisofs;
+	threads = iso9660->threads;
+
+	/* zisofs only defines 32, 64 and 128 KiB blocks. */
+	if (zisofs->pz_log2_bs < 15 || zisofs->pz_log2_bs > 17)
+		return (0);
+	bs = (size_t)1 << zisofs->pz_log2_bs;
+	n = (int)((zisofs->block_pointers_size - zisofs->block_off) / 4) - 1;
+	if (n > threads * ZISOFS_BATCH_BLOCKS)
+		n = threads * ZISOFS_BATCH_BLOCKS;
+	if (n > (int)(ZISOFS_BATCH_MAX / bs))
+		n = (int)(ZISOFS_BATCH_MAX / bs);
+	if (n < 2)
+		return (0);
+
+	bp = zisofs->block_pointers + zisofs->block_off;
+	bst = bed = prev = archive_le32dec(bp);
+	if (bst != zisofs->pz_offset)
+		return (0);
+	for (i = 1; i <= n; i++) {
+		bed = archive_le32dec(bp + i * 4);
+		if (bed < prev)
+			return (0);
+		prev = bed;
+	}
+	if ((int64_t)(bed - bst) > iso9660->entry_bytes_remaining)
+		return (0);
+	/*
+	 * The block pointers come from the image; don't read more ahead
+	 * than n blocks can take even when zlib can't compress them.
+	 */
+	if ((uint64_t)(bed - bst) > (uint64_t)n * compressBound((uLong)bs))
+		return (0);
+	p = NULL;
+	if (bed > bst &&
+	    (p = __archive_read_ahead(a, bed - bst, NULL)) == NULL)
+		return (0);
+
+	if (zisofs->jobs == NULL) {
+		zisofs->jobs = calloc(threads, sizeof(*zisofs->jobs));
+		zisofs->batch_sizes = calloc(
+		    threads * ZISOFS_BATCH_BLOCKS, sizeof(size_t));
+		if (zisofs->jobs == NULL || zisofs->batch_sizes == NULL) {
+			archive_set_error(&a->archive, ENOMEM,
+			    "No memory for zisofs decompression");
+			return (ARCHIVE_FATAL);
+		}
+		/* The calling thread inflates a share itself. */
+		zisofs->pool = __archive_thread_pool_new(threads - 1);
+	}
+	if (zisofs->batch_buffer_size < n * bs) {
+		free(zisofs->batch_buffer);
+		zisofs->batch_buffer_size = 0;
+		zisofs->batch_buffer = malloc(n * bs);
+		if (zisofs->batch_buffer == NULL) {
+			archive_set_error(&a->archive, ENOMEM,
+			    "No memory for zisofs decompression");
+			return (ARCHIVE_FATAL);
+		}
+		zisofs->batch_buffer_size = n * bs;
+	}
+
+	/* Hand a run of blocks to each thread; the last one is ours. */
+	for (t = 0; t < threads; t++) {
+		struct zisofs_job *job = &(zisofs->jobs[t]);
+
+		job->in = p;
+		job->base = bst;
+		job->block_pointers = bp;
+		job->out = zisofs->batch_buffer;
+		job->out_sizes = zisofs->batch_sizes;
+		job->log2_bs = zisofs->pz_log2_bs;
+		job->first = (int)((int64_t)n * t / threads);
+		job->end = (int)((int64_t)n * (t + 1) / threads);
+		job->status = Z_OK;
+		if (job->first == job->end || t == threads - 1)
+			continue;
+		__archive_thread_pool_run(zisofs->pool, &job->task,
+		    zisofs_inflate_job, job);
+	}
+	zisofs_inflate_job(&(zisofs->jobs[threads - 1]));
+	for (t = 0; t < threads; t++)
+		__archive_thread_pool_wait(zisofs->pool,
+		    &(zisofs->jobs[t].task));
+	for (t = 0; t < threads; t++) {
+		if (zisofs->jobs[t].status != Z_OK) {
+			archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
+			    "zisofs decompression failed (%d)",
+			    zisofs->jobs[t].status);
+			return (ARCHIVE_FATAL);
+		}
+	}
+
+	/* Close up the gap a short block left. */
+	total = 0;
+	for (i = 0; i < n; i++) {
+		if (total != i * bs)
+			memmove(zisofs->batch_buffer + total,
+			    zisofs->batch_buffer + i * bs,
+			    zisofs->batch_sizes[i]);
+		total += zisofs->batch_sizes[i];
+	}
+
+	*buff = zisofs->batch_buffer;
+	*size = total;
+	*offset = iso9660->entry_sparse_offset;
+	iso9660->entry_sparse_offset += total;
+	iso9660->entry_bytes_remaining -= bed - bst;
+	iso9660->current_position += bed - bst;
+	zisofs->pz_offset += bed - bst;
+	iso9660->entry_bytes_unconsumed += bed - bst;
+	zisofs->block_off += n * 4;
+	return (1);
+}
+
 static int
 zisofs_read_data(struct archive_read *a,
     const void **buff, size_t *size, int64_t *offset)
@@ -1510,6 +1764,15 @@ zisofs_read_data(struct archive_read *a,
 	iso9660 = (struct iso9660 *)(a->format->data);
 	zisofs = &iso9660->entry_zisofs;
 
+	if (iso9660->threads > 1 && zisofs->initialized &&
+	    zisofs->block_avail == 0) {
+		r = zisofs_read_batch(a, buff, size, offset);
+		if (r < 0)
+			return (r);
+		if (r > 0)
+			return (ARCHIVE_OK);
+	}
+
 	p = __archive_read_ahead(a, 1, &bytes_read);
 	if (bytes_read <= 0) {
 		archive_set_error(&a->archive, ARCHIVE_ERRNO_FILE_FORMAT,
@@ -1813,10 +2076,29 @@ archive_read_format_iso9660_cleanup(struct archive_read *a)
 	free(iso9660->read_ce_req.reqs);
 	archive_string_free(&iso9660->pathname);
 	archive_string_free(&iso9660->previous_pathname);
-	free(iso9660->pending_files.files);
+	free(iso9660->pending_files.extents);
+	free(iso9660->pending_files.runs);
 #ifdef HAVE_ZLIB_H
 	free(iso9660->entry_zisofs.uncompressed_buffer);
 	free(iso9660->entry_zisofs.block_pointers);
+	__archive_thread_pool_free(iso9660->entry_zisofs.pool);
+	if (iso9660->entry_zisofs.jobs != NULL) {
+		int i;
+
+		for (i = 0; i < iso9660->threads; i++) {
+			if (iso9660->entry_zisofs.jobs[i].stream_valid &&
+			    inflateEnd(&iso9660->entry_zisofs.jobs[i].stream)
+			    != Z_OK) {
+				archive_set_error(&a->archive,
+				    ARCHIVE_ERRNO_MISC,
+				    "Failed to clean up zlib decompressor");
+				r = ARCHIVE_FATAL;
+			}
+		}
+		free(iso9660->entry_zisofs.jobs);
+	}
+	free(iso9660->entry_zisofs.batch_buffer);
+	free(iso9660->entry_zisofs.batch_sizes);
 	if (iso9660->entry_zisofs.stream_valid) {
 		if (inflateEnd(&iso9660->entry_zisofs.stream) != Z_OK) {
 			archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
@@ -2837,7 +3119,7 @@ static int
 next_cache_entry(struct archive_read *a, struct iso9660 *iso9660,
     struct file_info **pfile)
 {
-	struct file_info *file;
+	struct file_info *file, *peek;
 	struct {
 		struct file_info	*first;
 		struct file_info	**last;
@@ -2982,9 +3264,8 @@ next_cache_entry(struct archive_read *a, struct iso9660 *iso9660,
 	/* Collect files which has the same file serial number.
 	 * Peek pending_files so that file which number is different
 	 * is not put back. */
-	while (iso9660->pending_files.used > 0 &&
-	    (iso9660->pending_files.files[0]->number == -1 ||
-	     iso9660->pending_files.files[0]->number == number)) {
+	while ((peek = peek_entry(iso9660)) != NULL &&
+	    (peek->number == -1 || peek->number == number)) {
 		if (file->number == -1) {
 			/* This file has the same offset
 			 * but it's wrong offset which empty files
@@ -3122,112 +3403,192 @@ cache_get_entry(struct iso9660 *iso9660)
 }
 
 static int
-heap_add_entry(struct archive_read *a, struct heap_queue *heap,
+extent_cmp(const void *p1, const void *p2)
+{
+	const struct pending_extent *e1 = (const struct pending_extent *)p1;
+	const struct pending_extent *e2 = (const struct pending_extent *)p2;
+
+	if (e1->key < e2->key)
+		return (-1);
+	return (e1->key > e2->key);
+}
+
+static int
+extent_add_entry(struct archive_read *a, struct extent_table *tbl,
     struct file_info *file, uint64_t key)
 {
-	uint64_t file_key, parent_key;
-	int hole, parent;
+	struct pending_extent *e;
 
 	/* Reserve 16 bits for possible key collisions (needed for linked items) */
 	/* For ISO files with more than 65535 entries, reordering will still occur */
 	key <<= 16;
-	key += heap->used & 0xFFFF;
+	key += tbl->pending & 0xFFFF;
 
 	/* Expand our pending files list as necessary. */
-	if (heap->used >= heap->allocated) {
-		struct file_info **new_pending_files;
-		int new_size = heap->allocated * 2;
+	if (tbl->used >= tbl->allocated) {
+		struct pending_extent *new_extents;
+		int new_size = tbl->allocated * 2;
 
-		if (heap->allocated < 1024)
+		if (tbl->allocated < 1024)
 			new_size = 1024;
 		/* Overflow might keep us from growing the list. */
-		if (new_size <= heap->allocated) {
+		if (new_size <= tbl->allocated) {
 			archive_set_error(&a->archive,
 			    ENOMEM, "Out of memory");
 			return (ARCHIVE_FATAL);
 		}
-		new_pending_files = (struct file_info **)
-		    calloc(new_size, sizeof(new_pending_files[0]));
-		if (new_pending_files == NULL) {
+		new_extents = (struct pending_extent *)
+		    calloc(new_size, sizeof(new_extents[0]));
+		if (new_extents == NULL) {
 			archive_set_error(&a->archive,
 			    ENOMEM, "Out of memory");
 			return (ARCHIVE_FATAL);
 		}
-		if (heap->allocated)
-			memcpy(new_pending_files, heap->files,
-			    heap->allocated * sizeof(new_pending_files[0]));
-		free(heap->files);
-		heap->files = new_pending_files;
-		heap->allocated = new_size;
+		if (tbl->allocated)
+			memcpy(new_extents, tbl->extents,
+			    tbl->used * sizeof(new_extents[0]));
+		free(tbl->extents);
+		tbl->extents = new_extents;
+		tbl->allocated = new_size;
 	}
+	/*
+	 * The first entry of a new slice will need a run of its own;
+	 * make room for it now so that taking entries cannot fail.
+	 */
+	if (tbl->sorted == tbl->used &&
+	    tbl->runs_used >= tbl->runs_allocated) {
+		struct extent_run *new_runs;
+		int new_size = tbl->runs_allocated * 2;
+
+		if (tbl->runs_allocated < 64)
+			new_size = 64;
+		if (new_size <= tbl->runs_allocated) {
+			archive_set_error(&a->archive,
+			    ENOMEM, "Out of memory");
+			return (ARCHIVE_FATAL);
+		}
+		new_runs = (struct extent_run *)
+		    calloc(new_size, sizeof(new_runs[0]));
+		if (new_runs == NULL) {
+			archive_set_error(&a->archive,
+			    ENOMEM, "Out of memory");
+			return (ARCHIVE_FATAL);
+		}
+		if (tbl->runs_allocated)
+			memcpy(new_runs, tbl->runs,
+			    tbl->runs_used * sizeof(new_runs[0]));
+		free(tbl->runs);
+		tbl->runs = new_runs;
+		tbl->runs_allocated = new_size;
+	}
+
+	file->key = key;
+	e = &tbl->extents[tbl->used++];
+	e->key = key;
+	e->file = file;
+	tbl->pending++;
+
+	return (ARCHIVE_OK);
+}
 
-	file_key = file->key = key;
+/*
+ * Turn the entries added since the last call into a run and
+ * push it onto the heap of runs.
+ */
+static void
+extent_sort_new_entries(struct extent_table *tbl)
+{
+	struct pending_extent *e;
+	struct extent_run run;
+	int i, hole, parent;
+
+	if (tbl->sorted == tbl->used)
+		return;
+	e = tbl->extents;
+	for (i = tbl->sorted + 1; i < tbl->used; i++) {
+		if (e[i].key < e[i - 1].key) {
+			qsort(e + tbl->sorted, tbl->used - tbl->sorted,
+			    sizeof(e[0]), extent_cmp);
+			break;
+		}
+	}
+	run.key = e[tbl->sorted].key;
+	run.next = tbl->sorted;
+	run.end = tbl->used;
+	tbl->sorted = tbl->used;
 
 	/*
 	 * Start with hole at end, walk it up tree to find insertion point.
 	 */
-	hole = heap->used++;
+	hole = tbl->runs_used++;
 	while (hole > 0) {
 		parent = (hole - 1)/2;
-		parent_key = heap->files[parent]->key;
-		if (file_key >= parent_key) {
-			heap->files[hole] = file;
-			return (ARCHIVE_OK);
-		}
+		if (run.key >= tbl->runs[parent].key)
+			break;
 		/* Move parent into hole <==> move hole up tree. */
-		heap->files[hole] = heap->files[parent];
+		tbl->runs[hole] = tbl->runs[parent];
 		hole = parent;
 	}
-	heap->files[0] = file;
+	tbl->runs[hole] = run;
+}
 
-	return (ARCHIVE_OK);
+static struct file_info *
+extent_peek_entry(struct extent_table *tbl)
+{
+
+	extent_sort_new_entries(tbl);
+	if (tbl->runs_used < 1)
+		return (NULL);
+	return (tbl->extents[tbl->runs[0].next].file);
 }
 
 static struct file_info *
-heap_get_entry(struct heap_queue *heap)
+extent_get_entry(struct extent_table *tbl)
 {
-	uint64_t a_key, b_key, c_key;
+	struct extent_run run;
+	struct file_info *r;
 	int a, b, c;
-	struct file_info *r, *tmp;
 
-	if (heap->used < 1)
+	extent_sort_new_entries(tbl);
+	if (tbl->runs_used < 1)
 		return (NULL);
 
 	/*
-	 * The first file in the list is the earliest; we'll return this.
+	 * The head of the first run is the earliest; we'll return this.
 	 */
-	r = heap->files[0];
-
-	/*
-	 * Move the last item in the heap to the root of the tree
-	 */
-	heap->files[0] = heap->files[--(heap->used)];
+	run = tbl->runs[0];
+	r = tbl->extents[run.next++].file;
+	tbl->pending--;
+	if (run.next < run.end)
+		run.key = tbl->extents[run.next].key;
+	else if (--(tbl->runs_used) > 0)
+		/* The run is used up; move the last run to the root. */
+		run = tbl->runs[tbl->runs_used];
+	else {
+		/* Everything has been taken; start the table over. */
+		tbl->used = tbl->sorted = 0;
+		return (r);
+	}
 
 	/*
 	 * Rebalance the heap.
 	 */
-	a = 0; /* Starting element and its heap key */
-	a_key = heap->files[a]->key;
+	a = 0;
 	for (;;) {
 		b = a + a + 1; /* First child */
-		if (b >= heap->used)
-			return (r);
-		b_key = heap->files[b]->key;
+		if (b >= tbl->runs_used)
+			break;
 		c = b + 1; /* Use second child if it is smaller. */
-		if (c < heap->used) {
-			c_key = heap->files[c]->key;
-			if (c_key < b_key) {
-				b = c;
-				b_key = c_key;
-			}
-		}
-		if (a_key <= b_key)
-			return (r);
-		tmp = heap->files[a];
-		heap->files[a] = heap->files[b];
-		heap->files[b] = tmp;
+		if (c < tbl->runs_used &&
+		    tbl->runs[c].key < tbl->runs[b].key)
+			b = c;
+		if (run.key <= tbl->runs[b].key)
+			break;
+		tbl->runs[a] = tbl->runs[b];
 		a = b;
 	}
+	tbl->runs[a] = run;
+	return (r);
 }
 
 static unsigned int
@@ -109,21 +109,19 @@ struct lzh_dec {
 		/*
 		 * Use a index table. It's faster than searching a huffman
 		 * coding tree, which is a binary tree. But a use of a large
-		 * index table causes L1 cache read miss many times.
+		 * index table causes L1 cache read miss many times, so
+		 * codes longer than HTBL_BITS are resolved by a small
+		 * second-level table instead of a full-width one.
 		 */
 #define HTBL_BITS	10
+		/* A table entry holds a symbol and the length of its code. */
+#define HTBL_SYM(e)	((e) & 0x3ff)
+#define HTBL_LEN(e)	((e) >> 10)
 		int		 max_bits;
-		int		 shift_bits;
+		int		 sub_bits;
 		int		 tbl_bits;
-		int		 tree_used;
-		int		 tree_avail;
-		/* Direct access table. */
+		/* Direct access table followed by the second-level tables. */
 		uint16_t	*tbl;
-		/* Binary tree table for extra bits over the direct access. */
-		struct htree_t {
-			uint16_t left;
-			uint16_t right;
-		}		*tree;
 	}			 lt, pt;
 
 	int			 blocks_avail;
@@ -251,7 +249,7 @@ static int	lzh_read_pt_bitlen(struct lzh_stream *, int start, int end);
 static int	lzh_make_fake_table(struct huffman *, uint16_t);
 static int	lzh_make_huffman_table(struct huffman *);
 static inline int lzh_decode_huffman(struct huffman *, unsigned);
-static int	lzh_decode_huffman_tree(struct huffman *, unsigned, int);
+static inline int lzh_decode_huffman_tbl(const uint16_t *, int, unsigned);
 
 
 int
@@ -1726,11 +1724,15 @@ lha_calcsum(unsigned char sum, const void *pp, int offset, size_t size)
 	return (sum);
 }
 
-static uint16_t crc16tbl[2][256];
+/*
+ * crc16tbl[k][i] is the CRC of byte i followed by k zero bytes, so that
+ * eight bytes can be folded in at once (slice-by-8).
+ */
+static uint16_t crc16tbl[8][256];
 static void
 lha_crc16_init(void)
 {
-	unsigned int i;
+	unsigned int i, k;
 	static int crc16init = 0;
 
 	if (crc16init)
@@ -1745,9 +1747,11 @@ lha_crc16_init(void)
 		crc16tbl[0][i] = crc;
 	}
 
-	for (i = 0; i < 256; i++) {
-		crc16tbl[1][i] = (crc16tbl[0][i] >> 8)
-			^ crc16tbl[0][crc16tbl[0][i] & 0xff];
+	for (k = 1; k < 8; k++) {
+		for (i = 0; i < 256; i++) {
+			crc16tbl[k][i] = (crc16tbl[k-1][i] >> 8)
+				^ crc16tbl[0][crc16tbl[k-1][i] & 0xff];
+		}
 	}
 }
 
@@ -1755,60 +1759,19 @@ static uint16_t
 lha_crc16(uint16_t crc, const void *pp, size_t len)
 {
 	const unsigned char *p = (const unsigned char *)pp;
-	const uint16_t *buff;
-	const union {
-		uint32_t i;
-		char c[4];
-	} u = { 0x01020304 };
-
-	if (len == 0)
-		return crc;
 
-	/* Process unaligned address. */
-	if (((uintptr_t)p) & (uintptr_t)0x1) {
-		crc = (crc >> 8) ^ crc16tbl[0][(crc ^ *p++) & 0xff];
-		len--;
+	for (;len >= 8; len -= 8, p += 8) {
+		uint64_t x = archive_le64dec(p) ^ crc;
+
+		crc = crc16tbl[7][x & 0xff]
+		    ^ crc16tbl[6][(x >> 8) & 0xff]
+		    ^ crc16tbl[5][(x >> 16) & 0xff]
+		    ^ crc16tbl[4][(x >> 24) & 0xff]
+		    ^ crc16tbl[3][(x >> 32) & 0xff]
+		    ^ crc16tbl[2][(x >> 40) & 0xff]
+		    ^ crc16tbl[1][(x >> 48) & 0xff]
+		    ^ crc16tbl[0][x >> 56];
 	}
-	buff = (const uint16_t *)p;
-	/*
-	 * Modern C compiler such as GCC does not unroll automatically yet
-	 * without unrolling pragma, and Clang is so. So we should
-	 * unroll this loop for its performance.
-	 */
-	for (;len >= 8; len -= 8) {
-		/* This if statement expects compiler optimization will
-		 * remove the statement which will not be executed. */
-#undef bswap16
-#ifndef __has_builtin
-#define __has_builtin(x) 0
-#endif
-#if defined(_MSC_VER) && _MSC_VER >= 1400  /* Visual Studio */
-#  define bswap16(x) _byteswap_ushort(x)
-#elif defined(__GNUC__) && ((__GNUC__ == 4 && __GNUC_MINOR__ >= 8) || __GNUC__ > 4)
-/* GCC 4.8 and later has __builtin_bswap16() */
-#  define bswap16(x) __builtin_bswap16(x)
-#elif defined(__clang__) && __has_builtin(__builtin_bswap16)
-/* Newer clang versions have __builtin_bswap16() */
-#  define bswap16(x) __builtin_bswap16(x)
-#else
-#  define bswap16(x) ((((x) >> 8) & 0xff) | ((x) << 8))
-#endif
-#define CRC16W	do { 	\
-		if(u.c[0] == 1) { /* Big endian */		\
-			crc ^= bswap16(*buff); buff++;		\
-		} else						\
-			crc ^= *buff++;				\
-		crc = crc16tbl[1][crc & 0xff] ^ crc16tbl[0][crc >> 8];\
-} while (0)
-		CRC16W;
-		CRC16W;
-		CRC16W;
-		CRC16W;
-#undef CRC16W
-#undef bswap16
-	}
-
-	p = (const unsigned char *)buff;
 	for (;len; len--) {
 		crc = (crc >> 8) ^ crc16tbl[0][(crc ^ *p++) & 0xff];
 	}
@@ -1857,7 +1820,8 @@ lzh_decode_init(struct lzh_stream *strm, const char *method)
 	ds->w_size = 1U << 17;
 	ds->w_mask = ds->w_size -1;
 	if (ds->w_buff == NULL) {
-		ds->w_buff = malloc(ds->w_size);
+		/* Eight extra bytes let a match be copied by words. */
+		ds->w_buff = calloc(1, ds->w_size + 8);
 		if (ds->w_buff == NULL)
 			return (ARCHIVE_FATAL);
 	}
@@ -1949,6 +1913,21 @@ lzh_br_fillup(struct lzh_stream *strm, struct lzh_br *br)
 {
 	int n = CACHE_BITS - br->cache_avail;
 
+	if (n >= 8 && strm->avail_in >= 8) {
+		/* Take as many whole bytes as fit with one load. */
+		const int x = n >> 3;
+		const uint64_t in = archive_be64dec(strm->next_in);
+
+		if (x == 8)
+			br->cache_buffer = in;
+		else
+			br->cache_buffer = (br->cache_buffer << (x * 8)) |
+			    (in >> (64 - x * 8));
+		strm->next_in += x;
+		strm->avail_in -= x;
+		br->cache_avail += x * 8;
+		return (1);
+	}
 	for (;;) {
 		const int x = n >> 3;
 		if (strm->avail_in >= x) {
@@ -2037,6 +2016,7 @@ lzh_br_fillup(struct lzh_stream *strm, struct lzh_br *br)
  */
 static int	lzh_read_blocks(struct lzh_stream *, int);
 static int	lzh_decode_blocks(struct lzh_stream *, int);
+static void	lzh_decode_blocks_fast(struct lzh_stream *);
 #define ST_RD_BLOCK		0
 #define ST_RD_PT_1		1
 #define ST_RD_PT_2		2
@@ -2065,8 +2045,11 @@ lzh_decode(struct lzh_stream *strm, int last)
 	do {
 		if (ds->state < ST_GET_LITERAL)
 			r = lzh_read_blocks(strm, last);
-		else
+		else {
+			if (ds->state == ST_GET_LITERAL)
+				lzh_decode_blocks_fast(strm);
 			r = lzh_decode_blocks(strm, last);
+		}
 	} while (r == 100);
 	strm->total_in += avail_in - strm->avail_in;
 	return (r);
@@ -2258,7 +2241,7 @@ lzh_read_blocks(struct lzh_stream *strm, int last)
 					return (ARCHIVE_OK);
 				}
 				rbits = lzh_br_bits(br, ds->pt.max_bits);
-				c = lzh_decode_huffman(&(ds->pt), rbits);
+				c = HTBL_SYM(lzh_decode_huffman(&(ds->pt), rbits));
 				if (c > 2) {
 					/* Note: 'c' will never be more than
 					 * eighteen since it's limited by
@@ -2323,8 +2306,6 @@ lzh_decode_blocks(struct lzh_stream *strm, int last)
 	struct huffman *lt = &(ds->lt);
 	struct huffman *pt = &(ds->pt);
 	unsigned char *w_buff = ds->w_buff;
-	unsigned char *lt_bitlen = lt->bitlen;
-	unsigned char *pt_bitlen = pt->bitlen;
 	int blocks_avail = ds->blocks_avail, c = 0;
 	int copy_len = ds->copy_len, copy_pos = ds->copy_pos;
 	int w_pos = ds->w_pos, w_mask = ds->w_mask, w_size = ds->w_size;
@@ -2365,13 +2346,15 @@ lzh_decode_blocks(struct lzh_stream *strm, int last)
 					c = lzh_decode_huffman(lt,
 					      lzh_br_bits_forced(&bre,
 					        lt_max_bits));
-					lzh_br_consume(&bre, lt_bitlen[c]);
+					lzh_br_consume(&bre, HTBL_LEN(c));
+					c = HTBL_SYM(c);
 					if (!lzh_br_has(&bre, 0))
 						goto failed;/* Over read. */
 				} else {
 					c = lzh_decode_huffman(lt,
 					      lzh_br_bits(&bre, lt_max_bits));
-					lzh_br_consume(&bre, lt_bitlen[c]);
+					lzh_br_consume(&bre, HTBL_LEN(c));
+					c = HTBL_SYM(c);
 				}
 				blocks_avail--;
 				if (c > UCHAR_MAX)
@@ -2406,13 +2389,15 @@ lzh_decode_blocks(struct lzh_stream *strm, int last)
 				}
 				copy_pos = lzh_decode_huffman(pt,
 				    lzh_br_bits_forced(&bre, pt_max_bits));
-				lzh_br_consume(&bre, pt_bitlen[copy_pos]);
+				lzh_br_consume(&bre, HTBL_LEN(copy_pos));
+				copy_pos = HTBL_SYM(copy_pos);
 				if (!lzh_br_has(&bre, 0))
 					goto failed;/* Over read. */
 			} else {
 				copy_pos = lzh_decode_huffman(pt,
 				    lzh_br_bits(&bre, pt_max_bits));
-				lzh_br_consume(&bre, pt_bitlen[copy_pos]);
+				lzh_br_consume(&bre, HTBL_LEN(copy_pos));
+				copy_pos = HTBL_SYM(copy_pos);
 			}
 			/* FALL THROUGH */
 		case ST_GET_POS_2:
@@ -2442,7 +2427,9 @@ lzh_decode_blocks(struct lzh_stream *strm, int last)
 			 * the window into the output buffer.
 			 */
 			for (;;) {
-				int l;
+				const unsigned char *s;
+				unsigned char *d;
+				int l, li;
 
 				l = copy_len;
 				if (copy_pos > w_pos) {
@@ -2452,23 +2439,23 @@ lzh_decode_blocks(struct lzh_stream *strm, int last)
 					if (l > w_size - w_pos)
 						l = w_size - w_pos;
 				}
-				if ((copy_pos + l < w_pos)
-				    || (w_pos + l < copy_pos)) {
-					/* No overlap. */
-					memcpy(w_buff + w_pos,
-					    w_buff + copy_pos, l);
+				d = w_buff + w_pos;
+				s = w_buff + copy_pos;
+				if (((w_pos - copy_pos) & w_mask) >= 8 &&
+				    ((copy_pos - w_pos) & w_mask) >= 8) {
+					/* Copy eight bytes at a time; the bytes
+					 * written past the end are put back. */
+					unsigned char keep[8];
+
+					memcpy(keep, d + l, 8);
+					for (li = 0; li < l; li += 8)
+						memcpy(d + li, s + li, 8);
+					memcpy(d + l, keep, 8);
+				} else if (((w_pos - copy_pos) & w_mask) == 1) {
+					/* A run of the last byte. */
+					memset(d, s[0], l);
 				} else {
-					const unsigned char *s;
-					unsigned char *d;
-					int li;
-
-					d = w_buff + w_pos;
-					s = w_buff + copy_pos;
-					for (li = 0; li < l-1;) {
-						d[li] = s[li];li++;
-						d[li] = s[li];li++;
-					}
-					if (li < l)
+					for (li = 0; li < l; li++)
 						d[li] = s[li];
 				}
 				w_pos += l;
@@ -2505,10 +2492,98 @@ next_data:
 	return (ARCHIVE_OK);
 }
 
+/*
+ * Decode codes while plenty of input remains and no match can reach
+ * the end of the window, leaving the rest to lzh_decode_blocks().
+ *
+ * The bit cache is refilled once per code; a refill leaves at least 56
+ * bits, which is enough for a match length, its position code and the
+ * extra bits of the position.  Matches are copied eight bytes at a
+ * time when they do not overlap that closely.  The few bytes written
+ * past the end of a match lie ahead of w_pos; they are overwritten
+ * before the window is emitted and are too far back to be referenced
+ * again, since the window is twice as large as the largest distance.
+ */
+static void
+lzh_decode_blocks_fast(struct lzh_stream *strm)
+{
+	struct lzh_dec *ds = strm->ds;
+	const unsigned char *next_in = strm->next_in, *end_in;
+	uint64_t cache = ds->br.cache_buffer;
+	int avail = ds->br.cache_avail;
+	const uint16_t *lt_tbl = ds->lt.tbl, *pt_tbl = ds->pt.tbl;
+	int lt_sub_bits = ds->lt.sub_bits, pt_sub_bits = ds->pt.sub_bits;
+	int lt_max_bits = ds->lt.max_bits, pt_max_bits = ds->pt.max_bits;
+	unsigned char *w_buff = ds->w_buff;
+	int w_pos = ds->w_pos, w_mask = ds->w_mask, w_size = ds->w_size;
+	int blocks_avail = ds->blocks_avail;
+
+	if (strm->avail_in < 8)
+		return;
+	end_in = next_in + strm->avail_in - 8;
+	while (blocks_avail > 0 && w_pos < w_size - (MAXMATCH + 8) &&
+	    next_in <= end_in) {
+		unsigned char *d;
+		const unsigned char *s;
+		int c, copy_len, copy_pos, n;
+
+		/* Take as many whole bytes as fit in the cache. */
+		n = (63 - avail) >> 3;
+		cache = (cache << (n * 8)) |
+		    ((archive_be64dec(next_in) >> 1) >> (63 - n * 8));
+		next_in += n;
+		avail += n * 8;
+
+		c = lzh_decode_huffman_tbl(lt_tbl, lt_sub_bits,
+		    (unsigned)(cache >> (avail - lt_max_bits)) &
+		    ((1U << lt_max_bits) - 1));
+		avail -= HTBL_LEN(c);
+		c = HTBL_SYM(c);
+		blocks_avail--;
+		if (c <= UCHAR_MAX) {
+			w_buff[w_pos++] = c;
+			continue;
+		}
+		copy_len = c - (UCHAR_MAX + 1) + MINMATCH;
+
+		copy_pos = lzh_decode_huffman_tbl(pt_tbl, pt_sub_bits,
+		    (unsigned)(cache >> (avail - pt_max_bits)) &
+		    ((1U << pt_max_bits) - 1));
+		avail -= HTBL_LEN(copy_pos);
+		copy_pos = HTBL_SYM(copy_pos);
+		if (copy_pos > 1) {
+			n = copy_pos - 1;
+			copy_pos = (1 << n) +
+			    (int)((cache >> (avail - n)) & ((1U << n) - 1));
+			avail -= n;
+		}
+		/* 'n' is the distance; 'copy_pos' becomes the position. */
+		n = copy_pos + 1;
+		copy_pos = (w_pos - n) & w_mask;
+		d = w_buff + w_pos;
+		s = w_buff + copy_pos;
+		if (n >= 8 && copy_pos + copy_len <= w_size) {
+			for (c = 0; c < copy_len; c += 8)
+				memcpy(d + c, s + c, 8);
+		} else if (n == 1) {
+			memset(d, *s, copy_len);
+		} else {
+			for (c = 0; c < copy_len; c++)
+				d[c] = w_buff[(copy_pos + c) & w_mask];
+		}
+		w_pos += copy_len;
+	}
+	ds->br.cache_buffer = cache;
+	ds->br.cache_avail = avail;
+	ds->w_pos = w_pos;
+	ds->blocks_avail = blocks_avail;
+	strm->avail_in -= (int)(next_in - strm->next_in);
+	strm->next_in = next_in;
+}
+
 static int
 lzh_huffman_init(struct huffman *hf, size_t len_size, int tbl_bits)
 {
-	int bits;
 
 	if (hf->bitlen == NULL) {
 		hf->bitlen = malloc(len_size * sizeof(hf->bitlen[0]));
@@ -2516,20 +2591,19 @@ lzh_huffman_init(struct huffman *hf, size_t len_size, int tbl_bits)
 			return (ARCHIVE_FATAL);
 	}
 	if (hf->tbl == NULL) {
+		size_t tbl_size;
+
 		if (tbl_bits < HTBL_BITS)
-			bits = tbl_bits;
+			tbl_size = (size_t)1 << tbl_bits;
 		else
-			bits = HTBL_BITS;
-		hf->tbl = malloc(((size_t)1 << bits) * sizeof(hf->tbl[0]));
+			tbl_size = (size_t)1 << HTBL_BITS;
+		/* Room for the second-level tables. */
+		if (tbl_bits > HTBL_BITS)
+			tbl_size += (size_t)1 << tbl_bits;
+		hf->tbl = malloc(tbl_size * sizeof(hf->tbl[0]));
 		if (hf->tbl == NULL)
 			return (ARCHIVE_FATAL);
 	}
-	if (hf->tree == NULL && tbl_bits > HTBL_BITS) {
-		hf->tree_avail = 1 << (tbl_bits - HTBL_BITS + 4);
-		hf->tree = malloc(hf->tree_avail * sizeof(hf->tree[0]));
-		if (hf->tree == NULL)
-			return (ARCHIVE_FATAL);
-	}
 	hf->len_size = (int)len_size;
 	hf->tbl_bits = tbl_bits;
 	return (ARCHIVE_OK);
@@ -2540,7 +2614,6 @@ lzh_huffman_free(struct huffman *hf)
 {
 	free(hf->bitlen);
 	free(hf->tbl);
-	free(hf->tree);
 }
 
 static const char bitlen_tbl[0x400] = {
@@ -2652,16 +2725,25 @@ lzh_make_fake_table(struct huffman *hf, uint16_t c)
 {
 	if (c >= hf->len_size)
 		return (0);
+	/* The only symbol has a zero-length code. */
 	hf->tbl[0] = c;
 	hf->max_bits = 0;
-	hf->shift_bits = 0;
+	hf->sub_bits = 0;
 	hf->bitlen[hf->tbl[0]] = 0;
 	return (1);
 }
 
 /*
  * Make a huffman coding table.
+ *
+ * Codes up to HTBL_BITS long are looked up directly with the leading
+ * HTBL_BITS bits.  When longer codes are used, their first-level entry
+ * holds HTBL_SUB plus the number of a second-level table, which is
+ * indexed by the remaining max_bits - HTBL_BITS bits.  Each code is
+ * therefore resolved by at most two table reads, and the entry found
+ * carries the code length as well, see HTBL_SYM() and HTBL_LEN().
  */
+#define HTBL_SUB	0x8000
 static int
 lzh_make_huffman_table(struct huffman *hf)
 {
@@ -2669,7 +2751,7 @@ lzh_make_huffman_table(struct huffman *hf)
 	const unsigned char *bitlen;
 	int bitptn[17], weight[17];
 	int i, maxbits = 0, ptn, tbl_size, w;
-	int diffbits, len_avail;
+	int len_avail, sub_bits, sub_count;
 
 	/*
 	 * Initialize bit patterns.
@@ -2687,6 +2769,8 @@ lzh_make_huffman_table(struct huffman *hf)
 		return (0);/* Invalid */
 
 	hf->max_bits = maxbits;
+	sub_bits = maxbits > HTBL_BITS ? maxbits - HTBL_BITS : 0;
+	hf->sub_bits = sub_bits;
 
 	/*
 	 * Cut out extra bits which we won't house in the table.
@@ -2700,180 +2784,107 @@ lzh_make_huffman_table(struct huffman *hf)
 			weight[i] >>= ebits;
 		}
 	}
-	if (maxbits > HTBL_BITS) {
-		unsigned htbl_max;
-		uint16_t *p;
-
-		diffbits = maxbits - HTBL_BITS;
-		for (i = 1; i <= HTBL_BITS; i++) {
-			bitptn[i] >>= diffbits;
-			weight[i] >>= diffbits;
-		}
-		htbl_max = bitptn[HTBL_BITS] +
-		    weight[HTBL_BITS] * hf->freq[HTBL_BITS];
-		p = &(hf->tbl[htbl_max]);
-		while (p < &hf->tbl[1U<<HTBL_BITS])
-			*p++ = 0;
-	} else
-		diffbits = 0;
-	hf->shift_bits = diffbits;
 
 	/*
 	 * Make the table.
 	 */
-	tbl_size = 1 << HTBL_BITS;
+	tbl_size = 1 << maxbits;
 	tbl = hf->tbl;
 	bitlen = hf->bitlen;
 	len_avail = hf->len_avail;
-	hf->tree_used = 0;
+	sub_count = 0;
+	if (sub_bits)
+		memset(tbl, 0xff, sizeof(tbl[0]) << HTBL_BITS);
 	for (i = 0; i < len_avail; i++) {
-		uint16_t *p;
+		uint16_t *p, e;
 		int len, cnt;
-		uint16_t bit;
-		int extlen;
-		struct htree_t *ht;
 
 		if (bitlen[i] == 0)
 			continue;
 		/* Get a bit pattern */
 		len = bitlen[i];
+		if (len > maxbits)
+			return (0);/* Invalid */
+		e = (uint16_t)(i | (len << 10));
 		ptn = bitptn[len];
 		cnt = weight[len];
+		/* Calculate next bit pattern */
+		if ((bitptn[len] = ptn + cnt) > tbl_size)
+			return (0);/* Invalid */
 		if (len <= HTBL_BITS) {
-			/* Calculate next bit pattern */
-			if ((bitptn[len] = ptn + cnt) > tbl_size)
-				return (0);/* Invalid */
-			/* Update the table */
-			p = &(tbl[ptn]);
-			if (cnt > 7) {
-				uint16_t *pc;
+			p = &(tbl[ptn >> sub_bits]);
+			cnt >>= sub_bits;
+		} else {
+			/*
+			 * A bit length is too big to be housed to the
+			 * direct table, so its extra bits select an entry
+			 * of a second-level table.
+			 */
+			uint16_t *sub = &(tbl[ptn >> sub_bits]);
 
+			if (*sub == 0xffff)
+				*sub = (uint16_t)(HTBL_SUB | sub_count++);
+			p = &(tbl[(1 << HTBL_BITS) +
+			    ((*sub & ~HTBL_SUB) << sub_bits) +
+			    (ptn & ((1 << sub_bits) - 1))]);
+		}
+		/* Update the table */
+		if (cnt > 7) {
+			uint16_t *pc;
+
+			cnt -= 8;
+			pc = &p[cnt];
+			pc[0] = e;
+			pc[1] = e;
+			pc[2] = e;
+			pc[3] = e;
+			pc[4] = e;
+			pc[5] = e;
+			pc[6] = e;
+			pc[7] = e;
+			if (cnt > 7) {
 				cnt -= 8;
+				memcpy(&p[cnt], pc,
+					8 * sizeof(uint16_t));
 				pc = &p[cnt];
-				pc[0] = (uint16_t)i;
-				pc[1] = (uint16_t)i;
-				pc[2] = (uint16_t)i;
-				pc[3] = (uint16_t)i;
-				pc[4] = (uint16_t)i;
-				pc[5] = (uint16_t)i;
-				pc[6] = (uint16_t)i;
-				pc[7] = (uint16_t)i;
-				if (cnt > 7) {
-					cnt -= 8;
+				while (cnt > 15) {
+					cnt -= 16;
 					memcpy(&p[cnt], pc,
-						8 * sizeof(uint16_t));
-					pc = &p[cnt];
-					while (cnt > 15) {
-						cnt -= 16;
-						memcpy(&p[cnt], pc,
-							16 * sizeof(uint16_t));
-					}
+						16 * sizeof(uint16_t));
 				}
-				if (cnt)
-					memcpy(p, pc, cnt * sizeof(uint16_t));
-			} else {
-				while (cnt > 1) {
-					p[--cnt] = (uint16_t)i;
-					p[--cnt] = (uint16_t)i;
-				}
-				if (cnt)
-					p[--cnt] = (uint16_t)i;
 			}
-			continue;
-		}
-
-		/*
-		 * A bit length is too big to be housed to a direct table,
-		 * so we use a tree model for its extra bits.
-		 */
-		bitptn[len] = ptn + cnt;
-		bit = 1U << (diffbits -1);
-		extlen = len - HTBL_BITS;
-		
-		p = &(tbl[ptn >> diffbits]);
-		if (*p == 0) {
-			*p = len_avail + hf->tree_used;
-			ht = &(hf->tree[hf->tree_used++]);
-			if (hf->tree_used > hf->tree_avail)
-				return (0);/* Invalid */
-			ht->left = 0;
-			ht->right = 0;
+			if (cnt)
+				memcpy(p, pc, cnt * sizeof(uint16_t));
 		} else {
-			if (*p < len_avail ||
-			    *p >= (len_avail + hf->tree_used))
-				return (0);/* Invalid */
-			ht = &(hf->tree[*p - len_avail]);
-		}
-		while (--extlen > 0) {
-			if (ptn & bit) {
-				if (ht->left < len_avail) {
-					ht->left = len_avail + hf->tree_used;
-					ht = &(hf->tree[hf->tree_used++]);
-					if (hf->tree_used > hf->tree_avail)
-						return (0);/* Invalid */
-					ht->left = 0;
-					ht->right = 0;
-				} else {
-					ht = &(hf->tree[ht->left - len_avail]);
-				}
-			} else {
-				if (ht->right < len_avail) {
-					ht->right = len_avail + hf->tree_used;
-					ht = &(hf->tree[hf->tree_used++]);
-					if (hf->tree_used > hf->tree_avail)
-						return (0);/* Invalid */
-					ht->left = 0;
-					ht->right = 0;
-				} else {
-					ht = &(hf->tree[ht->right - len_avail]);
-				}
+			while (cnt > 1) {
+				p[--cnt] = e;
+				p[--cnt] = e;
 			}
-			bit >>= 1;
-		}
-		if (ptn & bit) {
-			if (ht->left != 0)
-				return (0);/* Invalid */
-			ht->left = (uint16_t)i;
-		} else {
-			if (ht->right != 0)
-				return (0);/* Invalid */
-			ht->right = (uint16_t)i;
+			if (cnt)
+				p[--cnt] = e;
 		}
 	}
 	return (1);
 }
 
-static int
-lzh_decode_huffman_tree(struct huffman *hf, unsigned rbits, int c)
-{
-	struct htree_t *ht;
-	int extlen;
-
-	ht = hf->tree;
-	extlen = hf->shift_bits;
-	while (c >= hf->len_avail) {
-		c -= hf->len_avail;
-		if (extlen-- <= 0 || c >= hf->tree_used)
-			return (0);
-		if (rbits & (1U << extlen))
-			c = ht[c].left;
-		else
-			c = ht[c].right;
-	}
-	return (c);
-}
-
 static inline int
-lzh_decode_huffman(struct huffman *hf, unsigned rbits)
+lzh_decode_huffman_tbl(const uint16_t *tbl, int sub_bits, unsigned rbits)
 {
 	int c;
 	/*
 	 * At first search an index table for a bit pattern.
-	 * If it fails, search a huffman tree for.
+	 * If it points to a second-level table, search it with the
+	 * remaining bits.  Returns a table entry, not a bare symbol.
 	 */
-	c = hf->tbl[rbits >> hf->shift_bits];
-	if (c < hf->len_avail || hf->len_avail == 0)
+	c = tbl[rbits >> sub_bits];
+	if (c < HTBL_SUB)
 		return (c);
-	/* This bit pattern needs to be found out at a huffman tree. */
-	return (lzh_decode_huffman_tree(hf, rbits, c));
+	return (tbl[(1 << HTBL_BITS) + ((c & ~HTBL_SUB) << sub_bits) +
+	    (rbits & ((1 << sub_bits) - 1))]);
+}
+
+static inline int
+lzh_decode_huffman(struct huffman *hf, unsigned rbits)
+{
+	return (lzh_decode_huffman_tbl(hf->tbl, hf->sub_bits, rbits));
 }
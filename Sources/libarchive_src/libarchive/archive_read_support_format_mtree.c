@@ -49,6 +49,7 @@
 #endif
 
 #include "archive.h"
+#include "archive_digest_private.h"
 #include "archive_entry.h"
 #include "archive_entry_private.h"
 #include "archive_private.h"
@@ -56,6 +57,7 @@
 #include "archive_read_private.h"
 #include "archive_string.h"
 #include "archive_pack_dev.h"
+#include "archive_thread_private.h"
 
 #ifndef O_BINARY
 #define	O_BINARY 0
@@ -81,21 +83,116 @@
 
 #define	MAX_LINE_LEN		(1024 * 1024)
 
+/*
+ * The digests that can be verified, as AE_MSET_DIGEST_* flags.
+ */
+#ifdef ARCHIVE_HAS_MD5
+#define	MTREE_DIGEST_MD5	AE_MSET_DIGEST_MD5
+#else
+#define	MTREE_DIGEST_MD5	0
+#endif
+#ifdef ARCHIVE_HAS_RMD160
+#define	MTREE_DIGEST_RMD160	AE_MSET_DIGEST_RMD160
+#else
+#define	MTREE_DIGEST_RMD160	0
+#endif
+#ifdef ARCHIVE_HAS_SHA1
+#define	MTREE_DIGEST_SHA1	AE_MSET_DIGEST_SHA1
+#else
+#define	MTREE_DIGEST_SHA1	0
+#endif
+#ifdef ARCHIVE_HAS_SHA256
+#define	MTREE_DIGEST_SHA256	AE_MSET_DIGEST_SHA256
+#else
+#define	MTREE_DIGEST_SHA256	0
+#endif
+#ifdef ARCHIVE_HAS_SHA384
+#define	MTREE_DIGEST_SHA384	AE_MSET_DIGEST_SHA384
+#else
+#define	MTREE_DIGEST_SHA384	0
+#endif
+#ifdef ARCHIVE_HAS_SHA512
+#define	MTREE_DIGEST_SHA512	AE_MSET_DIGEST_SHA512
+#else
+#define	MTREE_DIGEST_SHA512	0
+#endif
+#define	MTREE_DIGESTS	(MTREE_DIGEST_MD5 | MTREE_DIGEST_RMD160 | \
+			 MTREE_DIGEST_SHA1 | MTREE_DIGEST_SHA256 | \
+			 MTREE_DIGEST_SHA384 | MTREE_DIGEST_SHA512)
+
+/*
+ * An option is a "keyword=value" or a bare "keyword"; keylen is the
+ * length of the keyword.  The options in effect from "/set" lines are
+ * shared by every entry that follows them, so they are never changed
+ * once an entry has been read.
+ */
 struct mtree_option {
 	struct mtree_option *next;
 	char *value;
+	size_t keylen;
 };
 
 struct mtree_entry {
 	struct archive_rb_node rbnode;
 	struct mtree_entry *next_dup;
 	struct mtree_entry *next;
+	/* The options on the lines of this entry, the last one first. */
 	struct mtree_option *options;
+	/* The "/set" options in effect, the one set first first. */
+	struct mtree_option *global;
 	char *name;
 	char full;
 	char used;
 };
 
+/*
+ * Entries, their names and their options live as long as the reader
+ * does, so they are carved out of large chunks.
+ */
+struct mtree_chunk {
+	struct mtree_chunk *next;
+	size_t size;
+	size_t used;
+};
+
+#define	MTREE_CHUNK_SIZE	(256 * 1024)
+#define	MTREE_ALIGN(n)		(((n) + 7) & ~(size_t)7)
+
+/*
+ * The contents file of an entry, hashed on a worker thread to verify
+ * the digests given for it.
+ */
+struct mtree_job {
+	struct archive_thread_task task;
+	int			 busy;
+	/* Index of the entry, counting from the first one. */
+	int64_t			 index;
+	struct archive_string	 path;
+	/* AE_MSET_DIGEST_* flags of the digests to compute. */
+	int			 digests;
+	/* The errno value if the file could not be read. */
+	int			 error;
+	struct ae_digest	 digest;
+	unsigned char		*buff;
+};
+
+#define	MTREE_JOB_BUFF_SIZE	(64 * 1024)
+
+enum mtree_keyword_id {
+	KW_UNKNOWN = 0,
+	KW_CKSUM, KW_CONTENT, KW_DEVICE, KW_FLAGS, KW_GID, KW_GNAME,
+	KW_IGNORE, KW_INODE, KW_LINK, KW_MD5, KW_MODE, KW_NLINK,
+	KW_NOCHANGE, KW_OPTIONAL, KW_RESDEVICE, KW_RMD160, KW_SHA1,
+	KW_SHA256, KW_SHA384, KW_SHA512, KW_SIZE, KW_TAGS, KW_TIME,
+	KW_TYPE, KW_UID, KW_UNAME
+};
+
+struct mtree_keyword {
+	const char *name;
+	size_t len;
+	enum mtree_keyword_id id;
+};
+
 struct mtree {
 	struct archive_string	 line;
 	size_t			 buffsize;
@@ -109,18 +206,44 @@ struct mtree {
 	struct archive_rb_tree	 entry_rbtree;
 	struct archive_string	 current_dir;
 	struct archive_string	 contents_name;
+	/* The pathname of the entry being parsed. */
+	struct archive_string	 path;
 
 	struct archive_entry_linkresolver *resolver;
 	struct archive_rb_tree rbtree;
 
 	int64_t			 cur_size;
 	char checkfs;
+	char verify;
+
+	/* The "/set" options in effect while reading the specification. */
+	struct mtree_option	*global;
+	struct mtree_chunk	*chunks;
+	/* A copy of a value that is changed as it is parsed. */
+	struct archive_string	 option_value;
+
+	/* Index of this_entry, counting from the first entry. */
+	int64_t			 entry_index;
+	int			 threads;
+	/* One slot per thread, indexed by entry index modulo threads,
+	 * and the workers beyond the first thread that hash them. */
+	struct mtree_job	*jobs;
+	struct archive_thread_pool *pool;
+	/* The next entry to hash ahead, its index, the directory it is
+	 * relative to and its pathname. */
+	struct mtree_entry	*prefetch_entry;
+	int64_t			 prefetch_index;
+	struct archive_string	 prefetch_dir;
+	struct archive_string	 prefetch_path;
 };
 
 static int	bid_keycmp(const char *, const char *, ssize_t);
 static int	cleanup(struct archive_read *);
+static void	free_jobs(struct mtree *);
 static int	detect_form(struct archive_read *, int *);
 static int	mtree_bid(struct archive_read *, int);
+static void	resolve_path(struct archive_string *, struct archive_string *,
+		    const struct mtree_entry *, int);
 static int	parse_file(struct archive_read *, struct archive_entry *,
 		    struct mtree *, struct mtree_entry *, int *);
 static void	parse_escapes(char *, struct mtree_entry *);
@@ -134,6 +257,8 @@ static ssize_t	readline(struct archive_read *, struct mtree *, char **, ssize_t)
 static int	skip(struct archive_read *a);
 static int	read_header(struct archive_read *,
 		    struct archive_entry *);
+static int	verify_digests(struct archive_read *, struct mtree *,
+		    struct archive_entry *, const char *);
 static int64_t	mtree_atol(char **, int base);
 #ifndef HAVE_STRNLEN
 static size_t	mtree_strnlen(const char *, size_t);
@@ -223,6 +348,20 @@ archive_read_format_mtree_options(struct archive_read *a,
 		}
 		return (ARCHIVE_OK);
 	}
+	if (strcmp(key, "threads") == 0)
+		return (__archive_thread_parse_count(&a->archive, val,
+		    &mtree->threads));
+	if (strcmp(key, "verify") == 0) {
+		/* Check the digests against the files; this reads them
+		 * from the file system as "checkfs" does. */
+		if (val == NULL || val[0] == 0) {
+			mtree->verify = 0;
+		} else {
+			mtree->verify = 1;
+			mtree->checkfs = 1;
+		}
+		return (ARCHIVE_OK);
+	}
 
 	/* Note: The "warn" return is just to inform the options
 	 * supervisor that we didn't handle it.  It will generate
@@ -230,18 +369,6 @@ archive_read_format_mtree_options(struct archive_read *a,
 	return (ARCHIVE_WARN);
 }
 
-static void
-free_options(struct mtree_option *head)
-{
-	struct mtree_option *next;
-
-	for (; head != NULL; head = next) {
-		next = head->next;
-		free(head->value);
-		free(head);
-	}
-}
-
 static int
 mtree_cmp_node(const struct archive_rb_node *n1,
     const struct archive_rb_node *n2)
@@ -281,6 +408,7 @@ archive_read_support_format_mtree(struct archive *_a)
 	}
 	mtree->checkfs = 0;
 	mtree->fd = -1;
+	mtree->threads = 1;
 
 	__archive_rb_tree_init(&mtree->rbtree, &rb_ops);
 
@@ -296,21 +424,24 @@ static int
 cleanup(struct archive_read *a)
 {
 	struct mtree *mtree;
-	struct mtree_entry *p, *q;
+	struct mtree_chunk *chunk;
 
 	mtree = (struct mtree *)(a->format->data);
 
-	p = mtree->entries;
-	while (p != NULL) {
-		q = p->next;
-		free(p->name);
-		free_options(p->options);
-		free(p);
-		p = q;
+	if (mtree->fd >= 0)
+		close(mtree->fd);
+	free_jobs(mtree);
+	while ((chunk = mtree->chunks) != NULL) {
+		mtree->chunks = chunk->next;
+		free(chunk);
 	}
 	archive_string_free(&mtree->line);
 	archive_string_free(&mtree->current_dir);
 	archive_string_free(&mtree->contents_name);
+	archive_string_free(&mtree->option_value);
+	archive_string_free(&mtree->prefetch_dir);
+	archive_string_free(&mtree->prefetch_path);
+	archive_string_free(&mtree->path);
 	archive_entry_linkresolver_free(mtree->resolver);
 
 	free(mtree->buff);
@@ -797,6 +928,50 @@ detect_form(struct archive_read *a, int *is_form_d)
 	return (0);
 }
 
+static void *
+mtree_alloc(struct archive_read *a, struct mtree *mtree, size_t size)
+{
+	struct mtree_chunk *chunk = mtree->chunks;
+	void *p;
+
+	size = MTREE_ALIGN(size);
+	if (chunk == NULL || chunk->size - chunk->used < size) {
+		size_t n = MTREE_CHUNK_SIZE;
+
+		if (n < MTREE_ALIGN(sizeof(*chunk)) + size)
+			n = MTREE_ALIGN(sizeof(*chunk)) + size;
+		if ((chunk = malloc(n)) == NULL) {
+			archive_set_error(&a->archive, ENOMEM,
+			    "Can't allocate memory");
+			return (NULL);
+		}
+		chunk->next = mtree->chunks;
+		chunk->size = n;
+		chunk->used = MTREE_ALIGN(sizeof(*chunk));
+		mtree->chunks = chunk;
+	}
+	p = (char *)chunk + chunk->used;
+	chunk->used += size;
+	return (p);
+}
+
+static struct mtree_option *
+new_option(struct archive_read *a, struct mtree *mtree,
+    const char *value, size_t len, size_t keylen)
+{
+	struct mtree_option *opt;
+
+	opt = mtree_alloc(a, mtree, sizeof(*opt) + len + 1);
+	if (opt == NULL)
+		return (NULL);
+	opt->next = NULL;
+	opt->value = (char *)(opt + 1);
+	memcpy(opt->value, value, len);
+	opt->value[len] = '\0';
+	opt->keylen = keylen;
+	return (opt);
+}
+
 /*
  * The extended mtree format permits multiple lines specifying
  * attributes for each file.  For those entries, only the last line
@@ -805,62 +980,68 @@ detect_form(struct archive_read *a, int *is_form_d)
  *
  * The parsing is done in two steps.  First, it is decided if a line
  * changes the global defaults and if it is, processed accordingly.
- * Otherwise, the options of the line are merged with the current
- * global options.
+ * Otherwise, the options of the line are kept along with the current
+ * global options, which the options of the line override.
  */
-static int
-add_option(struct archive_read *a, struct mtree_option **global,
-    const char *value, size_t len)
+static struct mtree_option *
+find_option(struct mtree_option *list, const char *key, size_t len)
 {
-	struct mtree_option *opt;
-
-	if ((opt = malloc(sizeof(*opt))) == NULL) {
-		archive_set_error(&a->archive, errno, "Can't allocate memory");
-		return (ARCHIVE_FATAL);
-	}
-	if ((opt->value = malloc(len + 1)) == NULL) {
-		free(opt);
-		archive_set_error(&a->archive, errno, "Can't allocate memory");
-		return (ARCHIVE_FATAL);
+	for (; list != NULL; list = list->next) {
+		if (list->keylen == len && memcmp(list->value, key, len) == 0)
+			break;
 	}
-	memcpy(opt->value, value, len);
-	opt->value[len] = '\0';
-	opt->next = *global;
-	*global = opt;
-	return (ARCHIVE_OK);
+	return (list);
 }
 
 static void
-remove_option(struct mtree_option **global, const char *value, size_t len)
+remove_option(struct mtree_option **list, const char *key, size_t len)
 {
 	struct mtree_option *iter, *last;
 
 	last = NULL;
-	for (iter = *global; iter != NULL; last = iter, iter = iter->next) {
-		if (strncmp(iter->value, value, len) == 0 &&
-		    (iter->value[len] == '\0' ||
-		     iter->value[len] == '='))
+	for (iter = *list; iter != NULL; last = iter, iter = iter->next) {
+		if (iter->keylen == len && memcmp(iter->value, key, len) == 0)
 			break;
 	}
 	if (iter == NULL)
 		return;
 	if (last == NULL)
-		*global = iter->next;
+		*list = iter->next;
 	else
 		last->next = iter->next;
+}
 
-	free(iter->value);
-	free(iter);
+/*
+ * Entries already read share the "/set" options, so replace them
+ * with a copy before changing them.
+ */
+static int
+copy_global(struct archive_read *a, struct mtree *mtree)
+{
+	struct mtree_option *iter, *copy, **last;
+
+	last = &mtree->global;
+	for (iter = mtree->global; iter != NULL; iter = iter->next) {
+		if ((copy = mtree_alloc(a, mtree, sizeof(*copy))) == NULL)
+			return (ARCHIVE_FATAL);
+		*copy = *iter;
+		copy->next = NULL;
+		*last = copy;
+		last = &copy->next;
+	}
+	return (ARCHIVE_OK);
 }
 
 static int
 process_global_set(struct archive_read *a,
-    struct mtree_option **global, const char *line)
+    struct mtree *mtree, const char *line)
 {
+	struct mtree_option *opt, **last;
 	const char *next, *eq;
 	size_t len;
-	int r;
 
+	if (copy_global(a, mtree) != ARCHIVE_OK)
+		return (ARCHIVE_FATAL);
 	line += 4;
 	for (;;) {
 		next = line + strspn(line, " \t\r\n");
@@ -868,23 +1049,28 @@ process_global_set(struct archive_read *a,
 			return (ARCHIVE_OK);
 		line = next;
 		next = line + strcspn(line, " \t\r\n");
-		eq = strchr(line, '=');
-		if (eq > next)
+		eq = memchr(line, '=', next - line);
+		if (eq == NULL)
 			len = next - line;
 		else
 			len = eq - line;
 
-		remove_option(global, line, len);
-		r = add_option(a, global, line, next - line);
-		if (r != ARCHIVE_OK)
-			return (r);
+		/* A keyword set again moves to the end. */
+		remove_option(&mtree->global, line, len);
+		opt = new_option(a, mtree, line, next - line, len);
+		if (opt == NULL)
+			return (ARCHIVE_FATAL);
+		for (last = &mtree->global; *last != NULL;
+		    last = &(*last)->next)
+			;
+		*last = opt;
 		line = next;
 	}
 }
 
 static int
 process_global_unset(struct archive_read *a,
-    struct mtree_option **global, const char *line)
+    struct mtree *mtree, const char *line)
 {
 	const char *next;
 	size_t len;
@@ -896,6 +1082,8 @@ process_global_unset(struct archive_read *a,
 		return ARCHIVE_FATAL;
 	}
 
+	if (copy_global(a, mtree) != ARCHIVE_OK)
+		return (ARCHIVE_FATAL);
 	for (;;) {
 		next = line + strspn(line, " \t\r\n");
 		if (*next == '\0')
@@ -904,10 +1092,9 @@ process_global_unset(struct archive_read *a,
 		len = strcspn(line, " \t\r\n");
 
 		if (len == 3 && strncmp(line, "all", 3) == 0) {
-			free_options(*global);
-			*global = NULL;
+			mtree->global = NULL;
 		} else {
-			remove_option(global, line, len);
+			remove_option(&mtree->global, line, len);
 		}
 
 		line += len;
@@ -916,21 +1103,20 @@ process_global_unset(struct archive_read *a,
 
 static int
 process_add_entry(struct archive_read *a, struct mtree *mtree,
-    struct mtree_option **global, const char *line, ssize_t line_len,
+    const char *line, ssize_t line_len,
     struct mtree_entry **last_entry, int is_form_d)
 {
 	struct mtree_entry *entry;
-	struct mtree_option *iter;
+	struct mtree_option *opt;
 	const char *next, *eq, *name, *end;
 	size_t name_len, len;
-	int r, i;
+	int i;
 
-	if ((entry = malloc(sizeof(*entry))) == NULL) {
-		archive_set_error(&a->archive, errno, "Can't allocate memory");
+	if ((entry = mtree_alloc(a, mtree, sizeof(*entry))) == NULL)
 		return (ARCHIVE_FATAL);
-	}
 	entry->next = NULL;
 	entry->options = NULL;
+	entry->global = mtree->global;
 	entry->name = NULL;
 	entry->used = 0;
 	entry->full = 0;
@@ -978,10 +1164,8 @@ process_add_entry(struct archive_read *a, struct mtree *mtree,
 	/* name/name_len is the name within the line. */
 	/* line..end brackets the entire line except the name */
 
-	if ((entry->name = malloc(name_len + 1)) == NULL) {
-		archive_set_error(&a->archive, errno, "Can't allocate memory");
+	if ((entry->name = mtree_alloc(a, mtree, name_len + 1)) == NULL)
 		return (ARCHIVE_FATAL);
-	}
 
 	memcpy(entry->name, name, name_len);
 	entry->name[name_len] = '\0';
@@ -1001,13 +1185,6 @@ process_add_entry(struct archive_read *a, struct mtree *mtree,
 		}
 	}
 
-	for (iter = *global; iter != NULL; iter = iter->next) {
-		r = add_option(a, &entry->options, iter->value,
-		    strlen(iter->value));
-		if (r != ARCHIVE_OK)
-			return (r);
-	}
-
 	for (;;) {
 		next = line + strspn(line, " \t\r\n");
 		if (*next == '\0')
@@ -1016,16 +1193,18 @@ process_add_entry(struct archive_read *a, struct mtree *mtree,
 			return (ARCHIVE_OK);
 		line = next;
 		next = line + strcspn(line, " \t\r\n");
-		eq = strchr(line, '=');
-		if (eq == NULL || eq > next)
+		eq = memchr(line, '=', next - line);
+		if (eq == NULL)
 			len = next - line;
 		else
 			len = eq - line;
 
 		remove_option(&entry->options, line, len);
-		r = add_option(a, &entry->options, line, next - line);
-		if (r != ARCHIVE_OK)
-			return (r);
+		opt = new_option(a, mtree, line, next - line, len);
+		if (opt == NULL)
+			return (ARCHIVE_FATAL);
+		opt->next = entry->options;
+		entry->options = opt;
 		line = next;
 	}
 }
@@ -1036,14 +1215,13 @@ read_mtree(struct archive_read *a, struct mtree *mtree)
 	ssize_t len;
 	uintmax_t counter;
 	char *p, *s;
-	struct mtree_option *global;
 	struct mtree_entry *last_entry;
 	int r, is_form_d;
 
 	mtree->archive_format = ARCHIVE_FORMAT_MTREE;
 	mtree->archive_format_name = "mtree";
 
-	global = NULL;
+	mtree->global = NULL;
 	last_entry = NULL;
 
 	(void)detect_form(a, &is_form_d);
@@ -1053,13 +1231,11 @@ read_mtree(struct archive_read *a, struct mtree *mtree)
 		len = readline(a, mtree, &p, 65536);
 		if (len == 0) {
 			mtree->this_entry = mtree->entries;
-			free_options(global);
+			mtree->entry_index = 0;
 			return (ARCHIVE_OK);
 		}
-		if (len < 0) {
-			free_options(global);
+		if (len < 0)
 			return ((int)len);
-		}
 		/* Leading whitespace is never significant, ignore it. */
 		while (*p == ' ' || *p == '\t') {
 			++p;
@@ -1080,31 +1256,65 @@ read_mtree(struct archive_read *a, struct mtree *mtree)
 		if (r != ARCHIVE_OK)
 			break;
 		if (*p != '/') {
-			r = process_add_entry(a, mtree, &global, p, len,
+			r = process_add_entry(a, mtree, p, len,
 			    &last_entry, is_form_d);
 		} else if (len > 4 && strncmp(p, "/set", 4) == 0) {
 			if (p[4] != ' ' && p[4] != '\t')
 				break;
-			r = process_global_set(a, &global, p);
+			r = process_global_set(a, mtree, p);
 		} else if (len > 6 && strncmp(p, "/unset", 6) == 0) {
 			if (p[6] != ' ' && p[6] != '\t')
 				break;
-			r = process_global_unset(a, &global, p);
+			r = process_global_unset(a, mtree, p);
 		} else
 			break;
 
-		if (r != ARCHIVE_OK) {
-			free_options(global);
+		if (r != ARCHIVE_OK)
 			return r;
-		}
 	}
 
 	archive_set_error(&a->archive, ARCHIVE_ERRNO_FILE_FORMAT,
 	    "Can't parse line %ju", counter);
-	free_options(global);
 	return (ARCHIVE_FATAL);
 }
 
+/* Roll back a path to its parent directory. */
+static void
+parent_dir(struct archive_string *dir)
+{
+	char *p;
+
+	if (archive_strlen(dir) > 0) {
+		p = dir->s + dir->length - 1;
+		while (p >= dir->s && *p != '/')
+			--p;
+		if (p >= dir->s)
+			--p;
+		dir->length = p - dir->s + 1;
+	}
+}
+
+/*
+ * Set path to the pathname of an entry.  The name of a relative entry
+ * is relative to dir, which descends into the entry if it is a
+ * directory.
+ */
+static void
+resolve_path(struct archive_string *dir, struct archive_string *path,
+    const struct mtree_entry *mentry, int isdir)
+{
+	if (mentry->full) {
+		archive_strcpy(path, mentry->name);
+		return;
+	}
+	archive_string_copy(path, dir);
+	if (archive_strlen(path) > 0)
+		archive_strappend_char(path, '/');
+	archive_strcat(path, mentry->name);
+	if (isdir)
+		archive_string_copy(dir, path);
+}
+
 /*
  * Read in the entire mtree file into memory on the first request.
  * Then use the next unused file to satisfy each header request.
@@ -1113,7 +1323,6 @@ static int
 read_header(struct archive_read *a, struct archive_entry *entry)
 {
 	struct mtree *mtree;
-	char *p;
 	int r, use_next;
 
 	mtree = (struct mtree *)(a->format->data);
@@ -1142,17 +1351,7 @@ read_header(struct archive_read *a, struct archive_entry *entry)
 			return (ARCHIVE_EOF);
 		if (strcmp(mtree->this_entry->name, "..") == 0) {
 			mtree->this_entry->used = 1;
-			if (archive_strlen(&mtree->current_dir) > 0) {
-				/* Roll back current path. */
-				p = mtree->current_dir.s
-				    + mtree->current_dir.length - 1;
-				while (p >= mtree->current_dir.s && *p != '/')
-					--p;
-				if (p >= mtree->current_dir.s)
-					--p;
-				mtree->current_dir.length
-				    = p - mtree->current_dir.s + 1;
-			}
+			parent_dir(&mtree->current_dir);
 		}
 		if (!mtree->this_entry->used) {
 			use_next = 0;
@@ -1162,6 +1361,7 @@ read_header(struct archive_read *a, struct archive_entry *entry)
 				return (r);
 		}
 		mtree->this_entry = mtree->this_entry->next;
+		mtree->entry_index++;
 	}
 }
 
@@ -1191,8 +1391,14 @@ parse_file(struct archive_read *a, struct archive_entry *entry,
 	parsed_kws = 0;
 	r = parse_line(a, entry, mtree, mentry, &parsed_kws);
 
+	/*
+	 * Relative entries are named relative to the current directory,
+	 * which relative directory entries descend into.
+	 */
+	resolve_path(&mtree->current_dir, &mtree->path, mentry,
+	    archive_entry_filetype(entry) == AE_IFDIR);
+	archive_entry_copy_pathname(entry, mtree->path.s);
 	if (mentry->full) {
-		archive_entry_copy_pathname(entry, mentry->name);
 		/*
 		 * "Full" entries are allowed to have multiple lines
 		 * and those lines aren't required to be adjacent.  We
@@ -1214,19 +1420,6 @@ parse_file(struct archive_read *a, struct archive_entry *entry,
 					r = r1;
 			}
 		}
-	} else {
-		/*
-		 * Relative entries require us to construct
-		 * the full path and possibly update the
-		 * current directory.
-		 */
-		size_t n = archive_strlen(&mtree->current_dir);
-		if (n > 0)
-			archive_strcat(&mtree->current_dir, "/");
-		archive_strcat(&mtree->current_dir, mentry->name);
-		archive_entry_copy_pathname(entry, mtree->current_dir.s);
-		if (archive_entry_filetype(entry) != AE_IFDIR)
-			mtree->current_dir.length = n;
 	}
 
 	if (mtree->checkfs) {
@@ -1394,6 +1587,13 @@ parse_file(struct archive_read *a, struct archive_entry *entry,
 			archive_entry_set_ino(entry, st->st_ino);
 			archive_entry_set_dev(entry, st->st_dev);
 
+			if (mtree->verify && mtree->fd >= 0 &&
+			    archive_entry_filetype(entry) == AE_IFREG) {
+				r1 = verify_digests(a, mtree, entry, path);
+				if (r1 < r)
+					r = r1;
+			}
+
 			archive_entry_linkify(mtree->resolver, &entry,
 				&sparse_entry);
 		} else if (parsed_kws & MTREE_HAS_OPTIONAL) {
@@ -1428,6 +1628,14 @@ parse_line(struct archive_read *a, struct archive_entry *entry,
 		if (r1 < r)
 			r = r1;
 	}
+	/* Then the global options the line does not override. */
+	for (iter = mp->global; iter != NULL; iter = iter->next) {
+		if (find_option(mp->options, iter->value, iter->keylen))
+			continue;
+		r1 = parse_keyword(a, mtree, entry, iter, parsed_kws);
+		if (r1 < r)
+			r = r1;
+	}
 	if (r == ARCHIVE_OK && (*parsed_kws & MTREE_HAS_TYPE) == 0) {
 		archive_set_error(&a->archive, ARCHIVE_ERRNO_FILE_FORMAT,
 		    "Missing type keyword in mtree specification");
@@ -1594,6 +1802,118 @@ parse_digest(struct archive_read *a, struct archive_entry *entry,
 	return archive_entry_set_digest(entry, type, digest_buf);
 }
 
+/*
+ * A perfect hash of the keywords: the length of a keyword plus the
+ * values given here to its first, second and fourth (or last)
+ * characters picks out one slot of the table below.
+ */
+static const unsigned char keyword_asso[128] = {
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	52, 54, 40, 27, 29, 20, 25,  0, 37,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0, 29,  0, 51, 46, 55,  9, 13, 22, 31,  0, 17, 63, 29, 62, 34,
+	41,  0, 11, 63,  9, 14, 54,  0,  0, 61, 24,  0,  0,  0,  0,  0,
+};
+
+static const struct mtree_keyword keywords[64] = {
+	{ "nlink", 5, KW_NLINK },
+	{ "type", 4, KW_TYPE },
+	{ "md5digest", 9, KW_MD5 },
+	{ "sha256", 6, KW_SHA256 },
+	{ NULL, 0, KW_UNKNOWN },
+	{ NULL, 0, KW_UNKNOWN },
+	{ NULL, 0, KW_UNKNOWN },
+	{ NULL, 0, KW_UNKNOWN },
+	{ NULL, 0, KW_UNKNOWN },
+	{ "sha256digest", 12, KW_SHA256 },
+	{ "device", 6, KW_DEVICE },
+	{ NULL, 0, KW_UNKNOWN },
+	{ NULL, 0, KW_UNKNOWN },
+	{ NULL, 0, KW_UNKNOWN },
+	{ NULL, 0, KW_UNKNOWN },
+	{ "sha1", 4, KW_SHA1 },
+	{ "inode", 5, KW_INODE },
+	{ NULL, 0, KW_UNKNOWN },
+	{ NULL, 0, KW_UNKNOWN },
+	{ NULL, 0, KW_UNKNOWN },
+	{ "ignore", 6, KW_IGNORE },
+	{ "sha1digest", 10, KW_SHA1 },
+	{ NULL, 0, KW_UNKNOWN },
+	{ "cksum", 5, KW_CKSUM },
+	{ NULL, 0, KW_UNKNOWN },
+	{ "size", 4, KW_SIZE },
+	{ "flags", 5, KW_FLAGS },
+	{ NULL, 0, KW_UNKNOWN },
+	{ NULL, 0, KW_UNKNOWN },
+	{ "gid", 3, KW_GID },
+	{ "uid", 3, KW_UID },
+	{ NULL, 0, KW_UNKNOWN },
+	{ NULL, 0, KW_UNKNOWN },
+	{ NULL, 0, KW_UNKNOWN },
+	{ "md5", 3, KW_MD5 },
+	{ "time", 4, KW_TIME },
+	{ "rmd160", 6, KW_RMD160 },
+	{ "content", 7, KW_CONTENT },
+	{ "contents", 8, KW_CONTENT },
+	{ NULL, 0, KW_UNKNOWN },
+	{ NULL, 0, KW_UNKNOWN },
+	{ "tags", 4, KW_TAGS },
+	{ "rmd160digest", 12, KW_RMD160 },
+	{ NULL, 0, KW_UNKNOWN },
+	{ NULL, 0, KW_UNKNOWN },
+	{ "gname", 5, KW_GNAME },
+	{ "uname", 5, KW_UNAME },
+	{ "sha512", 6, KW_SHA512 },
+	{ NULL, 0, KW_UNKNOWN },
+	{ NULL, 0, KW_UNKNOWN },
+	{ "optional", 8, KW_OPTIONAL },
+	{ "link", 4, KW_LINK },
+	{ NULL, 0, KW_UNKNOWN },
+	{ "sha512digest", 12, KW_SHA512 },
+	{ "sha384", 6, KW_SHA384 },
+	{ NULL, 0, KW_UNKNOWN },
+	{ NULL, 0, KW_UNKNOWN },
+	{ "resdevice", 9, KW_RESDEVICE },
+	{ "mode", 4, KW_MODE },
+	{ NULL, 0, KW_UNKNOWN },
+	{ "sha384digest", 12, KW_SHA384 },
+	{ NULL, 0, KW_UNKNOWN },
+	{ "nochange", 8, KW_NOCHANGE },
+	{ NULL, 0, KW_UNKNOWN },
+};
+
+static enum mtree_keyword_id
+keyword_lookup(const char *key, size_t len)
+{
+	const unsigned char *k = (const unsigned char *)key;
+	const struct mtree_keyword *kw;
+
+	if (len < 3 || len > 12)
+		return (KW_UNKNOWN);
+	kw = &keywords[(len + keyword_asso[k[0] & 0x7f] +
+	    keyword_asso[k[1] & 0x7f] +
+	    keyword_asso[k[len > 3 ? 3 : len - 1] & 0x7f]) & 63];
+	if (kw->len != len || memcmp(kw->name, key, len) != 0)
+		return (KW_UNKNOWN);
+	return (kw->id);
+}
+
+/*
+ * Copy a value so that it can be changed as it is parsed; options
+ * may be shared with other entries.
+ */
+static char *
+copy_value(struct mtree *mtree, const char *val, int escapes)
+{
+	archive_strcpy(&mtree->option_value, val);
+	if (escapes)
+		parse_escapes(mtree->option_value.s, NULL);
+	return (mtree->option_value.s);
+}
+
 /*
  * Parse a single keyword and its value.
  */
@@ -1602,175 +1922,130 @@ parse_keyword(struct archive_read *a, struct mtree *mtree,
     struct archive_entry *entry, struct mtree_option *opt, int *parsed_kws)
 {
 	char *val, *key;
+	enum mtree_keyword_id kw;
 
 	key = opt->value;
 
 	if (*key == '\0')
 		return (ARCHIVE_OK);
 
-	if (strcmp(key, "nochange") == 0) {
-		*parsed_kws |= MTREE_HAS_NOCHANGE;
-		return (ARCHIVE_OK);
-	}
-	if (strcmp(key, "optional") == 0) {
-		*parsed_kws |= MTREE_HAS_OPTIONAL;
-		return (ARCHIVE_OK);
-	}
-	if (strcmp(key, "ignore") == 0) {
-		/*
-		 * The mtree processing is not recursive, so
-		 * recursion will only happen for explicitly listed
-		 * entries.
-		 */
-		return (ARCHIVE_OK);
-	}
-
-	val = strchr(key, '=');
-	if (val == NULL) {
+	kw = keyword_lookup(key, opt->keylen);
+	if (key[opt->keylen] == '\0') {
+		switch (kw) {
+		case KW_NOCHANGE:
+			*parsed_kws |= MTREE_HAS_NOCHANGE;
+			return (ARCHIVE_OK);
+		case KW_OPTIONAL:
+			*parsed_kws |= MTREE_HAS_OPTIONAL;
+			return (ARCHIVE_OK);
+		case KW_IGNORE:
+			/*
+			 * The mtree processing is not recursive, so
+			 * recursion will only happen for explicitly listed
+			 * entries.
+			 */
+			return (ARCHIVE_OK);
+		default:
+			break;
+		}
 		archive_set_error(&a->archive, ARCHIVE_ERRNO_FILE_FORMAT,
 		    "Malformed attribute \"%s\" (%d)", key, key[0]);
 		return (ARCHIVE_WARN);
 	}
 
-	*val = '\0';
-	++val;
+	val = key + opt->keylen + 1;
 
-	switch (key[0]) {
-	case 'c':
-		if (strcmp(key, "content") == 0
-		    || strcmp(key, "contents") == 0) {
-			parse_escapes(val, NULL);
-			archive_strcpy(&mtree->contents_name, val);
-			return (ARCHIVE_OK);
-		}
-		if (strcmp(key, "cksum") == 0)
-			return (ARCHIVE_OK);
-		break;
-	case 'd':
-		if (strcmp(key, "device") == 0) {
-			/* stat(2) st_rdev field, e.g. the major/minor IDs
-			 * of a char/block special file */
+	switch (kw) {
+	case KW_CONTENT:
+		archive_strcpy(&mtree->contents_name,
+		    copy_value(mtree, val, 1));
+		return (ARCHIVE_OK);
+	case KW_CKSUM:
+		return (ARCHIVE_OK);
+	case KW_DEVICE:
+	case KW_RESDEVICE:
+		{
+			/* device: stat(2) st_rdev field, e.g. the major/minor
+			 * IDs of a char/block special file.
+			 * resdevice: stat(2) st_dev field, e.g. the device ID
+			 * where the inode resides */
 			int r;
 			dev_t dev;
 
-			*parsed_kws |= MTREE_HAS_DEVICE;
-			r = parse_device(&dev, &a->archive, val);
-			if (r == ARCHIVE_OK)
-				archive_entry_set_rdev(entry, dev);
-			return r;
-		}
-		break;
-	case 'f':
-		if (strcmp(key, "flags") == 0) {
-			*parsed_kws |= MTREE_HAS_FFLAGS;
-			archive_entry_copy_fflags_text(entry, val);
-			return (ARCHIVE_OK);
-		}
-		break;
-	case 'g':
-		if (strcmp(key, "gid") == 0) {
-			*parsed_kws |= MTREE_HAS_GID;
-			archive_entry_set_gid(entry, mtree_atol(&val, 10));
-			return (ARCHIVE_OK);
-		}
-		if (strcmp(key, "gname") == 0) {
-			*parsed_kws |= MTREE_HAS_GNAME;
-			archive_entry_copy_gname(entry, val);
-			return (ARCHIVE_OK);
-		}
-		break;
-	case 'i':
-		if (strcmp(key, "inode") == 0) {
-			archive_entry_set_ino(entry, mtree_atol(&val, 10));
-			return (ARCHIVE_OK);
-		}
-		break;
-	case 'l':
-		if (strcmp(key, "link") == 0) {
-			parse_escapes(val, NULL);
-			archive_entry_copy_symlink(entry, val);
-			return (ARCHIVE_OK);
-		}
-		break;
-	case 'm':
-		if (strcmp(key, "md5") == 0 || strcmp(key, "md5digest") == 0) {
-			return parse_digest(a, entry, val,
-			    ARCHIVE_ENTRY_DIGEST_MD5);
-		}
-		if (strcmp(key, "mode") == 0) {
-			if (val[0] < '0' || val[0] > '7') {
-				archive_set_error(&a->archive,
-				    ARCHIVE_ERRNO_FILE_FORMAT,
-				    "Symbolic or non-octal mode \"%s\" unsupported", val);
-				return (ARCHIVE_WARN);
+			if (kw == KW_DEVICE)
+				*parsed_kws |= MTREE_HAS_DEVICE;
+			r = parse_device(&dev, &a->archive,
+			    copy_value(mtree, val, 0));
+			if (r == ARCHIVE_OK) {
+				if (kw == KW_DEVICE)
+					archive_entry_set_rdev(entry, dev);
+				else
+					archive_entry_set_dev(entry, dev);
 			}
-			*parsed_kws |= MTREE_HAS_PERM;
-			archive_entry_set_perm(entry, (mode_t)mtree_atol(&val, 8));
-			return (ARCHIVE_OK);
-		}
-		break;
-	case 'n':
-		if (strcmp(key, "nlink") == 0) {
-			*parsed_kws |= MTREE_HAS_NLINK;
-			archive_entry_set_nlink(entry,
-				(unsigned int)mtree_atol(&val, 10));
-			return (ARCHIVE_OK);
-		}
-		break;
-	case 'r':
-		if (strcmp(key, "resdevice") == 0) {
-			/* stat(2) st_dev field, e.g. the device ID where the
-			 * inode resides */
-			int r;
-			dev_t dev;
-
-			r = parse_device(&dev, &a->archive, val);
-			if (r == ARCHIVE_OK)
-				archive_entry_set_dev(entry, dev);
 			return r;
 		}
-		if (strcmp(key, "rmd160") == 0 ||
-		    strcmp(key, "rmd160digest") == 0) {
-			return parse_digest(a, entry, val,
-			    ARCHIVE_ENTRY_DIGEST_RMD160);
-		}
-		break;
-	case 's':
-		if (strcmp(key, "sha1") == 0 ||
-		    strcmp(key, "sha1digest") == 0) {
-			return parse_digest(a, entry, val,
-			    ARCHIVE_ENTRY_DIGEST_SHA1);
-		}
-		if (strcmp(key, "sha256") == 0 ||
-		    strcmp(key, "sha256digest") == 0) {
-			return parse_digest(a, entry, val,
-			    ARCHIVE_ENTRY_DIGEST_SHA256);
-		}
-		if (strcmp(key, "sha384") == 0 ||
-		    strcmp(key, "sha384digest") == 0) {
-			return parse_digest(a, entry, val,
-			    ARCHIVE_ENTRY_DIGEST_SHA384);
-		}
-		if (strcmp(key, "sha512") == 0 ||
-		    strcmp(key, "sha512digest") == 0) {
-			return parse_digest(a, entry, val,
-			    ARCHIVE_ENTRY_DIGEST_SHA512);
-		}
-		if (strcmp(key, "size") == 0) {
-			archive_entry_set_size(entry, mtree_atol(&val, 10));
-			return (ARCHIVE_OK);
-		}
-		break;
-	case 't':
-		if (strcmp(key, "tags") == 0) {
-			/*
-			 * Comma delimited list of tags.
-			 * Ignore the tags for now, but the interface
-			 * should be extended to allow inclusion/exclusion.
-			 */
-			return (ARCHIVE_OK);
+	case KW_FLAGS:
+		*parsed_kws |= MTREE_HAS_FFLAGS;
+		archive_entry_copy_fflags_text(entry, val);
+		return (ARCHIVE_OK);
+	case KW_GID:
+		*parsed_kws |= MTREE_HAS_GID;
+		archive_entry_set_gid(entry, mtree_atol(&val, 10));
+		return (ARCHIVE_OK);
+	case KW_GNAME:
+		*parsed_kws |= MTREE_HAS_GNAME;
+		archive_entry_copy_gname(entry, val);
+		return (ARCHIVE_OK);
+	case KW_INODE:
+		archive_entry_set_ino(entry, mtree_atol(&val, 10));
+		return (ARCHIVE_OK);
+	case KW_LINK:
+		archive_entry_copy_symlink(entry, copy_value(mtree, val, 1));
+		return (ARCHIVE_OK);
+	case KW_MD5:
+		return parse_digest(a, entry, val, ARCHIVE_ENTRY_DIGEST_MD5);
+	case KW_MODE:
+		if (val[0] < '0' || val[0] > '7') {
+			archive_set_error(&a->archive,
+			    ARCHIVE_ERRNO_FILE_FORMAT,
+			    "Symbolic or non-octal mode \"%s\" unsupported", val);
+			return (ARCHIVE_WARN);
 		}
-		if (strcmp(key, "time") == 0) {
+		*parsed_kws |= MTREE_HAS_PERM;
+		archive_entry_set_perm(entry, (mode_t)mtree_atol(&val, 8));
+		return (ARCHIVE_OK);
+	case KW_NLINK:
+		*parsed_kws |= MTREE_HAS_NLINK;
+		archive_entry_set_nlink(entry,
+			(unsigned int)mtree_atol(&val, 10));
+		return (ARCHIVE_OK);
+	case KW_RMD160:
+		return parse_digest(a, entry, val,
+		    ARCHIVE_ENTRY_DIGEST_RMD160);
+	case KW_SHA1:
+		return parse_digest(a, entry, val,
+		    ARCHIVE_ENTRY_DIGEST_SHA1);
+	case KW_SHA256:
+		return parse_digest(a, entry, val,
+		    ARCHIVE_ENTRY_DIGEST_SHA256);
+	case KW_SHA384:
+		return parse_digest(a, entry, val,
+		    ARCHIVE_ENTRY_DIGEST_SHA384);
+	case KW_SHA512:
+		return parse_digest(a, entry, val,
+		    ARCHIVE_ENTRY_DIGEST_SHA512);
+	case KW_SIZE:
+		archive_entry_set_size(entry, mtree_atol(&val, 10));
+		return (ARCHIVE_OK);
+	case KW_TAGS:
+		/*
+		 * Comma delimited list of tags.
+		 * Ignore the tags for now, but the interface
+		 * should be extended to allow inclusion/exclusion.
+		 */
+		return (ARCHIVE_OK);
+	case KW_TIME:
+		{
 			int64_t m;
 			int64_t my_time_t_max = get_time_t_max();
 			int64_t my_time_t_min = get_time_t_min();
@@ -1796,83 +2071,442 @@ parse_keyword(struct archive_read *a, struct mtree *mtree,
 			archive_entry_set_mtime(entry, (time_t)m, ns);
 			return (ARCHIVE_OK);
 		}
-		if (strcmp(key, "type") == 0) {
-			switch (val[0]) {
-			case 'b':
-				if (strcmp(val, "block") == 0) {
-					*parsed_kws |= MTREE_HAS_TYPE;
-					archive_entry_set_filetype(entry,
-						AE_IFBLK);
-					return (ARCHIVE_OK);
-				}
+	case KW_TYPE:
+		switch (val[0]) {
+		case 'b':
+			if (strcmp(val, "block") == 0) {
+				*parsed_kws |= MTREE_HAS_TYPE;
+				archive_entry_set_filetype(entry,
+					AE_IFBLK);
+				return (ARCHIVE_OK);
+			}
+			break;
+		case 'c':
+			if (strcmp(val, "char") == 0) {
+				*parsed_kws |= MTREE_HAS_TYPE;
+				archive_entry_set_filetype(entry,
+					AE_IFCHR);
+				return (ARCHIVE_OK);
+			}
+			break;
+		case 'd':
+			if (strcmp(val, "dir") == 0) {
+				*parsed_kws |= MTREE_HAS_TYPE;
+				archive_entry_set_filetype(entry,
+					AE_IFDIR);
+				return (ARCHIVE_OK);
+			}
+			break;
+		case 'f':
+			if (strcmp(val, "fifo") == 0) {
+				*parsed_kws |= MTREE_HAS_TYPE;
+				archive_entry_set_filetype(entry,
+					AE_IFIFO);
+				return (ARCHIVE_OK);
+			}
+			if (strcmp(val, "file") == 0) {
+				*parsed_kws |= MTREE_HAS_TYPE;
+				archive_entry_set_filetype(entry,
+					AE_IFREG);
+				return (ARCHIVE_OK);
+			}
+			break;
+		case 'l':
+			if (strcmp(val, "link") == 0) {
+				*parsed_kws |= MTREE_HAS_TYPE;
+				archive_entry_set_filetype(entry,
+					AE_IFLNK);
+				return (ARCHIVE_OK);
+			}
+			break;
+		default:
+			break;
+		}
+		archive_set_error(&a->archive,
+		    ARCHIVE_ERRNO_FILE_FORMAT,
+		    "Unrecognized file type \"%s\"; "
+		    "assuming \"file\"", val);
+		archive_entry_set_filetype(entry, AE_IFREG);
+		return (ARCHIVE_WARN);
+	case KW_UID:
+		*parsed_kws |= MTREE_HAS_UID;
+		archive_entry_set_uid(entry, mtree_atol(&val, 10));
+		return (ARCHIVE_OK);
+	case KW_UNAME:
+		*parsed_kws |= MTREE_HAS_UNAME;
+		archive_entry_copy_uname(entry, val);
+		return (ARCHIVE_OK);
+	default:
+		break;
+	}
+	archive_strncpy(&mtree->option_value, key, opt->keylen);
+	archive_set_error(&a->archive, ARCHIVE_ERRNO_FILE_FORMAT,
+	    "Unrecognized key %s=%s", mtree->option_value.s, val);
+	return (ARCHIVE_WARN);
+}
+
+/*
+ * The digests a contents file can be checked against.
+ */
+static const struct mtree_digest {
+	int		 flag;
+	int		 type;
+	const char	*name;
+	size_t		 offset;
+	size_t		 size;
+} mtree_digests[] = {
+	{ AE_MSET_DIGEST_MD5, ARCHIVE_ENTRY_DIGEST_MD5, "md5",
+	  offsetof(struct ae_digest, md5), sizeof(((struct ae_digest *)0)->md5) },
+	{ AE_MSET_DIGEST_RMD160, ARCHIVE_ENTRY_DIGEST_RMD160, "rmd160",
+	  offsetof(struct ae_digest, rmd160),
+	  sizeof(((struct ae_digest *)0)->rmd160) },
+	{ AE_MSET_DIGEST_SHA1, ARCHIVE_ENTRY_DIGEST_SHA1, "sha1",
+	  offsetof(struct ae_digest, sha1),
+	  sizeof(((struct ae_digest *)0)->sha1) },
+	{ AE_MSET_DIGEST_SHA256, ARCHIVE_ENTRY_DIGEST_SHA256, "sha256",
+	  offsetof(struct ae_digest, sha256),
+	  sizeof(((struct ae_digest *)0)->sha256) },
+	{ AE_MSET_DIGEST_SHA384, ARCHIVE_ENTRY_DIGEST_SHA384, "sha384",
+	  offsetof(struct ae_digest, sha384),
+	  sizeof(((struct ae_digest *)0)->sha384) },
+	{ AE_MSET_DIGEST_SHA512, ARCHIVE_ENTRY_DIGEST_SHA512, "sha512",
+	  offsetof(struct ae_digest, sha512),
+	  sizeof(((struct ae_digest *)0)->sha512) },
+};
+
+/*
+ * Read the file named in a job and compute its digests.  This may
+ * run on a worker thread and touches nothing but the job.
+ */
+static void
+hash_job(void *arg)
+{
+	struct mtree_job *job = (struct mtree_job *)arg;
+	struct ae_digest *d = &job->digest;
+#ifdef ARCHIVE_HAS_MD5
+	archive_md5_ctx md5ctx;
+#endif
+#ifdef ARCHIVE_HAS_RMD160
+	archive_rmd160_ctx rmd160ctx;
+#endif
+#ifdef ARCHIVE_HAS_SHA1
+	archive_sha1_ctx sha1ctx;
+#endif
+#ifdef ARCHIVE_HAS_SHA256
+	archive_sha256_ctx sha256ctx;
+#endif
+#ifdef ARCHIVE_HAS_SHA384
+	archive_sha384_ctx sha384ctx;
+#endif
+#ifdef ARCHIVE_HAS_SHA512
+	archive_sha512_ctx sha512ctx;
+#endif
+	int digests = job->digests;
+	ssize_t bytes;
+	int fd;
+
+	job->error = 0;
+	fd = open(job->path.s, O_RDONLY | O_BINARY | O_CLOEXEC);
+	if (fd < 0) {
+		job->error = errno;
+		return;
+	}
+	__archive_ensure_cloexec_flag(fd);
+
+#ifdef ARCHIVE_HAS_MD5
+	if (digests & AE_MSET_DIGEST_MD5)
+		archive_md5_init(&md5ctx);
+#endif
+#ifdef ARCHIVE_HAS_RMD160
+	if (digests & AE_MSET_DIGEST_RMD160)
+		archive_rmd160_init(&rmd160ctx);
+#endif
+#ifdef ARCHIVE_HAS_SHA1
+	if (digests & AE_MSET_DIGEST_SHA1)
+		archive_sha1_init(&sha1ctx);
+#endif
+#ifdef ARCHIVE_HAS_SHA256
+	if (digests & AE_MSET_DIGEST_SHA256)
+		archive_sha256_init(&sha256ctx);
+#endif
+#ifdef ARCHIVE_HAS_SHA384
+	if (digests & AE_MSET_DIGEST_SHA384)
+		archive_sha384_init(&sha384ctx);
+#endif
+#ifdef ARCHIVE_HAS_SHA512
+	if (digests & AE_MSET_DIGEST_SHA512)
+		archive_sha512_init(&sha512ctx);
+#endif
+	while ((bytes = read(fd, job->buff, MTREE_JOB_BUFF_SIZE)) > 0) {
+#ifdef ARCHIVE_HAS_MD5
+		if (digests & AE_MSET_DIGEST_MD5)
+			archive_md5_update(&md5ctx, job->buff, bytes);
+#endif
+#ifdef ARCHIVE_HAS_RMD160
+		if (digests & AE_MSET_DIGEST_RMD160)
+			archive_rmd160_update(&rmd160ctx, job->buff, bytes);
+#endif
+#ifdef ARCHIVE_HAS_SHA1
+		if (digests & AE_MSET_DIGEST_SHA1)
+			archive_sha1_update(&sha1ctx, job->buff, bytes);
+#endif
+#ifdef ARCHIVE_HAS_SHA256
+		if (digests & AE_MSET_DIGEST_SHA256)
+			archive_sha256_update(&sha256ctx, job->buff, bytes);
+#endif
+#ifdef ARCHIVE_HAS_SHA384
+		if (digests & AE_MSET_DIGEST_SHA384)
+			archive_sha384_update(&sha384ctx, job->buff, bytes);
+#endif
+#ifdef ARCHIVE_HAS_SHA512
+		if (digests & AE_MSET_DIGEST_SHA512)
+			archive_sha512_update(&sha512ctx, job->buff, bytes);
+#endif
+	}
+	if (bytes < 0)
+		job->error = errno;
+	/* Finish every digest, which also releases its context. */
+#ifdef ARCHIVE_HAS_MD5
+	if (digests & AE_MSET_DIGEST_MD5)
+		archive_md5_final(&md5ctx, d->md5);
+#endif
+#ifdef ARCHIVE_HAS_RMD160
+	if (digests & AE_MSET_DIGEST_RMD160)
+		archive_rmd160_final(&rmd160ctx, d->rmd160);
+#endif
+#ifdef ARCHIVE_HAS_SHA1
+	if (digests & AE_MSET_DIGEST_SHA1)
+		archive_sha1_final(&sha1ctx, d->sha1);
+#endif
+#ifdef ARCHIVE_HAS_SHA256
+	if (digests & AE_MSET_DIGEST_SHA256)
+		archive_sha256_final(&sha256ctx, d->sha256);
+#endif
+#ifdef ARCHIVE_HAS_SHA384
+	if (digests & AE_MSET_DIGEST_SHA384)
+		archive_sha384_final(&sha384ctx, d->sha384);
+#endif
+#ifdef ARCHIVE_HAS_SHA512
+	if (digests & AE_MSET_DIGEST_SHA512)
+		archive_sha512_final(&sha512ctx, d->sha512);
+#endif
+	close(fd);
+}
+
+/*
+ * Hash a file in the job slot of the entry with the given index,
+ * on a worker thread if there is more than one.
+ */
+static int
+start_job(struct archive_read *a, struct mtree *mtree, int64_t index,
+    const char *path, int digests)
+{
+	struct mtree_job *job = &(mtree->jobs[index % mtree->threads]);
+
+	if (job->buff == NULL) {
+		job->buff = malloc(MTREE_JOB_BUFF_SIZE);
+		if (job->buff == NULL) {
+			archive_set_error(&a->archive, ENOMEM,
+			    "Can't allocate memory");
+			return (ARCHIVE_FATAL);
+		}
+	}
+	job->index = index;
+	job->busy = 1;
+	job->digests = digests;
+	archive_strcpy(&job->path, path);
+	if (mtree->threads <= 1)
+		hash_job(job);
+	else
+		__archive_thread_pool_run(mtree->pool, &job->task, hash_job,
+		    job);
+	return (ARCHIVE_OK);
+}
+
+static void
+finish_job(struct mtree *mtree, struct mtree_job *job)
+{
+	__archive_thread_pool_wait(mtree->pool, &job->task);
+	job->busy = 0;
+}
+
+static void
+free_jobs(struct mtree *mtree)
+{
+	int i;
+
+	if (mtree->jobs == NULL)
+		return;
+	for (i = 0; i < mtree->threads; i++) {
+		if (mtree->jobs[i].busy)
+			finish_job(mtree, &(mtree->jobs[i]));
+		archive_string_free(&(mtree->jobs[i].path));
+		free(mtree->jobs[i].buff);
+	}
+	free(mtree->jobs);
+	mtree->jobs = NULL;
+	__archive_thread_pool_free(mtree->pool);
+	mtree->pool = NULL;
+}
+
+/*
+ * Follow the next entry to hash ahead through the specification the
+ * way read_header() and parse_file() will, and when start is set and
+ * it is a regular file with digests, start hashing its contents file.
+ */
+static int
+prefetch_next(struct archive_read *a, struct mtree *mtree, int start)
+{
+	struct mtree_entry *mentry = mtree->prefetch_entry;
+	struct mtree_option *iter;
+	const char *type = NULL, *contents = NULL;
+	int digests = 0, i, r = ARCHIVE_OK;
+
+	mtree->prefetch_entry = mentry->next;
+	mtree->prefetch_index++;
+	if (strcmp(mentry->name, "..") == 0) {
+		parent_dir(&mtree->prefetch_dir);
+		return (ARCHIVE_OK);
+	}
+
+	/* The keywords in effect, as parse_line() applies them. */
+	for (i = 0; i < 2; i++) {
+		iter = (i == 0) ? mentry->options : mentry->global;
+		for (; iter != NULL; iter = iter->next) {
+			if (i == 1 && find_option(mentry->options,
+			    iter->value, iter->keylen))
+				continue;
+			if (iter->value[iter->keylen] != '=')
+				continue;
+			switch (keyword_lookup(iter->value, iter->keylen)) {
+			case KW_TYPE:
+				type = iter->value + iter->keylen + 1;
 				break;
-			case 'c':
-				if (strcmp(val, "char") == 0) {
-					*parsed_kws |= MTREE_HAS_TYPE;
-					archive_entry_set_filetype(entry,
-						AE_IFCHR);
-					return (ARCHIVE_OK);
-				}
+			case KW_CONTENT:
+				contents = iter->value + iter->keylen + 1;
 				break;
-			case 'd':
-				if (strcmp(val, "dir") == 0) {
-					*parsed_kws |= MTREE_HAS_TYPE;
-					archive_entry_set_filetype(entry,
-						AE_IFDIR);
-					return (ARCHIVE_OK);
-				}
+			case KW_MD5:
+				digests |= AE_MSET_DIGEST_MD5;
 				break;
-			case 'f':
-				if (strcmp(val, "fifo") == 0) {
-					*parsed_kws |= MTREE_HAS_TYPE;
-					archive_entry_set_filetype(entry,
-						AE_IFIFO);
-					return (ARCHIVE_OK);
-				}
-				if (strcmp(val, "file") == 0) {
-					*parsed_kws |= MTREE_HAS_TYPE;
-					archive_entry_set_filetype(entry,
-						AE_IFREG);
-					return (ARCHIVE_OK);
-				}
+			case KW_RMD160:
+				digests |= AE_MSET_DIGEST_RMD160;
 				break;
-			case 'l':
-				if (strcmp(val, "link") == 0) {
-					*parsed_kws |= MTREE_HAS_TYPE;
-					archive_entry_set_filetype(entry,
-						AE_IFLNK);
-					return (ARCHIVE_OK);
-				}
+			case KW_SHA1:
+				digests |= AE_MSET_DIGEST_SHA1;
+				break;
+			case KW_SHA256:
+				digests |= AE_MSET_DIGEST_SHA256;
+				break;
+			case KW_SHA384:
+				digests |= AE_MSET_DIGEST_SHA384;
+				break;
+			case KW_SHA512:
+				digests |= AE_MSET_DIGEST_SHA512;
 				break;
 			default:
 				break;
 			}
-			archive_set_error(&a->archive,
-			    ARCHIVE_ERRNO_FILE_FORMAT,
-			    "Unrecognized file type \"%s\"; "
-			    "assuming \"file\"", val);
-			archive_entry_set_filetype(entry, AE_IFREG);
-			return (ARCHIVE_WARN);
 		}
-		break;
-	case 'u':
-		if (strcmp(key, "uid") == 0) {
-			*parsed_kws |= MTREE_HAS_UID;
-			archive_entry_set_uid(entry, mtree_atol(&val, 10));
-			return (ARCHIVE_OK);
+	}
+
+	resolve_path(&mtree->prefetch_dir, &mtree->prefetch_path, mentry,
+	    type != NULL && strcmp(type, "dir") == 0);
+	digests &= MTREE_DIGESTS;
+	if (start && digests != 0 &&
+	    (type == NULL || strcmp(type, "file") == 0)) {
+		const char *path;
+
+		if (contents != NULL)
+			path = copy_value(mtree, contents, 1);
+		else
+			path = mtree->prefetch_path.s;
+		r = start_job(a, mtree, mtree->prefetch_index - 1, path,
+		    digests);
+	}
+	return (r);
+}
+
+/*
+ * Check the digests given for a regular file against its contents
+ * file.  With more than one thread, the contents files of the entries
+ * that follow are hashed ahead on worker threads.
+ */
+static int
+verify_digests(struct archive_read *a, struct mtree *mtree,
+    struct archive_entry *entry, const char *path)
+{
+	struct mtree_job *job;
+	int64_t k = mtree->entry_index;
+	int digests, hashed, i, r;
+
+	digests = entry->mset_digest & MTREE_DIGESTS;
+	if (digests == 0)
+		return (ARCHIVE_OK);
+
+	if (mtree->jobs == NULL) {
+		mtree->jobs = calloc(mtree->threads, sizeof(*mtree->jobs));
+		if (mtree->jobs == NULL) {
+			archive_set_error(&a->archive, ENOMEM,
+			    "Can't allocate memory");
+			return (ARCHIVE_FATAL);
 		}
-		if (strcmp(key, "uname") == 0) {
-			*parsed_kws |= MTREE_HAS_UNAME;
-			archive_entry_copy_uname(entry, val);
-			return (ARCHIVE_OK);
+		if (mtree->threads > 1)
+			mtree->pool =
+			    __archive_thread_pool_new(mtree->threads - 1);
+		mtree->prefetch_entry = mtree->entries;
+		mtree->prefetch_index = 0;
+	}
+	/* Discard files left behind. */
+	for (i = 0; i < mtree->threads; i++) {
+		job = &(mtree->jobs[i]);
+		if (job->busy && job->index < k)
+			finish_job(mtree, job);
+	}
+	/* Catch up with this entry, then hash those after it. */
+	while (mtree->prefetch_entry != NULL && mtree->prefetch_index <= k)
+		prefetch_next(a, mtree, 0);
+	while (mtree->threads > 1 && mtree->prefetch_entry != NULL &&
+	    mtree->prefetch_index - k < mtree->threads) {
+		r = prefetch_next(a, mtree, 1);
+		if (r != ARCHIVE_OK)
+			return (r);
+	}
+
+	job = &(mtree->jobs[k % mtree->threads]);
+	hashed = 0;
+	if (job->busy && job->index == k) {
+		finish_job(mtree, job);
+		/* It may have been hashed for another file. */
+		hashed = job->error == 0 && strcmp(job->path.s, path) == 0 &&
+		    (job->digests & digests) == digests;
+	}
+	if (!hashed) {
+		r = start_job(a, mtree, k, path, digests);
+		if (r != ARCHIVE_OK)
+			return (r);
+		finish_job(mtree, job);
+	}
+	if (job->error != 0) {
+		archive_set_error(&a->archive, job->error,
+		    "Can't read %s", path);
+		return (ARCHIVE_WARN);
+	}
+
+	for (i = 0; i < (int)(sizeof(mtree_digests) /
+	    sizeof(mtree_digests[0])); i++) {
+		const struct mtree_digest *md = &mtree_digests[i];
+
+		if ((digests & md->flag) == 0)
+			continue;
+		if (memcmp(archive_entry_digest(entry, md->type),
+		    (const unsigned char *)&job->digest + md->offset,
+		    md->size) != 0) {
+			archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
+			    "%s digest mismatch for %s", md->name, path);
+			return (ARCHIVE_WARN);
 		}
-		break;
-	default:
-		break;
 	}
-	archive_set_error(&a->archive, ARCHIVE_ERRNO_FILE_FORMAT,
-	    "Unrecognized key %s=%s", key, val);
-	return (ARCHIVE_WARN);
+	return (ARCHIVE_OK);
 }
 
 static int
@@ -2094,7 +2728,7 @@ readline(struct archive_read *a, struct mtree *mtree, char **start,
 	ssize_t find_off = 0;
 	const void *t;
 	void *nl;
-	char *u;
+	char *u, *end;
 
 	/* Accumulate line in a line buffer. */
 	for (;;) {
@@ -2127,28 +2761,32 @@ readline(struct archive_read *a, struct mtree *mtree, char **start,
 		total_size += bytes_read;
 		mtree->line.s[total_size] = '\0';
 
-		for (u = mtree->line.s + find_off; *u; ++u) {
-			if (u[0] == '\n') {
+		/*
+		 * Only an escaped newline continues the line; look for
+		 * backslashes rather than at every byte.  An escape cut
+		 * at the end of what has been read is looked at again
+		 * once more has been read.
+		 */
+		end = mtree->line.s + total_size;
+		for (u = mtree->line.s + find_off;
+		    (u = memchr(u, '\\', end - u)) != NULL; u += 2) {
+			if (u + 1 == end)
+				break;
+			if (u[1] == '\n') {
+				/* Trim escaped newline. */
+				total_size -= 2;
+				mtree->line.s[total_size] = '\0';
+				u = mtree->line.s + total_size;
+				break;
+			}
+		}
+		if (u == NULL) {
+			if (nl != NULL) {
 				/* Ends with unescaped newline. */
 				*start = mtree->line.s;
 				return total_size;
-			} else if (u[0] == '#') {
-				/* Ends with comment sequence #...\n */
-				if (nl == NULL) {
-					/* But we've not found the \n yet */
-					break;
-				}
-			} else if (u[0] == '\\') {
-				if (u[1] == '\n') {
-					/* Trim escaped newline. */
-					total_size -= 2;
-					mtree->line.s[total_size] = '\0';
-					break;
-				} else if (u[1] != '\0') {
-					/* Skip the two-char escape sequence */
-					++u;
-				}
 			}
+			u = end;
 		}
 		find_off = u - mtree->line.s;
 	}
@@ -133,6 +133,8 @@
   MAINCODE_SIZE + OFFSETCODE_SIZE + LOWOFFSETCODE_SIZE + LENGTHCODE_SIZE
 
 #define MAX_SYMBOL_LENGTH 0xF
+/* Bits looked up at once when decoding; longer codes walk the tree. */
+#define HUFFMAN_TABLE_BITS 12
 #define MAX_SYMBOLS       20
 
 /* Virtual Machine Properties */
@@ -194,8 +196,8 @@ struct huffman_tree_node
 
 struct huffman_table_entry
 {
-  unsigned int length;
-  int value;
+  uint16_t length;
+  uint16_t value;
 };
 
 struct huffman_code
@@ -421,7 +423,9 @@ static int read_data_compressed(struct archive_read *, const void **, size_t *,
 static int rar_br_preparation(struct archive_read *, struct rar_br *);
 static int parse_codes(struct archive_read *);
 static void free_codes(struct archive_read *);
-static int read_next_symbol(struct archive_read *, struct huffman_code *);
+static inline int read_next_symbol(struct archive_read *,
+                                   struct huffman_code *);
+static int read_next_symbol_slow(struct archive_read *, struct huffman_code *);
 static int create_code(struct archive_read *, struct huffman_code *,
                        unsigned char *, int, char);
 static int add_value(struct archive_read *, struct huffman_code *, int, int,
@@ -505,58 +509,28 @@ rar_br_fillup(struct archive_read *a, struct rar_br *br)
   for (;;) {
     switch (n >> 3) {
     case 8:
-      if (br->avail_in >= 8) {
-        br->cache_buffer =
-            ((uint64_t)br->next_in[0]) << 56 |
-            ((uint64_t)br->next_in[1]) << 48 |
-            ((uint64_t)br->next_in[2]) << 40 |
-            ((uint64_t)br->next_in[3]) << 32 |
-            ((uint32_t)br->next_in[4]) << 24 |
-            ((uint32_t)br->next_in[5]) << 16 |
-            ((uint32_t)br->next_in[6]) << 8 |
-             (uint32_t)br->next_in[7];
-        br->next_in += 8;
-        br->avail_in -= 8;
-        br->cache_avail += 8 * 8;
-        rar->bytes_unconsumed += 8;
-        rar->bytes_remaining -= 8;
-        return (1);
-      }
-      break;
     case 7:
-      if (br->avail_in >= 7) {
-        br->cache_buffer =
-           (br->cache_buffer << 56) |
-            ((uint64_t)br->next_in[0]) << 48 |
-            ((uint64_t)br->next_in[1]) << 40 |
-            ((uint64_t)br->next_in[2]) << 32 |
-            ((uint32_t)br->next_in[3]) << 24 |
-            ((uint32_t)br->next_in[4]) << 16 |
-            ((uint32_t)br->next_in[5]) << 8 |
-             (uint32_t)br->next_in[6];
-        br->next_in += 7;
-        br->avail_in -= 7;
-        br->cache_avail += 7 * 8;
-        rar->bytes_unconsumed += 7;
-        rar->bytes_remaining -= 7;
-        return (1);
-      }
-      break;
     case 6:
-      if (br->avail_in >= 6) {
-        br->cache_buffer =
-           (br->cache_buffer << 48) |
-            ((uint64_t)br->next_in[0]) << 40 |
-            ((uint64_t)br->next_in[1]) << 32 |
-            ((uint32_t)br->next_in[2]) << 24 |
-            ((uint32_t)br->next_in[3]) << 16 |
-            ((uint32_t)br->next_in[4]) << 8 |
-             (uint32_t)br->next_in[5];
-        br->next_in += 6;
-        br->avail_in -= 6;
-        br->cache_avail += 6 * 8;
-        rar->bytes_unconsumed += 6;
-        rar->bytes_remaining -= 6;
+    case 5:
+    case 4:
+    case 3:
+    case 2:
+    case 1:
+      if (br->avail_in >= 8) {
+        /* Top up with whole bytes from one big-endian load. */
+        int nbytes = n >> 3;
+        uint64_t in = archive_be64dec(br->next_in);
+
+        if (nbytes == 8)
+          br->cache_buffer = in;
+        else
+          br->cache_buffer = (br->cache_buffer << (nbytes * 8)) |
+              (in >> (64 - nbytes * 8));
+        br->next_in += nbytes;
+        br->avail_in -= nbytes;
+        br->cache_avail += nbytes * 8;
+        rar->bytes_unconsumed += nbytes;
+        rar->bytes_remaining -= nbytes;
         return (1);
       }
       break;
@@ -680,6 +654,36 @@ lzss_emit_match(struct rar *rar, int offset, int length)
   int l, li, remaining;
   unsigned char *d, *s;
 
+  if (dstoffs + length <= lzss_size(&rar->lzss) &&
+      srcoffs + length <= lzss_size(&rar->lzss)) {
+    /*
+     * Neither end wraps around the window, the common case.  The
+     * copy must behave like a forward byte loop.  When the source
+     * is just behind the bytes being written, that repeats the
+     * last 'offset' bytes: a run for offset 1 and, for offsets of
+     * 8 or more, whole 8-byte steps that never read what they write.
+     */
+    d = &(rar->lzss.window[dstoffs]);
+    s = &(rar->lzss.window[srcoffs]);
+    if (srcoffs >= dstoffs)
+      memmove(d, s, length);
+    else if (dstoffs - srcoffs >= length)
+      memcpy(d, s, length);
+    else if (dstoffs - srcoffs == 1)
+      memset(d, *s, length);
+    else {
+      li = 0;
+      if (dstoffs - srcoffs >= 8) {
+        for (; li + 8 <= length; li += 8)
+          memcpy(d + li, s + li, 8);
+      }
+      for (; li < length; li++)
+        d[li] = s[li];
+    }
+    rar->lzss.position += length;
+    return;
+  }
+
   remaining = length;
   while (remaining > 0) {
     l = remaining;
@@ -2372,6 +2376,7 @@ parse_codes(struct archive_read *a)
 
       rar->bytein.a = a;
       rar->bytein.Read = &ppmd_read;
+      rar->bytein.Cur = rar->bytein.Lim = NULL;
       __archive_ppmd7_functions.PpmdRAR_RangeDec_CreateVTable(&rar->range_dec);
       rar->range_dec.Stream = &rar->bytein;
       __archive_ppmd7_functions.Ppmd7_Construct(&rar->ppmd7_context);
@@ -2605,8 +2610,30 @@ free_codes(struct archive_read *a)
 }
 
 
-static int
+/*
+ * Decode one symbol.  Nearly every code is no longer than the lookup
+ * table is wide, so that case is handled inline; the rest go through
+ * read_next_symbol_slow(), which builds the table and walks the tree.
+ */
+static inline int
 read_next_symbol(struct archive_read *a, struct huffman_code *code)
+{
+  struct rar_br *br = &(((struct rar *)(a->format->data))->br);
+  const struct huffman_table_entry *entry;
+
+  if (code->table != NULL && (rar_br_has(br, code->tablesize) ||
+      (rar_br_fillup(a, br) && rar_br_has(br, code->tablesize)))) {
+    entry = &code->table[rar_br_bits(br, code->tablesize)];
+    if (entry->length <= (unsigned int)code->tablesize) {
+      rar_br_consume(br, entry->length);
+      return entry->value;
+    }
+  }
+  return read_next_symbol_slow(a, code);
+}
+
+static int
+read_next_symbol_slow(struct archive_read *a, struct huffman_code *code)
 {
   unsigned char bit;
   unsigned int bits;
@@ -2843,8 +2870,9 @@ new_node(struct huffman_code *code)
 static int
 make_table(struct archive_read *a, struct huffman_code *code)
 {
-  if (code->maxlength < code->minlength || code->maxlength > 10)
-    code->tablesize = 10;
+  if (code->maxlength < code->minlength ||
+      code->maxlength > HUFFMAN_TABLE_BITS)
+    code->tablesize = HUFFMAN_TABLE_BITS;
   else
     code->tablesize = code->maxlength;
 
@@ -2978,10 +3006,28 @@ expand(struct archive_read *a, int64_t *end)
 
     if (symbol < 256)
     {
-      lzss_emit_literal(rar, (uint8_t)symbol);
-      continue;
+      /*
+       * Literals come in runs.  Store a run through locals: stores
+       * into the window may alias anything, which would otherwise
+       * make every check around them reload from memory.
+       */
+      unsigned char *window = rar->lzss.window;
+      int64_t pos = rar->lzss.position, limit = *end;
+      int mask = rar->lzss.mask;
+
+      window[pos++ & mask] = (uint8_t)symbol;
+      while (pos < limit &&
+          (symbol = read_next_symbol(a, &rar->maincode)) >= 0 &&
+          symbol < 256)
+        window[pos++ & mask] = (uint8_t)symbol;
+      rar->lzss.position = pos;
+      if (symbol < 0)
+        goto bad_data;
+      if (symbol < 256)
+        continue;
+      /* A non-literal ended the run; handle it below. */
     }
-    else if (symbol == 256)
+    if (symbol == 256)
     {
       if (!rar_br_read_ahead(a, br, 1))
         goto truncated_data;
@@ -3703,7 +3749,8 @@ execute_filter_delta(struct rar_filter *filter, struct rar_virtual_machine *vm)
 
   src = &vm->memory[0];
   dst = &vm->memory[length];
-  for (i = 0; i < numchannels; i++)
+  /* Channels past the block length hold no bytes. */
+  for (i = 0; i < numchannels && i < length; i++)
   {
     uint8_t lastbyte = 0;
     for (idx = i; idx < length; idx += numchannels)
@@ -3724,6 +3771,32 @@ execute_filter_delta(struct rar_filter *filter, struct rar_virtual_machine *vm)
   return 1;
 }
 
+/*
+ * Find the next 0xE8 (or, with e9also, 0xE9) byte at or after 'i' and
+ * before 'end'.  Opcodes are sparse, so this skips eight bytes at a
+ * time with the usual zero-byte test on a 64-bit word.
+ */
+static uint32_t
+find_e8(const uint8_t *p, uint32_t i, uint32_t end, int e9also)
+{
+  const uint8_t *q;
+  uint64_t v;
+
+  if (!e9also) {
+    q = memchr(p + i, 0xE8, end - i);
+    return (q != NULL ? (uint32_t)(q - p) : end);
+  }
+  for (; i + 8 <= end; i += 8) {
+    memcpy(&v, p + i, 8);
+    v = (v & 0xFEFEFEFEFEFEFEFEULL) ^ 0xE8E8E8E8E8E8E8E8ULL;
+    if (((v - 0x0101010101010101ULL) & ~v & 0x8080808080808080ULL) != 0)
+      break;
+  }
+  while (i < end && (p[i] & 0xFE) != 0xE8)
+    i++;
+  return (i);
+}
+
 static int
 execute_filter_e8(struct rar_filter *filter, struct rar_virtual_machine *vm, size_t pos, int e9also)
 {
@@ -3736,7 +3809,8 @@ execute_filter_e8(struct rar_filter *filter, struct rar_virtual_machine *vm, siz
 
   for (i = 0; i <= length - 5; i++)
   {
-    if (vm->memory[i] == 0xE8 || (e9also && vm->memory[i] == 0xE9))
+    i = find_e8(vm->memory, i, length - 4, e9also);
+    if (i < length - 4)
     {
       uint32_t currpos = (uint32_t)pos + i + 1;
       int32_t address = (int32_t)vm_read_32(vm, i + 1);
@@ -3818,7 +3892,7 @@ execute_filter_audio(struct rar_filter *filter, struct rar_virtual_machine *vm)
 
   src = &vm->memory[0];
   dst = &vm->memory[length];
-  for (i = 0; i < numchannels; i++)
+  for (i = 0; i < numchannels && i < length; i++)
   {
     struct audio_state state;
     memset(&state, 0, sizeof(state));
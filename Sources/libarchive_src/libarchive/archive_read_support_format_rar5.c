@@ -46,6 +46,7 @@
 #include "archive_entry_locale.h"
 #include "archive_ppmd7_private.h"
 #include "archive_entry_private.h"
+#include "archive_thread_private.h"
 #include "archive_time_private.h"
 
 #ifdef HAVE_BLAKE2_H
@@ -170,6 +171,17 @@ struct filter_info {
 	int64_t block_start;
 	ssize_t block_length;
 	uint16_t width;
+
+	/* Set once the filter's input has been copied out of the window.
+	 * `output` starts as that copy and holds the filtered data when the
+	 * filter has finished; `input` is a second copy used only by DELTA,
+	 * which can't work in place. When `threaded` is set, the filter has
+	 * been handed to the worker pool as `task`. */
+	int started;
+	int threaded;
+	uint8_t* output;
+	uint8_t* input;
+	struct archive_thread_task task;
 };
 
 struct data_ready {
@@ -187,13 +199,22 @@ struct cdeque {
 	size_t* arr;
 };
 
+/* Number of leading bits resolved by a single lookup in the literal table;
+ * the smaller tables use 7. */
+#define QUICK_BITS_MAX 11
+
 struct decode_table {
 	uint32_t size;
 	int32_t decode_len[16];
 	uint32_t decode_pos[16];
 	uint32_t quick_bits;
-	uint8_t quick_len[1 << 10];
-	uint16_t quick_num[1 << 10];
+	uint8_t quick_len[1 << QUICK_BITS_MAX];
+	uint16_t quick_num[1 << QUICK_BITS_MAX];
+	/* Literal table only: when the lookup bits hold two whole literal
+	 * codes, their total length and the second literal. Zero length
+	 * means the entry doesn't start with two literals. */
+	uint8_t pair_len[1 << QUICK_BITS_MAX];
+	uint8_t pair_lit[1 << QUICK_BITS_MAX];
 	uint16_t decode_num[306];
 };
 
@@ -259,6 +280,7 @@ struct comp_state {
 
 	/* Circular deque for storing filters. */
 	struct cdeque filters;
+	int filter_jobs;             /* Filters running on worker threads. */
 	int64_t last_block_start;    /* Used for sanity checking. */
 	ssize_t last_block_length;   /* Used for sanity checking. */
 
@@ -365,6 +387,12 @@ struct rar5 {
 	 */
 	int has_encrypted_entries;
 	int headers_are_encrypted;
+
+	/* Number of threads used for unpacking, set by the "threads"
+	 * option. Filters run on the threads beyond the first one, which
+	 * are kept in `filter_pool` until the reader is freed. */
+	int threads;
+	struct archive_thread_pool* filter_pool;
 };
 
 /* Forward function declarations. */
@@ -533,19 +561,6 @@ static void circular_memcpy(uint8_t* dst, uint8_t* window, const ssize_t mask,
 	}
 }
 
-static uint32_t read_filter_data(struct rar5* rar, uint32_t offset) {
-	uint8_t linear_buf[4];
-	circular_memcpy(linear_buf, rar->cstate.window_buf,
-	    rar->cstate.window_mask, offset, offset + 4);
-	return archive_le32dec(linear_buf);
-}
-
-static void write_filter_data(struct rar5* rar, uint32_t offset,
-    uint32_t value)
-{
-	archive_le32enc(&rar->cstate.filtered_buf[offset], value);
-}
-
 /* Allocates a new filter descriptor and adds it to the filter array. */
 static struct filter_info* add_new_filter(struct rar5* rar) {
 	struct filter_info* f = calloc(1, sizeof(*f));
@@ -558,9 +573,15 @@ static struct filter_info* add_new_filter(struct rar5* rar) {
 	return f;
 }
 
-static int run_delta_filter(struct rar5* rar, struct filter_info* flt) {
+/* The filters below work on a private copy of the filter's input instead of
+ * the window, so that they can run on a worker thread while the decoder
+ * goes on filling the window. */
+
+static void run_delta_filter(struct filter_info* flt) {
+	const uint8_t* src = flt->input;
+	uint8_t* dst = flt->output;
+	ssize_t dest_pos;
 	int i;
-	ssize_t dest_pos, src_pos = 0;
 
 	for(i = 0; i < flt->channels; i++) {
 		uint8_t prev_byte = 0;
@@ -568,141 +589,226 @@ static int run_delta_filter(struct rar5* rar, struct filter_info* flt) {
 				dest_pos < flt->block_length;
 				dest_pos += flt->channels)
 		{
-			uint8_t byte;
+			prev_byte -= *src++;
+			dst[dest_pos] = prev_byte;
+		}
+	}
+}
 
-			byte = rar->cstate.window_buf[
-			    (rar->cstate.solid_offset + flt->block_start +
-			    src_pos) & rar->cstate.window_mask];
+/* Returns the offset of the first 0xE8 byte (or 0xE9 byte, if `extended` is
+ * set) in `buf[i..end)`, or `end` if there is none. Eight bytes are tested at
+ * a time; most of the data in an executable is not a call or a jump. */
+static ssize_t find_e8(const uint8_t* buf, ssize_t i, ssize_t end,
+    int extended)
+{
+	const uint64_t ones = UINT64_C(0x0101010101010101);
+	const uint64_t highs = UINT64_C(0x8080808080808080);
+	const uint64_t mask = extended ? ~ones : ~UINT64_C(0);
+
+	for(; i + 8 <= end; i += 8) {
+		uint64_t v;
+
+		memcpy(&v, buf + i, 8);
+		/* Clearing the low bit maps 0xE9 to 0xE8; then look for
+		 * a zero byte in v ^ 0xE8E8...E8. */
+		v = (v & mask) ^ (ones * 0xE8);
+		if(((v - ones) & ~v & highs) != 0)
+			break;
+	}
 
-			prev_byte -= byte;
-			rar->cstate.filtered_buf[dest_pos] = prev_byte;
-			src_pos++;
-		}
+	for(; i < end; i++) {
+		if(buf[i] == 0xE8 || (extended && buf[i] == 0xE9))
+			break;
 	}
 
-	return ARCHIVE_OK;
+	return i;
 }
 
-static int run_e8e9_filter(struct rar5* rar, struct filter_info* flt,
-		int extended)
-{
+static void run_e8e9_filter(struct filter_info* flt, int extended) {
 	const uint32_t file_size = 0x1000000;
+	uint8_t* buf = flt->output;
 	ssize_t i;
 
-	circular_memcpy(rar->cstate.filtered_buf,
-	    rar->cstate.window_buf, rar->cstate.window_mask,
-	    rar->cstate.solid_offset + flt->block_start,
-	    rar->cstate.solid_offset + flt->block_start + flt->block_length);
-
+	/*
+	 * 0xE8 = x86's call <relative_addr_uint32> (function call)
+	 * 0xE9 = x86's jmp <relative_addr_uint32> (unconditional jump)
+	 *
+	 * Converting in place is safe: every address is read before it is
+	 * rewritten, and the scan resumes after it.
+	 */
 	for(i = 0; i < flt->block_length - 4;) {
-		uint8_t b = rar->cstate.window_buf[
-		    (rar->cstate.solid_offset + flt->block_start +
-		    i++) & rar->cstate.window_mask];
+		uint32_t addr, offset;
 
-		/*
-		 * 0xE8 = x86's call <relative_addr_uint32> (function call)
-		 * 0xE9 = x86's jmp <relative_addr_uint32> (unconditional jump)
-		 */
-		if(b == 0xE8 || (extended && b == 0xE9)) {
-
-			uint32_t addr;
-			uint32_t offset = (i + flt->block_start) % file_size;
+		i = find_e8(buf, i, flt->block_length - 4, extended);
+		if(i >= flt->block_length - 4)
+			break;
 
-			addr = read_filter_data(rar,
-			    (uint32_t)(rar->cstate.solid_offset +
-			    flt->block_start + i) & rar->cstate.window_mask);
+		i++;
+		offset = (uint32_t) ((i + flt->block_start) % file_size);
+		addr = archive_le32dec(&buf[i]);
 
-			if(addr & 0x80000000) {
-				if(((addr + offset) & 0x80000000) == 0) {
-					write_filter_data(rar, (uint32_t)i,
-					    addr + file_size);
-				}
-			} else {
-				if((addr - file_size) & 0x80000000) {
-					uint32_t naddr = addr - offset;
-					write_filter_data(rar, (uint32_t)i,
-					    naddr);
-				}
+		if(addr & 0x80000000) {
+			if(((addr + offset) & 0x80000000) == 0) {
+				archive_le32enc(&buf[i], addr + file_size);
+			}
+		} else {
+			if((addr - file_size) & 0x80000000) {
+				archive_le32enc(&buf[i], addr - offset);
 			}
-
-			i += 4;
 		}
-	}
 
-	return ARCHIVE_OK;
+		i += 4;
+	}
 }
 
-static int run_arm_filter(struct rar5* rar, struct filter_info* flt) {
-	ssize_t i = 0;
+static void run_arm_filter(struct filter_info* flt) {
+	uint8_t* buf = flt->output;
+	ssize_t i;
 	uint32_t offset;
 
-	circular_memcpy(rar->cstate.filtered_buf,
-	    rar->cstate.window_buf, rar->cstate.window_mask,
-	    rar->cstate.solid_offset + flt->block_start,
-	    rar->cstate.solid_offset + flt->block_start + flt->block_length);
-
 	for(i = 0; i < flt->block_length - 3; i += 4) {
-		uint8_t* b = &rar->cstate.window_buf[
-		    (rar->cstate.solid_offset +
-		    flt->block_start + i + 3) & rar->cstate.window_mask];
-
-		if(*b == 0xEB) {
+		if(buf[i + 3] == 0xEB) {
 			/* 0xEB = ARM's BL (branch + link) instruction. */
-			offset = read_filter_data(rar,
-			    (rar->cstate.solid_offset + flt->block_start + i) &
-			     (uint32_t)rar->cstate.window_mask) & 0x00ffffff;
-
+			offset = archive_le32dec(&buf[i]) & 0x00ffffff;
 			offset -= (uint32_t) ((i + flt->block_start) / 4);
 			offset = (offset & 0x00ffffff) | 0xeb000000;
-			write_filter_data(rar, (uint32_t)i, offset);
+			archive_le32enc(&buf[i], offset);
 		}
 	}
-
-	return ARCHIVE_OK;
 }
 
-static int run_filter(struct archive_read* a, struct filter_info* flt) {
-	int ret;
-	struct rar5* rar = get_context(a);
-
-	clear_data_ready_stack(rar);
-	free(rar->cstate.filtered_buf);
-
-	rar->cstate.filtered_buf = malloc(flt->block_length);
-	if(!rar->cstate.filtered_buf) {
-		archive_set_error(&a->archive, ENOMEM,
-		    "Can't allocate memory for filter data.");
-		return ARCHIVE_FATAL;
-	}
+static void filter_job(void* data) {
+	struct filter_info* flt = (struct filter_info*) data;
 
 	switch(flt->type) {
 		case FILTER_DELTA:
-			ret = run_delta_filter(rar, flt);
+			run_delta_filter(flt);
 			break;
 
 		case FILTER_E8:
 			/* fallthrough */
 		case FILTER_E8E9:
-			ret = run_e8e9_filter(rar, flt,
-			    flt->type == FILTER_E8E9);
+			run_e8e9_filter(flt, flt->type == FILTER_E8E9);
 			break;
 
 		case FILTER_ARM:
-			ret = run_arm_filter(rar, flt);
+			run_arm_filter(flt);
 			break;
+	}
+}
 
-		default:
-			archive_set_error(&a->archive,
-			    ARCHIVE_ERRNO_FILE_FORMAT,
-			    "Unsupported filter type: 0x%x",
-			    (unsigned int)flt->type);
-			return ARCHIVE_FATAL;
+/* Filters shorter than this run right away even when worker threads are
+ * available; handing them over would cost more than running them. */
+#define FILTER_THREAD_MIN (64 * 1024)
+
+/* Copies the filter's input out of the window, and runs the filter on
+ * a worker thread if `threaded` is set, or right away otherwise. The
+ * filter's whole range must already be unpacked. */
+static int start_filter(struct archive_read* a, struct filter_info* flt,
+    int threaded)
+{
+	struct rar5* rar = get_context(a);
+	const int64_t start = rar->cstate.solid_offset + flt->block_start;
+	uint8_t* copy;
+
+	if(flt->type > FILTER_ARM) {
+		archive_set_error(&a->archive,
+		    ARCHIVE_ERRNO_FILE_FORMAT,
+		    "Unsupported filter type: 0x%x",
+		    (unsigned int)flt->type);
+		return ARCHIVE_FATAL;
 	}
 
-	if(ret != ARCHIVE_OK) {
-		/* Filter has failed. */
-		return ret;
+	flt->output = malloc(flt->block_length);
+	if(flt->type == FILTER_DELTA)
+		flt->input = malloc(flt->block_length);
+	if(!flt->output || (flt->type == FILTER_DELTA && !flt->input)) {
+		archive_set_error(&a->archive, ENOMEM,
+		    "Can't allocate memory for filter data.");
+		return ARCHIVE_FATAL;
+	}
+
+	copy = flt->type == FILTER_DELTA ? flt->input : flt->output;
+	circular_memcpy(copy, rar->cstate.window_buf,
+	    rar->cstate.window_mask, start, start + flt->block_length);
+	flt->started = 1;
+
+	if(threaded && flt->block_length >= FILTER_THREAD_MIN) {
+		if(rar->filter_pool == NULL)
+			rar->filter_pool =
+			    __archive_thread_pool_new(rar->threads - 1);
+		flt->threaded = 1;
+		rar->cstate.filter_jobs++;
+		__archive_thread_pool_run(rar->filter_pool, &flt->task,
+		    filter_job, flt);
+	} else {
+		filter_job(flt);
+	}
+
+	return ARCHIVE_OK;
+}
+
+/* Waits for the filter if it's running on a worker thread. */
+static void finish_filter(struct rar5* rar, struct filter_info* flt) {
+	if(flt->threaded) {
+		__archive_thread_pool_wait(rar->filter_pool, &flt->task);
+		flt->threaded = 0;
+		rar->cstate.filter_jobs--;
 	}
+}
+
+static void free_filter(struct rar5* rar, struct filter_info* flt) {
+	finish_filter(rar, flt);
+	free(flt->output);
+	free(flt->input);
+	free(flt);
+}
+
+/* Hands the filters whose ranges are already unpacked to worker threads,
+ * so that they run while the decoder continues with the data after them.
+ * At most `threads - 1` filters run at once. */
+static int start_filter_jobs(struct archive_read* a) {
+	struct rar5* rar = get_context(a);
+	struct cdeque* d = &rar->cstate.filters;
+	uint16_t i;
+	int ret;
+
+	for(i = 0; i < d->size &&
+	    rar->cstate.filter_jobs < rar->threads - 1; i++) {
+		struct filter_info* flt = (struct filter_info*)
+		    d->arr[(d->beg_pos + i) & d->cap_mask];
+
+		if(rar->cstate.write_ptr < flt->block_start + flt->block_length)
+			break;
+
+		if(flt->started)
+			continue;
+
+		ret = start_filter(a, flt, 1);
+		if(ret != ARCHIVE_OK)
+			return ret;
+	}
+
+	return ARCHIVE_OK;
+}
+
+static int run_filter(struct archive_read* a, struct filter_info* flt) {
+	int ret;
+	struct rar5* rar = get_context(a);
+
+	if(!flt->started) {
+		ret = start_filter(a, flt, 0);
+		if(ret != ARCHIVE_OK)
+			return ret;
+	}
+	finish_filter(rar, flt);
+
+	clear_data_ready_stack(rar);
+	free(rar->cstate.filtered_buf);
+
+	/* The filter's output becomes the buffer handed to the user. */
+	rar->cstate.filtered_buf = flt->output;
+	flt->output = NULL;
 
 	if(ARCHIVE_OK != push_data_ready(a, rar, rar->cstate.filtered_buf,
 	    flt->block_length, rar->cstate.last_write_ptr))
@@ -804,7 +910,7 @@ static int apply_filters(struct archive_read* a) {
 				(void) cdeque_pop_front(&rar->cstate.filters,
 				    cdeque_filter_p(&flt));
 
-				free(flt);
+				free_filter(rar, flt);
 			} else {
 				/* We can't run filters yet, dump the memory
 				 * right before the filter. */
@@ -858,7 +964,7 @@ static void free_filters(struct rar5* rar) {
 
 		/* Pop_front will also decrease the collection's size. */
 		if (CDE_OK == cdeque_pop_front(d, cdeque_filter_p(&f)))
-			free(f);
+			free_filter(rar, f);
 	}
 
 	cdeque_clear(d);
@@ -1032,6 +1138,26 @@ static int read_var_sized(struct archive_read* a, size_t* pvalue,
 	return ret;
 }
 
+/* Returns the 32 bits that follow the current bit position. Block buffers
+ * are read with at least 4 bytes of slack after the block, so most of the
+ * time this is a single 64-bit load; only the last few bytes of a block
+ * fall back to a 40-bit one. */
+static inline uint32_t peek_bits_32(const struct rar5* rar,
+	const uint8_t* p)
+{
+	const uint8_t* q = p + rar->bits.in_addr;
+	uint64_t bits;
+
+	if(rar->bits.in_addr + 4 <= rar->cstate.cur_block_size) {
+		bits = archive_be64dec(q);
+	} else {
+		bits = ((uint64_t) archive_be32dec(q) << 32) |
+		    ((uint64_t) q[4] << 24);
+	}
+
+	return (uint32_t) (bits >> (32 - rar->bits.bit_addr));
+}
+
 static int read_bits_32(struct archive_read* a, struct rar5* rar,
 	const uint8_t* p, uint32_t* value)
 {
@@ -1042,13 +1168,7 @@ static int read_bits_32(struct archive_read* a, struct rar5* rar,
 		return ARCHIVE_FATAL;
 	}
 
-	uint32_t bits = ((uint32_t) p[rar->bits.in_addr]) << 24;
-	bits |= p[rar->bits.in_addr + 1] << 16;
-	bits |= p[rar->bits.in_addr + 2] << 8;
-	bits |= p[rar->bits.in_addr + 3];
-	bits <<= rar->bits.bit_addr;
-	bits |= p[rar->bits.in_addr + 4] >> (8 - rar->bits.bit_addr);
-	*value = bits;
+	*value = peek_bits_32(rar, p);
 	return ARCHIVE_OK;
 }
 
@@ -1062,11 +1182,7 @@ static int read_bits_16(struct archive_read* a, struct rar5* rar,
 		return ARCHIVE_FATAL;
 	}
 
-	int bits = (int) ((uint32_t) p[rar->bits.in_addr]) << 16;
-	bits |= (int) p[rar->bits.in_addr + 1] << 8;
-	bits |= (int) p[rar->bits.in_addr + 2];
-	bits >>= (8 - rar->bits.bit_addr);
-	*value = bits & 0xffff;
+	*value = (uint16_t) (peek_bits_32(rar, p) >> 16);
 	return ARCHIVE_OK;
 }
 
@@ -1195,13 +1311,14 @@ static int rar5_bid(struct archive_read* a, int best_bid) {
 
 static int rar5_options(struct archive_read *a, const char *key,
     const char *val) {
-	(void) a;
-	(void) key;
-	(void) val;
+	struct rar5* rar = get_context(a);
 
-	/* No options supported in this version. Return the ARCHIVE_WARN code
-	 * to signal the options supervisor that the unpacker didn't handle
-	 * setting this option. */
+	if(strcmp(key, "threads") == 0)
+		return __archive_thread_parse_count(&a->archive, val,
+		    &rar->threads);
+
+	/* Return the ARCHIVE_WARN code to signal the options supervisor that
+	 * the unpacker didn't handle setting this option. */
 
 	return ARCHIVE_WARN;
 }
@@ -2576,7 +2693,7 @@ static int create_decode_tables(uint8_t* bit_length,
 	memset(&lc, 0, sizeof(lc));
 	memset(table->decode_num, 0, sizeof(table->decode_num));
 	table->size = size;
-	table->quick_bits = size == HUFF_NC ? 10 : 7;
+	table->quick_bits = size == HUFF_NC ? QUICK_BITS_MAX : 7;
 
 	for(i = 0; i < size; i++) {
 		lc[bit_length[i] & 15]++;
@@ -2630,11 +2747,36 @@ static int create_decode_tables(uint8_t* bit_length,
 		}
 	}
 
+	if(size != HUFF_NC)
+		return ARCHIVE_OK;
+
+	/* The bits left over after a short literal code often hold the whole
+	 * code of the next literal too. Record those, so that runs of
+	 * literals can be decoded two at a time. */
+	for(code = 0; code < quick_data_size; code++) {
+		const int len1 = table->quick_len[code];
+		int code2, len2;
+
+		table->pair_len[code] = 0;
+		if(len1 >= (int) table->quick_bits ||
+		    table->quick_num[code] >= 256)
+			continue;
+
+		code2 = (code << len1) & (int) (quick_data_size - 1);
+		len2 = table->quick_len[code2];
+		if(len1 + len2 > (int) table->quick_bits ||
+		    table->quick_num[code2] >= 256)
+			continue;
+
+		table->pair_len[code] = (uint8_t) (len1 + len2);
+		table->pair_lit[code] = (uint8_t) table->quick_num[code2];
+	}
+
 	return ARCHIVE_OK;
 }
 
-static int decode_number(struct archive_read* a, struct decode_table* table,
-    const uint8_t* p, uint16_t* num)
+static inline int decode_number(struct archive_read* a,
+    struct decode_table* table, const uint8_t* p, uint16_t* num)
 {
 	int i, bits, dist, ret;
 	uint16_t bitfield;
@@ -3059,23 +3201,46 @@ static int copy_string(struct archive_read* a, int len, int dist) {
 	const ssize_t cmask = rar->cstate.window_mask;
 	const uint64_t write_ptr = rar->cstate.write_ptr +
 	    rar->cstate.solid_offset;
+	const ssize_t write_idx = write_ptr & cmask;
+	const ssize_t read_idx = (write_ptr - dist) & cmask;
+	uint8_t* window = rar->cstate.window_buf;
 	int i;
 
-	if (rar->cstate.window_buf == NULL)
+	if (window == NULL)
 		return ARCHIVE_FATAL;
 
-	/* The unpacker spends most of the time in this function. It would be
-	 * a good idea to introduce some optimizations here.
-	 *
-	 * Just remember that this loop treats buffers that overlap differently
-	 * than buffers that do not overlap. This is why a simple memcpy(3)
-	 * call will not be enough. */
-
-	for(i = 0; i < len; i++) {
-		const ssize_t write_idx = (write_ptr + i) & cmask;
-		const ssize_t read_idx = (write_ptr + i - dist) & cmask;
-		rar->cstate.window_buf[write_idx] =
-		    rar->cstate.window_buf[read_idx];
+	/* The result must be the same as copying one byte at a time, because
+	 * the source and destination may overlap: a distance shorter than the
+	 * length repeats the last `dist` bytes. Only the copies that reach
+	 * past the window edge need to wrap each index; the others use
+	 * wide copies. */
+	if(write_idx + len <= cmask + 1 && read_idx + len <= cmask + 1) {
+		uint8_t* dst = &window[write_idx];
+		const uint8_t* src = &window[read_idx];
+
+		if(src > dst || dst - src >= len) {
+			/* No overlap, or the source is ahead of the
+			 * destination, where a forward copy is safe. */
+			memmove(dst, src, len);
+		} else if(dst - src == 1) {
+			memset(dst, *src, len);
+		} else {
+			i = 0;
+			if(dst - src >= 8) {
+				/* Each 8 byte chunk reads only bytes that
+				 * were written before it. */
+				for(; i + 8 <= len; i += 8)
+					memcpy(dst + i, src + i, 8);
+			}
+			for(; i < len; i++)
+				dst[i] = src[i];
+		}
+	} else {
+		for(i = 0; i < len; i++) {
+			const ssize_t widx = (write_ptr + i) & cmask;
+			const ssize_t ridx = (write_ptr + i - dist) & cmask;
+			window[widx] = window[ridx];
+		}
 	}
 
 	rar->cstate.write_ptr += len;
@@ -3111,8 +3276,40 @@ static int do_uncompress_block(struct archive_read* a, const uint8_t* p) {
 			break;
 		}
 
-		/* Decode the next literal. */
-		if(ARCHIVE_OK != decode_number(a, &rar->cstate.ld, p, &num)) {
+		/* Decode the next literal. Away from the end of the block,
+		 * the quick table lookup is done here, on bits that may also
+		 * hold the whole next literal; such pairs are stored at once.
+		 * Near the end, decode_number() checks every read, and the
+		 * second literal of a pair could come from the padding after
+		 * the block. */
+		if(rar->bits.in_addr + 4 < rar->cstate.cur_block_size) {
+			const struct decode_table* ld = &rar->cstate.ld;
+			const uint32_t bits = peek_bits_32(rar, p);
+			const uint32_t code = bits >> (32 - ld->quick_bits);
+
+			if(ld->pair_len[code] != 0) {
+				int64_t write_idx = rar->cstate.solid_offset +
+				    rar->cstate.write_ptr;
+
+				rar->cstate.window_buf[write_idx & cmask] =
+				    (uint8_t) ld->quick_num[code];
+				rar->cstate.window_buf[(write_idx + 1) & cmask] =
+				    ld->pair_lit[code];
+				rar->cstate.write_ptr += 2;
+				skip_bits(rar, ld->pair_len[code]);
+				continue;
+			}
+
+			if((int32_t) ((bits >> 16) & 0xfffe) <
+			    ld->decode_len[ld->quick_bits]) {
+				skip_bits(rar, ld->quick_len[code]);
+				num = ld->quick_num[code];
+			} else if(ARCHIVE_OK != decode_number(a, &rar->cstate.ld,
+			    p, &num)) {
+				return ARCHIVE_EOF;
+			}
+		} else if(ARCHIVE_OK != decode_number(a, &rar->cstate.ld, p,
+		    &num)) {
 			return ARCHIVE_EOF;
 		}
 
@@ -3852,6 +4049,12 @@ static int do_uncompress_file(struct archive_read* a) {
 			 * the loop. */
 			break;
 		}
+
+		if(rar->threads > 1) {
+			ret = start_filter_jobs(a);
+			if(ret != ARCHIVE_OK)
+				return ret;
+		}
 	}
 
 	/* Try to run filters. If filters won't be applied, it means that
@@ -4281,6 +4484,7 @@ static int rar5_cleanup(struct archive_read *a) {
 
 	free_filters(rar);
 	cdeque_free(&rar->cstate.filters);
+	__archive_thread_pool_free(rar->filter_pool);
 
 	free(rar);
 	a->format->data = NULL;
@@ -4316,6 +4520,7 @@ static int rar5_init(struct rar5* rar) {
 	 * any encrypted entries yet.
 	 */
 	rar->has_encrypted_entries = ARCHIVE_READ_FORMAT_ENCRYPTION_DONT_KNOW;
+	rar->threads = 1;
 
 	return ARCHIVE_OK;
 }
@@ -31,15 +31,21 @@
 #include <errno.h>
 #endif
 #include <stddef.h>
+#include <stdio.h>
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>
 #endif
 #ifdef HAVE_STRING_H
 #include <string.h>
 #endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "archive.h"
 #include "archive_acl_private.h" /* For ACL parsing routines. */
+#include "archive_base64_private.h"
+#include "archive_endian.h"
 #include "archive_entry.h"
 #include "archive_entry_locale.h"
 #include "archive_private.h"
@@ -116,6 +122,32 @@ struct sparse_block {
 	int hole;
 };
 
+/*
+ * Sidecar index of a tar archive: where each entry's headers and body
+ * start, keyed by the entry's fully-resolved (pax/GNU long name)
+ * pathname.  Entries live in an array; the hash chains link array
+ * slots so that the array can be grown freely while building.
+ */
+struct tar_index_entry {
+	int64_t			 header_offset;
+	int64_t			 data_offset;
+	int64_t			 data_size;
+	uint32_t		 mode;
+	char			*pathname;	/* UTF-8 */
+	char			*linkname;	/* UTF-8, or NULL */
+	size_t			 hash_next;
+};
+
+struct tar_index {
+	struct tar_index_entry	*entries;
+	size_t			 count;
+	size_t			 allocated;
+	size_t			*buckets;
+	size_t			 nbuckets;
+};
+
+#define TAR_INDEX_NONE ((size_t)-1)
+
 struct tar {
 	struct archive_string	 entry_pathname;
 	/* For "GNU.sparse.name" and other similar path extensions. */
@@ -145,6 +177,7 @@ struct tar {
 	char			 size_fields; /* Bits defined below */
 
 	struct archive_string	 localname;
+	struct archive_string	 special_body;	/* 'A', 'K' and 'L' bodies */
 	struct archive_string_conv *opt_sconv;
 	struct archive_string_conv *sconv;
 	struct archive_string_conv *sconv_acl;
@@ -153,6 +186,12 @@ struct tar {
 	int			 compat_2x;
 	int			 process_mac_extensions;
 	int			 read_concatenated_archives;
+
+	/* Sidecar index, built while reading or loaded from disk. */
+	struct tar_index	 index;
+	char			*index_write_path;
+	int			 index_loaded;
+	int			 index_seeked;
 };
 
 /* Track which size fields were present in the headers */
@@ -161,6 +200,50 @@ struct tar {
 #define TAR_SIZE_GNU_SPARSE_SIZE 4
 #define TAR_SIZE_SCHILY_SPARSE_REALSIZE 8
 
+/*
+ * Recognized pax keywords.  The keyword is classified while it is
+ * still in the read-ahead buffer, so it never needs to be copied.
+ */
+enum pax_keyword {
+	PAX_UNKNOWN = 0,
+	PAX_ATIME,
+	PAX_CTIME,
+	PAX_GID,
+	PAX_GNAME,
+	PAX_HDRCHARSET,
+	PAX_LINKPATH,
+	PAX_MTIME,
+	PAX_PATH,
+	PAX_SIZE,
+	PAX_UID,
+	PAX_UNAME,
+	PAX_GNU_SPARSE,		/* GNU.sparse and unknown GNU.sparse.* */
+	PAX_GNU_SPARSE_MAJOR,
+	PAX_GNU_SPARSE_MAP,
+	PAX_GNU_SPARSE_MINOR,
+	PAX_GNU_SPARSE_NAME,
+	PAX_GNU_SPARSE_NUMBLOCKS,
+	PAX_GNU_SPARSE_NUMBYTES,
+	PAX_GNU_SPARSE_OFFSET,
+	PAX_GNU_SPARSE_REALSIZE,
+	PAX_GNU_SPARSE_SIZE,
+	PAX_LIBARCHIVE_CREATIONTIME,
+	PAX_LIBARCHIVE_SYMLINKTYPE,
+	PAX_LIBARCHIVE_XATTR,	/* LIBARCHIVE.xattr.* */
+	PAX_RHT_SECURITY_SELINUX,
+	PAX_SCHILY_ACL_ACCESS,
+	PAX_SCHILY_ACL_ACE,
+	PAX_SCHILY_ACL_DEFAULT,
+	PAX_SCHILY_DEV,
+	PAX_SCHILY_DEVMAJOR,
+	PAX_SCHILY_DEVMINOR,
+	PAX_SCHILY_FFLAGS,
+	PAX_SCHILY_INO,
+	PAX_SCHILY_NLINK,
+	PAX_SCHILY_REALSIZE,
+	PAX_SCHILY_XATTR,	/* SCHILY.xattr.* */
+	PAX_SUN_HOLESDATA,
+};
 
 static int	archive_block_is_null(const char *p);
 static char	*base64_decode(const char *, size_t, size_t *);
@@ -210,12 +293,16 @@ static int	archive_read_format_tar_read_header(struct archive_read *,
 		    struct archive_entry *);
 static int	checksum(struct archive_read *, const void *);
 static int 	pax_attribute(struct archive_read *, struct tar *,
-		    struct archive_entry *, const char *key, size_t key_length,
-		    size_t value_length, int64_t *unconsumed);
+		    struct archive_entry *, enum pax_keyword,
+		    const char *key, size_t key_length,
+		    const char *value, size_t value_length);
+static int	pax_attribute_check_length(struct archive_read *,
+		    enum pax_keyword, const char *, size_t, size_t);
+static enum pax_keyword	pax_keyword(const char *, size_t);
 static int	pax_attribute_LIBARCHIVE_xattr(struct archive_entry *,
 		    const char *, size_t, const char *, size_t);
 static int	pax_attribute_SCHILY_acl(struct archive_read *, struct tar *,
-		    struct archive_entry *, size_t, int);
+		    struct archive_entry *, const char *, size_t, int);
 static int	pax_attribute_SUN_holesdata(struct archive_read *, struct tar *,
 		    struct archive_entry *, const char *, size_t);
 static void	pax_time(const char *, size_t, int64_t *sec, long *nanos);
@@ -234,6 +321,12 @@ static int	tar_read_header(struct archive_read *, struct tar *,
 static int	tohex(int c);
 static char	*url_decode(const char *, size_t);
 static void	tar_flush_unconsumed(struct archive_read *, int64_t *);
+static int	tar_index_add(struct archive_read *, struct tar *,
+		    struct archive_entry *, int64_t, int64_t);
+static void	tar_index_free(struct tar_index *);
+static int	tar_index_load(struct archive_read *, struct tar *,
+		    const char *);
+static int	tar_index_save(struct archive_read *, struct tar *);
 
 /* Sanity limits:  These numbers should be low enough to
  * prevent a maliciously-crafted archive from forcing us to
@@ -308,6 +401,9 @@ archive_read_format_tar_cleanup(struct archive_read *a)
 	archive_string_free(&tar->entry_linkpath);
 	archive_string_free(&tar->line);
 	archive_string_free(&tar->localname);
+	archive_string_free(&tar->special_body);
+	tar_index_free(&tar->index);
+	free(tar->index_write_path);
 	free(tar);
 	(a->format->data) = NULL;
 	return (ARCHIVE_OK);
@@ -465,6 +561,25 @@ archive_read_format_tar_options(struct archive_read *a,
 	} else if (strcmp(key, "read_concatenated_archives") == 0) {
 		tar->read_concatenated_archives = (val != NULL && val[0] != 0);
 		return (ARCHIVE_OK);
+	} else if (strcmp(key, "write-index") == 0) {
+		free(tar->index_write_path);
+		tar->index_write_path = NULL;
+		if (val != NULL && val[0] != 0) {
+			tar->index_write_path = strdup(val);
+			if (tar->index_write_path == NULL) {
+				archive_set_error(&a->archive, ENOMEM,
+				    "Can't allocate tar index path");
+				return (ARCHIVE_FATAL);
+			}
+		}
+		return (ARCHIVE_OK);
+	} else if (strcmp(key, "read-index") == 0) {
+		if (val == NULL || val[0] == 0) {
+			archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
+			    "tar: read-index option needs a file name");
+			return (ARCHIVE_FAILED);
+		}
+		return (tar_index_load(a, tar, val));
 	}
 
 	/* Note: The "warn" return is just to inform the options
@@ -558,6 +673,22 @@ archive_read_format_tar_read_header(struct archive_read *a,
 
 	tar_flush_unconsumed(a, &unconsumed);
 
+	/*
+	 * Record the entry in the sidecar index.  Once the caller has
+	 * seeked, the archive is no longer being read in order, so
+	 * there is nothing sensible to record.
+	 */
+	if (tar->index_write_path != NULL && !tar->index_seeked) {
+		if (r == ARCHIVE_EOF) {
+			if (tar_index_save(a, tar) != ARCHIVE_OK)
+				return (ARCHIVE_FATAL);
+		} else if (r >= ARCHIVE_WARN) {
+			if (tar_index_add(a, tar, entry, a->header_position,
+			    a->filter->position) != ARCHIVE_OK)
+				return (ARCHIVE_FATAL);
+		}
+	}
+
 	/*
 	 * "non-sparse" files are really just sparse files with
 	 * a single block.
@@ -985,6 +1116,59 @@ tar_read_header(struct archive_read *a, struct tar *tar,
 	}
 }
 
+/*
+ * Sum all 512 bytes of a header block, once treating the bytes as
+ * unsigned and once as signed.  A signed byte is just the unsigned
+ * byte minus 256 when the high bit is set, so both sums come out of a
+ * single pass over the block.
+ */
+static void
+tar_block_sums(const unsigned char *p, int *usum, int *ssum)
+{
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i flip = _mm_set1_epi8((char)0x80);
+	__m128i u = zero, s = zero, v;
+	int i;
+
+	/*
+	 * PSADBW against zero sums 8 bytes into each 64-bit lane.  For the
+	 * signed sum, flipping the high bit maps each byte b to b + 128.
+	 */
+	for (i = 0; i < 512; i += 16) {
+		v = _mm_loadu_si128((const __m128i *)(p + i));
+		u = _mm_add_epi64(u, _mm_sad_epu8(v, zero));
+		s = _mm_add_epi64(s, _mm_sad_epu8(_mm_xor_si128(v, flip), zero));
+	}
+	u = _mm_add_epi64(u, _mm_unpackhi_epi64(u, u));
+	s = _mm_add_epi64(s, _mm_unpackhi_epi64(s, s));
+	*usum = _mm_cvtsi128_si32(u);
+	*ssum = _mm_cvtsi128_si32(s) - 128 * 512;
+#else
+	const uint64_t m8 = ARCHIVE_LITERAL_ULL(0x00ff00ff00ff00ff);
+	const uint64_t m16 = ARCHIVE_LITERAL_ULL(0x0000ffff0000ffff);
+	const uint64_t hibits = ARCHIVE_LITERAL_ULL(0x0101010101010101);
+	uint64_t w, sum = 0, neg = 0;
+	int i;
+
+	/*
+	 * Word-at-a-time: add byte pairs into 16-bit lanes and count
+	 * high bits in 8-bit lanes.  Neither can overflow over 64 words.
+	 */
+	for (i = 0; i < 512; i += 8) {
+		memcpy(&w, p + i, sizeof(w));
+		sum += (w & m8) + ((w >> 8) & m8);
+		neg += (w >> 7) & hibits;
+	}
+	sum = (sum & m16) + ((sum >> 16) & m16);
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	neg = (neg & m8) + ((neg >> 8) & m8);
+	neg = (neg * ARCHIVE_LITERAL_ULL(0x0001000100010001)) >> 48;
+	*usum = (int)sum;
+	*ssum = (int)sum - 256 * (int)neg;
+#endif
+}
+
 /*
  * Return true if block checksum is correct.
  */
@@ -993,7 +1177,7 @@ checksum(struct archive_read *a, const void *h)
 {
 	const unsigned char *bytes;
 	const struct archive_entry_header_ustar	*header;
-	int check, sum;
+	int ucheck, scheck, sum;
 	size_t i;
 
 	(void)a; /* UNUSED */
@@ -1009,32 +1193,18 @@ checksum(struct archive_read *a, const void *h)
 
 	/*
 	 * Test the checksum.  Note that POSIX specifies _unsigned_
-	 * bytes for this calculation.
+	 * bytes for this calculation, but we also accept the _signed_
+	 * variant, just in case this archive was created by an old BSD,
+	 * Solaris, or HP-UX tar with a broken checksum calculation.
+	 * The checksum field itself counts as eight spaces.
 	 */
 	sum = (int)tar_atol(header->checksum, sizeof(header->checksum));
-	check = 0;
-	for (i = 0; i < 148; i++)
-		check += (unsigned char)bytes[i];
-	for (; i < 156; i++)
-		check += 32;
-	for (; i < 512; i++)
-		check += (unsigned char)bytes[i];
-	if (sum == check)
-		return (1);
-
-	/*
-	 * Repeat test with _signed_ bytes, just in case this archive
-	 * was created by an old BSD, Solaris, or HP-UX tar with a
-	 * broken checksum calculation.
-	 */
-	check = 0;
-	for (i = 0; i < 148; i++)
-		check += (signed char)bytes[i];
-	for (; i < 156; i++)
-		check += 32;
-	for (; i < 512; i++)
-		check += (signed char)bytes[i];
-	if (sum == check)
+	tar_block_sums(bytes, &ucheck, &scheck);
+	for (i = 148; i < 156; i++) {
+		ucheck += 32 - (unsigned char)bytes[i];
+		scheck += 32 - (signed char)bytes[i];
+	}
+	if (sum == ucheck || sum == scheck)
 		return (1);
 
 #if DONT_FAIL_ON_CRC_ERROR
@@ -1051,11 +1221,19 @@ checksum(struct archive_read *a, const void *h)
 static int
 archive_block_is_null(const char *p)
 {
-	unsigned i;
-
-	for (i = 0; i < 512; i++)
-		if (*p++)
+	uint64_t w, acc;
+	unsigned i, j;
+
+	/* OR together a cache line at a time; bail at the first nonzero. */
+	for (i = 0; i < 512; i += 64) {
+		acc = 0;
+		for (j = 0; j < 64; j += 8) {
+			memcpy(&w, p + i + j, sizeof(w));
+			acc |= w;
+		}
+		if (acc != 0)
 			return (0);
+	}
 	return (1);
 }
 
@@ -1067,7 +1245,7 @@ header_Solaris_ACL(struct archive_read *a, struct tar *tar,
     struct archive_entry *entry, const void *h, int64_t *unconsumed)
 {
 	const struct archive_entry_header_ustar *header;
-	struct archive_string	 acl_text;
+	struct archive_string	*acl_text = &tar->special_body;
 	size_t size;
 	int err, acl_type;
 	uint64_t type;
@@ -1075,12 +1253,9 @@ header_Solaris_ACL(struct archive_read *a, struct tar *tar,
 
 	header = (const struct archive_entry_header_ustar *)h;
 	size = (size_t)tar_atol(header->size, sizeof(header->size));
-	archive_string_init(&acl_text);
-	err = read_body_to_string(a, tar, &acl_text, h, unconsumed);
-	if (err != ARCHIVE_OK) {
-		archive_string_free(&acl_text);
+	err = read_body_to_string(a, tar, acl_text, h, unconsumed);
+	if (err != ARCHIVE_OK)
 		return (err);
-	}
 
 	/* TODO: Examine the first characters to see if this
 	 * is an AIX ACL descriptor.  We'll likely never support
@@ -1088,13 +1263,12 @@ header_Solaris_ACL(struct archive_read *a, struct tar *tar,
 	 * we do see them. */
 
 	/* Leading octal number indicates ACL type and number of entries. */
-	p = acl = acl_text.s;
+	p = acl = acl_text->s;
 	type = 0;
 	while (*p != '\0' && p < acl + size) {
 		if (*p < '0' || *p > '7') {
 			archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
 			    "Malformed Solaris ACL attribute (invalid digit)");
-			archive_string_free(&acl_text);
 			return(ARCHIVE_WARN);
 		}
 		type <<= 3;
@@ -1102,7 +1276,6 @@ header_Solaris_ACL(struct archive_read *a, struct tar *tar,
 		if (type > 077777777) {
 			archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
 			    "Malformed Solaris ACL attribute (count too large)");
-			archive_string_free(&acl_text);
 			return (ARCHIVE_WARN);
 		}
 		p++;
@@ -1120,7 +1293,6 @@ header_Solaris_ACL(struct archive_read *a, struct tar *tar,
 		archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
 		    "Malformed Solaris ACL attribute (unsupported type %llu)",
 		    (unsigned long long)type);
-		archive_string_free(&acl_text);
 		return (ARCHIVE_WARN);
 	}
 	p++;
@@ -1128,7 +1300,6 @@ header_Solaris_ACL(struct archive_read *a, struct tar *tar,
 	if (p >= acl + size) {
 		archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
 		    "Malformed Solaris ACL attribute (body overflow)");
-		archive_string_free(&acl_text);
 		return(ARCHIVE_WARN);
 	}
 
@@ -1142,10 +1313,8 @@ header_Solaris_ACL(struct archive_read *a, struct tar *tar,
 	if (tar->sconv_acl == NULL) {
 		tar->sconv_acl = archive_string_conversion_from_charset(
 		    &(a->archive), "UTF-8", 1);
-		if (tar->sconv_acl == NULL) {
-			archive_string_free(&acl_text);
+		if (tar->sconv_acl == NULL)
 			return (ARCHIVE_FATAL);
-		}
 	}
 	archive_strncpy(&(tar->localname), acl, p - acl);
 	err = archive_acl_from_text_l(archive_entry_acl(entry),
@@ -1161,7 +1330,6 @@ header_Solaris_ACL(struct archive_read *a, struct tar *tar,
 			archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
 			    "Malformed Solaris ACL attribute (unparsable)");
 	}
-	archive_string_free(&acl_text);
 	return (err);
 }
 
@@ -1174,13 +1342,10 @@ header_gnu_longlink(struct archive_read *a, struct tar *tar,
 {
 	int err;
 
-	struct archive_string linkpath;
-	archive_string_init(&linkpath);
-	err = read_body_to_string(a, tar, &linkpath, h, unconsumed);
+	err = read_body_to_string(a, tar, &tar->special_body, h, unconsumed);
 	if (err == ARCHIVE_OK) {
-		archive_entry_set_link(entry, linkpath.s);
+		archive_entry_set_link(entry, tar->special_body.s);
 	}
-	archive_string_free(&linkpath);
 	return (err);
 }
 
@@ -1207,16 +1372,14 @@ header_gnu_longname(struct archive_read *a, struct tar *tar,
     struct archive_entry *entry, const void *h, int64_t *unconsumed)
 {
 	int err;
-	struct archive_string longname;
+	struct archive_string *longname = &tar->special_body;
 
-	archive_string_init(&longname);
-	err = read_body_to_string(a, tar, &longname, h, unconsumed);
+	err = read_body_to_string(a, tar, longname, h, unconsumed);
 	if (err == ARCHIVE_OK) {
-		if (archive_entry_copy_pathname_l(entry, longname.s,
-		    archive_strlen(&longname), tar->sconv) != 0)
+		if (archive_entry_copy_pathname_l(entry, longname->s,
+		    archive_strlen(longname), tar->sconv) != 0)
 			err = set_conversion_failed_error(a, tar->sconv, "Pathname");
 	}
-	archive_string_free(&longname);
 	return (err);
 }
 
@@ -1337,18 +1500,20 @@ header_common(struct archive_read *a, struct tar *tar,
 	const struct archive_entry_header_ustar	*header;
 	const char *existing_linkpath;
 	const wchar_t *existing_wcs_linkpath;
+	int64_t	header_size;
+	mode_t	mode;
 	int     err = ARCHIVE_OK;
 
 	header = (const struct archive_entry_header_ustar *)h;
 
 	/* Parse out the numeric fields (all are octal) */
+	header_size = tar_atol(header->size, sizeof(header->size));
 
 	/* Split mode handling: Set filetype always, perm only if not already set */
-	archive_entry_set_filetype(entry,
-	    (mode_t)tar_atol(header->mode, sizeof(header->mode)));
+	mode = (mode_t)tar_atol(header->mode, sizeof(header->mode));
+	archive_entry_set_filetype(entry, mode);
 	if (!archive_entry_perm_is_set(entry)) {
-		archive_entry_set_perm(entry,
-			(mode_t)tar_atol(header->mode, sizeof(header->mode)));
+		archive_entry_set_perm(entry, mode);
 	}
 
 	/* Set uid, gid, mtime if not already set */
@@ -1379,7 +1544,7 @@ header_common(struct archive_read *a, struct tar *tar,
 		tar->disk_size = tar->pax_size;
 	} else {
 		/* There wasn't a suitable pax header, so use the ustar info */
-		tar->disk_size = tar_atol(header->size, sizeof(header->size));
+		tar->disk_size = header_size;
 	}
 
 	if (tar->disk_size < 0) {
@@ -1403,8 +1568,7 @@ header_common(struct archive_read *a, struct tar *tar,
 	} else if ((tar->size_fields & TAR_SIZE_PAX_SIZE) != 0) {
 		tar->entry_bytes_remaining = tar->pax_size;
 	} else {
-		tar->entry_bytes_remaining
-			= tar_atol(header->size, sizeof(header->size));
+		tar->entry_bytes_remaining = header_size;
 	}
 	if (tar->entry_bytes_remaining < 0) {
 		tar->entry_bytes_remaining = 0;
@@ -1870,11 +2034,13 @@ header_pax_extension(struct archive_read *a, struct tar *tar,
 	int64_t ext_size, ext_padding;
 	size_t line_length, value_length, name_length;
 	ssize_t to_read, did_read;
+	size_t prolog_length;
 	const struct archive_entry_header_ustar *header;
 	const char *p, *attr_start, *name_start;
 	struct archive_string_conv *sconv;
 	struct archive_string *pas = NULL;
-	struct archive_string attr_name;
+	enum pax_keyword kw;
+	char value_end;
 	int err = ARCHIVE_OK, r;
 
 	header = (const struct archive_entry_header_ustar *)h;
@@ -1903,7 +2069,6 @@ header_pax_extension(struct archive_read *a, struct tar *tar,
 	tar_flush_unconsumed(a, unconsumed);
 
 	/* Parse the size/name of each pax attribute in the body */
-	archive_string_init(&attr_name);
 	while (ext_size > 0) {
 		/* Read enough bytes to parse the size/name of the next attribute */
 		to_read = max_size_name;
@@ -1986,16 +2151,8 @@ header_pax_extension(struct archive_read *a, struct tar *tar,
 		name_length = p - name_start;
 		p++; // Skip '='
 
-		// Save the name before we consume it
-		archive_strncpy(&attr_name, name_start, name_length);
-
-		ext_size -= p - attr_start;
-		value_length = line_length - (p - attr_start);
-
-		/* Consume size, name, and `=` */
-		*unconsumed += p - attr_start;
-		tar_flush_unconsumed(a, unconsumed);
-
+		prolog_length = p - attr_start;
+		value_length = line_length - prolog_length;
 		if (value_length == 0) {
 			archive_set_error(&a->archive, EINVAL,
 					  "Malformed pax attributes");
@@ -2003,37 +2160,60 @@ header_pax_extension(struct archive_read *a, struct tar *tar,
 			return (ARCHIVE_WARN);
 		}
 
-		/* pax_attribute will consume value_length - 1 */
-		r = pax_attribute(a, tar, entry, attr_name.s, archive_strlen(&attr_name), value_length - 1, unconsumed);
-		ext_size -= value_length - 1;
-
-		// Release the allocated attr_name (either here or before every return in this function)
-		archive_string_free(&attr_name);
-
+		/* Classify the keyword while it's still in view. */
+		kw = pax_keyword(name_start, name_length);
+		r = pax_attribute_check_length(a, kw, name_start, name_length,
+		    value_length - 1);
 		if (r < ARCHIVE_WARN) {
 			*unconsumed += ext_size + ext_padding;
 			return (r);
 		}
+		if (r != ARCHIVE_OK || kw == PAX_UNKNOWN) {
+			/* Skip the value; just check the trailing `\n`. */
+			if (kw >= PAX_GNU_SPARSE && kw <= PAX_GNU_SPARSE_SIZE)
+				tar->sparse_gnu_attributes_seen = 1;
+			*unconsumed += line_length - 1;
+			tar_flush_unconsumed(a, unconsumed);
+			p = __archive_read_ahead(a, 1, NULL);
+			if (p == NULL) {
+				archive_set_error(&a->archive, EINVAL,
+						  "Truncated tar archive"
+						  " detected while completing pax attribute");
+				return (ARCHIVE_FATAL);
+			}
+			value_end = *p;
+			*unconsumed += 1;
+		} else {
+			/* Parse the value straight out of the
+			 * read-ahead buffer. */
+			p = __archive_read_ahead(a, line_length, NULL);
+			if (p == NULL) {
+				archive_set_error(&a->archive, EINVAL,
+						  "Truncated tar archive"
+						  " detected while reading pax attribute");
+				return (ARCHIVE_FATAL);
+			}
+			value_end = p[line_length - 1];
+			if (value_end == '\n')
+				r = pax_attribute(a, tar, entry, kw,
+				    p + (name_start - attr_start), name_length,
+				    p + prolog_length, value_length - 1);
+			if (r < ARCHIVE_WARN) {
+				*unconsumed += ext_size + ext_padding;
+				return (r);
+			}
+			*unconsumed += line_length;
+		}
 		err = err_combine(err, r);
-
-		/* Consume the `\n` that follows the pax attribute value. */
+		ext_size -= line_length;
 		tar_flush_unconsumed(a, unconsumed);
-		p = __archive_read_ahead(a, 1, &did_read);
-		if (p == NULL) {
-			archive_set_error(&a->archive, EINVAL,
-					  "Truncated tar archive"
-					  " detected while completing pax attribute");
-			return (ARCHIVE_FATAL);
-		}
-		if (p[0] != '\n') {
+
+		if (value_end != '\n') {
 			archive_set_error(&a->archive, EINVAL,
 					  "Malformed pax attributes");
 			*unconsumed += ext_size + ext_padding;
 			return (ARCHIVE_WARN);
 		}
-		ext_size -= 1;
-		*unconsumed += 1;
-		tar_flush_unconsumed(a, unconsumed);
 	}
 	*unconsumed += ext_size + ext_padding;
 
@@ -2179,10 +2359,10 @@ pax_attribute_RHT_security_selinux(struct archive_entry *entry,
 
 static int
 pax_attribute_SCHILY_acl(struct archive_read *a, struct tar *tar,
-	struct archive_entry *entry, size_t value_length, int type)
+	struct archive_entry *entry, const char *p, size_t value_length,
+	int type)
 {
 	int r;
-	const char *p;
 	const char* errstr;
 
 	switch (type) {
@@ -2209,26 +2389,8 @@ pax_attribute_SCHILY_acl(struct archive_read *a, struct tar *tar,
 			return (ARCHIVE_FATAL);
 	}
 
-	if (value_length > acl_limit) {
-		__archive_read_consume(a, value_length);
-		archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
-				  "Unreasonably large ACL: %llu > %llu",
-				  (unsigned long long)value_length,
-				  (unsigned long long)acl_limit);
-		return (ARCHIVE_WARN);
-	}
-
-	p = __archive_read_ahead(a, value_length, NULL);
-	if (p == NULL) {
-		archive_set_error(&a->archive, ARCHIVE_ERRNO_FILE_FORMAT,
-				  "Truncated tar archive "
-				  "detected while reading ACL data");
-		return (ARCHIVE_FATAL);
-	}
-
 	r = archive_acl_from_text_nl(archive_entry_acl(entry), p, value_length,
 	    type, tar->sconv_acl);
-	__archive_read_consume(a, value_length);
 	/* Workaround: Force perm_is_set() to be correct */
 	/* If this bit were stored in the ACL, this wouldn't be needed */
 	archive_entry_set_perm(entry, archive_entry_perm(entry));
@@ -2246,28 +2408,8 @@ pax_attribute_SCHILY_acl(struct archive_read *a, struct tar *tar,
 }
 
 static int
-pax_attribute_read_time(struct archive_read *a, size_t value_length, int64_t *ps, long *pn, int64_t *unconsumed) {
-	struct archive_string as;
-	int r;
-
-	if (value_length > 128) {
-		__archive_read_consume(a, value_length);
-		*ps = 0;
-		*pn = 0;
-		return (ARCHIVE_FATAL);
-	}
-
-	archive_string_init(&as);
-	r = read_bytes_to_string(a, &as, value_length, unconsumed);
-	if (r < ARCHIVE_OK) {
-		archive_string_free(&as);
-		*ps = 0;
-		*pn = 0;
-		return (r);
-	}
-
-	pax_time(as.s, archive_strlen(&as), ps, pn);
-	archive_string_free(&as);
+pax_attribute_read_time(const char *p, size_t value_length, int64_t *ps, long *pn) {
+	pax_time(p, value_length, ps, pn);
 	if (*ps == INT64_MIN) {
 		*ps = 0;
 		*pn = 0;
@@ -2277,33 +2419,295 @@ pax_attribute_read_time(struct archive_read *a, size_t value_length, int64_t *ps
 }
 
 static int
-pax_attribute_read_number(struct archive_read *a, size_t value_length, int64_t *result) {
-	struct archive_string as;
-	int64_t unconsumed = 0;
-	int r;
+pax_attribute_read_number(const char *p, size_t value_length, int64_t *result) {
+	*result = tar_atol10(p, value_length);
+	if (*result < 0 || *result == INT64_MAX) {
+		*result = INT64_MAX;
+		return (ARCHIVE_WARN);
+	}
+	return (ARCHIVE_OK);
+}
 
-	if (value_length > 64) {
-		__archive_read_consume(a, value_length);
-		*result = 0;
+/*
+ * Store a string-valued attribute.  These are the only values that
+ * are copied out of the read-ahead buffer before they go into the
+ * entry, since the character set isn't known until the whole
+ * extension has been read.
+ */
+static int
+pax_attribute_read_string(struct archive_read *a, struct archive_string *as,
+	const char *p, size_t value_length)
+{
+	archive_string_empty(as);
+	if (archive_array_append(as, p, value_length) == NULL) {
+		archive_set_error(&a->archive, ENOMEM, "No memory");
 		return (ARCHIVE_FATAL);
 	}
+	return (ARCHIVE_OK);
+}
 
-	archive_string_init(&as);
-	r = read_bytes_to_string(a, &as, value_length, &unconsumed);
-	tar_flush_unconsumed(a, &unconsumed);
-	if (r < ARCHIVE_OK) {
-		archive_string_free(&as);
-		*result = 0;
-		return (r);
+#define	PAX_KEY_IS(k, s)	(memcmp((k), (s), sizeof(s) - 1) == 0)
+
+static enum pax_keyword
+pax_keyword(const char *key, size_t key_length)
+{
+	/* Open-ended families first. */
+	if (key_length > 13 && PAX_KEY_IS(key, "SCHILY.xattr."))
+		return (PAX_SCHILY_XATTR);
+	if (key_length > 17 && PAX_KEY_IS(key, "LIBARCHIVE.xattr."))
+		return (PAX_LIBARCHIVE_XATTR);
+
+	/* Everything else is an exact match; the length and one or
+	 * two distinguishing bytes select the single candidate. */
+	switch (key_length) {
+	case 3:
+		if (PAX_KEY_IS(key, "gid"))
+			return (PAX_GID);
+		if (PAX_KEY_IS(key, "uid"))
+			return (PAX_UID);
+		break;
+	case 4:
+		if (PAX_KEY_IS(key, "path"))
+			return (PAX_PATH);
+		if (PAX_KEY_IS(key, "size"))
+			return (PAX_SIZE);
+		break;
+	case 5:
+		switch (key[0]) {
+		case 'a':
+			if (PAX_KEY_IS(key, "atime"))
+				return (PAX_ATIME);
+			break;
+		case 'c':
+			if (PAX_KEY_IS(key, "ctime"))
+				return (PAX_CTIME);
+			break;
+		case 'g':
+			if (PAX_KEY_IS(key, "gname"))
+				return (PAX_GNAME);
+			break;
+		case 'm':
+			if (PAX_KEY_IS(key, "mtime"))
+				return (PAX_MTIME);
+			break;
+		case 'u':
+			if (PAX_KEY_IS(key, "uname"))
+				return (PAX_UNAME);
+			break;
+		}
+		break;
+	case 8:
+		if (PAX_KEY_IS(key, "linkpath"))
+			return (PAX_LINKPATH);
+		break;
+	case 10:
+		switch (key[0]) {
+		case 'G':
+			if (PAX_KEY_IS(key, "GNU.sparse"))
+				return (PAX_GNU_SPARSE);
+			break;
+		case 'S':
+			if (PAX_KEY_IS(key, "SCHILY.dev"))
+				return (PAX_SCHILY_DEV);
+			if (PAX_KEY_IS(key, "SCHILY.ino"))
+				return (PAX_SCHILY_INO);
+			break;
+		case 'h':
+			if (PAX_KEY_IS(key, "hdrcharset"))
+				return (PAX_HDRCHARSET);
+			break;
+		}
+		break;
+	case 12:
+		if (PAX_KEY_IS(key, "SCHILY.nlink"))
+			return (PAX_SCHILY_NLINK);
+		break;
+	case 13:
+		if (PAX_KEY_IS(key, "SCHILY.fflags"))
+			return (PAX_SCHILY_FFLAGS);
+		if (PAX_KEY_IS(key, "SUN.holesdata"))
+			return (PAX_SUN_HOLESDATA);
+		break;
+	case 14:
+		if (PAX_KEY_IS(key, "SCHILY.acl.ace"))
+			return (PAX_SCHILY_ACL_ACE);
+		break;
+	case 15:
+		switch (key[12]) {
+		case 'j':
+			if (PAX_KEY_IS(key, "SCHILY.devmajor"))
+				return (PAX_SCHILY_DEVMAJOR);
+			break;
+		case 'n':
+			if (PAX_KEY_IS(key, "SCHILY.devminor"))
+				return (PAX_SCHILY_DEVMINOR);
+			break;
+		case 'i':
+			if (PAX_KEY_IS(key, "SCHILY.realsize"))
+				return (PAX_SCHILY_REALSIZE);
+			break;
+		}
+		break;
+	case 17:
+		if (PAX_KEY_IS(key, "SCHILY.acl.access"))
+			return (PAX_SCHILY_ACL_ACCESS);
+		break;
+	case 18:
+		if (PAX_KEY_IS(key, "SCHILY.acl.default"))
+			return (PAX_SCHILY_ACL_DEFAULT);
+		break;
+	case 20:
+		if (PAX_KEY_IS(key, "RHT.security.selinux"))
+			return (PAX_RHT_SECURITY_SELINUX);
+		break;
+	case 22:
+		if (PAX_KEY_IS(key, "LIBARCHIVE.symlinktype"))
+			return (PAX_LIBARCHIVE_SYMLINKTYPE);
+		break;
+	case 23:
+		if (PAX_KEY_IS(key, "LIBARCHIVE.creationtime"))
+			return (PAX_LIBARCHIVE_CREATIONTIME);
+		break;
 	}
 
-	*result = tar_atol10(as.s, archive_strlen(&as));
-	archive_string_free(&as);
-	if (*result < 0 || *result == INT64_MAX) {
-		*result = INT64_MAX;
+	/* GNU.sparse.* */
+	if (key_length > 11 && PAX_KEY_IS(key, "GNU.sparse.")) {
+		key += 11;
+		switch (key_length - 11) {
+		case 3:
+			if (PAX_KEY_IS(key, "map"))
+				return (PAX_GNU_SPARSE_MAP);
+			break;
+		case 4:
+			if (PAX_KEY_IS(key, "name"))
+				return (PAX_GNU_SPARSE_NAME);
+			if (PAX_KEY_IS(key, "size"))
+				return (PAX_GNU_SPARSE_SIZE);
+			break;
+		case 5:
+			if (PAX_KEY_IS(key, "major"))
+				return (PAX_GNU_SPARSE_MAJOR);
+			if (PAX_KEY_IS(key, "minor"))
+				return (PAX_GNU_SPARSE_MINOR);
+			break;
+		case 6:
+			if (PAX_KEY_IS(key, "offset"))
+				return (PAX_GNU_SPARSE_OFFSET);
+			break;
+		case 8:
+			if (PAX_KEY_IS(key, "numbytes"))
+				return (PAX_GNU_SPARSE_NUMBYTES);
+			if (PAX_KEY_IS(key, "realsize"))
+				return (PAX_GNU_SPARSE_REALSIZE);
+			break;
+		case 9:
+			if (PAX_KEY_IS(key, "numblocks"))
+				return (PAX_GNU_SPARSE_NUMBLOCKS);
+			break;
+		}
+		return (PAX_GNU_SPARSE);
+	}
+	return (PAX_UNKNOWN);
+}
+
+/*
+ * Check a value's length against the limit for its keyword before
+ * it is pulled into the read-ahead buffer.  Returns ARCHIVE_OK if the
+ * value should be parsed, otherwise the status to report after it
+ * has been skipped.
+ */
+static int
+pax_attribute_check_length(struct archive_read *a, enum pax_keyword kw,
+	const char *key, size_t key_length, size_t value_length)
+{
+	size_t limit;
+	int r = ARCHIVE_WARN;
+
+	switch (kw) {
+	case PAX_UNKNOWN:
+	case PAX_GNU_SPARSE:
+	case PAX_GNU_SPARSE_NUMBLOCKS:
+		/* Value is never examined. */
+		return (ARCHIVE_OK);
+	case PAX_ATIME:
+	case PAX_CTIME:
+	case PAX_MTIME:
+	case PAX_LIBARCHIVE_CREATIONTIME:
+		limit = 128;
+		r = ARCHIVE_FATAL;
+		break;
+	case PAX_GID:
+	case PAX_SIZE:
+	case PAX_UID:
+	case PAX_GNU_SPARSE_MAJOR:
+	case PAX_GNU_SPARSE_MINOR:
+	case PAX_GNU_SPARSE_NUMBYTES:
+	case PAX_GNU_SPARSE_OFFSET:
+	case PAX_GNU_SPARSE_REALSIZE:
+	case PAX_GNU_SPARSE_SIZE:
+	case PAX_SCHILY_DEV:
+	case PAX_SCHILY_DEVMAJOR:
+	case PAX_SCHILY_DEVMINOR:
+	case PAX_SCHILY_INO:
+	case PAX_SCHILY_NLINK:
+	case PAX_SCHILY_REALSIZE:
+		limit = 64;
+		r = ARCHIVE_FATAL;
+		break;
+	case PAX_GNAME:
+	case PAX_UNAME:
+		if (value_length <= guname_limit)
+			return (ARCHIVE_OK);
+		return (ARCHIVE_WARN);
+	case PAX_LINKPATH:
+	case PAX_PATH:
+	case PAX_GNU_SPARSE_NAME:
+		if (value_length <= pathname_limit)
+			return (ARCHIVE_OK);
+		return (ARCHIVE_WARN);
+	case PAX_HDRCHARSET:
+		limit = 63;
+		break;
+	case PAX_GNU_SPARSE_MAP:
+		limit = sparse_map_limit;
+		r = ARCHIVE_FAILED;
+		break;
+	case PAX_SUN_HOLESDATA:
+		limit = sparse_map_limit - 1;
+		r = ARCHIVE_FAILED;
+		break;
+	case PAX_LIBARCHIVE_SYMLINKTYPE:
+		limit = 15;
+		break;
+	case PAX_LIBARCHIVE_XATTR:
+		if (value_length <= xattr_limit)
+			return (ARCHIVE_OK);
 		return (ARCHIVE_WARN);
+	case PAX_RHT_SECURITY_SELINUX:
+		limit = xattr_limit;
+		break;
+	case PAX_SCHILY_XATTR:
+		limit = xattr_limit - 1;
+		break;
+	case PAX_SCHILY_ACL_ACCESS:
+	case PAX_SCHILY_ACL_ACE:
+	case PAX_SCHILY_ACL_DEFAULT:
+		limit = acl_limit;
+		break;
+	case PAX_SCHILY_FFLAGS:
+		if (value_length < fflags_limit)
+			return (ARCHIVE_OK);
+		return (ARCHIVE_WARN);
+	default:
+		return (ARCHIVE_OK);
 	}
-	return (ARCHIVE_OK);
+	if (value_length <= limit)
+		return (ARCHIVE_OK);
+	archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
+	    "Unreasonably large pax attribute %.*s: %llu > %llu",
+	    (int)key_length, key, (unsigned long long)value_length,
+	    (unsigned long long)limit);
+	return (r);
 }
 
 /*
@@ -2315,550 +2719,303 @@ pax_attribute_read_number(struct archive_read *a, size_t value_length, int64_t *
  * extensions here.  I'm using "LIBARCHIVE" for extensions unique to
  * this library.
  *
+ * Both key and value point into the read-ahead buffer; the value is
+ * followed by the record's newline.
+ *
  * TODO: Investigate other vendor-specific extensions and see if
  * any of them look useful.
  */
 static int
 pax_attribute(struct archive_read *a, struct tar *tar, struct archive_entry *entry,
-	      const char *key, size_t key_length, size_t value_length, int64_t *unconsumed)
+	      enum pax_keyword kw, const char *key, size_t key_length,
+	      const char *p, size_t value_length)
 {
 	int64_t t;
 	long n;
-	const char *p;
-	ssize_t bytes_read;
 	int err = ARCHIVE_OK;
 
-	switch (key[0]) {
-	case 'G':
-		/* GNU.* extensions */
-		if (key_length > 4 && memcmp(key, "GNU.", 4) == 0) {
-			key += 4;
-			key_length -= 4;
+	switch (kw) {
+	case PAX_UNKNOWN:
+		/* Includes "charset" and "comment", which we don't publish,
+		 * and the reserved "realtime.*" and "security.*". */
+		break;
 
-			/* GNU.sparse marks the existence of GNU sparse information */
-			if (key_length == 6 && memcmp(key, "sparse", 6) == 0) {
-				tar->sparse_gnu_attributes_seen = 1;
+	/* GNU.* extensions */
+	case PAX_GNU_SPARSE:
+		/* GNU.sparse marks the existence of GNU sparse information */
+		tar->sparse_gnu_attributes_seen = 1;
+		break;
+	/* GNU "0.0" sparse pax format. */
+	case PAX_GNU_SPARSE_NUMBLOCKS:
+		tar->sparse_gnu_attributes_seen = 1;
+		tar->sparse_offset = -1;
+		tar->sparse_numbytes = -1;
+		tar->sparse_gnu_major = 0;
+		tar->sparse_gnu_minor = 0;
+		break;
+	case PAX_GNU_SPARSE_OFFSET:
+		tar->sparse_gnu_attributes_seen = 1;
+		if ((err = pax_attribute_read_number(p, value_length, &t)) == ARCHIVE_OK) {
+			tar->sparse_offset = t;
+			if (tar->sparse_numbytes != -1) {
+				if (gnu_add_sparse_entry(a, tar,
+						 tar->sparse_offset, tar->sparse_numbytes)
+				    != ARCHIVE_OK)
+					return (ARCHIVE_FATAL);
+				tar->sparse_offset = -1;
+				tar->sparse_numbytes = -1;
 			}
-
-			/* GNU.sparse.* extensions */
-			else if (key_length > 7 && memcmp(key, "sparse.", 7) == 0) {
-				tar->sparse_gnu_attributes_seen = 1;
-				key += 7;
-				key_length -= 7;
-
-				/* GNU "0.0" sparse pax format. */
-				if (key_length == 9 && memcmp(key, "numblocks", 9) == 0) {
-					/* GNU.sparse.numblocks */
-					tar->sparse_offset = -1;
-					tar->sparse_numbytes = -1;
-					tar->sparse_gnu_major = 0;
-					tar->sparse_gnu_minor = 0;
-				}
-				else if (key_length == 6 && memcmp(key, "offset", 6) == 0) {
-					/* GNU.sparse.offset */
-					if ((err = pax_attribute_read_number(a, value_length, &t)) == ARCHIVE_OK) {
-						tar->sparse_offset = t;
-						if (tar->sparse_numbytes != -1) {
-							if (gnu_add_sparse_entry(a, tar,
-									 tar->sparse_offset, tar->sparse_numbytes)
-							    != ARCHIVE_OK)
-								return (ARCHIVE_FATAL);
-							tar->sparse_offset = -1;
-							tar->sparse_numbytes = -1;
-						}
-					}
-					return (err);
-				}
-				else if (key_length == 8 && memcmp(key, "numbytes", 8) == 0) {
-					/* GNU.sparse.numbytes */
-					if ((err = pax_attribute_read_number(a, value_length, &t)) == ARCHIVE_OK) {
-						tar->sparse_numbytes = t;
-						if (tar->sparse_offset != -1) {
-							if (gnu_add_sparse_entry(a, tar,
-									 tar->sparse_offset, tar->sparse_numbytes)
-							    != ARCHIVE_OK)
-								return (ARCHIVE_FATAL);
-							tar->sparse_offset = -1;
-							tar->sparse_numbytes = -1;
-						}
-					}
-					return (err);
-				}
-				else if (key_length == 4 && memcmp(key, "size", 4) == 0) {
-					/* GNU.sparse.size */
-					/* This is either the size of stored entry OR the size of data on disk,
-					 * depending on which GNU sparse format version is in use.
-					 * Since pax attributes can be in any order, we may not actually
-					 * know at this point how to interpret this. */
-					if ((err = pax_attribute_read_number(a, value_length, &t)) == ARCHIVE_OK) {
-						tar->GNU_sparse_size = t;
-						tar->size_fields |= TAR_SIZE_GNU_SPARSE_SIZE;
-					}
-					return (err);
-				}
-
-				/* GNU "0.1" sparse pax format. */
-				else if (key_length == 3 && memcmp(key, "map", 3) == 0) {
-					/* GNU.sparse.map */
-					tar->sparse_gnu_major = 0;
-					tar->sparse_gnu_minor = 1;
-					if (value_length > sparse_map_limit) {
-						archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
-								  "Unreasonably large sparse map: %llu > %llu",
-								  (unsigned long long)value_length,
-								  (unsigned long long)sparse_map_limit);
-						err = ARCHIVE_FAILED;
-					} else {
-						p = __archive_read_ahead(a, value_length, &bytes_read);
-						if (p == NULL) {
-							archive_set_error(&a->archive, EINVAL,
-									  "Truncated archive"
-									  " detected while reading GNU sparse data");
-							return (ARCHIVE_FATAL);
-						}
-						if (gnu_sparse_01_parse(a, tar, p, value_length) != ARCHIVE_OK) {
-							err = ARCHIVE_WARN;
-						}
-					}
-					__archive_read_consume(a, value_length);
-					return (err);
-				}
-
-				/* GNU "1.0" sparse pax format */
-				else if (key_length == 5 && memcmp(key, "major", 5) == 0) {
-					/* GNU.sparse.major */
-					if ((err = pax_attribute_read_number(a, value_length, &t)) == ARCHIVE_OK
-					    && t >= 0
-					    && t <= 10) {
-						tar->sparse_gnu_major = (int)t;
-					}
-					return (err);
-				}
-				else if (key_length == 5 && memcmp(key, "minor", 5) == 0) {
-					/* GNU.sparse.minor */
-					if ((err = pax_attribute_read_number(a, value_length, &t)) == ARCHIVE_OK
-					    && t >= 0
-					    && t <= 10) {
-						tar->sparse_gnu_minor = (int)t;
-					}
-					return (err);
-				}
-				else if (key_length == 4 && memcmp(key, "name", 4) == 0) {
-					/* GNU.sparse.name */
-					/*
-					 * The real filename; when storing sparse
-					 * files, GNU tar puts a synthesized name into
-					 * the regular 'path' attribute in an attempt
-					 * to limit confusion. ;-)
-					 */
-					if (value_length > pathname_limit) {
-						*unconsumed += value_length;
-						err = ARCHIVE_WARN;
-					} else {
-						err = read_bytes_to_string(a, &(tar->entry_pathname_override),
-									   value_length, unconsumed);
-					}
-					return (err);
-				}
-				else if (key_length == 8 && memcmp(key, "realsize", 8) == 0) {
-					/* GNU.sparse.realsize = size of file on disk */
-					if ((err = pax_attribute_read_number(a, value_length, &t)) == ARCHIVE_OK) {
-						tar->GNU_sparse_realsize = t;
-						tar->size_fields |= TAR_SIZE_GNU_SPARSE_REALSIZE;
-					}
-					return (err);
-				}
+		}
+		break;
+	case PAX_GNU_SPARSE_NUMBYTES:
+		tar->sparse_gnu_attributes_seen = 1;
+		if ((err = pax_attribute_read_number(p, value_length, &t)) == ARCHIVE_OK) {
+			tar->sparse_numbytes = t;
+			if (tar->sparse_offset != -1) {
+				if (gnu_add_sparse_entry(a, tar,
+						 tar->sparse_offset, tar->sparse_numbytes)
+				    != ARCHIVE_OK)
+					return (ARCHIVE_FATAL);
+				tar->sparse_offset = -1;
+				tar->sparse_numbytes = -1;
 			}
 		}
 		break;
-	case 'L':
-		/* LIBARCHIVE extensions */
-		if (key_length > 11 && memcmp(key, "LIBARCHIVE.", 11) == 0) {
-			key_length -= 11;
-			key += 11;
+	case PAX_GNU_SPARSE_SIZE:
+		/* This is either the size of stored entry OR the size of data on disk,
+		 * depending on which GNU sparse format version is in use.
+		 * Since pax attributes can be in any order, we may not actually
+		 * know at this point how to interpret this. */
+		tar->sparse_gnu_attributes_seen = 1;
+		if ((err = pax_attribute_read_number(p, value_length, &t)) == ARCHIVE_OK) {
+			tar->GNU_sparse_size = t;
+			tar->size_fields |= TAR_SIZE_GNU_SPARSE_SIZE;
+		}
+		break;
+	/* GNU "0.1" sparse pax format. */
+	case PAX_GNU_SPARSE_MAP:
+		tar->sparse_gnu_attributes_seen = 1;
+		tar->sparse_gnu_major = 0;
+		tar->sparse_gnu_minor = 1;
+		if (gnu_sparse_01_parse(a, tar, p, value_length) != ARCHIVE_OK)
+			err = ARCHIVE_WARN;
+		break;
+	/* GNU "1.0" sparse pax format */
+	case PAX_GNU_SPARSE_MAJOR:
+		tar->sparse_gnu_attributes_seen = 1;
+		if ((err = pax_attribute_read_number(p, value_length, &t)) == ARCHIVE_OK
+		    && t >= 0
+		    && t <= 10) {
+			tar->sparse_gnu_major = (int)t;
+		}
+		break;
+	case PAX_GNU_SPARSE_MINOR:
+		tar->sparse_gnu_attributes_seen = 1;
+		if ((err = pax_attribute_read_number(p, value_length, &t)) == ARCHIVE_OK
+		    && t >= 0
+		    && t <= 10) {
+			tar->sparse_gnu_minor = (int)t;
+		}
+		break;
+	case PAX_GNU_SPARSE_NAME:
+		/*
+		 * The real filename; when storing sparse
+		 * files, GNU tar puts a synthesized name into
+		 * the regular 'path' attribute in an attempt
+		 * to limit confusion. ;-)
+		 */
+		tar->sparse_gnu_attributes_seen = 1;
+		err = pax_attribute_read_string(a,
+		    &(tar->entry_pathname_override), p, value_length);
+		break;
+	case PAX_GNU_SPARSE_REALSIZE:
+		/* GNU.sparse.realsize = size of file on disk */
+		tar->sparse_gnu_attributes_seen = 1;
+		if ((err = pax_attribute_read_number(p, value_length, &t)) == ARCHIVE_OK) {
+			tar->GNU_sparse_realsize = t;
+			tar->size_fields |= TAR_SIZE_GNU_SPARSE_REALSIZE;
+		}
+		break;
 
-			/* TODO: Handle arbitrary extended attributes... */
-			/*
-			  if (strcmp(key, "LIBARCHIVE.xxxxxxx") == 0)
-				  archive_entry_set_xxxxxx(entry, value);
-			*/
-			if (key_length == 12 && memcmp(key, "creationtime", 12) == 0) {
-				/* LIBARCHIVE.creationtime */
-				if ((err = pax_attribute_read_time(a, value_length, &t, &n, unconsumed)) == ARCHIVE_OK) {
-					archive_entry_set_birthtime(entry, t, n);
-				}
-				return (err);
-			}
-			else if (key_length == 11 && memcmp(key, "symlinktype", 11) == 0) {
-				/* LIBARCHIVE.symlinktype */
-				if (value_length < 16) {
-					p = __archive_read_ahead(a, value_length, &bytes_read);
-					if (p == NULL) {
-						archive_set_error(&a->archive, ARCHIVE_ERRNO_FILE_FORMAT,
-								  "Truncated tar archive "
-								  "detected while reading `symlinktype` attribute");
-						return (ARCHIVE_FATAL);
-					}
-					if (value_length == 4 && memcmp(p, "file", 4) == 0) {
-						archive_entry_set_symlink_type(entry,
-									       AE_SYMLINK_TYPE_FILE);
-					} else if (value_length == 3 && memcmp(p, "dir", 3) == 0) {
-							archive_entry_set_symlink_type(entry,
-										       AE_SYMLINK_TYPE_DIRECTORY);
-					} else {
-						archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
-								  "Unrecognized symlink type");
-						err = ARCHIVE_WARN;
-					}
-				} else {
-					archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
-							  "symlink type is very long"
-							  "(longest recognized value is 4 bytes, this is %llu)",
-							  (unsigned long long)value_length);
-					err = ARCHIVE_WARN;
-				}
-				__archive_read_consume(a, value_length);
-				return (err);
-			}
-			else if (key_length > 6 && memcmp(key, "xattr.", 6) == 0) {
-				key_length -= 6;
-				key += 6;
-				if (value_length > xattr_limit) {
-					err = ARCHIVE_WARN;
-				} else {
-					p = __archive_read_ahead(a, value_length, &bytes_read);
-					if (p == NULL) {
-						archive_set_error(&a->archive, EINVAL,
-								  "Truncated archive"
-								  " detected while reading xattr information");
-						return (ARCHIVE_FATAL);
-					}
-					if (pax_attribute_LIBARCHIVE_xattr(entry, key, key_length, p, value_length)) {
-						/* TODO: Unable to parse xattr */
-						err = ARCHIVE_WARN;
-					}
-				}
-				__archive_read_consume(a, value_length);
-				return (err);
-			}
+	/* LIBARCHIVE extensions */
+	case PAX_LIBARCHIVE_CREATIONTIME:
+		if ((err = pax_attribute_read_time(p, value_length, &t, &n)) == ARCHIVE_OK) {
+			archive_entry_set_birthtime(entry, t, n);
 		}
 		break;
-	case 'R':
-		/* GNU tar uses RHT.security header to store SELinux xattrs
-		 * SCHILY.xattr.security.selinux == RHT.security.selinux */
-		if (key_length == 20 && memcmp(key, "RHT.security.selinux", 20) == 0) {
-			if (value_length > xattr_limit) {
-				archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
-						  "Ignoring unreasonably large security.selinux attribute:"
-						  " %llu > %llu",
-						  (unsigned long long)value_length,
-						  (unsigned long long)xattr_limit);
-				/* TODO: Should this be FAILED instead? */
-				err = ARCHIVE_WARN;
-			} else {
-				p = __archive_read_ahead(a, value_length, &bytes_read);
-				if (p == NULL) {
-					archive_set_error(&a->archive, EINVAL,
-							  "Truncated archive"
-							  " detected while reading selinux data");
-					return (ARCHIVE_FATAL);
-				}
-				if (pax_attribute_RHT_security_selinux(entry, p, value_length)) {
-					/* TODO: Unable to parse xattr */
-					err = ARCHIVE_WARN;
-				}
-			}
-			__archive_read_consume(a, value_length);
-			return (err);
+	case PAX_LIBARCHIVE_SYMLINKTYPE:
+		if (value_length == 4 && memcmp(p, "file", 4) == 0) {
+			archive_entry_set_symlink_type(entry,
+						       AE_SYMLINK_TYPE_FILE);
+		} else if (value_length == 3 && memcmp(p, "dir", 3) == 0) {
+			archive_entry_set_symlink_type(entry,
+						       AE_SYMLINK_TYPE_DIRECTORY);
+		} else {
+			archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
+					  "Unrecognized symlink type");
+			err = ARCHIVE_WARN;
+		}
+		break;
+	case PAX_LIBARCHIVE_XATTR:
+		if (pax_attribute_LIBARCHIVE_xattr(entry, key + 17,
+		    key_length - 17, p, value_length)) {
+			/* TODO: Unable to parse xattr */
+			err = ARCHIVE_WARN;
 		}
 		break;
-	case 'S':
-		/* SCHILY.* extensions used by "star" archiver */
-		if (key_length > 7 && memcmp(key, "SCHILY.", 7) == 0) {
-			key_length -= 7;
-			key += 7;
 
-			if (key_length == 10 && memcmp(key, "acl.access", 10) == 0) {
-				err = pax_attribute_SCHILY_acl(a, tar, entry, value_length,
-						      ARCHIVE_ENTRY_ACL_TYPE_ACCESS);
-				// TODO: Mark mode as set
-				return (err);
-			}
-			else if (key_length == 11 && memcmp(key, "acl.default", 11) == 0) {
-				err = pax_attribute_SCHILY_acl(a, tar, entry, value_length,
-						      ARCHIVE_ENTRY_ACL_TYPE_DEFAULT);
-				return (err);
-			}
-			else if (key_length == 7 && memcmp(key, "acl.ace", 7) == 0) {
-				err = pax_attribute_SCHILY_acl(a, tar, entry, value_length,
-						      ARCHIVE_ENTRY_ACL_TYPE_NFS4);
-				// TODO: Mark mode as set
-				return (err);
-			}
-			else if (key_length == 8 && memcmp(key, "devmajor", 8) == 0) {
-				if ((err = pax_attribute_read_number(a, value_length, &t)) == ARCHIVE_OK) {
-					archive_entry_set_rdevmajor(entry, (dev_t)t);
-				}
-				return (err);
-			}
-			else if (key_length == 8 && memcmp(key, "devminor", 8) == 0) {
-				if ((err = pax_attribute_read_number(a, value_length, &t)) == ARCHIVE_OK) {
-					archive_entry_set_rdevminor(entry, (dev_t)t);
-				}
-				return (err);
-			}
-			else if (key_length == 6 && memcmp(key, "fflags", 6) == 0) {
-				if (value_length < fflags_limit) {
-					p = __archive_read_ahead(a, value_length, &bytes_read);
-					if (p == NULL) {
-						/* Truncated archive */
-						archive_set_error(&a->archive, EINVAL,
-								  "Truncated archive"
-								  " detected while reading SCHILY.fflags");
-						return (ARCHIVE_FATAL);
-					}
-					archive_entry_copy_fflags_text_len(entry, p, value_length);
-					err = ARCHIVE_OK;
-				} else {
-					/* Overlong fflags field */
-					err = ARCHIVE_WARN;
-				}
-				__archive_read_consume(a, value_length);
-				return (err);
-			}
-			else if (key_length == 3 && memcmp(key, "dev", 3) == 0) {
-				if ((err = pax_attribute_read_number(a, value_length, &t)) == ARCHIVE_OK) {
-					archive_entry_set_dev(entry, (dev_t)t);
-				}
-				return (err);
-			}
-			else if (key_length == 3 && memcmp(key, "ino", 3) == 0) {
-				if ((err = pax_attribute_read_number(a, value_length, &t)) == ARCHIVE_OK) {
-					archive_entry_set_ino(entry, t);
-				}
-				return (err);
-			}
-			else if (key_length == 5 && memcmp(key, "nlink", 5) == 0) {
-				if ((err = pax_attribute_read_number(a, value_length, &t)) == ARCHIVE_OK) {
-					archive_entry_set_nlink(entry, (unsigned int)t);
-				}
-				return (err);
-			}
-			else if (key_length == 8 && memcmp(key, "realsize", 8) == 0) {
-				if ((err = pax_attribute_read_number(a, value_length, &t)) == ARCHIVE_OK) {
-					tar->SCHILY_sparse_realsize = t;
-					tar->size_fields |= TAR_SIZE_SCHILY_SPARSE_REALSIZE;
-				}
-				return (err);
-			}
-			/* TODO: Is there a SCHILY.sparse.size similar to GNU.sparse.size ? */
-			else if (key_length > 6 && memcmp(key, "xattr.", 6) == 0) {
-				key_length -= 6;
-				key += 6;
-				if (value_length < xattr_limit) {
-					p = __archive_read_ahead(a, value_length, &bytes_read);
-					if (p == NULL) {
-						archive_set_error(&a->archive, EINVAL,
-								  "Truncated archive"
-								  " detected while reading SCHILY.xattr");
-						return (ARCHIVE_FATAL);
-					}
-					if (pax_attribute_SCHILY_xattr(entry, key, key_length, p, value_length)) {
-						/* TODO: Unable to parse xattr */
-						err = ARCHIVE_WARN;
-					}
-				} else {
-					archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
-							  "Unreasonably large xattr: %llu > %llu",
-							  (unsigned long long)value_length,
-							  (unsigned long long)xattr_limit);
-					err = ARCHIVE_WARN;
-				}
-				__archive_read_consume(a, value_length);
-				return (err);
-			}
+	/* GNU tar uses RHT.security header to store SELinux xattrs
+	 * SCHILY.xattr.security.selinux == RHT.security.selinux */
+	case PAX_RHT_SECURITY_SELINUX:
+		if (pax_attribute_RHT_security_selinux(entry, p, value_length)) {
+			/* TODO: Unable to parse xattr */
+			err = ARCHIVE_WARN;
 		}
-		/* SUN.* extensions from Solaris tar */
-		if (key_length > 4 && memcmp(key, "SUN.", 4) == 0) {
-			key_length -= 4;
-			key += 4;
-
-			if (key_length == 9 && memcmp(key, "holesdata", 9) == 0) {
-				/* SUN.holesdata */
-				if (value_length < sparse_map_limit) {
-					p = __archive_read_ahead(a, value_length, &bytes_read);
-					if (p == NULL) {
-						archive_set_error(&a->archive, EINVAL,
-								  "Truncated archive"
-								  " detected while reading SUN.holesdata");
-						return (ARCHIVE_FATAL);
-					}
-					err = pax_attribute_SUN_holesdata(a, tar, entry, p, value_length);
-					if (err < ARCHIVE_OK) {
-						archive_set_error(&a->archive,
-								  ARCHIVE_ERRNO_MISC,
-								  "Parse error: SUN.holesdata");
-					}
-				} else {
-					archive_set_error(&a->archive, ARCHIVE_ERRNO_MISC,
-							  "Unreasonably large sparse map: %llu > %llu",
-							  (unsigned long long)value_length,
-							  (unsigned long long)sparse_map_limit);
-					err = ARCHIVE_FAILED;
-				}
-				__archive_read_consume(a, value_length);
-				return (err);
-			}
+		break;
+
+	/* SCHILY.* extensions used by "star" archiver */
+	case PAX_SCHILY_ACL_ACCESS:
+		err = pax_attribute_SCHILY_acl(a, tar, entry, p, value_length,
+		    ARCHIVE_ENTRY_ACL_TYPE_ACCESS);
+		// TODO: Mark mode as set
+		break;
+	case PAX_SCHILY_ACL_DEFAULT:
+		err = pax_attribute_SCHILY_acl(a, tar, entry, p, value_length,
+		    ARCHIVE_ENTRY_ACL_TYPE_DEFAULT);
+		break;
+	case PAX_SCHILY_ACL_ACE:
+		err = pax_attribute_SCHILY_acl(a, tar, entry, p, value_length,
+		    ARCHIVE_ENTRY_ACL_TYPE_NFS4);
+		// TODO: Mark mode as set
+		break;
+	case PAX_SCHILY_DEVMAJOR:
+		if ((err = pax_attribute_read_number(p, value_length, &t)) == ARCHIVE_OK) {
+			archive_entry_set_rdevmajor(entry, (dev_t)t);
 		}
 		break;
-	case 'a':
-		if (key_length == 5 && memcmp(key, "atime", 5) == 0) {
-			if ((err = pax_attribute_read_time(a, value_length, &t, &n, unconsumed)) == ARCHIVE_OK) {
-				archive_entry_set_atime(entry, t, n);
-			}
-			return (err);
+	case PAX_SCHILY_DEVMINOR:
+		if ((err = pax_attribute_read_number(p, value_length, &t)) == ARCHIVE_OK) {
+			archive_entry_set_rdevminor(entry, (dev_t)t);
 		}
 		break;
-	case 'c':
-		if (key_length == 5 && memcmp(key, "ctime", 5) == 0) {
-			if ((err = pax_attribute_read_time(a, value_length, &t, &n, unconsumed)) == ARCHIVE_OK) {
-				archive_entry_set_ctime(entry, t, n);
-			}
-			return (err);
-		} else if (key_length == 7 && memcmp(key, "charset", 7) == 0) {
-			/* TODO: Publish charset information in entry. */
-		} else if (key_length == 7 && memcmp(key, "comment", 7) == 0) {
-			/* TODO: Publish comment in entry. */
+	case PAX_SCHILY_FFLAGS:
+		archive_entry_copy_fflags_text_len(entry, p, value_length);
+		break;
+	case PAX_SCHILY_DEV:
+		if ((err = pax_attribute_read_number(p, value_length, &t)) == ARCHIVE_OK) {
+			archive_entry_set_dev(entry, (dev_t)t);
 		}
 		break;
-	case 'g':
-		if (key_length == 3 && memcmp(key, "gid", 3) == 0) {
-			if ((err = pax_attribute_read_number(a, value_length, &t)) == ARCHIVE_OK) {
-				archive_entry_set_gid(entry, t);
-			}
-			return (err);
-		} else if (key_length == 5 && memcmp(key, "gname", 5) == 0) {
-			if (value_length > guname_limit) {
-				*unconsumed += value_length;
-				err = ARCHIVE_WARN;
-			} else {
-				err = read_bytes_to_string(a, &(tar->entry_gname), value_length, unconsumed);
-			}
-			return (err);
+	case PAX_SCHILY_INO:
+		if ((err = pax_attribute_read_number(p, value_length, &t)) == ARCHIVE_OK) {
+			archive_entry_set_ino(entry, t);
 		}
 		break;
-	case 'h':
-		if (key_length == 10 && memcmp(key, "hdrcharset", 10) == 0) {
-			if (value_length < 64) {
-				p = __archive_read_ahead(a, value_length, &bytes_read);
-				if (p == NULL) {
-					archive_set_error(&a->archive, ARCHIVE_ERRNO_FILE_FORMAT,
-							  "Truncated tar archive "
-							  "detected while reading hdrcharset attribute");
-					return (ARCHIVE_FATAL);
-				}
-				if (value_length == 6
-				    && memcmp(p, "BINARY", 6) == 0) {
-					/* Binary  mode. */
-					tar->pax_hdrcharset_utf8 = 0;
-					err = ARCHIVE_OK;
-				} else if (value_length == 23
-					   && memcmp(p, "ISO-IR 10646 2000 UTF-8", 23) == 0) {
-					tar->pax_hdrcharset_utf8 = 1;
-					err = ARCHIVE_OK;
-				} else {
-					/* TODO: Unrecognized character set */
-					err  = ARCHIVE_WARN;
-				}
-			} else {
-				archive_set_error(&a->archive, ARCHIVE_ERRNO_FILE_FORMAT,
-						  "hdrcharset attribute is unreasonably large (%llu bytes)",
-						  (unsigned long long)value_length);
-				err = ARCHIVE_WARN;
-			}
-			__archive_read_consume(a, value_length);
-			return (err);
+	case PAX_SCHILY_NLINK:
+		if ((err = pax_attribute_read_number(p, value_length, &t)) == ARCHIVE_OK) {
+			archive_entry_set_nlink(entry, (unsigned int)t);
 		}
 		break;
-	case 'l':
-		/* pax interchange doesn't distinguish hardlink vs. symlink. */
-		if (key_length == 8 && memcmp(key, "linkpath", 8) == 0) {
-			if (value_length > pathname_limit) {
-				*unconsumed += value_length;
-				err = ARCHIVE_WARN;
-			} else {
-				err = read_bytes_to_string(a, &tar->entry_linkpath, value_length, unconsumed);
-			}
-			return (err);
+	case PAX_SCHILY_REALSIZE:
+		if ((err = pax_attribute_read_number(p, value_length, &t)) == ARCHIVE_OK) {
+			tar->SCHILY_sparse_realsize = t;
+			tar->size_fields |= TAR_SIZE_SCHILY_SPARSE_REALSIZE;
 		}
 		break;
-	case 'm':
-		if (key_length == 5 && memcmp(key, "mtime", 5) == 0) {
-			if ((err = pax_attribute_read_time(a, value_length, &t, &n, unconsumed)) == ARCHIVE_OK) {
-				archive_entry_set_mtime(entry, t, n);
-			}
-			return (err);
+	/* TODO: Is there a SCHILY.sparse.size similar to GNU.sparse.size ? */
+	case PAX_SCHILY_XATTR:
+		if (pax_attribute_SCHILY_xattr(entry, key + 13,
+		    key_length - 13, p, value_length)) {
+			/* TODO: Unable to parse xattr */
+			err = ARCHIVE_WARN;
 		}
 		break;
-	case 'p':
-		if (key_length == 4 && memcmp(key, "path", 4) == 0) {
-			if (value_length > pathname_limit) {
-				*unconsumed += value_length;
-				err = ARCHIVE_WARN;
-			} else {
-				err = read_bytes_to_string(a, &(tar->entry_pathname), value_length, unconsumed);
-			}
-			return (err);
+
+	/* SUN.* extensions from Solaris tar */
+	case PAX_SUN_HOLESDATA:
+		err = pax_attribute_SUN_holesdata(a, tar, entry, p, value_length);
+		if (err < ARCHIVE_OK) {
+			archive_set_error(&a->archive,
+					  ARCHIVE_ERRNO_MISC,
+					  "Parse error: SUN.holesdata");
 		}
 		break;
-	case 'r':
-		/* POSIX has reserved 'realtime.*' */
+
+	case PAX_ATIME:
+		if ((err = pax_attribute_read_time(p, value_length, &t, &n)) == ARCHIVE_OK) {
+			archive_entry_set_atime(entry, t, n);
+		}
 		break;
-	case 's':
-		/* POSIX has reserved 'security.*' */
-		/* Someday: if (strcmp(key, "security.acl") == 0) { ... } */
-		if (key_length == 4 && memcmp(key, "size", 4) == 0) {
-			/* "size" is the size of the data in the entry. */
-			if ((err = pax_attribute_read_number(a, value_length, &t)) == ARCHIVE_OK) {
-				tar->pax_size = t;
-				tar->size_fields |= TAR_SIZE_PAX_SIZE;
-			}
-			else if (t == INT64_MAX) {
-				/* Note: pax_attr_read_number returns INT64_MAX on overflow or < 0 */
-				tar->entry_bytes_remaining = 0;
-				archive_set_error(&a->archive,
-				    ARCHIVE_ERRNO_MISC,
-				    "Tar size attribute overflow");
-				return (ARCHIVE_FATAL);
-			}
-			return (err);
+	case PAX_CTIME:
+		if ((err = pax_attribute_read_time(p, value_length, &t, &n)) == ARCHIVE_OK) {
+			archive_entry_set_ctime(entry, t, n);
 		}
 		break;
-	case 'u':
-		if (key_length == 3 && memcmp(key, "uid", 3) == 0) {
-			if ((err = pax_attribute_read_number(a, value_length, &t)) == ARCHIVE_OK) {
-				archive_entry_set_uid(entry, t);
-			}
-			return (err);
-		} else if (key_length == 5 && memcmp(key, "uname", 5) == 0) {
-			if (value_length > guname_limit) {
-				*unconsumed += value_length;
-				err = ARCHIVE_WARN;
-			} else {
-				err = read_bytes_to_string(a, &(tar->entry_uname), value_length, unconsumed);
-			}
-			return (err);
+	case PAX_GID:
+		if ((err = pax_attribute_read_number(p, value_length, &t)) == ARCHIVE_OK) {
+			archive_entry_set_gid(entry, t);
+		}
+		break;
+	case PAX_GNAME:
+		err = pax_attribute_read_string(a, &(tar->entry_gname),
+		    p, value_length);
+		break;
+	case PAX_HDRCHARSET:
+		if (value_length == 6
+		    && memcmp(p, "BINARY", 6) == 0) {
+			/* Binary  mode. */
+			tar->pax_hdrcharset_utf8 = 0;
+		} else if (value_length == 23
+			   && memcmp(p, "ISO-IR 10646 2000 UTF-8", 23) == 0) {
+			tar->pax_hdrcharset_utf8 = 1;
+		} else {
+			/* TODO: Unrecognized character set */
+			err  = ARCHIVE_WARN;
+		}
+		break;
+	case PAX_LINKPATH:
+		/* pax interchange doesn't distinguish hardlink vs. symlink. */
+		err = pax_attribute_read_string(a, &(tar->entry_linkpath),
+		    p, value_length);
+		break;
+	case PAX_MTIME:
+		if ((err = pax_attribute_read_time(p, value_length, &t, &n)) == ARCHIVE_OK) {
+			archive_entry_set_mtime(entry, t, n);
+		}
+		break;
+	case PAX_PATH:
+		err = pax_attribute_read_string(a, &(tar->entry_pathname),
+		    p, value_length);
+		break;
+	case PAX_SIZE:
+		/* "size" is the size of the data in the entry. */
+		if ((err = pax_attribute_read_number(p, value_length, &t)) == ARCHIVE_OK) {
+			tar->pax_size = t;
+			tar->size_fields |= TAR_SIZE_PAX_SIZE;
+		}
+		else if (t == INT64_MAX) {
+			/* Note: pax_attr_read_number returns INT64_MAX on overflow or < 0 */
+			tar->entry_bytes_remaining = 0;
+			archive_set_error(&a->archive,
+			    ARCHIVE_ERRNO_MISC,
+			    "Tar size attribute overflow");
+			return (ARCHIVE_FATAL);
+		}
+		break;
+	case PAX_UID:
+		if ((err = pax_attribute_read_number(p, value_length, &t)) == ARCHIVE_OK) {
+			archive_entry_set_uid(entry, t);
 		}
 		break;
+	case PAX_UNAME:
+		err = pax_attribute_read_string(a, &(tar->entry_uname),
+		    p, value_length);
+		break;
 	}
-
-	/* Unrecognized key, just skip the entire value. */
-	__archive_read_consume(a, value_length);
 	return (err);
 }
 
 
-
 /*
  * Parse a decimal time value, which may include a fractional portion
  *
@@ -3376,6 +3533,19 @@ tar_atol(const char *p, size_t char_cnt)
 	 */
 	if (*p & 0x80)
 		return (tar_atol256(p, char_cnt));
+	/*
+	 * Fast path for the form nearly every writer uses: zero-padded
+	 * octal with no leading blanks or sign.  Twelve octal digits is
+	 * only 36 bits, so no overflow checks are needed.
+	 */
+	if (*p >= '0' && *p <= '7' && char_cnt <= 12) {
+		int64_t l = 0;
+		while (char_cnt != 0 && *p >= '0' && *p <= '7') {
+			l = (l << 3) | (*p++ - '0');
+			char_cnt--;
+		}
+		return (l);
+	}
 	return (tar_atol8(p, char_cnt));
 }
 
@@ -3605,9 +3775,20 @@ base64_decode(const char *s, size_t len, size_t *out_len)
 	d = out;
 
 	while (len > 0) {
-		/* Collect the next group of (up to) four characters. */
 		int v = 0;
 		int group_size = 0;
+		size_t n;
+
+		/* Decode complete groups in bulk as long as there are any. */
+		n = __archive_base64_decode((unsigned char *)d, src,
+		    len & ~(size_t)3, ARCHIVE_BASE64_STD);
+		src += n;
+		len -= n;
+		d += n / 4 * 3;
+		if (len == 0)
+			break;
+
+		/* Collect the next group of (up to) four characters. */
 		while (group_size < 4 && len > 0) {
 			/* '=' or '_' padding indicates final group. */
 			if (*src == '=' || *src == '_') {
@@ -3689,3 +3870,341 @@ tohex(int c)
 	else
 		return (-1);
 }
+
+/*
+ * Sidecar index support.
+ *
+ * The index file is a small little-endian binary file:
+ *
+ *   8 bytes   magic "TARINDEX"
+ *   4 bytes   version (1)
+ *   4 bytes   reserved (0)
+ *   8 bytes   number of entries
+ *
+ * followed by one record per entry, in archive order:
+ *
+ *   8 bytes   offset of the entry's first header (including any
+ *             pax or GNU long name headers)
+ *   8 bytes   offset of the entry's body
+ *   8 bytes   size of the body stored in the archive
+ *   4 bytes   mode
+ *   4 bytes   pathname length
+ *   4 bytes   linkname length (0 if none)
+ *   pathname and linkname, UTF-8, not NUL-terminated
+ *
+ * All offsets are in the uncompressed tar stream.
+ */
+#define TAR_INDEX_MAGIC		"TARINDEX"
+#define TAR_INDEX_VERSION	1
+#define TAR_INDEX_HEADER_SIZE	24
+#define TAR_INDEX_RECORD_SIZE	36
+
+static size_t
+tar_index_hash(const char *p)
+{
+	/* FNV-1a */
+	uint32_t h = 2166136261U;
+
+	while (*p != '\0') {
+		h ^= (unsigned char)*p++;
+		h *= 16777619U;
+	}
+	return (h);
+}
+
+static void
+tar_index_free(struct tar_index *index)
+{
+	size_t i;
+
+	for (i = 0; i < index->count; i++) {
+		free(index->entries[i].pathname);
+		free(index->entries[i].linkname);
+	}
+	free(index->entries);
+	free(index->buckets);
+	memset(index, 0, sizeof(*index));
+}
+
+static struct tar_index_entry *
+tar_index_new_entry(struct tar_index *index)
+{
+	struct tar_index_entry *e;
+
+	if (index->count >= index->allocated) {
+		size_t n = index->allocated < 64 ? 64 : index->allocated * 2;
+		e = realloc(index->entries, n * sizeof(*e));
+		if (e == NULL)
+			return (NULL);
+		index->entries = e;
+		index->allocated = n;
+	}
+	e = &index->entries[index->count++];
+	memset(e, 0, sizeof(*e));
+	e->hash_next = TAR_INDEX_NONE;
+	return (e);
+}
+
+/*
+ * Hash all pathnames.  Entries are chained newest-first, so a lookup
+ * finds the last archive member with a given name, which is the one
+ * that wins on extraction.
+ */
+static int
+tar_index_build_hash(struct tar_index *index)
+{
+	size_t i, n, slot;
+
+	free(index->buckets);
+	for (n = 64; n < index->count; n *= 2)
+		;
+	index->buckets = malloc(n * sizeof(*index->buckets));
+	if (index->buckets == NULL)
+		return (ARCHIVE_FATAL);
+	index->nbuckets = n;
+	for (i = 0; i < n; i++)
+		index->buckets[i] = TAR_INDEX_NONE;
+	for (i = 0; i < index->count; i++) {
+		slot = tar_index_hash(index->entries[i].pathname) & (n - 1);
+		index->entries[i].hash_next = index->buckets[slot];
+		index->buckets[slot] = i;
+	}
+	return (ARCHIVE_OK);
+}
+
+static const struct tar_index_entry *
+tar_index_lookup(const struct tar_index *index, const char *pathname)
+{
+	size_t i;
+
+	if (index->nbuckets == 0)
+		return (NULL);
+	i = index->buckets[tar_index_hash(pathname) & (index->nbuckets - 1)];
+	for (; i != TAR_INDEX_NONE; i = index->entries[i].hash_next) {
+		if (strcmp(index->entries[i].pathname, pathname) == 0)
+			return (&index->entries[i]);
+	}
+	return (NULL);
+}
+
+static int
+tar_index_add(struct archive_read *a, struct tar *tar,
+    struct archive_entry *entry, int64_t header_offset, int64_t data_offset)
+{
+	struct tar_index_entry *e;
+	const char *name, *link;
+
+	/*
+	 * Entries are recorded in archive order.  One at or before the
+	 * last recorded header is already in an index loaded with
+	 * "read-index", so don't record it twice.
+	 */
+	if (tar->index.count > 0 && header_offset <=
+	    tar->index.entries[tar->index.count - 1].header_offset)
+		return (ARCHIVE_OK);
+
+	name = archive_entry_pathname_utf8(entry);
+	link = archive_entry_hardlink_utf8(entry);
+	if (link == NULL)
+		link = archive_entry_symlink_utf8(entry);
+	e = tar_index_new_entry(&tar->index);
+	if (e == NULL)
+		goto nomem;
+	e->header_offset = header_offset;
+	e->data_offset = data_offset;
+	e->data_size = tar->entry_bytes_remaining;
+	e->mode = (uint32_t)archive_entry_mode(entry);
+	e->pathname = strdup(name != NULL ? name : "");
+	if (e->pathname == NULL)
+		goto nomem;
+	if (link != NULL && (e->linkname = strdup(link)) == NULL)
+		goto nomem;
+	return (ARCHIVE_OK);
+nomem:
+	archive_set_error(&a->archive, ENOMEM, "Can't allocate tar index");
+	return (ARCHIVE_FATAL);
+}
+
+static int
+tar_index_save(struct archive_read *a, struct tar *tar)
+{
+	const struct tar_index_entry *e;
+	unsigned char buff[TAR_INDEX_RECORD_SIZE];
+	size_t i, nlen, llen;
+	FILE *f;
+	int r = ARCHIVE_OK;
+
+	f = fopen(tar->index_write_path, "wb");
+	if (f == NULL) {
+		archive_set_error(&a->archive, errno,
+		    "Can't create tar index `%s'", tar->index_write_path);
+		return (ARCHIVE_FATAL);
+	}
+	memcpy(buff, TAR_INDEX_MAGIC, 8);
+	archive_le32enc(buff + 8, TAR_INDEX_VERSION);
+	archive_le32enc(buff + 12, 0);
+	archive_le64enc(buff + 16, tar->index.count);
+	if (fwrite(buff, TAR_INDEX_HEADER_SIZE, 1, f) != 1)
+		r = ARCHIVE_FATAL;
+	for (i = 0; r == ARCHIVE_OK && i < tar->index.count; i++) {
+		e = &tar->index.entries[i];
+		nlen = strlen(e->pathname);
+		llen = e->linkname != NULL ? strlen(e->linkname) : 0;
+		archive_le64enc(buff, (uint64_t)e->header_offset);
+		archive_le64enc(buff + 8, (uint64_t)e->data_offset);
+		archive_le64enc(buff + 16, (uint64_t)e->data_size);
+		archive_le32enc(buff + 24, e->mode);
+		archive_le32enc(buff + 28, (uint32_t)nlen);
+		archive_le32enc(buff + 32, (uint32_t)llen);
+		if (fwrite(buff, TAR_INDEX_RECORD_SIZE, 1, f) != 1
+		    || fwrite(e->pathname, 1, nlen, f) != nlen
+		    || (llen > 0 && fwrite(e->linkname, 1, llen, f) != llen))
+			r = ARCHIVE_FATAL;
+	}
+	if (fclose(f) != 0)
+		r = ARCHIVE_FATAL;
+	if (r != ARCHIVE_OK)
+		archive_set_error(&a->archive, errno,
+		    "Can't write tar index `%s'", tar->index_write_path);
+	/* Only write it once. */
+	free(tar->index_write_path);
+	tar->index_write_path = NULL;
+	return (r);
+}
+
+static char *
+tar_index_read_string(FILE *f, size_t len)
+{
+	char *p;
+
+	p = malloc(len + 1);
+	if (p == NULL)
+		return (NULL);
+	if (len > 0 && fread(p, 1, len, f) != len) {
+		free(p);
+		return (NULL);
+	}
+	p[len] = '\0';
+	return (p);
+}
+
+static int
+tar_index_load(struct archive_read *a, struct tar *tar, const char *path)
+{
+	struct tar_index_entry *e;
+	unsigned char buff[TAR_INDEX_RECORD_SIZE];
+	uint64_t count, i;
+	size_t nlen, llen;
+	FILE *f;
+
+	tar_index_free(&tar->index);
+	tar->index_loaded = 0;
+
+	f = fopen(path, "rb");
+	if (f == NULL) {
+		archive_set_error(&a->archive, errno,
+		    "Can't open tar index `%s'", path);
+		return (ARCHIVE_FAILED);
+	}
+	if (fread(buff, TAR_INDEX_HEADER_SIZE, 1, f) != 1
+	    || memcmp(buff, TAR_INDEX_MAGIC, 8) != 0
+	    || archive_le32dec(buff + 8) != TAR_INDEX_VERSION)
+		goto corrupt;
+	count = archive_le64dec(buff + 16);
+	for (i = 0; i < count; i++) {
+		if (fread(buff, TAR_INDEX_RECORD_SIZE, 1, f) != 1)
+			goto corrupt;
+		nlen = archive_le32dec(buff + 28);
+		llen = archive_le32dec(buff + 32);
+		if (nlen > pathname_limit || llen > pathname_limit)
+			goto corrupt;
+		if ((e = tar_index_new_entry(&tar->index)) == NULL)
+			goto nomem;
+		e->header_offset = (int64_t)archive_le64dec(buff);
+		e->data_offset = (int64_t)archive_le64dec(buff + 8);
+		e->data_size = (int64_t)archive_le64dec(buff + 16);
+		e->mode = archive_le32dec(buff + 24);
+		if (e->header_offset < 0 || e->data_offset < e->header_offset
+		    || e->data_size < 0)
+			goto corrupt;
+		if ((e->pathname = tar_index_read_string(f, nlen)) == NULL)
+			goto corrupt;
+		if (llen > 0 &&
+		    (e->linkname = tar_index_read_string(f, llen)) == NULL)
+			goto corrupt;
+	}
+	fclose(f);
+	if (tar_index_build_hash(&tar->index) != ARCHIVE_OK) {
+		tar_index_free(&tar->index);
+		archive_set_error(&a->archive, ENOMEM,
+		    "Can't allocate tar index");
+		return (ARCHIVE_FATAL);
+	}
+	tar->index_loaded = 1;
+	return (ARCHIVE_OK);
+corrupt:
+	fclose(f);
+	tar_index_free(&tar->index);
+	archive_set_error(&a->archive, ARCHIVE_ERRNO_FILE_FORMAT,
+	    "Damaged tar index `%s'", path);
+	return (ARCHIVE_FAILED);
+nomem:
+	fclose(f);
+	tar_index_free(&tar->index);
+	archive_set_error(&a->archive, ENOMEM, "Can't allocate tar index");
+	return (ARCHIVE_FATAL);
+}
+
+/*
+ * Position the reader so that the next archive_read_next_header()
+ * returns the named entry, using the index loaded with the
+ * "read-index" option.  The headers are re-read from the archive, so
+ * the entry comes back exactly as a sequential read would return it.
+ */
+int
+archive_read_tar_seek_entry(struct archive *_a, const char *pathname)
+{
+	struct archive_read *a = (struct archive_read *)_a;
+	const struct tar_index_entry *e;
+	struct tar *tar;
+	int64_t r;
+
+	archive_check_magic(_a, ARCHIVE_READ_MAGIC,
+	    ARCHIVE_STATE_HEADER | ARCHIVE_STATE_DATA | ARCHIVE_STATE_EOF,
+	    "archive_read_tar_seek_entry");
+
+	if (a->format == NULL || strcmp(a->format->name, "tar") != 0) {
+		archive_set_error(_a, ARCHIVE_ERRNO_MISC,
+		    "Not reading a tar archive");
+		return (ARCHIVE_FAILED);
+	}
+	tar = (struct tar *)(a->format->data);
+	if (!tar->index_loaded) {
+		archive_set_error(_a, ARCHIVE_ERRNO_MISC,
+		    "No tar index loaded");
+		return (ARCHIVE_FAILED);
+	}
+	e = tar_index_lookup(&tar->index, pathname);
+	if (e == NULL) {
+		archive_set_error(_a, ENOENT,
+		    "`%s' not found in tar index", pathname);
+		return (ARCHIVE_FAILED);
+	}
+
+	r = __archive_read_seek(a, e->header_offset, SEEK_SET);
+	if (r < 0) {
+		if (r == ARCHIVE_FAILED)
+			archive_set_error(_a, ARCHIVE_ERRNO_MISC,
+			    "Archive is not seekable");
+		return ((int)r);
+	}
+
+	/* Forget the body of whatever entry we were positioned in. */
+	tar->entry_bytes_remaining = 0;
+	tar->entry_bytes_unconsumed = 0;
+	tar->entry_padding = 0;
+	gnu_clear_sparse_list(tar);
+	tar->index_seeked = 1;
+	a->archive.state = ARCHIVE_STATE_HEADER;
+	return (ARCHIVE_OK);
+}
@@ -27,6 +27,9 @@
 #ifdef HAVE_ERRNO_H
 #include <errno.h>
 #endif
+#ifdef HAVE_LIMITS_H
+#include <limits.h>
+#endif
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>
 #endif
@@ -58,6 +61,7 @@
 #include "archive_entry_locale.h"
 #include "archive_private.h"
 #include "archive_read_private.h"
+#include "archive_thread_private.h"
 
 #if (!defined(HAVE_LIBXML_XMLREADER_H) && \
      !defined(HAVE_BSDXML_H) && !defined(HAVE_EXPAT_H) && \
@@ -211,12 +215,48 @@ struct hdlink {
 	struct xar_file		 *files;
 };
 
-struct heap_queue {
+/*
+ * The files of the TOC, returned in order of their ids.  They are
+ * appended while the TOC is parsed, which usually gives them in that
+ * order already, and sorted once when it has been read.
+ */
+struct file_table {
 	struct xar_file		**files;
 	int			 allocated;
 	int			 used;
+	/* Index of the next file to be returned. */
+	int			 next;
+	int			 sorted;
 };
 
+/*
+ * The heap data of a file read ahead and decompressed on a worker
+ * thread, which also verifies its checksums.
+ */
+struct xar_job {
+	struct archive_thread	*thread;
+	int			 busy;
+	/* Index of the file in the file table. */
+	int			 index;
+	enum enctype		 encoding;
+	struct chksumval	 a_sum;
+	struct chksumval	 e_sum;
+	unsigned char		*raw;
+	size_t			 raw_size;
+	unsigned char		*out;
+	size_t			 out_size;
+	int			 status;
+	int			 error_number;
+	struct archive_string	 error_string;
+};
+
+/* Largest heap data, compressed or not, of a file that is decompressed
+ * on a worker thread; each one in flight is held in memory. */
+#define PARALLEL_DATA_MAX	(64 * 1024 * 1024)
+/* Smaller files are not worth a thread of their own; they are
+ * decompressed as they are read ahead. */
+#define PARALLEL_DATA_MIN	(64 * 1024)
+
 enum xmlstatus {
 	INIT,
 	XAR,
@@ -348,7 +388,7 @@ struct xar {
 
 	struct xar_file		*file;	/* current reading file. */
 	struct xattr		*xattr; /* current reading extended attribute. */
-	struct heap_queue	 file_queue;
+	struct file_table	 file_queue;
 	struct xar_file		*hdlink_orgs;
 	struct hdlink		*hdlink_list;
 
@@ -362,6 +402,21 @@ struct xar {
 	struct chksumval	 entry_e_sum;
 
 	struct archive_string_conv *sconv;
+
+	/*
+	 * Parallel decompression.
+	 */
+	int			 threads;
+	/* One slot per thread, indexed by file table index modulo threads. */
+	struct xar_job		*jobs;
+	/* Next file in the table whose data has not been read ahead. */
+	int			 prefetch_next;
+	/* Set when reading ahead failed; the stream is no longer usable. */
+	int			 prefetch_failed;
+	/* Set when the data of the current entry has been read ahead. */
+	int			 entry_prefetched;
+	/* Output of the current entry when it was decompressed by a job. */
+	unsigned char		*entry_buff;
 };
 
 struct xmlattr {
@@ -381,7 +436,11 @@ static int	xar_read_header(struct archive_read *,
 static int	xar_read_data(struct archive_read *,
 		    const void **, size_t *, int64_t *);
 static int	xar_read_data_skip(struct archive_read *);
+static int	xar_options(struct archive_read *,
+		    const char *, const char *);
 static int	xar_cleanup(struct archive_read *);
+static int	xar_decoded_entry(struct archive_read *);
+static void	free_jobs(struct xar *);
 static int	move_reading_point(struct archive_read *, uint64_t);
 static int	rd_contents_init(struct archive_read *,
 		    enum enctype, int, int);
@@ -391,9 +450,10 @@ static uint64_t	atol10(const char *, size_t);
 static int64_t	atol8(const char *, size_t);
 static size_t	atohex(unsigned char *, size_t, const char *, size_t);
 static time_t	parse_time(const char *p, size_t n);
-static int	heap_add_entry(struct archive_read *a,
-    struct heap_queue *, struct xar_file *);
-static struct xar_file *heap_get_entry(struct heap_queue *);
+static int	file_table_add(struct archive_read *a,
+    struct file_table *, struct xar_file *);
+static void	file_table_sort(struct file_table *);
+static struct xar_file *file_table_next(struct file_table *);
 static int	add_link(struct archive_read *,
     struct xar *, struct xar_file *);
 static void	checksum_init(struct archive_read *, int, int);
@@ -467,13 +527,16 @@ archive_read_support_format_xar(struct archive *_a)
 	/* initialize xar->file_queue */
 	xar->file_queue.allocated = 0;
 	xar->file_queue.used = 0;
+	xar->file_queue.next = 0;
+	xar->file_queue.sorted = 1;
 	xar->file_queue.files = NULL;
+	xar->threads = 1;
 
 	r = __archive_read_register_format(a,
 	    xar,
 	    "xar",
 	    xar_bid,
-	    NULL,
+	    xar_options,
 	    xar_read_header,
 	    xar_read_data,
 	    xar_read_data_skip,
@@ -533,6 +596,22 @@ xar_bid(struct archive_read *a, int best_bid)
 	return (bid);
 }
 
+static int
+xar_options(struct archive_read *a, const char *key, const char *val)
+{
+	struct xar *xar;
+
+	xar = (struct xar *)(a->format->data);
+	if (strcmp(key, "threads") == 0)
+		return (__archive_thread_parse_count(&a->archive, val,
+		    &xar->threads));
+
+	/* Note: The "warn" return is just to inform the options
+	 * supervisor that we didn't handle it.  It will generate
+	 * a suitable error if no one used this option. */
+	return (ARCHIVE_WARN);
+}
+
 static int
 read_toc(struct archive_read *a)
 {
@@ -665,6 +744,7 @@ read_toc(struct archive_read *a)
 			}
 		}
 	}
+	file_table_sort(&(xar->file_queue));
 	a->archive.archive_format = ARCHIVE_FORMAT_XAR;
 	a->archive.archive_format_name = "xar";
 
@@ -698,7 +778,7 @@ xar_read_header(struct archive_read *a, struct archive_entry *entry)
 	}
 
 	for (;;) {
-		file = xar->file = heap_get_entry(&(xar->file_queue));
+		file = xar->file = file_table_next(&(xar->file_queue));
 		if (file == NULL) {
 			xar->end_of_file = 1;
 			return (ARCHIVE_EOF);
@@ -709,9 +789,9 @@ xar_read_header(struct archive_read *a, struct archive_entry *entry)
 			break;
 		/*
 		 * If a file type is a directory and it does not have
-		 * any metadata, do not export.
+		 * any metadata, do not export; the next call to
+		 * file_table_next() releases it.
 		 */
-		file_free(file);
 	}
         if (file->has & HAS_ATIME) {
           archive_entry_set_atime(entry, file->atime, 0);
@@ -801,6 +881,10 @@ xar_read_header(struct archive_read *a, struct archive_entry *entry)
 		archive_entry_copy_fflags_text(entry, file->fflags_text.s);
 
 	xar->entry_init = 1;
+	/* The data of this file has been read ahead along with that of
+	 * the file before it; see xar_decoded_entry(). */
+	xar->entry_prefetched =
+	    xar->file_queue.next - 1 < xar->prefetch_next;
 	xar->entry_total = 0;
 	xar->entry_remaining = file->length;
 	xar->entry_size = file->size;
@@ -854,19 +938,16 @@ xar_read_header(struct archive_read *a, struct archive_entry *entry)
 		    xattr->name.s, d, outbytes);
 		xattr = xattr->next;
 	}
-	if (r != ARCHIVE_OK) {
-		file_free(file);
+	if (r != ARCHIVE_OK)
 		return (r);
-	}
 
-	if (xar->entry_remaining > 0)
+	if (xar->entry_remaining > 0 && !xar->entry_prefetched)
 		/* Move reading point to the beginning of current
 		 * file contents. */
 		r = move_reading_point(a, file->offset);
 	else
 		r = ARCHIVE_OK;
 
-	file_free(file);
 	return (r);
 }
 
@@ -891,6 +972,23 @@ xar_read_data(struct archive_read *a,
 	}
 
 	if (xar->entry_init) {
+		r = xar_decoded_entry(a);
+		if (r < 0) {
+			xar->entry_remaining = 0;
+			return (r);
+		}
+		if (r > 0) {
+			/* The whole entry has been decompressed and its
+			 * checksums verified by a job. */
+			xar->entry_init = 0;
+			*buff = xar->entry_buff;
+			*size = (size_t)xar->entry_size;
+			*offset = 0;
+			xar->entry_total = xar->entry_size;
+			xar->total += xar->entry_size;
+			xar->entry_remaining = 0;
+			return (ARCHIVE_OK);
+		}
 		r = rd_contents_init(a, xar->entry_encoding,
 		    xar->entry_a_sum.alg, xar->entry_e_sum.alg);
 		if (r != ARCHIVE_OK) {
@@ -943,6 +1041,9 @@ xar_read_data_skip(struct archive_read *a)
 	xar = (struct xar *)(a->format->data);
 	if (xar->end_of_file)
 		return (ARCHIVE_EOF);
+	/* The data has already been read past. */
+	if (xar->entry_prefetched)
+		return (ARCHIVE_OK);
 	bytes_skipped = __archive_read_consume(a, xar->entry_remaining +
 		xar->entry_unconsumed);
 	if (bytes_skipped < 0)
@@ -970,8 +1071,11 @@ xar_cleanup(struct archive_read *a)
 		free(hdlink);
 		hdlink = next;
 	}
-	for (i = 0; i < xar->file_queue.used; i++)
-		file_free(xar->file_queue.files[i]);
+	free_jobs(xar);
+	for (i = 0; i < xar->file_queue.used; i++) {
+		if (xar->file_queue.files[i] != NULL)
+			file_free(xar->file_queue.files[i]);
+	}
 	free(xar->file_queue.files);
 	while (xar->unknowntags != NULL) {
 		struct unknown_tag *tag;
@@ -1229,110 +1333,75 @@ parse_time(const char *p, size_t n)
 }
 
 static int
-heap_add_entry(struct archive_read *a,
-    struct heap_queue *heap, struct xar_file *file)
+file_table_add(struct archive_read *a,
+    struct file_table *table, struct xar_file *file)
 {
-	uint64_t file_id, parent_id;
-	int hole, parent;
-
 	/* Expand our pending files list as necessary. */
-	if (heap->used >= heap->allocated) {
+	if (table->used >= table->allocated) {
 		struct xar_file **new_pending_files;
 		int new_size;
 
-		if (heap->allocated < 1024)
+		if (table->allocated < 1024)
 			new_size = 1024;
 		else
-			new_size = heap->allocated * 2;
+			new_size = table->allocated * 2;
 		/* Overflow might keep us from growing the list. */
-		if (new_size <= heap->allocated) {
+		if (new_size <= table->allocated) {
 			archive_set_error(&a->archive,
 			    ENOMEM, "Out of memory");
 			return (ARCHIVE_FATAL);
 		}
 		new_pending_files = (struct xar_file **)
-		    calloc(new_size, sizeof(new_pending_files[0]));
+		    realloc(table->files, new_size * sizeof(new_pending_files[0]));
 		if (new_pending_files == NULL) {
 			archive_set_error(&a->archive,
 			    ENOMEM, "Out of memory");
 			return (ARCHIVE_FATAL);
 		}
-		if (heap->allocated) {
-			memcpy(new_pending_files, heap->files,
-			    heap->allocated * sizeof(new_pending_files[0]));
-			free(heap->files);
-		}
-		heap->files = new_pending_files;
-		heap->allocated = new_size;
+		table->files = new_pending_files;
+		table->allocated = new_size;
 	}
-
-	file_id = file->id;
-
-	/*
-	 * Start with hole at end, walk it up tree to find insertion point.
-	 */
-	hole = heap->used++;
-	while (hole > 0) {
-		parent = (hole - 1)/2;
-		parent_id = heap->files[parent]->id;
-		if (file_id >= parent_id) {
-			heap->files[hole] = file;
-			return (ARCHIVE_OK);
-		}
-		/* Move parent into hole <==> move hole up tree. */
-		heap->files[hole] = heap->files[parent];
-		hole = parent;
-	}
-	heap->files[0] = file;
+	if (table->used > 0 && file->id < table->files[table->used - 1]->id)
+		table->sorted = 0;
+	table->files[table->used++] = file;
 
 	return (ARCHIVE_OK);
 }
 
-static struct xar_file *
-heap_get_entry(struct heap_queue *heap)
+static int
+file_cmp(const void *p1, const void *p2)
 {
-	uint64_t a_id, b_id, c_id;
-	int a, b, c;
-	struct xar_file *r, *tmp;
+	const struct xar_file *f1 = *(const struct xar_file * const *)p1;
+	const struct xar_file *f2 = *(const struct xar_file * const *)p2;
 
-	if (heap->used < 1)
-		return (NULL);
-
-	/*
-	 * The first file in the list is the earliest; we'll return this.
-	 */
-	r = heap->files[0];
+	if (f1->id != f2->id)
+		return (f1->id < f2->id ? -1 : 1);
+	return (0);
+}
 
-	/*
-	 * Move the last item in the heap to the root of the tree
-	 */
-	heap->files[0] = heap->files[--(heap->used)];
+static void
+file_table_sort(struct file_table *table)
+{
+	if (!table->sorted && table->used > 1)
+		qsort(table->files, table->used, sizeof(table->files[0]),
+		    file_cmp);
+	table->sorted = 1;
+}
 
-	/*
-	 * Rebalance the heap.
-	 */
-	a = 0; /* Starting element and its heap key */
-	a_id = heap->files[a]->id;
-	for (;;) {
-		b = a + a + 1; /* First child */
-		if (b >= heap->used)
-			return (r);
-		b_id = heap->files[b]->id;
-		c = b + 1; /* Use second child if it is smaller. */
-		if (c < heap->used) {
-			c_id = heap->files[c]->id;
-			if (c_id < b_id) {
-				b = c;
-				b_id = c_id;
-			}
-		}
-		if (a_id <= b_id)
-			return (r);
-		tmp = heap->files[a];
-		heap->files[a] = heap->files[b];
-		heap->files[b] = tmp;
-		a = b;
+/*
+ * Return the next file in order of ids, releasing the one returned
+ * before it.
+ */
+static struct xar_file *
+file_table_next(struct file_table *table)
+{
+	if (table->next > 0 && table->files[table->next - 1] != NULL) {
+		file_free(table->files[table->next - 1]);
+		table->files[table->next - 1] = NULL;
 	}
+	if (table->next >= table->used)
+		return (NULL);
+	return (table->files[table->next++]);
 }
 
 static int
@@ -1768,6 +1837,433 @@ checksum_cleanup(struct archive_read *a) {
 	_checksum_final(&(xar->e_sumwrk), NULL, 0);
 }
 
+/*
+ * Whether the heap data of a file can be decompressed by a job: it
+ * must be compressed, be small enough to hold in memory and not lie
+ * behind the current read position.
+ */
+static int
+file_job_eligible(struct xar *xar, const struct xar_file *file)
+{
+	if (file->length == 0 || file->length > PARALLEL_DATA_MAX ||
+	    file->size > PARALLEL_DATA_MAX)
+		return (0);
+	if (file->offset < xar->offset - xar->h_base)
+		return (0);
+	switch (file->encoding) {
+	case GZIP:
+#if defined(HAVE_BZLIB_H) && defined(BZ_CONFIG_ERROR)
+	case BZIP2:
+#endif
+#if defined(HAVE_LZMA_H) && defined(HAVE_LIBLZMA)
+	case LZMA:
+	case XZ:
+#endif
+		return (1);
+	default:
+		return (0);
+	}
+}
+
+/*
+ * Decompress the heap data of a job into its output, no more than
+ * OUTBUFF_SIZE bytes at a time, updating the checksums of what has
+ * just been consumed and produced while it is still in cache.
+ * Returns the number of bytes produced, or -1 on error.
+ */
+static int64_t
+decode_job_data(struct xar_job *job, struct chksumwork *a_sumwrk,
+    struct chksumwork *e_sumwrk)
+{
+	const unsigned char *in = job->raw;
+	size_t in_left = job->raw_size;
+	/* One byte more than expected, to notice too long data. */
+	size_t out_left = job->out_size + 1;
+	unsigned char *out = job->out;
+	size_t avail_in, avail_out;
+	int end = 0, r;
+	z_stream stream;
+#if defined(HAVE_BZLIB_H) && defined(BZ_CONFIG_ERROR)
+	bz_stream bzstream;
+#endif
+#if defined(HAVE_LZMA_H) && defined(HAVE_LIBLZMA)
+	lzma_stream lzstream = LZMA_STREAM_INIT;
+#endif
+
+	switch (job->encoding) {
+	case GZIP:
+		memset(&stream, 0, sizeof(stream));
+		r = inflateInit(&stream);
+		break;
+#if defined(HAVE_BZLIB_H) && defined(BZ_CONFIG_ERROR)
+	case BZIP2:
+		memset(&bzstream, 0, sizeof(bzstream));
+		r = BZ2_bzDecompressInit(&bzstream, 0, 0);
+		if (r == BZ_MEM_ERROR)
+			r = BZ2_bzDecompressInit(&bzstream, 0, 1);
+		break;
+#endif
+#if defined(HAVE_LZMA_H) && defined(HAVE_LIBLZMA)
+	case XZ:
+		r = lzma_stream_decoder(&lzstream, LZMA_MEMLIMIT,
+		    LZMA_CONCATENATED);
+		break;
+	case LZMA:
+		r = lzma_alone_decoder(&lzstream, LZMA_MEMLIMIT);
+		break;
+#endif
+	default:
+		r = -1;
+		break;
+	}
+	if (r != 0) {
+		job->error_number = ENOMEM;
+		archive_strcpy(&job->error_string,
+		    "Couldn't initialize decompression library");
+		return (-1);
+	}
+
+	while (!end && in_left > 0 && out_left > 0) {
+		avail_in = in_left;
+		avail_out = out_left > OUTBUFF_SIZE ? OUTBUFF_SIZE : out_left;
+		switch (job->encoding) {
+		case GZIP:
+			stream.next_in = (Bytef *)(uintptr_t)in;
+			stream.avail_in = (uInt)(avail_in > UINT_MAX ?
+			    UINT_MAX : avail_in);
+			avail_in = stream.avail_in;
+			stream.next_out = out;
+			stream.avail_out = (uInt)avail_out;
+			r = inflate(&stream, 0);
+			if (r == Z_STREAM_END)
+				end = 1;
+			else if (r != Z_OK) {
+				archive_string_sprintf(&job->error_string,
+				    "File decompression failed (%d)", r);
+				goto failed;
+			}
+			avail_in -= stream.avail_in;
+			avail_out -= stream.avail_out;
+			break;
+#if defined(HAVE_BZLIB_H) && defined(BZ_CONFIG_ERROR)
+		case BZIP2:
+			bzstream.next_in = (char *)(uintptr_t)in;
+			bzstream.avail_in = (unsigned int)(avail_in > UINT_MAX ?
+			    UINT_MAX : avail_in);
+			avail_in = bzstream.avail_in;
+			bzstream.next_out = (char *)out;
+			bzstream.avail_out = (unsigned int)avail_out;
+			r = BZ2_bzDecompress(&bzstream);
+			if (r == BZ_STREAM_END)
+				end = 1;
+			else if (r != BZ_OK) {
+				archive_strcpy(&job->error_string,
+				    "bzip decompression failed");
+				goto failed;
+			}
+			avail_in -= bzstream.avail_in;
+			avail_out -= bzstream.avail_out;
+			break;
+#endif
+#if defined(HAVE_LZMA_H) && defined(HAVE_LIBLZMA)
+		case LZMA:
+		case XZ:
+			lzstream.next_in = in;
+			lzstream.avail_in = avail_in;
+			lzstream.next_out = out;
+			lzstream.avail_out = avail_out;
+			r = lzma_code(&lzstream, LZMA_RUN);
+			if (r == LZMA_STREAM_END)
+				end = 1;
+			else if (r != LZMA_OK) {
+				archive_string_sprintf(&job->error_string,
+				    "%s decompression failed(%d)",
+				    (job->encoding == XZ)?"xz":"lzma", r);
+				goto failed;
+			}
+			avail_in -= lzstream.avail_in;
+			avail_out -= lzstream.avail_out;
+			break;
+#endif
+		default:
+			goto failed;
+		}
+		if (avail_in == 0 && avail_out == 0 && !end)
+			break;
+		_checksum_update(a_sumwrk, in, avail_in);
+		_checksum_update(e_sumwrk, out, avail_out);
+		in += avail_in;
+		in_left -= avail_in;
+		out += avail_out;
+		out_left -= avail_out;
+	}
+	/* The archived checksum covers all of the heap data. */
+	_checksum_update(a_sumwrk, in, in_left);
+
+	switch (job->encoding) {
+	case GZIP:
+		inflateEnd(&stream);
+		break;
+#if defined(HAVE_BZLIB_H) && defined(BZ_CONFIG_ERROR)
+	case BZIP2:
+		BZ2_bzDecompressEnd(&bzstream);
+		break;
+#endif
+#if defined(HAVE_LZMA_H) && defined(HAVE_LIBLZMA)
+	case LZMA:
+	case XZ:
+		lzma_end(&lzstream);
+		break;
+#endif
+	default:
+		break;
+	}
+	return (out - job->out);
+failed:
+	job->error_number = ARCHIVE_ERRNO_MISC;
+	switch (job->encoding) {
+	case GZIP:
+		inflateEnd(&stream);
+		break;
+#if defined(HAVE_BZLIB_H) && defined(BZ_CONFIG_ERROR)
+	case BZIP2:
+		BZ2_bzDecompressEnd(&bzstream);
+		break;
+#endif
+#if defined(HAVE_LZMA_H) && defined(HAVE_LIBLZMA)
+	case LZMA:
+	case XZ:
+		lzma_end(&lzstream);
+		break;
+#endif
+	default:
+		break;
+	}
+	return (-1);
+}
+
+/*
+ * Decompress the heap data held in a job and verify its checksums.
+ * This runs on a worker thread and touches nothing but the job.
+ */
+static void
+decode_job(void *arg)
+{
+	struct xar_job *job = (struct xar_job *)arg;
+	struct chksumwork a_sumwrk, e_sumwrk;
+	int64_t bytes;
+	int r;
+
+	_checksum_init(&a_sumwrk, job->a_sum.alg);
+	_checksum_init(&e_sumwrk, job->e_sum.alg);
+	job->out = malloc(job->out_size + 1);
+	if (job->out == NULL) {
+		job->status = ARCHIVE_FATAL;
+		job->error_number = ENOMEM;
+		archive_strcpy(&job->error_string,
+		    "Couldn't allocate memory for out buffer");
+		bytes = 0;
+	} else {
+		bytes = decode_job_data(job, &a_sumwrk, &e_sumwrk);
+		if (bytes < 0)
+			job->status = ARCHIVE_FATAL;
+		else if ((uint64_t)bytes != job->out_size) {
+			job->status = ARCHIVE_FATAL;
+			job->error_number = ARCHIVE_ERRNO_MISC;
+			archive_strcpy(&job->error_string,
+			    "Decompressed size error");
+		}
+	}
+	r = _checksum_final(&a_sumwrk, job->a_sum.val, job->a_sum.len);
+	if (_checksum_final(&e_sumwrk, job->e_sum.val, job->e_sum.len)
+	    != ARCHIVE_OK)
+		r = ARCHIVE_FAILED;
+	if (r != ARCHIVE_OK && job->status == ARCHIVE_OK) {
+		job->status = r;
+		job->error_number = ARCHIVE_ERRNO_MISC;
+		archive_strcpy(&job->error_string, "Sumcheck error");
+	}
+	/* The heap data is no longer needed. */
+	free(job->raw);
+	job->raw = NULL;
+}
+
+/*
+ * Read the heap data of a file into memory and hand it to a worker
+ * thread.  If the file is small or no thread can be created,
+ * decompress it right away instead.  Truncated data is recorded in the job, to be reported once
+ * the file is read, and ends reading ahead.
+ */
+static int
+start_job(struct archive_read *a, int index)
+{
+	struct xar *xar = (struct xar *)(a->format->data);
+	const struct xar_file *file = xar->file_queue.files[index];
+	struct xar_job *job = &(xar->jobs[index % xar->threads]);
+	const unsigned char *p;
+	ssize_t bytes;
+
+	job->index = index;
+	job->busy = 1;
+	job->status = ARCHIVE_OK;
+	job->encoding = file->encoding;
+	job->a_sum = file->a_sum;
+	job->e_sum = file->e_sum;
+	job->raw_size = 0;
+	job->out = NULL;
+	job->out_size = (size_t)file->size;
+	archive_string_empty(&job->error_string);
+	job->raw = malloc((size_t)file->length);
+	if (job->raw == NULL) {
+		job->busy = 0;
+		archive_set_error(&a->archive, ENOMEM, "Out of memory");
+		return (ARCHIVE_FATAL);
+	}
+
+	if (move_reading_point(a, file->offset) != ARCHIVE_OK)
+		goto failed;
+	while (job->raw_size < file->length) {
+		p = __archive_read_ahead(a, 1, &bytes);
+		if (bytes <= 0) {
+			if (bytes == 0)
+				archive_set_error(&a->archive,
+				    ARCHIVE_ERRNO_MISC,
+				    "Truncated archive file");
+			goto failed;
+		}
+		if ((uint64_t)bytes > file->length - job->raw_size)
+			bytes = (ssize_t)(file->length - job->raw_size);
+		memcpy(job->raw + job->raw_size, p, bytes);
+		job->raw_size += bytes;
+		__archive_read_consume(a, bytes);
+		xar->offset += bytes;
+	}
+
+	if (file->size < PARALLEL_DATA_MIN ||
+	    __archive_thread_create(&job->thread, decode_job, job))
+		decode_job(job);
+	return (ARCHIVE_OK);
+failed:
+	free(job->raw);
+	job->raw = NULL;
+	job->status = ARCHIVE_FATAL;
+	job->error_number = archive_errno(&a->archive);
+	archive_strcpy(&job->error_string,
+	    archive_error_string(&a->archive) != NULL ?
+	    archive_error_string(&a->archive) : "Truncated archive file");
+	archive_clear_error(&a->archive);
+	xar->prefetch_failed = 1;
+	return (ARCHIVE_OK);
+}
+
+static void
+finish_job(struct xar_job *job)
+{
+	__archive_thread_join(job->thread);
+	job->thread = NULL;
+	job->busy = 0;
+}
+
+static void
+free_jobs(struct xar *xar)
+{
+	int i;
+
+	if (xar->jobs != NULL) {
+		for (i = 0; i < xar->threads; i++) {
+			if (xar->jobs[i].busy)
+				finish_job(&(xar->jobs[i]));
+			free(xar->jobs[i].raw);
+			free(xar->jobs[i].out);
+			archive_string_free(&(xar->jobs[i].error_string));
+		}
+		free(xar->jobs);
+		xar->jobs = NULL;
+	}
+	free(xar->entry_buff);
+	xar->entry_buff = NULL;
+}
+
+/*
+ * Called when the data of an entry is first asked for.  With more
+ * than one thread, read the heap data of that file and of those
+ * following it ahead and decompress them on worker threads.  Returns
+ * 1 if the file has been decompressed that way and its data is in
+ * xar->entry_buff, 0 if it must be decompressed as usual.
+ */
+static int
+xar_decoded_entry(struct archive_read *a)
+{
+	struct xar *xar = (struct xar *)(a->format->data);
+	struct xar_file *file;
+	struct xar_job *job;
+	int i, k, r;
+
+	free(xar->entry_buff);
+	xar->entry_buff = NULL;
+	if (xar->threads <= 1)
+		return (0);
+	k = xar->file_queue.next - 1;
+
+	if (xar->jobs == NULL) {
+		xar->jobs = calloc(xar->threads, sizeof(*xar->jobs));
+		if (xar->jobs == NULL) {
+			archive_set_error(&a->archive, ENOMEM,
+			    "Out of memory");
+			return (ARCHIVE_FATAL);
+		}
+	}
+	/* Discard files left behind. */
+	for (i = 0; i < xar->threads; i++) {
+		job = &(xar->jobs[i]);
+		if (job->busy && job->index < k) {
+			finish_job(job);
+			free(job->out);
+			job->out = NULL;
+		}
+	}
+	if (xar->prefetch_next < k)
+		xar->prefetch_next = k;
+
+	job = &(xar->jobs[k % xar->threads]);
+	if (!(job->busy && job->index == k) &&
+	    (xar->prefetch_next != k ||
+	     !file_job_eligible(xar, xar->file_queue.files[k])))
+		return (0);
+	while (!xar->prefetch_failed &&
+	    xar->prefetch_next < xar->file_queue.used &&
+	    xar->prefetch_next - k < xar->threads) {
+		/* Extended attributes are read along with the header,
+		 * from wherever they are in the heap. */
+		file = xar->file_queue.files[xar->prefetch_next];
+		if (file->xattr_list != NULL)
+			break;
+		if (file->length > 0) {
+			if (!file_job_eligible(xar, file))
+				break;
+			r = start_job(a, xar->prefetch_next);
+			if (r < 0)
+				return (r);
+		}
+		xar->prefetch_next++;
+	}
+	if (!job->busy || job->index != k)
+		return (0);
+
+	xar->entry_prefetched = 1;
+	finish_job(job);
+	if (job->status != ARCHIVE_OK) {
+		archive_set_error(&a->archive, job->error_number, "%s",
+		    job->error_string.s);
+		free(job->out);
+		job->out = NULL;
+		return (job->status);
+	}
+	xar->entry_buff = job->out;
+	job->out = NULL;
+	return (1);
+}
+
 static void
 xmlattr_cleanup(struct xmlattr_list *list)
 {
@@ -1807,7 +2303,7 @@ file_new(struct archive_read *a, struct xar *xar, struct xmlattr_list *list)
 			file->id = atol10(attr->value, strlen(attr->value));
 	}
 	file->nlink = 1;
-	if (heap_add_entry(a, &(xar->file_queue), file) != ARCHIVE_OK)
+	if (file_table_add(a, &(xar->file_queue), file) != ARCHIVE_OK)
 		return (ARCHIVE_FATAL);
 	return (ARCHIVE_OK);
 }
@@ -71,6 +71,7 @@
 #include "archive_private.h"
 #include "archive_rb.h"
 #include "archive_read_private.h"
+#include "archive_thread_private.h"
 #include "archive_time_private.h"
 #include "archive_ppmd8_private.h"
 
@@ -200,6 +201,8 @@ struct zip {
 #endif
 
 	IByteIn			zipx_ppmd_stream;
+	/* Start of the read-ahead bytes handed to the range decoder. */
+	const uint8_t		*zipx_ppmd_window;
 	ssize_t			zipx_ppmd_read_compressed;
 	CPpmd8			ppmd8;
 	char			ppmd8_valid;
@@ -231,6 +234,10 @@ struct zip {
 	/* Traditional PKWARE decryption. */
 	struct trad_enc_ctx	tctx;
 	char			tctx_valid;
+	/* tctx was set up by archive_read_zip_find_passphrase(). */
+	char			tctx_preset;
+	/* computed_crc32 already covers the bytes being returned. */
+	char			crc32_fused;
 
 	/* WinZip AES decryption. */
 	/* Contexts used for AES decryption. */
@@ -266,28 +273,48 @@ zip_read_data_zipx_lzma_alone(struct archive_read *a, const void **buff,
 	size_t *size, int64_t *offset);
 #endif
 
+/* The Ppmd8 range decoder reads straight from a window over the
+ * read-ahead buffer. Consume the bytes it took from the window and add
+ * them to the counter of compressed bytes read. */
+static void
+ppmd_consume_window(struct archive_read *a, struct zip *zip)
+{
+	size_t n;
+
+	if(zip->zipx_ppmd_window != NULL) {
+		n = zip->zipx_ppmd_stream.Cur - zip->zipx_ppmd_window;
+		__archive_read_consume(a, n);
+		zip->zipx_ppmd_read_compressed += n;
+	}
+	zip->zipx_ppmd_window = NULL;
+	zip->zipx_ppmd_stream.Cur = NULL;
+	zip->zipx_ppmd_stream.Lim = NULL;
+}
+
 /* This function is used by Ppmd8_DecodeSymbol during decompression of Ppmd8
- * streams inside ZIP files. It has 2 purposes: one is to fetch the next
- * compressed byte from the stream, second one is to increase the counter how
- * many compressed bytes were read. */
+ * streams inside ZIP files, whenever the window is exhausted. It consumes
+ * the window, fetches the next compressed byte from the stream and makes
+ * whatever follows it available as the new window. */
 static Byte
 ppmd_read(void* p) {
 	/* Get the handle to current decompression context. */
 	struct archive_read *a = ((IByteIn*)p)->a;
 	struct zip *zip = (struct zip*) a->format->data;
 	ssize_t bytes_avail = 0;
+	const uint8_t* data;
+
+	ppmd_consume_window(a, zip);
 
 	/* Fetch next byte. */
-	const uint8_t* data = __archive_read_ahead(a, 1, &bytes_avail);
+	data = __archive_read_ahead(a, 1, &bytes_avail);
 	if(bytes_avail < 1) {
 		zip->ppmd8_stream_failed = 1;
 		return 0;
 	}
 
-	__archive_read_consume(a, 1);
-
-	/* Increment the counter. */
-	++zip->zipx_ppmd_read_compressed;
+	zip->zipx_ppmd_window = data;
+	zip->zipx_ppmd_stream.Cur = data + 1;
+	zip->zipx_ppmd_stream.Lim = data + bytes_avail;
 
 	/* Return the next compressed byte. */
 	return data[0];
@@ -299,45 +326,88 @@ ppmd_read(void* p) {
   Traditional PKWARE Decryption functions.
  */
 
+/*
+ * Both the key schedule and the decryption below are driven by the
+ * usual byte-at-a-time CRC-32 table; looking it up directly instead of
+ * calling crc32() for every byte keeps the whole update in registers.
+ */
+static uint32_t trad_enc_crc_table[256];
+static archive_thread_once_t trad_enc_crc_table_once =
+    ARCHIVE_THREAD_ONCE_INIT;
+
 static void
-trad_enc_update_keys(struct trad_enc_ctx *ctx, uint8_t c)
+trad_enc_build_table(void)
 {
-	uint8_t t;
-#define CRC32(c, b) (crc32(c ^ 0xffffffffUL, &b, 1) ^ 0xffffffffUL)
-
-	ctx->keys[0] = CRC32(ctx->keys[0], c);
-	ctx->keys[1] = (ctx->keys[1] + (ctx->keys[0] & 0xff)) * 134775813L + 1;
-	t = (ctx->keys[1] >> 24) & 0xff;
-	ctx->keys[2] = CRC32(ctx->keys[2], t);
-#undef CRC32
-}
+	uint32_t crc, b, i;
 
-static uint8_t
-trad_enc_decrypt_byte(struct trad_enc_ctx *ctx)
-{
-	unsigned temp = ctx->keys[2] | 2;
-	return (uint8_t)((temp * (temp ^ 1)) >> 8) & 0xff;
+	for (b = 0; b < 256; ++b) {
+		crc = b;
+		for (i = 8; i > 0; --i) {
+			if (crc & 1)
+				crc = (crc >> 1) ^ 0xedb88320UL;
+			else
+				crc = (crc >> 1);
+		}
+		trad_enc_crc_table[b] = crc;
+	}
 }
 
+#define TRAD_ENC_CRC(crc, b) \
+	(trad_enc_crc_table[((crc) ^ (b)) & 0xff] ^ ((crc) >> 8))
+
+/* Advance the three keys over the plaintext byte c. */
+#define TRAD_ENC_UPDATE_KEYS(k0, k1, k2, c) do {			\
+	(k0) = TRAD_ENC_CRC(k0, c);					\
+	(k1) = ((k1) + ((k0) & 0xff)) * 134775813UL + 1;		\
+	(k2) = TRAD_ENC_CRC(k2, (k1) >> 24);				\
+} while (0)
+
+/* The keystream byte derived from k2. */
+#define TRAD_ENC_DECRYPT_BYTE(k2) \
+	((uint8_t)((((k2) | 2) * (((k2) | 2) ^ 1)) >> 8))
+
+/*
+ * Decrypt min(in_len, out_len) bytes.  If crc is not NULL, the
+ * standard CRC-32 of the plaintext is carried along in *crc, which
+ * costs next to nothing since it does not lengthen the dependency
+ * chain through the keys and saves a second pass over the output.
+ */
 static void
 trad_enc_decrypt_update(struct trad_enc_ctx *ctx, const uint8_t *in,
-    size_t in_len, uint8_t *out, size_t out_len)
+    size_t in_len, uint8_t *out, size_t out_len, uint32_t *crc)
 {
-	unsigned i, max;
+	uint32_t k0 = ctx->keys[0], k1 = ctx->keys[1], k2 = ctx->keys[2];
+	size_t i, max;
 
-	max = (unsigned)((in_len < out_len)? in_len: out_len);
+	max = (in_len < out_len)? in_len: out_len;
 
-	for (i = 0; i < max; i++) {
-		uint8_t t = in[i] ^ trad_enc_decrypt_byte(ctx);
-		out[i] = t;
-		trad_enc_update_keys(ctx, t);
+	if (crc != NULL) {
+		uint32_t c = *crc ^ 0xffffffffUL;
+
+		for (i = 0; i < max; i++) {
+			uint8_t t = in[i] ^ TRAD_ENC_DECRYPT_BYTE(k2);
+			out[i] = t;
+			c = TRAD_ENC_CRC(c, t);
+			TRAD_ENC_UPDATE_KEYS(k0, k1, k2, t);
+		}
+		*crc = c ^ 0xffffffffUL;
+	} else {
+		for (i = 0; i < max; i++) {
+			uint8_t t = in[i] ^ TRAD_ENC_DECRYPT_BYTE(k2);
+			out[i] = t;
+			TRAD_ENC_UPDATE_KEYS(k0, k1, k2, t);
+		}
 	}
+	ctx->keys[0] = k0;
+	ctx->keys[1] = k1;
+	ctx->keys[2] = k2;
 }
 
 static int
 trad_enc_init(struct trad_enc_ctx *ctx, const char *pw, size_t pw_len,
     const uint8_t *key, size_t key_len, uint8_t *crcchk)
 {
+	uint32_t k0 = 305419896UL, k1 = 591751049UL, k2 = 878082192UL;
 	uint8_t header[12];
 
 	if (key_len < 12) {
@@ -345,14 +415,16 @@ trad_enc_init(struct trad_enc_ctx *ctx, const char *pw, size_t pw_len,
 		return -1;
 	}
 
-	ctx->keys[0] = 305419896L;
-	ctx->keys[1] = 591751049L;
-	ctx->keys[2] = 878082192L;
-
-	for (;pw_len; --pw_len)
-		trad_enc_update_keys(ctx, *pw++);
+	__archive_thread_once(&trad_enc_crc_table_once, trad_enc_build_table);
+	for (;pw_len; --pw_len) {
+		uint8_t c = (uint8_t)*pw++;
+		TRAD_ENC_UPDATE_KEYS(k0, k1, k2, c);
+	}
+	ctx->keys[0] = k0;
+	ctx->keys[1] = k1;
+	ctx->keys[2] = k2;
 
-	trad_enc_decrypt_update(ctx, key, 12, header, 12);
+	trad_enc_decrypt_update(ctx, key, 12, header, 12, NULL);
 	/* Return the last byte for CRC check. */
 	*crcchk = header[11];
 	return 0;
@@ -1601,7 +1673,7 @@ zip_read_data_none(struct archive_read *a, const void **_buff,
 	trailing_extra = zip->hctx_valid ? AUTH_CODE_SIZE : 0;
 
 	if (zip->entry->zip_flags & ZIP_LENGTH_AT_END) {
-		const char *p;
+		const char *p, *q;
 		ssize_t grabbing_bytes = 24 + trailing_extra;
 
 		/* Grab at least 24 bytes. */
@@ -1639,16 +1711,12 @@ zip_read_data_none(struct archive_read *a, const void **_buff,
 		/* Scan forward until we see where a PK\007\010 signature
 		 * might be. */
 		/* Return bytes up until that point.  On the next call,
-		 * the code above will verify the data descriptor. */
-		while (p < buff + bytes_avail - 4) {
-			if (p[3] == 'P') { p += 3; }
-			else if (p[3] == 'K') { p += 2; }
-			else if (p[3] == '\007') { p += 1; }
-			else if (p[3] == '\010' && p[2] == '\007'
-			    && p[1] == 'K' && p[0] == 'P') {
-				break;
-			} else { p += 4; }
-		}
+		 * the code above will verify the data descriptor.
+		 * Without a complete signature, hold back the last three
+		 * bytes, which could be the start of one. */
+		q = __archive_read_find_signature(p, buff + bytes_avail,
+		    "PK\007\010", 4);
+		p = q != NULL ? q : buff + bytes_avail - 3;
 		p -= trailing_extra;
 		bytes_avail = p - buff;
 	} else {
@@ -1677,10 +1745,18 @@ zip_read_data_none(struct archive_read *a, const void **_buff,
 
 		if (dec_size > zip->decrypted_buffer_size)
 			dec_size = zip->decrypted_buffer_size;
-		if (zip->tctx_valid) {
+		if (zip->tctx_valid && zip->crc32func == real_crc32) {
+			uint32_t crc = (uint32_t)zip->computed_crc32;
+
+			trad_enc_decrypt_update(&zip->tctx,
+			    (const uint8_t *)buff, dec_size,
+			    zip->decrypted_buffer, dec_size, &crc);
+			zip->computed_crc32 = crc;
+			zip->crc32_fused = 1;
+		} else if (zip->tctx_valid) {
 			trad_enc_decrypt_update(&zip->tctx,
 			    (const uint8_t *)buff, dec_size,
-			    zip->decrypted_buffer, dec_size);
+			    zip->decrypted_buffer, dec_size, NULL);
 		} else {
 			size_t dsize = dec_size;
 			archive_hmac_sha1_update(&zip->hctx,
@@ -2072,15 +2148,15 @@ zipx_ppmd8_init(struct archive_read *a, struct zip *zip)
 	uint32_t order;
 	uint32_t mem;
 	uint32_t restore_method;
+	int range_ok;
 
-	/* Remove previous decompression context if it exists. */
-	if(zip->ppmd8_valid) {
-		__archive_ppmd8_functions.Ppmd8_Free(&zip->ppmd8);
-		zip->ppmd8_valid = 0;
+	/* Create a decompression context, unless an earlier entry left one
+	 * behind; Ppmd8_Alloc() below reuses its memory when large enough.
+	 * The cleanup function releases it. */
+	if(!zip->ppmd8_valid) {
+		__archive_ppmd8_functions.Ppmd8_Construct(&zip->ppmd8);
+		zip->ppmd8_valid = 1;
 	}
-
-	/* Create a new decompression context. */
-	__archive_ppmd8_functions.Ppmd8_Construct(&zip->ppmd8);
 	zip->ppmd8_stream_failed = 0;
 
 	/* Setup function pointers required by Ppmd8 decompressor. The
@@ -2089,6 +2165,9 @@ zipx_ppmd8_init(struct archive_read *a, struct zip *zip)
 	zip->ppmd8.Stream.In = &zip->zipx_ppmd_stream;
 	zip->zipx_ppmd_stream.a = a;
 	zip->zipx_ppmd_stream.Read = &ppmd_read;
+	zip->zipx_ppmd_window = NULL;
+	zip->zipx_ppmd_stream.Cur = NULL;
+	zip->zipx_ppmd_stream.Lim = NULL;
 
 	/* Reset number of read bytes to 0. */
 	zip->zipx_ppmd_read_compressed = 0;
@@ -2123,12 +2202,10 @@ zipx_ppmd8_init(struct archive_read *a, struct zip *zip)
 		return (ARCHIVE_FATAL);
 	}
 
-	/* Signal the cleanup function to release Ppmd8 context in the
-	 * cleanup phase. */
-	zip->ppmd8_valid = 1;
-
 	/* Perform further Ppmd8 initialization. */
-	if(!__archive_ppmd8_functions.Ppmd8_RangeDec_Init(&zip->ppmd8)) {
+	range_ok = __archive_ppmd8_functions.Ppmd8_RangeDec_Init(&zip->ppmd8);
+	ppmd_consume_window(a, zip);
+	if(!range_ok) {
 		archive_set_error(&a->archive, ARCHIVE_ERRNO_PROGRAMMER,
 		    "PPMd8 stream range decoder initialization error");
 		return (ARCHIVE_FATAL);
@@ -2214,18 +2291,13 @@ zip_read_data_zipx_ppmd(struct archive_read *a, const void **buff,
 		zip->uncompressed_buffer[consumed_bytes] = (uint8_t) sym;
 		++consumed_bytes;
 	} while(consumed_bytes < zip->uncompressed_buffer_size);
+	ppmd_consume_window(a, zip);
 
 	/* Update pointers so we can continue decompression in another call. */
 	zip->entry_bytes_remaining -= zip->zipx_ppmd_read_compressed;
 	zip->entry_compressed_bytes_read += zip->zipx_ppmd_read_compressed;
 	zip->entry_uncompressed_bytes_read += consumed_bytes;
 
-	/* If we're at the end of stream, deinitialize Ppmd8 context. */
-	if(zip->end_of_entry) {
-		__archive_ppmd8_functions.Ppmd8_Free(&zip->ppmd8);
-		zip->ppmd8_valid = 0;
-	}
-
 	/* Update pointers for libarchive. */
 	*buff = zip->uncompressed_buffer;
 	*size = consumed_bytes;
@@ -2605,7 +2677,7 @@ zip_read_data_deflate(struct archive_read *a, const void **buff,
 					    compressed_buff, buff_remaining,
 					    zip->decrypted_ptr
 					      + zip->decrypted_bytes_remaining,
-					    buff_remaining);
+					    buff_remaining, NULL);
 				} else {
 					size_t dsize = buff_remaining;
 					archive_decrypto_aes_ctr_update(
@@ -2930,7 +3002,9 @@ init_traditional_PKWARE_decryption(struct archive_read *a)
 		return (ARCHIVE_FATAL);
 	}
 
-	for (retry = 0;; retry++) {
+	/* archive_read_zip_find_passphrase() may already have checked
+	 * this header and left the keys in tctx. */
+	for (retry = 0; !zip->tctx_preset; retry++) {
 		const char *passphrase;
 		uint8_t crcchk;
 
@@ -2959,6 +3033,7 @@ init_traditional_PKWARE_decryption(struct archive_read *a)
 	}
 
 	__archive_read_consume(a, ENC_HEADER_SIZE);
+	zip->tctx_preset = 0;
 	zip->tctx_valid = 1;
 	if (0 == (zip->entry->zip_flags & ZIP_LENGTH_AT_END)) {
 	    zip->entry_bytes_remaining -= ENC_HEADER_SIZE;
@@ -2971,6 +3046,75 @@ init_traditional_PKWARE_decryption(struct archive_read *a)
 #undef ENC_HEADER_SIZE
 }
 
+/*
+ * Check a list of candidate passphrases against the encryption header
+ * of the current entry without consuming anything, so that callers
+ * can try many candidates without reopening the archive.  The keys of
+ * the first candidate that passes are kept and used when the entry's
+ * data is read.
+ */
+int
+archive_read_zip_find_passphrase(struct archive *_a,
+    const char * const *passphrases, int count)
+{
+	struct archive_read *a = (struct archive_read *)_a;
+	struct trad_enc_ctx tctx;
+	struct zip *zip;
+	const void *p;
+	int i;
+
+	archive_check_magic(_a, ARCHIVE_READ_MAGIC, ARCHIVE_STATE_DATA,
+	    "archive_read_zip_find_passphrase");
+
+	if (a->format == NULL || strcmp(a->format->name, "zip") != 0) {
+		archive_set_error(_a, ARCHIVE_ERRNO_MISC,
+		    "Not reading a zip archive");
+		return (ARCHIVE_FAILED);
+	}
+	zip = (struct zip *)(a->format->data);
+	if (zip->entry == NULL || !zip->init_decryption
+	    || (zip->entry->zip_flags & ZIP_STRONG_ENCRYPTED)
+	    || zip->entry->compression == WINZIP_AES_ENCRYPTION) {
+		archive_set_error(_a, ARCHIVE_ERRNO_MISC,
+		    "Entry is not encrypted with traditional PKWARE "
+		    "encryption, or its data has already been read");
+		return (ARCHIVE_FAILED);
+	}
+	if (0 == (zip->entry->zip_flags & ZIP_LENGTH_AT_END)
+	    && zip->entry_bytes_remaining < 12) {
+		archive_set_error(_a, ARCHIVE_ERRNO_FILE_FORMAT,
+		    "Truncated Zip encrypted body: only %jd bytes available",
+		    (intmax_t)zip->entry_bytes_remaining);
+		return (ARCHIVE_FATAL);
+	}
+
+	__archive_read_consume(a, zip->unconsumed);
+	zip->unconsumed = 0;
+	p = __archive_read_ahead(a, 12, NULL);
+	if (p == NULL) {
+		archive_set_error(_a, ARCHIVE_ERRNO_FILE_FORMAT,
+		    "Truncated ZIP file data");
+		return (ARCHIVE_FATAL);
+	}
+
+	zip->tctx_preset = 0;
+	for (i = 0; i < count; i++) {
+		uint8_t crcchk;
+
+		if (passphrases[i] == NULL)
+			continue;
+		if (trad_enc_init(&tctx, passphrases[i],
+		    strlen(passphrases[i]), p, 12, &crcchk) == 0
+		    && crcchk == zip->entry->decdat) {
+			zip->tctx = tctx;
+			zip->tctx_preset = 1;
+			return (i);
+		}
+	}
+	archive_set_error(_a, ARCHIVE_ERRNO_MISC, "Incorrect passphrase");
+	return (ARCHIVE_WARN);
+}
+
 static int
 init_WinZip_AES_decryption(struct archive_read *a)
 {
@@ -3104,6 +3248,7 @@ archive_read_format_zip_read_data(struct archive_read *a,
 		zip->init_decryption = 0;
 	}
 
+	zip->crc32_fused = 0;
 	switch(zip->entry->compression) {
 	case 0:  /* No compression. */
 		r =  zip_read_data_none(a, buff, size, offset);
@@ -3147,7 +3292,7 @@ archive_read_format_zip_read_data(struct archive_read *a,
 	}
 	if (r != ARCHIVE_OK)
 		return (r);
-	if (*size > 0) {
+	if (*size > 0 && !zip->crc32_fused) {
 		zip->computed_crc32 = zip->crc32func(zip->computed_crc32, *buff,
 						     (unsigned)*size);
 	}
@@ -3414,6 +3559,7 @@ archive_read_format_zip_streamable_read_header(struct archive_read *a,
 	if (zip->hctx_valid)
 		archive_hmac_sha1_cleanup(&zip->hctx);
 	zip->tctx_valid = zip->cctx_valid = zip->hctx_valid = 0;
+	zip->tctx_preset = 0;
 	__archive_read_reset_passphrase(a);
 
 	/* Search ahead for the next local file header. */
@@ -3430,37 +3576,46 @@ archive_read_format_zip_streamable_read_header(struct archive_read *a,
 		end = p + bytes;
 
 		while (p + 4 <= end) {
-			if (p[0] == 'P' && p[1] == 'K') {
-				if (p[2] == '\003' && p[3] == '\004') {
-					/* Regular file entry. */
-					__archive_read_consume(a, skipped);
-					return zip_read_local_file_header(a,
-					    entry, zip);
-				}
+			const char *q;
+
+			/* Jump to the next "PK" that has room for the
+			 * two bytes after it. */
+			q = __archive_read_find_signature(p, end - 2, "PK", 2);
+			if (q == NULL) {
+				skipped += (end - 3) - p;
+				break;
+			}
+			skipped += q - p;
+			p = q;
+			if (p[2] == '\003' && p[3] == '\004') {
+				/* Regular file entry. */
+				__archive_read_consume(a, skipped);
+				return zip_read_local_file_header(a,
+				    entry, zip);
+			}
 
-                              /*
-                               * TODO: We cannot restore permissions
-                               * based only on the local file headers.
-                               * Consider scanning the central
-                               * directory and returning additional
-                               * entries for at least directories.
-                               * This would allow us to properly set
-                               * directory permissions.
-			       *
-			       * This won't help us fix symlinks
-			       * and may not help with regular file
-			       * permissions, either.  <sigh>
-                               */
-                              if (p[2] == '\001' && p[3] == '\002') {
-                                      return (ARCHIVE_EOF);
-                              }
-
-                              /* End of central directory?  Must be an
-                               * empty archive. */
-                              if ((p[2] == '\005' && p[3] == '\006')
-                                  || (p[2] == '\006' && p[3] == '\006'))
-                                      return (ARCHIVE_EOF);
+			/*
+			 * TODO: We cannot restore permissions
+			 * based only on the local file headers.
+			 * Consider scanning the central
+			 * directory and returning additional
+			 * entries for at least directories.
+			 * This would allow us to properly set
+			 * directory permissions.
+			 *
+			 * This won't help us fix symlinks
+			 * and may not help with regular file
+			 * permissions, either.  <sigh>
+			 */
+			if (p[2] == '\001' && p[3] == '\002') {
+				return (ARCHIVE_EOF);
 			}
+
+			/* End of central directory?  Must be an
+			 * empty archive. */
+			if ((p[2] == '\005' && p[3] == '\006')
+			    || (p[2] == '\006' && p[3] == '\006'))
+				return (ARCHIVE_EOF);
 			++p;
 			++skipped;
 		}
@@ -3468,11 +3623,28 @@ archive_read_format_zip_streamable_read_header(struct archive_read *a,
 	}
 }
 
+/*
+ * A PK\007\010 found while skipping stored data may just be part of
+ * the data.  Accept it only if the compressed size it records, in
+ * either the 32-bit or the Zip64 layout, matches the number of bytes
+ * that precede it.  Unknown methods and encrypted entries, whose
+ * headers and trailers are counted separately, are not checked.
+ */
+static int
+descriptor_matches(struct zip *zip, const char *p, int64_t compressed)
+{
+	if (zip->entry->compression != 0
+	    || (zip->entry->zip_flags & (ZIP_ENCRYPTED | ZIP_STRONG_ENCRYPTED)))
+		return (1);
+	return (archive_le32dec(p + 8) == (uint32_t)compressed
+	    || archive_le64dec(p + 8) == (uint64_t)compressed);
+}
+
 static int
 archive_read_format_zip_read_data_skip_streamable(struct archive_read *a)
 {
 	struct zip *zip;
-	int64_t bytes_skipped;
+	int64_t bytes_skipped, skipped;
 
 	zip = (struct zip *)(a->format->data);
 	bytes_skipped = __archive_read_consume(a, zip->unconsumed);
@@ -3529,23 +3701,24 @@ archive_read_format_zip_read_data_skip_streamable(struct archive_read *a)
 #endif
 	default: /* Uncompressed or unknown. */
 		/* Scan for a PK\007\010 signature. */
+		skipped = zip->entry_compressed_bytes_read;
 		for (;;) {
-			const char *p, *buff;
+			const char *p, *buff, *end;
 			ssize_t bytes_avail;
-			buff = __archive_read_ahead(a, 16, &bytes_avail);
-			if (bytes_avail < 16) {
+			buff = __archive_read_ahead(a, 24, &bytes_avail);
+			if (bytes_avail < 24) {
 				archive_set_error(&a->archive,
 				    ARCHIVE_ERRNO_FILE_FORMAT,
 				    "Truncated ZIP file data");
 				return (ARCHIVE_FATAL);
 			}
+			/* Each candidate needs a full 24-byte descriptor. */
+			end = buff + bytes_avail - 20;
 			p = buff;
-			while (p <= buff + bytes_avail - 16) {
-				if (p[3] == 'P') { p += 3; }
-				else if (p[3] == 'K') { p += 2; }
-				else if (p[3] == '\007') { p += 1; }
-				else if (p[3] == '\010' && p[2] == '\007'
-				    && p[1] == 'K' && p[0] == 'P') {
+			while ((p = __archive_read_find_signature(p, end,
+			    "PK\007\010", 4)) != NULL) {
+				if (descriptor_matches(zip, p,
+				    skipped + (p - buff))) {
 					if (zip->entry->flags & LA_USED_ZIP64)
 						__archive_read_consume(a,
 						    p - buff + 24);
@@ -3553,9 +3726,12 @@ archive_read_format_zip_read_data_skip_streamable(struct archive_read *a)
 						__archive_read_consume(a,
 						    p - buff + 16);
 					return ARCHIVE_OK;
-				} else { p += 4; }
+				}
+				p++;
 			}
-			__archive_read_consume(a, p - buff);
+			/* Keep the bytes that could start a descriptor. */
+			__archive_read_consume(a, bytes_avail - 23);
+			skipped += bytes_avail - 23;
 		}
 	}
 }
@@ -4313,6 +4489,7 @@ archive_read_format_zip_seekable_read_header(struct archive_read *a,
 	if (zip->hctx_valid)
 		archive_hmac_sha1_cleanup(&zip->hctx);
 	zip->tctx_valid = zip->cctx_valid = zip->hctx_valid = 0;
+	zip->tctx_preset = 0;
 	__archive_read_reset_passphrase(a);
 
 	/* File entries are sorted by the header offset, we should mostly
@@ -0,0 +1,671 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "archive_platform.h"
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "archive_endian.h"
+#include "archive_sha1_private.h"
+#include "archive_thread_private.h"
+
+/*
+ * The compression function is picked on first use: the SHA extensions
+ * on x86, otherwise portable C.  __archive_sha1_multi()
+ * hashes independent messages side by side in SSE2 lanes when the
+ * SHA extensions are missing.
+ */
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SHA1_X4	1
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))
+#include <cpuid.h>
+#include <immintrin.h>
+#define SHA1_X86_NI	1
+#define SHA_NI_TARGET	__attribute__((target("sha,sse4.1,ssse3")))
+#elif (defined(_M_X64) || defined(_M_IX86)) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#define SHA1_X86_NI	1
+#define SHA_NI_TARGET
+#endif
+
+#define	MAX_LANES	4
+
+typedef void sha1_blocks_fn(uint32_t st[5], const uint8_t *, size_t);
+/* Hash one block for each lane. */
+typedef void sha1_lanes_fn(uint32_t (*st)[5], const uint8_t * const *);
+
+#define	ROL(x, n)	(((x) << (n)) | ((x) >> (32 - (n))))
+
+#define	K0	0x5a827999U
+#define	K1	0x6ed9eba1U
+#define	K2	0x8f1bbcdcU
+#define	K3	0xca62c1d6U
+
+static const uint32_t sha1_iv[5] = {
+	0x67452301U, 0xefcdab89U, 0x98badcfeU, 0x10325476U, 0xc3d2e1f0U
+};
+
+/* Schedule word i, kept in a ring of 16. */
+#define	W(i)	(w[(i) & 15] = ROL(w[((i) + 13) & 15] ^ w[((i) + 8) & 15] ^ \
+		    w[((i) + 2) & 15] ^ w[(i) & 15], 1))
+
+#define	STEP(f, k, wi) do {						\
+	uint32_t t = ROL(a, 5) + (f) + e + (k) + (wi);			\
+	e = d; d = c; c = ROL(b, 30); b = a; a = t;			\
+} while (0)
+
+/* Hash one block given as 16 big-endian words; w is overwritten. */
+static void
+sha1_block(uint32_t st[5], uint32_t w[16])
+{
+	uint32_t a = st[0], b = st[1], c = st[2], d = st[3], e = st[4];
+	int i;
+
+	for (i = 0; i < 16; i++)
+		STEP((b & c) | (~b & d), K0, w[i]);
+	for (; i < 20; i++)
+		STEP((b & c) | (~b & d), K0, W(i));
+	for (; i < 40; i++)
+		STEP(b ^ c ^ d, K1, W(i));
+	for (; i < 60; i++)
+		STEP((b & c) | (d & (b | c)), K2, W(i));
+	for (; i < 80; i++)
+		STEP(b ^ c ^ d, K3, W(i));
+	st[0] += a;
+	st[1] += b;
+	st[2] += c;
+	st[3] += d;
+	st[4] += e;
+}
+
+static void
+sha1_blocks_c(uint32_t st[5], const uint8_t *p, size_t n)
+{
+	uint32_t w[16];
+	int i;
+
+	while (n-- > 0) {
+		for (i = 0; i < 16; i++)
+			w[i] = archive_be32dec(p + 4 * i);
+		sha1_block(st, w);
+		p += 64;
+	}
+}
+
+static void
+sha1_lanes_c(uint32_t (*st)[5], const uint8_t * const *blk)
+{
+	sha1_blocks_c(st[0], blk[0], 1);
+}
+
+#ifdef SHA1_X86_NI
+
+static int
+sha_ni_available(void)
+{
+#if defined(_MSC_VER)
+	int info[4], c1;
+
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return (0);
+	__cpuid(info, 1);
+	c1 = info[2];
+	__cpuidex(info, 7, 0);
+	return ((c1 >> 9) & 1) && ((c1 >> 19) & 1) && ((info[1] >> 29) & 1);
+#else
+	unsigned int a, b, c, d, c1;
+
+	if (__get_cpuid_max(0, NULL) < 7)
+		return (0);
+	__cpuid(1, a, b, c1, d);
+	__cpuid_count(7, 0, a, b, c, d);
+	return ((c1 >> 9) & 1) && ((c1 >> 19) & 1) && ((b >> 29) & 1);
+#endif
+}
+
+/*
+ * Four rounds with function f; e is the E input of this group, built
+ * from the A value saved by the previous group.  Words 4g to 4g+3 of
+ * the schedule for g >= 4 replace words 4g-16 to 4g-13 in w[g & 3].
+ * The rounds instruction is the bottleneck, so unlike SHA-256 there
+ * is nothing to gain from interleaving two messages.
+ */
+#define	NI_W(g)	(w[(g) & 3] = _mm_sha1msg2_epu32(_mm_xor_si128(	\
+		    _mm_sha1msg1_epu32(w[(g) & 3], w[((g) + 1) & 3]),	\
+		    w[((g) + 2) & 3]), w[((g) + 3) & 3]))
+#define	NI_ROUNDS(g, f) do {						\
+	__m128i e = (g) == 0 ? _mm_add_epi32(e0, w[0]) :		\
+	    _mm_sha1nexte_epu32(esave, (g) >= 4 ? NI_W(g) : w[(g) & 3]); \
+	esave = abcd;							\
+	abcd = _mm_sha1rnds4_epu32(abcd, e, f);				\
+} while (0)
+
+SHA_NI_TARGET static void
+sha1_blocks_ni(uint32_t st[5], const uint8_t *p, size_t n)
+{
+	const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL,
+	    0x08090a0b0c0d0e0fULL);
+	__m128i abcd, e0, abcd0, esave, w[4];
+	int i;
+
+	abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)st), 0x1B);
+	e0 = _mm_set_epi32((int)st[4], 0, 0, 0);
+	esave = abcd;
+	while (n-- > 0) {
+		abcd0 = abcd;
+		for (i = 0; i < 4; i++)
+			w[i] = _mm_shuffle_epi8(_mm_loadu_si128(
+			    (const __m128i *)(p + 16 * i)), mask);
+		NI_ROUNDS(0, 0); NI_ROUNDS(1, 0); NI_ROUNDS(2, 0);
+		NI_ROUNDS(3, 0); NI_ROUNDS(4, 0); NI_ROUNDS(5, 1);
+		NI_ROUNDS(6, 1); NI_ROUNDS(7, 1); NI_ROUNDS(8, 1);
+		NI_ROUNDS(9, 1); NI_ROUNDS(10, 2); NI_ROUNDS(11, 2);
+		NI_ROUNDS(12, 2); NI_ROUNDS(13, 2); NI_ROUNDS(14, 2);
+		NI_ROUNDS(15, 3); NI_ROUNDS(16, 3); NI_ROUNDS(17, 3);
+		NI_ROUNDS(18, 3); NI_ROUNDS(19, 3);
+		e0 = _mm_sha1nexte_epu32(esave, e0);
+		abcd = _mm_add_epi32(abcd, abcd0);
+		p += 64;
+	}
+	_mm_storeu_si128((__m128i *)st, _mm_shuffle_epi32(abcd, 0x1B));
+	st[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
+
+#endif /* SHA1_X86_NI */
+
+#ifdef SHA1_X4
+static void sha1_lanes_x4(uint32_t (*)[5], const uint8_t * const *);
+#endif
+
+static sha1_blocks_fn *sha1_blocks_impl;
+static sha1_lanes_fn *sha1_lanes;
+static int sha1_nlanes;
+
+static archive_thread_once_t sha1_once = ARCHIVE_THREAD_ONCE_INIT;
+/* Set by __archive_sha1_force_portable(). */
+static int sha1_portable;
+
+static void
+sha1_select(void)
+{
+	sha1_blocks_fn *blocks = sha1_blocks_c;
+	sha1_lanes_fn *lanes = sha1_lanes_c;
+	int nlanes = 1;
+
+#ifdef SHA1_X4
+	lanes = sha1_lanes_x4;
+	nlanes = 4;
+#endif
+#ifdef SHA1_X86_NI
+	if (sha_ni_available()) {
+		blocks = sha1_blocks_ni;
+		lanes = sha1_lanes_c;
+		nlanes = 1;
+	}
+#endif
+	if (sha1_portable) {
+		blocks = sha1_blocks_c;
+		lanes = sha1_lanes_c;
+		nlanes = 1;
+	}
+	sha1_lanes = lanes;
+	sha1_nlanes = nlanes;
+	sha1_blocks_impl = blocks;
+}
+
+/*
+ * For the tests: use only the portable C code, or go back to picking
+ * the fastest.  Not safe while other threads are hashing.
+ */
+void
+__archive_sha1_force_portable(int portable)
+{
+	__archive_thread_once(&sha1_once, sha1_select);
+	sha1_portable = portable;
+	sha1_select();
+}
+
+static void
+sha1_blocks(uint32_t st[5], const uint8_t *p, size_t n)
+{
+	__archive_thread_once(&sha1_once, sha1_select);
+	sha1_blocks_impl(st, p, n);
+}
+
+void
+__archive_sha1_init(struct archive_sha1 *ctx)
+{
+	memcpy(ctx->state, sha1_iv, sizeof(ctx->state));
+	ctx->count = 0;
+}
+
+void
+__archive_sha1_update(struct archive_sha1 *ctx, const void *data, size_t len)
+{
+	const uint8_t *p = (const uint8_t *)data;
+	size_t used = (size_t)(ctx->count & 63);
+
+	ctx->count += len;
+	if (used > 0) {
+		size_t n = 64 - used;
+
+		if (len < n) {
+			memcpy(ctx->buf + used, p, len);
+			return;
+		}
+		memcpy(ctx->buf + used, p, n);
+		sha1_blocks(ctx->state, ctx->buf, 1);
+		p += n;
+		len -= n;
+	}
+	sha1_blocks(ctx->state, p, len / 64);
+	p += len & ~(size_t)63;
+	memcpy(ctx->buf, p, len & 63);
+}
+
+void
+__archive_sha1_final(struct archive_sha1 *ctx,
+    uint8_t digest[ARCHIVE_SHA1_DIGEST_SIZE])
+{
+	uint64_t bits = ctx->count * 8;
+	size_t used = (size_t)(ctx->count & 63);
+	int i;
+
+	ctx->buf[used++] = 0x80;
+	if (used > 56) {
+		memset(ctx->buf + used, 0, 64 - used);
+		sha1_blocks(ctx->state, ctx->buf, 1);
+		used = 0;
+	}
+	memset(ctx->buf + used, 0, 56 - used);
+	archive_be64enc(ctx->buf + 56, bits);
+	sha1_blocks(ctx->state, ctx->buf, 1);
+	for (i = 0; i < 5; i++)
+		archive_be32enc(digest + 4 * i, ctx->state[i]);
+	memset(ctx, 0, sizeof(*ctx));
+}
+
+int
+__archive_sha1_multi_lanes(void)
+{
+	__archive_thread_once(&sha1_once, sha1_select);
+	return (sha1_nlanes);
+}
+
+/*
+ * Each lane works through one message; when it finishes, the next
+ * message not yet started takes its place.  The padded tail of a
+ * message is copied aside, and a lane with nothing left to do hashes
+ * a dummy block.  The last message still running is finished with the
+ * single-message code.
+ */
+struct lane {
+	const uint8_t	*msg;
+	size_t		 pos, full, total;	/* In blocks. */
+	int		 index;
+	uint8_t		 tail[128];
+};
+
+static void
+lane_start(struct lane *ln, uint32_t st[5], int index, const void *msg,
+    size_t len)
+{
+	size_t rem = len & 63, tb = rem < 56 ? 1 : 2;
+
+	ln->msg = (const uint8_t *)msg;
+	ln->index = index;
+	ln->pos = 0;
+	ln->full = len / 64;
+	ln->total = ln->full + tb;
+	if (rem > 0)
+		memcpy(ln->tail, ln->msg + len - rem, rem);
+	ln->tail[rem] = 0x80;
+	memset(ln->tail + rem + 1, 0, 64 * tb - 8 - rem - 1);
+	archive_be64enc(ln->tail + 64 * tb - 8, (uint64_t)len * 8);
+	memcpy(st, sha1_iv, sizeof(sha1_iv));
+}
+
+static void
+lane_finish(struct lane *ln, uint32_t st[5],
+    uint8_t (*digests)[ARCHIVE_SHA1_DIGEST_SIZE])
+{
+	int i;
+
+	for (i = 0; i < 5; i++)
+		archive_be32enc(digests[ln->index] + 4 * i, st[i]);
+	ln->index = -1;
+}
+
+void
+__archive_sha1_multi(int n, const void * const *msgs, const size_t *lens,
+    uint8_t (*digests)[ARCHIVE_SHA1_DIGEST_SIZE])
+{
+	static const uint8_t idle[64];
+	struct lane ln[MAX_LANES];
+	uint32_t st[MAX_LANES][5];
+	const uint8_t *blk[MAX_LANES];
+	int next = 0, running = 0, nlanes, l;
+
+	nlanes = __archive_sha1_multi_lanes();
+	if (nlanes == 1) {
+		struct archive_sha1 ctx;
+
+		for (l = 0; l < n; l++) {
+			__archive_sha1_init(&ctx);
+			__archive_sha1_update(&ctx, msgs[l], lens[l]);
+			__archive_sha1_final(&ctx, digests[l]);
+		}
+		return;
+	}
+	for (l = 0; l < nlanes; l++) {
+		ln[l].index = -1;
+		if (next < n) {
+			lane_start(&ln[l], st[l], next, msgs[next],
+			    lens[next]);
+			next++;
+			running++;
+		}
+	}
+	while (running > 1 || (running == 1 && next < n)) {
+		for (l = 0; l < nlanes; l++) {
+			if (ln[l].index < 0)
+				blk[l] = idle;
+			else if (ln[l].pos < ln[l].full)
+				blk[l] = ln[l].msg + 64 * ln[l].pos;
+			else
+				blk[l] = ln[l].tail + 64 *
+				    (ln[l].pos - ln[l].full);
+		}
+		sha1_lanes(st, blk);
+		for (l = 0; l < nlanes; l++) {
+			if (ln[l].index < 0 || ++ln[l].pos < ln[l].total)
+				continue;
+			lane_finish(&ln[l], st[l], digests);
+			running--;
+			if (next < n) {
+				lane_start(&ln[l], st[l], next, msgs[next],
+				    lens[next]);
+				next++;
+				running++;
+			}
+		}
+	}
+	for (l = 0; l < nlanes; l++) {
+		if (ln[l].index < 0)
+			continue;
+		if (ln[l].pos < ln[l].full) {
+			sha1_blocks(st[l], ln[l].msg + 64 * ln[l].pos,
+			    ln[l].full - ln[l].pos);
+			ln[l].pos = ln[l].full;
+		}
+		sha1_blocks(st[l], ln[l].tail + 64 *
+		    (ln[l].pos - ln[l].full), ln[l].total - ln[l].pos);
+		lane_finish(&ln[l], st[l], digests);
+	}
+}
+
+/*
+ * PBKDF2-HMAC-SHA1.
+ *
+ * After the first, every iteration hashes one 20-byte value with the
+ * inner and outer HMAC keys, so both pads are hashed once up front and
+ * each iteration is exactly two compressions of a fixed-format block
+ * built straight from the previous state words.  Key blocks are
+ * independent of each other; with SSE2, four of them (enough for the
+ * 66 bytes WinZip AES-256 derives) run side by side in vector lanes.
+ */
+
+/* Fill in the padding for a 20-byte message after a 64-byte key block. */
+static void
+pad_words(uint32_t w[16])
+{
+	int i;
+
+	w[5] = 0x80000000U;
+	for (i = 6; i < 15; i++)
+		w[i] = 0;
+	w[15] = (64 + ARCHIVE_SHA1_DIGEST_SIZE) * 8;
+}
+
+static void
+pbkdf2_iterate(const uint32_t ist[5], const uint32_t ost[5],
+    uint32_t u[5], uint32_t t[5], unsigned rounds)
+{
+	uint32_t w[16], st[5];
+	unsigned r;
+	int i;
+
+	for (r = 1; r < rounds; r++) {
+		memcpy(w, u, 20);
+		pad_words(w);
+		memcpy(st, ist, 20);
+		sha1_block(st, w);
+		memcpy(w, st, 20);
+		pad_words(w);
+		memcpy(u, ost, 20);
+		sha1_block(u, w);
+		for (i = 0; i < 5; i++)
+			t[i] ^= u[i];
+	}
+}
+
+#ifdef SHA1_X4
+
+#define	VROL(x, n)	_mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - (n)))
+#define	VW(i)	(w[(i) & 15] = VROL(_mm_xor_si128(_mm_xor_si128(	\
+		    w[((i) + 13) & 15], w[((i) + 8) & 15]),		\
+		    _mm_xor_si128(w[((i) + 2) & 15], w[(i) & 15])), 1))
+#define	VSTEP(f, k, wi) do {						\
+	__m128i t = _mm_add_epi32(_mm_add_epi32(VROL(a, 5), (f)),	\
+	    _mm_add_epi32(_mm_add_epi32(e, (k)), (wi)));		\
+	e = d; d = c; c = VROL(b, 30); b = a; a = t;			\
+} while (0)
+#define	VCH	_mm_or_si128(_mm_and_si128(b, c), _mm_andnot_si128(b, d))
+#define	VPAR	_mm_xor_si128(_mm_xor_si128(b, c), d)
+#define	VMAJ	_mm_or_si128(_mm_and_si128(b, c), \
+		    _mm_and_si128(d, _mm_or_si128(b, c)))
+
+static void
+sha1_block_x4(__m128i st[5], __m128i w[16])
+{
+	__m128i a = st[0], b = st[1], c = st[2], d = st[3], e = st[4];
+	const __m128i k0 = _mm_set1_epi32((int)K0);
+	const __m128i k1 = _mm_set1_epi32((int)K1);
+	const __m128i k2 = _mm_set1_epi32((int)K2);
+	const __m128i k3 = _mm_set1_epi32((int)K3);
+	int i;
+
+	for (i = 0; i < 16; i++)
+		VSTEP(VCH, k0, w[i]);
+	for (; i < 20; i++)
+		VSTEP(VCH, k0, VW(i));
+	for (; i < 40; i++)
+		VSTEP(VPAR, k1, VW(i));
+	for (; i < 60; i++)
+		VSTEP(VMAJ, k2, VW(i));
+	for (; i < 80; i++)
+		VSTEP(VPAR, k3, VW(i));
+	st[0] = _mm_add_epi32(st[0], a);
+	st[1] = _mm_add_epi32(st[1], b);
+	st[2] = _mm_add_epi32(st[2], c);
+	st[3] = _mm_add_epi32(st[3], d);
+	st[4] = _mm_add_epi32(st[4], e);
+}
+
+static void
+sha1_lanes_x4(uint32_t (*st)[5], const uint8_t * const *blk)
+{
+	__m128i s[5], w[16];
+	uint32_t lanes[4];
+	int i, l;
+
+	for (i = 0; i < 5; i++)
+		s[i] = _mm_setr_epi32((int)st[0][i], (int)st[1][i],
+		    (int)st[2][i], (int)st[3][i]);
+	for (i = 0; i < 16; i++)
+		w[i] = _mm_setr_epi32((int)archive_be32dec(blk[0] + 4 * i),
+		    (int)archive_be32dec(blk[1] + 4 * i),
+		    (int)archive_be32dec(blk[2] + 4 * i),
+		    (int)archive_be32dec(blk[3] + 4 * i));
+	sha1_block_x4(s, w);
+	for (i = 0; i < 5; i++) {
+		_mm_storeu_si128((__m128i *)lanes, s[i]);
+		for (l = 0; l < 4; l++)
+			st[l][i] = lanes[l];
+	}
+}
+
+static void
+vpad_words(__m128i w[16])
+{
+	int i;
+
+	w[5] = _mm_set1_epi32((int)0x80000000U);
+	for (i = 6; i < 15; i++)
+		w[i] = _mm_setzero_si128();
+	w[15] = _mm_set1_epi32((64 + ARCHIVE_SHA1_DIGEST_SIZE) * 8);
+}
+
+/* pbkdf2_iterate() for four key blocks at once; lane l is block l. */
+static void
+pbkdf2_iterate_x4(const uint32_t ist[5], const uint32_t ost[5],
+    uint32_t u[4][5], uint32_t t[4][5], unsigned rounds)
+{
+	__m128i vi[5], vo[5], vu[5], vt[5], w[16], st[5];
+	uint32_t lanes[4];
+	unsigned r;
+	int i, l;
+
+	for (i = 0; i < 5; i++) {
+		vi[i] = _mm_set1_epi32((int)ist[i]);
+		vo[i] = _mm_set1_epi32((int)ost[i]);
+		vu[i] = _mm_setr_epi32((int)u[0][i], (int)u[1][i],
+		    (int)u[2][i], (int)u[3][i]);
+		vt[i] = vu[i];
+	}
+	for (r = 1; r < rounds; r++) {
+		memcpy(w, vu, sizeof(vu));
+		vpad_words(w);
+		memcpy(st, vi, sizeof(st));
+		sha1_block_x4(st, w);
+		memcpy(w, st, sizeof(st));
+		vpad_words(w);
+		memcpy(vu, vo, sizeof(vu));
+		sha1_block_x4(vu, w);
+		for (i = 0; i < 5; i++)
+			vt[i] = _mm_xor_si128(vt[i], vu[i]);
+	}
+	for (i = 0; i < 5; i++) {
+		_mm_storeu_si128((__m128i *)lanes, vt[i]);
+		for (l = 0; l < 4; l++)
+			t[l][i] = lanes[l];
+	}
+}
+
+#endif /* SHA1_X4 */
+
+int
+__archive_pbkdf2_sha1(const char *pw, size_t pw_len, const uint8_t *salt,
+    size_t salt_len, unsigned rounds, uint8_t *derived_key,
+    size_t derived_key_len)
+{
+	struct archive_sha1 ctx;
+	uint8_t key[64], pad[64], md[ARCHIVE_SHA1_DIGEST_SIZE], be[4];
+	uint32_t ist[5], ost[5], u[4][5], t[4][5];
+	size_t blocks, done, n, l, len;
+	int i;
+
+	memset(key, 0, sizeof(key));
+	if (pw_len > sizeof(key)) {
+		__archive_sha1_init(&ctx);
+		__archive_sha1_update(&ctx, pw, pw_len);
+		__archive_sha1_final(&ctx, key);
+	} else
+		memcpy(key, pw, pw_len);
+	for (i = 0; i < 64; i++)
+		pad[i] = key[i] ^ 0x36;
+	memcpy(ist, sha1_iv, sizeof(ist));
+	sha1_blocks(ist, pad, 1);
+	for (i = 0; i < 64; i++)
+		pad[i] = key[i] ^ 0x5c;
+	memcpy(ost, sha1_iv, sizeof(ost));
+	sha1_blocks(ost, pad, 1);
+
+	blocks = (derived_key_len + ARCHIVE_SHA1_DIGEST_SIZE - 1) /
+	    ARCHIVE_SHA1_DIGEST_SIZE;
+	for (done = 0; done < blocks; done += n) {
+		n = blocks - done < 4 ? blocks - done : 4;
+		/* U1 = HMAC(password, salt || INT(block number)). */
+		for (l = 0; l < n; l++) {
+			archive_be32enc(be, (uint32_t)(done + l + 1));
+			memcpy(ctx.state, ist, sizeof(ist));
+			ctx.count = 64;
+			__archive_sha1_update(&ctx, salt, salt_len);
+			__archive_sha1_update(&ctx, be, 4);
+			__archive_sha1_final(&ctx, md);
+			memcpy(ctx.state, ost, sizeof(ost));
+			ctx.count = 64;
+			__archive_sha1_update(&ctx, md, sizeof(md));
+			__archive_sha1_final(&ctx, md);
+			for (i = 0; i < 5; i++)
+				u[l][i] = t[l][i] = archive_be32dec(md + 4 * i);
+		}
+#ifdef SHA1_X4
+		if (n > 1 && !sha1_portable) {
+			for (l = n; l < 4; l++)
+				memcpy(u[l], u[0], sizeof(u[l]));
+			pbkdf2_iterate_x4(ist, ost, u, t, rounds);
+		} else
+#endif
+		for (l = 0; l < n; l++)
+			pbkdf2_iterate(ist, ost, u[l], t[l], rounds);
+		for (l = 0; l < n; l++) {
+			for (i = 0; i < 5; i++)
+				archive_be32enc(md + 4 * i, t[l][i]);
+			len = derived_key_len - (done + l) *
+			    ARCHIVE_SHA1_DIGEST_SIZE;
+			if (len > sizeof(md))
+				len = sizeof(md);
+			memcpy(derived_key + (done + l) *
+			    ARCHIVE_SHA1_DIGEST_SIZE, md, len);
+		}
+	}
+	memset(key, 0, sizeof(key));
+	memset(pad, 0, sizeof(pad));
+	memset(md, 0, sizeof(md));
+	memset(u, 0, sizeof(u));
+	memset(t, 0, sizeof(t));
+	return (0);
+}
@@ -0,0 +1,560 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "archive_platform.h"
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "archive_endian.h"
+#include "archive_sha256_private.h"
+#include "archive_thread_private.h"
+
+/*
+ * SHA-256 for the built-in digest backend.
+ *
+ * The compression function is picked on first use: the SHA extensions
+ * on x86, otherwise portable C.  __archive_sha256_multi()
+ * hashes independent messages side by side, eight at a time in AVX2
+ * lanes or four in SSE2 lanes; with the SHA extensions it interleaves
+ * two messages, whose rounds overlap in the pipeline where those of a
+ * single message have to wait for each other.
+ */
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))
+#include <cpuid.h>
+#include <immintrin.h>
+#define SHA256_X86	1
+#define SHA_NI_TARGET	__attribute__((target("sha,sse4.1,ssse3")))
+#define AVX2_TARGET	__attribute__((target("avx2")))
+#elif (defined(_M_X64) || defined(_M_IX86)) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#define SHA256_X86	1
+#define SHA_NI_TARGET
+#define AVX2_TARGET
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SHA256_X4	1
+#endif
+
+#define	MAX_LANES	8
+
+typedef void sha256_blocks_fn(uint32_t st[8], const uint8_t *, size_t);
+/* Hash one block for each lane. */
+typedef void sha256_lanes_fn(uint32_t (*st)[8], const uint8_t * const *);
+
+static const uint32_t sha256_iv[8] = {
+	0x6a09e667U, 0xbb67ae85U, 0x3c6ef372U, 0xa54ff53aU,
+	0x510e527fU, 0x9b05688cU, 0x1f83d9abU, 0x5be0cd19U
+};
+
+static const uint32_t K[64] = {
+	0x428a2f98U, 0x71374491U, 0xb5c0fbcfU, 0xe9b5dba5U,
+	0x3956c25bU, 0x59f111f1U, 0x923f82a4U, 0xab1c5ed5U,
+	0xd807aa98U, 0x12835b01U, 0x243185beU, 0x550c7dc3U,
+	0x72be5d74U, 0x80deb1feU, 0x9bdc06a7U, 0xc19bf174U,
+	0xe49b69c1U, 0xefbe4786U, 0x0fc19dc6U, 0x240ca1ccU,
+	0x2de92c6fU, 0x4a7484aaU, 0x5cb0a9dcU, 0x76f988daU,
+	0x983e5152U, 0xa831c66dU, 0xb00327c8U, 0xbf597fc7U,
+	0xc6e00bf3U, 0xd5a79147U, 0x06ca6351U, 0x14292967U,
+	0x27b70a85U, 0x2e1b2138U, 0x4d2c6dfcU, 0x53380d13U,
+	0x650a7354U, 0x766a0abbU, 0x81c2c92eU, 0x92722c85U,
+	0xa2bfe8a1U, 0xa81a664bU, 0xc24b8b70U, 0xc76c51a3U,
+	0xd192e819U, 0xd6990624U, 0xf40e3585U, 0x106aa070U,
+	0x19a4c116U, 0x1e376c08U, 0x2748774cU, 0x34b0bcb5U,
+	0x391c0cb3U, 0x4ed8aa4aU, 0x5b9cca4fU, 0x682e6ff3U,
+	0x748f82eeU, 0x78a5636fU, 0x84c87814U, 0x8cc70208U,
+	0x90befffaU, 0xa4506cebU, 0xbef9a3f7U, 0xc67178f2U
+};
+
+#define	ROR(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+#define	BSIG0(x)	(ROR(x, 2) ^ ROR(x, 13) ^ ROR(x, 22))
+#define	BSIG1(x)	(ROR(x, 6) ^ ROR(x, 11) ^ ROR(x, 25))
+#define	SSIG0(x)	(ROR(x, 7) ^ ROR(x, 18) ^ ((x) >> 3))
+#define	SSIG1(x)	(ROR(x, 17) ^ ROR(x, 19) ^ ((x) >> 10))
+#define	CH(x, y, z)	((z) ^ ((x) & ((y) ^ (z))))
+#define	MAJ(x, y, z)	(((x) & (y)) | ((z) & ((x) | (y))))
+
+static void
+sha256_blocks_c(uint32_t st[8], const uint8_t *p, size_t n)
+{
+	uint32_t w[16], a, b, c, d, e, f, g, h, t1, t2;
+	int i;
+
+	while (n-- > 0) {
+		for (i = 0; i < 16; i++)
+			w[i] = archive_be32dec(p + 4 * i);
+		a = st[0]; b = st[1]; c = st[2]; d = st[3];
+		e = st[4]; f = st[5]; g = st[6]; h = st[7];
+		for (i = 0; i < 64; i++) {
+			if (i >= 16)
+				w[i & 15] += SSIG1(w[(i - 2) & 15]) +
+				    w[(i - 7) & 15] + SSIG0(w[(i - 15) & 15]);
+			t1 = h + BSIG1(e) + CH(e, f, g) + K[i] + w[i & 15];
+			t2 = BSIG0(a) + MAJ(a, b, c);
+			h = g; g = f; f = e; e = d + t1;
+			d = c; c = b; b = a; a = t1 + t2;
+		}
+		st[0] += a; st[1] += b; st[2] += c; st[3] += d;
+		st[4] += e; st[5] += f; st[6] += g; st[7] += h;
+		p += 64;
+	}
+}
+
+static void
+sha256_lanes_c(uint32_t (*st)[8], const uint8_t * const *blk)
+{
+	sha256_blocks_c(st[0], blk[0], 1);
+}
+
+#ifdef SHA256_X4
+
+#define	V4ROR(x, n)	_mm_or_si128(_mm_srli_epi32(x, n), _mm_slli_epi32(x, 32 - (n)))
+#define	V4XOR3(x, y, z)	_mm_xor_si128(_mm_xor_si128(x, y), z)
+#define	V4ADD3(x, y, z)	_mm_add_epi32(_mm_add_epi32(x, y), z)
+
+static void
+sha256_lanes_x4(uint32_t (*st)[8], const uint8_t * const *blk)
+{
+	__m128i s[8], w[16], a, b, c, d, e, f, g, h, t1, t2;
+	uint32_t out[4];
+	int i, l;
+
+	for (i = 0; i < 8; i++)
+		s[i] = _mm_setr_epi32((int)st[0][i], (int)st[1][i],
+		    (int)st[2][i], (int)st[3][i]);
+	for (i = 0; i < 16; i++)
+		w[i] = _mm_setr_epi32((int)archive_be32dec(blk[0] + 4 * i),
+		    (int)archive_be32dec(blk[1] + 4 * i),
+		    (int)archive_be32dec(blk[2] + 4 * i),
+		    (int)archive_be32dec(blk[3] + 4 * i));
+	a = s[0]; b = s[1]; c = s[2]; d = s[3];
+	e = s[4]; f = s[5]; g = s[6]; h = s[7];
+	for (i = 0; i < 64; i++) {
+		if (i >= 16) {
+			__m128i x = w[(i - 15) & 15], y = w[(i - 2) & 15];
+
+			w[i & 15] = _mm_add_epi32(V4ADD3(w[i & 15],
+			    w[(i - 7) & 15], V4XOR3(V4ROR(x, 7), V4ROR(x, 18),
+			    _mm_srli_epi32(x, 3))), V4XOR3(V4ROR(y, 17),
+			    V4ROR(y, 19), _mm_srli_epi32(y, 10)));
+		}
+		t1 = V4ADD3(h, V4XOR3(V4ROR(e, 6), V4ROR(e, 11), V4ROR(e, 25)),
+		    _mm_xor_si128(g, _mm_and_si128(e, _mm_xor_si128(f, g))));
+		t1 = V4ADD3(t1, _mm_set1_epi32((int)K[i]), w[i & 15]);
+		t2 = _mm_add_epi32(V4XOR3(V4ROR(a, 2), V4ROR(a, 13),
+		    V4ROR(a, 22)), _mm_or_si128(_mm_and_si128(a, b),
+		    _mm_and_si128(c, _mm_or_si128(a, b))));
+		h = g; g = f; f = e; e = _mm_add_epi32(d, t1);
+		d = c; c = b; b = a; a = _mm_add_epi32(t1, t2);
+	}
+	s[0] = _mm_add_epi32(s[0], a); s[1] = _mm_add_epi32(s[1], b);
+	s[2] = _mm_add_epi32(s[2], c); s[3] = _mm_add_epi32(s[3], d);
+	s[4] = _mm_add_epi32(s[4], e); s[5] = _mm_add_epi32(s[5], f);
+	s[6] = _mm_add_epi32(s[6], g); s[7] = _mm_add_epi32(s[7], h);
+	for (i = 0; i < 8; i++) {
+		_mm_storeu_si128((__m128i *)out, s[i]);
+		for (l = 0; l < 4; l++)
+			st[l][i] = out[l];
+	}
+}
+
+#endif /* SHA256_X4 */
+
+#ifdef SHA256_X86
+
+/* Bit 0: SHA extensions, bit 1: AVX2. */
+static int
+x86_features(void)
+{
+	int r = 0;
+#if defined(_MSC_VER)
+	int info[4], c1;
+
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return (0);
+	__cpuid(info, 1);
+	c1 = info[2];
+	if (!((c1 >> 9) & 1) || !((c1 >> 19) & 1))
+		return (0);
+	__cpuidex(info, 7, 0);
+	if ((info[1] >> 29) & 1)
+		r |= 1;
+	if (((info[1] >> 5) & 1) && ((c1 >> 27) & 1) && ((c1 >> 28) & 1) &&
+	    (_xgetbv(0) & 6) == 6)
+		r |= 2;
+#else
+	unsigned int a, b, c, d, c1, xcr0_lo, xcr0_hi;
+
+	if (__get_cpuid_max(0, NULL) < 7)
+		return (0);
+	__cpuid(1, a, b, c1, d);
+	if (!((c1 >> 9) & 1) || !((c1 >> 19) & 1))
+		return (0);
+	__cpuid_count(7, 0, a, b, c, d);
+	if ((b >> 29) & 1)
+		r |= 1;
+	if (((b >> 5) & 1) && ((c1 >> 27) & 1) && ((c1 >> 28) & 1)) {
+		__asm__ __volatile__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi)
+		    : "c"(0));
+		if ((xcr0_lo & 6) == 6)
+			r |= 2;
+	}
+#endif
+	return (r);
+}
+
+SHA_NI_TARGET static void
+sha256_blocks_ni(uint32_t st[8], const uint8_t *p, size_t n)
+{
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+	    0x0405060700010203ULL);
+	__m128i s0, s1, t, m0, m1, m2, m3, msg, abef, cdgh;
+	int i;
+
+	t = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&st[0]), 0xB1);
+	s1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&st[4]), 0x1B);
+	s0 = _mm_alignr_epi8(t, s1, 8);		/* ABEF */
+	s1 = _mm_blend_epi16(s1, t, 0xF0);	/* CDGH */
+
+	while (n-- > 0) {
+		abef = s0;
+		cdgh = s1;
+		m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)p), mask);
+		m1 = _mm_shuffle_epi8(
+		    _mm_loadu_si128((const __m128i *)(p + 16)), mask);
+		m2 = _mm_shuffle_epi8(
+		    _mm_loadu_si128((const __m128i *)(p + 32)), mask);
+		m3 = _mm_shuffle_epi8(
+		    _mm_loadu_si128((const __m128i *)(p + 48)), mask);
+		for (i = 0; i < 16; i++) {
+			msg = _mm_add_epi32(m0,
+			    _mm_loadu_si128((const __m128i *)&K[4 * i]));
+			s1 = _mm_sha256rnds2_epu32(s1, s0, msg);
+			s0 = _mm_sha256rnds2_epu32(s0, s1,
+			    _mm_shuffle_epi32(msg, 0x0E));
+			/* Words 4i+16 to 4i+19 replace words 4i to 4i+3. */
+			t = _mm_add_epi32(_mm_sha256msg1_epu32(m0, m1),
+			    _mm_alignr_epi8(m3, m2, 4));
+			t = _mm_sha256msg2_epu32(t, m3);
+			m0 = m1; m1 = m2; m2 = m3; m3 = t;
+		}
+		s0 = _mm_add_epi32(s0, abef);
+		s1 = _mm_add_epi32(s1, cdgh);
+		p += 64;
+	}
+
+	t = _mm_shuffle_epi32(s0, 0x1B);	/* FEBA */
+	s1 = _mm_shuffle_epi32(s1, 0xB1);	/* DCHG */
+	_mm_storeu_si128((__m128i *)&st[0], _mm_blend_epi16(t, s1, 0xF0));
+	_mm_storeu_si128((__m128i *)&st[4], _mm_alignr_epi8(s1, t, 8));
+}
+
+SHA_NI_TARGET static void
+sha256_lanes_ni(uint32_t (*st)[8], const uint8_t * const *blk)
+{
+	sha256_blocks_ni(st[0], blk[0], 1);
+	sha256_blocks_ni(st[1], blk[1], 1);
+}
+
+#define	V8ROR(x, n)	_mm256_or_si256(_mm256_srli_epi32(x, n), \
+			    _mm256_slli_epi32(x, 32 - (n)))
+#define	V8XOR3(x, y, z)	_mm256_xor_si256(_mm256_xor_si256(x, y), z)
+#define	V8ADD3(x, y, z)	_mm256_add_epi32(_mm256_add_epi32(x, y), z)
+
+AVX2_TARGET static void
+sha256_lanes_x8(uint32_t (*st)[8], const uint8_t * const *blk)
+{
+	__m256i s[8], w[16], a, b, c, d, e, f, g, h, t1, t2;
+	uint32_t out[8];
+	int i, l;
+
+	for (i = 0; i < 8; i++)
+		s[i] = _mm256_setr_epi32((int)st[0][i], (int)st[1][i],
+		    (int)st[2][i], (int)st[3][i], (int)st[4][i],
+		    (int)st[5][i], (int)st[6][i], (int)st[7][i]);
+	for (i = 0; i < 16; i++) {
+		for (l = 0; l < 8; l++)
+			out[l] = archive_be32dec(blk[l] + 4 * i);
+		w[i] = _mm256_loadu_si256((const __m256i *)out);
+	}
+	a = s[0]; b = s[1]; c = s[2]; d = s[3];
+	e = s[4]; f = s[5]; g = s[6]; h = s[7];
+	for (i = 0; i < 64; i++) {
+		if (i >= 16) {
+			__m256i x = w[(i - 15) & 15], y = w[(i - 2) & 15];
+
+			w[i & 15] = _mm256_add_epi32(V8ADD3(w[i & 15],
+			    w[(i - 7) & 15], V8XOR3(V8ROR(x, 7), V8ROR(x, 18),
+			    _mm256_srli_epi32(x, 3))), V8XOR3(V8ROR(y, 17),
+			    V8ROR(y, 19), _mm256_srli_epi32(y, 10)));
+		}
+		t1 = V8ADD3(h, V8XOR3(V8ROR(e, 6), V8ROR(e, 11), V8ROR(e, 25)),
+		    _mm256_xor_si256(g,
+		    _mm256_and_si256(e, _mm256_xor_si256(f, g))));
+		t1 = V8ADD3(t1, _mm256_set1_epi32((int)K[i]), w[i & 15]);
+		t2 = _mm256_add_epi32(V8XOR3(V8ROR(a, 2), V8ROR(a, 13),
+		    V8ROR(a, 22)), _mm256_or_si256(_mm256_and_si256(a, b),
+		    _mm256_and_si256(c, _mm256_or_si256(a, b))));
+		h = g; g = f; f = e; e = _mm256_add_epi32(d, t1);
+		d = c; c = b; b = a; a = _mm256_add_epi32(t1, t2);
+	}
+	s[0] = _mm256_add_epi32(s[0], a); s[1] = _mm256_add_epi32(s[1], b);
+	s[2] = _mm256_add_epi32(s[2], c); s[3] = _mm256_add_epi32(s[3], d);
+	s[4] = _mm256_add_epi32(s[4], e); s[5] = _mm256_add_epi32(s[5], f);
+	s[6] = _mm256_add_epi32(s[6], g); s[7] = _mm256_add_epi32(s[7], h);
+	for (i = 0; i < 8; i++) {
+		_mm256_storeu_si256((__m256i *)out, s[i]);
+		for (l = 0; l < 8; l++)
+			st[l][i] = out[l];
+	}
+}
+
+#endif /* SHA256_X86 */
+
+static sha256_blocks_fn *sha256_blocks;
+static sha256_lanes_fn *sha256_lanes;
+static int sha256_nlanes;
+
+static archive_thread_once_t sha256_once = ARCHIVE_THREAD_ONCE_INIT;
+
+static void
+sha256_select(void)
+{
+	sha256_blocks_fn *blocks = sha256_blocks_c;
+	sha256_lanes_fn *lanes = sha256_lanes_c;
+	int nlanes = 1;
+
+#ifdef SHA256_X4
+	lanes = sha256_lanes_x4;
+	nlanes = 4;
+#endif
+#ifdef SHA256_X86
+	{
+		int features = x86_features();
+
+		if (features & 2) {
+			lanes = sha256_lanes_x8;
+			nlanes = 8;
+		}
+		if (features & 1) {
+			blocks = sha256_blocks_ni;
+			lanes = sha256_lanes_ni;
+			nlanes = 2;
+		}
+	}
+#endif
+	sha256_lanes = lanes;
+	sha256_nlanes = nlanes;
+	sha256_blocks = blocks;
+}
+
+static void
+sha256_blocks_any(uint32_t st[8], const uint8_t *p, size_t n)
+{
+	__archive_thread_once(&sha256_once, sha256_select);
+	sha256_blocks(st, p, n);
+}
+
+void
+__archive_sha256_init(struct archive_sha256 *ctx)
+{
+	memcpy(ctx->state, sha256_iv, sizeof(ctx->state));
+	ctx->count = 0;
+}
+
+void
+__archive_sha256_update(struct archive_sha256 *ctx, const void *data,
+    size_t len)
+{
+	const uint8_t *p = (const uint8_t *)data;
+	size_t used = (size_t)(ctx->count & 63);
+
+	ctx->count += len;
+	if (used > 0) {
+		size_t n = 64 - used;
+
+		if (len < n) {
+			memcpy(ctx->buf + used, p, len);
+			return;
+		}
+		memcpy(ctx->buf + used, p, n);
+		sha256_blocks_any(ctx->state, ctx->buf, 1);
+		p += n;
+		len -= n;
+	}
+	if (len >= 64)
+		sha256_blocks_any(ctx->state, p, len / 64);
+	p += len & ~(size_t)63;
+	memcpy(ctx->buf, p, len & 63);
+}
+
+void
+__archive_sha256_final(struct archive_sha256 *ctx,
+    uint8_t digest[ARCHIVE_SHA256_DIGEST_SIZE])
+{
+	uint64_t bits = ctx->count * 8;
+	size_t used = (size_t)(ctx->count & 63);
+	int i;
+
+	ctx->buf[used++] = 0x80;
+	if (used > 56) {
+		memset(ctx->buf + used, 0, 64 - used);
+		sha256_blocks_any(ctx->state, ctx->buf, 1);
+		used = 0;
+	}
+	memset(ctx->buf + used, 0, 56 - used);
+	archive_be64enc(ctx->buf + 56, bits);
+	sha256_blocks_any(ctx->state, ctx->buf, 1);
+	for (i = 0; i < 8; i++)
+		archive_be32enc(digest + 4 * i, ctx->state[i]);
+	memset(ctx, 0, sizeof(*ctx));
+}
+
+int
+__archive_sha256_multi_lanes(void)
+{
+	__archive_thread_once(&sha256_once, sha256_select);
+	return (sha256_nlanes);
+}
+
+/*
+ * Each lane works through one message; when it finishes, the next
+ * message not yet started takes its place.  The padded tail of a
+ * message is copied aside, and a lane with nothing left to do hashes
+ * a dummy block.  The last message still running is finished with the
+ * single-message code.
+ */
+struct lane {
+	const uint8_t	*msg;
+	size_t		 pos, full, total;	/* In blocks. */
+	int		 index;
+	uint8_t		 tail[128];
+};
+
+static void
+lane_start(struct lane *ln, uint32_t st[8], int index, const void *msg,
+    size_t len)
+{
+	size_t rem = len & 63, tb = rem < 56 ? 1 : 2;
+
+	ln->msg = (const uint8_t *)msg;
+	ln->index = index;
+	ln->pos = 0;
+	ln->full = len / 64;
+	ln->total = ln->full + tb;
+	if (rem > 0)
+		memcpy(ln->tail, ln->msg + len - rem, rem);
+	ln->tail[rem] = 0x80;
+	memset(ln->tail + rem + 1, 0, 64 * tb - 8 - rem - 1);
+	archive_be64enc(ln->tail + 64 * tb - 8, (uint64_t)len * 8);
+	memcpy(st, sha256_iv, sizeof(sha256_iv));
+}
+
+static void
+lane_finish(struct lane *ln, uint32_t st[8],
+    uint8_t (*digests)[ARCHIVE_SHA256_DIGEST_SIZE])
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+		archive_be32enc(digests[ln->index] + 4 * i, st[i]);
+	ln->index = -1;
+}
+
+void
+__archive_sha256_multi(int n, const void * const *msgs, const size_t *lens,
+    uint8_t (*digests)[ARCHIVE_SHA256_DIGEST_SIZE])
+{
+	static const uint8_t idle[64];
+	struct lane ln[MAX_LANES];
+	uint32_t st[MAX_LANES][8];
+	const uint8_t *blk[MAX_LANES];
+	int next = 0, running = 0, nlanes, l;
+
+	nlanes = __archive_sha256_multi_lanes();
+	if (nlanes == 1) {
+		struct archive_sha256 ctx;
+
+		for (l = 0; l < n; l++) {
+			__archive_sha256_init(&ctx);
+			__archive_sha256_update(&ctx, msgs[l], lens[l]);
+			__archive_sha256_final(&ctx, digests[l]);
+		}
+		return;
+	}
+	for (l = 0; l < nlanes; l++) {
+		ln[l].index = -1;
+		if (next < n) {
+			lane_start(&ln[l], st[l], next, msgs[next],
+			    lens[next]);
+			next++;
+			running++;
+		}
+	}
+	while (running > 1 || (running == 1 && next < n)) {
+		for (l = 0; l < nlanes; l++) {
+			if (ln[l].index < 0)
+				blk[l] = idle;
+			else if (ln[l].pos < ln[l].full)
+				blk[l] = ln[l].msg + 64 * ln[l].pos;
+			else
+				blk[l] = ln[l].tail + 64 *
+				    (ln[l].pos - ln[l].full);
+		}
+		sha256_lanes(st, blk);
+		for (l = 0; l < nlanes; l++) {
+			if (ln[l].index < 0 || ++ln[l].pos < ln[l].total)
+				continue;
+			lane_finish(&ln[l], st[l], digests);
+			running--;
+			if (next < n) {
+				lane_start(&ln[l], st[l], next, msgs[next],
+				    lens[next]);
+				next++;
+				running++;
+			}
+		}
+	}
+	for (l = 0; l < nlanes; l++) {
+		if (ln[l].index < 0)
+			continue;
+		if (ln[l].pos < ln[l].full) {
+			sha256_blocks(st[l], ln[l].msg + 64 * ln[l].pos,
+			    ln[l].full - ln[l].pos);
+			ln[l].pos = ln[l].full;
+		}
+		sha256_blocks(st[l], ln[l].tail + 64 *
+		    (ln[l].pos - ln[l].full), ln[l].total - ln[l].pos);
+		lane_finish(&ln[l], st[l], digests);
+	}
+}
@@ -0,0 +1,60 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ARCHIVE_SHA256_PRIVATE_H_INCLUDED
+#define ARCHIVE_SHA256_PRIVATE_H_INCLUDED
+
+#ifndef __LIBARCHIVE_BUILD
+#error This header is only to be used internally to libarchive.
+#endif
+
+/*
+ * Built-in SHA-256, used by archive_digest.c when no crypto library
+ * provides one.
+ */
+
+#define ARCHIVE_SHA256_DIGEST_SIZE	32
+
+struct archive_sha256 {
+	uint32_t	state[8];
+	uint64_t	count;		/* Bytes hashed so far. */
+	uint8_t		buf[64];
+};
+
+void	__archive_sha256_init(struct archive_sha256 *);
+void	__archive_sha256_update(struct archive_sha256 *, const void *, size_t);
+void	__archive_sha256_final(struct archive_sha256 *,
+	    uint8_t digest[ARCHIVE_SHA256_DIGEST_SIZE]);
+
+/*
+ * Hash n complete, independent messages.  Up to
+ * __archive_sha256_multi_lanes() of them are hashed side by side;
+ * when that is 1, hashing them one after another is just as fast.
+ */
+int	__archive_sha256_multi_lanes(void);
+void	__archive_sha256_multi(int n, const void * const *msgs,
+	    const size_t *lens, uint8_t (*digests)[ARCHIVE_SHA256_DIGEST_SIZE]);
+
+#endif /* !ARCHIVE_SHA256_PRIVATE_H_INCLUDED */
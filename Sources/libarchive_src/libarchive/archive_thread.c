@@ -0,0 +1,479 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "archive_platform.h"
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if defined(_WIN32) && !defined(__CYGWIN__)
+#include <windows.h>
+#elif defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#endif
+
+#include "archive.h"
+#include "archive_private.h"
+#include "archive_thread_private.h"
+
+struct archive_thread {
+#if defined(_WIN32) && !defined(__CYGWIN__)
+	HANDLE		 handle;
+#elif defined(HAVE_PTHREAD_H)
+	pthread_t	 thread;
+#endif
+	void		(*func)(void *);
+	void		*arg;
+};
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+
+static DWORD WINAPI
+thread_start(LPVOID p)
+{
+	struct archive_thread *t = (struct archive_thread *)p;
+
+	t->func(t->arg);
+	return (0);
+}
+
+int
+__archive_thread_create(struct archive_thread **tp, void (*func)(void *),
+    void *arg)
+{
+	struct archive_thread *t;
+
+	*tp = NULL;
+	t = malloc(sizeof(*t));
+	if (t == NULL)
+		return (-1);
+	t->func = func;
+	t->arg = arg;
+	t->handle = CreateThread(NULL, 0, thread_start, t, 0, NULL);
+	if (t->handle == NULL) {
+		free(t);
+		return (-1);
+	}
+	*tp = t;
+	return (0);
+}
+
+void
+__archive_thread_join(struct archive_thread *t)
+{
+	if (t == NULL)
+		return;
+	WaitForSingleObject(t->handle, INFINITE);
+	CloseHandle(t->handle);
+	free(t);
+}
+
+/* 0: not run, 1: running, 2: done. */
+void
+__archive_thread_once(archive_thread_once_t *once, void (*func)(void))
+{
+	if (InterlockedCompareExchange(once, 0, 0) == 2)
+		return;
+	if (InterlockedCompareExchange(once, 1, 0) == 0) {
+		func();
+		InterlockedExchange(once, 2);
+		return;
+	}
+	while (InterlockedCompareExchange(once, 2, 2) != 2)
+		Sleep(0);
+}
+
+#elif defined(HAVE_PTHREAD_H)
+
+static void *
+thread_start(void *p)
+{
+	struct archive_thread *t = (struct archive_thread *)p;
+
+	t->func(t->arg);
+	return (NULL);
+}
+
+int
+__archive_thread_create(struct archive_thread **tp, void (*func)(void *),
+    void *arg)
+{
+	struct archive_thread *t;
+
+	*tp = NULL;
+	t = malloc(sizeof(*t));
+	if (t == NULL)
+		return (-1);
+	t->func = func;
+	t->arg = arg;
+	if (pthread_create(&t->thread, NULL, thread_start, t) != 0) {
+		free(t);
+		return (-1);
+	}
+	*tp = t;
+	return (0);
+}
+
+void
+__archive_thread_join(struct archive_thread *t)
+{
+	if (t == NULL)
+		return;
+	pthread_join(t->thread, NULL);
+	free(t);
+}
+
+void
+__archive_thread_once(archive_thread_once_t *once, void (*func)(void))
+{
+	pthread_once(once, func);
+}
+
+#else
+
+int
+__archive_thread_create(struct archive_thread **tp, void (*func)(void *),
+    void *arg)
+{
+	(void)func; /* UNUSED */
+	(void)arg; /* UNUSED */
+	*tp = NULL;
+	return (-1);
+}
+
+void
+__archive_thread_join(struct archive_thread *t)
+{
+	(void)t; /* UNUSED */
+}
+
+/* Without threads there is no one to race with. */
+void
+__archive_thread_once(archive_thread_once_t *once, void (*func)(void))
+{
+	if (*once == 0) {
+		*once = 1;
+		func();
+	}
+}
+
+#endif
+
+/*
+ * Worker pool.  A lock and two condition variables: one that workers
+ * sleep on until a task is queued, one that waiters sleep on until a
+ * task is done.
+ */
+#if defined(_WIN32) && !defined(__CYGWIN__)
+#if _WIN32_WINNT >= 0x0600 /* _WIN32_WINNT_VISTA */
+#define ARCHIVE_THREAD_POOL
+typedef CRITICAL_SECTION pool_lock_t;
+typedef CONDITION_VARIABLE pool_cond_t;
+#define	pool_lock_init(l)	(InitializeCriticalSection(l), 0)
+#define	pool_lock_destroy(l)	DeleteCriticalSection(l)
+#define	pool_lock(l)		EnterCriticalSection(l)
+#define	pool_unlock(l)		LeaveCriticalSection(l)
+#define	pool_cond_init(c)	(InitializeConditionVariable(c), 0)
+#define	pool_cond_destroy(c)	((void)(c))
+#define	pool_cond_wait(c, l)	SleepConditionVariableCS(c, l, INFINITE)
+#define	pool_cond_signal(c)	WakeConditionVariable(c)
+#define	pool_cond_broadcast(c)	WakeAllConditionVariable(c)
+#endif
+#elif defined(HAVE_PTHREAD_H)
+#define ARCHIVE_THREAD_POOL
+typedef pthread_mutex_t pool_lock_t;
+typedef pthread_cond_t pool_cond_t;
+#define	pool_lock_init(l)	pthread_mutex_init(l, NULL)
+#define	pool_lock_destroy(l)	pthread_mutex_destroy(l)
+#define	pool_lock(l)		pthread_mutex_lock(l)
+#define	pool_unlock(l)		pthread_mutex_unlock(l)
+#define	pool_cond_init(c)	pthread_cond_init(c, NULL)
+#define	pool_cond_destroy(c)	pthread_cond_destroy(c)
+#define	pool_cond_wait(c, l)	pthread_cond_wait(c, l)
+#define	pool_cond_signal(c)	pthread_cond_signal(c)
+#define	pool_cond_broadcast(c)	pthread_cond_broadcast(c)
+#endif
+
+/* States of an archive_thread_task. */
+#define	TASK_IDLE	0
+#define	TASK_QUEUED	1
+#define	TASK_RUNNING	2
+#define	TASK_DONE	3
+
+#ifdef ARCHIVE_THREAD_POOL
+
+struct archive_thread_pool {
+	pool_lock_t		 lock;
+	pool_cond_t		 work;
+	pool_cond_t		 done;
+	struct archive_thread_task *head, *tail;
+	struct archive_thread	**threads;
+	int			 max;
+	int			 started;
+	int			 idle;
+	int			 shutdown;
+};
+
+static void
+pool_worker(void *arg)
+{
+	struct archive_thread_pool *pool = (struct archive_thread_pool *)arg;
+	struct archive_thread_task *task;
+
+	pool_lock(&pool->lock);
+	for (;;) {
+		while (pool->head == NULL && !pool->shutdown)
+			pool_cond_wait(&pool->work, &pool->lock);
+		if (pool->head == NULL)
+			break;
+		task = pool->head;
+		pool->head = task->next;
+		if (pool->head == NULL)
+			pool->tail = NULL;
+		task->state = TASK_RUNNING;
+		pool->idle--;
+		pool_unlock(&pool->lock);
+		task->func(task->arg);
+		pool_lock(&pool->lock);
+		task->state = TASK_DONE;
+		pool->idle++;
+		pool_cond_broadcast(&pool->done);
+	}
+	pool_unlock(&pool->lock);
+}
+
+struct archive_thread_pool *
+__archive_thread_pool_new(int max)
+{
+	struct archive_thread_pool *pool;
+
+	if (max < 1)
+		max = 1;
+	pool = calloc(1, sizeof(*pool));
+	if (pool == NULL)
+		return (NULL);
+	pool->threads = calloc(max, sizeof(*pool->threads));
+	if (pool->threads == NULL) {
+		free(pool);
+		return (NULL);
+	}
+	if (pool_lock_init(&pool->lock) != 0) {
+		free(pool->threads);
+		free(pool);
+		return (NULL);
+	}
+	if (pool_cond_init(&pool->work) != 0) {
+		pool_lock_destroy(&pool->lock);
+		free(pool->threads);
+		free(pool);
+		return (NULL);
+	}
+	if (pool_cond_init(&pool->done) != 0) {
+		pool_cond_destroy(&pool->work);
+		pool_lock_destroy(&pool->lock);
+		free(pool->threads);
+		free(pool);
+		return (NULL);
+	}
+	pool->max = max;
+	return (pool);
+}
+
+void
+__archive_thread_pool_run(struct archive_thread_pool *pool,
+    struct archive_thread_task *task, void (*func)(void *), void *arg)
+{
+	task->func = func;
+	task->arg = arg;
+	task->next = NULL;
+	if (pool == NULL) {
+		task->state = TASK_DONE;
+		func(arg);
+		return;
+	}
+	pool_lock(&pool->lock);
+	task->state = TASK_QUEUED;
+	if (pool->tail != NULL)
+		pool->tail->next = task;
+	else
+		pool->head = task;
+	pool->tail = task;
+	/* Start another worker if every one is busy. */
+	if (pool->idle == 0 && pool->started < pool->max &&
+	    __archive_thread_create(&pool->threads[pool->started],
+	    pool_worker, pool) == 0) {
+		pool->started++;
+		pool->idle++;
+	}
+	pool_cond_signal(&pool->work);
+	pool_unlock(&pool->lock);
+}
+
+void
+__archive_thread_pool_wait(struct archive_thread_pool *pool,
+    struct archive_thread_task *task)
+{
+	struct archive_thread_task *prev, *t;
+
+	if (pool == NULL) {
+		task->state = TASK_IDLE;
+		return;
+	}
+	pool_lock(&pool->lock);
+	if (task->state == TASK_IDLE) {
+		pool_unlock(&pool->lock);
+		return;
+	}
+	if (task->state == TASK_QUEUED) {
+		/* Nobody has it yet; take it out of the queue and run it. */
+		prev = NULL;
+		for (t = pool->head; t != task; t = t->next)
+			prev = t;
+		if (prev != NULL)
+			prev->next = task->next;
+		else
+			pool->head = task->next;
+		if (pool->tail == task)
+			pool->tail = prev;
+		task->state = TASK_RUNNING;
+		pool_unlock(&pool->lock);
+		task->func(task->arg);
+		task->state = TASK_IDLE;
+		return;
+	}
+	while (task->state != TASK_DONE)
+		pool_cond_wait(&pool->done, &pool->lock);
+	task->state = TASK_IDLE;
+	pool_unlock(&pool->lock);
+}
+
+void
+__archive_thread_pool_free(struct archive_thread_pool *pool)
+{
+	int i;
+
+	if (pool == NULL)
+		return;
+	pool_lock(&pool->lock);
+	pool->shutdown = 1;
+	pool_cond_broadcast(&pool->work);
+	pool_unlock(&pool->lock);
+	for (i = 0; i < pool->started; i++)
+		__archive_thread_join(pool->threads[i]);
+	pool_cond_destroy(&pool->done);
+	pool_cond_destroy(&pool->work);
+	pool_lock_destroy(&pool->lock);
+	free(pool->threads);
+	free(pool);
+}
+
+#else
+
+struct archive_thread_pool *
+__archive_thread_pool_new(int max)
+{
+	(void)max; /* UNUSED */
+	return (NULL);
+}
+
+void
+__archive_thread_pool_run(struct archive_thread_pool *pool,
+    struct archive_thread_task *task, void (*func)(void *), void *arg)
+{
+	(void)pool; /* UNUSED */
+	task->state = TASK_DONE;
+	func(arg);
+}
+
+void
+__archive_thread_pool_wait(struct archive_thread_pool *pool,
+    struct archive_thread_task *task)
+{
+	(void)pool; /* UNUSED */
+	task->state = TASK_IDLE;
+}
+
+void
+__archive_thread_pool_free(struct archive_thread_pool *pool)
+{
+	(void)pool; /* UNUSED */
+}
+
+#endif /* ARCHIVE_THREAD_POOL */
+
+int
+__archive_thread_cpus(void)
+{
+	long n = 1;
+
+#if defined(HAVE_SYSCONF) && defined(_SC_NPROCESSORS_ONLN)
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+#elif !defined(__CYGWIN__) && defined(_WIN32_WINNT) && \
+	_WIN32_WINNT >= 0x0601 /* _WIN32_WINNT_WIN7 */
+	n = (long)GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+#endif
+	if (n < 1)
+		n = 1;
+	if (n > 256)
+		n = 256;
+	return ((int)n);
+}
+
+/*
+ * Parse the value of a "threads" option: 0 means one per processor,
+ * and anything over 256 is taken as 256.  A missing or malformed
+ * value, or a negative one, fails with ARCHIVE_FAILED and *out is
+ * left alone.
+ */
+int
+__archive_thread_parse_count(struct archive *a, const char *value, int *out)
+{
+	long n = -1;
+	char *end;
+
+	if (value != NULL && value[0] != '-' && value[0] != '\0') {
+		errno = 0;
+		n = strtol(value, &end, 10);
+		if (*end != '\0' || (errno != 0 && errno != ERANGE))
+			n = -1;
+	}
+	if (n < 0) {
+		archive_set_error(a, ARCHIVE_ERRNO_MISC,
+		    "threads option needs a non-negative number");
+		return (ARCHIVE_FAILED);
+	}
+	if (n == 0)
+		n = __archive_thread_cpus();
+	else if (n > 256)
+		n = 256;
+	*out = (int)n;
+	return (ARCHIVE_OK);
+}
@@ -0,0 +1,100 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ARCHIVE_THREAD_PRIVATE_H_INCLUDED
+#define ARCHIVE_THREAD_PRIVATE_H_INCLUDED
+
+#ifndef __LIBARCHIVE_BUILD
+#error This header is only to be used internally to libarchive.
+#endif
+
+#if !(defined(_WIN32) && !defined(__CYGWIN__)) && defined(HAVE_PTHREAD_H)
+#include <pthread.h>
+#endif
+
+/*
+ * Minimal worker threads for readers and writers that can decode
+ * independent pieces of an archive concurrently.
+ *
+ * __archive_thread_create() returns non-zero if the platform has no
+ * thread support or a thread can't be started; callers then just run
+ * the work themselves.  __archive_thread_join() waits for the thread
+ * and releases it.
+ */
+struct archive;
+struct archive_thread;
+
+/*
+ * __archive_thread_once() runs a function exactly once, however many
+ * threads call it together; all of them return only after it ran.
+ * Code that picks an implementation on first use does so this way.
+ */
+#if !(defined(_WIN32) && !defined(__CYGWIN__)) && defined(HAVE_PTHREAD_H)
+typedef pthread_once_t archive_thread_once_t;
+#define ARCHIVE_THREAD_ONCE_INIT	PTHREAD_ONCE_INIT
+#else
+typedef volatile long archive_thread_once_t;
+#define ARCHIVE_THREAD_ONCE_INIT	0
+#endif
+
+int	__archive_thread_create(struct archive_thread **,
+	    void (*)(void *), void *);
+void	__archive_thread_join(struct archive_thread *);
+void	__archive_thread_once(archive_thread_once_t *, void (*)(void));
+
+/*
+ * A pool of worker threads, owned by one reader or writer, that runs
+ * tasks queued to it.  Workers are started as tasks need them, up to
+ * the number given to __archive_thread_pool_new(), and are kept until
+ * the pool is freed.
+ *
+ * The task structure belongs to the caller and must stay put until
+ * __archive_thread_pool_wait() has returned for it.  Waiting for a
+ * task that no worker has picked up yet runs it on the calling thread.
+ * A NULL pool, as returned where there is no thread support, runs each
+ * task when it is queued.
+ */
+struct archive_thread_pool;
+struct archive_thread_task {
+	void			(*func)(void *);
+	void			*arg;
+	struct archive_thread_task *next;
+	int			 state;
+};
+
+struct archive_thread_pool *__archive_thread_pool_new(int);
+void	__archive_thread_pool_run(struct archive_thread_pool *,
+	    struct archive_thread_task *, void (*)(void *), void *);
+void	__archive_thread_pool_wait(struct archive_thread_pool *,
+	    struct archive_thread_task *);
+void	__archive_thread_pool_free(struct archive_thread_pool *);
+
+/* Number of processors available, for a "threads=0" option. */
+int	__archive_thread_cpus(void);
+
+/* Parse a "threads" option value into *out; see archive_thread.c. */
+int	__archive_thread_parse_count(struct archive *, const char *, int *);
+
+#endif /* !ARCHIVE_THREAD_PRIVATE_H_INCLUDED */
@@ -48,9 +48,6 @@
 #include <zstd.h>
 #include <stdio.h>
 #endif
-#ifdef HAVE_LZO_LZOCONF_H
-#include <lzo/lzoconf.h>
-#endif
 #if HAVE_LIBXML_XMLVERSION_H
 #include <libxml/xmlversion.h>
 #elif HAVE_BSDXML_H
@@ -161,6 +158,9 @@ archive_crypto_version(struct archive_string* str)
 #if defined(ARCHIVE_CRYPTOR_USE_WINCRYPT)
 	archive_strcat(str, " WinCrypt/");
 	archive_strcat(str, archive_wincrypt_version());
+#endif
+#if defined(ARCHIVE_CRYPTOR_USE_BUILTIN)
+	archive_strcat(str, " aes/bundled");
 #endif
 	// Just in case
 	(void)str; /* UNUSED */
@@ -176,7 +176,6 @@ archive_version_details(void)
 	const char *bzlib = archive_bzlib_version();
 	const char *liblz4 = archive_liblz4_version();
 	const char *libzstd = archive_libzstd_version();
-	const char *liblzo = archive_liblzo2_version();
 	const char *libiconv = archive_libiconv_version();
 	const char *libacl = archive_libacl_version();
 	const char *librichacl = archive_librichacl_version();
@@ -210,10 +209,6 @@ archive_version_details(void)
 			archive_strcat(&str, " libzstd/");
 			archive_strcat(&str, libzstd);
 		}
-		if (liblzo) {
-			archive_strcat(&str, " liblzo2/");
-			archive_strcat(&str, liblzo);
-		}
 		archive_xml_version(&str);
 		archive_regex_version(&str);
 		archive_crypto_version(&str);
@@ -313,11 +308,8 @@ archive_libzstd_version(void)
 const char *
 archive_liblzo2_version(void)
 {
-#if HAVE_LZO_LZOCONF_H && HAVE_LIBLZO2
-	return LZO_VERSION_STRING;
-#else
+	/* lzop is handled by the bundled LZO1X code, not liblzo2. */
 	return NULL;
-#endif
 }
 
 const char *
@@ -36,6 +36,7 @@
 #endif
 
 #include "archive.h"
+#include "archive_base64_private.h"
 #include "archive_private.h"
 #include "archive_string.h"
 #include "archive_write_private.h"
@@ -58,20 +59,10 @@ static int archive_filter_b64encode_write(struct archive_write_filter *,
     const void *, size_t);
 static int archive_filter_b64encode_close(struct archive_write_filter *);
 static int archive_filter_b64encode_free(struct archive_write_filter *);
-static void la_b64_encode(struct archive_string *, const unsigned char *, size_t);
+static int la_b64_encode(struct archive_write_filter *, const unsigned char *,
+    size_t);
 static int64_t atol8(const char *, size_t);
 
-static const char base64[] = {
-	'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H',
-	'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P',
-	'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X',
-	'Y', 'Z', 'a', 'b', 'c', 'd', 'e', 'f',
-	'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n',
-	'o', 'p', 'q', 'r', 's', 't', 'u', 'v',
-	'w', 'x', 'y', 'z', '0', '1', '2', '3',
-	'4', '5', '6', '7', '8', '9', '+', '/'
-};
-
 /*
  * Add a compress filter to this write handle.
  */
@@ -172,38 +163,24 @@ archive_filter_b64encode_open(struct archive_write_filter *f)
 	return (0);
 }
 
-static void
-la_b64_encode(struct archive_string *as, const unsigned char *p, size_t len)
+/*
+ * Append the lines encoding len bytes to the encoded buffer.
+ */
+static int
+la_b64_encode(struct archive_write_filter *f, const unsigned char *p, size_t len)
 {
-	int c;
-
-	for (; len >= 3; p += 3, len -= 3) {
-		c = p[0] >> 2;
-		archive_strappend_char(as, base64[c]);
-		c = ((p[0] & 0x03) << 4) | ((p[1] & 0xf0) >> 4);
-		archive_strappend_char(as, base64[c]);
-		c = ((p[1] & 0x0f) << 2) | ((p[2] & 0xc0) >> 6);
-		archive_strappend_char(as, base64[c]);
-		c = p[2] & 0x3f;
-		archive_strappend_char(as, base64[c]);
-	}
-	if (len > 0) {
-		c = p[0] >> 2;
-		archive_strappend_char(as, base64[c]);
-		c = (p[0] & 0x03) << 4;
-		if (len == 1) {
-			archive_strappend_char(as, base64[c]);
-			archive_strappend_char(as, '=');
-			archive_strappend_char(as, '=');
-		} else {
-			c |= (p[1] & 0xf0) >> 4;
-			archive_strappend_char(as, base64[c]);
-			c = (p[1] & 0x0f) << 2;
-			archive_strappend_char(as, base64[c]);
-			archive_strappend_char(as, '=');
-		}
+	struct private_b64encode *state = (struct private_b64encode *)f->data;
+	struct archive_string *as = &state->encoded_buff;
+
+	if (archive_string_ensure(as,
+	    as->length + __archive_base64_lines_size(len, LBYTES)) == NULL) {
+		archive_set_error(f->archive, ENOMEM,
+		    "Can't allocate data for b64encode buffer");
+		return (ARCHIVE_FATAL);
 	}
-	archive_strappend_char(as, '\n');
+	as->length += __archive_base64_encode_lines(as->s + as->length, p,
+	    len, LBYTES, ARCHIVE_BASE64_STD);
+	return (ARCHIVE_OK);
 }
 
 /*
@@ -215,6 +192,7 @@ archive_filter_b64encode_write(struct archive_write_filter *f, const void *buff,
 {
 	struct private_b64encode *state = (struct private_b64encode *)f->data;
 	const unsigned char *p = buff;
+	size_t n, off;
 	int ret = ARCHIVE_OK;
 
 	if (length == 0)
@@ -227,25 +205,34 @@ archive_filter_b64encode_write(struct archive_write_filter *f, const void *buff,
 		}
 		if (state->hold_len < LBYTES)
 			return (ret);
-		la_b64_encode(&state->encoded_buff, state->hold, LBYTES);
+		if (la_b64_encode(f, state->hold, LBYTES) != ARCHIVE_OK)
+			return (ARCHIVE_FATAL);
 		state->hold_len = 0;
 	}
 
-	for (; length >= LBYTES; length -= LBYTES, p += LBYTES)
-		la_b64_encode(&state->encoded_buff, p, LBYTES);
+	/* Encode all the complete lines at once. */
+	n = length - length % LBYTES;
+	if (n > 0 && la_b64_encode(f, p, n) != ARCHIVE_OK)
+		return (ARCHIVE_FATAL);
+	p += n;
+	length -= n;
 
 	/* Save remaining bytes. */
 	if (length > 0) {
 		memcpy(state->hold, p, length);
 		state->hold_len = length;
 	}
-	while (archive_strlen(&state->encoded_buff) >= state->bs) {
+	for (off = 0; archive_strlen(&state->encoded_buff) - off >= state->bs;
+	    off += state->bs) {
 		ret = __archive_write_filter(f->next_filter,
-		    state->encoded_buff.s, state->bs);
-		memmove(state->encoded_buff.s,
-		    state->encoded_buff.s + state->bs,
-		    state->encoded_buff.length - state->bs);
-		state->encoded_buff.length -= state->bs;
+		    state->encoded_buff.s + off, state->bs);
+		if (ret != ARCHIVE_OK)
+			break;
+	}
+	if (off > 0) {
+		memmove(state->encoded_buff.s, state->encoded_buff.s + off,
+		    state->encoded_buff.length - off);
+		state->encoded_buff.length -= off;
 	}
 
 	return (ret);
@@ -261,8 +248,9 @@ archive_filter_b64encode_close(struct archive_write_filter *f)
 	struct private_b64encode *state = (struct private_b64encode *)f->data;
 
 	/* Flush remaining bytes. */
-	if (state->hold_len != 0)
-		la_b64_encode(&state->encoded_buff, state->hold, state->hold_len);
+	if (state->hold_len != 0 &&
+	    la_b64_encode(f, state->hold, state->hold_len) != ARCHIVE_OK)
+		return (ARCHIVE_FATAL);
 	archive_string_sprintf(&state->encoded_buff, "====\n");
 	/* Write the last block */
 	archive_write_set_bytes_in_last_block(f->archive, 1);
@@ -57,7 +57,6 @@
  */
 
 #include "archive_platform.h"
-
 #ifdef HAVE_ERRNO_H
 #include <errno.h>
 #endif
@@ -69,11 +68,13 @@
 #endif
 
 #include "archive.h"
+#include "archive_endian.h"
 #include "archive_private.h"
 #include "archive_write_private.h"
 
-#define	HSIZE		69001	/* 95% occupancy */
-#define	HSHIFT		8	/* 8 - trunc(log2(HSIZE / 65536)) */
+#define	HBITS		17
+#define	HSIZE		(1 << HBITS)	/* At most 50% occupancy */
+#define	HMASK		(HSIZE - 1)
 #define	CHECK_GAP 10000		/* Ratio check interval. */
 
 #define	MAXCODE(bits)	((1 << (bits)) - 1)
@@ -85,21 +86,44 @@
 #define	FIRST	257		/* First free entry. */
 #define	CLEAR	256		/* Table clear output code. */
 
+/*
+ * Each hash table slot packs the generation it was filled in, the
+ * (character, prefix code) pair it maps and the code assigned to that
+ * pair:
+ *
+ *	bits 40-63	generation
+ *	bits 16-39	character << 16 | prefix code
+ *	bits  0-15	code
+ *
+ * Clearing the table only advances the generation, which makes every
+ * slot of an older generation read as empty; the table itself is only
+ * wiped when the 24-bit generation counter wraps.
+ */
+#define	GEN_SHIFT	40
+#define	GEN_MAX		(1 << 24)
+
 struct private_data {
 	int64_t in_count, out_count, checkpoint;
 
 	int code_len;			/* Number of bits/code. */
 	int cur_maxcode;		/* Maximum code, given n_bits. */
 	int max_maxcode;		/* Should NEVER generate this code. */
-	int hashtab [HSIZE];
-	unsigned short codetab [HSIZE];
+	uint64_t hashtab [HSIZE];
+	uint32_t generation;
 	int first_free;		/* First unused entry. */
 	int compress_ratio;
 
-	int cur_code, cur_fcode;
+	int cur_code;
 
+	/*
+	 * Codes are packed LSB first into bit_buf and written out four
+	 * bytes at a time.  bit_offset is the position within the
+	 * current group of eight codes, which is padded out when the
+	 * code size changes.
+	 */
+	uint64_t bit_buf;
+	int bit_count;
 	int bit_offset;
-	unsigned char bit_buf;
 
 	unsigned char	*compressed;
 	size_t		 compressed_buffer_size;
@@ -183,6 +207,7 @@ archive_compressor_compress_open(struct archive_write_filter *f)
 	state->max_maxcode = 0x10000;	/* Should NEVER generate this code. */
 	state->in_count = 0;		/* Length of input. */
 	state->bit_buf = 0;
+	state->bit_count = 0;
 	state->bit_offset = 0;
 	state->out_count = 3;		/* Includes 3-byte header mojo. */
 	state->compress_ratio = 0;
@@ -191,7 +216,8 @@ archive_compressor_compress_open(struct archive_write_filter *f)
 	state->cur_maxcode = MAXCODE(state->code_len);
 	state->first_free = FIRST;
 
-	memset(state->hashtab, 0xff, sizeof(state->hashtab));
+	/* calloc() left every slot in generation 0. */
+	state->generation = 1;
 
 	/* Prime output buffer with a gzip header. */
 	state->compressed[0] = 0x1f; /* Compress */
@@ -203,24 +229,6 @@ archive_compressor_compress_open(struct archive_write_filter *f)
 	return (0);
 }
 
-/*-
- * Output the given code.
- * Inputs:
- * 	code:	A n_bits-bit integer.  If == -1, then EOF.  This assumes
- *		that n_bits <= (long)wordsize - 1.
- * Outputs:
- * 	Outputs code to the file.
- * Assumptions:
- *	Chars are 8 bits long.
- * Algorithm:
- * 	Maintain a BITS character long buffer (so that 8 codes will
- * fit in it exactly).  Use the VAX insv instruction to insert each
- * code in turn.  When the buffer fills up empty it and start over.
- */
-
-static const unsigned char rmask[9] =
-	{0x00, 0x01, 0x03, 0x07, 0x0f, 0x1f, 0x3f, 0x7f, 0xff};
-
 static int
 output_byte(struct archive_write_filter *f, unsigned char c)
 {
@@ -240,33 +248,84 @@ output_byte(struct archive_write_filter *f, unsigned char c)
 	return ARCHIVE_OK;
 }
 
+/*
+ * Move the 32 lowest bits of the bit buffer to the output, with a
+ * single store when the output buffer has room for them.
+ */
+static int
+output_word(struct archive_write_filter *f)
+{
+	struct private_data *state = f->data;
+	uint32_t w = (uint32_t)state->bit_buf;
+	int i, ret;
+
+	state->bit_buf >>= 32;
+	state->bit_count -= 32;
+	if (state->compressed_buffer_size - state->compressed_offset > 4) {
+		archive_le32enc(state->compressed + state->compressed_offset,
+		    w);
+		state->compressed_offset += 4;
+		state->out_count += 4;
+		return (ARCHIVE_OK);
+	}
+	for (i = 0; i < 4; i++, w >>= 8) {
+		ret = output_byte(f, (unsigned char)w);
+		if (ret != ARCHIVE_OK)
+			return (ret);
+	}
+	return (ARCHIVE_OK);
+}
+
+/*
+ * Write out every bit still held in the bit buffer, padding the last
+ * byte with zeros.
+ */
+static int
+output_bits(struct archive_write_filter *f)
+{
+	struct private_data *state = f->data;
+	int ret;
+
+	while (state->bit_count > 0) {
+		ret = output_byte(f, (unsigned char)state->bit_buf);
+		if (ret != ARCHIVE_OK)
+			return (ret);
+		state->bit_buf >>= 8;
+		state->bit_count -= 8;
+	}
+	state->bit_buf = 0;
+	state->bit_count = 0;
+	return (ARCHIVE_OK);
+}
+
+/*-
+ * Output the given code.
+ * Inputs:
+ * 	code:	A n_bits-bit integer.
+ * Outputs:
+ * 	Outputs code to the file.
+ * Algorithm:
+ * 	Codes are written in groups of eight, so that a group fills
+ * exactly code_len bytes.  When the code size changes the current
+ * group is padded out with zeros, because the input side won't
+ * discover the size increase until after it has read the whole group.
+ */
 static int
 output_code(struct archive_write_filter *f, int ocode)
 {
 	struct private_data *state = f->data;
-	int bits, ret, clear_flg, bit_offset;
+	int ret, clear_flg, pad;
 
 	clear_flg = ocode == CLEAR;
 
-	/*
-	 * Since ocode is always >= 8 bits, only need to mask the first
-	 * hunk on the left.
-	 */
-	bit_offset = state->bit_offset % 8;
-	state->bit_buf |= (ocode << bit_offset) & 0xff;
-	output_byte(f, state->bit_buf);
-
-	bits = state->code_len - (8 - bit_offset);
-	ocode >>= 8 - bit_offset;
-	/* Get any 8 bit parts in the middle (<=1 for up to 16 bits). */
-	if (bits >= 8) {
-		output_byte(f, ocode & 0xff);
-		ocode >>= 8;
-		bits -= 8;
+	state->bit_buf |= (uint64_t)ocode << state->bit_count;
+	state->bit_count += state->code_len;
+	if (state->bit_count >= 32) {
+		ret = output_word(f);
+		if (ret != ARCHIVE_OK)
+			return (ret);
 	}
-	/* Last bits. */
 	state->bit_offset += state->code_len;
-	state->bit_buf = ocode & rmask[bits];
 	if (state->bit_offset == state->code_len * 8)
 		state->bit_offset = 0;
 
@@ -275,20 +334,20 @@ output_code(struct archive_write_filter *f, int ocode)
 	 * then increase it, if possible.
 	 */
 	if (clear_flg || state->first_free > state->cur_maxcode) {
-	       /*
-		* Write the whole buffer, because the input side won't
-		* discover the size increase until after it has read it.
-		*/
 		if (state->bit_offset > 0) {
-			while (state->bit_offset < state->code_len * 8) {
-				ret = output_byte(f, state->bit_buf);
+			/* Groups start on a byte boundary, so the padded
+			 * group ends on one too. */
+			pad = state->code_len * 8 - state->bit_offset;
+			ret = output_bits(f);
+			if (ret != ARCHIVE_OK)
+				return (ret);
+			pad -= (8 - state->bit_offset % 8) % 8;
+			for (; pad > 0; pad -= 8) {
+				ret = output_byte(f, 0);
 				if (ret != ARCHIVE_OK)
-					return ret;
-				state->bit_offset += 8;
-				state->bit_buf = 0;
+					return (ret);
 			}
 		}
-		state->bit_buf = 0;
 		state->bit_offset = 0;
 
 		if (clear_flg) {
@@ -306,21 +365,17 @@ output_code(struct archive_write_filter *f, int ocode)
 	return (ARCHIVE_OK);
 }
 
-static int
-output_flush(struct archive_write_filter *f)
+/*
+ * Forget every string in the table.
+ */
+static void
+clear_table(struct private_data *state)
 {
-	struct private_data *state = f->data;
-	int ret;
-
-	/* At EOF, write the rest of the buffer. */
-	if (state->bit_offset % 8) {
-		state->code_len = (state->bit_offset % 8 + 7) / 8;
-		ret = output_byte(f, state->bit_buf);
-		if (ret != ARCHIVE_OK)
-			return ret;
+	if (++state->generation == GEN_MAX) {
+		memset(state->hashtab, 0, sizeof(state->hashtab));
+		state->generation = 1;
 	}
-
-	return (ARCHIVE_OK);
+	state->first_free = FIRST;
 }
 
 /*
@@ -331,10 +386,12 @@ archive_compressor_compress_write(struct archive_write_filter *f,
     const void *buff, size_t length)
 {
 	struct private_data *state = (struct private_data *)f->data;
-	int i;
+	uint64_t * const hashtab = state->hashtab;
+	uint64_t e, key, gen;
+	uint32_t fcode, i;
 	int ratio;
-	int c, disp, ret;
-	const unsigned char *bp;
+	int c, cur_code, ret;
+	const unsigned char *bp, *counted;
 
 	if (length == 0)
 		return ARCHIVE_OK;
@@ -347,41 +404,39 @@ archive_compressor_compress_write(struct archive_write_filter *f,
 		--length;
 	}
 
+	/* in_count is only brought up to date when it is needed. */
+	counted = bp;
+	cur_code = state->cur_code;
+	gen = state->generation;
+	key = gen << 24;
 	while (length--) {
 		c = *bp++;
-		state->in_count++;
-		state->cur_fcode = (c << 16) | state->cur_code;
-		i = ((c << HSHIFT) ^ state->cur_code);	/* Xor hashing. */
-
-		if (state->hashtab[i] == state->cur_fcode) {
-			state->cur_code = state->codetab[i];
-			continue;
+		fcode = ((uint32_t)c << 16) | (uint32_t)cur_code;
+		/* Multiplicative hashing, linear probing. */
+		i = (fcode * 0x9E3779B1U) >> (32 - HBITS);
+		for (;;) {
+			e = hashtab[i];
+			if ((e >> 16) == (key | fcode))
+				break;
+			if ((e >> GEN_SHIFT) != gen)
+				break;	/* Empty slot. */
+			i = (i + 1) & HMASK;
 		}
-		if (state->hashtab[i] < 0)	/* Empty slot. */
-			goto nomatch;
-		/* Secondary hash (after G. Knott). */
-		if (i == 0)
-			disp = 1;
-		else
-			disp = HSIZE - i;
- probe:
-		if ((i -= disp) < 0)
-			i += HSIZE;
-
-		if (state->hashtab[i] == state->cur_fcode) {
-			state->cur_code = state->codetab[i];
+		if ((e >> 16) == (key | fcode)) {
+			cur_code = (int)(e & 0xffff);
 			continue;
 		}
-		if (state->hashtab[i] >= 0)
-			goto probe;
- nomatch:
-		ret = output_code(f, state->cur_code);
+
+		state->in_count += bp - counted;
+		counted = bp;
+		ret = output_code(f, cur_code);
 		if (ret != ARCHIVE_OK)
 			return ret;
-		state->cur_code = c;
+		cur_code = c;
 		if (state->first_free < state->max_maxcode) {
-			state->codetab[i] = state->first_free++;	/* code -> hashtable */
-			state->hashtab[i] = state->cur_fcode;
+			/* code -> hashtable */
+			hashtab[i] = ((key | fcode) << 16) |
+			    (uint64_t)state->first_free++;
 			continue;
 		}
 		if (state->in_count < state->checkpoint)
@@ -389,9 +444,14 @@ archive_compressor_compress_write(struct archive_write_filter *f,
 
 		state->checkpoint = state->in_count + CHECK_GAP;
 
-		if (state->in_count <= 0x007fffff && state->out_count != 0)
-			ratio = (int)(state->in_count * 256 / state->out_count);
-		else if ((ratio = (int)(state->out_count / 256)) == 0)
+		/* Count the whole bytes still held in the bit buffer
+		 * as written. */
+		ratio = state->bit_count >> 3;
+		if (state->in_count <= 0x007fffff &&
+		    state->out_count + ratio != 0)
+			ratio = (int)(state->in_count * 256 /
+			    (state->out_count + ratio));
+		else if ((ratio = (int)((state->out_count + ratio) / 256)) == 0)
 			ratio = 0x7fffffff;
 		else
 			ratio = (int)(state->in_count / ratio);
@@ -400,13 +460,16 @@ archive_compressor_compress_write(struct archive_write_filter *f,
 			state->compress_ratio = ratio;
 		else {
 			state->compress_ratio = 0;
-			memset(state->hashtab, 0xff, sizeof(state->hashtab));
-			state->first_free = FIRST;
+			clear_table(state);
+			gen = state->generation;
+			key = gen << 24;
 			ret = output_code(f, CLEAR);
 			if (ret != ARCHIVE_OK)
 				return ret;
 		}
 	}
+	state->in_count += bp - counted;
+	state->cur_code = cur_code;
 
 	return (ARCHIVE_OK);
 }
@@ -424,7 +487,8 @@ archive_compressor_compress_close(struct archive_write_filter *f)
 	ret = output_code(f, state->cur_code);
 	if (ret != ARCHIVE_OK)
 		return ret;
-	ret = output_flush(f);
+	/* At EOF, write the rest of the buffer. */
+	ret = output_bits(f);
 	if (ret != ARCHIVE_OK)
 		return ret;
 
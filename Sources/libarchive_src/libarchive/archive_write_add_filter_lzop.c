@@ -25,9 +25,6 @@
 
 #include "archive_platform.h"
 
-//#undef HAVE_LZO_LZOCONF_H
-//#undef HAVE_LZO_LZO1X_H
-
 #ifdef HAVE_ERRNO_H
 #include <errno.h>
 #endif
@@ -38,39 +35,54 @@
 #include <string.h>
 #endif
 #include <time.h>
-#ifdef HAVE_LZO_LZOCONF_H
-#include <lzo/lzoconf.h>
-#endif
-#ifdef HAVE_LZO_LZO1X_H
-#include <lzo/lzo1x.h>
+#ifdef HAVE_ZLIB_H
+#include <zlib.h> /* for adler32 */
 #endif
 
 #include "archive.h"
 #include "archive_string.h"
 #include "archive_endian.h"
+#include "archive_lzo1x_private.h"
+#include "archive_thread_private.h"
 #include "archive_write_private.h"
 
+#ifndef HAVE_ZLIB_H
+#define adler32	__archive_lzo_adler32
+#endif
+
 enum lzo_method {
 	METHOD_LZO1X_1 = 1,
 	METHOD_LZO1X_1_15 = 2,
 	METHOD_LZO1X_999 = 3
 };
+
+/*
+ * One block of input and its compressed form.  The blocks collected
+ * before a flush are compressed together, all but the first on
+ * worker threads.
+ */
+struct lzop_block {
+	const unsigned char	*in;
+	size_t			 in_size;
+	unsigned char		*out;
+	size_t			 out_size;
+	void			*work_buffer;
+	uint32_t		 checksum;
+	int			 level;
+	struct archive_thread	*thread;
+};
+
 struct write_lzop {
 	int compression_level;
-#if defined(HAVE_LZO_LZOCONF_H) && defined(HAVE_LZO_LZO1X_H)
+	int threads;
 	unsigned char	*uncompressed;
 	size_t		 uncompressed_buffer_size;
 	size_t		 uncompressed_avail_bytes;
-	unsigned char	*compressed;
-	size_t		 compressed_buffer_size;
+	struct lzop_block *blocks;
+	int		 nblocks;	/* Allocated at open. */
 	enum lzo_method	 method;
 	unsigned char	 level;
-	lzo_voidp	 work_buffer;
-	lzo_uint32	 work_buffer_size;
 	char		 header_written;
-#else
-	struct archive_write_program_data *pdata;
-#endif
 };
 
 static int archive_write_lzop_open(struct archive_write_filter *);
@@ -81,13 +93,14 @@ static int archive_write_lzop_write(struct archive_write_filter *,
 static int archive_write_lzop_close(struct archive_write_filter *);
 static int archive_write_lzop_free(struct archive_write_filter *);
 
-#if defined(HAVE_LZO_LZOCONF_H) && defined(HAVE_LZO_LZO1X_H)
 /* Maximum block size. */
 #define BLOCK_SIZE			(256 * 1024)
 /* Block information is composed of uncompressed size(4 bytes),
  * compressed size(4 bytes) and the checksum of uncompressed data(4 bytes)
  * in this lzop writer. */
 #define BLOCK_INfO_SIZE			12
+/* The LZO library version our output corresponds to. */
+#define LZO_LIBVERSION			0x20a0
 
 #define HEADER_VERSION			9
 #define HEADER_LIBVERSION		11
@@ -130,7 +143,6 @@ static const unsigned char header[] = {
 	/* Header checksum 4 bytes */
 	0x00, 0x00, 0x00, 0x00,
 };
-#endif
 
 int
 archive_write_add_filter_lzop(struct archive *_a)
@@ -155,50 +167,25 @@ archive_write_add_filter_lzop(struct archive *_a)
 	f->write = archive_write_lzop_write;
 	f->close = archive_write_lzop_close;
 	f->free = archive_write_lzop_free;
-#if defined(HAVE_LZO_LZOCONF_H) && defined(HAVE_LZO_LZO1X_H)
-	if (lzo_init() != LZO_E_OK) {
-		free(data);
-		archive_set_error(_a, ARCHIVE_ERRNO_MISC,
-		    "lzo_init(type check) failed");
-		return (ARCHIVE_FATAL);
-	}
-	if (lzo_version() < 0x940) {
-		free(data);
-		archive_set_error(_a, ARCHIVE_ERRNO_MISC,
-		    "liblzo library is too old(%s < 0.940)",
-		    lzo_version_string());
-		return (ARCHIVE_FATAL);
-	}
 	data->compression_level = 5;
+	data->threads = 1;
 	return (ARCHIVE_OK);
-#else
-	data->pdata = __archive_write_program_allocate("lzop");
-	if (data->pdata == NULL) {
-		free(data);
-		archive_set_error(_a, ENOMEM, "Can't allocate memory");
-		return (ARCHIVE_FATAL);
-	}
-	data->compression_level = 0;
-	/* Note: We return "warn" to inform of using an external lzop
-	 * program. */
-	archive_set_error(_a, ARCHIVE_ERRNO_MISC,
-	    "Using external lzop program for lzop compression");
-	return (ARCHIVE_WARN);
-#endif
 }
 
 static int
 archive_write_lzop_free(struct archive_write_filter *f)
 {
 	struct write_lzop *data = (struct write_lzop *)f->data;
+	int i;
 
-#if defined(HAVE_LZO_LZOCONF_H) && defined(HAVE_LZO_LZO1X_H)
+	if (data->blocks != NULL) {
+		for (i = 0; i < data->nblocks; i++) {
+			free(data->blocks[i].out);
+			free(data->blocks[i].work_buffer);
+		}
+		free(data->blocks);
+	}
 	free(data->uncompressed);
-	free(data->compressed);
-	free(data->work_buffer);
-#else
-	__archive_write_program_free(data->pdata);
-#endif
 	free(data);
 	return (ARCHIVE_OK);
 }
@@ -215,18 +202,20 @@ archive_write_lzop_options(struct archive_write_filter *f, const char *key,
 			return (ARCHIVE_WARN);
 		data->compression_level = value[0] - '0';
 		return (ARCHIVE_OK);
-	}
+	} else if (strcmp(key, "threads") == 0)
+		return (__archive_thread_parse_count(f->archive, value,
+		    &data->threads));
 	/* Note: The "warn" return is just to inform the options
 	 * supervisor that we didn't handle it.  It will generate
 	 * a suitable error if no one used this option. */
 	return (ARCHIVE_WARN);
 }
 
-#if defined(HAVE_LZO_LZOCONF_H) && defined(HAVE_LZO_LZO1X_H)
 static int
 archive_write_lzop_open(struct archive_write_filter *f)
 {
 	struct write_lzop *data = (struct write_lzop *)f->data;
+	int i;
 
 	switch (data->compression_level) {
 	case 1:
@@ -241,35 +230,30 @@ archive_write_lzop_open(struct archive_write_filter *f)
 	case 9:
 		data->method = METHOD_LZO1X_999; data->level = 9; break;
 	}
-	switch (data->method) {
-	case METHOD_LZO1X_1:
-		data->work_buffer_size = LZO1X_1_MEM_COMPRESS; break;
-	case METHOD_LZO1X_1_15:
-		data->work_buffer_size = LZO1X_1_15_MEM_COMPRESS; break;
-	case METHOD_LZO1X_999:
-		data->work_buffer_size = LZO1X_999_MEM_COMPRESS; break;
-	}
-	if (data->work_buffer == NULL) {
-		data->work_buffer = (lzo_voidp)malloc(data->work_buffer_size);
-		if (data->work_buffer == NULL) {
+	if (data->blocks == NULL) {
+		data->blocks = calloc(data->threads, sizeof(*data->blocks));
+		if (data->blocks == NULL) {
 			archive_set_error(f->archive, ENOMEM,
 			    "Can't allocate data for compression buffer");
 			return (ARCHIVE_FATAL);
 		}
-	}
-	if (data->compressed == NULL) {
-		data->compressed_buffer_size = sizeof(header) +
-		    BLOCK_SIZE + (BLOCK_SIZE >> 4) + 64 + 3;
-		data->compressed = (unsigned char *)
-		    malloc(data->compressed_buffer_size);
-		if (data->compressed == NULL) {
-			archive_set_error(f->archive, ENOMEM,
-			    "Can't allocate data for compression buffer");
-			return (ARCHIVE_FATAL);
+		data->nblocks = data->threads;
+		for (i = 0; i < data->nblocks; i++) {
+			data->blocks[i].out =
+			    malloc(ARCHIVE_LZO1X_WORST_SIZE(BLOCK_SIZE));
+			data->blocks[i].work_buffer =
+			    malloc(ARCHIVE_LZO1X_MEM_COMPRESS);
+			if (data->blocks[i].out == NULL ||
+			    data->blocks[i].work_buffer == NULL) {
+				archive_set_error(f->archive, ENOMEM,
+				    "Can't allocate data for compression buffer");
+				return (ARCHIVE_FATAL);
+			}
 		}
 	}
 	if (data->uncompressed == NULL) {
-		data->uncompressed_buffer_size = BLOCK_SIZE;
+		data->uncompressed_buffer_size =
+		    (size_t)BLOCK_SIZE * data->nblocks;
 		data->uncompressed = (unsigned char *)
 		    malloc(data->uncompressed_buffer_size);
 		if (data->uncompressed == NULL) {
@@ -277,111 +261,118 @@ archive_write_lzop_open(struct archive_write_filter *f)
 			    "Can't allocate data for compression buffer");
 			return (ARCHIVE_FATAL);
 		}
-		data->uncompressed_avail_bytes = BLOCK_SIZE;
+		data->uncompressed_avail_bytes =
+		    data->uncompressed_buffer_size;
 	}
 	return (ARCHIVE_OK);
 }
 
 static int
-make_header(struct archive_write_filter *f)
+write_header(struct archive_write_filter *f)
 {
 	struct write_lzop *data = (struct write_lzop *)f->data;
+	unsigned char h[sizeof(header)];
 	int64_t t;
 	uint32_t checksum;
 
-	memcpy(data->compressed, header, sizeof(header));
+	memcpy(h, header, sizeof(header));
 	/* Overwrite library version. */
-	data->compressed[HEADER_LIBVERSION] = (unsigned char )
-	    (lzo_version() >> 8) & 0xff;
-	data->compressed[HEADER_LIBVERSION + 1] = (unsigned char )
-	    lzo_version() & 0xff;
+	archive_be16enc(&h[HEADER_LIBVERSION], LZO_LIBVERSION);
 	/* Overwrite method and level. */
-	data->compressed[HEADER_METHOD] = (unsigned char)data->method;
-	data->compressed[HEADER_LEVEL] = data->level;
+	h[HEADER_METHOD] = (unsigned char)data->method;
+	h[HEADER_LEVEL] = data->level;
 	/* Overwrite mtime with current time. */
 	t = (int64_t)time(NULL);
-	archive_be32enc(&data->compressed[HEADER_MTIME_LOW],
+	archive_be32enc(&h[HEADER_MTIME_LOW],
 	    (uint32_t)(t & 0xffffffff));
-	archive_be32enc(&data->compressed[HEADER_MTIME_HIGH],
+	archive_be32enc(&h[HEADER_MTIME_HIGH],
 	    (uint32_t)((t >> 32) & 0xffffffff));
 	/* Overwrite header checksum with calculated value. */
-	checksum = lzo_adler32(1, data->compressed + HEADER_VERSION,
-			(lzo_uint)(HEADER_H_CHECKSUM - HEADER_VERSION));
-	archive_be32enc(&data->compressed[HEADER_H_CHECKSUM], checksum);
-	return (sizeof(header));
+	checksum = adler32(1, h + HEADER_VERSION,
+			HEADER_H_CHECKSUM - HEADER_VERSION);
+	archive_be32enc(&h[HEADER_H_CHECKSUM], checksum);
+	return (__archive_write_filter(f->next_filter, h, sizeof(h)));
+}
+
+static void
+compress_block(void *arg)
+{
+	struct lzop_block *b = (struct lzop_block *)arg;
+
+	__archive_lzo1x_compress(b->in, b->in_size, b->out, &b->out_size,
+	    b->level, b->work_buffer);
+	/* Store the checksum of the uncompressed data. */
+	b->checksum = adler32(1, b->in, (unsigned)b->in_size);
 }
 
 static int
 drive_compressor(struct archive_write_filter *f)
 {
 	struct write_lzop *data = (struct write_lzop *)f->data;
-	unsigned char *p;
-	const int block_info_bytes = 12;
-	int header_bytes, r;
-	lzo_uint usize, csize;
-	uint32_t checksum;
+	struct lzop_block *b;
+	unsigned char info[BLOCK_INfO_SIZE];
+	size_t size, used;
+	int i, n, r;
 
 	if (!data->header_written) {
-		header_bytes = make_header(f);
+		r = write_header(f);
+		if (r != ARCHIVE_OK)
+			return (ARCHIVE_FATAL);
 		data->header_written = 1;
-	} else
-		header_bytes = 0;
-	p = data->compressed;
-
-	usize = (lzo_uint)
-	    (data->uncompressed_buffer_size - data->uncompressed_avail_bytes);
-	csize = 0;
-	switch (data->method) {
-	default:
-	case METHOD_LZO1X_1:
-		r = lzo1x_1_compress(data->uncompressed, usize,
-			p + header_bytes + block_info_bytes, &csize,
-			data->work_buffer);
-		break;
-	case METHOD_LZO1X_1_15:
-		r = lzo1x_1_15_compress(data->uncompressed, usize,
-			p + header_bytes + block_info_bytes, &csize,
-			data->work_buffer);
-		break;
-	case METHOD_LZO1X_999:
-		r = lzo1x_999_compress_level(data->uncompressed, usize,
-			p + header_bytes + block_info_bytes, &csize,
-			data->work_buffer, NULL, 0, 0, data->level);
-		break;
 	}
-	if (r != LZO_E_OK) {
-		archive_set_error(f->archive, ARCHIVE_ERRNO_MISC,
-		    "Lzop compression failed: returned status %d", r);
-		return (ARCHIVE_FATAL);
+
+	used = data->uncompressed_buffer_size - data->uncompressed_avail_bytes;
+	for (n = 0; used > 0; n++) {
+		b = &data->blocks[n];
+		size = used < BLOCK_SIZE ? used : BLOCK_SIZE;
+		b->in = data->uncompressed + (size_t)n * BLOCK_SIZE;
+		b->in_size = size;
+		b->level = data->level;
+		used -= size;
+		if (n > 0)
+			(void)__archive_thread_create(&b->thread,
+			    compress_block, b);
+	}
+	/* The first block is compressed here, as is any block no
+	 * thread could be started for. */
+	for (i = 0; i < n; i++) {
+		b = &data->blocks[i];
+		if (b->thread == NULL)
+			compress_block(b);
+	}
+	for (i = 0; i < n; i++) {
+		__archive_thread_join(data->blocks[i].thread);
+		data->blocks[i].thread = NULL;
 	}
 
-	/* Store uncompressed size. */
-	archive_be32enc(p + header_bytes, (uint32_t)usize);
-	/* Store the checksum of the uncompressed data. */
-	checksum = lzo_adler32(1, data->uncompressed, usize);
-	archive_be32enc(p + header_bytes + 8, checksum);
-
-	if (csize < usize) {
-		/* Store compressed size. */
-		archive_be32enc(p + header_bytes + 4, (uint32_t)csize);
-		r = __archive_write_filter(f->next_filter, data->compressed,
-			header_bytes + block_info_bytes + csize);
-	} else {
-		/*
-		 * This case, we output uncompressed data instead.
-		 */
-		/* Store uncompressed size as compressed size. */
-		archive_be32enc(p + header_bytes + 4, (uint32_t)usize);
-		r = __archive_write_filter(f->next_filter, data->compressed,
-			header_bytes + block_info_bytes);
+	for (i = 0; i < n; i++) {
+		b = &data->blocks[i];
+		/* Store uncompressed size. */
+		archive_be32enc(info, (uint32_t)b->in_size);
+		archive_be32enc(info + 8, b->checksum);
+		if (b->out_size < b->in_size) {
+			/* Store compressed size. */
+			archive_be32enc(info + 4, (uint32_t)b->out_size);
+			r = __archive_write_filter(f->next_filter, info,
+			    sizeof(info));
+			if (r == ARCHIVE_OK)
+				r = __archive_write_filter(f->next_filter,
+				    b->out, b->out_size);
+		} else {
+			/*
+			 * This case, we output uncompressed data instead.
+			 */
+			/* Store uncompressed size as compressed size. */
+			archive_be32enc(info + 4, (uint32_t)b->in_size);
+			r = __archive_write_filter(f->next_filter, info,
+			    sizeof(info));
+			if (r == ARCHIVE_OK)
+				r = __archive_write_filter(f->next_filter,
+				    b->in, b->in_size);
+		}
 		if (r != ARCHIVE_OK)
 			return (ARCHIVE_FATAL);
-		r = __archive_write_filter(f->next_filter, data->uncompressed,
-			usize);
 	}
-
-	if (r != ARCHIVE_OK)
-		return (ARCHIVE_FATAL);
 	return (ARCHIVE_OK);
 }
 
@@ -412,7 +403,8 @@ archive_write_lzop_write(struct archive_write_filter *f,
 
 		r = drive_compressor(f);
 		if (r != ARCHIVE_OK) return (r);
-		data->uncompressed_avail_bytes = BLOCK_SIZE;
+		data->uncompressed_avail_bytes =
+		    data->uncompressed_buffer_size;
 	} while (length);
 
 	return (ARCHIVE_OK);
@@ -425,7 +417,7 @@ archive_write_lzop_close(struct archive_write_filter *f)
 	const uint32_t endmark = 0;
 	int r;
 
-	if (data->uncompressed_avail_bytes < BLOCK_SIZE) {
+	if (data->uncompressed_avail_bytes < data->uncompressed_buffer_size) {
 		/* Compress and output remaining data. */
 		r = drive_compressor(f);
 		if (r != ARCHIVE_OK)
@@ -435,43 +427,3 @@ archive_write_lzop_close(struct archive_write_filter *f)
 	 * compressed block. */
 	return __archive_write_filter(f->next_filter, &endmark, sizeof(endmark));
 }
-
-#else
-static int
-archive_write_lzop_open(struct archive_write_filter *f)
-{
-	struct write_lzop *data = (struct write_lzop *)f->data;
-	struct archive_string as;
-	int r;
-
-	archive_string_init(&as);
-	archive_strcpy(&as, "lzop");
-	/* Specify compression level. */
-	if (data->compression_level > 0) {
-		archive_strappend_char(&as, ' ');
-		archive_strappend_char(&as, '-');
-		archive_strappend_char(&as, '0' + data->compression_level);
-	}
-
-	r = __archive_write_program_open(f, data->pdata, as.s);
-	archive_string_free(&as);
-	return (r);
-}
-
-static int
-archive_write_lzop_write(struct archive_write_filter *f,
-    const void *buff, size_t length)
-{
-	struct write_lzop *data = (struct write_lzop *)f->data;
-
-	return __archive_write_program_write(f, data->pdata, buff, length);
-}
-
-static int
-archive_write_lzop_close(struct archive_write_filter *f)
-{
-	struct write_lzop *data = (struct write_lzop *)f->data;
-
-	return __archive_write_program_close(f, data->pdata);
-}
-#endif
@@ -68,8 +68,19 @@ struct archive_write_program_data {
 	char		*child_buf;
 	size_t		 child_buf_len, child_buf_avail;
 	char		*program_name;
+
+	/*
+	 * With a writer, data is gathered in one input buffer while
+	 * the other is fed to the child on a worker thread.
+	 */
+	struct archive_child_writer *writer;
+	char		*in_buf[2];
+	size_t		 in_buf_len, in_buf_avail, in_flight;
+	int		 in_idx;
 };
 
+#define PROGRAM_BUF_SIZE	262144
+
 struct private_data {
 	struct archive_write_program_data *pdata;
 	struct archive_string description;
@@ -195,8 +206,10 @@ __archive_write_program_free(struct archive_write_program_data *data)
 {
 
 	if (data) {
+		__archive_child_writer_free(data->writer);
 		free(data->program_name);
 		free(data->child_buf);
+		free(data->in_buf[0]);
 		free(data);
 	}
 	return (ARCHIVE_OK);
@@ -209,7 +222,7 @@ __archive_write_program_open(struct archive_write_filter *f,
 	int ret;
 
 	if (data->child_buf == NULL) {
-		data->child_buf_len = 65536;
+		data->child_buf_len = PROGRAM_BUF_SIZE;
 		data->child_buf_avail = 0;
 		data->child_buf = malloc(data->child_buf_len);
 
@@ -227,6 +240,17 @@ __archive_write_program_open(struct archive_write_filter *f,
 		    "Can't launch external program: %s", cmd);
 		return (ARCHIVE_FATAL);
 	}
+
+	/* If there is no writer, child_write() feeds the child itself. */
+	if (data->in_buf[0] == NULL) {
+		data->in_buf_len = PROGRAM_BUF_SIZE;
+		data->in_buf[0] = malloc(2 * data->in_buf_len);
+		data->in_buf[1] = data->in_buf[0] + data->in_buf_len;
+	}
+	data->in_buf_avail = 0;
+	data->in_idx = 0;
+	if (data->in_buf[0] != NULL)
+		data->writer = __archive_child_writer_new(data->child_stdin);
 	return (ARCHIVE_OK);
 }
 
@@ -295,6 +319,105 @@ child_write(struct archive_write_filter *f,
 	}
 }
 
+/*
+ * Pass whatever output the child has ready on to the next filter.
+ * Returns -1 on error, 0 if the child has closed its output and 1
+ * otherwise.
+ */
+static int
+child_drain(struct archive_write_filter *f,
+    struct archive_write_program_data *data)
+{
+	ssize_t ret;
+
+	while (data->child_stdout != -1) {
+		do {
+			ret = read(data->child_stdout,
+			    data->child_buf + data->child_buf_avail,
+			    data->child_buf_len - data->child_buf_avail);
+		} while (ret == -1 && errno == EINTR);
+
+		if (ret == 0 || (ret == -1 && errno == EPIPE)) {
+			close(data->child_stdout);
+			data->child_stdout = -1;
+			break;
+		}
+		if (ret == -1 && errno == EAGAIN)
+			return (1);
+		if (ret == -1)
+			return (-1);
+
+		data->child_buf_avail += ret;
+
+		ret = __archive_write_filter(f->next_filter,
+		    data->child_buf, data->child_buf_avail);
+		if (ret != ARCHIVE_OK)
+			return (-1);
+		data->child_buf_avail = 0;
+	}
+	return (0);
+}
+
+/*
+ * Wait for the writer to feed its buffer to the child, passing the
+ * child's output on meanwhile so that it doesn't stall.
+ */
+static int
+child_writer_wait(struct archive_write_filter *f,
+    struct archive_write_program_data *data)
+{
+	ssize_t ret;
+
+	while (!__archive_child_writer_done(data->writer)) {
+		if (child_drain(f, data) < 0)
+			return (-1);
+		if (!__archive_child_writer_done(data->writer))
+			__archive_child_writer_wait(data->writer,
+			    data->child_stdout);
+	}
+	ret = __archive_child_writer_finish(data->writer);
+	/* The child quit reading before it got all of it. */
+	if (ret != (ssize_t)data->in_flight)
+		return (-1);
+	return (0);
+}
+
+/*
+ * Hand the data gathered so far to the writer, once it is done with
+ * the previous buffer.
+ */
+static int
+child_flush(struct archive_write_filter *f,
+    struct archive_write_program_data *data)
+{
+	const char *buf;
+	size_t length;
+	ssize_t ret;
+
+	if (__archive_child_writer_busy(data->writer) &&
+	    child_writer_wait(f, data) != 0)
+		return (-1);
+	if (data->in_buf_avail == 0)
+		return (0);
+	buf = data->in_buf[data->in_idx];
+	length = data->in_buf_avail;
+	data->in_buf_avail = 0;
+	if (__archive_child_writer_start(data->writer, buf, length) == 0) {
+		data->in_flight = length;
+		data->in_idx ^= 1;
+		return (0);
+	}
+	/* No thread; write it here. */
+	while (length > 0) {
+		ret = child_write(f, data, buf, length);
+		if (ret == -1 || ret == 0)
+			return (-1);
+		length -= ret;
+		buf += ret;
+	}
+	return (0);
+}
+
 /*
  * Write data to the filter stream.
  */
@@ -309,6 +432,27 @@ __archive_write_program_write(struct archive_write_filter *f,
 		return (ARCHIVE_OK);
 
 	buf = buff;
+	if (data->writer != NULL) {
+		while (length > 0) {
+			size_t n = data->in_buf_len - data->in_buf_avail;
+
+			if (n > length)
+				n = length;
+			memcpy(data->in_buf[data->in_idx] + data->in_buf_avail,
+			    buf, n);
+			data->in_buf_avail += n;
+			length -= n;
+			buf += n;
+			if (data->in_buf_avail == data->in_buf_len &&
+			    child_flush(f, data) != 0) {
+				archive_set_error(f->archive, EIO,
+				    "Can't write to program: %s",
+				    data->program_name);
+				return (ARCHIVE_FATAL);
+			}
+		}
+		return (ARCHIVE_OK);
+	}
 	while (length > 0) {
 		ret = child_write(f, data, buf, length);
 		if (ret == -1 || ret == 0) {
@@ -337,8 +481,21 @@ __archive_write_program_close(struct archive_write_filter *f,
 		return ARCHIVE_OK;
 
 	ret = 0;
+	if (data->writer != NULL) {
+		/* Feed the child the rest of the data. */
+		if (child_flush(f, data) != 0 ||
+		    (__archive_child_writer_busy(data->writer) &&
+		    child_writer_wait(f, data) != 0)) {
+			archive_set_error(f->archive, EIO,
+			    "Can't write to program: %s", data->program_name);
+			ret = ARCHIVE_FATAL;
+			goto cleanup;
+		}
+	}
 	close(data->child_stdin);
 	data->child_stdin = -1;
+	if (data->child_stdout == -1)
+		goto cleanup;
 	fcntl(data->child_stdout, F_SETFL, 0);
 
 	for (;;) {
@@ -370,6 +527,17 @@ __archive_write_program_close(struct archive_write_filter *f,
 
 cleanup:
 	/* Shut down the child. */
+	if (__archive_child_writer_busy(data->writer)) {
+		/* Stop reading first, so that a child blocked on its
+		 * output quits instead of waiting for more input. */
+		if (data->child_stdout != -1) {
+			close(data->child_stdout);
+			data->child_stdout = -1;
+		}
+		__archive_child_writer_finish(data->writer);
+	}
+	__archive_child_writer_free(data->writer);
+	data->writer = NULL;
 	if (data->child_stdin != -1)
 		close(data->child_stdin);
 	if (data->child_stdout != -1)
@@ -47,6 +47,24 @@
 #define SET_KEYS	\
 	(F_FLAGS | F_GID | F_GNAME | F_MODE | F_TYPE | F_UID | F_UNAME)
 
+/*
+ * With the built-in SHA-1 and SHA-256, the contents of small files are
+ * kept until a batch of them can be hashed side by side by
+ * __archive_sha1_multi() and __archive_sha256_multi().  Nothing is
+ * written out before the archive is closed, so the digests are not
+ * needed any sooner.
+ */
+#if defined(ARCHIVE_CRYPTO_SHA1_BUILTIN) || \
+    defined(ARCHIVE_CRYPTO_SHA256_BUILTIN)
+#define	BATCH_DIGESTS	1
+#define	BATCH_FILES	64		/* Files per batch. */
+#define	BATCH_FILE_SIZE	(64 * 1024)	/* Largest file batched. */
+#define	BATCH_BYTES	(1024 * 1024)	/* Data per batch. */
+#define	BATCHED(f)	(mtree->batch.keys & (f))
+#else
+#define	BATCHED(f)	0
+#endif
+
 struct attr_counter {
 	struct attr_counter *prev;
 	struct attr_counter *next;
@@ -167,6 +185,18 @@ struct mtree_writer {
 #endif
 #ifdef ARCHIVE_HAS_SHA512
 	archive_sha512_ctx sha512ctx;
+#endif
+#ifdef BATCH_DIGESTS
+	struct {
+		int			 keys;	/* Of the current entry. */
+		int			 count;
+		struct archive_string	 data;
+		struct {
+			struct reg_info	*reg;
+			int		 keys;
+			size_t		 offset, length;
+		}			 file[BATCH_FILES];
+	} batch;
 #endif
 	/* Keyword options */
 	int keys;
@@ -245,6 +275,9 @@ static void sum_init(struct mtree_writer *);
 static void sum_update(struct mtree_writer *, const void *, size_t);
 static void sum_final(struct mtree_writer *, struct reg_info *);
 static void sum_write(struct archive_string *, struct reg_info *);
+#ifdef BATCH_DIGESTS
+static void batch_flush(struct mtree_writer *);
+#endif
 static int write_mtree_entry(struct archive_write *, struct mtree_entry *);
 static int write_dot_dot_entry(struct archive_write *, struct mtree_entry *);
 
@@ -1259,6 +1292,9 @@ archive_write_mtree_close(struct archive_write *a)
 	struct mtree_writer *mtree= a->format_data;
 	int ret;
 
+#ifdef BATCH_DIGESTS
+	batch_flush(mtree);
+#endif
 	if (mtree->root != NULL) {
 		ret = write_mtree_entry_tree(a);
 		if (ret != ARCHIVE_OK)
@@ -1302,6 +1338,9 @@ archive_write_mtree_free(struct archive_write *a)
 	archive_string_free(&mtree->cur_dirstr);
 	archive_string_free(&mtree->ebuf);
 	archive_string_free(&mtree->buf);
+#ifdef BATCH_DIGESTS
+	archive_string_free(&mtree->batch.data);
+#endif
 	attr_counter_set_free(mtree);
 	free(mtree);
 	a->format_data = NULL;
@@ -1548,6 +1587,23 @@ sum_init(struct mtree_writer *mtree)
 			mtree->keys &= ~F_SHA512;/* Not supported. */
 	}
 #endif
+#ifdef BATCH_DIGESTS
+	/* Two lanes, as with the SHA extensions, do not gain enough
+	 * to pay for copying the data. */
+	mtree->batch.keys = 0;
+	if (mtree->entry_bytes_remaining <= BATCH_FILE_SIZE) {
+#ifdef ARCHIVE_CRYPTO_SHA1_BUILTIN
+		if (__archive_sha1_multi_lanes() >= 4)
+			mtree->batch.keys |= mtree->compute_sum & F_SHA1;
+#endif
+#ifdef ARCHIVE_CRYPTO_SHA256_BUILTIN
+		if (__archive_sha256_multi_lanes() >= 4)
+			mtree->batch.keys |= mtree->compute_sum & F_SHA256;
+#endif
+	}
+	mtree->batch.file[mtree->batch.count].offset =
+	    mtree->batch.data.length;
+#endif
 }
 
 static void
@@ -1578,16 +1634,23 @@ sum_update(struct mtree_writer *mtree, const void *buff, size_t n)
 			~AE_MSET_DIGEST_RMD160;
 	}
 #endif
+#ifdef BATCH_DIGESTS
+	if (mtree->batch.keys)
+		archive_array_append(&mtree->batch.data,
+		    (const char *)buff, n);
+#endif
 #ifdef ARCHIVE_HAS_SHA1
 	if (mtree->compute_sum & F_SHA1) {
-		archive_sha1_update(&mtree->sha1ctx, buff, n);
+		if (!BATCHED(F_SHA1))
+			archive_sha1_update(&mtree->sha1ctx, buff, n);
 		mtree->mtree_entry->reg_info->mset_digest &=
 			~AE_MSET_DIGEST_SHA1;
 	}
 #endif
 #ifdef ARCHIVE_HAS_SHA256
 	if (mtree->compute_sum & F_SHA256) {
-		archive_sha256_update(&mtree->sha256ctx, buff, n);
+		if (!BATCHED(F_SHA256))
+			archive_sha256_update(&mtree->sha256ctx, buff, n);
 		mtree->mtree_entry->reg_info->mset_digest &=
 			~AE_MSET_DIGEST_SHA256;
 	}
@@ -1611,6 +1674,14 @@ sum_update(struct mtree_writer *mtree, const void *buff, size_t n)
 static void
 sum_final(struct mtree_writer *mtree, struct reg_info *reg)
 {
+#ifdef BATCH_DIGESTS
+	int i, keys = 0;
+
+	/* Forget an earlier entry for the same file. */
+	for (i = 0; i < mtree->batch.count; i++)
+		if (mtree->batch.file[i].reg == reg)
+			mtree->batch.file[i].keys = 0;
+#endif
 
 	if (mtree->compute_sum & F_CKSUM) {
 		uint64_t len;
@@ -1633,15 +1704,25 @@ sum_final(struct mtree_writer *mtree, struct reg_info *reg)
 #endif
 #ifdef ARCHIVE_HAS_SHA1
 	if ((mtree->compute_sum & F_SHA1)
-		&& !(reg->mset_digest & AE_MSET_DIGEST_SHA1))
-
+		&& !(reg->mset_digest & AE_MSET_DIGEST_SHA1)) {
+#ifdef BATCH_DIGESTS
+		if (BATCHED(F_SHA1))
+			keys |= F_SHA1;
+		else
+#endif
 		archive_sha1_final(&mtree->sha1ctx, reg->digest.sha1);
+	}
 #endif
 #ifdef ARCHIVE_HAS_SHA256
 	if ((mtree->compute_sum & F_SHA256)
-		&& !(reg->mset_digest & AE_MSET_DIGEST_SHA256))
-
+		&& !(reg->mset_digest & AE_MSET_DIGEST_SHA256)) {
+#ifdef BATCH_DIGESTS
+		if (BATCHED(F_SHA256))
+			keys |= F_SHA256;
+		else
+#endif
 		archive_sha256_final(&mtree->sha256ctx, reg->digest.sha256);
+	}
 #endif
 #ifdef ARCHIVE_HAS_SHA384
 	if ((mtree->compute_sum & F_SHA384)
@@ -1657,8 +1738,74 @@ sum_final(struct mtree_writer *mtree, struct reg_info *reg)
 #endif
 	/* Save what types of sum are computed. */
 	reg->compute_sum = mtree->compute_sum;
+#ifdef BATCH_DIGESTS
+	i = mtree->batch.count;
+	if (keys == 0) {
+		/* Drop data that will not be hashed. */
+		mtree->batch.data.length = mtree->batch.file[i].offset;
+		return;
+	}
+	mtree->batch.file[i].reg = reg;
+	mtree->batch.file[i].keys = keys;
+	mtree->batch.file[i].length =
+	    mtree->batch.data.length - mtree->batch.file[i].offset;
+	if (++mtree->batch.count == BATCH_FILES ||
+	    mtree->batch.data.length >= BATCH_BYTES)
+		batch_flush(mtree);
+#endif
+}
+
+#ifdef BATCH_DIGESTS
+/* Gather the batched files that need the digest key. */
+static int
+batch_collect(struct mtree_writer *mtree, int key, const void **msgs,
+    size_t *lens, struct reg_info **regs)
+{
+	int i, n = 0;
+
+	for (i = 0; i < mtree->batch.count; i++) {
+		if ((mtree->batch.file[i].keys & key) == 0)
+			continue;
+		msgs[n] = mtree->batch.data.s + mtree->batch.file[i].offset;
+		lens[n] = mtree->batch.file[i].length;
+		regs[n++] = mtree->batch.file[i].reg;
+	}
+	return (n);
 }
 
+static void
+batch_flush(struct mtree_writer *mtree)
+{
+	const void *msgs[BATCH_FILES];
+	size_t lens[BATCH_FILES];
+	struct reg_info *regs[BATCH_FILES];
+	int i, n;
+
+#ifdef ARCHIVE_CRYPTO_SHA1_BUILTIN
+	n = batch_collect(mtree, F_SHA1, msgs, lens, regs);
+	if (n > 0) {
+		uint8_t md[BATCH_FILES][ARCHIVE_SHA1_DIGEST_SIZE];
+
+		__archive_sha1_multi(n, msgs, lens, md);
+		for (i = 0; i < n; i++)
+			memcpy(regs[i]->digest.sha1, md[i], sizeof(md[i]));
+	}
+#endif
+#ifdef ARCHIVE_CRYPTO_SHA256_BUILTIN
+	n = batch_collect(mtree, F_SHA256, msgs, lens, regs);
+	if (n > 0) {
+		uint8_t md[BATCH_FILES][ARCHIVE_SHA256_DIGEST_SIZE];
+
+		__archive_sha256_multi(n, msgs, lens, md);
+		for (i = 0; i < n; i++)
+			memcpy(regs[i]->digest.sha256, md[i], sizeof(md[i]));
+	}
+#endif
+	mtree->batch.count = 0;
+	archive_string_empty(&mtree->batch.data);
+}
+#endif
+
 #if defined(ARCHIVE_HAS_MD5) || defined(ARCHIVE_HAS_RMD160) || \
     defined(ARCHIVE_HAS_SHA1) || defined(ARCHIVE_HAS_SHA256) || \
     defined(ARCHIVE_HAS_SHA384) || defined(ARCHIVE_HAS_SHA512)
@@ -41,4 +41,37 @@ __archive_create_child(const char *cmd, int *child_stdin, int *child_stdout,
 void
 __archive_check_child(int in, int out);
 
+/*
+ * Feeds a buffer to the child's stdin on a worker thread, so that the
+ * caller can go on reading the child's stdout in the meantime.
+ *
+ * __archive_child_writer_new() returns NULL if this isn't possible;
+ * callers then fall back to __archive_check_child().  While a buffer
+ * is being written, the caller must leave it alone and should wait with
+ * __archive_child_writer_wait() rather than __archive_check_child().
+ */
+struct archive_child_writer;
+
+struct archive_child_writer *
+__archive_child_writer_new(int in);
+
+int
+__archive_child_writer_start(struct archive_child_writer *,
+	const void *buff, size_t length);
+
+int
+__archive_child_writer_busy(struct archive_child_writer *);
+
+int
+__archive_child_writer_done(struct archive_child_writer *);
+
+ssize_t
+__archive_child_writer_finish(struct archive_child_writer *);
+
+void
+__archive_child_writer_wait(struct archive_child_writer *, int out);
+
+void
+__archive_child_writer_free(struct archive_child_writer *);
+
 #endif
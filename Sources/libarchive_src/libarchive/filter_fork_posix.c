@@ -67,9 +67,28 @@
 
 #include "archive.h"
 #include "archive_cmdline_private.h"
+#include "archive_thread_private.h"
 
 #include "filter_fork.h"
 
+/*
+ * Ask for pipes larger than the default 64 KiB so that the child and
+ * we can each move a lot of data per system call.  Linux caps this
+ * at /proc/sys/fs/pipe-max-size, which is 1 MiB by default; if we
+ * can't get it the pipe simply keeps its size.
+ */
+#define CHILD_PIPE_SIZE	(1024 * 1024)
+
+static void
+set_pipe_size(int fd)
+{
+#ifdef F_SETPIPE_SZ
+	fcntl(fd, F_SETPIPE_SZ, CHILD_PIPE_SIZE);
+#else
+	(void)fd; /* UNUSED */
+#endif
+}
+
 int
 __archive_create_child(const char *cmd, int *child_stdin, int *child_stdout,
 		pid_t *out_child)
@@ -104,6 +123,8 @@ __archive_create_child(const char *cmd, int *child_stdin, int *child_stdout,
 		close(stdout_pipe[1]);
 		stdout_pipe[1] = tmp;
 	}
+	set_pipe_size(stdin_pipe[1]);
+	set_pipe_size(stdout_pipe[0]);
 
 #if HAVE_POSIX_SPAWNP
 
@@ -235,4 +256,223 @@ __archive_check_child(int in, int out)
 #endif
 }
 
+#if defined(HAVE_POLL) && (defined(HAVE_POLL_H) || defined(HAVE_SYS_POLL_H))
+
+struct archive_child_writer {
+	struct archive_thread	*thread;
+	int			 in;
+	/* The thread writes a byte here when it is done. */
+	int			 notify[2];
+	int			 busy;
+	int			 done;
+	const char		*buff;
+	size_t			 length;
+	size_t			 written;
+	int			 error;
+};
+
+struct archive_child_writer *
+__archive_child_writer_new(int in)
+{
+	struct archive_child_writer *w;
+
+	w = calloc(1, sizeof(*w));
+	if (w == NULL)
+		return (NULL);
+	if (pipe(w->notify) == -1) {
+		free(w);
+		return (NULL);
+	}
+	fcntl(w->notify[0], F_SETFD, FD_CLOEXEC);
+	fcntl(w->notify[1], F_SETFD, FD_CLOEXEC);
+	fcntl(w->notify[0], F_SETFL, O_NONBLOCK);
+	w->in = in;
+	return (w);
+}
+
+static void
+child_writer_run(void *arg)
+{
+	struct archive_child_writer *w = arg;
+	struct pollfd fds;
+	ssize_t ret;
+
+	while (w->written < w->length) {
+		ret = write(w->in, w->buff + w->written,
+		    w->length - w->written);
+		if (ret > 0) {
+			w->written += ret;
+			continue;
+		}
+		if (ret == -1 && errno == EINTR)
+			continue;
+		if (ret == -1 && errno == EAGAIN) {
+			/* Our end of the pipe is non-blocking. */
+			fds.fd = w->in;
+			fds.events = POLLOUT;
+			fds.revents = 0;
+			poll(&fds, 1, -1);
+			/* Don't write into a pipe the child has closed. */
+			if ((fds.revents & (POLLERR | POLLHUP)) &&
+			    !(fds.revents & POLLOUT)) {
+				w->error = EPIPE;
+				break;
+			}
+			continue;
+		}
+		w->error = (ret == -1) ? errno : EPIPE;
+		break;
+	}
+	do {
+		ret = write(w->notify[1], "", 1);
+	} while (ret == -1 && errno == EINTR);
+}
+
+/*
+ * Start writing a buffer; returns non-zero if no thread could be
+ * started, in which case the caller has to write it itself.
+ */
+int
+__archive_child_writer_start(struct archive_child_writer *w,
+    const void *buff, size_t length)
+{
+	w->buff = buff;
+	w->length = length;
+	w->written = 0;
+	w->error = 0;
+	w->done = 0;
+	if (__archive_thread_create(&w->thread, child_writer_run, w) != 0)
+		return (-1);
+	w->busy = 1;
+	return (0);
+}
+
+int
+__archive_child_writer_busy(struct archive_child_writer *w)
+{
+	return (w != NULL && w->busy);
+}
+
+/* Check without blocking whether the buffer has been written. */
+int
+__archive_child_writer_done(struct archive_child_writer *w)
+{
+	char c;
+
+	if (!w->done && read(w->notify[0], &c, 1) == 1)
+		w->done = 1;
+	return (w->done);
+}
+
+/*
+ * Wait for the buffer to be written and return how much of it was,
+ * or -1 with errno set if none of it could be.
+ */
+ssize_t
+__archive_child_writer_finish(struct archive_child_writer *w)
+{
+	char c;
+
+	__archive_thread_join(w->thread);
+	w->thread = NULL;
+	w->busy = 0;
+	if (!w->done) {
+		/* The thread has written its byte before finishing. */
+		while (read(w->notify[0], &c, 1) == -1 && errno == EINTR)
+			continue;
+	}
+	w->done = 0;
+	if (w->written == 0 && w->error != 0) {
+		errno = w->error;
+		return (-1);
+	}
+	return ((ssize_t)w->written);
+}
+
+/* Block until the child has output ready or the buffer is written. */
+void
+__archive_child_writer_wait(struct archive_child_writer *w, int out)
+{
+	struct pollfd fds[2];
+	int idx;
+
+	idx = 0;
+	fds[idx].fd = w->notify[0];
+	fds[idx].events = POLLIN;
+	++idx;
+	if (out != -1) {
+		fds[idx].fd = out;
+		fds[idx].events = POLLIN;
+		++idx;
+	}
+	poll(fds, idx, -1);
+}
+
+void
+__archive_child_writer_free(struct archive_child_writer *w)
+{
+	if (w == NULL)
+		return;
+	if (w->busy)
+		__archive_child_writer_finish(w);
+	close(w->notify[0]);
+	close(w->notify[1]);
+	free(w);
+}
+
+#else /* !HAVE_POLL */
+
+struct archive_child_writer *
+__archive_child_writer_new(int in)
+{
+	(void)in; /* UNUSED */
+	return (NULL);
+}
+
+int
+__archive_child_writer_start(struct archive_child_writer *w,
+    const void *buff, size_t length)
+{
+	(void)w; /* UNUSED */
+	(void)buff; /* UNUSED */
+	(void)length; /* UNUSED */
+	return (-1);
+}
+
+int
+__archive_child_writer_busy(struct archive_child_writer *w)
+{
+	(void)w; /* UNUSED */
+	return (0);
+}
+
+int
+__archive_child_writer_done(struct archive_child_writer *w)
+{
+	(void)w; /* UNUSED */
+	return (1);
+}
+
+ssize_t
+__archive_child_writer_finish(struct archive_child_writer *w)
+{
+	(void)w; /* UNUSED */
+	return (0);
+}
+
+void
+__archive_child_writer_wait(struct archive_child_writer *w, int out)
+{
+	(void)w; /* UNUSED */
+	(void)out; /* UNUSED */
+}
+
+void
+__archive_child_writer_free(struct archive_child_writer *w)
+{
+	(void)w; /* UNUSED */
+}
+
+#endif /* HAVE_POLL */
+
 #endif /* defined(HAVE_PIPE) && defined(HAVE_VFORK) && defined(HAVE_FCNTL) */
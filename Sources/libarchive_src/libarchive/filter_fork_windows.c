@@ -242,4 +242,56 @@ __archive_check_child(int in, int out)
 	Sleep(100);
 }
 
+/* Child pipes are only fed from a worker thread on POSIX systems. */
+struct archive_child_writer *
+__archive_child_writer_new(int in)
+{
+	(void)in; /* UNUSED */
+	return (NULL);
+}
+
+int
+__archive_child_writer_start(struct archive_child_writer *w,
+    const void *buff, size_t length)
+{
+	(void)w; /* UNUSED */
+	(void)buff; /* UNUSED */
+	(void)length; /* UNUSED */
+	return (-1);
+}
+
+int
+__archive_child_writer_busy(struct archive_child_writer *w)
+{
+	(void)w; /* UNUSED */
+	return (0);
+}
+
+int
+__archive_child_writer_done(struct archive_child_writer *w)
+{
+	(void)w; /* UNUSED */
+	return (1);
+}
+
+ssize_t
+__archive_child_writer_finish(struct archive_child_writer *w)
+{
+	(void)w; /* UNUSED */
+	return (0);
+}
+
+void
+__archive_child_writer_wait(struct archive_child_writer *w, int out)
+{
+	(void)w; /* UNUSED */
+	(void)out; /* UNUSED */
+}
+
+void
+__archive_child_writer_free(struct archive_child_writer *w)
+{
+	(void)w; /* UNUSED */
+}
+
 #endif /* _WIN32 && !__CYGWIN__ */
@@ -0,0 +1,208 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * Shared code for the tests of the "threads" option of the readers:
+ * read an archive sequentially and with threads, and check that every
+ * entry comes back the same.
+ */
+
+unsigned long
+read_threads_checksum(unsigned long sum, const void *buff, size_t size)
+{
+	const unsigned char *p = buff;
+
+	while (size--)
+		sum = sum * 31 + *p++;
+	return (sum);
+}
+
+/* Hand the archive out in small blocks, without any way to seek. */
+struct stream {
+	const char	*data;
+	size_t		 size;
+	size_t		 offset;
+};
+
+static la_ssize_t
+stream_read(struct archive *a, void *client_data, const void **buff)
+{
+	struct stream *s = (struct stream *)client_data;
+	size_t size = s->size - s->offset;
+
+	(void)a; /* UNUSED */
+	if (size > 1024)
+		size = 1024;
+	*buff = s->data + s->offset;
+	s->offset += size;
+	return ((la_ssize_t)size);
+}
+
+/*
+ * Read every entry of refname, or of the size bytes at data if that
+ * is not NULL, skipping the data of the entries before 'first'.
+ */
+void
+read_threads_archive(const char *refname, const void *data, size_t size,
+    const char *options, int flags, int first,
+    struct read_threads_result *res)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	struct stream s;
+	const void *buff;
+	size_t bsize;
+	int64_t offset;
+	int r;
+
+	memset(res, 0, sizeof(*res));
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	if (options != NULL)
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_set_options(a, options));
+	if (data != NULL) {
+		s.data = data;
+		s.size = size;
+		s.offset = 0;
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_open(a, &s, NULL, stream_read, NULL));
+	} else
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_open_filename(a, refname, 10240));
+	while (res->count < READ_THREADS_MAX_ENTRIES &&
+	    archive_read_next_header(a, &ae) == ARCHIVE_OK) {
+		int i = res->count++;
+
+		strncpy(res->name[i], archive_entry_pathname(ae),
+		    sizeof(res->name[i]) - 1);
+		res->size[i] = archive_entry_size(ae);
+		if (i < first || ((flags & READ_THREADS_SKIP_ODD) && (i & 1)))
+			continue;
+		while ((r = archive_read_data_block(a, &buff, &bsize,
+		    &offset)) == ARCHIVE_OK) {
+			res->sum[i] = read_threads_checksum(res->sum[i],
+			    buff, bsize);
+			if (flags & READ_THREADS_FIRST_BLOCK)
+				break;
+		}
+		res->ret[i] = r;
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_free(a));
+}
+
+/*
+ * Compare entries 'first' up to 'count', or all of them if count is
+ * -1, in which case there must be as many in both.
+ */
+void
+read_threads_compare(const char *refname, const char *options,
+    const struct read_threads_result *expect,
+    const struct read_threads_result *got, int first, int count)
+{
+	int j;
+
+	failure("%s with %s", refname, options);
+	if (count < 0) {
+		assertEqualInt(expect->count, got->count);
+		count = expect->count;
+	} else
+		assert(got->count >= count);
+	for (j = first; j < count && j < got->count; j++) {
+		failure("%s with %s, entry %d", refname, options, j);
+		assertEqualString(expect->name[j], got->name[j]);
+		assertEqualInt(expect->size[j], got->size[j]);
+		assertEqualInt(expect->ret[j], got->ret[j]);
+		/* Data that fails to verify may be cut short anywhere. */
+		if (expect->ret[j] == ARCHIVE_EOF ||
+		    expect->ret[j] == ARCHIVE_OK)
+			assert(expect->sum[j] == got->sum[j]);
+	}
+}
+
+/*
+ * Read refname sequentially and with each of the NULL-terminated
+ * options, first reading every entry in full and then with flags and
+ * READ_THREADS_SKIP_ODD, and check that all of them agree.
+ */
+void
+read_threads_verify(const char *refname, const char * const *options,
+    int flags)
+{
+	struct read_threads_result *expect, *got;
+	int i, pass;
+
+	assert((expect = malloc(sizeof(*expect))) != NULL);
+	assert((got = malloc(sizeof(*got))) != NULL);
+	for (pass = 0; pass <= 1; pass++) {
+		int f = pass ? flags | READ_THREADS_SKIP_ODD : 0;
+
+		read_threads_archive(refname, NULL, 0, NULL, f, 0, expect);
+		assert(expect->count > 0);
+		for (i = 0; options[i] != NULL; i++) {
+			read_threads_archive(refname, NULL, 0, options[i], f,
+			    0, got);
+			read_threads_compare(refname, options[i], expect, got,
+			    0, -1);
+		}
+	}
+	free(got);
+	free(expect);
+}
+
+/*
+ * Check that "<format>:threads" takes a non-negative number and
+ * nothing else.  Returns 0, having checked nothing, if support()
+ * can't enable the format.
+ */
+int
+read_threads_check_option(const char *format,
+    int (*support)(struct archive *))
+{
+	struct archive *a;
+	char opt[64];
+
+	assert((a = archive_read_new()) != NULL);
+	if (support(a) != ARCHIVE_OK) {
+		assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+		return (0);
+	}
+	snprintf(opt, sizeof(opt), "%s:threads=-1", format);
+	assertEqualIntA(a, ARCHIVE_FAILED, archive_read_set_options(a, opt));
+	snprintf(opt, sizeof(opt), "%s:threads=two", format);
+	assertEqualIntA(a, ARCHIVE_FAILED, archive_read_set_options(a, opt));
+	snprintf(opt, sizeof(opt), "%s:threads=", format);
+	assertEqualIntA(a, ARCHIVE_FAILED, archive_read_set_options(a, opt));
+	snprintf(opt, sizeof(opt), "%s:threads=0", format);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_set_options(a, opt));
+	snprintf(opt, sizeof(opt), "%s:threads=3", format);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_set_options(a, opt));
+	snprintf(opt, sizeof(opt), "%s:threads=100000", format);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_set_options(a, opt));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	return (1);
+}
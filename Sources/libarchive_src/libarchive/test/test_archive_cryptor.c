@@ -0,0 +1,357 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * Known-answer tests of the built-in AES, SHA-1 and PBKDF2, each run
+ * with the fastest code the CPU allows and with the portable code
+ * forced, and of the cryptor and HMAC interfaces on top of whichever
+ * backend this build uses.
+ */
+
+#define __LIBARCHIVE_BUILD 1
+#include "archive_aes_private.h"
+#include "archive_cryptor_private.h"
+#include "archive_hmac_private.h"
+#include "archive_sha1_private.h"
+
+static void
+unhex(uint8_t *out, const char *hex)
+{
+	unsigned v;
+
+	for (; hex[0] != '\0' && hex[1] != '\0'; hex += 2) {
+		sscanf(hex, "%2x", &v);
+		*out++ = (uint8_t)v;
+	}
+}
+
+/* Set ctr so that counter mode encrypts block itself next. */
+static void
+ctr_before(uint8_t ctr[16], const uint8_t block[16])
+{
+	int i;
+
+	memcpy(ctr, block, 16);
+	for (i = 0; i < 8; i++) {
+		if (ctr[i]-- != 0)
+			break;
+	}
+}
+
+/* FIPS-197, Appendix C. */
+static void
+aes_fips197(void)
+{
+	static const struct {
+		const char *key, *ct;
+	} kat[] = {
+	    { "000102030405060708090a0b0c0d0e0f",
+	      "69c4e0d86a7b0430d8cdb78070b4c55a" },
+	    { "000102030405060708090a0b0c0d0e0f1011121314151617",
+	      "dda97ca4864cdfe06eaf70a0ec0d7191" },
+	    { "000102030405060708090a0b0c0d0e0f101112131415161718191a1b"
+	      "1c1d1e1f",
+	      "8ea2b7ca516745bfeafc49904b496089" },
+	};
+	struct archive_aes aes;
+	uint8_t key[32], pt[16], ct[16], ctr[16], zero[16], out[16];
+	size_t i;
+
+	unhex(pt, "00112233445566778899aabbccddeeff");
+	memset(zero, 0, sizeof(zero));
+	for (i = 0; i < sizeof(kat) / sizeof(kat[0]); i++) {
+		size_t key_len = strlen(kat[i].key) / 2;
+
+		unhex(key, kat[i].key);
+		unhex(ct, kat[i].ct);
+		assertEqualInt(0,
+		    __archive_aes_set_encrypt_key(&aes, key, key_len));
+		ctr_before(ctr, pt);
+		__archive_aes_ctr_xor(&aes, ctr, zero, out, 1);
+		failure("AES-%d", (int)key_len * 8);
+		assertEqualMem(out, ct, 16);
+		assertEqualMem(ctr, pt, 16);
+	}
+	assertEqualInt(-1, __archive_aes_set_encrypt_key(&aes, key, 20));
+}
+
+/*
+ * A long run of blocks, which goes through the code that keeps
+ * several blocks in flight, matches encrypting them one at a time,
+ * including where the counter carries.
+ */
+static void
+aes_runs(void)
+{
+	struct archive_aes aes;
+	uint8_t key[32], ctr0[16], ctr[16], in[37 * 16], out[37 * 16];
+	uint8_t one[16];
+	int i;
+
+	for (i = 0; i < 32; i++)
+		key[i] = (uint8_t)(i * 7 + 1);
+	for (i = 0; i < (int)sizeof(in); i++)
+		in[i] = (uint8_t)(i * 13);
+	memset(ctr0, 0, sizeof(ctr0));
+	ctr0[0] = 0xf0;
+	ctr0[1] = 0xff;
+	ctr0[8] = 0x5a;
+	assertEqualInt(0, __archive_aes_set_encrypt_key(&aes, key, 32));
+	memcpy(ctr, ctr0, 16);
+	__archive_aes_ctr_xor(&aes, ctr, in, out, 37);
+	memcpy(ctr, ctr0, 16);
+	for (i = 0; i < 37; i++) {
+		__archive_aes_ctr_xor(&aes, ctr, in + 16 * i, one, 1);
+		failure("block %d", i);
+		assertEqualMem(out + 16 * i, one, 16);
+	}
+}
+
+static void
+sha1_hex(const void *msg, size_t len, size_t repeat, const char *hex)
+{
+	struct archive_sha1 ctx;
+	uint8_t md[ARCHIVE_SHA1_DIGEST_SIZE], expect[ARCHIVE_SHA1_DIGEST_SIZE];
+
+	unhex(expect, hex);
+	__archive_sha1_init(&ctx);
+	while (repeat-- > 0)
+		__archive_sha1_update(&ctx, msg, len);
+	__archive_sha1_final(&ctx, md);
+	assertEqualMem(md, expect, sizeof(md));
+}
+
+/* RFC 3174, section 7.3. */
+static void
+sha1_rfc3174(void)
+{
+	static const char a[] = "a";
+	static const char abc[] = "abc";
+	static const char abcdbcde[] =
+	    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+	static const char digits[] =
+	    "0123456701234567012345670123456701234567012345670123456701234567";
+	struct archive_sha1 ctx;
+	const void *msgs[3];
+	size_t lens[3];
+	uint8_t md[3][ARCHIVE_SHA1_DIGEST_SIZE], expect[ARCHIVE_SHA1_DIGEST_SIZE];
+
+	sha1_hex(abc, 3, 1, "a9993e364706816aba3e25717850c26c9cd0d89d");
+	sha1_hex(abcdbcde, strlen(abcdbcde), 1,
+	    "84983e441c3bd26ebaae4aa1f95129e5e54670f1");
+	sha1_hex(a, 1, 1000000, "34aa973cd4c4daa4f61eeb2bdbad27316534016f");
+	sha1_hex(digits, strlen(digits), 10,
+	    "dea356a2cddd90c7a7ecedc5ebb563934f460452");
+
+	/* The same messages hashed side by side. */
+	msgs[0] = abc;
+	lens[0] = 3;
+	msgs[1] = abcdbcde;
+	lens[1] = strlen(abcdbcde);
+	msgs[2] = digits;
+	lens[2] = strlen(digits);
+	__archive_sha1_multi(3, msgs, lens, md);
+	unhex(expect, "a9993e364706816aba3e25717850c26c9cd0d89d");
+	assertEqualMem(md[0], expect, sizeof(expect));
+	unhex(expect, "84983e441c3bd26ebaae4aa1f95129e5e54670f1");
+	assertEqualMem(md[1], expect, sizeof(expect));
+	__archive_sha1_init(&ctx);
+	__archive_sha1_update(&ctx, digits, strlen(digits));
+	__archive_sha1_final(&ctx, expect);
+	assertEqualMem(md[2], expect, sizeof(expect));
+}
+
+static const struct {
+	const char *pw;
+	size_t pw_len;
+	const char *salt;
+	size_t salt_len;
+	unsigned rounds;
+	const char *dk;
+} pbkdf2_kat[] = {
+	/* RFC 6070, section 2, without the 16777216-round case. */
+	{ "password", 8, "salt", 4, 1,
+	  "0c60c80f961f0e71f3a9b524af6012062fe037a6" },
+	{ "password", 8, "salt", 4, 2,
+	  "ea6c014dc72d6f8ccd1ed92ace1d41f0d8de8957" },
+	{ "password", 8, "salt", 4, 4096,
+	  "4b007901b765489abead49d926f721d065a429c1" },
+	{ "passwordPASSWORDpassword", 24,
+	  "saltSALTsaltSALTsaltSALTsaltSALTsalt", 36, 4096,
+	  "3d2eec4fe41c849b80c8d83662c0e44a8b291a964cf2f07038" },
+	{ "pass\0word", 9, "sa\0lt", 5, 4096,
+	  "56fa6aa75548099dcc37d7f03425e0c3" },
+};
+
+static void
+pbkdf2_rfc6070(int builtin)
+{
+	uint8_t dk[32], expect[32];
+	size_t i, len;
+
+	for (i = 0; i < sizeof(pbkdf2_kat) / sizeof(pbkdf2_kat[0]); i++) {
+		len = strlen(pbkdf2_kat[i].dk) / 2;
+		unhex(expect, pbkdf2_kat[i].dk);
+		memset(dk, 0, sizeof(dk));
+		failure("RFC 6070 case %d", (int)i + 1);
+		if (builtin)
+			assertEqualInt(0, __archive_pbkdf2_sha1(
+			    pbkdf2_kat[i].pw, pbkdf2_kat[i].pw_len,
+			    (const uint8_t *)pbkdf2_kat[i].salt,
+			    pbkdf2_kat[i].salt_len, pbkdf2_kat[i].rounds,
+			    dk, len));
+		else
+			assertEqualInt(0, archive_pbkdf2_sha1(
+			    pbkdf2_kat[i].pw, pbkdf2_kat[i].pw_len,
+			    (const uint8_t *)pbkdf2_kat[i].salt,
+			    pbkdf2_kat[i].salt_len, pbkdf2_kat[i].rounds,
+			    dk, len));
+		failure("RFC 6070 case %d", (int)i + 1);
+		assertEqualMem(dk, expect, len);
+	}
+}
+
+DEFINE_TEST(test_archive_cryptor_builtin)
+{
+	int portable;
+
+	for (portable = 0; portable <= 1; portable++) {
+		__archive_aes_force_portable(portable);
+		__archive_sha1_force_portable(portable);
+		failure("portable=%d", portable);
+		aes_fips197();
+		aes_runs();
+		sha1_rfc3174();
+		pbkdf2_rfc6070(1);
+	}
+	__archive_aes_force_portable(0);
+	__archive_sha1_force_portable(0);
+}
+
+/* RFC 2202, section 3, test cases 1, 2 and 6. */
+static void
+hmac_rfc2202(void)
+{
+	static const struct {
+		const char *key_hex, *key;
+		const char *data;
+		const char *mac;
+	} kat[] = {
+	    { "0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b", NULL, "Hi There",
+	      "b617318655057264e28bc0b6fb378c8ef146be00" },
+	    { NULL, "Jefe", "what do ya want for nothing?",
+	      "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79" },
+	    { NULL, NULL,
+	      "Test Using Larger Than Block-Size Key - Hash Key First",
+	      "aa4ae5e15272d00e95705637ce8a3b55ed402112" },
+	};
+	archive_hmac_sha1_ctx ctx;
+	uint8_t key[80], mac[20], expect[20];
+	size_t i, key_len, mac_len;
+
+	for (i = 0; i < sizeof(kat) / sizeof(kat[0]); i++) {
+		if (kat[i].key_hex != NULL) {
+			key_len = strlen(kat[i].key_hex) / 2;
+			unhex(key, kat[i].key_hex);
+		} else if (kat[i].key != NULL) {
+			key_len = strlen(kat[i].key);
+			memcpy(key, kat[i].key, key_len);
+		} else {
+			key_len = 80;
+			memset(key, 0xaa, key_len);
+		}
+		unhex(expect, kat[i].mac);
+		assertEqualInt(0, archive_hmac_sha1_init(&ctx, key, key_len));
+		/* In two pieces, to go through the buffering. */
+		archive_hmac_sha1_update(&ctx, (const uint8_t *)kat[i].data, 3);
+		archive_hmac_sha1_update(&ctx,
+		    (const uint8_t *)kat[i].data + 3, strlen(kat[i].data) - 3);
+		mac_len = sizeof(mac);
+		archive_hmac_sha1_final(&ctx, mac, &mac_len);
+		archive_hmac_sha1_cleanup(&ctx);
+		failure("RFC 2202 case %d", (int)i + 1);
+		assertEqualInt(20, mac_len);
+		assertEqualMem(mac, expect, sizeof(mac));
+	}
+}
+
+/*
+ * The cryptor's counter mode, fed in uneven pieces, gives the keystream
+ * of WinZip AES: the counter starts at 1, little-endian.
+ */
+static void
+cryptor_ctr(void)
+{
+	archive_crypto_ctx ctx;
+	struct archive_aes aes;
+	static const size_t pieces[] = { 1, 15, 16, 17, 100, 3, 64, 250 };
+	uint8_t key[32], ctr[16], in[1000], out[1000], expect[63 * 16];
+	size_t i, off, n, out_len;
+
+	for (i = 0; i < sizeof(key); i++)
+		key[i] = (uint8_t)(0xa0 + i);
+	for (i = 0; i < sizeof(in); i++)
+		in[i] = (uint8_t)(i * 29 + 3);
+	memset(ctr, 0, sizeof(ctr));
+	assertEqualInt(0, __archive_aes_set_encrypt_key(&aes, key, 32));
+	memset(expect, 0, sizeof(expect));
+	__archive_aes_ctr_xor(&aes, ctr, expect, expect, 63);
+	for (i = 0; i < sizeof(in); i++)
+		expect[i] ^= in[i];
+
+	assertEqualInt(0, archive_encrypto_aes_ctr_init(&ctx, key, 32));
+	for (i = 0, off = 0; off < sizeof(in); i++, off += n) {
+		n = pieces[i % (sizeof(pieces) / sizeof(pieces[0]))];
+		if (n > sizeof(in) - off)
+			n = sizeof(in) - off;
+		out_len = n;
+		assertEqualInt(0, archive_encrypto_aes_ctr_update(&ctx,
+		    in + off, n, out + off, &out_len));
+		assertEqualInt(n, out_len);
+	}
+	archive_encrypto_aes_ctr_release(&ctx);
+	assertEqualMem(out, expect, sizeof(out));
+}
+
+DEFINE_TEST(test_archive_cryptor)
+{
+	int portable;
+
+	/*
+	 * The forced portable code only matters when this build uses
+	 * the built-in backend; with a crypto library these check it.
+	 */
+	for (portable = 0; portable <= 1; portable++) {
+		__archive_aes_force_portable(portable);
+		__archive_sha1_force_portable(portable);
+		failure("portable=%d", portable);
+		pbkdf2_rfc6070(0);
+		hmac_rfc2202();
+		cryptor_ctr();
+	}
+	__archive_aes_force_portable(0);
+	__archive_sha1_force_portable(0);
+}
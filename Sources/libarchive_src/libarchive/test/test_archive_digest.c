@@ -29,6 +29,11 @@
 
 #define __LIBARCHIVE_BUILD 1
 #include "archive_digest_private.h"
+#include "archive_sha1_private.h"
+#include "archive_sha256_private.h"
+#ifndef HAVE_BLAKE2_H
+#include "archive_blake2.h"
+#endif
 
 DEFINE_TEST(test_archive_md5)
 {
@@ -143,3 +148,167 @@ DEFINE_TEST(test_archive_sha512)
 	assertEqualInt(ARCHIVE_OK, archive_sha512_final(&ctx, md));
 	assertEqualMem(md, actualmd, sizeof(md));
 }
+
+DEFINE_TEST(test_archive_sha_multi)
+{
+	static const char *vectors[] = {
+		"",
+		"abc",
+		"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+	};
+	static const unsigned char sha1md[][20] = {
+		{ 0xda, 0x39, 0xa3, 0xee, 0x5e, 0x6b, 0x4b, 0x0d, 0x32, 0x55,
+		  0xbf, 0xef, 0x95, 0x60, 0x18, 0x90, 0xaf, 0xd8, 0x07, 0x09 },
+		{ 0xa9, 0x99, 0x3e, 0x36, 0x47, 0x06, 0x81, 0x6a, 0xba, 0x3e,
+		  0x25, 0x71, 0x78, 0x50, 0xc2, 0x6c, 0x9c, 0xd0, 0xd8, 0x9d },
+		{ 0x84, 0x98, 0x3e, 0x44, 0x1c, 0x3b, 0xd2, 0x6e, 0xba, 0xae,
+		  0x4a, 0xa1, 0xf9, 0x51, 0x29, 0xe5, 0xe5, 0x46, 0x70, 0xf1 },
+	};
+	static const unsigned char sha256md[][32] = {
+		{ 0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14,
+		  0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+		  0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c,
+		  0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55 },
+		{ 0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+		  0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+		  0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+		  0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad },
+		{ 0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8,
+		  0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+		  0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67,
+		  0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1 },
+	};
+	enum { NMSG = 50 };
+	const void *msgs[NMSG];
+	size_t lens[NMSG];
+	unsigned char (*md1)[ARCHIVE_SHA1_DIGEST_SIZE];
+	unsigned char (*md256)[ARCHIVE_SHA256_DIGEST_SIZE];
+	unsigned char *data, md[32];
+	struct archive_sha1 c1;
+	struct archive_sha256 c256;
+	size_t size = 300000;
+	int i;
+
+	/* Known answers. */
+	for (i = 0; i < 3; i++) {
+		msgs[i] = vectors[i];
+		lens[i] = strlen(vectors[i]);
+	}
+	md1 = malloc(NMSG * sizeof(*md1));
+	md256 = malloc(NMSG * sizeof(*md256));
+	assert(md1 != NULL && md256 != NULL);
+	__archive_sha1_multi(3, msgs, lens, md1);
+	__archive_sha256_multi(3, msgs, lens, md256);
+	for (i = 0; i < 3; i++) {
+		failure("vector %d", i);
+		assertEqualMem(md1[i], sha1md[i], 20);
+		failure("vector %d", i);
+		assertEqualMem(md256[i], sha256md[i], 32);
+	}
+
+	/*
+	 * Messages of assorted lengths, covering every padding case and
+	 * lanes that finish at different times, must hash the same as
+	 * they do one at a time.
+	 */
+	assert((data = malloc(size)) != NULL);
+	for (i = 0; i < (int)size; i++)
+		data[i] = (unsigned char)(i * 131 + (i >> 9));
+	for (i = 0; i < NMSG; i++) {
+		msgs[i] = data + i * 3;
+		lens[i] = (size_t)(i * i * 97 + i) % 6000;
+	}
+	lens[0] = 0;
+	lens[1] = 55;
+	lens[2] = 56;
+	lens[3] = 64;
+	lens[9] = size - 9 * 3;
+	__archive_sha1_multi(NMSG, msgs, lens, md1);
+	__archive_sha256_multi(NMSG, msgs, lens, md256);
+	for (i = 0; i < NMSG; i++) {
+		__archive_sha1_init(&c1);
+		__archive_sha1_update(&c1, msgs[i], lens[i]);
+		__archive_sha1_final(&c1, md);
+		failure("message %d, %d bytes", i, (int)lens[i]);
+		assertEqualMem(md1[i], md, 20);
+		__archive_sha256_init(&c256);
+		__archive_sha256_update(&c256, msgs[i], lens[i]);
+		__archive_sha256_final(&c256, md);
+		failure("message %d, %d bytes", i, (int)lens[i]);
+		assertEqualMem(md256[i], md, 32);
+	}
+	free(data);
+	free(md1);
+	free(md256);
+}
+
+DEFINE_TEST(test_archive_blake2sp)
+{
+#ifdef HAVE_BLAKE2_H
+	skipping("BLAKE2sp comes from the system libb2");
+#else
+	static const size_t lens[] = {
+		0, 1, 64, 511, 512, 513, 1024, 1500, 4096, 70000, 300000
+	};
+	static const size_t chunks[] = { 1, 100, 512, 777, 65536 };
+	/* Known answers, which the SIMD stripes of whole-buffer updates
+	 * must reproduce. */
+	static const struct {
+		size_t len;
+		const char *md;
+	} kat[] = {
+		{ 4096,
+		    "\xa2\xec\x53\x12\x13\x27\x17\x0b"
+		    "\x05\xbe\xe3\x51\x8e\x43\x63\x02"
+		    "\x59\xce\x8d\x13\xba\x46\xcf\x64"
+		    "\x5c\x3b\xc8\x1a\xd9\xcc\x54\x2f" },
+		{ 300000,
+		    "\x27\x3d\x69\x84\xbd\xd9\xfc\x0b"
+		    "\x25\xb9\xcd\xd0\x40\x6b\xa4\x47"
+		    "\x14\x73\xf0\x62\xaf\x2a\x87\xcb"
+		    "\x05\x2a\x0e\xef\x20\xac\x96\x25" },
+	};
+	blake2sp_state leaves, S;
+	unsigned char *data, md[32], expect[32];
+	size_t c, i, j, k, len, n, stripes;
+
+	assert((data = malloc(300000)) != NULL);
+	for (i = 0; i < 300000; i++)
+		data[i] = (unsigned char)(i * 131 + (i >> 9));
+	for (i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+		/* Deal whole stripes to the leaves a block at a time, as
+		 * the portable code does, and leave the rest buffered. */
+		len = lens[i];
+		stripes = len / 512;
+		assertEqualInt(0, blake2sp_init(&leaves, 32));
+		for (j = 0; j < 8; j++)
+			for (k = 0; k < stripes; k++)
+				blake2s_update(leaves.S[j],
+				    data + k * 512 + j * 64, 64);
+		memcpy(leaves.buf, data + stripes * 512, len % 512);
+		leaves.buflen = len % 512;
+		assertEqualInt(0, blake2sp_final(&leaves, expect, 32));
+
+		for (c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+			assertEqualInt(0, blake2sp_init(&S, 32));
+			for (k = 0; k < len; k += n) {
+				n = len - k < chunks[c] ? len - k : chunks[c];
+				assertEqualInt(0,
+				    blake2sp_update(&S, data + k, n));
+			}
+			assertEqualInt(0, blake2sp_final(&S, md, 32));
+			failure("%d bytes in chunks of %d", (int)len,
+			    (int)chunks[c]);
+			assertEqualMem(expect, md, 32);
+		}
+	}
+	for (i = 0; i < sizeof(kat) / sizeof(kat[0]); i++) {
+		assertEqualInt(0, blake2sp_init(&S, 32));
+		assertEqualInt(0, blake2sp_update(&S, data, kat[i].len));
+		assertEqualInt(0, blake2sp_final(&S, md, 32));
+		failure("%d bytes", (int)kat[i].len);
+		assertEqualMem(kat[i].md, md, 32);
+	}
+	free(data);
+#endif
+}
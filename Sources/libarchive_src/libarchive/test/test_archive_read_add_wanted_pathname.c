@@ -0,0 +1,238 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * Restrict reading to a set of wanted pathnames and check that exactly
+ * those entries come back, in archive order, followed by ARCHIVE_EOF.
+ */
+
+#define	NFILES	20
+
+static const char *tar_wanted[] = { "file17", "file3", "file3", "file8",
+    "no/such/file", NULL };
+static const char *tar_found[] = { "file3", "file8", "file17", NULL };
+
+static size_t
+make_tar(char *buff, size_t buffsize)
+{
+	char name[32], data[64];
+	struct archive_entry *ae;
+	struct archive *a;
+	size_t used;
+	int i;
+
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_pax(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_none(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, buffsize, &used));
+	for (i = 0; i < NFILES; i++) {
+		snprintf(name, sizeof(name), "file%d", i);
+		memset(data, 'a' + i, sizeof(data));
+		assert((ae = archive_entry_new()) != NULL);
+		archive_entry_copy_pathname(ae, name);
+		archive_entry_set_mode(ae, AE_IFREG | 0644);
+		archive_entry_set_size(ae, i);
+		assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+		assertEqualInt(i, archive_write_data(a, data, i));
+		archive_entry_free(ae);
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+	return (used);
+}
+
+static void
+test_tar(void)
+{
+	static const size_t buffsize = 64 * 1024;
+	char *buff, data[64];
+	struct archive_entry *ae;
+	struct archive *a;
+	size_t used;
+	int i, n;
+
+	assert((buff = malloc(buffsize)) != NULL);
+	used = make_tar(buff, buffsize);
+
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	for (i = 0; tar_wanted[i] != NULL; i++)
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_add_wanted_pathname(a, tar_wanted[i]));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, buff, used));
+	for (i = 0; tar_found[i] != NULL; i++) {
+		assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+		assertEqualString(tar_found[i], archive_entry_pathname(ae));
+		/* Leave the body of the middle entry unread. */
+		if (i == 1)
+			continue;
+		n = atoi(tar_found[i] + 4);
+		assertEqualInt(n, archive_read_data(a, data, sizeof(data)));
+		assert(n == 0 || data[n - 1] == 'a' + n);
+	}
+	/* "no/such/file" is never found, so the whole archive is read. */
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualInt(3, archive_file_count(a));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	/* Once every wanted entry has been seen, the rest is not read:
+	 * the garbage after "file2" is never reached. */
+	memset(buff + used / 4, 'x', used - used / 4);
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_add_wanted_pathname(a, "file2"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, buff, used));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("file2", archive_entry_pathname(ae));
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	free(buff);
+}
+
+/*
+ * In this archive "file1" .. "file4" share the first LZMA folder and
+ * "zfile1" .. "zfile4" the second.
+ */
+static void
+test_7zip(const char *options)
+{
+	const char *refname = "test_read_format_7zip_lzma1_lzma2.7z";
+	struct archive_entry *ae;
+	struct archive *a;
+	char *buff, expect[64], data[64];
+	size_t size;
+	int i;
+
+	/* Reference contents of zfile3. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_7zip(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_filename(a, refname, 10240));
+	while (archive_read_next_header(a, &ae) == ARCHIVE_OK &&
+	    strcmp(archive_entry_pathname(ae), "zfile3") != 0)
+		;
+	assertEqualString("zfile3", archive_entry_pathname(ae));
+	assertEqualInt(39, archive_read_data(a, expect, sizeof(expect)));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	/* Wanted entries come back in archive order from both folders. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_7zip(a));
+	if (options != NULL)
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_set_options(a, options));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_add_wanted_pathname(a, "zfile3"));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_add_wanted_pathname(a, "file2"));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_filename(a, refname, 10240));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("file2", archive_entry_pathname(ae));
+	assertEqualInt(26, archive_read_data(a, data, sizeof(data)));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("zfile3", archive_entry_pathname(ae));
+	assertEqualInt(39, archive_read_data(a, data, sizeof(data)));
+	assertEqualMem(expect, data, 39);
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualInt(2, archive_file_count(a));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	/*
+	 * Damage the pack stream of the first folder.  It holds no
+	 * wanted entry, so it must never be decoded.
+	 */
+	buff = slurpfile(&size, "%s", refname);
+	assert(buff != NULL);
+	for (i = 34; i < 54; i++)
+		buff[i] ^= 0x5a;
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_7zip(a));
+	if (options != NULL)
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_set_options(a, options));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_add_wanted_pathname(a, "zfile3"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, buff, size));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("zfile3", archive_entry_pathname(ae));
+	assertEqualInt(39, archive_read_data(a, data, sizeof(data)));
+	assertEqualMem(expect, data, 39);
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	free(buff);
+}
+
+DEFINE_TEST(test_archive_read_add_wanted_pathname)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	char *buff;
+	size_t used;
+
+	/* Empty names are rejected. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_FAILED,
+	    archive_read_add_wanted_pathname(a, ""));
+	assertEqualIntA(a, ARCHIVE_FAILED,
+	    archive_read_add_wanted_pathname(a, NULL));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	/* The list can't change once the archive is open. */
+	assert((buff = malloc(64 * 1024)) != NULL);
+	used = make_tar(buff, 64 * 1024);
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, buff, used));
+	assertEqualIntA(a, ARCHIVE_FATAL,
+	    archive_read_add_wanted_pathname(a, "file1"));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	/* Without a list every entry is returned. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, buff, used));
+	while (archive_read_next_header(a, &ae) == ARCHIVE_OK)
+		;
+	assertEqualInt(NFILES, archive_file_count(a));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	free(buff);
+
+	test_tar();
+
+	assert((a = archive_read_new()) != NULL);
+	if (ARCHIVE_OK != archive_read_support_filter_xz(a)) {
+		skipping("7zip:lzma decoding is not supported on this "
+		    "platform");
+	} else {
+		extract_reference_file("test_read_format_7zip_lzma1_lzma2.7z");
+		test_7zip(NULL);
+		test_7zip("7zip:threads=2");
+	}
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+}
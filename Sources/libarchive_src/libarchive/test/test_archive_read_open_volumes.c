@@ -0,0 +1,328 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * Split archives into volumes named the way various archivers name
+ * them, open them by the name of one volume with
+ * archive_read_open_volumes(), and check that every entry reads back
+ * the same as from the unsplit archive.
+ */
+
+#define	MAX_ENTRIES	64
+
+struct result {
+	int		 count;
+	char		 name[MAX_ENTRIES][256];
+	unsigned long	 sum[MAX_ENTRIES];
+};
+
+static unsigned long
+checksum(unsigned long sum, const void *buff, size_t size)
+{
+	const unsigned char *p = buff;
+
+	while (size--)
+		sum = sum * 31 + *p++;
+	return (sum);
+}
+
+/*
+ * Read every entry of an opened archive; with skip_odd set, the data
+ * of every other entry is skipped, so skips also cross volumes.
+ */
+static void
+read_entries(struct archive *a, int skip_odd, struct result *res)
+{
+	struct archive_entry *ae;
+	const void *buff;
+	size_t size;
+	int64_t offset;
+	int r;
+
+	memset(res, 0, sizeof(*res));
+	while (res->count < MAX_ENTRIES &&
+	    (r = archive_read_next_header(a, &ae)) == ARCHIVE_OK) {
+		int i = res->count++;
+
+		strncpy(res->name[i], archive_entry_pathname(ae),
+		    sizeof(res->name[i]) - 1);
+		if (skip_odd && (i & 1))
+			continue;
+		while ((r = archive_read_data_block(a, &buff, &size,
+		    &offset)) == ARCHIVE_OK)
+			res->sum[i] = checksum(res->sum[i], buff, size);
+		assertEqualIntA(a, ARCHIVE_EOF, r);
+	}
+	assertEqualIntA(a, ARCHIVE_EOF, r);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_free(a));
+}
+
+static struct archive *
+new_reader(void)
+{
+	struct archive *a;
+
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	return (a);
+}
+
+static void
+compare(const struct result *expect, const struct result *got,
+    const char *name)
+{
+	int i;
+
+	failure("%s", name);
+	assertEqualInt(expect->count, got->count);
+	for (i = 0; i < expect->count && i < got->count; i++) {
+		failure("%s, entry %d", name, i);
+		assertEqualString(expect->name[i], got->name[i]);
+		failure("%s, entry %d", name, i);
+		assert(expect->sum[i] == got->sum[i]);
+	}
+}
+
+/* Read the volumes by one of their names and compare. */
+static void
+verify_volumes(const char *name, const struct result *expect, int skip_odd)
+{
+	struct result *got;
+	struct archive *a;
+
+	assert((got = malloc(sizeof(*got))) != NULL);
+	a = new_reader();
+	failure("%s", name);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_volumes(a, name, 10240));
+	read_entries(a, skip_odd, got);
+	compare(expect, got, name);
+	free(got);
+}
+
+static size_t
+make_archive(char *buff, size_t buffsize, int format)
+{
+	static char data[100000];
+	struct archive_entry *ae;
+	struct archive *a;
+	char name[64];
+	size_t used, size;
+	int i;
+
+	for (i = 0; i < (int)sizeof(data); i++)
+		data[i] = (char)(i * 7 + i / 251);
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format(a, format));
+	if (format == ARCHIVE_FORMAT_ZIP)
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_write_set_options(a, "zip:compression=store"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_none(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, buffsize, &used));
+	for (i = 0; i < 12; i++) {
+		snprintf(name, sizeof(name), "file%d", i);
+		size = (size_t)(i * 37013) % sizeof(data);
+		assert((ae = archive_entry_new()) != NULL);
+		archive_entry_copy_pathname(ae, name);
+		archive_entry_set_mode(ae, AE_IFREG | 0644);
+		archive_entry_set_size(ae, size);
+		assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+		assertEqualInt((la_ssize_t)size,
+		    archive_write_data(a, data + i, size));
+		archive_entry_free(ae);
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+	return (used);
+}
+
+/* Write the archive out as equal-sized volumes with the given names. */
+static void
+split_archive(const char *buff, size_t used, const char **names)
+{
+	size_t n, i, part, off = 0;
+
+	for (n = 0; names[n] != NULL; n++)
+		;
+	part = (used + n - 1) / n;
+	for (i = 0; i < n; i++) {
+		size_t len = used - off < part ? used - off : part;
+		FILE *f = fopen(names[i], "wb");
+		assert(f != NULL);
+		assertEqualInt(len, fwrite(buff + off, 1, len, f));
+		fclose(f);
+		off += len;
+	}
+}
+
+static void
+test_split(int format, const char **names, const char *open_name)
+{
+	static const size_t buffsize = 2 * 1024 * 1024;
+	struct result *expect;
+	struct archive *a;
+	char *buff;
+	size_t used;
+	int skip;
+
+	assert((buff = malloc(buffsize)) != NULL);
+	assert((expect = malloc(sizeof(*expect))) != NULL);
+	used = make_archive(buff, buffsize, format);
+	split_archive(buff, used, names);
+	for (skip = 0; skip <= 1; skip++) {
+		a = new_reader();
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_open_memory(a, buff, used));
+		read_entries(a, skip, expect);
+		assertEqualInt(12, expect->count);
+		verify_volumes(open_name, expect, skip);
+	}
+	free(expect);
+	free(buff);
+}
+
+static void
+test_rar_sets(void)
+{
+	static const char *rar5[] = {
+		"test_read_format_rar5_multiarchive.part01.rar",
+		"test_read_format_rar5_multiarchive.part02.rar",
+		"test_read_format_rar5_multiarchive.part03.rar",
+		"test_read_format_rar5_multiarchive.part04.rar",
+		"test_read_format_rar5_multiarchive.part05.rar",
+		"test_read_format_rar5_multiarchive.part06.rar",
+		"test_read_format_rar5_multiarchive.part07.rar",
+		"test_read_format_rar5_multiarchive.part08.rar",
+		NULL
+	};
+	static const char *rar4[] = {
+		"test_rar_multivolume_multiple_files.part1.rar",
+		"test_rar_multivolume_multiple_files.part2.rar",
+		"test_rar_multivolume_multiple_files.part3.rar",
+		"test_rar_multivolume_multiple_files.part4.rar",
+		"test_rar_multivolume_multiple_files.part5.rar",
+		"test_rar_multivolume_multiple_files.part6.rar",
+		NULL
+	};
+	struct result *expect;
+	struct archive *a;
+
+	assert((expect = malloc(sizeof(*expect))) != NULL);
+	extract_reference_files(rar5);
+	a = new_reader();
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_filenames(a, rar5, 10240));
+	read_entries(a, 0, expect);
+	assert(expect->count > 0);
+	verify_volumes(rar5[0], expect, 0);
+	verify_volumes(rar5[5], expect, 0);
+
+	extract_reference_files(rar4);
+	a = new_reader();
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_filenames(a, rar4, 10240));
+	read_entries(a, 0, expect);
+	assert(expect->count > 0);
+	verify_volumes(rar4[2], expect, 0);
+	free(expect);
+}
+
+/*
+ * A split ZIP made by "zip -s 64k": the first volume starts with the
+ * spanning marker and the deflated second entry crosses into the last
+ * volume.  The checksums are of the original files.
+ */
+static void
+test_zip_set(void)
+{
+	static const char *zip[] = {
+		"test_archive_read_open_volumes.z01",
+		"test_archive_read_open_volumes.zip",
+		NULL
+	};
+	struct result *expect, *got;
+	struct archive *a;
+	int skip;
+
+	assert((expect = malloc(sizeof(*expect))) != NULL);
+	assert((got = malloc(sizeof(*got))) != NULL);
+	extract_reference_files(zip);
+	a = new_reader();
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_filenames(a, zip, 10240));
+	read_entries(a, 0, got);
+	assertEqualInt(2, got->count);
+	assertEqualString("stored.bin", got->name[0]);
+	assertEqualInt(1759523480U, (uint32_t)got->sum[0]);
+	assertEqualString("deflated.txt", got->name[1]);
+	assertEqualInt(1371564191U, (uint32_t)got->sum[1]);
+	for (skip = 0; skip <= 1; skip++) {
+		a = new_reader();
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_open_filenames(a, zip, 10240));
+		read_entries(a, skip, expect);
+		verify_volumes(zip[0], expect, skip);
+		verify_volumes(zip[1], expect, skip);
+	}
+	free(got);
+	free(expect);
+}
+
+DEFINE_TEST(test_archive_read_open_volumes)
+{
+	static const char *numbered[] = {
+		"split.tar.001", "split.tar.002", "split.tar.003", NULL
+	};
+	static const char *from_zero[] = {
+		"zero.tar.000", "zero.tar.001", "zero.tar.002",
+		"zero.tar.003", NULL
+	};
+	static const char *old_rar[] = {
+		"old.rar", "old.r00", "old.r01", NULL
+	};
+	static const char *part_rar[] = {
+		"new.part1.rar", "new.part2.rar", "new.part3.rar",
+		"new.part4.rar", NULL
+	};
+	static const char *zip[] = {
+		"split.z01", "split.z02", "split.zip", NULL
+	};
+	static const char *single[] = { "single.tar", NULL };
+
+	test_rar_sets();
+	test_zip_set();
+	/* The volume contents only matter to the format readers, so
+	 * pieces of a tar archive stand in for the RAR naming. */
+	test_split(ARCHIVE_FORMAT_TAR_USTAR, numbered, "split.tar.002");
+	test_split(ARCHIVE_FORMAT_TAR_USTAR, from_zero, "zero.tar.003");
+	test_split(ARCHIVE_FORMAT_TAR_USTAR, old_rar, "old.r01");
+	test_split(ARCHIVE_FORMAT_TAR_USTAR, part_rar, "new.part3.rar");
+	test_split(ARCHIVE_FORMAT_TAR_USTAR, single, "single.tar");
+	/* A ZIP split without spanning markers reads like the whole. */
+	test_split(ARCHIVE_FORMAT_ZIP, zip, "split.z02");
+	test_split(ARCHIVE_FORMAT_ZIP, zip, "split.zip");
+}
@@ -0,0 +1,108 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * Queue more tasks than the pool has workers, wait for them out of
+ * order, and do it again with the same task structures.  Without
+ * thread support the pool is NULL and each task runs when queued.
+ */
+
+#define __LIBARCHIVE_BUILD 1
+#include "archive_thread_private.h"
+
+#define	TASKS	64
+
+struct job {
+	struct archive_thread_task task;
+	int	n;
+	int	runs;
+	long	result;
+};
+
+static void
+job_run(void *arg)
+{
+	struct job *job = (struct job *)arg;
+	long sum = 0;
+	int i;
+
+	for (i = 0; i <= job->n * 1000; i++)
+		sum += i % 7;
+	job->result = sum;
+	job->runs++;
+}
+
+static long
+expected(int n)
+{
+	long sum = 0;
+	int i;
+
+	for (i = 0; i <= n * 1000; i++)
+		sum += i % 7;
+	return (sum);
+}
+
+static void
+run_pool(struct archive_thread_pool *pool, struct job *jobs, int round)
+{
+	int i;
+
+	for (i = 0; i < TASKS; i++) {
+		jobs[i].n = i + round;
+		jobs[i].result = -1;
+		__archive_thread_pool_run(pool, &jobs[i].task, job_run,
+		    &jobs[i]);
+	}
+	/* Wait from the back, so queued tasks are also taken back. */
+	for (i = TASKS - 1; i >= 0; i--) {
+		__archive_thread_pool_wait(pool, &jobs[i].task);
+		failure("task %d, round %d", i, round);
+		assertEqualInt(expected(i + round), jobs[i].result);
+		assertEqualInt(round + 1, jobs[i].runs);
+	}
+	/* Waiting again for a finished task returns at once. */
+	__archive_thread_pool_wait(pool, &jobs[0].task);
+}
+
+DEFINE_TEST(test_archive_thread_pool)
+{
+	static struct job jobs[TASKS];
+	struct archive_thread_pool *pool;
+
+	memset(jobs, 0, sizeof(jobs));
+	pool = __archive_thread_pool_new(4);
+	run_pool(pool, jobs, 0);
+	run_pool(pool, jobs, 1);
+	__archive_thread_pool_free(pool);
+
+	/* A NULL pool runs tasks on the caller's thread. */
+	run_pool(NULL, jobs, 2);
+
+	/* A pool freed with nothing queued, and a NULL one. */
+	__archive_thread_pool_free(__archive_thread_pool_new(2));
+	__archive_thread_pool_free(NULL);
+}
@@ -414,12 +414,10 @@ DEFINE_TEST(test_fuzz_tar)
 		"test_read_format_tar_empty_filename.tar",
 		NULL
 	};
-#if HAVE_LIBLZO2 && HAVE_LZO_LZO1X_H && HAVE_LZO_LZOCONF_H
 	static const char *fileset9[] = {
 		"test_compat_lzop_1.tar.lzo",
 		NULL
 	};
-#endif
 #if HAVE_ZSTD_H && HAVE_LIBZSTD
 	static const char *fileset10[] = {
 		"test_compat_zstd_1.tar.zst",
@@ -440,9 +438,7 @@ DEFINE_TEST(test_fuzz_tar)
 		{0, fileset6}, /* Exercise xz decompressor. */
 		{0, fileset7},
 		{0, fileset8},
-#if HAVE_LIBLZO2 && HAVE_LZO_LZO1X_H && HAVE_LZO_LZOCONF_H
 		{0, fileset9}, /* Exercise lzo decompressor. */
-#endif
 #if HAVE_ZSTD_H && HAVE_LIBZSTD
 		{0, fileset10}, /* Exercise zstd decompressor. */
 #endif
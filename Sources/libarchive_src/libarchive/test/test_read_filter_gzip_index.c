@@ -0,0 +1,167 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * Build a gzip-compressed tar archive, read it once sequentially while
+ * writing both a tar entry index and a gzip checkpoint index, then
+ * reopen it with both indexes and jump to entries out of order.
+ */
+
+#define	NFILES	48
+
+static size_t
+entry_size(int i)
+{
+	return ((size_t)(i * 2749) % 24000);
+}
+
+/* Poorly compressible, so the output has many deflate blocks. */
+static void
+entry_data(char *buff, size_t size, int i)
+{
+	uint32_t seed = 2166136261U ^ (uint32_t)i;
+	size_t n;
+
+	for (n = 0; n < size; n++) {
+		seed = seed * 1103515245U + 12345U;
+		buff[n] = (char)(seed >> 24);
+	}
+}
+
+static void
+verify_entry(struct archive *a, int i)
+{
+	char name[64], expect[24000], data[24000];
+	struct archive_entry *ae;
+	size_t size;
+
+	snprintf(name, sizeof(name), "dir%d/file%d", i % 5, i);
+	size = entry_size(i);
+	entry_data(expect, size, i);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_tar_seek_entry(a, name));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString(name, archive_entry_pathname(ae));
+	assertEqualInt(size, archive_entry_size(ae));
+	assertEqualInt((la_ssize_t)size,
+	    archive_read_data(a, data, sizeof(data)));
+	assertEqualMem(expect, data, size);
+}
+
+DEFINE_TEST(test_read_filter_gzip_index)
+{
+	static const size_t buffsize = 2 * 1024 * 1024;
+	char *buff, name[64], data[24000];
+	struct archive_entry *ae;
+	struct archive *a;
+	size_t used, size;
+	int i, n;
+
+	assert((buff = malloc(buffsize)) != NULL);
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_pax_restricted(a));
+	if (archive_write_add_filter_gzip(a) != ARCHIVE_OK) {
+		skipping("gzip writing not supported on this platform");
+		assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+		free(buff);
+		return;
+	}
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, buffsize, &used));
+	for (i = 0; i < NFILES; i++) {
+		snprintf(name, sizeof(name), "dir%d/file%d", i % 5, i);
+		size = entry_size(i);
+		entry_data(data, size, i);
+		assert((ae = archive_entry_new()) != NULL);
+		archive_entry_copy_pathname(ae, name);
+		archive_entry_set_mode(ae, AE_IFREG | 0644);
+		archive_entry_set_size(ae, size);
+		assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+		assertEqualInt((la_ssize_t)size, archive_write_data(a, data, size));
+		archive_entry_free(ae);
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+
+	/* Sequential pass that builds both indexes. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_gzip(a));
+	assertEqualIntA(a, ARCHIVE_FAILED,
+	    archive_read_set_options(a, "gzip:checkpoint-span=100"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_set_options(a,
+	    "tar:write-index=test.idx,"
+	    "gzip:checkpoint-write=test.gzidx,gzip:checkpoint-span=65536"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, buff, used));
+	for (n = 0; archive_read_next_header(a, &ae) == ARCHIVE_OK; n++)
+		;
+	assertEqualInt(NFILES, n);
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	assertFileExists("test.idx");
+	assertFileExists("test.gzidx");
+
+	/*
+	 * Random access using both indexes.  Their options have distinct
+	 * names, so each reaches only its own module unqualified.
+	 */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_gzip(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_set_options(a,
+	    "read-index=test.idx,checkpoint-read=test.gzidx"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, buff, used));
+	for (i = NFILES - 1; i >= 0; i -= 7)
+		verify_entry(a, i);
+	verify_entry(a, 20);
+	verify_entry(a, 21);
+	verify_entry(a, 1);
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	/* The gzip index is also usable while it is being built. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_gzip(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_set_options(a,
+	    "tar:read-index=test.idx,"
+	    "gzip:checkpoint-write=test2.gzidx,gzip:checkpoint-span=65536"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, buff, used));
+	verify_entry(a, 30);
+	verify_entry(a, 2);
+	verify_entry(a, 31);
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	/* Without a gzip index, seeking in the compressed data is refused. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_gzip(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_set_options(a, "tar:read-index=test.idx"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, buff, used));
+	snprintf(name, sizeof(name), "dir%d/file%d", 3, 3);
+	assertEqualIntA(a, ARCHIVE_FAILED, archive_read_tar_seek_entry(a, name));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	free(buff);
+}
@@ -1122,6 +1122,59 @@ DEFINE_TEST(test_read_format_7zip_ppmd)
 	test_ppmd();
 }
 
+/*
+ * Extract PPMd folders whose models differ in order and memory size,
+ * so that the model left by one folder is reused, grown and shrunk.
+ */
+DEFINE_TEST(test_read_format_7zip_ppmd_folders)
+{
+	static const struct {
+		const char	*name;
+		int64_t		 size;
+		uint32_t	 crc;
+	} files[] = {
+		{ "small.txt", 30000, 0xb8a05709 },	/* order 6, 1 MiB */
+		{ "large.txt", 100000, 0xc6c33eea },	/* order 8, 16 MiB */
+		{ "medium.txt", 50000, 0xad7392c8 },	/* order 4, 4 MiB */
+	};
+	const char *refname = "test_read_format_7zip_ppmd_folders.7z";
+	struct archive_entry *ae;
+	struct archive *a;
+	char buff[4096];
+	uint32_t computed_crc;
+	int64_t total;
+	ssize_t bytes;
+	size_t i;
+
+	extract_reference_file(refname);
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_filename(a, refname, 10240));
+
+	for (i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_next_header(a, &ae));
+		assertEqualString(files[i].name, archive_entry_pathname(ae));
+		assertEqualInt(files[i].size, archive_entry_size(ae));
+		computed_crc = 0;
+		total = 0;
+		while ((bytes = archive_read_data(a, buff, sizeof(buff))) > 0) {
+			computed_crc = bitcrc32(computed_crc, buff, bytes);
+			total += bytes;
+		}
+		assertEqualInt(0, bytes);
+		assertEqualInt(files[i].size, total);
+		assertEqualInt(files[i].crc, computed_crc);
+	}
+	assertEqualInt(3, archive_file_count(a));
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+
+	assertEqualInt(ARCHIVE_OK, archive_read_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+}
+
 static void
 test_arm64_filter(const char *refname)
 {
@@ -1627,3 +1680,78 @@ DEFINE_TEST(test_read_format_7zip_lzma2_powerpc)
   
 	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
 }
+
+/*
+ * Skipped entries are decoded, so that damage in them is reported,
+ * unless a read plan says they are not wanted.  A solid archive made
+ * of small bzip2 blocks is damaged late in its pack stream, past the
+ * part of the first entry that is read.
+ */
+DEFINE_TEST(test_read_format_7zip_skip_damaged)
+{
+	static char data[300000];
+	struct archive_entry *ae;
+	struct archive *a;
+	char *buff, name[16];
+	size_t buffsize = 4 * 1024 * 1024, used;
+	unsigned x = 1;
+	int i, r;
+
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_7zip(a));
+	if (ARCHIVE_OK != archive_write_set_format_option(a, "7zip",
+	    "compression", "bzip2")) {
+		skipping("7zip:bzip2 writing is not supported on this platform");
+		assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+		return;
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_option(a,
+	    "7zip", "compression-level", "1"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_none(a));
+	assert((buff = malloc(buffsize)) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, buffsize, &used));
+	for (i = 0; i < (int)sizeof(data); i++) {
+		x = x * 1103515245 + 12345;
+		data[i] = 'a' + (x >> 16) % 16;
+	}
+	for (i = 0; i < 3; i++) {
+		snprintf(name, sizeof(name), "file%d", i);
+		assert((ae = archive_entry_new()) != NULL);
+		archive_entry_copy_pathname(ae, name);
+		archive_entry_set_mode(ae, AE_IFREG | 0644);
+		archive_entry_set_size(ae, sizeof(data));
+		assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+		assertEqualInt(sizeof(data),
+		    archive_write_data(a, data, sizeof(data)));
+		archive_entry_free(ae);
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+	buff[used * 2 / 3] ^= 0x55;
+
+	/* Without a plan, skipping runs into the damage. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_7zip(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, buff, used));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("file0", archive_entry_pathname(ae));
+	assertEqualInt(100, archive_read_data(a, data, 100));
+	while ((r = archive_read_next_header(a, &ae)) == ARCHIVE_OK)
+		;
+	assertEqualIntA(a, ARCHIVE_FATAL, r);
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	/* With one, the rest of the folder is never decoded. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_7zip(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_add_wanted_pathname(a, "file0"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, buff, used));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("file0", archive_entry_pathname(ae));
+	assertEqualInt(100, archive_read_data(a, data, 100));
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	free(buff);
+}
@@ -0,0 +1,79 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * Read multi-folder archives with "7zip:threads" set and check that
+ * every entry comes back exactly as it does when read sequentially.
+ */
+
+static void
+verify(const char *refname)
+{
+	static const char *options[] = {
+		"7zip:threads=2", "7zip:threads=4", "7zip:threads=0", NULL
+	};
+
+	extract_reference_file(refname);
+	read_threads_verify(refname, options, 0);
+}
+
+DEFINE_TEST(test_read_format_7zip_threads)
+{
+	struct archive *a;
+
+	assert(read_threads_check_option("7zip",
+	    archive_read_support_format_7zip));
+
+	assert((a = archive_read_new()) != NULL);
+	if (ARCHIVE_OK != archive_read_support_filter_gzip(a)) {
+		skipping("7zip:deflate decoding is not supported on this "
+		    "platform");
+	} else
+		verify("test_read_format_7zip_deflate.7z");
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	assert((a = archive_read_new()) != NULL);
+	if (ARCHIVE_OK != archive_read_support_filter_bzip2(a)) {
+		skipping("7zip:bzip2 decoding is not supported on this "
+		    "platform");
+	} else
+		verify("test_read_format_7zip_bzip2.7z");
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	assert((a = archive_read_new()) != NULL);
+	if (ARCHIVE_OK != archive_read_support_filter_xz(a)) {
+		skipping("7zip:lzma decoding is not supported on this "
+		    "platform");
+	} else {
+		verify("test_read_format_7zip_lzma1_lzma2.7z");
+		verify("test_read_format_7zip_bcj2_lzma2_2.7z");
+		verify("test_read_format_7zip_copy_2.7z");
+		verify("test_read_format_7zip_extract_second.7z");
+	}
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	verify("test_read_format_7zip_ppmd.7z");
+	verify("test_read_format_7zip_ppmd_folders.7z");
+}
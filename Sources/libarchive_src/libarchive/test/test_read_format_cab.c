@@ -407,3 +407,61 @@ DEFINE_TEST(test_read_format_cab)
 	verify3("test_read_format_cab_3.cab", LZX);
 }
 
+
+/*
+ * Read one entry of a cabinet with several folders after skipping all
+ * those before it without reading their data.  The bytes skipped in
+ * earlier folders must not be charged to the folder of that entry.
+ */
+#define	SKIP_MAX_ENTRIES	16
+
+static int
+read_crc(struct archive *a, unsigned long *crc)
+{
+	const void *p;
+	size_t size;
+	int64_t offset;
+	int r;
+
+	*crc = 0;
+	while ((r = archive_read_data_block(a, &p, &size, &offset)) ==
+	    ARCHIVE_OK)
+		*crc = bitcrc32(*crc, p, size);
+	return (r);
+}
+
+DEFINE_TEST(test_read_format_cab_skip_folders)
+{
+	const char *refname = "test_read_format_cab_threads.cab";
+	struct archive_entry *ae;
+	struct archive *a;
+	unsigned long crc[SKIP_MAX_ENTRIES], got;
+	int count, i, k;
+
+	extract_reference_file(refname);
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_cab(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_filename(a, refname, 10240));
+	for (count = 0; count < SKIP_MAX_ENTRIES &&
+	    archive_read_next_header(a, &ae) == ARCHIVE_OK; count++)
+		assertEqualIntA(a, ARCHIVE_EOF, read_crc(a, &crc[count]));
+	assertEqualInt(12, count);
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	for (k = 1; k < count; k++) {
+		assert((a = archive_read_new()) != NULL);
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_support_format_cab(a));
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_open_filename(a, refname, 10240));
+		for (i = 0; i <= k; i++)
+			assertEqualIntA(a, ARCHIVE_OK,
+			    archive_read_next_header(a, &ae));
+		failure("entry %d", k);
+		assertEqualIntA(a, ARCHIVE_EOF, read_crc(a, &got));
+		failure("entry %d", k);
+		assertEqualInt(crc[k], got);
+		assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	}
+}
@@ -0,0 +1,77 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * Read Cabinet files with "cab:threads" set and check that every
+ * entry comes back exactly as it does when read sequentially.
+ *
+ * test_read_format_cab_threads.cab holds six folders: LZX with 32 KiB,
+ * 2 MiB and 64 KiB windows and E8 call translation, two in MSZIP and
+ * one stored, most of them spanning several CFDATA.
+ */
+
+static void
+verify(const char *refname, int count)
+{
+	static const char *options[] = {
+		"cab:threads=2", "cab:threads=4", "cab:threads=0", NULL
+	};
+	struct read_threads_result *expect, *got;
+	int i;
+
+	extract_reference_file(refname);
+	read_threads_verify(refname, options, 0);
+
+	/*
+	 * Reading only the last entry, after skipping whole folders
+	 * without reading any data, gives the same result.
+	 */
+	assert((expect = malloc(sizeof(*expect))) != NULL);
+	assert((got = malloc(sizeof(*got))) != NULL);
+	read_threads_archive(refname, NULL, 0, NULL, 0, 0, expect);
+	assertEqualInt(count, expect->count);
+	read_threads_archive(refname, NULL, 0, NULL, 0, count - 1, got);
+	read_threads_compare(refname, "no options", expect, got, count - 1, -1);
+	for (i = 0; options[i] != NULL; i++) {
+		read_threads_archive(refname, NULL, 0, options[i], 0,
+		    count - 1, got);
+		read_threads_compare(refname, options[i], expect, got,
+		    count - 1, -1);
+	}
+	free(expect);
+	free(got);
+}
+
+DEFINE_TEST(test_read_format_cab_threads)
+{
+	assert(read_threads_check_option("cab",
+	    archive_read_support_format_cab));
+
+	verify("test_read_format_cab_threads.cab", 12);
+	verify("test_read_format_cab_1.cab", 3);
+	verify("test_read_format_cab_2.cab", 4);
+	verify("test_read_format_cab_3.cab", 4);
+}
@@ -0,0 +1,107 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * Read an ISO 9660 image with "iso9660:threads" set and check that
+ * every entry comes back exactly as it does when read sequentially.
+ *
+ * test_read_format_iso_threads.iso.Z holds 96 small files spread over
+ * 24 nested directories, so that many directory extents are pending at
+ * once, and "big", a zisofs file of 41 blocks of 32 KiB: blocks 4 and
+ * 22 are zero blocks without any compressed data and the last one is
+ * short.
+ */
+
+#define	BIG_SIZE	(40 * 32768 + 1234)
+
+/* The contents of "big". */
+static void
+make_big(char *p, size_t size)
+{
+	char line[64];
+	size_t i, l;
+	int n;
+
+	for (i = 0, n = 0; i < size; i += l, n++) {
+		l = snprintf(line, sizeof(line), "zisofs block %d, line %d\n",
+		    (int)(i >> 15), n % 7);
+		if (l > size - i)
+			l = size - i;
+		memcpy(p + i, line, l);
+	}
+	memset(p + 3 * 32768 + 100, 0, 2 * 32768);
+	memset(p + 22 * 32768, 0, 32768);
+}
+
+DEFINE_TEST(test_read_format_iso_threads)
+{
+	static const char *options[] = {
+		"iso9660:threads=2", "iso9660:threads=3", "iso9660:threads=0",
+		NULL
+	};
+	const char *refname = "test_read_format_iso_threads.iso.Z";
+	struct read_threads_result *expect;
+	char *big;
+	int i, found;
+
+	assert(read_threads_check_option("iso9660",
+	    archive_read_support_format_iso9660));
+
+	if (archive_zlib_version() == NULL) {
+		skipping("zisofs needs zlib");
+		return;
+	}
+	extract_reference_file(refname);
+	assert((big = malloc(BIG_SIZE)) != NULL);
+	assert((expect = malloc(sizeof(*expect))) != NULL);
+	make_big(big, BIG_SIZE);
+
+	/* Reading sequentially gives back what was stored. */
+	read_threads_archive(refname, NULL, 0, NULL, 0, 0, expect);
+	/* ".", "big", the directories and the small files. */
+	assertEqualInt(1 + 1 + 24 + 96, expect->count);
+	found = 0;
+	for (i = 0; i < expect->count; i++) {
+		if (strcmp(expect->name[i], "big") != 0)
+			continue;
+		found = 1;
+		assertEqualInt(BIG_SIZE, expect->size[i]);
+		assertEqualInt(ARCHIVE_EOF, expect->ret[i]);
+		assert(expect->sum[i] == read_threads_checksum(0, big,
+		    BIG_SIZE));
+	}
+	assert(found);
+
+	/*
+	 * Of the entries whose data is read when skipping, only the first
+	 * block: the small files have just one, but the rest of "big" is
+	 * skipped part way.
+	 */
+	read_threads_verify(refname, options, READ_THREADS_FIRST_BLOCK);
+
+	free(expect);
+	free(big);
+}
@@ -0,0 +1,129 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * Read -lh5- and -lh7- entries that are larger than the decoder's
+ * window, so that the window wraps around, and whose data mixes text,
+ * runs of one byte, short repeated patterns and random bytes.  Their
+ * content is regenerated here and compared byte by byte.
+ */
+
+#define	DATA_SIZE	140000
+
+static const char *words[] = {
+	"alpha ", "bravo ", "charlie ", "delta ", "echo ", "foxtrot ",
+	"golf ", "hotel ", "india ", "juliett ", "kilo ", "lima ",
+	"mike ", "november ", "oscar ", "papa\n"
+};
+
+static void
+generate(unsigned char *buff, size_t size)
+{
+	unsigned long x = 12345;
+	size_t n = 0, i, len;
+
+#define	PUT(c)	do { if (n < size) buff[n++] = (unsigned char)(c); } while (0)
+	while (n < size) {
+		unsigned r;
+
+		x = (x * 1103515245UL + 12345) & 0x7fffffff;
+		r = (x >> 16) & 0xff;
+		if (r < 200) {
+			for (i = 0; i < (r & 7); i++) {
+				const char *w = words[(r + i) & 15];
+				for (; *w; w++)
+					PUT(*w);
+			}
+		} else if (r < 220) {
+			len = 3 + (x & 63);
+			for (i = 0; i < len; i++)
+				PUT('a' + (r & 7));
+		} else if (r < 252) {
+			len = 2 + (x & 15);
+			for (i = 0; i < len; i++) {
+				PUT('x');
+				PUT('y');
+				if (r & 1)
+					PUT('z');
+			}
+		} else
+			PUT((x >> 8) & 0xff);
+	}
+#undef PUT
+}
+
+static void
+verify_entry(struct archive *a, const char *name, const unsigned char *expect)
+{
+	struct archive_entry *ae;
+	const void *buff;
+	size_t size;
+	int64_t offset, total = 0;
+	int r;
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString(name, archive_entry_pathname(ae));
+	assertEqualInt(DATA_SIZE, archive_entry_size(ae));
+	while ((r = archive_read_data_block(a, &buff, &size, &offset))
+	    == ARCHIVE_OK) {
+		failure("%s at offset %d", name, (int)offset);
+		assertEqualInt(total, offset);
+		if (offset + (int64_t)size > DATA_SIZE) {
+			assert(offset + (int64_t)size <= DATA_SIZE);
+			break;
+		}
+		assertEqualMem(buff, expect + offset, size);
+		total += size;
+	}
+	/* The entry CRC is checked when the end of data is reached. */
+	assertEqualIntA(a, ARCHIVE_EOF, r);
+	assertEqualInt(DATA_SIZE, total);
+}
+
+DEFINE_TEST(test_read_format_lha_large)
+{
+	const char *refname = "test_read_format_lha_large.lzh";
+	struct archive_entry *ae;
+	struct archive *a;
+	unsigned char *expect;
+
+	assert((expect = malloc(DATA_SIZE)) != NULL);
+	generate(expect, DATA_SIZE);
+	extract_reference_file(refname);
+
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_filename(a, refname, 10240));
+	verify_entry(a, "lh5", expect);
+	verify_entry(a, "lh7", expect);
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualIntA(a, ARCHIVE_FORMAT_LHA, archive_format(a));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	free(expect);
+}
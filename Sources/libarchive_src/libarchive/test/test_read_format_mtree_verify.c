@@ -0,0 +1,165 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * Check the digests given in an mtree spec against the files it names
+ * with "mtree:verify", hashing them one at a time and ahead of the
+ * entry being read on worker threads.
+ */
+
+#define	SHA256_ONE \
+	"2c8b08da5ce60398e1f19af0e5dccc744df274b826abe585eaba68c525434806"
+#define	SHA256_THREE \
+	"f6936912184481f5edd4c304ce27c5a1a827804fc7f329f43d273b8621870776"
+#define	SHA256_DATA \
+	"6667b2d1aab6a00caa5aee5af8ad9f1465e567abf1c209d15727d57b3e8f6e5f"
+#define	SHA256_SAME \
+	"a6328afc76e9db71da297ebff4b0d3e7a7eb3b01d917c05a6573fef121b6ecb6"
+
+#define	MAX_ENTRIES	64
+
+struct result {
+	int		 count;
+	char		 name[MAX_ENTRIES][32];
+	int		 ret[MAX_ENTRIES];
+	int		 mismatch[MAX_ENTRIES];
+};
+
+static void
+read_spec(const char *spec, const char *options, struct result *res)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	int r;
+
+	memset(res, 0, sizeof(*res));
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_set_options(a, options));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_memory(a, spec, strlen(spec)));
+	while (res->count < MAX_ENTRIES) {
+		int i = res->count;
+
+		r = archive_read_next_header(a, &ae);
+		if (r != ARCHIVE_OK && r != ARCHIVE_WARN)
+			break;
+		res->count++;
+		strncpy(res->name[i], archive_entry_pathname(ae),
+		    sizeof(res->name[i]) - 1);
+		res->ret[i] = r;
+		if (r == ARCHIVE_WARN)
+			res->mismatch[i] = strstr(archive_error_string(a),
+			    "sha256 digest mismatch") != NULL;
+	}
+	assertEqualIntA(a, ARCHIVE_EOF, r);
+	assertEqualInt(ARCHIVE_OK, archive_read_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+}
+
+DEFINE_TEST(test_read_format_mtree_verify)
+{
+	static const char *options[] = {
+		"mtree:verify", "mtree:verify,mtree:threads=2",
+		"mtree:verify,mtree:threads=3", "mtree:threads=0,mtree:verify",
+		NULL
+	};
+	static char spec[4096];
+	struct result *res;
+	char name[16];
+	int i, j;
+
+	assert(read_threads_check_option("mtree",
+	    archive_read_support_format_mtree));
+
+	assertMakeDir("d", 0755);
+	assertMakeFile("d/one", 0644, "one\n");
+	assertMakeFile("d/two", 0644, "two\n");
+	assertMakeFile("three", 0644, "three\n");
+	assertMakeFile("data", 0644, "data\n");
+	assertMakeFile("plain", 0644, "plain\n");
+
+	/*
+	 * "d/two" and every fifth of the "fNN" files do not match their
+	 * digests; the directory entries, "..", the contents keyword
+	 * and the files without digests shift what is hashed ahead.
+	 */
+	strcpy(spec,
+	    "#mtree\n"
+	    "/set type=file mode=0644 sha256digest=" SHA256_SAME "\n"
+	    "d type=dir mode=0755\n"
+	    " one sha256digest=" SHA256_ONE "\n"
+	    " two sha256digest=" SHA256_ONE "\n"
+	    " ..\n"
+	    "three sha256digest=" SHA256_THREE "\n"
+	    "alias contents=data \\\n"
+	    "    sha256digest=" SHA256_DATA "\n"
+	    "/unset sha256digest\n"
+	    "plain\n"
+	    "/set sha256digest=" SHA256_SAME "\n");
+	for (i = 0; i < 20; i++) {
+		snprintf(name, sizeof(name), "f%02d", i);
+		assertMakeFile(name, 0644, i % 5 == 3 ? "diff\n" : "same\n");
+		strcat(spec, name);
+		strcat(spec, "\n");
+		if (i % 7 == 6) {
+			/* Files without digests in between. */
+			snprintf(name, sizeof(name), "p%02d", i);
+			assertMakeFile(name, 0644, "plain\n");
+			strcat(spec, "/unset sha256digest\n");
+			strcat(spec, name);
+			strcat(spec,
+			    "\n/set sha256digest=" SHA256_SAME "\n");
+		}
+	}
+
+	assert((res = malloc(sizeof(*res))) != NULL);
+	for (i = 0; options[i] != NULL; i++) {
+		read_spec(spec, options[i], res);
+		failure("%s", options[i]);
+		assertEqualInt(6 + 20 + 2, res->count);
+		for (j = 0; j < res->count; j++) {
+			const char *n = res->name[j];
+			int bad;
+
+			bad = strcmp(n, "d/two") == 0 ||
+			    (n[0] == 'f' && atoi(n + 1) % 5 == 3);
+			failure("%s: %s", options[i], n);
+			assertEqualInt(bad ? ARCHIVE_WARN : ARCHIVE_OK,
+			    res->ret[j]);
+			assertEqualInt(bad, res->mismatch[j]);
+		}
+	}
+
+	/* Without verify, the digests are only recorded. */
+	read_spec(spec, "mtree:checkfs,mtree:threads=3", res);
+	assertEqualInt(6 + 20 + 2, res->count);
+	for (j = 0; j < res->count; j++)
+		assertEqualInt(ARCHIVE_OK, res->ret[j]);
+
+	free(res);
+}
@@ -3929,3 +3929,162 @@ DEFINE_TEST(test_read_format_rar_symlink_huge)
   assertEqualInt(ARCHIVE_OK, archive_read_free(a));
 #endif
 }
+
+/*
+ * Compare whole entries against sizes and checksums taken from the
+ * decoder before its LZSS copies, Huffman lookups and filter scans
+ * were sped up.  Between them these archives reach every branch of
+ * lzss_emit_match(): plain copies, overlapping copies at distances
+ * of 1, 2 to 7 and 8 or more, copies whose source lies ahead of the
+ * destination, matches that wrap the window and, in
+ * ppmd_lzss_conversion and the multivolume set, matches that end
+ * exactly at the end of the window.  Each entry is read twice, with
+ * an odd archive_read_data() size and with archive_read_data_block(),
+ * so the window is also copied out at unaligned offsets.
+ */
+struct rar_lzss_entry {
+  const char *pathname;
+  int64_t size;
+  uint32_t sum;
+};
+
+static uint32_t
+rar_lzss_checksum(uint32_t sum, const void *buff, size_t size)
+{
+  const unsigned char *p = buff;
+
+  while (size-- > 0)
+    sum = sum * 31 + *p++;
+  return (sum);
+}
+
+static void
+test_read_format_rar_lzss_body(const char **reffiles,
+    const struct rar_lzss_entry *expect)
+{
+  static char buff[4093];
+  const struct rar_lzss_entry *e;
+  struct archive_entry *ae;
+  struct archive *a;
+  const void *block;
+  size_t block_size;
+  la_int64_t block_offset;
+  int64_t total, gaps;
+  uint32_t sum;
+  la_ssize_t bytes;
+  int pass, r;
+
+  for (pass = 0; pass < 2; pass++) {
+    assert((a = archive_read_new()) != NULL);
+    assertA(0 == archive_read_support_filter_all(a));
+    assertA(0 == archive_read_support_format_all(a));
+    assertA(0 == archive_read_open_filenames(a, reffiles, 10240));
+    for (e = expect; e->pathname != NULL; e++) {
+      assertA(0 == archive_read_next_header(a, &ae));
+      assertEqualString(e->pathname, archive_entry_pathname(ae));
+      assertEqualInt(e->size, archive_entry_size(ae));
+      total = 0;
+      gaps = 0;
+      sum = 0;
+      if (pass == 0) {
+        while ((bytes = archive_read_data(a, buff, sizeof(buff))) > 0) {
+          sum = rar_lzss_checksum(sum, buff, bytes);
+          total += bytes;
+        }
+        assertEqualIntA(a, 0, bytes);
+      } else {
+        while ((r = archive_read_data_block(a, &block, &block_size,
+            &block_offset)) == ARCHIVE_OK) {
+          if (block_offset != total)
+            gaps++;
+          sum = rar_lzss_checksum(sum, block, block_size);
+          total += block_size;
+        }
+        assertEqualIntA(a, ARCHIVE_EOF, r);
+        assertEqualInt(0, gaps);
+      }
+      assertEqualInt(e->size, total);
+      assertEqualInt(e->sum, sum);
+    }
+    assertA(1 == archive_read_next_header(a, &ae));
+    assertEqualIntA(a, ARCHIVE_OK, archive_read_close(a));
+    assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+  }
+}
+
+DEFINE_TEST(test_read_format_rar_lzss_copies)
+{
+  static const char *filter[] = {
+    "test_read_format_rar_filter.rar", NULL
+  };
+  static const struct rar_lzss_entry filter_expect[] = {
+    { "bsdcat.exe", 204288, 3639224588U },
+    { NULL, 0, 0 }
+  };
+  static const char *binary_data[] = {
+    "test_read_format_rar_binary_data.rar", NULL
+  };
+  static const struct rar_lzss_entry binary_data_expect[] = {
+    { "random_data.bin", 1048576, 1920378970U },
+    { "LibarchiveAddingTest.odt", 32618, 3416462359U },
+    { NULL, 0, 0 }
+  };
+  static const char *compress_normal[] = {
+    "test_read_format_rar_compress_normal.rar", NULL
+  };
+  static const struct rar_lzss_entry compress_normal_expect[] = {
+    { "LibarchiveAddingTest.html", 20111, 2833176052U },
+    { "testlink", 0, 0 },
+    { "testdir/test.txt", 20, 2955188541U },
+    { "testdir/LibarchiveAddingTest.html", 20111, 2833176052U },
+    { "testdir", 0, 0 },
+    { "testemptydir", 0, 0 },
+    { NULL, 0, 0 }
+  };
+  static const char *multi_lzss_blocks[] = {
+    "test_read_format_rar_multi_lzss_blocks.rar", NULL
+  };
+  static const struct rar_lzss_entry multi_lzss_blocks_expect[] = {
+    { "multi_lzss_blocks_test.txt", 20131111, 725747700U },
+    { NULL, 0, 0 }
+  };
+  static const char *ppmd_lzss_conversion[] = {
+    "test_read_format_rar_ppmd_lzss_conversion.rar", NULL
+  };
+  static const struct rar_lzss_entry ppmd_lzss_conversion_expect[] = {
+    { "ppmd_lzss_conversion_test.txt", 241647978, 1497973888U },
+    { NULL, 0, 0 }
+  };
+  static const char *multivolume[] = {
+    "test_read_format_rar_multivolume.part0001.rar",
+    "test_read_format_rar_multivolume.part0002.rar",
+    "test_read_format_rar_multivolume.part0003.rar",
+    "test_read_format_rar_multivolume.part0004.rar",
+    NULL
+  };
+  static const struct rar_lzss_entry multivolume_expect[] = {
+    { "ppmd_lzss_conversion_test.txt", 241647978, 1497973888U },
+    { "LibarchiveAddingTest.html", 20111, 2833176052U },
+    { "testlink", 0, 0 },
+    { "testdir/test.txt", 20, 2955188541U },
+    { "testdir/LibarchiveAddingTest.html", 20111, 2833176052U },
+    { "testdir", 0, 0 },
+    { "testemptydir", 0, 0 },
+    { NULL, 0, 0 }
+  };
+
+  extract_reference_files(filter);
+  extract_reference_files(binary_data);
+  extract_reference_files(compress_normal);
+  extract_reference_files(multi_lzss_blocks);
+  extract_reference_files(ppmd_lzss_conversion);
+  extract_reference_files(multivolume);
+
+  test_read_format_rar_lzss_body(filter, filter_expect);
+  test_read_format_rar_lzss_body(binary_data, binary_data_expect);
+  test_read_format_rar_lzss_body(compress_normal, compress_normal_expect);
+  test_read_format_rar_lzss_body(multi_lzss_blocks, multi_lzss_blocks_expect);
+  test_read_format_rar_lzss_body(ppmd_lzss_conversion,
+      ppmd_lzss_conversion_expect);
+  test_read_format_rar_lzss_body(multivolume, multivolume_expect);
+}
@@ -1428,3 +1428,85 @@ DEFINE_TEST(test_read_format_rar5_data_ready_pointer_leak)
 
 	EPILOGUE();
 }
+
+/* Unpacks every entry and returns a checksum over all names and data. */
+static uint32_t
+read_all_crc(const char** reffiles, const char* options, int* count)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	const void* buf;
+	size_t size;
+	la_int64_t offset;
+	uint32_t crc = 0;
+	int r;
+
+	*count = 0;
+	assert((a = archive_read_new()) != NULL);
+	assertA(0 == archive_read_support_filter_all(a));
+	assertA(0 == archive_read_support_format_all(a));
+	if(options)
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_set_options(a, options));
+	assertA(0 == archive_read_open_filenames(a, reffiles, 10240));
+	while(archive_read_next_header(a, &ae) == ARCHIVE_OK) {
+		const char* name = archive_entry_pathname(ae);
+
+		crc = bitcrc32(crc, name, strlen(name));
+		while((r = archive_read_data_block(a, &buf, &size,
+		    &offset)) == ARCHIVE_OK) {
+			if(size > 0)
+				crc = bitcrc32(crc, buf, size);
+		}
+		assertEqualIntA(a, ARCHIVE_EOF, r);
+		(*count)++;
+	}
+	EPILOGUE();
+	return crc;
+}
+
+DEFINE_TEST(test_read_format_rar5_threads)
+{
+	/* The X86, DELTA and ARM filters are run on worker threads; the
+	 * result must not differ from running them inline. */
+	const char* multi[] = {
+		"test_read_format_rar5_multiarchive.part01.rar",
+		"test_read_format_rar5_multiarchive.part02.rar",
+		"test_read_format_rar5_multiarchive.part03.rar",
+		"test_read_format_rar5_multiarchive.part04.rar",
+		"test_read_format_rar5_multiarchive.part05.rar",
+		"test_read_format_rar5_multiarchive.part06.rar",
+		"test_read_format_rar5_multiarchive.part07.rar",
+		"test_read_format_rar5_multiarchive.part08.rar",
+		NULL
+	};
+	const char* arm[] = { "test_read_format_rar5_arm.rar", NULL };
+	const char* solid[] = {
+		"test_read_format_rar5_multiarchive_solid.part01.rar",
+		"test_read_format_rar5_multiarchive_solid.part02.rar",
+		"test_read_format_rar5_multiarchive_solid.part03.rar",
+		"test_read_format_rar5_multiarchive_solid.part04.rar",
+		NULL
+	};
+	const char** sets[] = { multi, arm, solid, NULL };
+	const char* options[] = { "rar5:threads=2", "rar5:threads=8", NULL };
+	uint32_t expect, got;
+	int i, j, expect_count, got_count;
+
+	assert(read_threads_check_option("rar5",
+	    archive_read_support_format_rar5));
+
+	extract_reference_files(multi);
+	extract_reference_files(arm);
+	extract_reference_files(solid);
+	for(i = 0; sets[i] != NULL; i++) {
+		expect = read_all_crc(sets[i], NULL, &expect_count);
+		assert(expect_count > 0);
+		for(j = 0; options[j] != NULL; j++) {
+			got = read_all_crc(sets[i], options[j], &got_count);
+			failure("%s with %s", sets[i][0], options[j]);
+			assertEqualInt(expect_count, got_count);
+			assertEqualInt(expect, got);
+		}
+	}
+}
@@ -0,0 +1,109 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * Build a one-entry ustar archive whose name contains bytes with the
+ * high bit set, so the unsigned and signed header checksums differ.
+ * Old BSD, Solaris and HP-UX tars wrote the signed variant; both must
+ * be accepted, and anything else must be rejected.
+ */
+
+#define	CKSUM_UNSIGNED	0
+#define	CKSUM_SIGNED	1
+#define	CKSUM_BAD	2
+
+static void
+make_archive(char *buff, int variant)
+{
+	int i, usum = 0, ssum = 0, sum;
+
+	memset(buff, 0, 2048);
+	/* Name with a Latin-1 e-acute and some other 8-bit bytes. */
+	memcpy(buff, "caf\xe9\xff\x80\x90.txt", 11);
+	memcpy(buff + 100, "0000644", 8);
+	memcpy(buff + 108, "0001750", 8);
+	memcpy(buff + 116, "0001750", 8);
+	memcpy(buff + 124, "00000000005", 12);
+	memcpy(buff + 136, "14247604456", 12);
+	buff[156] = '0';
+	memcpy(buff + 257, "ustar", 6);
+	memcpy(buff + 263, "00", 2);
+	/* Spread some high bytes through the second half of the block. */
+	for (i = 345; i < 500; i += 7)
+		buff[i] = (char)(0x80 + i % 127);
+	memcpy(buff + 512, "hello", 5);
+
+	memset(buff + 148, ' ', 8);
+	for (i = 0; i < 512; i++) {
+		usum += (unsigned char)buff[i];
+		ssum += (signed char)buff[i];
+	}
+	assert(usum != ssum);
+	switch (variant) {
+	case CKSUM_UNSIGNED:	sum = usum; break;
+	case CKSUM_SIGNED:	sum = ssum; break;
+	default:		sum = usum + 1; break;
+	}
+	sprintf(buff + 148, "%06o", sum);
+	buff[155] = ' ';
+}
+
+static void
+verify(int variant)
+{
+	char buff[2048];
+	struct archive_entry *ae;
+	struct archive *a;
+
+	make_archive(buff, variant);
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	if (variant == CKSUM_BAD) {
+		/* Nothing else looks like a tar header, so the bid fails. */
+		assertEqualIntA(a, ARCHIVE_FATAL,
+		    archive_read_open_memory(a, buff, sizeof(buff)));
+	} else {
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_open_memory(a, buff, sizeof(buff)));
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_next_header(a, &ae));
+		assertEqualInt(archive_entry_mode(ae), AE_IFREG | 0644);
+		assertEqualInt(archive_entry_uid(ae), 1000);
+		assertEqualInt(archive_entry_size(ae), 5);
+		assertEqualInt(archive_entry_mtime(ae), 1654589742);
+		/* The two null blocks after the body end the archive. */
+		assertEqualIntA(a, ARCHIVE_EOF,
+		    archive_read_next_header(a, &ae));
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_free(a));
+}
+
+DEFINE_TEST(test_read_format_tar_checksum)
+{
+	verify(CKSUM_UNSIGNED);
+	verify(CKSUM_SIGNED);
+	verify(CKSUM_BAD);
+}
@@ -0,0 +1,193 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * Build a tar archive, read it once sequentially with "write-index",
+ * then reopen it with "read-index" and jump to entries out of order.
+ */
+
+#define	NFILES	64
+
+static void
+entry_name(char *buff, size_t size, int i)
+{
+	/* Every fourth name is too long for ustar, forcing a pax
+	 * 'x' header or a GNU 'L' header. */
+	if (i % 4 == 3)
+		snprintf(buff, size, "dir%d/%0150d", i, i);
+	else
+		snprintf(buff, size, "dir%d/file%d", i, i);
+}
+
+static size_t
+entry_size(int i)
+{
+	return ((size_t)(i * 397) % 2000);
+}
+
+static size_t
+make_archive(char *buff, size_t buffsize, int format)
+{
+	char name[256], data[2048];
+	struct archive_entry *ae;
+	struct archive *a;
+	size_t used, size;
+	int i;
+
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format(a, format));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_none(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, buffsize, &used));
+	for (i = 0; i < NFILES; i++) {
+		entry_name(name, sizeof(name), i);
+		size = entry_size(i);
+		memset(data, 'a' + i % 26, size);
+		assert((ae = archive_entry_new()) != NULL);
+		archive_entry_copy_pathname(ae, name);
+		archive_entry_set_mode(ae, AE_IFREG | 0644);
+		archive_entry_set_size(ae, size);
+		assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+		assertEqualInt((la_ssize_t)size,
+		    archive_write_data(a, data, size));
+		archive_entry_free(ae);
+	}
+	/* A symlink with a long target. */
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "link");
+	archive_entry_set_mode(ae, AE_IFLNK | 0755);
+	entry_name(name, sizeof(name), 3);
+	archive_entry_copy_symlink(ae, name);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	archive_entry_free(ae);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+	return (used);
+}
+
+static void
+verify_entry(struct archive *a, int i)
+{
+	char name[256], data[2048];
+	struct archive_entry *ae;
+	size_t size, n;
+
+	entry_name(name, sizeof(name), i);
+	size = entry_size(i);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_tar_seek_entry(a, name));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString(name, archive_entry_pathname(ae));
+	assertEqualInt(size, archive_entry_size(ae));
+	assertEqualInt((la_ssize_t)size, archive_read_data(a, data, sizeof(data)));
+	for (n = 0; n < size; n++) {
+		if (data[n] != 'a' + i % 26) {
+			failure("entry %d byte %d", i, (int)n);
+			assert(0);
+			break;
+		}
+	}
+}
+
+static void
+test_format(int format)
+{
+	static const size_t buffsize = 1024 * 1024;
+	char *buff;
+	char name[256];
+	struct archive_entry *ae;
+	struct archive *a;
+	size_t used;
+	int i, n;
+
+	assert((buff = malloc(buffsize)) != NULL);
+	used = make_archive(buff, buffsize, format);
+
+	/* Sequential pass that builds the index. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_set_options(a, "tar:write-index=test.idx"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, buff, used));
+	for (n = 0; archive_read_next_header(a, &ae) == ARCHIVE_OK; n++)
+		;
+	assertEqualInt(NFILES + 1, n);
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	assertFileExists("test.idx");
+
+	/* Random access using the index. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_set_options(a, "tar:read-index=test.idx"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, buff, used));
+	for (i = NFILES - 1; i >= 0; i -= 5)
+		verify_entry(a, i);
+	/* Seeking from the middle of an entry body. */
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_tar_seek_entry(a, "link"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualInt(AE_IFLNK, archive_entry_filetype(ae));
+	entry_name(name, sizeof(name), 3);
+	assertEqualString(name, archive_entry_symlink(ae));
+	verify_entry(a, 7);
+	/* Seeking after end of archive. */
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_tar_seek_entry(a, "link"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	verify_entry(a, 0);
+	/* Unknown entries are reported, and leave the reader usable. */
+	assertEqualIntA(a, ARCHIVE_FAILED,
+	    archive_read_tar_seek_entry(a, "no/such/file"));
+	verify_entry(a, NFILES - 1);
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	/* Rewriting a loaded index doesn't record its entries twice. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_set_options(a,
+	    "tar:read-index=test.idx,tar:write-index=test2.idx"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, buff, used));
+	for (n = 0; archive_read_next_header(a, &ae) == ARCHIVE_OK; n++)
+		;
+	assertEqualInt(NFILES + 1, n);
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	assertEqualFile("test2.idx", "test.idx");
+
+	/* Without an index, seeking is refused. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, buff, used));
+	assertEqualIntA(a, ARCHIVE_FAILED,
+	    archive_read_tar_seek_entry(a, "link"));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	free(buff);
+}
+
+DEFINE_TEST(test_read_format_tar_index)
+{
+	test_format(ARCHIVE_FORMAT_TAR_PAX_RESTRICTED);
+	test_format(ARCHIVE_FORMAT_TAR_GNUTAR);
+}
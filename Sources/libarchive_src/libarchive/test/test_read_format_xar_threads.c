@@ -0,0 +1,126 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * Read a xar archive with "xar:threads" set and check that every entry
+ * comes back as it does when read sequentially.
+ *
+ * test_read_format_xar_threads.xar holds gzip, bzip2 and xz compressed
+ * files, large ones which are decompressed on worker threads and small
+ * ones, a stored file, a file whose extracted checksum is wrong and,
+ * in "d3", files whose heap data is stored in reverse order.  Each file
+ * holds lines of "<pathname> line <n % 97>".
+ */
+
+/* The checksum of the contents of a file. */
+static unsigned long
+text_checksum(const char *pathname, size_t size)
+{
+	char line[96];
+	unsigned long sum = 0;
+	size_t i, l;
+	int n;
+
+	for (i = 0, n = 0; i < size; i += l, n++) {
+		l = snprintf(line, sizeof(line), "%s line %d\n",
+		    pathname, n % 97);
+		if (l > size - i)
+			l = size - i;
+		sum = read_threads_checksum(sum, line, l);
+	}
+	return (sum);
+}
+
+DEFINE_TEST(test_read_format_xar_threads)
+{
+	static const char *options[] = {
+		"xar:threads=2", "xar:threads=3", "xar:threads=0", NULL
+	};
+	const char *refname = "test_read_format_xar_threads.xar";
+	struct read_threads_result *expect, *got;
+	const char *data;
+	size_t size;
+	int i, n, skip, checked;
+
+	if (!read_threads_check_option("xar",
+	    archive_read_support_format_xar)) {
+		skipping("xar reading not fully supported on this platform");
+		return;
+	}
+
+	extract_reference_file(refname);
+	assert((expect = malloc(sizeof(*expect))) != NULL);
+	assert((got = malloc(sizeof(*got))) != NULL);
+
+	/* Reading sequentially gives back what was stored. */
+	read_threads_archive(refname, NULL, 0, NULL, 0, 0, expect);
+	/* Three directories and 21 files. */
+	assertEqualInt(3 + 21, expect->count);
+	checked = 0;
+	for (i = 0; i < expect->count; i++) {
+		if (strcmp(expect->name[i], "d2/bad") == 0) {
+			assertEqualInt(ARCHIVE_FAILED, expect->ret[i]);
+			continue;
+		}
+		/* bzip2 or xz may not be supported. */
+		if (expect->ret[i] != ARCHIVE_EOF)
+			continue;
+		failure("%s", expect->name[i]);
+		assert(expect->sum[i] == text_checksum(expect->name[i],
+		    (size_t)expect->size[i]));
+		checked++;
+	}
+	assert(checked >= 3 + 18);
+
+	read_threads_verify(refname, options, 0);
+
+	/*
+	 * Without seeking, reading sequentially stops after "d2/bad",
+	 * but every file up to it must be read the same, however far
+	 * ahead their data has been read.
+	 */
+	data = slurpfile(&size, "%s", refname);
+	assert(data != NULL);
+	for (skip = 0; skip <= 1; skip++) {
+		read_threads_archive(refname, data, size, NULL,
+		    skip ? READ_THREADS_SKIP_ODD : 0, 0, expect);
+		for (n = 0; n < expect->count; n++) {
+			if (strcmp(expect->name[n], "d2/bad") == 0)
+				break;
+		}
+		assert(n < expect->count);
+		for (i = 0; options[i] != NULL; i++) {
+			read_threads_archive(refname, data, size, options[i],
+			    skip ? READ_THREADS_SKIP_ODD : 0, 0, got);
+			read_threads_compare(refname, options[i], expect, got,
+			    0, n + 1);
+		}
+	}
+
+	free((void *)(uintptr_t)data);
+	free(got);
+	free(expect);
+}
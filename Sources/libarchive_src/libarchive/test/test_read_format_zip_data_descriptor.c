@@ -0,0 +1,131 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * Stored entries of unknown size end with a PK\007\010 data descriptor.
+ * Write some whose data contains that signature, followed by bytes that
+ * look like a descriptor, and check that the streaming reader finds the
+ * real end of each entry both when reading and when skipping the data.
+ */
+
+#define	DATA_SIZE	(200 * 1024)
+
+static void
+fill(char *data, size_t size, int seed)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		data[i] = (char)((i * 7 + seed) & 0xff);
+	/* Fake descriptors, some of them straddling read blocks. */
+	for (i = 100; i + 32 < size; i += 4093) {
+		memcpy(data + i, "PK\007\010", 4);
+		/* A compressed size one more than the bytes before
+		 * it, so only the size check tells it apart. */
+		data[i + 8] = (char)((i + 1) & 0xff);
+		data[i + 9] = (char)(((i + 1) >> 8) & 0xff);
+		data[i + 10] = (char)(((i + 1) >> 16) & 0xff);
+		data[i + 11] = 0;
+		/* And something that looks like the next entry. */
+		memcpy(data + i + 16, "PK\003\004", 4);
+	}
+}
+
+static size_t
+make_archive(char *buff, size_t buffsize, char *data)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	char name[16];
+	size_t used;
+	int i;
+
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_zip(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_set_options(a, "zip:compression=store"));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, buffsize, &used));
+	for (i = 0; i < 3; i++) {
+		snprintf(name, sizeof(name), "file%d", i);
+		fill(data, DATA_SIZE, i);
+		assert((ae = archive_entry_new()) != NULL);
+		archive_entry_copy_pathname(ae, name);
+		archive_entry_set_mode(ae, AE_IFREG | 0644);
+		/* No size, so the writer emits a data descriptor. */
+		assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+		assertEqualInt(DATA_SIZE, archive_write_data(a, data, DATA_SIZE));
+		archive_entry_free(ae);
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+	return (used);
+}
+
+static void
+read_archive(const char *buff, size_t used, char *data, char *expect,
+    int skip)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	char name[16];
+	int i;
+
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_support_format_zip_streamable(a));
+	assertEqualIntA(a, ARCHIVE_OK, read_open_memory(a, buff, used, 7));
+	for (i = 0; i < 3; i++) {
+		snprintf(name, sizeof(name), "file%d", i);
+		assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+		assertEqualString(name, archive_entry_pathname(ae));
+		if (skip && i != 1)
+			continue;
+		fill(expect, DATA_SIZE, i);
+		assertEqualInt(DATA_SIZE,
+		    archive_read_data(a, data, DATA_SIZE + 1));
+		assertEqualMem(expect, data, DATA_SIZE);
+	}
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+}
+
+DEFINE_TEST(test_read_format_zip_data_descriptor)
+{
+	size_t buffsize = 4 * DATA_SIZE;
+	char *buff, *data, *expect;
+	size_t used;
+
+	assert((buff = malloc(buffsize)) != NULL);
+	assert((data = malloc(DATA_SIZE + 1)) != NULL);
+	assert((expect = malloc(DATA_SIZE)) != NULL);
+	used = make_archive(buff, buffsize, data);
+	read_archive(buff, used, data, expect, 0);
+	read_archive(buff, used, data, expect, 1);
+	free(expect);
+	free(data);
+	free(buff);
+}
@@ -0,0 +1,218 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+/*
+ * Traditional PKWARE encryption: check candidate passphrases with
+ * archive_read_zip_find_passphrase() and verify that the CRC computed
+ * while decrypting stored entries catches damaged data.
+ */
+
+#define	DATA_SIZE	(200 * 1024)
+
+static int
+has_traditional_encryption(void)
+{
+	struct archive *a;
+	int r;
+
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_zip(a));
+	r = archive_write_set_options(a, "zip:encryption=traditional");
+	archive_write_free(a);
+	return (r == ARCHIVE_OK);
+}
+
+static void
+fill(char *data, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		data[i] = (char)((i * 7) ^ (i >> 9));
+}
+
+static size_t
+make_archive(char *buff, size_t buffsize, const char *data)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	size_t used;
+
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_zip(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_none(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_set_options(a,
+		"zip:encryption=traditional,zip:compression=store"));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_set_passphrase(a, "password1234"));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, buffsize, &used));
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "stored.bin");
+	archive_entry_set_mode(ae, AE_IFREG | 0644);
+	archive_entry_set_size(ae, DATA_SIZE);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	assertEqualInt(DATA_SIZE, archive_write_data(a, data, DATA_SIZE));
+	archive_entry_free(ae);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+	return (used);
+}
+
+/* Read the single entry and return the result of the last data read. */
+static int
+read_stored(const char *buff, size_t used, const char *data, int streamable,
+    int expect_data)
+{
+	struct archive_entry *ae;
+	struct archive *a;
+	char *out;
+	la_ssize_t n;
+	size_t total = 0;
+
+	assert((out = malloc(DATA_SIZE)) != NULL);
+	assert((a = archive_read_new()) != NULL);
+	if (streamable)
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_support_format_zip_streamable(a));
+	else
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_support_format_zip_seekable(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_add_passphrase(a, "password1234"));
+	if (streamable)
+		assertEqualIntA(a, ARCHIVE_OK,
+		    read_open_memory(a, buff, used, 7));
+	else
+		assertEqualIntA(a, ARCHIVE_OK,
+		    read_open_memory_seek(a, buff, used, 7));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("stored.bin", archive_entry_pathname(ae));
+	while ((n = archive_read_data(a, out + total,
+	    DATA_SIZE - total)) > 0) {
+		total += n;
+		if (total == DATA_SIZE)
+			break;
+	}
+	if (n > 0)
+		n = archive_read_data(a, out, 1);
+	if (expect_data) {
+		assertEqualInt(DATA_SIZE, total);
+		assertEqualMem(data, out, DATA_SIZE);
+	}
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	free(out);
+	return ((int)n);
+}
+
+static void
+test_fused_crc(void)
+{
+	static const size_t buffsize = DATA_SIZE + 4096;
+	char *buff, *data;
+	size_t used;
+	int streamable;
+
+	assert((buff = malloc(buffsize)) != NULL);
+	assert((data = malloc(DATA_SIZE)) != NULL);
+	fill(data, DATA_SIZE);
+	used = make_archive(buff, buffsize, data);
+
+	for (streamable = 0; streamable <= 1; streamable++) {
+		failure("streamable=%d", streamable);
+		assertEqualInt(0, read_stored(buff, used, data, streamable, 1));
+	}
+
+	/* Damage a byte in the middle of the entry: the decrypted data
+	 * no longer matches the stored CRC. */
+	buff[used / 2] ^= 0x40;
+	assertEqualInt(ARCHIVE_FAILED, read_stored(buff, used, data, 0, 0));
+
+	free(data);
+	free(buff);
+}
+
+static void
+test_find_passphrase(void)
+{
+	/* Password is "12345678". */
+	const char *refname =
+		"test_read_format_zip_traditional_encryption_data.zip";
+	static const char * const wrong[] = {
+		"invalid_pass", "invalid_phrase", "1234567", "123456789"
+	};
+	static const char * const candidates[] = {
+		"invalid_pass", NULL, "invalid_phrase", "12345678", "x"
+	};
+	struct archive_entry *ae;
+	struct archive *a;
+	char buff[512];
+
+	extract_reference_file(refname);
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_filename(a, refname, 10240));
+
+	/* No passphrases registered; find one for each entry. */
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("bar.txt", archive_entry_pathname(ae));
+	assertEqualIntA(a, ARCHIVE_WARN,
+	    archive_read_zip_find_passphrase(a, wrong, 4));
+	assertEqualIntA(a, ARCHIVE_WARN,
+	    archive_read_zip_find_passphrase(a, candidates, 0));
+	assertEqualIntA(a, 3,
+	    archive_read_zip_find_passphrase(a, candidates, 5));
+	assertEqualInt(495, archive_read_data(a, buff, sizeof(buff)));
+	/* Too late once the data has been read. */
+	assertEqualIntA(a, ARCHIVE_FAILED,
+	    archive_read_zip_find_passphrase(a, candidates, 5));
+
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("foo.txt", archive_entry_pathname(ae));
+	/* A failed search discards an earlier match. */
+	assertEqualIntA(a, 0,
+	    archive_read_zip_find_passphrase(a, candidates + 3, 1));
+	assertEqualIntA(a, ARCHIVE_WARN,
+	    archive_read_zip_find_passphrase(a, wrong, 4));
+	assertEqualInt(ARCHIVE_FAILED, archive_read_data(a, buff, sizeof(buff)));
+
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+}
+
+DEFINE_TEST(test_read_format_zip_passphrase_check)
+{
+	if (!has_traditional_encryption()) {
+		skipping("This system does not have cryptographic library");
+		return;
+	}
+	test_fused_crc();
+	test_find_passphrase();
+}
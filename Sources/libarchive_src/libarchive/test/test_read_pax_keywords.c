@@ -0,0 +1,151 @@
+/*-
+ * Copyright (c) 2026 libarchive contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR(S) BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+#include "test.h"
+
+/*
+ * Exercise the pax keyword table with a hand-built 'x' header holding
+ * standard, vendor and unknown keywords, followed by a ustar entry
+ * whose own fields the pax values must override.
+ */
+
+static size_t
+add_record(char *p, const char *key, const char *value, size_t value_len)
+{
+	char tmp[512];
+	size_t len, n;
+
+	/* The length prefix counts itself. */
+	n = strlen(key) + value_len + 3;
+	len = n + 1;
+	while (len != n + (size_t)snprintf(tmp, sizeof(tmp), "%d", (int)len))
+		len++;
+	n = (size_t)snprintf(p, len + 1, "%d %s=", (int)len, key);
+	memcpy(p + n, value, value_len);
+	p[len - 1] = '\n';
+	return (len);
+}
+
+static void
+make_header(char *h, const char *name, char type, size_t size)
+{
+	int i, sum = 0;
+
+	memset(h, 0, 512);
+	strcpy(h, name);
+	memcpy(h + 100, "0000644", 8);
+	memcpy(h + 108, "0000001", 8);
+	memcpy(h + 116, "0000001", 8);
+	snprintf(h + 124, 12, "%011o", (unsigned)size);
+	memcpy(h + 136, "00000000001", 12);
+	h[156] = type;
+	memcpy(h + 257, "ustar", 6);
+	memcpy(h + 263, "00", 2);
+	memset(h + 148, ' ', 8);
+	for (i = 0; i < 512; i++)
+		sum += (unsigned char)h[i];
+	snprintf(h + 148, 8, "%06o", sum);
+}
+
+DEFINE_TEST(test_read_pax_keywords)
+{
+	char buff[8192], body[2048];
+	struct archive_entry *ae;
+	struct archive *a;
+	const char *xname;
+	const void *xval;
+	size_t xsize, n = 0;
+	int i;
+
+	n += add_record(body + n, "comment", "ignored", 7);
+	n += add_record(body + n, "path", "pax/long/name", 13);
+	n += add_record(body + n, "uid", "4000000", 7);
+	n += add_record(body + n, "gid", "5000", 4);
+	n += add_record(body + n, "uname", "tim", 3);
+	n += add_record(body + n, "gname", "staff", 5);
+	n += add_record(body + n, "mtime", "1234567890.25", 13);
+	n += add_record(body + n, "atime", "1234567891", 10);
+	n += add_record(body + n, "FOO.unknown", "x", 1);
+	n += add_record(body + n, "SCHILY.dev", "77", 2);
+	n += add_record(body + n, "SCHILY.ino", "88", 2);
+	n += add_record(body + n, "SCHILY.nlink", "3", 1);
+	n += add_record(body + n, "SCHILY.xattr.user.bin", "a\0b", 3);
+	n += add_record(body + n, "LIBARCHIVE.xattr.user%2Efoo", "YmFy", 4);
+	n += add_record(body + n, "SCHILY.xattr.", "too short", 9);
+	n += add_record(body + n, "size", "5", 1);
+
+	memset(buff, 0, sizeof(buff));
+	make_header(buff, "PaxHeader/x", 'x', n);
+	memcpy(buff + 512, body, n);
+	i = 512 + (int)((n + 511) & ~(size_t)511);
+	make_header(buff + i, "ustar_name", '0', 99);
+	memcpy(buff + i + 512, "hello", 5);
+
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_memory(a, buff, sizeof(buff)));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("pax/long/name", archive_entry_pathname(ae));
+	assertEqualInt(4000000, archive_entry_uid(ae));
+	assertEqualInt(5000, archive_entry_gid(ae));
+	assertEqualString("tim", archive_entry_uname(ae));
+	assertEqualString("staff", archive_entry_gname(ae));
+	assertEqualInt(1234567890, archive_entry_mtime(ae));
+	assertEqualInt(250000000, archive_entry_mtime_nsec(ae));
+	assertEqualInt(1234567891, archive_entry_atime(ae));
+	assertEqualInt(77, archive_entry_dev(ae));
+	assertEqualInt(88, archive_entry_ino(ae));
+	assertEqualInt(3, archive_entry_nlink(ae));
+	assertEqualInt(5, archive_entry_size(ae));
+
+	assertEqualInt(2, archive_entry_xattr_reset(ae));
+	/* Most recently added first. */
+	assertEqualInt(ARCHIVE_OK,
+	    archive_entry_xattr_next(ae, &xname, &xval, &xsize));
+	assertEqualString("user.foo", xname);
+	assertEqualInt(3, xsize);
+	assertEqualMem("bar", xval, 3);
+	assertEqualInt(ARCHIVE_OK,
+	    archive_entry_xattr_next(ae, &xname, &xval, &xsize));
+	assertEqualString("user.bin", xname);
+	assertEqualInt(3, xsize);
+	assertEqualMem("a\0b", xval, 3);
+
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_free(a));
+
+	/* A record without its trailing newline abandons the rest of
+	 * the extension, leaving the ustar fields in place. */
+	body[n - 1] = ' ';
+	memcpy(buff + 512, body, n);
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_open_memory(a, buff, sizeof(buff)));
+	assertEqualIntA(a, ARCHIVE_WARN, archive_read_next_header(a, &ae));
+	assertEqualString("ustar_name", archive_entry_pathname(ae));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_free(a));
+}
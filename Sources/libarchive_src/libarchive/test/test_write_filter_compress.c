@@ -94,3 +94,102 @@ DEFINE_TEST(test_write_filter_compress)
 	free(data);
 	free(buff);
 }
+
+/*
+ * Round trip enough data to fill the string table several times,
+ * mixing text, long runs and incompressible stretches so that the
+ * writer clears the table and the reader sees every code size.
+ */
+DEFINE_TEST(test_write_filter_compress_large)
+{
+	static const char *words[] = {
+	    "archive", "compress", "entry", "filter", "header", "libarchive",
+	    "read", "string", "table", "write", "\n", " ", " ", " "
+	};
+	struct archive_entry *ae;
+	struct archive *a;
+	char *buff, *data, *out;
+	size_t buffsize, datasize, used, n, off;
+	unsigned int seed = 7;
+	int i;
+
+	datasize = 4 * 1024 * 1024;
+	assert(NULL != (data = malloc(datasize)));
+	for (off = 0; off < datasize;) {
+		seed = seed * 1103515245 + 12345;
+		switch ((seed >> 16) % 8) {
+		case 0:
+			/* Noise, which makes the writer clear the table. */
+			for (n = 0; n < 20000 && off < datasize; n++) {
+				seed = seed * 1103515245 + 12345;
+				data[off++] = (char)(seed >> 16);
+			}
+			break;
+		case 1:
+			n = (seed >> 8) % 5000;
+			for (; n > 0 && off < datasize; n--)
+				data[off++] = 'a';
+			break;
+		default:
+			for (i = 0; i < 2000 && off < datasize; i++) {
+				const char *w;
+
+				seed = seed * 1103515245 + 12345;
+				w = words[(seed >> 16) %
+				    (sizeof(words) / sizeof(words[0]))];
+				while (*w != '\0' && off < datasize)
+					data[off++] = *w++;
+			}
+			break;
+		}
+	}
+
+	buffsize = datasize;
+	assert(NULL != (buff = malloc(buffsize)));
+	assert(NULL != (out = malloc(datasize)));
+
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_ustar(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_compress(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, buffsize, &used));
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "file");
+	archive_entry_set_size(ae, datasize);
+	archive_entry_set_filetype(ae, AE_IFREG);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	archive_entry_free(ae);
+	/* Feed the writer in odd-sized pieces. */
+	for (off = 0; off < datasize; off += n) {
+		n = datasize - off < 77777 ? datasize - off : 77777;
+		assertEqualInt(n, archive_write_data(a, data + off, n));
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+	assert(used < datasize / 2);
+	/* The output of the encoder that predates the generation-tagged
+	 * hash table; the codes must not change. */
+	assertEqualInt(1952247, used);
+	assertEqualInt(0xC6A84C20, bitcrc32(0, buff, used));
+
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, buff, used));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualInt(archive_filter_code(a, 0), ARCHIVE_FILTER_COMPRESS);
+	/* Read it back in small pieces, too. */
+	for (off = 0; off < datasize; off += n) {
+		n = datasize - off < 1000 ? datasize - off : 1000;
+		if (!assertEqualInt(n, archive_read_data(a, out + off, n)))
+			break;
+	}
+	assertEqualMem(out, data, datasize);
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	free(out);
+	free(data);
+	free(buff);
+}
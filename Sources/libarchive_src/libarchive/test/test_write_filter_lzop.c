@@ -264,3 +264,95 @@ DEFINE_TEST(test_write_filter_lzop)
 	free(data);
 	free(buff);
 }
+
+/*
+ * Compress several blocks' worth of data on worker threads at each
+ * kind of compression level and make sure it reads back unchanged.
+ */
+DEFINE_TEST(test_write_filter_lzop_threads)
+{
+	static const char *levels[] = { "1", "5", "9" };
+	struct archive_entry *ae;
+	struct archive *a;
+	unsigned char *data, *out;
+	char *buff;
+	size_t buffsize, datasize, used, off, n, i, l;
+	unsigned int seed = 7;
+
+	/* Random bytes, runs of zeros, and text repeated from far back. */
+	datasize = 1500001;
+	assert(NULL != (data = malloc(datasize)));
+	assert(NULL != (out = malloc(datasize)));
+	for (i = 0; i < datasize; i++) {
+		seed = seed * 1103515245 + 12345;
+		if (i % 300000 < 100000)
+			data[i] = (unsigned char)(seed >> 16);
+		else if (i % 300000 < 150000)
+			data[i] = 0;
+		else if (i > 40000 && (seed >> 16) % 8)
+			data[i] = data[i - 30000 - (seed >> 20) % 9000];
+		else
+			data[i] = "lzop threads "[(seed >> 16) % 13];
+	}
+	buffsize = datasize + datasize / 8;
+	assert(NULL != (buff = malloc(buffsize)));
+
+	for (l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+		assert((a = archive_write_new()) != NULL);
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_write_set_format_raw(a));
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_write_add_filter_lzop(a));
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_write_set_filter_option(a, NULL,
+			"compression-level", levels[l]));
+		assertEqualIntA(a, ARCHIVE_FAILED,
+		    archive_write_set_filter_option(a, NULL, "threads", "-1"));
+		assertEqualIntA(a, ARCHIVE_FAILED,
+		    archive_write_set_filter_option(a, NULL, "threads", "two"));
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_write_set_filter_option(a, NULL, "threads", "4"));
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_write_set_bytes_per_block(a, 0));
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_write_open_memory(a, buff, buffsize, &used));
+		assert((ae = archive_entry_new()) != NULL);
+		archive_entry_set_pathname(ae, "data");
+		archive_entry_set_filetype(ae, AE_IFREG);
+		assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+		archive_entry_free(ae);
+		for (off = 0; off < datasize; off += n) {
+			n = datasize - off < 77777 ? datasize - off : 77777;
+			assertEqualInt(n, archive_write_data(a, data + off, n));
+		}
+		assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+		assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+		failure("compression-level=%s", levels[l]);
+		assert(used < datasize);
+
+		assert((a = archive_read_new()) != NULL);
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_support_format_raw(a));
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_support_filter_lzop(a));
+		assertEqualIntA(a, ARCHIVE_OK,
+		    archive_read_open_memory(a, buff, used));
+		assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+		assertEqualInt(ARCHIVE_FILTER_LZOP, archive_filter_code(a, 0));
+		memset(out, 0, datasize);
+		for (off = 0; off < datasize; off += n) {
+			n = datasize - off < 5000 ? datasize - off : 5000;
+			if (!assertEqualInt(n, archive_read_data(a, out + off, n)))
+				break;
+		}
+		failure("compression-level=%s", levels[l]);
+		assertEqualMem(out, data, datasize);
+		assertEqualInt(0, archive_read_data(a, out, 1));
+		assertEqualIntA(a, ARCHIVE_OK, archive_read_close(a));
+		assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+	}
+
+	free(buff);
+	free(out);
+	free(data);
+}
@@ -121,3 +121,106 @@ DEFINE_TEST(test_write_filter_program)
 	assertEqualIntA(a, ARCHIVE_OK, archive_read_close(a));
 	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
 }
+
+/*
+ * Push several megabytes of poorly compressible data through external
+ * programs in both directions, so that the child's input and output
+ * pipes fill up at the same time.
+ */
+DEFINE_TEST(test_write_filter_program_large)
+{
+	const size_t datasize = 8 * 1024 * 1024;
+	const size_t outsize = datasize + 1024 * 1024;
+	struct archive_entry *ae;
+	struct archive *a;
+	unsigned char *data, *out, *p;
+	uint32_t seed = 1;
+	size_t i, used, total;
+	ssize_t n;
+	int r;
+
+	if (!canGzip()) {
+		skipping("Cannot run 'gzip'");
+		return;
+	}
+	assert((data = malloc(datasize)) != NULL);
+	assert((out = malloc(outsize)) != NULL);
+	assert((p = malloc(65536)) != NULL);
+	for (i = 0; i < datasize; i++) {
+		seed = seed * 1103515245 + 12345;
+		/* Runs of a few bytes keep gzip busy but not idle. */
+		data[i] = (i & 3) ? data[i - 1] : (unsigned char)(seed >> 24);
+	}
+
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_ustar(a));
+	r = archive_write_add_filter_program(a, "gzip -1");
+	if (r == ARCHIVE_FATAL) {
+		skipping("Write compression via external "
+		    "program unsupported on this platform");
+		archive_write_free(a);
+		free(p);
+		free(out);
+		free(data);
+		return;
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_bytes_per_block(a, 1));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_set_bytes_in_last_block(a, 1));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, out, outsize, &used));
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_copy_pathname(ae, "file");
+	archive_entry_set_mode(ae, S_IFREG | 0644);
+	archive_entry_set_size(ae, datasize);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	archive_entry_free(ae);
+	/* Odd-sized writes straddle the program's input buffers. */
+	for (i = 0; i < datasize; i += (size_t)n) {
+		n = datasize - i < 12345 ? datasize - i : 12345;
+		assertEqualIntA(a, n, archive_write_data(a, data + i, n));
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+	assert(used > datasize / 4);
+
+	/* Read it back through "gzip -d". */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_support_filter_program(a, "gzip -d"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, out, used));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualString("file", archive_entry_pathname(ae));
+	assertEqualInt(datasize, archive_entry_size(ae));
+	total = 0;
+	while ((n = archive_read_data(a, p, 65536)) > 0) {
+		if (total + n > datasize ||
+		    memcmp(data + total, p, n) != 0)
+			break;
+		total += n;
+	}
+	assertEqualInt(0, n);
+	assertEqualInt(datasize, total);
+	assertEqualIntA(a, ARCHIVE_EOF, archive_read_next_header(a, &ae));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	/* Stop reading while the program still has input and output. */
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_tar(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_read_support_filter_program(a, "gzip -d"));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, out, used));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualIntA(a, 65536, archive_read_data(a, p, 65536));
+	assertEqualMem(p, data, 65536);
+	/* The program may complain that its output was cut short. */
+	r = archive_read_close(a);
+	assert(r == ARCHIVE_OK || r == ARCHIVE_WARN);
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	free(p);
+	free(out);
+	free(data);
+}
@@ -170,3 +170,93 @@ DEFINE_TEST(test_write_filter_uuencode)
 	free(data);
 	free(buff);
 }
+
+/*
+ * Encode a larger stream fed in odd-sized pieces, check the text
+ * against a plain encoder and decode it again.
+ */
+#define	UU(v)	((v) ? (v) + 0x20 : '`')
+DEFINE_TEST(test_write_filter_uuencode_large)
+{
+	static const size_t pieces[] = { 1, 44, 1000, 45, 7777, 3, 65536 };
+	struct archive_entry *ae;
+	struct archive *a;
+	unsigned char *data, *out;
+	char *buff, *expect, *e;
+	size_t buffsize, datasize, used, off, n, i, j;
+	unsigned int seed = 13, v;
+
+	datasize = 300001;
+	assert(NULL != (data = malloc(datasize)));
+	assert(NULL != (out = malloc(datasize)));
+	for (i = 0; i < datasize; i++) {
+		seed = seed * 1103515245 + 12345;
+		/* Plenty of zero bytes to exercise the '`' encoding. */
+		data[i] = (seed >> 28) < 4 ? 0 : (unsigned char)(seed >> 16);
+	}
+	buffsize = datasize * 2;
+	assert(NULL != (buff = malloc(buffsize)));
+	assert(NULL != (expect = malloc(buffsize)));
+
+	e = expect;
+	e += sprintf(e, "begin 644 -\n");
+	for (i = 0; i < datasize; i += 45) {
+		n = datasize - i < 45 ? datasize - i : 45;
+		*e++ = (char)UU(n);
+		for (j = 0; j < n; j += 3) {
+			v = data[i + j] << 16;
+			if (j + 1 < n)
+				v |= data[i + j + 1] << 8;
+			if (j + 2 < n)
+				v |= data[i + j + 2];
+			*e++ = (char)UU(v >> 18);
+			*e++ = (char)UU((v >> 12) & 0x3f);
+			*e++ = j + 1 < n ? (char)UU((v >> 6) & 0x3f) : '`';
+			*e++ = j + 2 < n ? (char)UU(v & 0x3f) : '`';
+		}
+		*e++ = '\n';
+	}
+	e += sprintf(e, "`\nend\n");
+
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_raw(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_add_filter_uuencode(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_bytes_per_block(a, 0));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, buffsize, &used));
+	assert((ae = archive_entry_new()) != NULL);
+	archive_entry_set_pathname(ae, "data");
+	archive_entry_set_filetype(ae, AE_IFREG);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_header(a, ae));
+	archive_entry_free(ae);
+	for (off = 0, i = 0; off < datasize; off += n, i++) {
+		n = pieces[i % (sizeof(pieces) / sizeof(pieces[0]))];
+		if (n > datasize - off)
+			n = datasize - off;
+		assertEqualInt(n, archive_write_data(a, data + off, n));
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_write_free(a));
+	assertEqualInt(e - expect, used);
+	assertEqualMem(buff, expect, e - expect);
+
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_raw(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_filter_all(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, buff, used));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_next_header(a, &ae));
+	assertEqualInt(ARCHIVE_FILTER_UU, archive_filter_code(a, 0));
+	for (off = 0; off < datasize; off += n) {
+		n = datasize - off < 5000 ? datasize - off : 5000;
+		if (!assertEqualInt(n, archive_read_data(a, out + off, n)))
+			break;
+	}
+	assertEqualMem(out, data, datasize);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_close(a));
+	assertEqualInt(ARCHIVE_OK, archive_read_free(a));
+
+	free(expect);
+	free(buff);
+	free(out);
+	free(data);
+}
@@ -2105,3 +2105,93 @@ DEFINE_TEST(test_write_format_mtree_digests_sha512_digest_set_non_empty_data)
 	return;
 #endif
 }
+
+/*
+ * Many files of assorted sizes, one of them written twice, so that
+ * digests computed together in batches are checked as well.
+ */
+DEFINE_TEST(test_write_format_mtree_digests_many_files)
+{
+#if defined(ARCHIVE_HAS_SHA1) && defined(ARCHIVE_HAS_SHA256)
+	enum { NFILES = 150, DUP = NFILES - 1 };
+	const size_t buffsize = 256 * 1024, datasize = 80000;
+	unsigned char (*sha1)[20], (*sha256)[32];
+	unsigned char *data;
+	char *buff, name[16];
+	size_t used, size;
+	struct archive *a;
+	struct archive_entry *entry;
+	int i, n, seen;
+
+	assert((buff = malloc(buffsize)) != NULL);
+	assert((data = malloc(datasize)) != NULL);
+	assert((sha1 = malloc((NFILES + 1) * sizeof(*sha1))) != NULL);
+	assert((sha256 = malloc((NFILES + 1) * sizeof(*sha256))) != NULL);
+	for (i = 0; i < (int)datasize; i++)
+		data[i] = (unsigned char)(i * 7 + (i >> 8));
+
+	assert((a = archive_write_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_set_format_mtree(a));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_set_options(a, "sha1,sha256"));
+	assertEqualIntA(a, ARCHIVE_OK,
+	    archive_write_open_memory(a, buff, buffsize, &used));
+	for (i = 0; i <= NFILES; i++) {
+		/* The last one, too large to be batched, replaces file
+		 * DUP while its digests may still be pending. */
+		n = i < NFILES ? i : DUP;
+		size = i < NFILES ? (size_t)(i * 613) % datasize :
+		    datasize - NFILES;
+		snprintf(name, sizeof(name), "f%d", n);
+		assert((entry = archive_entry_new()) != NULL);
+		archive_entry_set_pathname(entry, name);
+		archive_entry_set_filetype(entry, AE_IFREG);
+		archive_entry_set_size(entry, size);
+		archive_write_header(a, entry);
+		assertEqualInt(size, archive_write_data(a, data + i, size));
+		archive_entry_free(entry);
+
+		assertEqualInt(ARCHIVE_OK, archive_sha1_init(&expectedSha1Ctx));
+		assertEqualInt(ARCHIVE_OK,
+		    archive_sha1_update(&expectedSha1Ctx, data + i, size));
+		assertEqualInt(ARCHIVE_OK,
+		    archive_sha1_final(&expectedSha1Ctx, sha1[n]));
+		assertEqualInt(ARCHIVE_OK,
+		    archive_sha256_init(&expectedSha256Ctx));
+		assertEqualInt(ARCHIVE_OK,
+		    archive_sha256_update(&expectedSha256Ctx, data + i, size));
+		assertEqualInt(ARCHIVE_OK,
+		    archive_sha256_final(&expectedSha256Ctx, sha256[n]));
+	}
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_close(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_write_free(a));
+
+	assert((a = archive_read_new()) != NULL);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_support_format_mtree(a));
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_open_memory(a, buff, used));
+	for (seen = 0; archive_read_next_header(a, &entry) == ARCHIVE_OK;) {
+		if (archive_entry_filetype(entry) != AE_IFREG)
+			continue;
+		assert(strncmp(archive_entry_pathname(entry), "./f", 3) == 0);
+		n = atoi(archive_entry_pathname(entry) + 3);
+		assert(n >= 0 && n < NFILES);
+		if (n < 0 || n >= NFILES)
+			break;
+		failure("%s", archive_entry_pathname(entry));
+		assertEqualMem(archive_entry_digest(entry,
+		    ARCHIVE_ENTRY_DIGEST_SHA1), sha1[n], 20);
+		failure("%s", archive_entry_pathname(entry));
+		assertEqualMem(archive_entry_digest(entry,
+		    ARCHIVE_ENTRY_DIGEST_SHA256), sha256[n], 32);
+		seen++;
+	}
+	assertEqualInt(NFILES, seen);
+	assertEqualIntA(a, ARCHIVE_OK, archive_read_free(a));
+	free(buff);
+	free(data);
+	free(sha1);
+	free(sha256);
+#else
+	skipping("This platform does not support SHA1 and SHA256");
+#endif
+}
@@ -452,6 +452,34 @@ int read_open_memory_seek(struct archive *, const void *, size_t, size_t);
 #define assertEqualStringA(a,v1,v2)   \
   assertion_equal_string(__FILE__, __LINE__, (v1), #v1, (v2), #v2, (a), 0)
 
+/*
+ * Shared code for the tests of the readers' "threads" option; see
+ * read_threads.c.
+ */
+#define	READ_THREADS_MAX_ENTRIES	256
+
+struct read_threads_result {
+	int		 count;
+	char		 name[READ_THREADS_MAX_ENTRIES][256];
+	int64_t		 size[READ_THREADS_MAX_ENTRIES];
+	unsigned long	 sum[READ_THREADS_MAX_ENTRIES];
+	int		 ret[READ_THREADS_MAX_ENTRIES];
+};
+
+/* Skip the data of every other entry. */
+#define	READ_THREADS_SKIP_ODD		1
+/* Read only the first block of the data of an entry. */
+#define	READ_THREADS_FIRST_BLOCK	2
+
+unsigned long read_threads_checksum(unsigned long, const void *, size_t);
+void read_threads_archive(const char *, const void *, size_t, const char *,
+    int, int, struct read_threads_result *);
+void read_threads_compare(const char *, const char *,
+    const struct read_threads_result *, const struct read_threads_result *,
+    int, int);
+void read_threads_verify(const char *, const char * const *, int);
+int read_threads_check_option(const char *, int (*)(struct archive *));
+
 #else	/* defined(PROGRAM) */
 /*
  * Special interfaces for program test harness.